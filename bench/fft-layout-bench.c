@@ -0,0 +1,353 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : FFT layout benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          fft-layout-bench.c
+ *
+ *    This program times the half-complex (R2HC, hc.h) and the interleaved
+ *    complex (r2c, cx.h) FFT layouts on the two hot paths of the project.
+ *
+ * \library       waonc benchmarks
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    -  Analysis: windowing, forward FFT, and power spectrum, as done by
+ *       stage 1 of processing() (HC_to_amp2() versus CX_to_amp2()).
+ *    -  Phase vocoder: complex phase vocoder, loose phase lock, and
+ *       inverse FFT, as done for one channel by pv_complex_play_step().
+ *
+ *    The input is a synthetic chord, so no sound file is needed.  Both
+ *    layouts get the same frames; the largest relative difference of
+ *    their results is printed as well, as a check that the two paths
+ *    compute the same thing.
+ */
+
+#include <math.h>                      /* sin(), fabs()                       */
+#include <stdio.h>                     /* printf(), fprintf()                 */
+#include <stdlib.h>                    /* atoi(), exit()                      */
+#include <string.h>                    /* strcmp()                            */
+#include <time.h>                      /* clock_gettime()                     */
+
+#include "cx.h"                        /* CX_...() routines, CX_LENGTH()      */
+#include "fft.h"                       /* windowing(), fftw3.h                */
+#include "hc.h"                        /* HC_...() routines                   */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+
+/**
+ *    The FFT lengths timed when no -n option is given.
+ */
+
+static const long s_default_lengths[] = { 512, 1024, 2048, 4096, 8192, 0 };
+
+/**
+ *    Returns the monotonic time in seconds.
+ */
+
+static double
+bench_now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double) ts.tv_sec + 1.0e-9 * (double) ts.tv_nsec;
+}
+
+/**
+ *    Fills the n samples of the signal with a three-note chord (C4, E4,
+ *    G4 at 44.1 kHz) plus a little noise.
+ */
+
+static void
+bench_signal (long n, double * x)
+{
+   long i;
+   srand(1);
+   for (i = 0; i < n; ++i)
+   {
+      double t = (double) i / 44100.0;
+      x[i] = 0.5 * sin(2.0 * M_PI * 261.63 * t) +
+         0.3 * sin(2.0 * M_PI * 329.63 * t) +
+         0.2 * sin(2.0 * M_PI * 392.00 * t) +
+         1.0e-3 * ((double) rand() / (double) RAND_MAX - 0.5);
+   }
+}
+
+/**
+ *    Returns the largest difference between a and b, relative to the
+ *    largest magnitude of a.
+ */
+
+static double
+bench_diff (long n, const double * a, const double * b)
+{
+   long i;
+   double dmax = 0.0;
+   double amax = 0.0;
+   for (i = 0; i < n; ++i)
+   {
+      double d = fabs(a[i] - b[i]);
+      if (d > dmax)
+         dmax = d;
+
+      if (fabs(a[i]) > amax)
+         amax = fabs(a[i]);
+   }
+   return amax > 0.0 ? dmax / amax : dmax;
+}
+
+/**
+ *    Times the analysis and the phase-vocoder paths for one FFT length,
+ *    and prints one line for each.
+ *
+ * \param len
+ *    The FFT length.
+ *
+ * \param frames
+ *    The number of frames (hops of len/4) to process per layout.
+ */
+
+static void
+bench_length (long len, int frames)
+{
+   long hop = len / 4;
+   long nsig = len + hop * (frames + 1);
+   long nc = CX_LENGTH(len);
+   double * sig = (double *) malloc(sizeof(double) * nsig);
+   double * x = (double *) fftw_malloc(sizeof(double) * len);
+   double * t = (double *) fftw_malloc(sizeof(double) * len);
+   double * hc = (double *) fftw_malloc(sizeof(double) * len);
+   double * cx = (double *) fftw_malloc(sizeof(double) * nc);
+   double * hc_fs = (double *) malloc(sizeof(double) * len);
+   double * cx_fs = (double *) malloc(sizeof(double) * nc);
+   double * hc_old = (double *) malloc(sizeof(double) * len);
+   double * cx_old = (double *) malloc(sizeof(double) * nc);
+   double * tmp = (double *) malloc(sizeof(double) * nc);
+   double * hc_p = (double *) malloc(sizeof(double) * (len / 2 + 1));
+   double * cx_p = (double *) malloc(sizeof(double) * (len / 2 + 1));
+   double * hc_t = (double *) malloc(sizeof(double) * len);
+   double * cx_t = (double *) malloc(sizeof(double) * len);
+   double den = init_den(len, FILTER_WINDOW_HANNING);
+   double t_hc_ana, t_cx_ana, t_hc_pv, t_cx_pv;
+   double d_ana, d_pv;
+   double t0;
+   fftw_plan hc_plan, hc_inv, cx_plan, cx_inv;
+   int f;
+   long i;
+
+   CHECK_MALLOC(sig, "bench_length");
+   CHECK_MALLOC(x, "bench_length");
+   CHECK_MALLOC(t, "bench_length");
+   CHECK_MALLOC(hc, "bench_length");
+   CHECK_MALLOC(cx, "bench_length");
+   CHECK_MALLOC(hc_fs, "bench_length");
+   CHECK_MALLOC(cx_fs, "bench_length");
+   CHECK_MALLOC(hc_old, "bench_length");
+   CHECK_MALLOC(cx_old, "bench_length");
+   CHECK_MALLOC(tmp, "bench_length");
+   CHECK_MALLOC(hc_p, "bench_length");
+   CHECK_MALLOC(cx_p, "bench_length");
+   CHECK_MALLOC(hc_t, "bench_length");
+   CHECK_MALLOC(cx_t, "bench_length");
+   bench_signal(nsig, sig);
+
+   /*
+    * The same planning flags as the pipelines use.
+    */
+
+   hc_plan = fftw_plan_r2r_1d(len, x, hc, FFTW_R2HC, FFTW_ESTIMATE);
+   hc_inv = fftw_plan_r2r_1d(len, hc, t, FFTW_HC2R, FFTW_ESTIMATE);
+   cx_plan = fftw_plan_dft_r2c_1d(len, x, (fftw_complex *) cx, FFTW_ESTIMATE);
+   cx_inv = fftw_plan_dft_c2r_1d(len, (fftw_complex *) cx, t, FFTW_ESTIMATE);
+
+   /*
+    * Analysis:  window, FFT, power spectrum.
+    */
+
+   t0 = bench_now();
+   for (f = 0; f < frames; ++f)
+   {
+      windowing(len, sig + f * hop, FILTER_WINDOW_HANNING, 1.0, x);
+      fftw_execute(hc_plan);
+      HC_to_amp2(len, hc, den, hc_p);
+   }
+   t_hc_ana = bench_now() - t0;
+
+   t0 = bench_now();
+   for (f = 0; f < frames; ++f)
+   {
+      windowing(len, sig + f * hop, FILTER_WINDOW_HANNING, 1.0, x);
+      fftw_execute(cx_plan);
+      CX_to_amp2(len, cx, den, cx_p);
+   }
+   t_cx_ana = bench_now() - t0;
+   d_ana = bench_diff(len / 2 + 1, hc_p, cx_p);
+
+   /*
+    * Phase vocoder:  the spectra X[s_i] and X[t_i] are those of the
+    * frames f and f+1; Y[u_{i-1}] starts as X[s_0].  The inverse FFT
+    * works on a copy, as apply_invFFT_mono() does.
+    */
+
+   windowing(len, sig, FILTER_WINDOW_HANNING, 1.0, x);
+   fftw_execute(hc_plan);
+   for (i = 0; i < len; ++i)
+      hc_old[i] = hc[i];
+
+   t0 = bench_now();
+   for (f = 0; f < frames; ++f)
+   {
+      windowing(len, sig + f * hop, FILTER_WINDOW_HANNING, 1.0, x);
+      fftw_execute(hc_plan);
+      for (i = 0; i < len; ++i)
+         hc_fs[i] = hc[i];
+
+      windowing(len, sig + (f + 1) * hop, FILTER_WINDOW_HANNING, 1.0, x);
+      fftw_execute(hc_plan);
+      HC_complex_phase_vocoder(len, hc_fs, hc, hc_old, tmp);
+      HC_puckette_lock(len, tmp, hc_old);
+      for (i = 0; i < len; ++i)
+         hc[i] = tmp[i];
+
+      fftw_execute(hc_inv);
+   }
+   t_hc_pv = bench_now() - t0;
+   for (i = 0; i < len; ++i)
+      hc_t[i] = t[i];
+
+   windowing(len, sig, FILTER_WINDOW_HANNING, 1.0, x);
+   fftw_execute(cx_plan);
+   for (i = 0; i < nc; ++i)
+      cx_old[i] = cx[i];
+
+   t0 = bench_now();
+   for (f = 0; f < frames; ++f)
+   {
+      windowing(len, sig + f * hop, FILTER_WINDOW_HANNING, 1.0, x);
+      fftw_execute(cx_plan);
+      for (i = 0; i < nc; ++i)
+         cx_fs[i] = cx[i];
+
+      windowing(len, sig + (f + 1) * hop, FILTER_WINDOW_HANNING, 1.0, x);
+      fftw_execute(cx_plan);
+      CX_complex_phase_vocoder(len, cx_fs, cx, cx_old, tmp);
+      CX_puckette_lock(len, tmp, cx_old);
+      for (i = 0; i < nc; ++i)
+         cx[i] = tmp[i];
+
+      fftw_execute(cx_inv);
+   }
+   t_cx_pv = bench_now() - t0;
+   for (i = 0; i < len; ++i)
+      cx_t[i] = t[i];
+
+   d_pv = bench_diff(len, hc_t, cx_t);
+   printf
+   (
+      "%6ld  analysis  %10.0f %10.0f  %5.2fx  %9.2e\n",
+      len, 1.0e9 * t_hc_ana / frames, 1.0e9 * t_cx_ana / frames,
+      t_hc_ana / t_cx_ana, d_ana
+   );
+   printf
+   (
+      "%6ld  vocoder   %10.0f %10.0f  %5.2fx  %9.2e\n",
+      len, 1.0e9 * t_hc_pv / frames, 1.0e9 * t_cx_pv / frames,
+      t_hc_pv / t_cx_pv, d_pv
+   );
+
+   fftw_destroy_plan(hc_plan);
+   fftw_destroy_plan(hc_inv);
+   fftw_destroy_plan(cx_plan);
+   fftw_destroy_plan(cx_inv);
+   free(sig);
+   fftw_free(x);
+   fftw_free(t);
+   fftw_free(hc);
+   fftw_free(cx);
+   free(hc_fs);
+   free(cx_fs);
+   free(hc_old);
+   free(cx_old);
+   free(tmp);
+   free(hc_p);
+   free(cx_p);
+   free(hc_t);
+   free(cx_t);
+}
+
+/**
+ *    Prints the usage of the benchmark.
+ */
+
+static void
+bench_usage (const char * argv0)
+{
+   fprintf
+   (
+      stdout,
+      "Usage: %s [-n len] [-f frames]\n\n"
+      "  -n len     Time only this FFT length [Default: 512 to 8192].\n"
+      "  -f frames  Number of frames per layout and path [Default: 2000].\n"
+      "\n"
+      "Times are in nanoseconds per frame.  'diff' is the largest relative\n"
+      "difference between the results of the two layouts.\n"
+      ,
+      argv0
+   );
+}
+
+int
+main (int argc, char * argv[])
+{
+   long len = 0;
+   int frames = 2000;
+   int i;
+   for (i = 1; i < argc; ++i)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         len = atol(argv[++i]);
+      else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+         frames = atoi(argv[++i]);
+      else
+      {
+         bench_usage(argv[0]);
+         exit(1);
+      }
+   }
+   if (frames < 1 || len < 0 || (len > 0 && len < 8))
+   {
+      bench_usage(argv[0]);
+      exit(1);
+   }
+   printf("   len  path          HC ns      CX ns  speedup       diff\n");
+   if (len > 0)
+      bench_length(len, frames);
+   else
+   {
+      for (i = 0; s_default_lengths[i] > 0; ++i)
+         bench_length(s_default_lengths[i], frames);
+   }
+   return 0;
+}
+
+/*
+ * fft-layout-bench.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,353 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : phase-vocoder engine benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          pv-bench.c
+ *
+ *    This program runs each phase-vocoder engine of pv-engine.h over the
+ *    same input and compares their speed, memory, and latency.
+ *
+ * \library       waonc benchmarks
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The input is a synthetic chord at 44.1 kHz, pushed through
+ *    pv_engine_process_block() in blocks of a fixed size, as a caller with
+ *    an audio callback would do.  Each engine runs in a child process, so
+ *    that its peak memory can be read from wait4(); the "peak KiB" column
+ *    is that peak less the peak of a child that runs no engine.
+ *
+ *    The "realtime" column is the output rate in multiples of 44.1 kHz
+ *    (above 1 is faster than real time).  The "latency" column is the
+ *    input that had to be pushed before the first output frame came out,
+ *    in milliseconds.  An engine that does not take the parameters (e.g.
+ *    "freq" with a rate below 1) shows "n/a".
+ */
+
+#include <math.h>                      /* sin()                               */
+#include <stdio.h>                     /* printf(), fprintf()                 */
+#include <stdlib.h>                    /* atol(), atof(), malloc(), exit()    */
+#include <string.h>                    /* strcmp()                            */
+#include <time.h>                      /* clock_gettime()                     */
+#include <unistd.h>                    /* fork(), pipe(), read(), write()     */
+#include <sys/resource.h>              /* struct rusage                       */
+#include <sys/wait.h>                  /* wait4()                             */
+
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "pv-engine.h"                 /* pv_engine_t, the engines            */
+
+/**
+ *    The sampling rate of the input.
+ */
+
+#define BENCH_RATE                     44100.0
+
+/**
+ *    Holds what a child sends back to the parent.
+ */
+
+typedef struct
+{
+   wbool_t ok;             /*<< The engine took the parameters.               */
+   double seconds;         /*<< Wall time of the run.                         */
+   long frames;            /*<< Output frames, with the flush.                */
+   long latency;           /*<< Input frames pushed before the first output.  */
+
+} bench_result_t;
+
+/**
+ *    Returns the monotonic time in seconds.
+ */
+
+static double
+bench_now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double) ts.tv_sec + 1.0e-9 * (double) ts.tv_nsec;
+}
+
+/**
+ *    Fills the n frames of the two channels with a three-note chord (C4,
+ *    E4, G4), C4 and E4 on the left, C4 and G4 on the right.
+ */
+
+static void
+bench_signal (long n, double * l, double * r)
+{
+   long i;
+   for (i = 0; i < n; ++i)
+   {
+      double t = (double) i / BENCH_RATE;
+      l[i] = 0.5 * sin(2.0 * M_PI * 261.63 * t) +
+         0.3 * sin(2.0 * M_PI * 329.63 * t);
+
+      r[i] = 0.5 * sin(2.0 * M_PI * 261.63 * t) +
+         0.2 * sin(2.0 * M_PI * 392.00 * t);
+   }
+}
+
+/**
+ *    Runs one engine over the whole input, in the child.
+ */
+
+static bench_result_t
+bench_run
+(
+   const pv_engine_ops_t * ops,
+   const pv_engine_params_t * params,
+   const double * l,
+   const double * r,
+   long n,
+   long block
+)
+{
+   bench_result_t result;
+   pv_engine_t * e;
+   double * out_l;
+   double * out_r;
+   double t0;
+   long pos;
+   memset(&result, 0, sizeof result);
+   result.latency = -1;
+   e = pv_engine_new(ops, params);
+   if (is_nullptr(e))
+      return result;
+
+   out_l = (double *) malloc(sizeof(double) * PV_ENGINE_BLOCK);
+   out_r = (double *) malloc(sizeof(double) * PV_ENGINE_BLOCK);
+   CHECK_MALLOC(out_l, "bench_run");
+   CHECK_MALLOC(out_r, "bench_run");
+   t0 = bench_now();
+   for (pos = 0; pos < n; pos += block)
+   {
+      long count = n - pos < block ? n - pos : block;
+      long m;
+      if (pv_engine_process_block(e, l + pos, r + pos, count) < 0)
+         break;
+
+      while ((m = pv_engine_read(e, out_l, out_r, PV_ENGINE_BLOCK)) > 0)
+      {
+         if (result.latency < 0)
+            result.latency = pos + count;
+
+         result.frames += m;
+      }
+   }
+   if (pv_engine_flush(e) >= 0)
+   {
+      long m;
+      while ((m = pv_engine_read(e, out_l, out_r, PV_ENGINE_BLOCK)) > 0)
+      {
+         if (result.latency < 0)
+            result.latency = n;
+
+         result.frames += m;
+      }
+   }
+   result.seconds = bench_now() - t0;
+   result.ok = wtrue;
+   free(out_l);
+   free(out_r);
+   pv_engine_free(e);
+   return result;
+}
+
+/**
+ *    Runs one engine, or none if \a ops is null, in a child process.
+ *
+ * \return
+ *    Returns the peak resident size of the child in KiB, or -1 if the
+ *    child cannot be run.
+ */
+
+static long
+bench_child
+(
+   const pv_engine_ops_t * ops,
+   const pv_engine_params_t * params,
+   const double * l,
+   const double * r,
+   long n,
+   long block,
+   bench_result_t * result
+)
+{
+   struct rusage usage;
+   int status;
+   int fd[2];
+   pid_t pid;
+   memset(result, 0, sizeof *result);
+   if (pipe(fd) != 0)
+      return -1;
+
+   pid = fork();
+   if (pid < 0)
+   {
+      close(fd[0]);
+      close(fd[1]);
+      return -1;
+   }
+   if (pid == 0)
+   {
+      bench_result_t res;
+      memset(&res, 0, sizeof res);
+      close(fd[0]);
+      if (not_nullptr(ops))
+         res = bench_run(ops, params, l, r, n, block);
+
+      if (write(fd[1], &res, sizeof res) != (ssize_t) sizeof res)
+         _exit(1);
+
+      close(fd[1]);
+      _exit(0);
+   }
+   close(fd[1]);
+   if (read(fd[0], result, sizeof *result) != (ssize_t) sizeof *result)
+      memset(result, 0, sizeof *result);
+
+   close(fd[0]);
+   if (wait4(pid, &status, 0, &usage) < 0)
+      return -1;
+
+   return usage.ru_maxrss;
+}
+
+/**
+ *    Prints the usage of the benchmark.
+ */
+
+static void
+bench_usage (const char * argv0)
+{
+   fprintf
+   (
+      stdout,
+      "Usage: %s [-n len] [-hop hop] [-r rate] [-p pitch] [-s seconds]\n"
+      "          [-b block] [-e engine]\n\n"
+      "  -n len      FFT length [Default: 2048].\n"
+      "  -hop hop    Synthesis hop [Default: 512].\n"
+      "  -r rate     Time-stretching rate [Default: 1.0].\n"
+      "  -p pitch    Pitch shift in half-notes [Default: 0].\n"
+      "  -s seconds  Length of the input [Default: 10].\n"
+      "  -b block    Input frames per pv_engine_process_block()\n"
+      "              [Default: 1024].\n"
+      "  -e engine   Run only this engine [Default: all of them].\n"
+      "\n"
+      "See the source for the meaning of the columns.  The engines are:\n"
+      ,
+      argv0
+   );
+}
+
+int
+main (int argc, char * argv[])
+{
+   pv_engine_params_t params;
+   const pv_engine_ops_t * only = nullptr;
+   const pv_engine_ops_t * ops;
+   bench_result_t result;
+   double seconds = 10.0;
+   long block = 1024;
+   long base;
+   long n;
+   double * l;
+   double * r;
+   int i;
+   pv_engine_params_init(&params);
+   for (i = 1; i < argc; ++i)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         params.len = atol(argv[++i]);
+      else if (strcmp(argv[i], "-hop") == 0 && i + 1 < argc)
+         params.hop_syn = atol(argv[++i]);
+      else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+         params.rate = atof(argv[++i]);
+      else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+         params.pitch_shift = atof(argv[++i]);
+      else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+         seconds = atof(argv[++i]);
+      else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+         block = atol(argv[++i]);
+      else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+      {
+         only = pv_engine_find(argv[++i]);
+         if (is_nullptr(only))
+            break;
+      }
+      else
+         break;
+   }
+   if (i < argc || seconds <= 0.0 || block < 1)
+   {
+      bench_usage(argv[0]);
+      for (i = 0; not_nullptr(ops = pv_engine_list(i)); ++i)
+         printf("  %-14s %s\n", ops->name, ops->description);
+
+      exit(1);
+   }
+   n = (long) (seconds * BENCH_RATE);
+   l = (double *) malloc(sizeof(double) * n);
+   r = (double *) malloc(sizeof(double) * n);
+   CHECK_MALLOC(l, "main");
+   CHECK_MALLOC(r, "main");
+   bench_signal(n, l, r);
+   base = bench_child(nullptr, &params, l, r, n, block, &result);
+   printf
+   (
+      "len %ld, hop %ld, rate %g, pitch %g, %g s in blocks of %ld\n",
+      params.len, params.hop_syn, params.rate, params.pitch_shift,
+      seconds, block
+   );
+   printf("engine           realtime  latency ms   peak KiB     frames\n");
+   for (i = 0; not_nullptr(ops = pv_engine_list(i)); ++i)
+   {
+      long peak;
+      if (not_nullptr(only) && ops != only)
+         continue;
+
+      peak = bench_child(ops, &params, l, r, n, block, &result);
+      if (! result.ok || peak < 0)
+      {
+         printf("%-14s %10s\n", ops->name, "n/a");
+         continue;
+      }
+      printf
+      (
+         "%-14s %10.1f %11.1f %10ld %10ld\n",
+         ops->name,
+         result.seconds > 0.0 ?
+            (double) result.frames / BENCH_RATE / result.seconds : 0.0,
+         1000.0 * (double) result.latency / BENCH_RATE,
+         peak > base ? peak - base : 0L,
+         result.frames
+      );
+   }
+   free(l);
+   free(r);
+   return 0;
+}
+
+/*
+ * pv-bench.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,271 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : phase-vocoder kernel benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          pv-kernel-bench.c
+ *
+ *    This program checks and times the vectorized half-complex kernels of
+ *    hc-simd.c against the scalar routines of hc.c.
+ *
+ * \library       waonc benchmarks
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    For each instruction set the processor supports, the two kernels
+ *    HC_complex_phase_vocoder_simd() and HC_puckette_lock_simd() are run
+ *    on random spectra, for an even and an odd FFT length, and compared to
+ *    HC_complex_phase_vocoder() and HC_puckette_lock().  The "error"
+ *    column is the largest difference of a bin, relative to the magnitude
+ *    of that bin; the program exits with status 1 if it is above 1e-12.
+ *    The "ns/bin" column is the time per bin (len/2+1 bins per call).
+ */
+
+#include <math.h>                      /* fabs(), sqrt()                      */
+#include <stdio.h>                     /* printf(), fprintf()                 */
+#include <stdlib.h>                    /* atoi(), exit(), rand()              */
+#include <string.h>                    /* strcmp(), memcpy()                  */
+#include <time.h>                      /* clock_gettime()                     */
+
+#include "hc.h"                        /* HC_...() routines                   */
+#include "hc-simd.h"                   /* HC_..._simd() routines              */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+
+/**
+ *    The largest error accepted.
+ */
+
+#define BENCH_TOLERANCE                1.0e-12
+
+/**
+ *    Returns the monotonic time in seconds.
+ */
+
+static double
+bench_now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double) ts.tv_sec + 1.0e-9 * (double) ts.tv_nsec;
+}
+
+/**
+ *    Fills an HC spectrum with random values of up to \a amp.
+ */
+
+static void
+bench_spectrum (long len, double amp, double * x)
+{
+   long i;
+   for (i = 0; i < len; ++i)
+      x[i] = amp * (2.0 * (double) rand() / (double) RAND_MAX - 1.0);
+}
+
+/**
+ *    Returns the largest difference of the bins of two HC spectra,
+ *    relative to the magnitude of the bin of the reference.
+ */
+
+static double
+bench_error (long len, const double * ref, const double * x)
+{
+   double err = 0.0;
+   long i;
+   for (i = 0; i <= len / 2; ++i)
+   {
+      double re = fabs(x[i] - ref[i]);
+      double ie = 0.0;
+      double mag = fabs(ref[i]);
+      double e;
+      if (i > 0 && len - i != i)
+      {
+         ie = fabs(x[len - i] - ref[len - i]);
+         mag = sqrt(ref[i] * ref[i] + ref[len - i] * ref[len - i]);
+      }
+      e = (re > ie ? re : ie) / (mag > 1.0e-300 ? mag : 1.0);
+      if (e > err)
+         err = e;
+   }
+   return err;
+}
+
+/**
+ *    Checks and times both kernels with the current instruction set, for
+ *    one FFT length, and prints their lines.
+ *
+ * \return
+ *    Returns the larger error of the two kernels.
+ */
+
+static double
+bench_length (long len, int calls, wbool_t reference)
+{
+   double * fs = (double *) malloc(sizeof(double) * len);
+   double * ft = (double *) malloc(sizeof(double) * len);
+   double * fo = (double *) malloc(sizeof(double) * len);
+   double * ref = (double *) malloc(sizeof(double) * len);
+   double * out = (double *) malloc(sizeof(double) * len);
+   const char * isa = reference ? "hc.c" : hc_simd_name(hc_simd_level());
+   double bins = (double) calls * (double) (len / 2 + 1);
+   double err_pv, err_lock, t0, t;
+   int c;
+   CHECK_MALLOC(fs, "bench_length");
+   CHECK_MALLOC(ft, "bench_length");
+   CHECK_MALLOC(fo, "bench_length");
+   CHECK_MALLOC(ref, "bench_length");
+   CHECK_MALLOC(out, "bench_length");
+   srand(1);
+   bench_spectrum(len, 100.0, fs);
+   bench_spectrum(len, 100.0, ft);
+   bench_spectrum(len, 100.0, fo);
+
+   /*
+    * The phase vocoder, also in place (f_out == f_out_old), as
+    * pv_complex_play_step() calls it.
+    */
+
+   HC_complex_phase_vocoder(len, fs, ft, fo, ref);
+   memcpy(out, fo, sizeof(double) * len);
+   if (reference)
+      HC_complex_phase_vocoder(len, fs, ft, out, out);
+   else
+      HC_complex_phase_vocoder_simd(len, fs, ft, out, out);
+
+   err_pv = bench_error(len, ref, out);
+   t0 = bench_now();
+   for (c = 0; c < calls; ++c)
+   {
+      if (reference)
+         HC_complex_phase_vocoder(len, fs, ft, fo, out);
+      else
+         HC_complex_phase_vocoder_simd(len, fs, ft, fo, out);
+   }
+   t = bench_now() - t0;
+   printf
+   (
+      "%-16s %-8s %6ld %10.2f %11.1e\n",
+      "phase vocoder", isa, len, 1.0e9 * t / bins, err_pv
+   );
+
+   /*
+    * The loose phase lock.
+    */
+
+   HC_puckette_lock(len, fs, ref);
+   if (reference)
+      HC_puckette_lock(len, fs, out);
+   else
+      HC_puckette_lock_simd(len, fs, out);
+
+   err_lock = bench_error(len, ref, out);
+   t0 = bench_now();
+   for (c = 0; c < calls; ++c)
+   {
+      if (reference)
+         HC_puckette_lock(len, ft, out);
+      else
+         HC_puckette_lock_simd(len, ft, out);
+   }
+   t = bench_now() - t0;
+   printf
+   (
+      "%-16s %-8s %6ld %10.2f %11.1e\n",
+      "puckette lock", isa, len, 1.0e9 * t / bins, err_lock
+   );
+   free(fs);
+   free(ft);
+   free(fo);
+   free(ref);
+   free(out);
+   return err_pv > err_lock ? err_pv : err_lock;
+}
+
+/**
+ *    Prints the usage of the benchmark.
+ */
+
+static void
+bench_usage (const char * argv0)
+{
+   fprintf
+   (
+      stdout,
+      "Usage: %s [-n len] [-f calls]\n\n"
+      "  -n len     FFT length; len+1 is checked as well [Default: 2048].\n"
+      "  -f calls   Number of calls timed per kernel [Default: 20000].\n"
+      ,
+      argv0
+   );
+}
+
+int
+main (int argc, char * argv[])
+{
+   long len = 2048;
+   int calls = 20000;
+   double err = 0.0;
+   int level;
+   int i;
+   for (i = 1; i < argc; ++i)
+   {
+      if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+         len = atol(argv[++i]);
+      else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+         calls = atoi(argv[++i]);
+      else
+      {
+         bench_usage(argv[0]);
+         exit(1);
+      }
+   }
+   if (len < 16 || calls < 1)
+   {
+      bench_usage(argv[0]);
+      exit(1);
+   }
+   printf("kernel           isa         len     ns/bin       error\n");
+   bench_length(len, calls, wtrue);
+   bench_length(len + 1, calls, wtrue);
+   for (level = HC_SIMD_NONE; level < HC_SIMD_MAX; ++level)
+   {
+      if (hc_simd_set_level((hc_simd_t) level))
+      {
+         double e = bench_length(len, calls, wfalse);
+         if (e > err)
+            err = e;
+
+         e = bench_length(len + 1, calls, wfalse);
+         if (e > err)
+            err = e;
+      }
+   }
+   if (err > BENCH_TOLERANCE)
+   {
+      fprintf(stderr, "? largest error %g is above %g\n", err, BENCH_TOLERANCE);
+      return 1;
+   }
+   return 0;
+}
+
+/*
+ * pv-kernel-bench.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
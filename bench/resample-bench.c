@@ -0,0 +1,310 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : pitch-shift resampler benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          resample-bench.c
+ *
+ *    This program times pv_complex_resample(), the samplerate conversion
+ *    that does the pitch-shift of the phase vocoder, for each converter
+ *    of libsamplerate.
+ *
+ * \library       waonc benchmarks
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Each hop of a synthetic chord is copied into the [lr]_out[] buffers of
+ *    a struct pv_complex and converted, as pv_complex_play_step() does.
+ *    For reference, the "simple" line times the old way, a src_simple()
+ *    call (a new SRC_SINC_FASTEST converter) for every hop.
+ *
+ *    The "jump" column is the largest step between two output samples
+ *    that straddle a hop boundary, relative to the largest step inside
+ *    the hops.  A converter that keeps its state stays near 1; one that
+ *    restarts every hop shows the clicks at the boundaries.
+ */
+
+#include <math.h>                      /* sin(), fabs()                       */
+#include <stdio.h>                     /* printf(), fprintf()                 */
+#include <stdlib.h>                    /* atoi(), atof(), calloc(), exit()    */
+#include <string.h>                    /* strcmp()                            */
+#include <time.h>                      /* clock_gettime()                     */
+
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "pv-complex.h"                /* struct pv_complex, samplerate.h     */
+
+/**
+ *    Returns the monotonic time in seconds.
+ */
+
+static double
+bench_now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double) ts.tv_sec + 1.0e-9 * (double) ts.tv_nsec;
+}
+
+/**
+ *    Fills the n frames of the two channels with a three-note chord (C4,
+ *    E4, G4 at 44.1 kHz), C4 and E4 on the left, C4 and G4 on the right.
+ */
+
+static void
+bench_signal (long n, double * l, double * r)
+{
+   long i;
+   for (i = 0; i < n; ++i)
+   {
+      double t = (double) i / 44100.0;
+      l[i] = 0.5 * sin(2.0 * M_PI * 261.63 * t) +
+         0.3 * sin(2.0 * M_PI * 329.63 * t);
+
+      r[i] = 0.5 * sin(2.0 * M_PI * 261.63 * t) +
+         0.2 * sin(2.0 * M_PI * 392.00 * t);
+   }
+}
+
+/**
+ *    Copies hop \a h of the signal into the [lr]_out[] buffers of the
+ *    phase vocoder.
+ */
+
+static void
+bench_hop
+(
+   struct pv_complex * pv,
+   int h,
+   const double * l,
+   const double * r
+)
+{
+   long i;
+   for (i = 0; i < pv->hop_syn; ++i)
+   {
+      pv->l_out[i] = l[h * pv->hop_syn + i];
+      pv->r_out[i] = r[h * pv->hop_syn + i];
+   }
+}
+
+/**
+ *    Updates the largest steps between neighboring output samples, at
+ *    the hop boundary (with the last sample of the previous hop) and
+ *    inside the hop.  The first hops, which hold the delay of the
+ *    converter, are not counted.
+ */
+
+static void
+bench_steps
+(
+   long n,
+   const double * y,
+   double * last,
+   int count,
+   double * at_edge,
+   double * inside
+)
+{
+   long i;
+   if (count > 4)
+   {
+      double d = fabs(y[0] - *last);
+      if (d > *at_edge)
+         *at_edge = d;
+
+      for (i = 1; i < n; ++i)
+      {
+         d = fabs(y[i] - y[i - 1]);
+         if (d > *inside)
+            *inside = d;
+      }
+   }
+   *last = y[n - 1];
+}
+
+/**
+ *    Converts \a hops hops with the old per-hop src_simple() call.
+ */
+
+static void
+bench_simple
+(
+   struct pv_complex * pv,
+   int hops,
+   const double * l,
+   const double * r,
+   double * left,
+   double * at_edge,
+   double * inside
+)
+{
+   SRC_DATA srdata;
+   float * fl_in = (float *) malloc(sizeof(float) * 2 * pv->hop_syn);
+   float * fl_out = (float *) calloc(2 * pv->hop_res, sizeof(float));
+   double last = 0.0;
+   int h;
+   long i;
+   CHECK_MALLOC(fl_in, "bench_simple");
+   CHECK_MALLOC(fl_out, "bench_simple");
+   for (h = 0; h < hops; ++h)
+   {
+      bench_hop(pv, h, l, r);
+      for (i = 0; i < pv->hop_syn; ++i)
+      {
+         fl_in[i * 2 + 0] = (float) pv->l_out[i];
+         fl_in[i * 2 + 1] = (float) pv->r_out[i];
+      }
+      srdata.data_in = fl_in;
+      srdata.data_out = fl_out;
+      srdata.input_frames = pv->hop_syn;
+      srdata.output_frames = pv->hop_res;
+      srdata.src_ratio = (double) pv->hop_res / (double) pv->hop_syn;
+      src_simple(&srdata, SRC_SINC_FASTEST, 2);
+      for (i = 0; i < pv->hop_res; ++i)
+         left[i] = (double) fl_out[i * 2 + 0];
+
+      bench_steps(pv->hop_res, left, &last, h, at_edge, inside);
+   }
+   free(fl_in);
+   free(fl_out);
+}
+
+/**
+ *    Times one converter (or the src_simple() reference if \a quality is
+ *    negative) and prints its line.
+ */
+
+static void
+bench_quality
+(
+   long len,
+   long hop,
+   double pitch,
+   int hops,
+   int quality
+)
+{
+   struct pv_complex * pv = pv_complex_init(len, hop, 3);
+   double * left = (double *) malloc(sizeof(double) * (2 * hop + 16));
+   double * right = (double *) malloc(sizeof(double) * (2 * hop + 16));
+   double * l = (double *) malloc(sizeof(double) * hops * hop);
+   double * r = (double *) malloc(sizeof(double) * hops * hop);
+   double at_edge = 0.0;
+   double inside = 0.0;
+   double last = 0.0;
+   double t0, t;
+   int h;
+   CHECK_MALLOC(pv, "bench_quality");
+   CHECK_MALLOC(left, "bench_quality");
+   CHECK_MALLOC(right, "bench_quality");
+   CHECK_MALLOC(l, "bench_quality");
+   CHECK_MALLOC(r, "bench_quality");
+   bench_signal(hops * hop, l, r);
+   pv_complex_change_rate_pitch(pv, 1.0, pitch);
+   t0 = bench_now();
+   if (quality < 0)
+      bench_simple(pv, hops, l, r, left, &at_edge, &inside);
+   else
+   {
+      pv_complex_set_resample_quality(pv, quality);
+      for (h = 0; h < hops; ++h)
+      {
+         bench_hop(pv, h, l, r);
+         pv_complex_resample(pv, left, right);
+         bench_steps(pv->hop_res, left, &last, h, &at_edge, &inside);
+      }
+   }
+   t = bench_now() - t0;
+   printf
+   (
+      "%-24s %10.0f %9.1fx %8.2f\n",
+      quality < 0 ? "src_simple() per hop" : src_get_name(quality),
+      1.0e9 * t / hops,
+      (double) hops * (double) pv->hop_res / 44100.0 / t,
+      inside > 0.0 ? at_edge / inside : 0.0
+   );
+   free(left);
+   free(right);
+   free(l);
+   free(r);
+   pv_complex_free(pv);
+}
+
+/**
+ *    Prints the usage of the benchmark.
+ */
+
+static void
+bench_usage (const char * argv0)
+{
+   fprintf
+   (
+      stdout,
+      "Usage: %s [-hop hop] [-pitch p] [-f hops]\n\n"
+      "  -hop hop   Synthesis hop [Default: 512].\n"
+      "  -pitch p   Pitch shift in half-notes, -12 to 12 [Default: 1].\n"
+      "  -f hops    Number of hops per converter [Default: 2000].\n"
+      "\n"
+      "'ns/hop' is the time of one conversion, 'realtime' is the output\n"
+      "rate in multiples of 44.1 kHz.  See the source for 'jump'.\n"
+      ,
+      argv0
+   );
+}
+
+int
+main (int argc, char * argv[])
+{
+   long hop = 512;
+   double pitch = 1.0;
+   int hops = 2000;
+   int i;
+   for (i = 1; i < argc; ++i)
+   {
+      if (strcmp(argv[i], "-hop") == 0 && i + 1 < argc)
+         hop = atol(argv[++i]);
+      else if (strcmp(argv[i], "-pitch") == 0 && i + 1 < argc)
+         pitch = atof(argv[++i]);
+      else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+         hops = atoi(argv[++i]);
+      else
+      {
+         bench_usage(argv[0]);
+         exit(1);
+      }
+   }
+   if (hops < 8 || hop < 16 || pitch < -12.0 || pitch > 12.0)
+   {
+      bench_usage(argv[0]);
+      exit(1);
+   }
+   printf("converter                    ns/hop  realtime     jump\n");
+   bench_quality(4 * hop, hop, pitch, hops, -1);
+   for (i = SRC_SINC_BEST_QUALITY; src_get_name(i) != NULL; ++i)
+      bench_quality(4 * hop, hop, pitch, hops, i);
+
+   return 0;
+}
+
+/*
+ * resample-bench.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,646 @@
+/* gWaoN -- gtk+ Spectra Analyzer : live input
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* the live window captures one JACK input and runs stages 1 and 2
+ * of waonc on it (see live.h).  three threads, which never wait on
+ * each other:
+ *
+ *   JACK process callback --(capture ring)--> analysis worker
+ *   analysis worker --(column ring)--> display timeout (LIVE_FPS)
+ *
+ * both rings are jack_ringbuffer_t, lock-free for one writer and one
+ * reader, and locked in memory.  the callback only copies samples,
+ * the worker allocates nothing after the start, and the display takes
+ * all the columns that are ready at each frame and scrolls them in.
+ */
+
+#include <gtk/gtk.h>
+#include <stdio.h> /* sprintf() */
+#include <stdlib.h> /* malloc(), free() */
+#include <string.h> /* memcpy() */
+#include <unistd.h> /* usleep() */
+#include <pthread.h> /* pthread_create(), pthread_join() */
+
+#include <jack/jack.h>
+#include <jack/ringbuffer.h> /* lock-free rings between the threads */
+
+#include "jack-client.h" /* waon_jack_open() */
+#include "live.h" /* live_create(), live_step() */
+#include "midi.h" /* midi_to_logf() */
+#include "parameters.h" /* parameters_initialize() */
+#include "spectrogram.h" /* spg_render_column(), spg_colormap() */
+
+#include "gwaon-live.h"
+#include "gwaon-wav.h" /* draw_keyboard() */
+#include "gtk-color.h" /* get_color() */
+#include "memory-check.h" /* CHECK_MALLOC() macro */
+
+
+/* samples between the process callback and the worker (JACK rounds
+ * it up to a power of two); at 48 kHz, 32768 samples are 0.68 sec,
+ * which fill up only while the worker stalls */
+#define LIVE_CAPTURE_RING (32768)
+
+/* columns between the worker and the display */
+#define LIVE_COLUMN_RING (256)
+
+/* the display rate [frames per sec] */
+#define LIVE_FPS (30)
+
+/* sleep of the worker while a hop is not captured yet [usec] */
+#define LIVE_WORKER_SLEEP (1000)
+
+/* the keyboard on the left, and the text line on the top [pixel] */
+#define LIVE_KEYBOARD (11)
+#define LIVE_TEXT (16)
+
+/* a column in the column ring; amp2 [nbin] and dphi [nbin] (float)
+ * and vel [128] follow */
+struct live_column
+{
+   jack_time_t t_capture;  /* the last sample of the frame came in [usec] */
+   jack_time_t t_analysed; /* the worker was done with the frame [usec] */
+};
+
+struct live_jack
+{
+   jack_client_t * client;
+   jack_port_t * in;
+   jack_nframes_t samplerate;
+   volatile int flag_exit;   /* 1 == the worker stops */
+   volatile int flag_server; /* 0 == the JACK server went away */
+
+   waon_live_t * live;
+   jack_ringbuffer_t * capture; /* samples, from the callback */
+   jack_ringbuffer_t * columns; /* struct live_column, from the worker */
+   size_t len_column; /* bytes of a column in the ring */
+   pthread_t worker;
+   int flag_worker; /* 1 == the worker was started */
+   float * hop;  /* [live->hop], of the worker */
+   char * column; /* [len_column], of the worker */
+
+   /* written by the process callback only */
+   volatile unsigned long frames_in; /* samples put in the capture ring */
+   volatile jack_time_t t_cycle;     /* the start of the last cycle */
+   volatile unsigned long n_overruns; /* cycles lost on a full ring */
+   /* written by the worker only */
+   volatile unsigned long n_dropped; /* columns lost on a full ring */
+
+   /* the display, in the main loop */
+   GtkWidget * window;
+   GtkWidget * area;
+   GdkPixmap * pixmap;
+   gint width, height;
+   gint tag; /* the timeout */
+   spg_render_t render;
+   char * shown; /* [len_column], the column being drawn */
+   double * amp2; /* [nbin] */
+   double * dphi;
+   int rows; /* height of the spectrogram, 1 to rows */
+   int cols; /* width of the spectrogram */
+   int head; /* the newest column of rgb, which is a ring of columns */
+   double * value; /* [rows + 1] */
+   guchar * rgb; /* [rows][cols][3] */
+   unsigned char palette [SPG_COLORS][3];
+   char vel [MIDI_NOTE_COUNT]; /* the notes of the newest column */
+   double ms_queue;   /* capture ring and analysis of the newest column */
+   jack_time_t t_analysed; /* the analysis of the newest column */
+};
+
+static struct live_jack * live_jack = NULL;
+
+
+/* the process callback, in the real-time thread of JACK: copy the
+ * input into the capture ring, or count the cycle lost if the worker
+ * is that far behind.  it neither allocates nor waits. */
+static int
+live_jack_process (jack_nframes_t nframes, void * arg)
+{
+   struct live_jack * lj = (struct live_jack *) arg;
+   const jack_default_audio_sample_t * in
+      = (const jack_default_audio_sample_t *)
+        jack_port_get_buffer (lj->in, nframes);
+   size_t len = sizeof (jack_default_audio_sample_t) * nframes;
+
+   if (jack_ringbuffer_write_space (lj->capture) < len)
+   {
+      lj->n_overruns ++;
+   }
+   else
+   {
+      jack_ringbuffer_write (lj->capture, (const char *) in, len);
+      lj->frames_in += nframes;
+   }
+   lj->t_cycle = jack_get_time ();
+   return 0;
+}
+
+static void
+live_jack_shutdown (void * arg)
+{
+   struct live_jack * lj = (struct live_jack *) arg;
+   lj->flag_server = 0;
+}
+
+/* the analysis worker: a hop at a time, analyse the frame and send
+ * its column to the display.  a column that finds the ring full is
+ * dropped rather than waited for.
+ * INPUT
+ *  arg : struct live_jack
+ */
+static void *
+live_jack_worker (void * arg)
+{
+   struct live_jack * lj = (struct live_jack *) arg;
+   waon_live_t * live = lj->live;
+   struct live_column * c = (struct live_column *) lj->column;
+   float * c_amp2 = (float *) (lj->column + sizeof (struct live_column));
+   float * c_dphi = c_amp2 + (live->fft_len / 2 + 1);
+   char * c_vel = (char *) (c_dphi + (live->fft_len / 2 + 1));
+   size_t len_hop = sizeof (float) * live->hop;
+   unsigned long frames_read = 0;
+   long behind;
+   long i;
+
+   while (lj->flag_exit == 0)
+   {
+      if (jack_ringbuffer_read_space (lj->capture) < len_hop)
+      {
+         usleep (LIVE_WORKER_SLEEP);
+         continue;
+      }
+      jack_ringbuffer_read (lj->capture, (char *) lj->hop, len_hop);
+      frames_read += live->hop;
+
+      live_step (live, lj->hop);
+
+      /* the last sample of the frame came in at the end of its cycle,
+       * which is as many samples before the last cycle as the samples
+       * still in the ring (frames_in may lag the ring by a cycle) */
+      behind = (long)(lj->frames_in - frames_read);
+      if (behind < 0) behind = 0;
+      c->t_capture = lj->t_cycle
+         - (jack_time_t)(1.0e6 * (double) behind / (double) lj->samplerate);
+      for (i = 0; i < live->fft_len / 2 + 1; i ++)
+      {
+         c_amp2 [i] = (float) live->amp2 [i];
+         c_dphi [i] = (float) live->dphi [i];
+      }
+      memcpy (c_vel, live->vel, MIDI_NOTE_COUNT);
+      c->t_analysed = jack_get_time ();
+
+      if (jack_ringbuffer_write_space (lj->columns) < lj->len_column)
+      {
+         lj->n_dropped ++;
+         continue;
+      }
+      jack_ringbuffer_write (lj->columns, lj->column, lj->len_column);
+   }
+   return NULL;
+}
+
+/* the view of the live window is the one of the wav window;
+ * the defaults of create_wav() if no file was opened
+ */
+static void
+live_view_get (spg_view_t * view)
+{
+   extern int oct_min;
+   extern int oct_max;
+   extern double logf_min;
+   extern double logf_max;
+   extern double amp2_min;
+   extern double amp2_max;
+   struct live_jack * lj = live_jack;
+
+   if (oct_max <= oct_min)
+   {
+      oct_min = 2;
+      oct_max = 6;
+      logf_min = midi_to_logf ((oct_min + 1) * 12);
+      logf_max = midi_to_logf ((oct_max + 1) * 12);
+   }
+   if (amp2_max <= amp2_min)
+   {
+      amp2_min = -3.0;
+      amp2_max = 1.0;
+   }
+   view->mode = lj->live->flag_phase ? SPG_MODE_PV_NOTES : SPG_MODE_POWER;
+   view->fft_len = lj->live->fft_len;
+   view->samplerate = (int) lj->samplerate;
+   view->logf_min = logf_min;
+   view->logf_max = logf_max;
+   view->amp2_min = amp2_min;
+   view->amp2_max = amp2_max;
+   view->octave_removal_factor = 0.0;
+}
+
+/* put the column in lj->shown at the head of the image, with a dot
+ * on the row of each detected note
+ */
+static void
+live_draw_column (struct live_jack * lj)
+{
+   extern double logf_min;
+   extern double logf_max;
+   struct live_column * c = (struct live_column *) lj->shown;
+   long nbin = lj->live->fft_len / 2 + 1;
+   const float * amp2 = (const float *) (lj->shown + sizeof (*c));
+   const float * dphi = amp2 + nbin;
+   const char * vel = (const char *) (dphi + nbin);
+   long i;
+   int k;
+
+   for (i = 0; i < nbin; i ++)
+   {
+      lj->amp2 [i] = (double) amp2 [i];
+      lj->dphi [i] = (double) dphi [i];
+   }
+   spg_render_column (&lj->render, lj->amp2, lj->dphi, lj->value);
+
+   lj->head = (lj->head + 1) % lj->cols;
+   for (k = 1; k <= lj->rows; k ++)
+   {
+      guchar * p
+         = lj->rgb + ((size_t)(lj->rows - k) * lj->cols + lj->head) * 3;
+      if (lj->value [k] < 0.0)
+      {
+         p [0] = p [1] = p [2] = 0; /* blank */
+      }
+      else
+      {
+         int ic = spg_color_index (&lj->render, lj->value [k]);
+         p [0] = lj->palette [ic][0];
+         p [1] = lj->palette [ic][1];
+         p [2] = lj->palette [ic][2];
+      }
+   }
+   for (i = 0; i < MIDI_NOTE_COUNT; i ++)
+   {
+      if (vel [i] > 0)
+      {
+         k = (int)((double) lj->rows * (midi_to_logf ((int) i) - logf_min)
+                   / (logf_max - logf_min));
+         if (k >= 1 && k <= lj->rows)
+         {
+            guchar * p
+               = lj->rgb + ((size_t)(lj->rows - k) * lj->cols + lj->head) * 3;
+            p [0] = p [1] = p [2] = 255; /* white */
+         }
+      }
+   }
+
+   memcpy (lj->vel, vel, MIDI_NOTE_COUNT);
+   lj->ms_queue = 1.0e-3 * (double)(c->t_analysed - c->t_capture);
+   lj->t_analysed = c->t_analysed;
+}
+
+/* the latency budget of the newest column, from the sound at the
+ * middle of its frame to the screen:
+ *   capture : the latency of the JACK input (and its period)
+ *   frame   : half the FFT frame
+ *   queue   : the capture ring and the analysis
+ *   display : the column ring and the frame rate
+ */
+static void
+live_draw_text (struct live_jack * lj, GdkGC * gc)
+{
+   jack_latency_range_t range;
+   double ms_capture;
+   double ms_display = 1.0e-3 * (double)(jack_get_time () - lj->t_analysed);
+   double ms_frame
+      = 1.0e3 * 0.5 * (double) lj->live->fft_len / (double) lj->samplerate;
+   gchar string [256];
+   PangoLayout * layout;
+
+   jack_port_get_latency_range (lj->in, JackCaptureLatency, &range);
+   ms_capture = 1.0e3 * (double)(range.max + jack_get_buffer_size (lj->client))
+                / (double) lj->samplerate;
+   if (lj->flag_server == 0)
+   {
+      sprintf (string, "the JACK server is gone");
+   }
+   else
+   {
+      sprintf (string,
+               "latency %.1f ms = capture %.1f + frame %.1f"
+               " + queue %.1f + display %.1f   "
+               "(N = %ld, H = %ld, overruns %lu, dropped %lu)",
+               ms_capture + ms_frame + lj->ms_queue + ms_display,
+               ms_capture, ms_frame, lj->ms_queue, ms_display,
+               lj->live->fft_len, lj->live->hop,
+               lj->n_overruns, lj->n_dropped);
+   }
+
+   get_color (lj->area, 0, 0, 0, gc); /* black */
+   gdk_draw_rectangle (lj->pixmap, gc, TRUE, /* fill */
+                       0, 0, lj->width, LIVE_TEXT);
+   layout = gtk_widget_create_pango_layout (lj->area, string);
+   get_color (lj->area, 255, 255, 255, gc); /* white */
+   gdk_draw_layout (lj->pixmap, gc, 2, 0, layout);
+   g_object_unref (layout);
+}
+
+/* put the ring of columns on the pixmap, the oldest on the left */
+static void
+live_draw_image (struct live_jack * lj, GdkGC * gc)
+{
+   int n_old = lj->cols - 1 - lj->head; /* columns right of the head */
+
+   if (n_old > 0)
+   {
+      gdk_draw_rgb_image (lj->pixmap, gc,
+                          LIVE_KEYBOARD, LIVE_TEXT, n_old, lj->rows,
+                          GDK_RGB_DITHER_NONE,
+                          lj->rgb + (lj->head + 1) * 3, lj->cols * 3);
+   }
+   gdk_draw_rgb_image (lj->pixmap, gc,
+                       LIVE_KEYBOARD + n_old, LIVE_TEXT,
+                       lj->head + 1, lj->rows,
+                       GDK_RGB_DITHER_NONE,
+                       lj->rgb, lj->cols * 3);
+}
+
+/* the display timeout: scroll in the columns that are ready, and
+ * redraw the keyboard and the latency
+ */
+static gboolean
+live_tick (gpointer data)
+{
+   struct live_jack * lj = (struct live_jack *) data;
+   spg_view_t view;
+   size_t n;
+   GdkGC * gc;
+
+   if (lj->pixmap == NULL || lj->rows <= 0 || lj->cols <= 0)
+   {
+      return TRUE;
+   }
+
+   live_view_get (&view);
+   spg_render_set (&lj->render, &view, lj->rows, TRUE);
+
+   /* the columns that would scroll out at once are skipped */
+   n = jack_ringbuffer_read_space (lj->columns) / lj->len_column;
+   for (; n > (size_t) lj->cols; n --)
+   {
+      jack_ringbuffer_read (lj->columns, lj->shown, lj->len_column);
+   }
+   for (; n > 0; n --)
+   {
+      jack_ringbuffer_read (lj->columns, lj->shown, lj->len_column);
+      live_draw_column (lj);
+   }
+
+   gc = gdk_gc_new (lj->area->window);
+   live_draw_image (lj, gc);
+   draw_keyboard (lj->area, gc, lj->pixmap,
+                  LIVE_TEXT + lj->rows, lj->rows, lj->vel);
+   live_draw_text (lj, gc);
+   g_object_unref (gc);
+
+   gdk_draw_drawable (lj->area->window,
+                      lj->area->style->fg_gc [GTK_WIDGET_STATE (lj->area)],
+                      lj->pixmap,
+                      0, 0, 0, 0, lj->width, lj->height);
+   return TRUE;
+}
+
+static gboolean
+live_configure_event (GtkWidget * widget, GdkEventConfigure * event)
+{
+   struct live_jack * lj = live_jack;
+
+   if (lj->pixmap)
+   {
+      g_object_unref (lj->pixmap);
+   }
+   lj->width  = widget->allocation.width;
+   lj->height = widget->allocation.height;
+   lj->pixmap = gdk_pixmap_new (widget->window, lj->width, lj->height, -1);
+
+   /* a new size starts the spectrogram afresh */
+   lj->cols = lj->width - LIVE_KEYBOARD;
+   lj->rows = lj->height - LIVE_TEXT;
+   if (lj->cols < 1) lj->cols = 1;
+   if (lj->rows < 1) lj->rows = 1;
+   lj->head = lj->cols - 1;
+   free (lj->rgb);
+   free (lj->value);
+   lj->rgb = (guchar *) calloc ((size_t) lj->cols * lj->rows * 3,
+                                sizeof (guchar));
+   lj->value = (double *) malloc (sizeof (double) * (lj->rows + 1));
+   CHECK_MALLOC (lj->rgb, "live_configure_event");
+   CHECK_MALLOC (lj->value, "live_configure_event");
+
+   gdk_draw_rectangle (lj->pixmap, widget->style->black_gc, TRUE,
+                       0, 0, lj->width, lj->height);
+   return TRUE;
+}
+
+static gboolean
+live_expose_event (GtkWidget * widget, GdkEventExpose * event)
+{
+   gdk_draw_drawable (widget->window,
+                      widget->style->fg_gc [GTK_WIDGET_STATE (widget)],
+                      live_jack->pixmap,
+                      event->area.x, event->area.y,
+                      event->area.x, event->area.y,
+                      event->area.width, event->area.height);
+   return FALSE;
+}
+
+/* stop the threads, in the order of the data, and free everything */
+static void
+live_jack_free (struct live_jack * lj)
+{
+   if (lj->tag != 0)
+   {
+      g_source_remove (lj->tag);
+   }
+   if (lj->client != NULL)
+   {
+      jack_client_close (lj->client); /* no more callbacks */
+   }
+   if (lj->flag_worker)
+   {
+      lj->flag_exit = 1;
+      pthread_join (lj->worker, NULL);
+   }
+   if (lj->capture != NULL)
+   {
+      jack_ringbuffer_free (lj->capture);
+   }
+   if (lj->columns != NULL)
+   {
+      jack_ringbuffer_free (lj->columns);
+   }
+   live_free (lj->live);
+   spg_render_free (&lj->render);
+   if (lj->pixmap != NULL)
+   {
+      g_object_unref (lj->pixmap);
+   }
+   free (lj->hop);
+   free (lj->column);
+   free (lj->shown);
+   free (lj->amp2);
+   free (lj->dphi);
+   free (lj->value);
+   free (lj->rgb);
+   free (lj);
+}
+
+static gint
+live_delete (GtkWidget * widget, GdkEvent * event, gpointer data)
+{
+   if (live_jack != NULL)
+   {
+      live_jack_free (live_jack);
+      live_jack = NULL;
+   }
+   return FALSE;
+}
+
+/* start the JACK client and the worker; NULL if JACK cannot be used
+ */
+static struct live_jack *
+live_jack_init (void)
+{
+   waon_parameters_t parameters;
+   analysis_scratchpad_t scratchpad;
+   struct live_jack * lj
+      = (struct live_jack *) calloc (1, sizeof (struct live_jack));
+   long nbin;
+
+   CHECK_MALLOC (lj, "live_jack_init");
+   lj->flag_server = 1;
+   spg_render_init (&lj->render);
+
+   lj->client = waon_jack_open ("gwaonc");
+   if (lj->client == NULL)
+   {
+      live_jack_free (lj);
+      return NULL;
+   }
+   lj->samplerate = jack_get_sample_rate (lj->client);
+
+   /* stages 1 and 2 with the defaults of waonc */
+   parameters_initialize (&parameters);
+   analysis_scratchpad_initialize (&scratchpad);
+   scratchpad.absolute_cutoff = parameters.abs_flg;
+   scratchpad.adj_pitch = parameters.adj_pitch;
+   lj->live = live_create (&parameters, &scratchpad, (int) lj->samplerate);
+   parameters_free (&parameters);
+
+   nbin = lj->live->fft_len / 2 + 1;
+   lj->len_column = sizeof (struct live_column)
+                    + sizeof (float) * 2 * nbin + MIDI_NOTE_COUNT;
+   lj->hop = (float *) malloc (sizeof (float) * lj->live->hop);
+   lj->column = (char *) malloc (lj->len_column);
+   lj->shown = (char *) malloc (lj->len_column);
+   lj->amp2 = (double *) malloc (sizeof (double) * nbin);
+   lj->dphi = (double *) malloc (sizeof (double) * nbin);
+   CHECK_MALLOC (lj->hop, "live_jack_init");
+   CHECK_MALLOC (lj->column, "live_jack_init");
+   CHECK_MALLOC (lj->shown, "live_jack_init");
+   CHECK_MALLOC (lj->amp2, "live_jack_init");
+   CHECK_MALLOC (lj->dphi, "live_jack_init");
+
+   spg_colormap (lj->palette);
+
+   /* the rings, locked in memory, and the worker to read the first,
+    * before the process callback starts */
+   lj->capture = jack_ringbuffer_create
+                 (sizeof (jack_default_audio_sample_t) * LIVE_CAPTURE_RING);
+   lj->columns = jack_ringbuffer_create (lj->len_column * LIVE_COLUMN_RING);
+   CHECK_MALLOC (lj->capture, "live_jack_init");
+   CHECK_MALLOC (lj->columns, "live_jack_init");
+   jack_ringbuffer_mlock (lj->capture);
+   jack_ringbuffer_mlock (lj->columns);
+   if (pthread_create (&lj->worker, NULL, live_jack_worker, lj) != 0)
+   {
+      fprintf (stderr, "cannot start the worker thread\n");
+      live_jack_free (lj);
+      return NULL;
+   }
+   lj->flag_worker = 1;
+
+   jack_set_process_callback (lj->client, live_jack_process, lj);
+   jack_on_shutdown (lj->client, live_jack_shutdown, lj);
+   lj->in = jack_port_register (lj->client, "input",
+                                JACK_DEFAULT_AUDIO_TYPE,
+                                JackPortIsInput, 0);
+   if (lj->in == NULL)
+   {
+      fprintf (stderr, "no more JACK ports available\n");
+      live_jack_free (lj);
+      return NULL;
+   }
+   if (jack_activate (lj->client))
+   {
+      fprintf (stderr, "cannot activate client\n");
+      live_jack_free (lj);
+      return NULL;
+   }
+   waon_jack_connect_physical (lj->client, lj->in, 0);
+   g_print ("live input: %u Hz, N = %ld, H = %ld\n",
+            (unsigned) lj->samplerate, lj->live->fft_len, lj->live->hop);
+   return lj;
+}
+
+void
+create_live (void)
+{
+   struct live_jack * lj;
+   GtkWidget * area;
+
+   if (live_jack != NULL)
+   {
+      gtk_window_present (GTK_WINDOW (live_jack->window));
+      return;
+   }
+   lj = live_jack_init ();
+   if (lj == NULL)
+   {
+      g_print ("the live input needs a JACK server\n");
+      return;
+   }
+   live_jack = lj;
+
+   lj->window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+   gtk_window_set_title (GTK_WINDOW (lj->window), "gWaoN live");
+   gtk_widget_set_size_request (GTK_WIDGET (lj->window), 800, 400);
+   gtk_signal_connect (GTK_OBJECT (lj->window), "destroy",
+                       GTK_SIGNAL_FUNC (gtk_widget_destroy),
+                       GTK_OBJECT (lj->window));
+   gtk_signal_connect (GTK_OBJECT (lj->window), "delete_event",
+                       GTK_SIGNAL_FUNC (live_delete), NULL);
+
+   area = gtk_drawing_area_new ();
+   lj->area = area;
+   gtk_container_add (GTK_CONTAINER (lj->window), area);
+   gtk_widget_set_events (area, GDK_EXPOSURE_MASK);
+   gtk_signal_connect (GTK_OBJECT (area), "expose_event",
+                       (GtkSignalFunc) live_expose_event, NULL);
+   gtk_signal_connect (GTK_OBJECT (area), "configure_event",
+                       (GtkSignalFunc) live_configure_event, NULL);
+   gtk_widget_show (area);
+   gtk_widget_show (lj->window);
+
+   lj->tag = g_timeout_add (1000 / LIVE_FPS, live_tick, lj);
+}
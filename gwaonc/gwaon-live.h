@@ -0,0 +1,28 @@
+#ifndef	_GWAON_LIVE_H_
+#define	_GWAON_LIVE_H_
+
+/* header file for gwaon-live.c --
+ * gWaoN -- gtk+ Spectra Analyzer : live input
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* open the live window, which captures from JACK and scrolls the
+ * spectrogram and the detected notes (one live window at a time) */
+
+void create_live (void);
+
+
+#endif /* !_GWAON_LIVE_H_ */
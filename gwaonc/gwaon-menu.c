@@ -22,7 +22,9 @@
 #include <sndfile.h>
 
 #include "gwaon-about.h" /* create_about() */
+#include "gwaon-live.h" /* create_live() */
 #include "gwaon-wav.h" /* create_wav() */
+#include "spec-cache.h" /* spec_cache_open() */
 
 
 static void
@@ -42,12 +44,16 @@ on_file_open_wav_sel_ok (GtkWidget * widget, GtkFileSelection * fs)
 {
    extern SNDFILE * sf;
    extern SF_INFO sfinfo;
+   extern waon_spec_cache_t * spec_cache;
 
    gchar * filename =
       (gchar *) gtk_file_selection_get_filename (GTK_FILE_SELECTION (fs));
    g_print ("%s\n", filename);
 
 
+   // stop the spectrogram workers, which read the file and the cache
+   spg_tiles_stop ();
+
    // close sf first, if sf is open
    if (sf != NULL)
    {
@@ -67,7 +73,35 @@ on_file_open_wav_sel_ok (GtkWidget * widget, GtkFileSelection * fs)
    g_print ("samplerate = %d\n", sfinfo.samplerate);
    g_print ("frames = %d\n", (int)sfinfo.frames);
 
-   create_wav ();
+   /* the spectral cache written by "waonc --spec-cache", if any */
+   spec_cache_close (spec_cache);
+   spec_cache = NULL;
+   {
+      gchar * name = g_strconcat (filename, SPEC_CACHE_EXTENSION, NULL);
+      spec_cache = spec_cache_open (name, NULL);
+      if (spec_cache != NULL)
+      {
+         waon_spec_header_t key;
+         spec_cache_key (&key, filename,
+                         spec_cache->header.fft_len, 0,
+                         spec_cache->header.flag_window,
+                         sfinfo.samplerate, sfinfo.channels,
+                         (long)sfinfo.frames, 0);
+         if (! spec_cache_matches (spec_cache, &key))
+         {
+            spec_cache_close (spec_cache);
+            spec_cache = NULL;
+         }
+         else
+         {
+            g_print ("spectral cache %s (N = %d)\n",
+                     name, spec_cache->header.fft_len);
+         }
+      }
+      g_free (name);
+   }
+
+   create_wav (filename);
 
    gtk_widget_destroy (GTK_WIDGET (fs));
 }
@@ -100,11 +134,25 @@ on_file_open_wav (GtkWidget * widget, gpointer data)
    gtk_widget_show(filew);
 }
 
+static void
+on_file_live (GtkWidget * widget, gpointer data)
+{
+   create_live ();
+}
+
 void
 create_menu (void)
 {
+   GtkWidget * window;
+   GtkTooltips * tooltips;
+   GtkAccelGroup * accel_group;
+   GtkWidget * vbox;
+   GtkWidget * menubar;
+   GtkWidget * menuitem;
+   GtkWidget * menu;
+
    // create a new window
-   GtkWidget * window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+   window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
 
    /*gtk_widget_set_usize( GTK_WIDGET (window), 200, 100);*/
    gtk_widget_set_uposition (window, 200, 100);
@@ -125,26 +173,26 @@ create_menu (void)
    gtk_window_set_title(GTK_WINDOW (window), "gWaoN");
    gtk_container_border_width (GTK_CONTAINER (window), 0);
 
-   GtkTooltips * tooltips = gtk_tooltips_new ();
-   GtkAccelGroup * accel_group = gtk_accel_group_new ();
+   tooltips = gtk_tooltips_new ();
+   accel_group = gtk_accel_group_new ();
 
 
-   GtkWidget * vbox = gtk_vbox_new (FALSE, 0);
+   vbox = gtk_vbox_new (FALSE, 0);
    gtk_container_add (GTK_CONTAINER (window), vbox);
    gtk_widget_show (vbox);
 
 
    /* create menu bar */
-   GtkWidget * menubar = gtk_menu_bar_new ();
+   menubar = gtk_menu_bar_new ();
    gtk_box_pack_start (GTK_BOX (vbox), menubar, FALSE, TRUE, 0);
    gtk_widget_show (menubar);
 
    /* create File menu */
-   GtkWidget * menuitem = gtk_menu_item_new_with_label ("File");
+   menuitem = gtk_menu_item_new_with_label ("File");
    gtk_menu_bar_append (GTK_MENU_BAR (menubar), menuitem);
    gtk_widget_show (menuitem);
 
-   GtkWidget * menu = gtk_menu_new ();
+   menu = gtk_menu_new ();
    gtk_menu_item_set_submenu (GTK_MENU_ITEM (menuitem), menu);
 
    /* File -> Open WAV */
@@ -158,6 +206,15 @@ create_menu (void)
                          "Open an existing project", NULL);
    gtk_widget_show (menuitem);
 
+   /* File -> Live input */
+   menuitem = gtk_menu_item_new_with_label ("Live input (JACK)");
+   gtk_signal_connect (GTK_OBJECT (menuitem), "activate",
+                       GTK_SIGNAL_FUNC (on_file_live), NULL);
+   gtk_menu_append (GTK_MENU (menu), menuitem);
+   gtk_tooltips_set_tip (tooltips, menuitem,
+                         "Analyse the input of a JACK port", NULL);
+   gtk_widget_show (menuitem);
+
    /* --separator-- */
    menuitem = gtk_menu_item_new ();
    gtk_menu_append (GTK_MENU (menu), menuitem);
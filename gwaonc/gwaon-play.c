@@ -31,6 +31,7 @@
 /* global variables */
 
 ao_device * ao = NULL;
+ao_queue_t * aoq = NULL; /* output thread of ao, if it could start */
 
 long play_cur; /* current frame to play */
 int flag_play; /* status: 0 = not playing, 1 = playing */
@@ -46,23 +47,26 @@ double pv_pitch; /* pitch-shift */
 struct pv_complex * pv = NULL; /* initialized in create_wav() */
 
 
-/* play 100 milisecond and return */
+/* play 100 milisecond and return
+ * (with the output queue, play until the queue is full, so that
+ * the main loop never waits for the device)
+ */
 gint
 play_100msec (gpointer data)
 {
    extern struct pv_complex * pv;
    extern long play_cur;
-
-   long len_100msec = (long)(0.1 /* sec */ * pv->sfinfo->samplerate /* Hz */);
-
-   draw_play_indicator ((GtkWidget *)data); /* draw indicator */
-
    extern int WIN_wav_cur;
    extern int WIN_wav_scale;
    extern int WIN_wav_width;
+
+   long len_100msec = (long)(0.1 /* sec */ * pv->sfinfo->samplerate /* Hz */);
    long l;
    long frame0 = (long) WIN_wav_cur;
    long frame1 = frame0 + (long)(WIN_wav_scale * WIN_wav_width) - 1;
+
+   draw_play_indicator ((GtkWidget *)data); /* draw indicator */
+
    if (frame1 >= pv->sfinfo->frames)
       frame1 = (long)pv->sfinfo->frames - 1;
 
@@ -72,9 +76,14 @@ play_100msec (gpointer data)
    if (play_cur >= frame1)
       play_cur = frame1;
 
-   for (l = 0; l < len_100msec; l += pv->hop_syn)
+   for (l = 0; pv->aoq != NULL || l < len_100msec; l += pv->hop_syn)
    {
-      long len_play = pv_complex_play_step (pv, play_cur);
+      long len_play;
+      if (pv_complex_play_ready (pv) == 0)
+      {
+         break; /* the queue is full */
+      }
+      len_play = pv_complex_play_step (pv, play_cur);
       if (len_play < pv->hop_res)
       {
          flag_play = 0; // stop playing
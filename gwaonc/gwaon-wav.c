@@ -26,10 +26,15 @@
 
 #include <sndfile.h> /* libsndfile */
 #include "snd.h" /* sndfile_read_at() */
+#include "snd-cache.h" /* snd_cache_read_at() */
+#include "peaks.h" /* peaks_range() */
 
 #include <fftw3.h> /* FFTW library */
 #include "hc.h"
-#include "fft.h" /* hanning() */
+#include "fft.h" /* hanning(), windowed_FFT_stereo() */
+#include "spec-cache.h" /* waon_spec_cache_t */
+#include "spec-tiles.h" /* spec_tiles_column() */
+#include "spectrogram.h" /* spg_frame_one(), spg_render_column() */
 #include "midi.h" /* midi_to_freq(), etc. */
 
 #include "gwaon-play.h" /* play_1msec() */
@@ -62,11 +67,16 @@ int WIN_spec_n;
 int WIN_spec_hop_scale;
 int WIN_spec_hop;
 int WIN_spec_mode;
-double * spec_in  = NULL;
-double * spec_out = NULL;
-double * spec_left  = NULL;
-double * spec_right = NULL;
-fftw_plan plan;
+spg_frame_t * spec_frame = NULL; /* plans and buffers of the spectrum panel */
+waon_spec_cache_t * spec_cache = NULL; /* "<wav>.waonspec", if it matches */
+spec_tiles_t * spec_tiles = NULL; /* columns of the spectrogram */
+snd_cache_t * snd_cache = NULL; /* decoded samples of the open file */
+waon_peaks_t * wav_peaks = NULL; /* min/max/RMS pyramid of the samples */
+
+/* the peak pyramid of a file this long (in frames) is kept in
+ * "<wav>.waonpeak"; a shorter one is built again quicker than it is read
+ */
+#define WAV_PEAKS_SAVE_FRAMES (1L << 24)
 
 int flag_window;
 double amp2_min, amp2_max;
@@ -83,6 +93,87 @@ gint colormap_power_b[256];
 double octave_removal_factor = 0.0;
 
 
+/* read len frames from start on, from the decoded samples if they are
+ * held, else from the file
+ */
+static void
+wav_read_at (long start, double * left, double * right, int len)
+{
+   extern SNDFILE * sf;
+   extern SF_INFO sfinfo;
+   extern snd_cache_t * snd_cache;
+
+   if (snd_cache != NULL)
+   {
+      snd_cache_read_at (snd_cache, start, left, right, len);
+   }
+   else
+   {
+      sndfile_read_at (sf, sfinfo, start, left, right, len);
+   }
+}
+
+
+/* draw wave panel from the peak pyramid, so that the time does not
+ * depend on WIN_wav_scale; the RMS band is drawn darker
+ * INPUT
+ *  i0, i1 : the range to draw in the display (pixel)
+ */
+static void
+draw_wav_peaks (GtkWidget * widget,
+                GdkGC * gc,
+                int bottom_wav, int height_wav,
+                int i0, int i1)
+{
+   extern GdkPixmap * wav_pixmap;
+   extern int WIN_wav_cur;
+   extern waon_peaks_t * wav_peaks;
+   /* left in red, right in green */
+   static const int color [2][3] = {{255, 0, 0}, {0, 255, 0}};
+   double min [2], max [2], rms [2];
+   int iy_t [2], iy_b [2], iy_t0 [2] = {0, 0}, iy_b0 [2] = {0, 0};
+   int i, k;
+
+   for (i = i0; i < i1; i ++)
+   {
+      peaks_range (wav_peaks, (long)WIN_wav_cur + (long)i * WIN_wav_scale,
+                   WIN_wav_scale, min, max, rms);
+      for (k = 0; k < 2; k ++)
+      {
+         double lo = (-rms [k] > min [k]) ? -rms [k] : min [k];
+         double hi = ( rms [k] < max [k]) ?  rms [k] : max [k];
+         /* vertical axis is directing down on the window */
+         iy_t [k] = bottom_wav
+                    - (int)((double)height_wav * (min [k] + 1.0) / 2.0);
+         iy_b [k] = bottom_wav
+                    - (int)((double)height_wav * (max [k] + 1.0) / 2.0);
+
+         get_color (widget, color [k][0], color [k][1], color [k][2], gc);
+         gdk_draw_line (wav_pixmap, gc, i, iy_b [k], i, iy_t [k]);
+         if (i > i0)
+         {
+            gdk_draw_line (wav_pixmap, gc, i - 1, iy_t0 [k], i, iy_t [k]);
+            gdk_draw_line (wav_pixmap, gc, i - 1, iy_b0 [k], i, iy_b [k]);
+         }
+         iy_t0 [k] = iy_t [k];
+         iy_b0 [k] = iy_b [k];
+
+         if (lo < hi)
+         {
+            /* XOR with the half color leaves the half color */
+            get_color (widget, color [k][0] / 2, color [k][1] / 2,
+                       color [k][2] / 2, gc);
+            gdk_draw_line (wav_pixmap, gc,
+                           i, bottom_wav
+                              - (int)((double)height_wav * (hi + 1.0) / 2.0),
+                           i, bottom_wav
+                              - (int)((double)height_wav * (lo + 1.0) / 2.0));
+         }
+      }
+   }
+}
+
+
 /* draw wave panel
  * INPUT
  *  i0, i1 : the range to draw in the display (pixel)
@@ -96,9 +187,10 @@ draw_wav_frame (GtkWidget * widget,
    extern GdkPixmap * wav_pixmap;
    extern int WIN_wav_cur;
    extern SNDFILE * sf;
-   extern SF_INFO sfinfo;
+   extern waon_peaks_t * wav_peaks;
 
    int i, j, k;
+   GdkGCValues backup_gc_values;
 
 
    /* clear image first */
@@ -108,7 +200,6 @@ draw_wav_frame (GtkWidget * widget,
                        i1, height_wav);
 
    /* backup GdkFunction */
-   GdkGCValues backup_gc_values;
    gdk_gc_get_values (gc, &backup_gc_values);
 
    /* set GC wiht XOR function */
@@ -129,7 +220,14 @@ draw_wav_frame (GtkWidget * widget,
 
 
    /* the following is the dynamic */
-   if (sf != NULL)
+   if (sf != NULL && wav_peaks != NULL)
+   {
+      draw_wav_peaks (widget, gc, bottom_wav, height_wav, i0, i1);
+
+      /* recover GC's function */
+      gdk_gc_set_function (gc, backup_gc_values.function);
+   }
+   else if (sf != NULL)
    {
       int len = 10000;
       double * left  = (double *)malloc (sizeof (double) * len);
@@ -148,7 +246,7 @@ draw_wav_frame (GtkWidget * widget,
       {
          left [i] = right [i] = 0.0;
       }
-      sndfile_read_at (sf, sfinfo, cur_read, left, right, len);
+      wav_read_at (cur_read, left, right, len);
 
       for (i = i0; i < i1; i ++)
       {
@@ -170,7 +268,7 @@ draw_wav_frame (GtkWidget * widget,
             /* read next frame */
             cur_read += iarray;
             for (k = 0; k < len; k ++) left [k] = right [k] = 0.0;
-            sndfile_read_at (sf, sfinfo, cur_read, left, right, len);
+            wav_read_at (cur_read, left, right, len);
             /* reset iarray */
             iarray = 0;
          }
@@ -197,7 +295,7 @@ draw_wav_frame (GtkWidget * widget,
                /* read next frame */
                cur_read += iarray;
                for (k = 0; k < len; k ++) left [k] = right [k] = 0.0;
-               sndfile_read_at (sf, sfinfo, cur_read, left, right, len);
+               wav_read_at (cur_read, left, right, len);
                /* reset iarray */
                iarray = 0;
             }
@@ -245,20 +343,6 @@ logf_to_display (double logf, int resolution)
    return (ix);
 }
 
-/*
- * OUTPUT (returnd value)
- *  ix : ranges from 0 to resolution for x = logf_min to logf_max
- */
-static double
-display_to_logf (int ix, int resolution)
-{
-   extern double logf_min;
-   extern double logf_max;
-   double logf = logf_min
-                 + ((double)ix + 0.5) * (logf_max - logf_min) / (double)resolution;
-   return (logf);
-}
-
 /* return the bottom position on the display for the midi note
  * OUTPUT (returnd value)
  *  ix : ranges from 0 to resolution for x = logf_min to logf_max
@@ -283,13 +367,15 @@ midi_to_display_top (int midi, int res)
 }
 
 /* draw vertical keyboard between (bottom - height) to bottom
+ * on pixmap; the notes of vel [128] (if not NULL) are lit by velocity
  */
-static void
+void
 draw_keyboard (GtkWidget * widget,
                GdkGC * gc,
-               int bottom, int height)
+               GdkPixmap * pixmap,
+               int bottom, int height,
+               const char * vel)
 {
-   extern GdkPixmap * wav_pixmap;
    extern int oct_min;
    extern int oct_max;
    extern double logf_min;
@@ -301,14 +387,14 @@ draw_keyboard (GtkWidget * widget,
    int idx = (int)((double)height / (double)(oct_max - oct_min) / 12.0);
 
    get_color (widget, 255, 255, 255, gc); /* white */
-   gdk_draw_rectangle (wav_pixmap, gc, TRUE, /* fill */
+   gdk_draw_rectangle (pixmap, gc, TRUE, /* fill */
                        0, bottom - height,
                        10, height);
    get_color (widget, 0, 0, 0, gc); /* black */
-   gdk_draw_line (wav_pixmap, gc,
+   gdk_draw_line (pixmap, gc,
                   0, bottom - height,
                   0, bottom);
-   gdk_draw_line (wav_pixmap, gc,
+   gdk_draw_line (pixmap, gc,
                   10, bottom - height,
                   10, bottom);
 
@@ -317,31 +403,31 @@ draw_keyboard (GtkWidget * widget,
       /* C# (Db) */
       j = 1;
       ix = bottom - midi_to_display_top ((i + 1) * 12 + j, height);
-      gdk_draw_rectangle (wav_pixmap, gc, TRUE, /* fill */
+      gdk_draw_rectangle (pixmap, gc, TRUE, /* fill */
                           0, ix,
                           6, idx);
       /* D# (Eb) */
       j = 3;
       ix = bottom - midi_to_display_top ((i + 1) * 12 + j, height);
-      gdk_draw_rectangle (wav_pixmap, gc, TRUE, /* fill */
+      gdk_draw_rectangle (pixmap, gc, TRUE, /* fill */
                           0, ix,
                           6, idx);
       /* F# (Gb) */
       j = 6;
       ix = bottom - midi_to_display_top ((i + 1) * 12 + j, height);
-      gdk_draw_rectangle (wav_pixmap, gc, TRUE, /* fill */
+      gdk_draw_rectangle (pixmap, gc, TRUE, /* fill */
                           0, ix,
                           6, idx);
       /* G# (Ab) */
       j = 8;
       ix = bottom - midi_to_display_top ((i + 1) * 12 + j, height);
-      gdk_draw_rectangle (wav_pixmap, gc, TRUE, /* fill */
+      gdk_draw_rectangle (pixmap, gc, TRUE, /* fill */
                           0, ix,
                           6, idx);
       /* A# (Bb) */
       j = 10;
       ix = bottom - midi_to_display_top ((i + 1) * 12 + j, height);
-      gdk_draw_rectangle (wav_pixmap, gc, TRUE, /* fill */
+      gdk_draw_rectangle (pixmap, gc, TRUE, /* fill */
                           0, ix,
                           6, idx);
 
@@ -350,7 +436,7 @@ draw_keyboard (GtkWidget * widget,
       x = midi_to_logf ((i + 1) * 12 + j);
       ix = bottom
            - (int)((double)height * (x - logf_min) / (logf_max - logf_min));
-      gdk_draw_line (wav_pixmap, gc,
+      gdk_draw_line (pixmap, gc,
                      0, ix,
                      9, ix);
       /* on the black key of D# */
@@ -358,7 +444,7 @@ draw_keyboard (GtkWidget * widget,
       x = midi_to_logf ((i + 1) * 12 + j);
       ix = bottom
            - (int)((double)height * (x - logf_min) / (logf_max - logf_min));
-      gdk_draw_line (wav_pixmap, gc,
+      gdk_draw_line (pixmap, gc,
                      0, ix,
                      9, ix);
       /* on the black key of F# */
@@ -366,7 +452,7 @@ draw_keyboard (GtkWidget * widget,
       x = midi_to_logf ((i + 1) * 12 + j);
       ix = bottom
            - (int)((double)height * (x - logf_min) / (logf_max - logf_min));
-      gdk_draw_line (wav_pixmap, gc,
+      gdk_draw_line (pixmap, gc,
                      0, ix,
                      9, ix);
       /* on the black key of G# */
@@ -374,7 +460,7 @@ draw_keyboard (GtkWidget * widget,
       x = midi_to_logf ((i + 1) * 12 + j);
       ix = bottom
            - (int)((double)height * (x - logf_min) / (logf_max - logf_min));
-      gdk_draw_line (wav_pixmap, gc,
+      gdk_draw_line (pixmap, gc,
                      0, ix,
                      9, ix);
       /* on the black key of A# */
@@ -382,22 +468,42 @@ draw_keyboard (GtkWidget * widget,
       x = midi_to_logf ((i + 1) * 12 + j);
       ix = bottom
            - (int)((double)height * (x - logf_min) / (logf_max - logf_min));
-      gdk_draw_line (wav_pixmap, gc,
+      gdk_draw_line (pixmap, gc,
                      0, ix,
                      9, ix);
       /* between E and F */
       j = 4;
       ix = bottom - midi_to_display_top ((i + 1) * 12 + j, height);
-      gdk_draw_line (wav_pixmap, gc,
+      gdk_draw_line (pixmap, gc,
                      0, ix,
                      9, ix);
       /* between B and C */
       j = 11;
       ix = bottom - midi_to_display_top ((i + 1) * 12 + j, height);
-      gdk_draw_line (wav_pixmap, gc,
+      gdk_draw_line (pixmap, gc,
                      0, ix,
                      9, ix);
    }
+
+   if (vel == NULL)
+   {
+      return;
+   }
+   for (i = (oct_min + 1) * 12; i < (oct_max + 1) * 12; i ++)
+   {
+      int iy0, iy1;
+      if (vel [i] <= 0)
+      {
+         continue;
+      }
+      /* yellow for soft, red for loud */
+      get_color (widget, 255, 255 - 2 * vel [i], 0, gc);
+      iy0 = bottom - midi_to_display_top (i, height);
+      iy1 = bottom - midi_to_display_bottom (i, height);
+      gdk_draw_rectangle (pixmap, gc, TRUE, /* fill */
+                          1, iy0,
+                          9, (iy1 > iy0) ? iy1 - iy0 : 1);
+   }
 }
 
 /* draw horizontal keyboard at y = bottom for 10 pixels
@@ -661,199 +767,121 @@ void draw_infos (GtkWidget * widget,
               r, g, b, drop, rd, gd, bd, font);
 }
 
-/*
- * INPUT
- *  i : starting frame to analyse
- *  r_amp2 : if NULL is given, l+r are returned in l_amp2 (and l_ph)
- *  ph : if NULL is given, just l_amp2 (and r_amp2) is calculated.
- * OUTPUT
- *  l_amp2, r_amp2 : amp^2 scaled by WIN_spec_n.
- *  l_ph, r_ph   : phase if ph is not NULL
- */
+/* the view of the spectrogram engine for the current settings */
 static void
-fft_one_frame (int i,
-               double * l_amp2, double * r_amp2,
-               double * l_ph,   double * r_ph)
+spg_view_get (spg_view_t * view)
 {
-   extern SNDFILE * sf;
-   extern SF_INFO sfinfo;
    extern int WIN_spec_n;
-   extern double * spec_left;
-   extern double * spec_right;
-   extern fftw_plan plan;
-   int k;
+   extern int WIN_spec_mode;
+   extern SF_INFO sfinfo;
+   extern double logf_min;
+   extern double logf_max;
+   extern double amp2_min;
+   extern double amp2_max;
+   extern double octave_removal_factor;
 
-   /* read data */
-   for (k = 0; k < WIN_spec_n; k ++)
-   {
-      spec_left [k] = spec_right [k] = 0.0;
-   }
-   sndfile_read_at (sf, sfinfo,
-                    i,
-                    spec_left, spec_right,
-                    WIN_spec_n);
+   view->mode = (spg_mode_t) WIN_spec_mode;
+   view->fft_len = WIN_spec_n;
+   view->samplerate = sfinfo.samplerate;
+   view->logf_min = logf_min;
+   view->logf_max = logf_max;
+   view->amp2_min = amp2_min;
+   view->amp2_max = amp2_max;
+   view->octave_removal_factor = octave_removal_factor;
+}
 
-   if (r_amp2 == NULL)
-   {
-      /* left + right */
-      for (k = 0; k < WIN_spec_n; k ++)
-      {
-         spec_in [k] = 0.5 * (spec_left [k] + spec_right [k]);
-      }
-      windowing (WIN_spec_n, spec_in, flag_window, 1.0, spec_in);
-      fftw_execute (plan); /* FFT: spec_in[] -> spec_out[] */
-      if (l_ph == NULL)
-      {
-         HC_to_amp2 (WIN_spec_n, spec_out, (double)WIN_spec_n,
-                     l_amp2);
-      }
-      else
-      {
-         HC_to_polar2 (WIN_spec_n, spec_out, 0, (double)WIN_spec_n,
-                       l_amp2, l_ph);
-      }
-   }
-   else
-   {
-      /* left */
-      windowing (WIN_spec_n, spec_left, flag_window, 1.0, spec_in);
-      fftw_execute (plan); /* FFT: spec_in[] -> spec_out[] */
-      if (l_ph == NULL)
-      {
-         HC_to_amp2 (WIN_spec_n, spec_out, (double)WIN_spec_n,
-                     l_amp2);
-      }
-      else
-      {
-         HC_to_polar2 (WIN_spec_n, spec_out, 0, (double)WIN_spec_n,
-                       l_amp2, l_ph);
-      }
 
-      /* right */
-      windowing (WIN_spec_n, spec_right, flag_window, 1.0, spec_in);
-      fftw_execute (plan); /* FFT: spec_in[] -> spec_out[] */
-      if (l_ph == NULL)
-      {
-         HC_to_amp2 (WIN_spec_n, spec_out, (double)WIN_spec_n,
-                     r_amp2);
-      }
-      else
-      {
-         HC_to_polar2 (WIN_spec_n, spec_out, 0, (double)WIN_spec_n,
-                       r_amp2, r_ph);
-      }
-   }
+/* working buffers of the spectrum and spectrogram panels, so that a
+ * redraw allocates nothing; the bins are sized by wav_scratch_size ()
+ * when WIN_spec_n changes, the rows and the image grow with the panels
+ */
+struct wav_scratch
+{
+   int nbin; /* WIN_spec_n / 2 + 1 */
+   double * l_amp2, * r_amp2; /* [nbin] */
+   double * l_ph, * r_ph;
+   double * l_dphi, * r_dphi;
+   int rows;
+   double * l_ave, * r_ave; /* [rows] */
+   double * value;
+   size_t len_rgb;
+   guchar * rgb; /* [len_rgb] */
+};
+static struct wav_scratch wav_scratch;
+
+static void *
+wav_scratch_realloc (void * p, size_t size)
+{
+   p = realloc (p, size);
+   CHECK_MALLOC (p, "wav_scratch");
+   return p;
 }
 
-/*
- * INPUT
- *  r_amp2 : if NULL is given, left+right is analised.
- *  l_dphi, r_dphi :
- *    dphi[k] = principal(ph2 - ph1 - Omega[k]),
- *    where principal() rounds the value in [-pi, pi]
- *    and Omega[k] = 2pi k hop / N.
- *    NOTE the real frequency of k-bin in Hz is, therefore,
- *    (k + [lr]_f * N) * samplerate / N
- *
- *    = (k / N + [lr]_f) * samplerate
- */
+/* size the bins for the FFT length n */
 static void
-fft_two_frames (int i, int hop,
-                double * l_amp2, double * r_amp2,
-                double * l_ph,   double * r_ph,
-                double * l_dphi, double * r_dphi)
+wav_scratch_size (int n)
 {
-   double twopi = 2.0 * M_PI;
-   double * l_ph1 = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-   double * r_ph1 = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-   CHECK_MALLOC (l_ph1, "fft_two_frames");
-   CHECK_MALLOC (r_ph1, "fft_two_frames");
-
-   fft_one_frame (i + hop, l_amp2, r_amp2, l_ph1, r_ph1);
-   fft_one_frame (i,       l_amp2, r_amp2, l_ph,  r_ph);
-   /* because we need [lr]_amp2 at the frame i */
+   struct wav_scratch * w = &wav_scratch;
+   size_t size;
+
+   w->nbin = n / 2 + 1;
+   size = sizeof (double) * w->nbin;
+   w->l_amp2 = (double *)wav_scratch_realloc (w->l_amp2, size);
+   w->r_amp2 = (double *)wav_scratch_realloc (w->r_amp2, size);
+   w->l_ph   = (double *)wav_scratch_realloc (w->l_ph,   size);
+   w->r_ph   = (double *)wav_scratch_realloc (w->r_ph,   size);
+   w->l_dphi = (double *)wav_scratch_realloc (w->l_dphi, size);
+   w->r_dphi = (double *)wav_scratch_realloc (w->r_dphi, size);
+}
 
-   /* freq correction by phase difference */
+/* make room for rows values of each row buffer */
+static void
+wav_scratch_rows (int rows)
+{
+   struct wav_scratch * w = &wav_scratch;
+   size_t size;
 
-   for (i = 0; i < (WIN_spec_n / 2) + 1; ++i) /* full span */
-   {
-      double dphi;
-      /* left */
-      dphi = l_ph1[i] - l_ph[i]
-             - twopi * (double)i / (double)WIN_spec_n * (double)hop;
-      for (; dphi >= M_PI; dphi -= twopi);
-      for (; dphi < -M_PI; dphi += twopi);
-      l_dphi [i] = dphi / twopi / (double)hop;
-
-      /* right */
-      if (r_amp2 != NULL)
-      {
-         dphi = r_ph1[i] - r_ph[i]
-                - twopi * (double)i / (double)WIN_spec_n * (double)hop;
-         for (; dphi >= M_PI; dphi -= twopi);
-         for (; dphi < -M_PI; dphi += twopi);
-         r_dphi [i] = dphi / twopi / (double)hop;
-      }
-   }
+   if (rows <= w->rows)
+      return;
 
-   free (l_ph1);
-   free (r_ph1);
+   w->rows = rows;
+   size = sizeof (double) * rows;
+   w->l_ave = (double *)wav_scratch_realloc (w->l_ave, size);
+   w->r_ave = (double *)wav_scratch_realloc (w->r_ave, size);
+   w->value = (double *)wav_scratch_realloc (w->value, size);
 }
 
-/*
- * amp [resolution] : note that this is not squared.
- */
-static void
-average_PV_FFT (int resolution,
-                const double * amp2, const double * dphi,
-                double * amp)
+/* make room for an image of len bytes, and return it cleared */
+static guchar *
+wav_scratch_rgb (size_t len)
 {
-   extern int WIN_spec_n;
-   extern SF_INFO sfinfo;
-   extern double logf_min;
-   extern double logf_max;
-   extern double octave_removal_factor;
-   int i;
-   for (i = 0; i < resolution; i ++)
-   {
-      amp [i] = 0.0;
-   }
+   struct wav_scratch * w = &wav_scratch;
 
-   int k;
-   for (k = 1; k < (WIN_spec_n + 1) / 2; k ++)
+   if (len > w->len_rgb)
    {
-      /* freq -> display position */
-      double x = log (((double)k / (double)WIN_spec_n + dphi [k])
-                      * sfinfo.samplerate);
-      int ix
-         = (int)((double)resolution * (x - logf_min) / (logf_max - logf_min));
-      if (ix < 0 || ix >= resolution)
-         continue;
-
-      amp [ix] += sqrt (amp2 [k]);
+      w->len_rgb = len;
+      w->rgb = (guchar *)wav_scratch_realloc (w->rgb, len);
    }
+   memset (w->rgb, 0, len);
+   return w->rgb;
+}
 
-   /* experimental */
-   if (octave_removal_factor <= 0.0)
-      return;
-   else
-   {
-      double * amp0 = (double *)malloc (resolution * sizeof (double));
-      CHECK_MALLOC (amp0, "average_PV_FFT");
-      for (i = 0; i < resolution; i ++)
-      {
-         amp0[i] = amp[i];
-      }
-      for (i = 0; i < (resolution - 12); i ++)
-      {
-         amp [i + 12] -= octave_removal_factor * amp0 [i];
-         if (amp [i + 12] < 0.0)
-         {
-            amp [i + 12] = 0.0;
-         }
-      }
-      free (amp0);
-   }
+static void
+wav_scratch_free (void)
+{
+   struct wav_scratch * w = &wav_scratch;
+
+   free (w->l_amp2);
+   free (w->r_amp2);
+   free (w->l_ph);
+   free (w->r_ph);
+   free (w->l_dphi);
+   free (w->r_dphi);
+   free (w->l_ave);
+   free (w->r_ave);
+   free (w->value);
+   free (w->rgb);
+   memset (w, 0, sizeof (struct wav_scratch));
 }
 
 
@@ -873,6 +901,8 @@ draw_spectrum_frame (GtkWidget * widget,
    extern double amp2_max;
    extern SNDFILE * sf;
    extern SF_INFO sfinfo;
+   extern snd_cache_t * snd_cache;
+   extern spg_frame_t * spec_frame;
 
    int i;
 
@@ -922,57 +952,46 @@ draw_spectrum_frame (GtkWidget * widget,
 
 
    /* the following is the dynamic */
-   if (sf != NULL)
+   if (sf != NULL && snd_cache != NULL)
    {
-      /* allocate working area */
-      double * l_amp2 = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      double * r_amp2 = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      CHECK_MALLOC (l_amp2, "draw_spectrum_frame");
-      CHECK_MALLOC (r_amp2, "draw_spectrum_frame");
-
-      double * l_ph = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      double * r_ph = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      CHECK_MALLOC (l_ph,   "draw_spectrum_frame");
-      CHECK_MALLOC (r_ph,   "draw_spectrum_frame");
-
-      double * l_dphi = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      double * r_dphi = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      CHECK_MALLOC (l_dphi, "draw_spectrum_frame");
-      CHECK_MALLOC (r_dphi, "draw_spectrum_frame");
-
-
-      extern int oct_max, oct_min;
+      /* working area, see wav_scratch_size () */
+      double * l_amp2 = wav_scratch.l_amp2;
+      double * r_amp2 = wav_scratch.r_amp2;
+      double * l_ph   = wav_scratch.l_ph;
+      double * r_ph   = wav_scratch.r_ph;
+      double * l_dphi = wav_scratch.l_dphi;
+      double * r_dphi = wav_scratch.r_dphi;
       int resolution = (oct_max - oct_min) * 12;
-      double * l_ave = NULL;
-      double * r_ave = NULL;
-      if (WIN_spec_mode == 2)
-      {
-         l_ave = (double *)malloc (sizeof (double) * resolution);
-         r_ave = (double *)malloc (sizeof (double) * resolution);
-         CHECK_MALLOC (l_ave, "draw_spectrum_frame");
-         CHECK_MALLOC (r_ave, "draw_spectrum_frame");
-      }
+      double * l_ave;
+      double * r_ave;
+
+      wav_scratch_rows (resolution);
+      l_ave = wav_scratch.l_ave;
+      r_ave = wav_scratch.r_ave;
 
       /* set GC wiht OR function */
       gdk_gc_set_function (gc, GDK_OR);
 
       /* analyse the frame WIN_wav_mark */
+      spec_frame->flag_window = flag_window;
       if (WIN_spec_mode == 0)
       {
-         fft_one_frame (WIN_wav_mark,
+         spg_frame_one (spec_frame, snd_cache, WIN_wav_mark,
                         l_amp2, r_amp2,
                         l_ph, r_ph);
       }
       else
       {
-         fft_two_frames (WIN_wav_mark, WIN_spec_hop,
-                         l_amp2, r_amp2,
-                         l_ph, r_ph,
-                         l_dphi, r_dphi);
+         spg_frame_two (spec_frame, snd_cache, WIN_wav_mark, WIN_spec_hop,
+                        l_amp2, r_amp2,
+                        l_ph, r_ph,
+                        l_dphi, r_dphi);
          if (WIN_spec_mode == 2)
          {
-            average_PV_FFT (resolution, l_amp2, l_dphi, l_ave);
-            average_PV_FFT (resolution, r_amp2, r_dphi, r_ave);
+            spg_view_t view;
+            spg_view_get (&view);
+            spg_average_pv (&view, resolution, l_amp2, l_dphi, l_ave);
+            spg_average_pv (&view, resolution, r_amp2, r_dphi, r_ave);
          }
       }
 
@@ -1169,19 +1188,6 @@ draw_spectrum_frame (GtkWidget * widget,
          }
       }
 
-      free (l_amp2);
-      free (r_amp2);
-      free (l_ph);
-      free (r_ph);
-      free (l_dphi);
-      free (r_dphi);
-
-      if (WIN_spec_mode == 2)
-      {
-         free (l_ave);
-         free (r_ave);
-      }
-
       /* recover GC's function */
       gdk_gc_set_function (gc, backup_gc_values.function);
    }
@@ -1223,6 +1229,93 @@ draw_spectrum_frame (GtkWidget * widget,
                   WIN_wav_width, bottom_phase - 1);
 }
 
+/* RGB image of the cells of the spectrogram panel, so that a redraw
+ * puts one image on the pixmap instead of a GDK call for each cell
+ */
+struct spg_image
+{
+   guchar * rgb; /* [height][width][3] */
+   int x0, y0; /* the position on wav_pixmap */
+   int width, height;
+   guchar palette [256][3]; /* from colormap_power_r/g/b */
+};
+
+/* set up the image, black, in the working area, with the palette of
+ * the current colormap
+ */
+static void
+spg_image_new (struct spg_image * img, int x0, int y0, int width, int height)
+{
+   extern gint colormap_power_r[256];
+   extern gint colormap_power_g[256];
+   extern gint colormap_power_b[256];
+   int ic;
+
+   img->x0 = x0;
+   img->y0 = y0;
+   img->width  = (width  > 0) ? width  : 0;
+   img->height = (height > 0) ? height : 0;
+   img->rgb = wav_scratch_rgb ((size_t)img->width * img->height * 3 + 1);
+
+   for (ic = 0; ic < 256; ic ++)
+   {
+      img->palette [ic][0] = (guchar) colormap_power_r [ic];
+      img->palette [ic][1] = (guchar) colormap_power_g [ic];
+      img->palette [ic][2] = (guchar) colormap_power_b [ic];
+   }
+}
+
+/* fill the rectangle (x, y, w, h) on wav_pixmap with the color index ic,
+ * clipped to the image
+ */
+static void
+spg_image_fill (struct spg_image * img, int x, int y, int w, int h, int ic)
+{
+   int x1 = x + w;
+   int y1 = y + h;
+   int ix, iy;
+
+   x  -= img->x0;
+   x1 -= img->x0;
+   y  -= img->y0;
+   y1 -= img->y0;
+   if (x  < 0) x = 0;
+   if (y  < 0) y = 0;
+   if (x1 > img->width)  x1 = img->width;
+   if (y1 > img->height) y1 = img->height;
+
+   for (iy = y; iy < y1; iy ++)
+   {
+      guchar * p = img->rgb + ((size_t)iy * img->width + x) * 3;
+      for (ix = x; ix < x1; ix ++, p += 3)
+      {
+         p [0] = img->palette [ic][0];
+         p [1] = img->palette [ic][1];
+         p [2] = img->palette [ic][2];
+      }
+   }
+}
+
+/* put the image on wav_pixmap; the buffer stays in the working area */
+static void
+spg_image_put (struct spg_image * img, GdkGC * gc)
+{
+   extern GdkPixmap * wav_pixmap;
+
+   if (img->width > 0 && img->height > 0)
+   {
+      gdk_draw_rgb_image (wav_pixmap, gc,
+                          img->x0, img->y0, img->width, img->height,
+                          GDK_RGB_DITHER_NONE, img->rgb, img->width * 3);
+   }
+   img->rgb = NULL;
+}
+
+/* the rows of the spectrogram panel for the current view; the engine
+ * keeps its bands of bins until the view or the height changes
+ */
+static spg_render_t spg_render;
+
 /* draw spectrogram panel
  * INPUT
  *  i0, i1 : the range to draw in the display (pixel)
@@ -1236,18 +1329,15 @@ draw_spectrogram_frame (GtkWidget * widget,
    extern GdkPixmap * wav_pixmap;
    //extern gint WIN_wav_width;
    extern int WIN_spec_mode;
-   extern double amp2_min;
-   extern double amp2_max;
    extern SNDFILE * sf;
-   extern SF_INFO sfinfo;
+   extern spec_tiles_t * spec_tiles;
 
    int i, j;
    int k;
 
-   double x;
-   int ix, ix0;
-   double y;
+   int ix;
    int ic;
+   GdkGCValues backup_gc_values;
 
 
    if (i0 < 10) i0 = 10;
@@ -1263,293 +1353,71 @@ draw_spectrogram_frame (GtkWidget * widget,
 
 
    /* backup GdkFunction */
-   GdkGCValues backup_gc_values;
    gdk_gc_get_values (gc, &backup_gc_values);
 
 
    /* the following is the dynamic */
    if (sf != NULL)
    {
-      /* allocate working area */
-      double * l_amp2 = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      double * l_ph   = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      double * l_dphi = (double *)malloc (sizeof (double) * ((WIN_spec_n / 2) + 1));
-      CHECK_MALLOC (l_amp2, "draw_spectrogram_frame");
-      CHECK_MALLOC (l_ph,   "draw_spectrogram_frame");
-      CHECK_MALLOC (l_dphi, "draw_spectrogram_frame");
-
-      extern gint colormap_power_r[256];
-      extern gint colormap_power_g[256];
-      extern gint colormap_power_b[256];
-
-      int istep = WIN_spec_n / WIN_wav_scale;
+      /* working area, see wav_scratch_size () */
+      double * l_amp2 = wav_scratch.l_amp2;
+      double * l_dphi = wav_scratch.l_dphi;
+      double * value;
+      int istep;
+      struct spg_image img;
+      spg_view_t view;
+      spec_tiles_key_t key;
+
+      istep = WIN_spec_n / WIN_wav_scale;
       if (istep <= 0) istep = 1;
 
-      double * ave = NULL;
-      if (WIN_spec_mode == 1 || WIN_spec_mode == 2)
+      wav_scratch_rows (height_spg + 1);
+      value = wav_scratch.value;
+
+      /* the cells are filled in an RGB image of the panel, which is put
+       * on the pixmap at once at the end */
+      spg_image_new (&img, i0, bottom_spg - height_spg,
+                     i1 - i0, height_spg);
+
+      /* the rows of each column, from the spectrogram engine */
+      spg_view_get (&view);
+      spg_render_set (&spg_render, &view, height_spg, istep <= 1);
+
+      /* the columns come from the tile cache, which the workers fill;
+       * each pixel column takes the cached column nearest to its frame.
+       * modes 1 and 2 share the columns with the phase difference. */
+      key.fft_len = WIN_spec_n;
+      key.hop = (WIN_spec_mode == 0) ? 0 : WIN_spec_hop;
+      key.flag_window = flag_window;
+      key.step = (long)istep * WIN_wav_scale;
+      if (spec_tiles != NULL)
       {
-         ave = (double *)malloc (sizeof (double) * height_spg);
-         CHECK_MALLOC (ave, "draw_spectrogram_frame");
+         spec_tiles_begin (spec_tiles);
       }
 
       for (i = i0/*0*/; i < i1/*WIN_wav_width*/; i += istep)
       {
-         if (WIN_spec_mode == 0)
+         long frame = WIN_wav_cur + (long)i * WIN_wav_scale;
+         if (spec_tiles == NULL
+             || ! spec_tiles_column (spec_tiles, &key,
+                                     (frame + key.step / 2) / key.step,
+                                     l_amp2, l_dphi))
          {
-            /* get amp2 for the frame (WIN_wav_cur + i * WIN_wav_scale) */
-            fft_one_frame (WIN_wav_cur + i * WIN_wav_scale,
-                           l_amp2, NULL, NULL, NULL);
-
-            /* drawing */
-            ix0 = -1;
-            y = 0.0;
-            int ny = 0;
-            for (k = 0; k < (WIN_spec_n / 2) + 1; k ++) /* full span */
-            {
-               x = log ((double)k / (double)WIN_spec_n * sfinfo.samplerate);
-               if (x < logf_min || x > logf_max)
-                  continue;
-
-               ix = logf_to_display (x, height_spg);
-               if (ix != ix0)
-               {
-                  if (ny > 0)
-                  {
-                     y /= (double) ny;
-                     y = log10 (y);
-                     ic = (int)(256.0
-                                * (y - amp2_min) / (amp2_max - amp2_min));
-                     if (ic < 0)    ic = 0;
-                     if (ic >= 256) ic = 255;
-                     get_color (widget,
-                                colormap_power_r[ic],
-                                colormap_power_g[ic],
-                                colormap_power_b[ic],
-                                gc);
-
-                     /* draw ix0 */
-                     if (ix - ix0 > 1)
-                     {
-                        /* too big gap */
-                        int ix1;
-                        /* check */
-                        x = log ((double)(k - 1)
-                                 / (double)WIN_spec_n
-                                 * sfinfo.samplerate);
-                        ix1 = logf_to_display (x, height_spg);
-                        if (ix1 != ix0)
-                        {
-                           fprintf (stderr, "something is wrong...\n");
-                           exit (1);
-                        }
-
-                        x = log ((double)(k - 2)
-                                 / (double)WIN_spec_n
-                                 * sfinfo.samplerate);
-                        ix1 = logf_to_display (x, height_spg);
-                        /* so that (ix1, ix0, ix) are the positions */
-                        /* => draw the rectangle for */
-                        /* (ix0-(ix0-ix1)/2,ix0+(ix-ix0)/2)=(ix_b, ix_t) */
-                        /* whose width is ((ix+ix0) - (ix0+ix1))/2 = ix_d */
-                        int ix_b, ix_t, ix_d;
-                        ix_b = (ix0 + ix1) / 2;
-                        ix_t = (ix  + ix0) / 2;
-                        ix_d = (ix  - ix1) / 2 + 1;
-                        if (ix_b < 0) ix_b = 0;
-                        if (ix_d < 1) ix_d = 1;
-                        if (ix_t > height_spg) ix_t = height_spg;
-
-                        if (istep <= 1)
-                        {
-                           gdk_draw_line
-                           (wav_pixmap, gc,
-                            i, bottom_spg - ix_b,
-                            i, bottom_spg - ix_t);
-                        }
-                        else
-                        {
-                           if (i + istep >= WIN_wav_width)
-                           {
-                              gdk_draw_rectangle
-                              (wav_pixmap, gc,
-                               TRUE, /* fill */
-                               i, bottom_spg - ix_t,
-                               WIN_wav_width - i, ix_d);
-                           }
-                           else
-                           {
-                              gdk_draw_rectangle
-                              (wav_pixmap, gc,
-                               TRUE, /* fill */
-                               i, bottom_spg - ix_t,
-                               istep, ix_d);
-                           }
-                        }
-                     }
-                     else
-                     {
-                        if (istep <= 1)
-                        {
-                           gdk_draw_point
-                           (wav_pixmap, gc,
-                            i, bottom_spg - ix0);
-                        }
-                        else
-                        {
-                           if (i + istep >= WIN_wav_width)
-                           {
-                              gdk_draw_line
-                              (wav_pixmap, gc,
-                               i,             bottom_spg - ix0,
-                               WIN_wav_width, bottom_spg - ix0);
-                           }
-                           else
-                           {
-                              gdk_draw_line
-                              (wav_pixmap, gc,
-                               i,         bottom_spg - ix0,
-                               i + istep, bottom_spg - ix0);
-                           }
-                        }
-                     }
-                  }
-                  /* for the next step */
-                  y = 0.0;
-                  ny = 0;
-                  ix0 = ix;
-               }
-               y += l_amp2 [k];
-               ny ++;
-            }
+            continue; /* not ready yet; drawn by spg_tiles_redraw() */
          }
-         else /* WIN_spec_mode == 1 || WIN_spec_mode == 2 */
+
+         /* row 0 is the bottom edge, under the panel */
+         spg_render_column (&spg_render, l_amp2, l_dphi, value);
+         for (k = 1; k <= height_spg; k ++)
          {
-            /* get amp2 and dphi for the frame */
-            /* (WIN_wav_cur + i * WIN_wav_scale) */
-            fft_two_frames (WIN_wav_cur + i * WIN_wav_scale, WIN_spec_hop,
-                            l_amp2, NULL,
-                            l_ph, NULL,
-                            l_dphi, NULL);
-            average_PV_FFT (height_spg, l_amp2, l_dphi, ave);
-
-            if (WIN_spec_mode == 1 ||
-                  (WIN_spec_mode == 2 && height_spg < (oct_max - oct_min) * 12))
-            {
-               for (k = 0; k < height_spg; k ++)
-               {
-                  y = 2.0 * log10 (ave [k]);
-                  ic = (int)(256.0 * (y - amp2_min)
-                             / (amp2_max - amp2_min));
-                  if (ic < 0)    ic = 0;
-                  if (ic >= 256) ic = 255;
-                  get_color (widget,
-                             colormap_power_r[ic],
-                             colormap_power_g[ic],
-                             colormap_power_b[ic],
-                             gc);
-
-                  if (istep <= 1)
-                  {
-                     gdk_draw_point (wav_pixmap, gc, i, bottom_spg - k);
-                  }
-                  else
-                  {
-                     if (i + istep >= WIN_wav_width)
-                     {
-                        gdk_draw_line (wav_pixmap, gc,
-                                       i,             bottom_spg - k,
-                                       WIN_wav_width, bottom_spg - k);
-                     }
-                     else
-                     {
-                        gdk_draw_line (wav_pixmap, gc,
-                                       i,         bottom_spg - k,
-                                       i + istep, bottom_spg - k);
-                     }
-                  }
-               }
-            }
-            else /* WIN_spec_mode == 2 and height_spg > 4*12 */
-            {
-               int midi0, midi;
-               midi0 = -1;
-               y = 0.0;
-               int ny = 0;
-               for (k = 0; k < height_spg; k ++)
-               {
-                  /* current midi note for display position k */
-                  midi = logf_to_midi (display_to_logf (k, height_spg));
-                  if (midi != midi0)
-                  {
-                     if (ny > 0)
-                     {
-                        /* draw for midi0 (= midi - 1) */
-                        y /= (double) ny;
-                        y = 2.0 * log10 (y);
-                        ic = (int)(256.0
-                                   * (y - amp2_min)
-                                   / (amp2_max - amp2_min));
-                        if (ic < 0)    ic = 0;
-                        if (ic >= 256) ic = 255;
-                        get_color (widget,
-                                   colormap_power_r[ic],
-                                   colormap_power_g[ic],
-                                   colormap_power_b[ic],
-                                   gc);
-                        int ix_b, ix_t, ix_d;
-                        ix_b = midi_to_display_bottom (midi - 1, height_spg);
-                        ix_t = midi_to_display_top (midi - 1, height_spg);
-                        ix_d = ix_t - ix_b + 1;
-                        if (ix_b < 0) ix_b = 0;
-                        if (ix_d < 1) ix_d = 1;
-                        if (ix_t > height_spg) ix_t = height_spg;
-
-                        if (istep <= 1)
-                        {
-                           gdk_draw_line
-                           (wav_pixmap, gc,
-                            i, bottom_spg - ix_b,
-                            i, bottom_spg - ix_t);
-                        }
-                        else
-                        {
-                           if (i + istep >= WIN_wav_width)
-                           {
-                              gdk_draw_rectangle
-                              (wav_pixmap, gc,
-                               TRUE, /* fill */
-                               i, bottom_spg - ix_t,
-                               WIN_wav_width - i, ix_d);
-                           }
-                           else
-                           {
-                              gdk_draw_rectangle
-                              (wav_pixmap, gc,
-                               TRUE, /* fill */
-                               i, bottom_spg - ix_t,
-                               istep, ix_d);
-                           }
-                        }
-                     }
-                     /* for the next step */
-                     y = 0.0;
-                     ny = 0;
-                     midi0 = midi;
-                  }
-                  y += ave [k];
-                  ny ++;
-               }
-            }
-         }
-      }
-      free (l_amp2);
-      free (l_ph);
-      free (l_dphi);
+            if (value [k] < 0.0)
+               continue;
 
-      if (WIN_spec_mode == 1 || WIN_spec_mode == 2)
-      {
-         free (ave);
+            ic = spg_color_index (&spg_render, value [k]);
+            spg_image_fill (&img, i, bottom_spg - k, istep, 1, ic);
+         }
       }
+      spg_image_put (&img, gc);
 
       /* recover GC's function */
       gdk_gc_set_function (gc, backup_gc_values.function);
@@ -1625,7 +1493,7 @@ draw_spectrogram_frame (GtkWidget * widget,
                   i0/*0*/, bottom_spg,
                   i1/*WIN_wav_width*/, bottom_spg);
 
-   draw_keyboard (widget, gc, bottom_spg, height_spg);
+   draw_keyboard (widget, gc, wav_pixmap, bottom_spg, height_spg, NULL);
 }
 
 
@@ -1757,6 +1625,50 @@ update_win_wav (GtkWidget * widget,
 }
 
 
+/* spec_tiles calls spg_tiles_ready() on its worker threads each time
+ * a tile of the spectrogram is ready; one redraw at a time is scheduled
+ * in the main loop, and it picks up all of the tiles ready by then.
+ */
+static gint spg_redraw_pending = 0;
+static guint spg_redraw_tag = 0;
+
+static gboolean
+spg_tiles_redraw (gpointer data)
+{
+   g_atomic_int_set (&spg_redraw_pending, 0);
+   update_win_wav (GTK_WIDGET (data),
+                   0, /* spec */
+                   0, /* wav */
+                   1  /* spg */
+                  );
+   return FALSE; /* just once */
+}
+
+static void
+spg_tiles_ready (void * data)
+{
+   if (g_atomic_int_compare_and_exchange (&spg_redraw_pending, 0, 1))
+   {
+      spg_redraw_tag = g_idle_add (spg_tiles_redraw, data);
+   }
+}
+
+/* stop the spectrogram workers, with the redraw they have scheduled
+ */
+void
+spg_tiles_stop (void)
+{
+   extern spec_tiles_t * spec_tiles;
+   spec_tiles_free (spec_tiles); /* joins the workers */
+   spec_tiles = NULL;
+   if (g_atomic_int_get (&spg_redraw_pending))
+   {
+      g_source_remove (spg_redraw_tag);
+      g_atomic_int_set (&spg_redraw_pending, 0);
+   }
+}
+
+
 /* draw playing indicator
  */
 void
@@ -1880,11 +1792,7 @@ static void
 WIN_spec_n_update (void)
 {
    extern int WIN_spec_n;
-   extern double * spec_in;
-   extern double * spec_out;
-   extern fftw_plan plan;
-   extern double * spec_left;
-   extern double * spec_right;
+   extern spg_frame_t * spec_frame;
    extern int WIN_spec_hop_scale;
    extern int WIN_spec_hop;
    extern struct pv_complex * pv;
@@ -1892,20 +1800,9 @@ WIN_spec_n_update (void)
    extern double pv_pitch;
    pv_complex_change_rate_pitch (pv, pv_rate, pv_pitch);
 
-   free (spec_in);
-   free (spec_out);
-   fftw_destroy_plan (plan);
-   spec_in  = (double *)fftw_malloc (sizeof(double) * WIN_spec_n);
-   spec_out = (double *)fftw_malloc (sizeof(double) * WIN_spec_n);
-   CHECK_MALLOC (spec_in,  "wav_key_press_event");
-   CHECK_MALLOC (spec_out, "wav_key_press_event");
-   plan = fftw_plan_r2r_1d (WIN_spec_n, spec_in, spec_out,
-                            FFTW_R2HC, FFTW_ESTIMATE);
-
-   spec_left  = (double *)realloc (spec_left, sizeof(double) * WIN_spec_n);
-   spec_right = (double *)realloc (spec_right, sizeof(double) * WIN_spec_n);
-   CHECK_MALLOC (spec_left,  "wav_key_press_event");
-   CHECK_MALLOC (spec_right, "wav_key_press_event");
+   spg_frame_free (spec_frame);
+   spec_frame = spg_frame_new (WIN_spec_n);
+   wav_scratch_size (WIN_spec_n);
 
    WIN_spec_hop = WIN_spec_n / WIN_spec_hop_scale;
 
@@ -2054,12 +1951,21 @@ b_play_press_event (GtkWidget * widget, gpointer data)
 {
    extern int flag_play;
    extern gint tag_play;
+   extern ao_queue_t * aoq;
    flag_play ++;
    if (flag_play > 1)
    {
       flag_play = 0;
       /* gtk_timeout_remove is deprecated */
       g_source_remove (tag_play);
+      if (aoq != NULL)
+      {
+         fprintf (stderr, "# ao queue: lowest %ld of %ld frames,"
+                  " underruns %lu\n",
+                  ao_queue_depth_min (aoq), aoq->size,
+                  ao_queue_underruns (aoq));
+         ao_queue_flush (aoq); /* stop now, not after the latency */
+      }
    }
    else
    {
@@ -2404,46 +2310,15 @@ make_color_map (void)
    extern gint colormap_power_g[256];
    extern gint colormap_power_b[256];
 
+   unsigned char palette [SPG_COLORS][3];
    int i;
-   int i0;
-   for (i = 0; i < 256 / 5; i ++)
-   {
-      colormap_power_r[i] = 0;
-      colormap_power_g[i] = 0;
-      colormap_power_b[i] = i * 5;
-   }
-   i0 = 256 / 5;
-   for (i = 0; i < 256 / 5; i ++)
+   spg_colormap (palette);
+   for (i = 0; i < 256; i ++)
    {
-      colormap_power_r[i0 + i] = 0;
-      colormap_power_g[i0 + i] = i * 5;
-      colormap_power_b[i0 + i] = 255;
+      colormap_power_r[i] = palette [i][0];
+      colormap_power_g[i] = palette [i][1];
+      colormap_power_b[i] = palette [i][2];
    }
-   i0 = 256 * 2 / 5;
-   for (i = 0; i < 256 / 5; i ++)
-   {
-      colormap_power_r[i0 + i] = 0;
-      colormap_power_g[i0 + i] = 255;
-      colormap_power_b[i0 + i] = 255 - i * 5;
-   }
-   i0 = 256 * 3 / 5;
-   for (i = 0; i < 256 / 5; i ++)
-   {
-      colormap_power_r[i0 + i] = i * 5;
-      colormap_power_g[i0 + i] = 255;
-      colormap_power_b[i0 + i] = 0;
-   }
-   i0 = 256 * 4 / 5;
-   for (i = 0; i < 256 / 5; i ++)
-   {
-      colormap_power_r[i0 + i] = 255;
-      colormap_power_g[i0 + i] = 255 - i * 5;
-      colormap_power_b[i0 + i] = 0;
-   }
-   /* for sure */
-   colormap_power_r[255] = 255;
-   colormap_power_g[255] = 0;
-   colormap_power_b[255] = 0;
 }
 
 static gboolean
@@ -2454,6 +2329,7 @@ wav_delete (GtkWidget * widget,
    extern struct pv_complex * pv;
    extern SNDFILE * sf;
    extern ao_device * ao;
+   extern ao_queue_t * aoq;
    /* stop playing */
    extern int flag_play;
    extern gint tag_play;
@@ -2463,6 +2339,17 @@ wav_delete (GtkWidget * widget,
       g_source_remove (tag_play);
    }
 
+   /* spectrogram workers, before the file goes */
+   spg_tiles_stop ();
+   peaks_free (wav_peaks);
+   wav_peaks = NULL;
+   snd_cache_close (snd_cache);
+   snd_cache = NULL;
+   spg_frame_free (spec_frame);
+   spec_frame = NULL;
+   spg_render_free (&spg_render);
+   wav_scratch_free ();
+
    if (pv != NULL)
    {
       pv_complex_free (pv);
@@ -2476,7 +2363,12 @@ wav_delete (GtkWidget * widget,
       sf = NULL;
    }
 
-   /* ao device */
+   /* ao device, after its output thread */
+   if (aoq != NULL)
+   {
+      ao_queue_free (aoq);
+      aoq = NULL;
+   }
    if (ao != NULL)
    {
       ao_close (ao);
@@ -2504,7 +2396,7 @@ b_close_press_event (GtkWidget * widget, gpointer data)
 
 /** **/
 void
-create_wav (void)
+create_wav (const char * file)
 {
    extern GtkObject * adj_cur;
    extern GtkObject * adj_scale;
@@ -2515,14 +2407,12 @@ create_wav (void)
    extern SNDFILE * sf;
    extern SF_INFO sfinfo;
    extern struct pv_complex * pv;
-   extern double * spec_in;
-   extern double * spec_out;
-   extern fftw_plan plan;
+   extern spg_frame_t * spec_frame;
    extern int flag_window;
    extern double amp2_min;
    extern double amp2_max;
-   extern double * spec_left;
-   extern double * spec_right;
+   extern waon_spec_cache_t * spec_cache;
+   extern spec_tiles_t * spec_tiles;
    extern int WIN_wav_cur;
    extern int WIN_wav_mark;
    extern int WIN_wav_scale;
@@ -2531,6 +2421,7 @@ create_wav (void)
    extern double logf_min;
    extern double logf_max;
    extern ao_device * ao;
+   extern ao_queue_t * aoq;
    extern long play_cur;
    extern int flag_play;
    extern gint WIN_wav_width;
@@ -2574,25 +2465,18 @@ create_wav (void)
    WIN_spec_mode = 0;
 
    pv = pv_complex_init (WIN_spec_n, WIN_spec_hop, 3 /* hanning */);
+   CHECK_MALLOC (pv, "create_wav");
    pv_complex_set_input (pv, sf, &sfinfo);
 
 
-   spec_in = (double *)fftw_malloc (sizeof(double) * WIN_spec_n);
-   spec_out = (double *)fftw_malloc (sizeof(double) * WIN_spec_n);
-   CHECK_MALLOC (spec_in,  "wav_key_press_event");
-   CHECK_MALLOC (spec_out, "wav_key_press_event");
-   plan = fftw_plan_r2r_1d (WIN_spec_n, spec_in, spec_out,
-                            FFTW_R2HC, FFTW_ESTIMATE);
+   spg_frame_free (spec_frame);
+   spec_frame = spg_frame_new (WIN_spec_n);
+   wav_scratch_size (WIN_spec_n);
 
    flag_window = 0; /* no window */
    amp2_min = -3.0;
    amp2_max = 1.0;
 
-   spec_left = (double *)malloc (sizeof(double) * WIN_spec_n);
-   spec_right = (double *)malloc (sizeof(double) * WIN_spec_n);
-   CHECK_MALLOC (spec_left,  "wav_key_press_event");
-   CHECK_MALLOC (spec_right, "wav_key_press_event");
-
    WIN_wav_cur = 0;
    WIN_wav_mark = 0;
    if (sfinfo.frames > WIN_spec_n)
@@ -2616,7 +2500,15 @@ create_wav (void)
    ao_shutdown ();
 
    ao = ao_init_16_stereo (sfinfo.samplerate, 0);
-   pv_complex_set_output_ao (pv, ao);
+   aoq = ao_queue_new (ao, sfinfo.samplerate, AO_QUEUE_LATENCY_MS);
+   if (aoq != NULL)
+   {
+      pv_complex_set_output_ao_queue (pv, aoq);
+   }
+   else
+   {
+      pv_complex_set_output_ao (pv, ao);
+   }
 
    play_cur = 0;
    flag_play = 0;
@@ -2752,6 +2644,36 @@ create_wav (void)
    gtk_signal_connect (GTK_OBJECT (wav_win), "button_press_event",
                        (GtkSignalFunc) wav_button_press_event, NULL);
 
+   /* the samples are decoded once, for the panels and the workers */
+   peaks_free (wav_peaks);
+   wav_peaks = NULL;
+   snd_cache_close (snd_cache);
+   snd_cache = snd_cache_open (file);
+
+   /* the waveform is drawn from its peaks, kept beside a long file */
+   if (snd_cache != NULL)
+   {
+      gchar * name = g_strconcat (file, PEAKS_EXTENSION, NULL);
+      wav_peaks = peaks_open (name, snd_cache, file);
+      if (wav_peaks == NULL)
+      {
+         wav_peaks = peaks_build (snd_cache, file);
+         if (sfinfo.frames >= WAV_PEAKS_SAVE_FRAMES)
+         {
+            peaks_save (wav_peaks, name);
+         }
+      }
+      g_free (name);
+   }
+
+   /* the spectrogram columns are computed in the background */
+   if (snd_cache != NULL)
+   {
+      spec_tiles = spec_tiles_new (snd_cache, 0, /* threads by the CPUs */
+                                   spg_tiles_ready, wav_win);
+      spec_tiles_set_disk_cache (spec_tiles, spec_cache);
+   }
+
    /* add scrollbar */
 
    adj_cur = gtk_adjustment_new
@@ -24,7 +24,20 @@
 /* draw playing indicator */
 
 void draw_play_indicator (GtkWidget * widget);
-void create_wav (void);
+
+/* draw vertical keyboard between (bottom - height) to bottom
+ * on pixmap; the notes of vel [128] (if not NULL) are lit by velocity */
+
+void draw_keyboard (GtkWidget * widget,
+                    GdkGC * gc,
+                    GdkPixmap * pixmap,
+                    int bottom, int height,
+                    const char * vel);
+
+/* stop the spectrogram workers (before the file is closed) */
+
+void spg_tiles_stop (void);
+void create_wav (const char * file);
 
 
 #endif /* !_GWAON_WAV_H_ */
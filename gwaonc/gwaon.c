@@ -30,6 +30,9 @@ SF_INFO sfinfo;
 int
 main (int argc, char * argv [])
 {
+#if ! GLIB_CHECK_VERSION (2, 32, 0)
+   g_thread_init (NULL); /* the spectrogram workers call g_idle_add() */
+#endif
    gtk_init(&argc, &argv);
    create_menu();
    gtk_main();
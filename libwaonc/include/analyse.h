@@ -67,6 +67,13 @@ typedef struct
 
    wbool_t absolute_cutoff;               /* abs_flg     */
 
+   /**
+    * The pitch adjustment in semitones, selected by option --adjust or
+    * -a.  See get_note().
+    */
+
+   double adj_pitch;                      /* adj_pitch   */
+
    /**
     * Flag for using patch file.
     */
@@ -116,6 +123,7 @@ extern void note_intensity
    double t0, char * intens,
    analysis_scratchpad_t * parameters
 );
+extern double frame_mean_square (int n, const double * x);
 extern void average_FFT_into_midi
 (
    int len, double samplerate,
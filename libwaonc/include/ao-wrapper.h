@@ -31,13 +31,61 @@
  * \library       libwaonc
  * \author        Kengo Ichiki with modifications by Chris Ahlstrom
  * \date          2007-02-28
- * \updates       2013-12-22
+ * \updates       2026-10-18
  * \version       $Revision$
  * \license       GNU GPL
+ *
+ *    ao_write() blocks its caller until the device takes the frames.  An
+ *    ao_queue_t puts a queue of ao_queue_t.size frames and a thread of its
+ *    own between the caller and ao_play(), so that a synthesis loop only
+ *    blocks when it is that far ahead of the device, and a loop that also
+ *    handles the user interface can ask ao_queue_space() before each hop
+ *    and never block at all.
  */
 
+#include <pthread.h>                   /* pthread_t, mutex, condition         */
+
 #include "macros.h"                    /* to define wbool_t                   */
 
+/**
+ *    The default latency of an ao_queue_t, in milliseconds.
+ */
+
+#define AO_QUEUE_LATENCY_MS            200
+
+/**
+ *    Holds the output queue of an ao device, in the 16-bit stereo format
+ *    of ao_init_16_stereo().  The members below the mutex are shared with
+ *    the output thread; use the functions to read them.
+ */
+
+typedef struct
+{
+   ao_device * device;
+   char * ring;            /*<< [4 * size], 16-bit little-endian stereo.      */
+   char * chunk;           /*<< [4 * period], what ao_play() is playing.      */
+   long size;              /*<< Frames of the queue, i.e. the latency.        */
+   long period;            /*<< Most frames given to ao_play() at a time.     */
+   pthread_t thread;
+   pthread_mutex_t lock;
+   pthread_cond_t cond_data;  /*<< Frames were queued, or stop.               */
+   pthread_cond_t cond_space; /*<< Frames were taken or played, or stop.      */
+   long head;              /*<< Index of the oldest queued frame.             */
+   long count;             /*<< Queued frames.                                */
+   wbool_t running;        /*<< wfalse tells the thread to exit.              */
+   wbool_t playing;        /*<< The thread is in ao_play().                   */
+   wbool_t primed;         /*<< Frames came since the last flush or drain.    */
+   wbool_t draining;       /*<< ao_queue_drain() waits for the end.           */
+   unsigned long underruns;   /*<< The thread found the queue empty.          */
+   long depth_min;         /*<< Lowest depth at a take, since primed.         */
+   unsigned long played;   /*<< Frames given to ao_play().                    */
+
+} ao_queue_t;
+
+/*
+ * Global functions for the ao-wrapper module.
+ */
+
 extern ao_device * ao_init_16_stereo (int samplerate, wbool_t verbose);
 extern void print_ao_driver_info_list (void);
 extern int ao_write
@@ -47,6 +95,26 @@ extern int ao_write
    double * right,
    int len
 );
+extern ao_queue_t * ao_queue_new
+(
+   ao_device * device,
+   int samplerate,
+   long latency_ms
+);
+extern void ao_queue_free (ao_queue_t * q);
+extern int ao_queue_write
+(
+   ao_queue_t * q,
+   const double * left,
+   const double * right,
+   int len
+);
+extern long ao_queue_space (ao_queue_t * q);
+extern long ao_queue_depth (ao_queue_t * q);
+extern unsigned long ao_queue_underruns (ao_queue_t * q);
+extern long ao_queue_depth_min (ao_queue_t * q);
+extern void ao_queue_flush (ao_queue_t * q);
+extern void ao_queue_drain (ao_queue_t * q);
 
 #endif         /* WAONC_AO_WRAPPER_H_ */
 
@@ -0,0 +1,125 @@
+#ifndef WAONC_CX_H_
+#define WAONC_CX_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : interleaved-complex routines
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          cx.h
+ *
+ *    This module provides the interleaved-complex counterparts of the
+ *    half-complex routines of hc.h.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The "CX" layout is the output of fftw_plan_dft_r2c_1d() (and the
+ *    input of fftw_plan_dft_c2r_1d()), viewed as an array of doubles:
+ *
+\verbatim
+      (freq(0), freq(1), ... freq(2k), freq(2k+1) ...) = (r(0), i(0), ...
+                                                          r(k), i(k) ...)
+\endverbatim
+ *
+ *    for k = 0 to len/2, where Y(k) = r(k) + i i(k).  The real and
+ *    imaginary parts of each bin are adjacent, so that the loops below
+ *    walk the buffers with unit stride, instead of reading from both ends
+ *    of the buffer as the HC routines must do.  A CX buffer holds
+ *    CX_LENGTH(len) doubles, two more than the HC buffer for the same
+ *    FFT length when len is even.
+ *
+ *    The parameters and results of each routine are the same as those of
+ *    the HC routine of the same name; only the layout of the frequency
+ *    buffers differs.
+ */
+
+#include "macros.h"                    /* wbool_t */
+
+/**
+ *    Provides the number of doubles in a CX buffer for an FFT of length
+ *    \a len, that is, len/2+1 complex values.
+ */
+
+#define CX_LENGTH(len)                 (2 * ((len) / 2 + 1))
+
+extern void CX_to_polar
+(
+   long len,
+   const double * freq,
+   wbool_t conjugate,
+   double * amp,
+   double * phs
+);
+extern void CX_to_polar2
+(
+   long len,
+   const double * freq,
+   wbool_t conjugate,
+   double scale,
+   double * amp2,
+   double * phs
+);
+extern void CX_to_amp2
+(
+   long len,
+   const double * freq,
+   double scale,
+   double * amp2
+);
+extern void polar_to_CX
+(
+   long len,
+   const double * amp,
+   const double * phs,
+   wbool_t conjugate,
+   double * freq
+);
+extern void CX_mul
+(
+   long len, const double * x, const double * y, double * z
+);
+extern void CX_div (long len, const double * x, const double * y, double * z);
+extern void CX_abs (long len, const double * x, double * z);
+extern void CX_puckette_lock (long len, const double * y, double * z);
+extern void CX_complex_phase_vocoder
+(
+   int len,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+);
+extern void CX_split_stereo
+(
+   long len,
+   const double * z,
+   double * left,
+   double * right
+);
+
+#endif         /* WAONC_CX_H_ */
+
+/*
+ * cx.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
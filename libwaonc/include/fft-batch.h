@@ -0,0 +1,119 @@
+#ifndef WAONC_FFT_BATCH_H_
+#define WAONC_FFT_BATCH_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : batched FFT of several frames
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          fft-batch.h
+ *
+ *    This module provides the transform of several frames with a single
+ *    FFTW plan.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The frames are windowed into the rows of one contiguous matrix, and
+ *    all of the rows are transformed by one fftw_plan_many_r2r() (or
+ *    fftw_plan_many_dft_r2c()) plan, which lets FFTW interleave the
+ *    transforms.  The power and phase conversions run over the rows of
+ *    the output matrix in the same way.  The typical use is:
+ *
+ *       -# fft_batch_load() for rows 0 to n-1 (n <= count).
+ *       -# fft_batch_execute().
+ *       -# fft_batch_amp2() or fft_batch_polar2() for the n rows.
+ */
+
+#include "fft.h"                       /* filter_window_t, FFTW headers       */
+#include "macros.h"                    /* wbool_t and errprint() macros       */
+
+/**
+ *    Holds the input and output matrices and the plan for a batch of
+ *    frames.  The in[] matrix is [count][len]; the out[] matrix is
+ *    [count][spec_len], in half-complex layout (see hc.h) or, if r2c is
+ *    set, in interleaved-complex layout (see cx.h).
+ */
+
+typedef struct
+{
+   long len;               /*<< The FFT length (samples in one frame).        */
+   int count;              /*<< The number of frames (rows) of the batch.     */
+   wbool_t r2c;            /*<< Interleaved (r2c) rather than half-complex.   */
+   long spec_len;          /*<< Doubles in one output row, len or CX_LENGTH.  */
+   filter_window_t flag_window; /*<< The window; may change between batches.  */
+   double * in;            /*<< The windowed frames, [count][len].            */
+   double * out;           /*<< The spectra, [count][spec_len].               */
+#ifdef FFTW2
+   rfftw_plan plan;        /*<< The plan, run with howmany = count.           */
+#else
+   fftw_plan plan;         /*<< The "many" plan for all of the rows.          */
+#endif
+
+} waon_fft_batch_t;
+
+/*
+ * Global functions for the fft-batch module.
+ */
+
+extern waon_fft_batch_t * fft_batch_create
+(
+   long len,
+   int count,
+   filter_window_t flag_window,
+   wbool_t r2c
+);
+extern void fft_batch_free (waon_fft_batch_t * batch);
+extern void fft_batch_load
+(
+   waon_fft_batch_t * batch,
+   int k,
+   const double * x
+);
+extern void fft_batch_execute (waon_fft_batch_t * batch);
+extern const double * fft_batch_spectrum
+(
+   const waon_fft_batch_t * batch,
+   int k
+);
+extern void fft_batch_amp2
+(
+   const waon_fft_batch_t * batch,
+   int n,
+   double scale,
+   double * amp2
+);
+extern void fft_batch_polar2
+(
+   const waon_fft_batch_t * batch,
+   int n,
+   double scale,
+   double * amp2,
+   double * phs
+);
+
+#endif         /* WAONC_FFT_BATCH_H_ */
+
+/*
+ * fft-batch.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
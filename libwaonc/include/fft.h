@@ -161,6 +161,35 @@ extern void apply_FFT
    double * amp,
    double * phs
 );
+extern fftw_plan plan_FFT_stereo (int len, double * in, double * out);
+extern void windowed_FFT_stereo
+(
+   int len,
+   const double * left,
+   const double * right,
+   filter_window_t flag_window,
+   fftw_plan plan,
+   double * in,
+   double * out,
+   wbool_t r2c,
+   double * f_left,
+   double * f_right
+);
+extern void apply_FFT_stereo
+(
+   int len,
+   const double * left,
+   const double * right,
+   filter_window_t flag_window,
+   fftw_plan plan,
+   double * in,
+   double * out,
+   double scale,
+   double * l_amp,
+   double * l_phs,
+   double * r_amp,
+   double * r_phs
+);
 extern double init_den (int n, filter_window_t flag_window);
 extern void power_spectrum_fftw
 (
@@ -176,8 +205,14 @@ extern void power_spectrum_fftw
    fftw_plan plan
 #endif
 );
-extern void power_subtract_ave (int n, double * p, int m, double factor);
-extern void power_subtract_octave (int n, double * p, double factor);
+extern void power_subtract_ave
+(
+   int n, double * p, int m, double factor, double * ave
+);
+extern void power_subtract_octave
+(
+   int n, double * p, double factor, double * oct
+);
 
 #endif         /* WAONC_FFT_H_ */
 
@@ -0,0 +1,97 @@
+#ifndef WAONC_HC_SIMD_H_
+#define WAONC_HC_SIMD_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : vectorized half-complex kernels
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          hc-simd.h
+ *
+ *    This module provides SIMD versions of the two half-complex kernels
+ *    at the core of pv_complex, HC_complex_phase_vocoder() and
+ *    HC_puckette_lock().
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The instruction set is picked at run time, the first time a kernel
+ *    is called:  AVX2 or SSE2 on x86, NEON on 64-bit ARM, and otherwise a
+ *    one-pass scalar loop.  The routines of hc.c are left as they are, and
+ *    serve as the reference.
+ */
+
+#include "macros.h"                    /* wbool_t */
+
+/**
+ *    Provides the instruction sets of the kernels.
+ *
+ * @var HC_SIMD_NONE
+ *    The one-pass scalar loop, with a square root and a division per bin.
+ *
+ * @var HC_SIMD_SSE2
+ *    Two bins at a time (x86).
+ *
+ * @var HC_SIMD_AVX2
+ *    Four bins at a time (x86).
+ *
+ * @var HC_SIMD_NEON
+ *    Two bins at a time (AArch64).
+ *
+ * @var HC_SIMD_MAX
+ *    One greater than the last instruction set.
+ */
+
+typedef enum
+{
+   HC_SIMD_NONE,
+   HC_SIMD_SSE2,
+   HC_SIMD_AVX2,
+   HC_SIMD_NEON,
+   HC_SIMD_MAX
+
+} hc_simd_t;
+
+/*
+ * Global functions for the hc-simd module.
+ */
+
+extern hc_simd_t hc_simd_best (void);
+extern hc_simd_t hc_simd_level (void);
+extern wbool_t hc_simd_set_level (hc_simd_t level);
+extern const char * hc_simd_name (hc_simd_t level);
+extern void HC_complex_phase_vocoder_simd
+(
+   int len,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+);
+extern void HC_puckette_lock_simd (long len, const double * y, double * z);
+
+#endif         /* WAONC_HC_SIMD_H_ */
+
+/*
+ * hc-simd.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -95,6 +95,13 @@ extern void HC_complex_phase_vocoder
    const double * f_out_old,
    double * f_out
 );
+extern void HC_split_stereo
+(
+   long len,
+   const double * z,
+   double * left,
+   double * right
+);
 
 #endif         /* WAONC_HC_H */
 
@@ -0,0 +1,64 @@
+#ifndef WAONC_JACK_CLIENT_H_
+#define WAONC_JACK_CLIENT_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : JACK client setup
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          jack-client.h
+ *
+ *    This module provides the JACK client setup shared by the programs
+ *    that play or capture through JACK.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The setup is the one of the pvc JACK player:  open the client and
+ *    report what the server did, register the ports and the callbacks,
+ *    activate the client, and then connect the ports to the physical
+ *    ones.  The functions report their errors and return, so that the
+ *    caller decides whether to exit.
+ */
+
+#include <jack/jack.h>                 /* jack_client_t, jack_port_t          */
+
+#include "macros.h"                    /* wbool_t                             */
+
+/*
+ * Global functions for the jack-client module.
+ */
+
+extern jack_client_t * waon_jack_open (const char * name);
+extern wbool_t waon_jack_connect_physical
+(
+   jack_client_t * client,
+   jack_port_t * port,
+   wbool_t is_output
+);
+
+#endif         /* WAONC_JACK_CLIENT_H_ */
+
+/*
+ * jack-client.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,139 @@
+#ifndef WAONC_LIVE_H_
+#define WAONC_LIVE_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : live analysis
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          live.h
+ *
+ *    This module runs stages 1 and 2 of processing() (the power spectrum
+ *    and the note picking) on a stream of samples, one hop at a time, for
+ *    live input.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Everything is allocated by live_create(), so that live_step() can run
+ *    on a thread that must not wait on the allocator.  The power spectrum
+ *    and the phase differences of each frame are kept in the form of the
+ *    spectrogram engine (see spg_columns_compute()), so that a monitor can
+ *    draw them with spg_render_column().
+ *
+ *    The drum and octave removals (--psub-n, --oct) allocate, and are not
+ *    applied.
+ *
+ *    live_notes_check() decides the note-on and note-off events of the
+ *    last frame as WAON_notes_check() does, but keeps only the state of
+ *    the sounding notes, so that it does not allocate either.
+ */
+
+#include "analyse.h"                   /* analysis_scratchpad_t               */
+#include "fft-batch.h"                 /* waon_fft_batch_t                    */
+#include "macros.h"                    /* wbool_t, MIDI_NOTE_COUNT            */
+#include "parameters.h"                /* waon_parameters_t                   */
+
+/**
+ *    The most events of one frame:  an off and an on for each note.
+ */
+
+#define LIVE_EVENTS_MAX         (2 * MIDI_NOTE_COUNT)
+
+/**
+ *    Holds a note-on or note-off event of live_notes_check(), in the
+ *    encoding of waon_notes_t.
+ */
+
+typedef struct
+{
+   char event;             /*<< The event type (0 == off, 1 == on).           */
+   char note;              /*<< The MIDI note number (0-127).                 */
+   char vel;               /*<< The velocity of the note (0-127).             */
+
+} waon_live_event_t;
+
+/**
+ *    Holds the state of the live analysis.
+ */
+
+typedef struct
+{
+   long fft_len;           /*<< The FFT length.                               */
+   long hop;               /*<< The samples of one step.                      */
+   int samplerate;         /*<< The rate of the input.                        */
+   wbool_t flag_phase;     /*<< Correct the frequencies by the phase.         */
+   double cut_ratio;       /*<< The log10 of the absolute cutoff.             */
+   double rel_cut_ratio;   /*<< The log10 of the cutoff relative to the mean. */
+   analysis_scratchpad_t scratchpad; /*<< A copy, with the abs_flg.           */
+   int i0, i1;             /*<< The bins searched for notes.                  */
+   double t0;              /*<< The duration of a frame.                      */
+   double den;             /*<< The weight of the window, see init_den().     */
+   double gate;            /*<< The mean-square of a silent frame, or 0.      */
+   waon_fft_batch_t * batch; /*<< One row.                                    */
+   double * frame;         /*<< [fft_len], the last fft_len samples.          */
+   double * phs;           /*<< [nbin], the phases of the frame.              */
+   double * ph0;           /*<< [nbin], the phases of the frame before.       */
+   wbool_t have_ph0;       /*<< ph0[] holds the frame a hop before.           */
+   double * fp;            /*<< [nbin], the corrected frequencies [Hz].       */
+   double * power;         /*<< [nbin], scratch of note_intensity().          */
+   long step;              /*<< The frames analysed so far.                   */
+   double mean_square;     /*<< The mean-square of the last frame.            */
+   double * amp2;          /*<< [nbin], the power of the last frame, scaled   */
+                           /*<< by the FFT length as in the spectrogram.      */
+   double * dphi;          /*<< [nbin], its frequency corrections [cycles per */
+                           /*<< sample], 0 without flag_phase.                */
+   char vel[MIDI_NOTE_COUNT]; /*<< The velocities of the notes of the last    */
+                           /*<< frame, 0 for none.                            */
+   int on_vel[MIDI_NOTE_COUNT]; /*<< The velocity of each sounding note, or   */
+                           /*<< WAON_UNINITIALIZED if it is off.              */
+
+} waon_live_t;
+
+/*
+ * Global functions for the live module.
+ */
+
+extern waon_live_t * live_create
+(
+   const waon_parameters_t * parameters,
+   const analysis_scratchpad_t * scratchpad,
+   int samplerate
+);
+extern void live_step (waon_live_t * live, const float * x);
+extern int live_notes_check
+(
+   waon_live_t * live,
+   int on_threshold,
+   int off_threshold,
+   int peak_threshold,
+   waon_live_event_t * events
+);
+extern int live_notes_off (waon_live_t * live, waon_live_event_t * events);
+extern void live_free (waon_live_t * live);
+
+#endif         /* WAONC_LIVE_H_ */
+
+/*
+ * live.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
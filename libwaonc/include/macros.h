@@ -58,6 +58,8 @@
 #define DEFAULT_USE_PHASE                 wtrue
 #define DEFAULT_USE_ABSOLUTE_CUTOFF       wtrue
 #define DEFAULT_PEAK_THRESHOLD_DISABLED   128
+#define DEFAULT_FFT_BATCH                   16
+#define DEFAULT_USE_ENERGY_GATE           wtrue
 
 /**
  *    The default top and bottom notes are defined for a 76-key piano.
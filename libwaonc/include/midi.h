@@ -32,15 +32,12 @@
 
 typedef struct
 {
-   double mp_adj_pitch;
-   double mp_pitch_shift;
-   int mp_n_pitch;
    double mp_mid2freq[MIDI_NOTE_COUNT];
 
 } midi_pitch_t;
 
 /*
- * For estimating pitch shift.
+ * The frequencies of the MIDI notes; read only.
  */
 
 extern midi_pitch_t g_midi_pitch_info;
@@ -58,7 +55,7 @@ extern int logf_to_midi (double logf);
  * Get standard MIDI note from frequency.
  */
 
-extern int get_note (double freq);
+extern int get_note (double freq, double adj_pitch);
 extern int smf_header_fmt
 (
    int fd,
@@ -90,6 +87,13 @@ extern int write_var_len (int fd, long value);
 extern int read_var_len (int fd, long * value);
 extern int wblong (int fd, unsigned long ul);
 extern int wbshort (int fd, unsigned short us);
+extern int WAON_notes_write_midi
+(
+   waon_notes_t * notes,
+   double div,
+   int fd,
+   wbool_t seekable
+);
 extern void WAON_notes_output_midi
 (
    waon_notes_t * notes,
@@ -0,0 +1,117 @@
+#ifndef WAONC_NOTE_BANK_H_
+#define WAONC_NOTE_BANK_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : note-bank analysis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          note-bank.h
+ *
+ *    This module provides a bank of Goertzel filters, one per MIDI note,
+ *    as an alternative to the full FFT for narrow note ranges.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    When only a handful of notes are of interest (e.g. an octave or two
+ *    selected with --bottom and --top), evaluating the spectrum only at
+ *    the note frequencies (and, optionally, a few of their harmonics) is
+ *    cheaper than a full fft_len FFT followed by a scan over all of the
+ *    bins.  The output of the bank is a velocity array, just like the one
+ *    produced by note_intensity(), so it feeds WAON_notes_check() as is.
+ */
+
+#include "macros.h"                    /* wbool_t and errprint() macros       */
+#include "fft.h"                       /* filter_window_t                     */
+
+/**
+ *    Defines the maximum number of harmonics that can be folded into the
+ *    power of each note of the bank.
+ */
+
+#define NOTE_BANK_HARMONICS_MAX           8
+
+/**
+ *    Holds the precomputed filter coefficients and the window for a bank
+ *    of Goertzel filters covering the MIDI notes [note_low, note_top].
+ */
+
+typedef struct
+{
+   int note_low;           /*<< The lowest MIDI note covered by the bank.     */
+   int note_top;           /*<< The highest MIDI note covered by the bank.    */
+   int count;              /*<< Number of notes, note_top - note_low + 1.     */
+   int harmonics;          /*<< Number of partials per note, including f0.    */
+   long len;               /*<< The number of samples in one analysis frame.  */
+   double den;             /*<< The window weight, from init_den().           */
+   double * window;        /*<< The precomputed window function [len].        */
+   double * coeff;         /*<< 2 cos(w) for each [count][harmonics] filter.  */
+   double * weight;        /*<< The weight of each [count][harmonics] filter. */
+   double * power;         /*<< Scratch: the power of each note [count].      */
+
+} waon_note_bank_t;
+
+/*
+ * Global functions for the note-bank module.
+ */
+
+extern waon_note_bank_t * note_bank_create
+(
+   int note_low,
+   int note_top,
+   int harmonics,
+   long len,
+   double samplerate,
+   filter_window_t flag_window,
+   double adj_pitch
+);
+extern void note_bank_free (waon_note_bank_t * bank);
+extern void note_bank_power
+(
+   waon_note_bank_t * bank,
+   const double * x
+);
+extern void note_bank_pick
+(
+   const waon_note_bank_t * bank,
+   double cut_ratio,
+   double rel_cut_ratio,
+   wbool_t abs_flg,
+   char * intens
+);
+extern void note_bank_intensity
+(
+   waon_note_bank_t * bank,
+   const double * x,
+   double cut_ratio,
+   double rel_cut_ratio,
+   wbool_t abs_flg,
+   char * intens
+);
+
+#endif         /* WAONC_NOTE_BANK_H_ */
+
+/*
+ * note-bank.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -30,7 +30,7 @@
  * \library       waonc application
  * \author        Chris Ahlstrom
  * \date          2013-11-23
- * \updates       2013-11-29
+ * \updates       2026-10-18
  * \version       $Revision$
  * \license       GNU GPL
  *
@@ -50,19 +50,26 @@
       -i          file_wav
       -o          file_midi
       -p          file_patch
+      --sweep     file_sweep
+      --spec-cache file_spec_cache
       -c          cut_ratio
       -r          rel_cut_ratio (affects abs_flg as well)
       -t          note_top
       -b          note_low
       -w          flag_window (e.g. 3 for Hanning)
       -n          fft_len
+      --r2c       fft_r2c (wbool_t)
+      --batch     fft_batch
       -s          shift_hop
       -k          peak_threshold
+      --no-gate   energy_gate (wbool_t)
       --nophase   flag_phase (wbool_t)
       --psub-n    psub_n
       --psub-f    psub_f
       --oct       oct_f
-      -a          g_midi_pitch_info.mp_adj_pitch
+      -a          adj_pitch
+      --note-bank note_bank (wbool_t)
+      --harmonics bank_harmonics
 @endverbatim
  *
  * Others:
@@ -81,9 +88,14 @@ typedef struct
    char * file_midi;       /*<< Holds the name of the output MIDI file.       */
    char * file_wav;        /*<< Holds the name of the input WAV file.         */
    char * file_patch;      /*<< Holds the name of the optional patch file.    */
+   char * file_sweep;      /*<< Holds the name of the optional sweep file.    */
+   char * file_spec_cache; /*<< Holds the name of the optional .waonspec.     */
    double cut_ratio;       /*<< Holds the absolute log10 cutoff-ratio value.  */
    double rel_cut_ratio;   /*<< Holds the relative log10 cutoff-ratio value.  */
    long fft_len;           /*<< Provides the length of the FFT window.        */
+   wbool_t fft_r2c;        /*<< Use the r2c (interleaved) FFT, not R2HC.      */
+   int fft_batch;          /*<< Number of frames transformed by one plan.     */
+   wbool_t energy_gate;    /*<< Skip the FFT of frames below the cutoff.      */
    int flag_window;        /*<< The type of FFT window (Hanning by default)   */
    int notelow;            /*<< Indicates the lowest MIDI note to be created. */
    int notetop;            /*<< Indicates the highest MIDI note to create.    */
@@ -93,8 +105,10 @@ typedef struct
    int psub_n;             /*<< TBD.                                          */
    double psub_f;          /*<< TBD.                                          */
    double oct_f;           /*<< TBD.                                          */
-   double adj_pitch;       /*<< TBD.                                          */
+   double adj_pitch;       /*<< The pitch adjustment, in semitones.           */
    wbool_t abs_flg;        /*<< Indicates to use absolute/relative cutoff.    */
+   wbool_t note_bank;      /*<< Use Goertzel note bank instead of the FFT.    */
+   int bank_harmonics;     /*<< Number of partials per note in the bank.      */
    wbool_t dump_bins;      /*<< Indicates to dump a count of each MIDI note.  */
    wbool_t dump_events;    /*<< Indicates to dump the events to the screen.   */
    wbool_t show_help;      /*<< Indicates to show the help text.              */
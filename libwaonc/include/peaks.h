@@ -0,0 +1,167 @@
+#ifndef WAONC_PEAKS_H_
+#define WAONC_PEAKS_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : waveform peak pyramid
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          peaks.h
+ *
+ *    This module provides the minimum, maximum, and RMS of the samples of
+ *    any range of a sound file, from a pyramid of the values of blocks,
+ *    so that a zoomed-out waveform is drawn without reading every sample.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Level 0 of the pyramid holds one entry per PEAKS_BASE frames, and
+ *    each level above holds one entry per two entries of the level below,
+ *    up to a level of one entry.  An entry holds, for each channel kept
+ *    by the snd_cache_t (see snd-cache.h):
+ *
+@verbatim
+      float min;                 the smallest sample
+      float max;                 the largest sample
+      float mean_square;         the mean of the squares of the samples
+@endverbatim
+ *
+ *    peaks_range() covers a range with at most two entries per level, and
+ *    reads the frames at its ends that do not fill an entry of level 0
+ *    from the snd_cache_t; it costs O(log(len) + PEAKS_BASE).
+ *
+ *    The pyramid can be saved in a ".waonpeak" file beside the sound
+ *    file: a waon_peaks_header_t followed by the levels from 0 up, in
+ *    native byte order.  The entry count in the header is written last,
+ *    so that a file that was not finished has a count of 0 and is
+ *    rejected.  The file is read by mapping it into memory.
+ */
+
+#include <stdint.h>                    /* int32_t, int64_t                    */
+
+#include "macros.h"                    /* wbool_t                             */
+#include "snd-cache.h"                 /* snd_cache_t                         */
+
+/**
+ *    Provides the magic bytes and the version of the format.
+ */
+
+#define PEAKS_MAGIC                    "WAONPEAK"
+#define PEAKS_VERSION                  1
+
+/**
+ *    Provides the extension that gwaonc appends to the name of a sound
+ *    file to find its peak file.
+ */
+
+#define PEAKS_EXTENSION                ".waonpeak"
+
+/**
+ *    The frames of an entry of level 0.
+ */
+
+#define PEAKS_BASE                     256
+
+/**
+ *    The most levels, enough for 2^62 frames.
+ */
+
+#define PEAKS_LEVELS_MAX               56
+
+/**
+ *    The floats of an entry, per channel.
+ */
+
+#define PEAKS_VALUES                   3
+
+/**
+ *    Holds the header of a peak file.  It doubles as the key that a file
+ *    must match to be used.
+ */
+
+typedef struct
+{
+   char magic[8];          /*<< PEAKS_MAGIC, not null-terminated.             */
+   int32_t version;        /*<< PEAKS_VERSION.                                */
+   int32_t header_size;    /*<< sizeof(waon_peaks_header_t).                  */
+   int32_t base;           /*<< PEAKS_BASE.                                   */
+   int32_t samplerate;     /*<< The sample rate of the source.                */
+   int32_t channels;       /*<< The channel count of the source.              */
+   int32_t reserved;       /*<< 0, for the alignment of what follows.         */
+   int64_t source_frames;  /*<< The length of the source, in frames.          */
+   int64_t source_mtime;   /*<< Modification time of the source, or 0.        */
+   int64_t entry_count;    /*<< The entries of all of the levels.             */
+
+} waon_peaks_header_t;
+
+/**
+ *    Holds a pyramid, either built or mapped from a file.
+ */
+
+typedef struct
+{
+   waon_peaks_header_t header;
+   snd_cache_t * snd;      /*<< The samples, for the ends of a range.         */
+   int levels;             /*<< The number of levels.                         */
+   long count[PEAKS_LEVELS_MAX];          /*<< The entries of each level.     */
+   const float * level[PEAKS_LEVELS_MAX]; /*<< The first entry of each level. */
+   float * data;           /*<< The entries, if built.                        */
+   void * map;             /*<< The mapped file, if read.                     */
+   size_t map_size;        /*<< The size of the mapping.                      */
+   double * left;          /*<< [PEAKS_BASE], for peaks_range().              */
+   double * right;         /*<< [PEAKS_BASE], for peaks_range().              */
+
+} waon_peaks_t;
+
+/*
+ * Global functions for the peaks module.
+ */
+
+extern waon_peaks_t * peaks_build
+(
+   snd_cache_t * snd,
+   const char * source
+);
+extern waon_peaks_t * peaks_open
+(
+   const char * name,
+   snd_cache_t * snd,
+   const char * source
+);
+extern wbool_t peaks_save (const waon_peaks_t * peaks, const char * name);
+extern long peaks_range
+(
+   waon_peaks_t * peaks,
+   long start,
+   long len,
+   double * min,
+   double * max,
+   double * rms
+);
+extern void peaks_free (waon_peaks_t * peaks);
+
+#endif         /* WAONC_PEAKS_H_ */
+
+/*
+ * peaks.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
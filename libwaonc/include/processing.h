@@ -1,3 +1,6 @@
+#ifndef WAONC_PROCESSING_H_
+#define WAONC_PROCESSING_H_
+
 /*
  * WaoN - a Wave-to-Notes transcriber : processing
  *
@@ -28,7 +31,7 @@
  * \library       waonc application
  * \author        Chris Ahlstrom
  * \date          2013-11-24
- * \updates       2013-11-28
+ * \updates       2026-10-18
  * \version       $Revision$
  * \license       GNU GPL
  *
@@ -37,18 +40,92 @@
  *
  *    The processing() function requires a new "scratchpad" parameter that
  *    takes the place of using global variables.
+ *
+ *    The transcription itself is done by processing_run(), with the
+ *    buffers, the FFTW plan, and the patch of a waon_processing_t.  The
+ *    engine keeps them from one run to the next, and processing_prepare()
+ *    makes them again only when the FFT length, the batch, the window, or
+ *    the patch change.  A program that transcribes many inputs, such as
+ *    waoncd, plans once per engine.  processing() is the run of waonc:
+ *    one file in, one MIDI file per parameter set out.
+ */
+
+#include <sndfile.h>                   /* SNDFILE, SF_INFO                    */
+
+#include "analyse.h"                   /* analysis_scratchpad_t               */
+#include "fft-batch.h"                 /* waon_fft_batch_t                    */
+#include "parameters.h"                /* waon_parameters_t                   */
+#include "sweep.h"                     /* waon_sweep_t                        */
+
+/**
+ *    Holds the buffers, the FFTW plan, and the patch of processing_run(),
+ *    and the key they were made for.
  */
 
+typedef struct
+{
+   long fft_len;           /*<< The FFT length, 0 until prepared.             */
+   int nbatch;             /*<< The frames transformed together.              */
+   int flag_window;        /*<< The window of the plan.                       */
+   wbool_t fft_r2c;        /*<< The layout of the plan.                       */
+   wbool_t note_bank;      /*<< No plan for the note bank.                    */
+   char * file_patch;      /*<< The patch loaded, or null.                    */
+   waon_fft_batch_t * batch; /*<< The plan, null with the note bank.          */
+   double * left;          /*<< [fft_len], the left or mono channel.          */
+   double * right;         /*<< [fft_len], the right channel.                 */
+   double * x;             /*<< [fft_len], the frame for the FFT.             */
+   double * pb;            /*<< [nbatch][nbin], the power of the batch.       */
+   double * phb;           /*<< [nbatch][nbin], the phase of the batch.       */
+   double * p0;            /*<< [nbin], the power of the frame before.        */
+   double * dphi;          /*<< [nbin], the phase correction.                 */
+   double * ph0;           /*<< [nbin], the phase of the frame before.        */
+   double * held;          /*<< [fft_len], the last gated frame.              */
+   double * frames;        /*<< [fft_len][channels], the samples as read.     */
+   int channels;           /*<< The channels the frames buffer has room for.  */
+
+} waon_processing_t;
+
+/**
+ *    Holds the figures of a run of processing_run().
+ */
+
+typedef struct
+{
+   long div;               /*<< The MIDI divisions of a beat (120 BPM).       */
+   int frames;             /*<< The frames analysed.                          */
+   int gated;              /*<< The frames the energy gate skipped.           */
+
+} waon_processing_stats_t;
+
 /*
  * Global functions for the processing module.
  */
 
+extern waon_processing_t * processing_create (void);
+extern wbool_t processing_prepare
+(
+   waon_processing_t * engine,
+   const waon_parameters_t * parameters,
+   analysis_scratchpad_t * scratchpad
+);
+extern wbool_t processing_run
+(
+   waon_processing_t * engine,
+   const waon_parameters_t * parameters,
+   waon_sweep_t * sweep,
+   SNDFILE * sf,
+   const SF_INFO * sfinfo,
+   waon_processing_stats_t * stats
+);
+extern void processing_free (waon_processing_t * engine);
 extern wbool_t processing
 (
    waon_parameters_t * parameters,
    analysis_scratchpad_t * analysis_scratchpad
 );
 
+#endif         /* WAONC_PROCESSING_H_ */
+
 /*
  * processing.h
  *
@@ -24,6 +24,7 @@
 #include "pv-complex.h" /* struct pv_complex */
 
 /* play 100 milisecond and return
+ * (with the output queue, play until the queue is full)
  * INPUT
  *  pv        : struct pv_complex
  *  play_cur  : current frame
@@ -36,8 +37,12 @@ play_100msec_curses (struct pv_complex *pv,
 		     long frame0, long frame1);
 
 /* phase vocoder by complex arithmetics with fixed hops.
+ * INPUT
+ *  latency_ms : length of the output queue to the ao device
+ *               (0 == AO_QUEUE_LATENCY_MS, see ao-wrapper.h)
  */
 void pv_complex_curses (const char *file,
-			long len, long hop_syn);
+			long len, long hop_syn,
+			long latency_ms);
 
 #endif /* !_PV_COMPLEX_CURSES_H_ */
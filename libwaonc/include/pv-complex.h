@@ -25,6 +25,27 @@
 #include <ao/ao.h> /* ao device */
 
 #include "snd.h"
+#include "ao-wrapper.h" /* ao_queue_t */
+#include "pv-engine.h" /* pv_engine_input_t */
+#include "pv-resample.h" /* pv_resample_t */
+
+/* frames in the spectrum cache of pv_complex_init(): enough for the
+ * terminal frame of a hop to be the starting frame of the next one */
+#define PV_COMPLEX_CACHE_FRAMES (4)
+
+/* frames in the spectrum cache of the interactive players, so that a
+ * loop of a few seconds is transformed only once */
+#define PV_COMPLEX_CACHE_LOOP_FRAMES (512)
+
+/* one entry of the spectrum cache (see read_and_FFT_stereo()) */
+struct pv_complex_frame
+{
+  long frame;         /* position in the input, or -1 if unused */
+  int flag_window;    /* window of the spectra */
+  unsigned long used; /* pv->cache_clock at the last use (LRU) */
+  double *left;       /* spectra in the layout of pv->flag_r2c */
+  double *right;
+};
 
 struct pv_complex
 {
@@ -36,11 +57,14 @@ struct pv_complex
   int flag_out; /* 0 = ao, 1 = sf */
 
   ao_device *ao;
+  ao_queue_t *aoq; /* if set, ao is played through this queue */
 
   SNDFILE *sfout;
   SF_INFO *sfout_info;
 
   long len; /* FFT length */
+  int flag_r2c;  /* 0 = half-complex (R2HC) spectra, 1 = interleaved (r2c) */
+  long spec_len; /* number of doubles in one spectrum: len or CX_LENGTH(len) */
 
   long hop_ana;
   long hop_syn;
@@ -53,6 +77,11 @@ struct pv_complex
   double *freq;
   fftw_plan plan;
 
+  /* both channels in one complex FFT (see read_and_FFT_stereo()) */
+  double *st_in;  /* (left, right) as (real, imag), [2 * len] */
+  double *st_out; /* [2 * len] */
+  fftw_plan plan_stereo;
+
   double *t_out;
   double *f_out;
   fftw_plan plan_inv;
@@ -67,11 +96,47 @@ struct pv_complex
   double *r_out;
 
   int flag_lock; /* 0 = no phase lock, 1 = loose phase lock */
+
+  /* input queue of the engine interface; if set, it is read instead
+   * of sf (see pv_complex_read_at()) */
+  pv_engine_input_t *input;
+
+  /* samplerate conversion for the pitch-shift (pv_complex_resample()),
+   * streaming from hop to hop (see pv-resample.h) */
+  int src_quality; /* converter type of libsamplerate (SRC_SINC_FASTEST) */
+  pv_resample_t *resample; /* NULL until the first conversion */
+  double *l_res; /* the resampled hop of pv_complex_play_resample() */
+  double *r_res; /* [res_len] */
+  long res_len;
+
+  /* work arrays of read_and_FFT_stereo() and pv_nofft_synth_step(),
+   * [len] */
+  double *l_read;
+  double *r_read;
+
+  /* work arrays of pv_complex_synth_step(), [CX_LENGTH (len)] */
+  double *l_fs;
+  double *r_fs;
+  double *l_ft;
+  double *r_ft;
+  double *l_tmp;
+  double *r_tmp;
+
+  /* LRU cache of the spectra made by read_and_FFT_stereo() */
+  int n_cache;                     /* number of entries (0 == off) */
+  struct pv_complex_frame *cache;  /* [n_cache] */
+  unsigned long cache_clock;
+  unsigned long cache_hits;
+  unsigned long cache_misses;
 };
 
 
 /** utility routines for struct pv_omplex_data **/
 
+/* OUTPUT
+ *  returned value : the new struct pv_complex,
+ *                   or NULL if the memory is short
+ */
 struct pv_complex *
 pv_complex_init (long len, long hop_syn, int flag_window);
 
@@ -100,16 +165,85 @@ pv_complex_set_output_sf (struct pv_complex *pv,
 void
 pv_complex_set_output_ao (struct pv_complex *pv,
 			  ao_device *ao);
+/* play through the output thread of q (see ao-wrapper.h), so that
+ * pv_complex_play() blocks only when q is full */
+void
+pv_complex_set_output_ao_queue (struct pv_complex *pv,
+				ao_queue_t *q);
 
 void
 pv_complex_free (struct pv_complex *pv);
 
+/* select the layout of the spectra (and rebuild the FFTW plans)
+ * INPUT
+ *  flag_r2c : 0 == half-complex layout (FFTW_R2HC, hc.h routines)
+ *             1 == interleaved complex layout (r2c/c2r, cx.h routines)
+ * OUTPUT
+ *  pv->spec_len : number of doubles in the spectra passed around
+ *  pv->flag_left, pv->flag_right : reset, since [lr]_f_old[] are lost
+ */
+void
+pv_complex_set_r2c (struct pv_complex *pv, int flag_r2c);
+
+/* resize the spectrum cache (and empty it)
+ * INPUT
+ *  n : number of frames to keep (0 turns the cache off)
+ * OUTPUT
+ *  returned value : 1 on success,
+ *                   0 if the memory is short (the cache is off then)
+ */
+int
+pv_complex_set_cache (struct pv_complex *pv, int n);
+
+/* empty the spectrum cache, e.g. for a new input.
+ * the hit and miss counts are kept. */
+void
+pv_complex_clear_cache (struct pv_complex *pv);
+
+/* hit rate of the spectrum cache in percent (0 before any read) */
+double
+pv_complex_cache_hit_rate (const struct pv_complex *pv);
+
+/* Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]|
+ * by HC_complex_phase_vocoder_simd() or CX_complex_phase_vocoder(),
+ * according to pv->flag_r2c.
+ */
+void
+pv_complex_phase_vocoder (struct pv_complex *pv,
+			  const double *fs, const double *ft,
+			  const double *f_out_old, double *f_out);
+
+/* loose phase lock by HC_puckette_lock_simd() or CX_puckette_lock(),
+ * according to pv->flag_r2c.
+ */
+void
+pv_complex_puckette_lock (struct pv_complex *pv,
+			  const double *y, double *z);
+
+
+/* read [frame, frame + len] from pv->input if it is set,
+ * otherwise from pv->sf
+ * OUTPUT
+ *  returned value : frames read, or PV_ENGINE_MORE (see pv-engine.h)
+ */
+long
+pv_complex_read_at (struct pv_complex *pv,
+		    long frame,
+		    double *left, double *right,
+		    long len);
 
+/* the windowed spectra of both channels of the frame starting at
+ * "frame", from the spectrum cache if they are there
+ * OUTPUT
+ *  f_left[pv->spec_len], f_right[pv->spec_len] :
+ *  returned value : frames read (pv->len, unless at the end)
+ */
 long
 read_and_FFT_stereo (struct pv_complex *pv,
 		     long frame,
 		     double *f_left, double *f_right);
 /* the results are stored in out [i] for i = hop_syn to (hop_syn + len)
+ * f[pv->spec_len] is the spectrum in the layout given by pv->flag_r2c
  * INPUT
  *  scale : for safety (give 0.5, for example)
  */
@@ -117,8 +251,47 @@ void
 apply_invFFT_mono (struct pv_complex *pv,
 		   const double *f, double scale,
 		   double *out);
+/* apply_invFFT_mono() on the work arrays of the caller, so that
+ * two threads may run it at once with the plan pv->plan_inv.
+ * INPUT
+ *  f_out[CX_LENGTH (pv->len)], t_out[pv->len] : allocated by fftw_malloc()
+ */
+void
+apply_invFFT_mono_r (struct pv_complex *pv,
+		     const double *f, double scale,
+		     double *f_out, double *t_out,
+		     double *out);
+
+/* the synthesis spectrum of one channel for one hop
+ * INPUT
+ *  fs[spec_len], ft[spec_len] : spectra at s_i and t_i
+ *  flag : whether f_old[] is ready (1) or not (0)
+ *  f_old[spec_len] : Y[u_{i-1}], or Z[u_{i-1}] with the phase lock
+ * OUTPUT
+ *  y[spec_len] : Y[u_i], to be superimposed by apply_invFFT_mono()
+ *  f_old[spec_len] : backed up for the next step
+ *  returned value : 1 if y[] is made,
+ *                   0 if the channel is silent at s_i or t_i
+ */
+int
+pv_complex_channel_vocoder (struct pv_complex *pv,
+			    const double *fs, const double *ft,
+			    int *flag, double *f_old,
+			    double *y);
+/* select the converter for the pitch-shift (and reset its state)
+ * INPUT
+ *  quality : converter type of libsamplerate, from
+ *            SRC_SINC_BEST_QUALITY (0) to SRC_LINEAR (4)
+ * OUTPUT
+ *  returned value : 1 on success, 0 if quality is not a converter
+ */
+int
+pv_complex_set_resample_quality (struct pv_complex *pv, int quality);
+
 /* resample pv->[rl]_out[i] for i = 0 to pv->hop_syn
  *       to [left,right][i] for i = 0 to pv->hop_res
+ * by pv_resample_hop(), so that the output is continuous and late by
+ * a fixed latency.  it exits on failure, as the players do.
  * INPUT
  * OUTPUT
  */
@@ -135,6 +308,33 @@ pv_complex_resample (struct pv_complex *pv,
 int
 pv_complex_play_resample (struct pv_complex *pv);
 
+/* check whether the next hop can be played without waiting for the
+ * device, for the interactive players that also scan the keys
+ * OUTPUT
+ *  returned value : 0 if pv->aoq has no room for hop_res frames,
+ *                   1 otherwise (and always without a queue)
+ */
+int
+pv_complex_play_ready (struct pv_complex *pv);
+
+
+/* make one hop_syn by the phase vocoder, without playing it
+ * (see pv_complex_play_step())
+ * OUTPUT
+ *  pv->[lr]_out[0, hop_syn] : the frames to play, before the shift
+ *                             by pv_complex_shift_out()
+ *  returned value : pv->len on success, otherwise the status of
+ *                   read_and_FFT_stereo() (nothing is made then)
+ */
+long
+pv_complex_synth_step (struct pv_complex *pv,
+		       long cur);
+
+/* shift
+ * out[hop_syn, hop_syn + len] ==> out[0, len]
+ */
+void
+pv_complex_shift_out (struct pv_complex *pv);
 
 /* play one hop_syn by the phase vocoder:
  * phase vocoder by complex arithmetics with fixed hops.
@@ -166,6 +366,11 @@ pv_complex_play_step (struct pv_complex *pv,
  * INPUT
  *  flag_lock : 0 == no phase lock is applied
  *              1 == loose phase lock is applied
+ *  flag_r2c : 0 == half-complex FFT layout
+ *             1 == interleaved complex (r2c) FFT layout
+ *  src_quality : converter type of libsamplerate for the pitch-shift
+ *  flag_threads : 0 == one thread
+ *                 1 == pipeline of threads by pv_render() (outfile only)
  *  rate : time-streching rate
  *  pitch_shift : in the unit of half-note
  */
@@ -173,7 +378,10 @@ void pv_complex (const char *file, const char *outfile,
 		 double rate, double pitch_shift,
 		 long len, long hop_syn,
 		 int flag_window,
-		 int flag_lock);
+		 int flag_lock,
+		 int flag_r2c,
+		 int src_quality,
+		 int flag_threads);
 
 
 #endif /* !_PV_COMPLEX_H_ */
@@ -23,20 +23,6 @@
 
 /** general utility routines for pv **/
 
-/*
- * INPUT
- *  hop_res :
- *  hop_syn :
- *  l_out [hop_syn] :
- *  r_out [hop_syn] :
- *  ao, sfout, sfout_info : properties for output
- */
-int
-pv_play_resample (long hop_res, long hop_syn,
-		  double *l_out, double *r_out,
-		  ao_device *ao, SNDFILE *sfout, SF_INFO *sfout_info);
-
-
 /* estimate the superposing weight for the window with hop
  */
 double
@@ -45,11 +31,14 @@ get_scale_factor_for_window (int len, long hop_out, int flag_window);
 
 /* standard phase vocoder
  * Ref: J.Laroche and M.Dolson (1999)
+ * the engine is pv_conventional_engine (see pv-engine.h)
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
  */
-void pv_conventional (const char *file, const char *outfile,
-		      double rate, double pitch_shift,
-		      long len, long hop_syn,
-		      int flag_window);
+int pv_conventional (const char *file, const char *outfile,
+		     double rate, double pitch_shift,
+		     long len, long hop_syn,
+		     int flag_window);
 
 
 #endif /* !_PV_CONVENTIONAL_H_ */
@@ -23,11 +23,14 @@
 
 /* this routine is translated from Matlab script written by D.P.W.Ellis:
  *   http://www.ee.columbia.edu/~dpwe/resources/matlab/pvoc/
+ * the engine is pv_ellis_engine (see pv-engine.h)
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
  */
-void pv_ellis (const char *file, const char *outfile,
-	       double rate, double pitch_shift,
-	       long len, long hop,
-	       int flag_window);
+int pv_ellis (const char *file, const char *outfile,
+	      double rate, double pitch_shift,
+	      long len, long hop,
+	      int flag_window);
 
 
 #endif /* !_PV_ELLIS_H_ */
@@ -0,0 +1,257 @@
+#ifndef WAONC_PV_ENGINE_H_
+#define WAONC_PV_ENGINE_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : common interface of the phase vocoders
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-engine.h
+ *
+ *    This module provides one interface to all of the phase-vocoder
+ *    variants, so that they can be embedded and compared.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Each variant (pv-complex.c, pv-conventional.c, ...) provides a
+ *    pv_engine_ops_t table of four functions that work one hop at a time:
+ *
+ *       -  init():  allocates the state, or returns a null pointer if the
+ *          parameters do not suit the variant or the memory is short.
+ *       -  process_block():  reads the input frames it needs for the next
+ *          hop with pv_engine_input_read_at(), and makes the output frames
+ *          of the hop.  It returns PV_ENGINE_MORE if the frames are not
+ *          there yet, PV_ENGINE_END once the input is used up, and
+ *          PV_ENGINE_ERROR if it fails.
+ *       -  flush():  makes the frames left in the overlap-add buffers, or
+ *          returns PV_ENGINE_ERROR.
+ *       -  free():  frees the state.
+ *
+ *    A pv_engine_t drives the table for a caller that has blocks of
+ *    any size:  pv_engine_process_block() queues the input and runs the
+ *    hops, the pitch-shift resampling is done here for all variants (by
+ *    pv_resample_hop(), as for pv_complex_resample()), and
+ *    pv_engine_read() takes the output.  No function of the interface
+ *    exits the application:  init() and pv_engine_new() return a null
+ *    pointer, and the others return -1, if the memory is short.
+ */
+
+#include "pv-resample.h"               /* pv_resample_t, SRC_SINC_FASTEST     */
+
+#include "macros.h"                    /* wbool_t                             */
+
+/**
+ *    Returned by process_block() when the input does not reach the next
+ *    hop yet.
+ */
+
+#define PV_ENGINE_MORE                 (-1)
+
+/**
+ *    Returned by process_block() when the input is used up.
+ */
+
+#define PV_ENGINE_END                  (-2)
+
+/**
+ *    Returned by process_block() and flush() when they fail, e.g. when
+ *    the memory is short.
+ */
+
+#define PV_ENGINE_ERROR                (-3)
+
+/**
+ *    The number of frames pv_engine_render_file() reads at a time.
+ */
+
+#define PV_ENGINE_BLOCK                4096
+
+/**
+ *    Holds the parameters shared by all of the variants.  A variant
+ *    ignores those it has no use for.
+ */
+
+typedef struct
+{
+   long len;               /*<< The FFT length.                               */
+   long hop_syn;           /*<< The synthesis hop.                            */
+   double rate;            /*<< The speed (1 == same, larger is faster).      */
+   double pitch_shift;     /*<< In half-notes (0 == no shift).                */
+   int flag_window;        /*<< The window, see windowing() in fft.c.         */
+   int flag_lock;          /*<< The loose phase lock (complex variant).       */
+   int flag_r2c;           /*<< The r2c FFT layout (complex variant).         */
+   int src_quality;        /*<< The libsamplerate converter for the pitch.    */
+
+} pv_engine_params_t;
+
+/**
+ *    Holds what init() tells the driver about the output of a variant.
+ */
+
+typedef struct
+{
+   long block;             /*<< Most frames made by one process_block().      */
+   long hop_res;           /*<< Frames of a block after the resampling;       */
+                           /*<< equal to block if there is none.              */
+   long tail;              /*<< Most frames made by flush().                  */
+
+} pv_engine_shape_t;
+
+/**
+ *    Holds the queue of input frames.  The frames from start to start +
+ *    count - 1 are in left[offset] and right[offset] onward.
+ */
+
+typedef struct
+{
+   double * left;
+   double * right;
+   long size;              /*<< Allocated frames.                             */
+   long offset;            /*<< Index of the first queued frame.              */
+   long count;             /*<< Queued frames.                                */
+   long start;             /*<< Input frame of left[offset].                  */
+   long keep;              /*<< First frame the variant may still read; set   */
+                           /*<< by process_block(), 0 keeps everything.       */
+   wbool_t eof;            /*<< No more frames will be queued.                */
+
+} pv_engine_input_t;
+
+/**
+ *    Provides the functions of one variant.
+ */
+
+typedef struct
+{
+   const char * name;
+   const char * description;
+   void * (* init)
+   (
+      const pv_engine_params_t * params,
+      pv_engine_shape_t * shape
+   );
+   long (* process_block)
+   (
+      void * state,
+      pv_engine_input_t * in,
+      double * left,
+      double * right
+   );
+   long (* flush) (void * state, double * left, double * right);
+   void (* free) (void * state);
+
+} pv_engine_ops_t;
+
+/**
+ *    Holds a variant with its input and output queues.
+ */
+
+typedef struct
+{
+   const pv_engine_ops_t * ops;
+   void * state;
+   pv_engine_params_t params;
+   pv_engine_shape_t shape;
+   pv_engine_input_t in;
+   double * l_hop;         /*<< One block of the variant, [shape.block].      */
+   double * r_hop;
+   double * l_out;         /*<< Output not read yet, from out_offset on.      */
+   double * r_out;
+   long out_size;
+   long out_offset;
+   long out_count;
+   wbool_t ended;          /*<< process_block() returned PV_ENGINE_END.       */
+   wbool_t flushed;
+   pv_resample_t * resample; /*<< The pitch-shift converter, if needed.       */
+
+} pv_engine_t;
+
+/*
+ * Global functions for the pv-engine module.
+ */
+
+extern void pv_engine_params_init (pv_engine_params_t * params);
+extern const pv_engine_ops_t * pv_engine_list (int index);
+extern const pv_engine_ops_t * pv_engine_find (const char * name);
+extern pv_engine_t * pv_engine_new
+(
+   const pv_engine_ops_t * ops,
+   const pv_engine_params_t * params
+);
+extern long pv_engine_process_block
+(
+   pv_engine_t * e,
+   const double * left,
+   const double * right,
+   long n
+);
+extern long pv_engine_flush (pv_engine_t * e);
+extern long pv_engine_read
+(
+   pv_engine_t * e,
+   double * left,
+   double * right,
+   long n
+);
+extern void pv_engine_free (pv_engine_t * e);
+extern long pv_engine_input_read_at
+(
+   pv_engine_input_t * in,
+   long frame,
+   double * left,
+   double * right,
+   long len
+);
+extern long pv_engine_input_ready
+(
+   const pv_engine_input_t * in,
+   long frame,
+   long len
+);
+extern int pv_engine_render_file
+(
+   const pv_engine_ops_t * ops,
+   const pv_engine_params_t * params,
+   const char * file,
+   const char * outfile
+);
+
+/*
+ * The variants, in pv-complex.c, pv-conventional.c, pv-loose-lock.c,
+ * pv-ellis.c, pv-freq.c, pv-nofft.c, and pv-wsola.c.
+ */
+
+extern const pv_engine_ops_t pv_complex_engine;
+extern const pv_engine_ops_t pv_complex_lock_engine;
+extern const pv_engine_ops_t pv_conventional_engine;
+extern const pv_engine_ops_t pv_loose_lock_engine;
+extern const pv_engine_ops_t pv_ellis_engine;
+extern const pv_engine_ops_t pv_freq_engine;
+extern const pv_engine_ops_t pv_nofft_engine;
+extern const pv_engine_ops_t pv_wsola_engine;
+
+#endif         /* WAONC_PV_ENGINE_H_ */
+
+/*
+ * pv-engine.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -23,9 +23,12 @@
 
 /* phase vocoder by frequency domain
  * only integer rate is working
+ * the engine is pv_freq_engine (see pv-engine.h)
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
  */
-void pv_freq (const char *file, const char *outfile,
-	      double rate, long len, long hop_syn,
-	      int flag_window);
+int pv_freq (const char *file, const char *outfile,
+	     double rate, long len, long hop_syn,
+	     int flag_window);
 
 #endif /* !_PV_FREQ_H_ */
@@ -25,12 +25,15 @@
  *   (not by the complex arithmetics)
  * References: M.Puckette (1995)
  *             J.Laroche and M.Dolson (1999)
+ * the engine is pv_loose_lock_engine (see pv-engine.h)
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
  */
 
-void pv_loose_lock (const char *file, const char *outfile,
-		    double rate, double pitch_shift,
-		    long len, long hop_syn,
-		    int flag_window);
+int pv_loose_lock (const char *file, const char *outfile,
+		   double rate, double pitch_shift,
+		   long len, long hop_syn,
+		   int flag_window);
 
 
 #endif /* !_PV_LOOSE_LOCK_H_ */
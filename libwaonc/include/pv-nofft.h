@@ -21,6 +21,19 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+/* make one hop_syn by the phase vocoder without FFT, without playing it
+ * (see pv_nofft_play_step())
+ * OUTPUT
+ *  pv->[lr]_out[0, hop_syn] : the frames to play, before the shift
+ *                             by pv_complex_shift_out()
+ *  returned value : pv->len on success, otherwise the status of
+ *                   pv_complex_read_at() (nothing is made then)
+ */
+
+long
+pv_nofft_synth_step (struct pv_complex *pv,
+		     long cur);
+
 /* play one hop_syn by the phase vocoder without FFT
  * INPUT
  *  pv : struct pv_complex
@@ -36,18 +49,18 @@ long
 pv_nofft_play_step (struct pv_complex *pv,
 		    long cur);
 
-/* phase vocoder by no-FFT -- wrapper for pv_nofft_play_step()
+/* phase vocoder by no-FFT -- through pv_nofft_engine (see pv-engine.h)
  * INPUT
- *  flag_lock : 0 == no phase lock is applied
- *              1 == loose phase lock is applied
  *  rate : time-streching rate
  *  pitch_shift : in the unit of half-note
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
  */
 
-void pv_nofft (const char *file, const char *outfile,
-	       double rate, double pitch_shift,
-	       long len, long hop_syn,
-	       int flag_window);
+int pv_nofft (const char *file, const char *outfile,
+	      double rate, double pitch_shift,
+	      long len, long hop_syn,
+	      int flag_window);
 
 
 #endif /* !_PV_NOFFT_H_ */
@@ -0,0 +1,72 @@
+#ifndef WAONC_PV_RENDER_H_
+#define WAONC_PV_RENDER_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : pipelined offline phase vocoder
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-render.h
+ *
+ *    This module renders a whole input through pv_complex with the stages
+ *    of pv_complex_play_step() on separate threads.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The hops pass through a ring of PV_RENDER_QUEUE slots:
+ *
+ *       -# One thread reads the frames s_i and t_i and transforms both
+ *          channels (read_and_FFT_stereo()).
+ *       -# One thread per channel does the phase vocoder and the phase
+ *          lock (pv_complex_channel_vocoder()).
+ *       -# One thread per channel does the inverse FFT and the
+ *          overlap-add (apply_invFFT_mono_r()).
+ *       -# The calling thread resamples and writes the hops, in order
+ *          (pv_complex_play_resample()).
+ *
+ *    The output is the same as that of the pv_complex_play_step() loop of
+ *    pv_complex().  It is meant for output to a file; an ao device works,
+ *    but gains nothing.
+ */
+
+#include "pv-complex.h"                /* struct pv_complex                   */
+
+/**
+ *    The number of hops that can be in the pipeline at once.  The reader
+ *    waits when it is this far ahead of the writer.
+ */
+
+#define PV_RENDER_QUEUE                16
+
+/*
+ * Global functions for the pv-render module.
+ */
+
+extern long pv_render (struct pv_complex * pv, long frames);
+
+#endif         /* WAONC_PV_RENDER_H_ */
+
+/*
+ * pv-render.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,95 @@
+#ifndef WAONC_PV_RESAMPLE_H_
+#define WAONC_PV_RESAMPLE_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : streaming resampler of the vocoders
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-resample.h
+ *
+ *    This module provides the samplerate conversion of the pitch-shift,
+ *    one hop at a time, for pv_complex_resample() and pv_engine_t.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    One SRC_STATE streams from hop to hop, so that the output is
+ *    continuous, and a FIFO holds the frames it makes ahead of the hop
+ *    handed out.  When the converter is made (at the first hop, or after
+ *    pv_resample_reset()), it is primed once by silence, until its delay
+ *    is filled and the FIFO holds PV_RESAMPLE_MARGIN frames more.  The
+ *    output is then late by a fixed latency, and each hop has its frames
+ *    to hand out without padding.
+ */
+
+#include <samplerate.h>                /* SRC_STATE                           */
+
+/**
+ *    The frames of silence kept ahead in the FIFO, so that a hop never
+ *    runs short when the count of frames made by a hop jitters, or the
+ *    delay of the converter moves with its ratio (by less than the half
+ *    length of its filter).
+ */
+
+#define PV_RESAMPLE_MARGIN             256
+
+/**
+ *    Holds the converter and its FIFO.
+ */
+
+typedef struct
+{
+   int quality;            /*<< The converter type of libsamplerate.          */
+   SRC_STATE * src;        /*<< Null until the first hop, or after a reset.   */
+   float * in;             /*<< Interleaved input of one hop, [2 * in_len].   */
+   long in_len;
+   float * out;            /*<< Interleaved output, [2 * out_len].            */
+   long out_len;
+   long out_n;             /*<< Frames in out[], not handed out yet.          */
+
+} pv_resample_t;
+
+/*
+ * Global functions for the pv-resample module.
+ */
+
+extern pv_resample_t * pv_resample_new (int quality);
+extern void pv_resample_free (pv_resample_t * rs);
+extern void pv_resample_reset (pv_resample_t * rs);
+extern long pv_resample_hop
+(
+   pv_resample_t * rs,
+   const double * l_in,
+   const double * r_in,
+   long n_in,
+   double * l_out,
+   double * r_out,
+   long n_out
+);
+
+#endif         /* WAONC_PV_RESAMPLE_H_ */
+
+/*
+ * pv-resample.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,147 @@
+#ifndef WAONC_PV_WSOLA_H_
+#define WAONC_PV_WSOLA_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : WSOLA time-stretching
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-wsola.h
+ *
+ *    This module stretches the time of a sound by waveform-similarity
+ *    overlap-add (WSOLA), without a phase vocoder.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Like pv_nofft_play_step(), each hop overlap-adds one windowed segment
+ *    of the input.  Rather than taking the segment at the nominal frame,
+ *    WSOLA looks up to pv_wsola_t.tolerance frames either way for the
+ *    segment that best continues the previous one, i.e. that correlates
+ *    best with the input that followed the previous segment.  This keeps
+ *    the waveform periods aligned, which suits speech and percussion, for
+ *    a fraction of the cost of the phase vocoder.
+ *
+ *    The search correlates a mono mix of the input, decimated by
+ *    PV_WSOLA_DECIMATE, with an FFT over the whole tolerance at once, and
+ *    then refines the best match at the full rate.  The input is read
+ *    through a pv_wsola_reader_t, so that the same code serves a file
+ *    (jack-pv.c) and the input queue of an engine (pv_wsola_engine).
+ */
+
+#include <fftw3.h>                     /* fftw_plan, fftw_complex             */
+
+/**
+ *    The decimation of the mono mix for the coarse search.  The fine
+ *    search tries the PV_WSOLA_DECIMATE - 1 frames on either side of the
+ *    coarse match.
+ */
+
+#define PV_WSOLA_DECIMATE              4
+
+/**
+ *    Reads \a len frames from \a frame on, as pv_engine_input_read_at()
+ *    does.
+ *
+ * \return
+ *    Returns \a len if they are all there, a negative value if the caller
+ *    has to wait for them, and the number of frames read (the rest are
+ *    0) at the end of the input.
+ */
+
+typedef long (* pv_wsola_reader_t)
+(
+   void * data,
+   long frame,
+   double * left,
+   double * right,
+   long len
+);
+
+/**
+ *    Holds the state of the WSOLA time-stretching.
+ */
+
+typedef struct
+{
+   long len;               /*<< Frames of a segment.                          */
+   long hop_syn;           /*<< The synthesis hop.                            */
+   long tolerance;         /*<< Largest shift of a segment from its frame.    */
+   int flag_window;        /*<< The window, see windowing() in fft.c.         */
+   int decimate;           /*<< Decimation of the coarse search.              */
+   double * window;        /*<< [len], the window over the scale factor.      */
+   double * l_reg;         /*<< [len + 2 * tolerance], the search region.     */
+   double * r_reg;
+   double * m_reg;         /*<< Its mono mix.                                 */
+   double * l_tmpl;        /*<< [len], the input after the previous segment.  */
+   double * r_tmpl;
+   double * m_tmpl;        /*<< Its mono mix.                                 */
+   long n_fft;             /*<< The size of the coarse correlation.           */
+   double * x_time;        /*<< [n_fft], the decimated region.                */
+   double * t_time;        /*<< [n_fft], the decimated template.              */
+   double * c_time;        /*<< [n_fft], the correlation.                     */
+   double * energy;        /*<< [n_fft + 1], running energy of x_time.        */
+   fftw_complex * x_freq;  /*<< [n_fft / 2 + 1]                               */
+   fftw_complex * t_freq;
+   fftw_plan plan_x;       /*<< x_time ==> x_freq.                            */
+   fftw_plan plan_t;       /*<< t_time ==> t_freq.                            */
+   fftw_plan plan_c;       /*<< x_freq ==> c_time.                            */
+   double * l_out;         /*<< [hop_syn + len], the overlap-add buffers.     */
+   double * r_out;
+   long prev;              /*<< Frame of the last segment, -1 before any.     */
+
+} pv_wsola_t;
+
+/*
+ * Global functions for the pv-wsola module.
+ */
+
+extern pv_wsola_t * pv_wsola_new (long len, long hop_syn, int flag_window);
+extern void pv_wsola_free (pv_wsola_t * w);
+extern void pv_wsola_reset (pv_wsola_t * w);
+extern long pv_wsola_step
+(
+   pv_wsola_t * w,
+   pv_wsola_reader_t reader,
+   void * data,
+   long cur,
+   double * left,
+   double * right
+);
+extern long pv_wsola_keep (const pv_wsola_t * w, long cur);
+extern int pv_wsola
+(
+   const char * file,
+   const char * outfile,
+   double rate,
+   double pitch_shift,
+   long len,
+   long hop_syn,
+   int flag_window
+);
+
+#endif         /* WAONC_PV_WSOLA_H_ */
+
+/*
+ * pv-wsola.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
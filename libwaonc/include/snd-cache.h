@@ -0,0 +1,112 @@
+#ifndef WAONC_SND_CACHE_H_
+#define WAONC_SND_CACHE_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : decoded-sample cache
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          snd-cache.h
+ *
+ *    This module holds the decoded samples of a sound file in memory, so
+ *    that the frames can be read again and again, from several threads,
+ *    without seeking and decoding the file each time.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The first two channels are kept, as float.  A file whose samples fit
+ *    in SND_CACHE_FULL_MAX bytes is decoded whole by snd_cache_open(), and
+ *    is then read with no lock and no system call.  A larger file is
+ *    decoded in blocks of SND_CACHE_BLOCK frames, on demand, into a pool
+ *    of SND_CACHE_BLOCKS blocks mapped from anonymous memory; the least
+ *    recently used block is decoded over when the pool is full, and a
+ *    mutex serializes the readers.
+ */
+
+#include <pthread.h>                   /* pthread_mutex_t                     */
+#include <sndfile.h>                   /* SNDFILE, SF_INFO                    */
+
+#include "macros.h"                    /* wbool_t                             */
+
+/**
+ *    The largest decoded file held whole, in bytes.
+ */
+
+#define SND_CACHE_FULL_MAX             (512L * 1024L * 1024L)
+
+/**
+ *    The frames of a block, for a larger file.
+ */
+
+#define SND_CACHE_BLOCK                65536
+
+/**
+ *    The blocks held at once, for a larger file.
+ */
+
+#define SND_CACHE_BLOCKS               256
+
+/**
+ *    Holds the decoded samples.
+ */
+
+typedef struct
+{
+   SF_INFO sfinfo;         /*<< The information of the file.                  */
+   int channels;           /*<< Channels kept, 1 or 2.                        */
+   wbool_t whole;          /*<< The file is decoded whole into data[].        */
+   float * data;           /*<< Whole:  [frames][channels].                   */
+   SNDFILE * sf;           /*<< Blocks:  the file, open while the cache is.   */
+   float * pool;           /*<< [SND_CACHE_BLOCKS][SND_CACHE_BLOCK][channels] */
+   size_t pool_size;       /*<< Bytes mapped for the pool.                    */
+   long * block;           /*<< [SND_CACHE_BLOCKS], file block of each slot,  */
+                           /*<< or -1.                                        */
+   unsigned long * used;   /*<< [SND_CACHE_BLOCKS], when it was last read.    */
+   unsigned long clock;
+   int last;               /*<< The slot last read, tried first.              */
+   double * decode;        /*<< [SND_CACHE_BLOCK][sfinfo.channels]            */
+   pthread_mutex_t lock;   /*<< Guards the blocks.                            */
+
+} snd_cache_t;
+
+/*
+ * Global functions for the snd-cache module.
+ */
+
+extern snd_cache_t * snd_cache_open (const char * file);
+extern long snd_cache_read_at
+(
+   snd_cache_t * cache,
+   long start,
+   double * left,
+   double * right,
+   long len
+);
+extern void snd_cache_close (snd_cache_t * cache);
+
+#endif         /* WAONC_SND_CACHE_H_ */
+
+/*
+ * snd-cache.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -42,7 +42,8 @@ extern long sndfile_read
    SF_INFO sfinfo,
    double * left,
    double * right,
-   int len
+   int len,
+   double * buf
 );
 extern long sndfile_read_at
 (
@@ -0,0 +1,164 @@
+#ifndef WAONC_SPEC_CACHE_H_
+#define WAONC_SPEC_CACHE_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : on-disk spectral-frame cache
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          spec-cache.h
+ *
+ *    This module provides the ".waonspec" file, which holds the power
+ *    spectra (stage 1) of every frame of a sound file, so that the notes
+ *    can be picked again without redoing the FFTs.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The file is a waon_spec_header_t followed by one record per analysis
+ *    frame, in native byte order:
+ *
+@verbatim
+      float mean_square;         frame_mean_square() of the frame
+      float power[fft_len/2+1];  the power spectrum, scaled by init_den()
+      float dphi[fft_len/2+1];   only if has_dphi:  (1/2pi hop) principal
+                                 (phi - phi0 - Omega), 0 for frame 0
+@endverbatim
+ *
+ *    Frame k starts at sample k * shift_hop of the (mono-mixed) input.
+ *    The frame count in the header is written last, so that a cache that
+ *    was not finished has a count of 0 and is rejected.  A cache is read
+ *    by mapping the file into memory.
+ */
+
+#include <stdio.h>                     /* FILE                                */
+#include <stdint.h>                    /* int32_t, int64_t                    */
+
+#include "macros.h"                    /* wbool_t and errprint() macros       */
+
+/**
+ *    Provides the magic bytes and the version of the format.
+ */
+
+#define SPEC_CACHE_MAGIC                "WAONSPEC"
+#define SPEC_CACHE_VERSION                 1
+
+/**
+ *    Provides the extension that gwaonc appends to the name of a sound
+ *    file to find its cache.
+ */
+
+#define SPEC_CACHE_EXTENSION            ".waonspec"
+
+/**
+ *    Holds the header of a cache file.  It doubles as the key that a
+ *    cache must match to be used.
+ */
+
+typedef struct
+{
+   char magic[8];             /*<< SPEC_CACHE_MAGIC, not null-terminated.    */
+   int32_t version;           /*<< SPEC_CACHE_VERSION.                       */
+   int32_t header_size;       /*<< sizeof(waon_spec_header_t).               */
+   int32_t fft_len;           /*<< The FFT length.                           */
+   int32_t shift_hop;         /*<< The samples between frames.               */
+   int32_t flag_window;       /*<< The window (filter_window_t).             */
+   int32_t samplerate;        /*<< The sample rate of the source.            */
+   int32_t channels;          /*<< The channel count of the source.          */
+   int32_t has_dphi;          /*<< The records hold the dphi[] array.        */
+   int64_t source_frames;     /*<< The length of the source, in frames.      */
+   int64_t source_mtime;      /*<< Modification time of the source, or 0.    */
+   int64_t frame_count;       /*<< The number of records.                    */
+
+} waon_spec_header_t;
+
+/**
+ *    Holds an open cache, either being written or mapped for reading.
+ */
+
+typedef struct
+{
+   waon_spec_header_t header; /*<< The header (the key, while writing).      */
+   long nbin;                 /*<< fft_len/2+1.                              */
+   long record;               /*<< The number of floats in one record.       */
+   FILE * file;               /*<< The file being written, or null.          */
+   float * buffer;            /*<< One record, while writing.                */
+   void * map;                /*<< The mapped file, while reading.           */
+   size_t map_size;           /*<< The size of the mapping.                  */
+   const float * data;        /*<< The first record, while reading.          */
+
+} waon_spec_cache_t;
+
+/*
+ * Global functions for the spec-cache module.
+ */
+
+extern void spec_cache_key
+(
+   waon_spec_header_t * key,
+   const char * source,
+   long fft_len,
+   long shift_hop,
+   int flag_window,
+   int samplerate,
+   int channels,
+   long source_frames,
+   wbool_t has_dphi
+);
+extern wbool_t spec_cache_matches
+(
+   const waon_spec_cache_t * cache,
+   const waon_spec_header_t * key
+);
+extern waon_spec_cache_t * spec_cache_open
+(
+   const char * name,
+   const waon_spec_header_t * key
+);
+extern waon_spec_cache_t * spec_cache_create
+(
+   const char * name,
+   const waon_spec_header_t * key
+);
+extern void spec_cache_write
+(
+   waon_spec_cache_t * cache,
+   double mean_square,
+   const double * power,
+   const double * dphi
+);
+extern long spec_cache_frames (const waon_spec_cache_t * cache);
+extern double spec_cache_read
+(
+   const waon_spec_cache_t * cache,
+   long k,
+   double * power,
+   double * dphi
+);
+extern void spec_cache_close (waon_spec_cache_t * cache);
+
+#endif         /* WAONC_SPEC_CACHE_H_ */
+
+/*
+ * spec-cache.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
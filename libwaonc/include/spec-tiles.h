@@ -0,0 +1,137 @@
+#ifndef WAONC_SPEC_TILES_H_
+#define WAONC_SPEC_TILES_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : tiled cache of spectrogram columns
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          spec-tiles.h
+ *
+ *    This module caches the spectra of the columns of a spectrogram, and
+ *    computes the missing ones on worker threads.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Column c of an analysis starts at frame c * step of the sound file.
+ *    The columns are held in tiles of SPEC_TILES_COLUMNS, keyed by the
+ *    spec_tiles_key_t and the tile index, so that scrolling or going back
+ *    to an earlier FFT length, window, or hop finds the columns computed
+ *    before.  A typical redraw is:
+ *
+ *       -# spec_tiles_begin(), which drops the tiles still queued for the
+ *          previous redraw.
+ *       -# spec_tiles_column() for each column on display.  A column that
+ *          is not ready is queued, and the caller leaves it blank.
+ *
+ *    The worker threads call the notify function each time a tile is
+ *    ready, so that the caller can redraw.  The least recently used tiles
+ *    are dropped when the cache grows above SPEC_TILES_MEMORY bytes.
+ *
+ *    The workers read the samples from a snd_cache_t, which they share,
+ *    and all of the FFTW plans are made on the thread that calls
+ *    spec_tiles_column(), as the FFTW planner is not thread-safe.
+ */
+
+#include "macros.h"                    /* wbool_t                             */
+#include "snd-cache.h"                 /* snd_cache_t                         */
+#include "spec-cache.h"                /* waon_spec_cache_t                   */
+#include "spectrogram.h"               /* spg_key_t, spg_columns_t            */
+
+/**
+ *    The number of columns in a tile.
+ */
+
+#define SPEC_TILES_COLUMNS             64
+
+/**
+ *    The most tiles held at once.
+ */
+
+#define SPEC_TILES_MAX                 1024
+
+/**
+ *    The memory the tiles may take, in bytes.  It is exceeded only if the
+ *    tiles of one redraw need more.
+ */
+
+#define SPEC_TILES_MEMORY              (64L * 1024L * 1024L)
+
+/**
+ *    The most worker threads.  spec_tiles_new() starts one less than the
+ *    number of processors, within 1 and this value.
+ */
+
+#define SPEC_TILES_THREADS             4
+
+/**
+ *    Holds what the columns of a tile depend on, besides the file.
+ */
+
+typedef spg_key_t spec_tiles_key_t;
+
+/**
+ *    Called on a worker thread each time a tile is ready.
+ */
+
+typedef void (* spec_tiles_notify_t) (void * data);
+
+/**
+ *    The cache is opaque; see spec-tiles.c.
+ */
+
+typedef struct spec_tiles spec_tiles_t;
+
+/*
+ * Global functions for the spec-tiles module.
+ */
+
+extern spec_tiles_t * spec_tiles_new
+(
+   snd_cache_t * snd,
+   int threads,
+   spec_tiles_notify_t notify,
+   void * data
+);
+extern void spec_tiles_set_disk_cache
+(
+   spec_tiles_t * tiles,
+   const waon_spec_cache_t * disk
+);
+extern void spec_tiles_begin (spec_tiles_t * tiles);
+extern wbool_t spec_tiles_column
+(
+   spec_tiles_t * tiles,
+   const spec_tiles_key_t * key,
+   long column,
+   double * amp2,
+   double * dphi
+);
+extern void spec_tiles_free (spec_tiles_t * tiles);
+
+#endif         /* WAONC_SPEC_TILES_H_ */
+
+/*
+ * spec-tiles.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,242 @@
+#ifndef WAONC_SPECTROGRAM_H_
+#define WAONC_SPECTROGRAM_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : spectrogram engine
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          spectrogram.h
+ *
+ *    This module computes and colors the spectrogram of gwaonc, so that
+ *    gwaonc and the spgc batch renderer draw the same picture.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    It has three parts:
+ *
+ *       -# spg_columns_t computes the columns of a spectrogram in batches:
+ *          the power spectra of the mono mix, scaled by the FFT length,
+ *          with the phase differences to the frame a hop later for the
+ *          phase-vocoder modes.  Each thread needs its own.
+ *       -# spg_frame_t computes the spectrum of one frame of each channel,
+ *          for the spectrum panel of gwaonc.
+ *       -# spg_render_t turns a column into the values of the rows of the
+ *          display, in one of the modes of gwaonc (spg_mode_t), and
+ *          spg_color_index() turns a value into an index of the colormap
+ *          of spg_colormap().
+ *
+ *    The samples are read from a snd_cache_t.  The FFTW plans are made by
+ *    spg_columns_new() and spg_frame_new(), which must not run on two
+ *    threads at once.
+ */
+
+#include "fft-batch.h"                 /* waon_fft_batch_t                    */
+#include "fft.h"                       /* fftw_plan                           */
+#include "macros.h"                    /* wbool_t                             */
+#include "snd-cache.h"                 /* snd_cache_t                         */
+
+/**
+ *    The number of colors of the colormap.
+ */
+
+#define SPG_COLORS                     256
+
+/**
+ *    Provides the display modes of gwaonc.
+ */
+
+typedef enum
+{
+   SPG_MODE_POWER,         /*<< The power of each band of bins.               */
+   SPG_MODE_PV,            /*<< The amplitudes moved to their phase-vocoder   */
+                           /*<< frequencies, one row each.                    */
+   SPG_MODE_PV_NOTES       /*<< The same, averaged over each MIDI note when   */
+                           /*<< the display has a row per note or more.       */
+
+} spg_mode_t;
+
+/**
+ *    Holds what the columns depend on, besides the file.  Column c starts
+ *    at frame c * step.
+ */
+
+typedef struct
+{
+   long fft_len;           /*<< The FFT length.                               */
+   long hop;               /*<< The hop of the phase difference, or 0 for     */
+                           /*<< the power spectrum alone.                     */
+   int flag_window;        /*<< The window, see windowing() in fft.c.         */
+   long step;              /*<< Frames between two columns.                   */
+
+} spg_key_t;
+
+/**
+ *    Holds the batch and the buffers that compute the columns.
+ */
+
+typedef struct
+{
+   long fft_len;
+   waon_fft_batch_t * batch;
+   double * left;          /*<< [fft_len]                                     */
+   double * right;
+   double * amp2;          /*<< [batch->count][nbin]                          */
+   double * phs;
+   double * last_amp2;     /*<< [nbin], the last frame of a batch.            */
+   double * last_phs;
+
+} spg_columns_t;
+
+/**
+ *    Holds the plans and the buffers that compute the spectra of one
+ *    frame of each channel.
+ */
+
+typedef struct
+{
+   long fft_len;
+   int flag_window;        /*<< The window, set before each frame.            */
+   waon_fft_batch_t * mono; /*<< For the mono mix.                            */
+   fftw_plan plan_stereo;  /*<< For both channels in one FFT.                 */
+   double * st_in;         /*<< [2 * fft_len]                                 */
+   double * st_out;
+   double * left;          /*<< [fft_len]                                     */
+   double * right;
+   double * l_ph1;         /*<< [nbin], the phases a hop later.               */
+   double * r_ph1;
+
+} spg_frame_t;
+
+/**
+ *    Holds what the display of a column depends on.
+ */
+
+typedef struct
+{
+   spg_mode_t mode;
+   long fft_len;
+   int samplerate;
+   double logf_min;        /*<< The log of the frequency of the bottom row.   */
+   double logf_max;        /*<< The log of the frequency of the top row.      */
+   double amp2_min;        /*<< The log10 of the power of the first color.    */
+   double amp2_max;        /*<< The log10 of the power of the last color.     */
+   double octave_removal_factor; /*<< Experimental, 0 for none.              */
+
+} spg_view_t;
+
+/**
+ *    Holds the display of the columns for one view and height.  Rows are
+ *    counted from the bottom, and row 0 is the bottom edge.
+ */
+
+typedef struct
+{
+   spg_view_t view;
+   int height;             /*<< Rows of the display, 1 to height.             */
+   wbool_t thin;           /*<< The columns are one pixel wide.               */
+   int bands;              /*<< The bands of bins of SPG_MODE_POWER.          */
+   int * k0;               /*<< [bands], band b has the bins k0 <= k < k1.    */
+   int * k1;
+   int * top;              /*<< [bands], the top row of the cell.             */
+   int * len_line;         /*<< [bands], the rows of the cell if thin.        */
+   int * len_rect;         /*<< [bands], the rows of the cell if not.         */
+   double threshold[SPG_COLORS]; /*<< The least power of each color.          */
+   double * ave;           /*<< [height], for the phase-vocoder modes.        */
+
+} spg_render_t;
+
+/*
+ * Global functions for the spectrogram module.
+ */
+
+extern spg_columns_t * spg_columns_new (long fft_len, int count);
+extern void spg_columns_compute
+(
+   spg_columns_t * cols,
+   snd_cache_t * snd,
+   const spg_key_t * key,
+   long first,
+   long n,
+   float * amp2,
+   float * dphi
+);
+extern void spg_columns_free (spg_columns_t * cols);
+extern spg_frame_t * spg_frame_new (long fft_len);
+extern void spg_frame_one
+(
+   spg_frame_t * frame,
+   snd_cache_t * snd,
+   long i,
+   double * l_amp2,
+   double * r_amp2,
+   double * l_ph,
+   double * r_ph
+);
+extern void spg_frame_two
+(
+   spg_frame_t * frame,
+   snd_cache_t * snd,
+   long i,
+   long hop,
+   double * l_amp2,
+   double * r_amp2,
+   double * l_ph,
+   double * r_ph,
+   double * l_dphi,
+   double * r_dphi
+);
+extern void spg_frame_free (spg_frame_t * frame);
+extern void spg_colormap (unsigned char palette[SPG_COLORS][3]);
+extern void spg_average_pv
+(
+   const spg_view_t * view,
+   int resolution,
+   const double * amp2,
+   const double * dphi,
+   double * amp
+);
+extern void spg_render_init (spg_render_t * render);
+extern void spg_render_set
+(
+   spg_render_t * render,
+   const spg_view_t * view,
+   int height,
+   wbool_t thin
+);
+extern void spg_render_column
+(
+   spg_render_t * render,
+   const double * amp2,
+   const double * dphi,
+   double * value
+);
+extern int spg_color_index (const spg_render_t * render, double amp2);
+extern void spg_render_free (spg_render_t * render);
+
+#endif         /* WAONC_SPECTROGRAM_H_ */
+
+/*
+ * spectrogram.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
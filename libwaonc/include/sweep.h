@@ -0,0 +1,130 @@
+#ifndef WAONC_SWEEP_H_
+#define WAONC_SWEEP_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : parameter sweep over one analysis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          sweep.h
+ *
+ *    This module provides the note-picking stages (2 and 3) for several
+ *    parameter sets that share one spectral analysis (stage 1).
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The --sweep option names a text file with one parameter set per
+ *    line, written as waonc options.  Only the options that act after the
+ *    power spectrum is made can differ between the sets:
+ *
+@verbatim
+      -c --cutoff, -r --relative, -k --peak, --psub-n, --psub-f, --oct,
+      -o --output
+@endverbatim
+ *
+ *    Blank lines and lines starting with '#' are ignored.  A set without
+ *    -o writes its MIDI file to the --output name with the set number
+ *    appended (e.g. "output-03.mid").  Without --sweep, the sweep holds
+ *    the one set given by the command line, so that processing() has a
+ *    single code path.
+ */
+
+#include <stdio.h>                     /* FILE                                */
+
+#include "analyse.h"                   /* analysis_scratchpad_t               */
+#include "note-bank.h"                 /* waon_note_bank_t                    */
+#include "notes.h"                     /* waon_notes_t                        */
+#include "parameters.h"                /* waon_parameters_t                   */
+
+/**
+ *    Provides the maximum number of tokens in one line of a sweep file.
+ */
+
+#define SWEEP_TOKENS_MAX                  32
+
+/**
+ *    Holds one parameter set and the note-tracking state that goes with
+ *    it.
+ */
+
+typedef struct
+{
+   waon_parameters_t parameters;    /*<< A copy of the base, plus overrides.  */
+   analysis_scratchpad_t scratchpad;/*<< A copy, with this set's abs_flg.     */
+   waon_notes_t * notes;            /*<< The notes picked with this set.      */
+   char vel[MIDI_NOTE_COUNT];       /*<< The velocities at the current step.  */
+   int on_event[MIDI_NOTE_COUNT];   /*<< The last on-event of each note.      */
+
+} waon_sweep_set_t;
+
+/**
+ *    Holds all of the parameter sets of a run.
+ */
+
+typedef struct
+{
+   int count;                 /*<< The number of parameter sets.              */
+   waon_sweep_set_t * sets;   /*<< The parameter sets [count].                */
+   long fft_len;              /*<< The FFT length shared by all of the sets.  */
+   double * scratch;          /*<< Scratch copy of the power [fft_len/2+1].   */
+   double * work;             /*<< The removals' work space [fft_len/2+1].    */
+
+} waon_sweep_t;
+
+/*
+ * Global functions for the sweep module.
+ */
+
+extern waon_sweep_t * sweep_create
+(
+   const waon_parameters_t * base,
+   const analysis_scratchpad_t * scratchpad
+);
+extern void sweep_free (waon_sweep_t * sweep);
+extern double sweep_gate (const waon_sweep_t * sweep, double gain);
+extern void sweep_spectrum
+(
+   waon_sweep_t * sweep,
+   int step,
+   double * p,
+   const double * fp,
+   int i0,
+   int i1,
+   double t0
+);
+extern void sweep_bank
+(
+   waon_sweep_t * sweep,
+   int step,
+   const waon_note_bank_t * bank
+);
+extern void sweep_silence (waon_sweep_t * sweep, int step);
+extern void sweep_finish (waon_sweep_t * sweep);
+extern void sweep_summary (const waon_sweep_t * sweep, FILE * out);
+
+#endif         /* WAONC_SWEEP_H_ */
+
+/*
+ * sweep.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -27,7 +27,7 @@
  * \library       libwaonc
  * \author        Kengo Ichiki with modifications by Chris Ahlstrom
  * \date          2007-02-28
- * \updates       2013-12-22
+ * \updates       2026-10-18
  * \version       $Revision$
  * \license       GNU GPL
  *
@@ -70,6 +70,7 @@ analysis_scratchpad_initialize (analysis_scratchpad_t * parameters)
    if (result)
    {
       parameters->absolute_cutoff = DEFAULT_USE_ABSOLUTE_CUTOFF;
+      parameters->adj_pitch = 0.0;
       parameters->use_patchfile = wfalse;
       parameters->patch_array = nullptr;
       parameters->patch_array_size = 0;
@@ -191,7 +192,7 @@ note_intensity
       else
          freq = fp[imax];              /* use specified frequency bins        */
 
-      in = get_note(freq);             /* midi note number                    */
+      in = get_note(freq, aparms->adj_pitch); /* midi note number            */
       if (in >= i0 && in <= i1)        /* check  the range of the note        */
       {
          /**
@@ -258,6 +259,36 @@ note_intensity
    }
 }
 
+/**
+ *    Calculates the mean-square value (the energy per sample) of one
+ *    frame.  This value is an upper bound for every bin of the power
+ *    spectrum of the frame, whatever the window:  by Cauchy-Schwarz,
+ *    |Y(k)|^2 <= sum(w^2) sum(x^2), and HC_to_amp2() divides by the
+ *    init_den() value n sum(w^2).  Therefore, if this value is not over
+ *    10^cut_ratio, note_intensity() cannot yield a non-zero intensity for
+ *    the frame, and the FFT can be skipped.
+ *
+ * \param n
+ *    Provides the number of samples in the frame.
+ *
+ * \param x[n]
+ *    Provides the (unwindowed) samples.
+ *
+ * \return
+ *    Returns sum(x^2) / n.
+ */
+
+double
+frame_mean_square (int n, const double * x)
+{
+   double sum = 0.0;
+   int i;
+   for (i = 0; i < n; ++i)
+      sum += x[i] * x[i];
+
+   return sum / (double) n;
+}
+
 /**
  *    Converts FFT information into MIDI.
  *
@@ -602,7 +633,7 @@ init_patch
          );
          exit(1);
       }
-      if (sndfile_read(sf, sfinfo, x, xx, plen) != plen) /* read patch wav    */
+      if (sndfile_read(sf, sfinfo, x, xx, plen, nullptr) != plen) /* patch wav */
       {
          fprintf(stderr, "no patch data");
          aparms->use_patchfile = wfalse;
@@ -28,15 +28,23 @@
  * \library       libwaonc
  * \author        Kengo Ichiki with modifications by Chris Ahlstrom
  * \date          2007-02-28
- * \updates       2013-12-22
+ * \updates       2026-10-18
  * \version       $Revision$
  * \license       GNU GPL
+ *
+ *    The output thread of an ao_queue_t counts an underrun each time it
+ *    finds the queue empty while it was fed, i.e. the synthesis fell
+ *    behind the device.  Running dry at a pause (ao_queue_flush()) or at
+ *    the end (ao_queue_drain()) is not counted.
  */
 
 #include <stdlib.h>
+#include <string.h>                    /* memcpy()                            */
 #include <unistd.h>                    /* write()                             */
 #include <ao/ao.h>
 
+#include "ao-wrapper.h"                /* ao_queue_t                          */
+
 #include "macros.h"                    /* wbool_t, errprint() macros          */
 #include "memory-check.h"              /* CHECK_MALLOC() macro                */
 
@@ -127,6 +135,33 @@ print_ao_driver_info_list (void)
    }
 }
 
+/**
+ *    Converts stereo data to the 16-bit little-endian frames of the
+ *    device, 4 bytes a frame.  The data is scaled by 32768 (the maximum
+ *    value of a 16-bit integer, plus 1).
+ */
+
+static void
+ao_pack_16_stereo
+(
+   const double * left,
+   const double * right,
+   int len,
+   char * buffer
+)
+{
+   int i;
+   for (i = 0; i < len; i++)
+   {
+      short sl = (short) (left[i] * 32768.0);
+      short sr = (short) (right[i] * 32768.0);
+      buffer[i*4 + 0] =  sl       & 0xff;
+      buffer[i*4 + 1] = (sl >> 8) & 0xff;
+      buffer[i*4 + 2] =  sr       & 0xff;
+      buffer[i*4 + 3] = (sr >> 8) & 0xff;
+   }
+}
+
 /**
  *    Writes stereo data to the given AO device.
  *
@@ -153,21 +188,10 @@ ao_write
    int len
 )
 {
-   int i;
    int status;
-   short sl;
-   short sr;
    char * buffer = (char *) malloc(len * 4 * sizeof(char));
    CHECK_MALLOC(buffer, "ao_write");
-   for (i = 0; i < len; i++)
-   {
-      sl = (short) (left[i] * 32768.0);
-      sr = (short) (right[i] * 32768.0);
-      buffer[i*4 + 0] =  sl       & 0xff;
-      buffer[i*4 + 1] = (sl >> 8) & 0xff;
-      buffer[i*4 + 2] =  sr       & 0xff;
-      buffer[i*4 + 3] = (sr >> 8) & 0xff;
-   }
+   ao_pack_16_stereo(left, right, len, buffer);
    status = ao_play(device, buffer, len * 4);
    if (status != 0)
       status = len * 4;
@@ -178,6 +202,305 @@ ao_write
    return status;
 }
 
+/**
+ *    The output thread of an ao_queue_t.  It takes up to q->period frames
+ *    at a time and plays them with the lock released, so that the writer
+ *    only waits on the lock for a memcpy().
+ */
+
+static void *
+ao_queue_thread (void * arg)
+{
+   ao_queue_t * q = (ao_queue_t *) arg;
+   pthread_mutex_lock(&q->lock);
+   for (;;)
+   {
+      long n;
+      long first;
+      while (q->running && q->count == 0)
+      {
+         if (q->primed && ! q->draining)
+            ++q->underruns;
+
+         q->primed = wfalse;
+         pthread_cond_wait(&q->cond_data, &q->lock);
+      }
+      if (! q->running)
+         break;
+
+      n = q->count < q->period ? q->count : q->period;
+      first = q->size - q->head;
+      if (first > n)
+         first = n;
+
+      memcpy(q->chunk, q->ring + 4 * q->head, 4 * first);
+      if (n > first)
+         memcpy(q->chunk + 4 * first, q->ring, 4 * (n - first));
+
+      q->head = (q->head + n) % q->size;
+      q->count -= n;
+      if (q->primed && q->count < q->depth_min)
+         q->depth_min = q->count;
+
+      q->playing = wtrue;
+      pthread_cond_broadcast(&q->cond_space);
+      pthread_mutex_unlock(&q->lock);
+      if (ao_play(q->device, q->chunk, 4 * n) == 0)
+         errprint("ao_play() returned a zero status");
+
+      pthread_mutex_lock(&q->lock);
+      q->playing = wfalse;
+      q->played += (unsigned long) n;
+      pthread_cond_broadcast(&q->cond_space);
+   }
+   pthread_mutex_unlock(&q->lock);
+   return nullptr;
+}
+
+/**
+ *    Creates the output queue of a device and starts its thread.
+ *
+ * \param device
+ *    Provides the device, opened by ao_init_16_stereo().  It is not closed
+ *    by ao_queue_free().
+ *
+ * \param samplerate
+ *    Provides the samplerate of the device.
+ *
+ * \param latency_ms
+ *    Provides the length of the queue in milliseconds, i.e. how far the
+ *    writer may run ahead of the device.  0 selects AO_QUEUE_LATENCY_MS.
+ *
+ * \return
+ *    Returns the queue, or a null pointer if the thread cannot be started.
+ */
+
+ao_queue_t *
+ao_queue_new (ao_device * device, int samplerate, long latency_ms)
+{
+   ao_queue_t * q = (ao_queue_t *) malloc(sizeof(ao_queue_t));
+   CHECK_MALLOC(q, "ao_queue_new");
+   memset(q, 0, sizeof(ao_queue_t));
+   if (latency_ms <= 0)
+      latency_ms = AO_QUEUE_LATENCY_MS;
+
+   q->device = device;
+   q->size = (long) samplerate * latency_ms / 1000;
+   if (q->size < 64)
+      q->size = 64;
+
+   /*
+    * A quarter of the queue at a time keeps the device fed while the
+    * writer refills the rest.
+    */
+
+   q->period = q->size / 4 < 1024 ? q->size / 4 : 1024;
+   q->ring = (char *) malloc(4 * q->size);
+   q->chunk = (char *) malloc(4 * q->period);
+   CHECK_MALLOC(q->ring, "ao_queue_new");
+   CHECK_MALLOC(q->chunk, "ao_queue_new");
+   q->depth_min = q->size;
+   q->running = wtrue;
+   pthread_mutex_init(&q->lock, NULL);
+   pthread_cond_init(&q->cond_data, NULL);
+   pthread_cond_init(&q->cond_space, NULL);
+   if (pthread_create(&q->thread, NULL, ao_queue_thread, q) != 0)
+   {
+      errprint("cannot start the ao output thread");
+      pthread_cond_destroy(&q->cond_space);
+      pthread_cond_destroy(&q->cond_data);
+      pthread_mutex_destroy(&q->lock);
+      free(q->chunk);
+      free(q->ring);
+      free(q);
+      return nullptr;
+   }
+   return q;
+}
+
+/**
+ *    Stops the thread, dropping the frames not played yet, and frees the
+ *    queue.  See ao_queue_drain() to play them first.
+ */
+
+void
+ao_queue_free (ao_queue_t * q)
+{
+   if (is_nullptr(q))
+      return;
+
+   pthread_mutex_lock(&q->lock);
+   q->running = wfalse;
+   pthread_cond_broadcast(&q->cond_data);
+   pthread_cond_broadcast(&q->cond_space);
+   pthread_mutex_unlock(&q->lock);
+   pthread_join(q->thread, NULL);
+   pthread_cond_destroy(&q->cond_space);
+   pthread_cond_destroy(&q->cond_data);
+   pthread_mutex_destroy(&q->lock);
+   free(q->chunk);
+   free(q->ring);
+   free(q);
+}
+
+/**
+ *    Queues stereo data, in the same format as ao_write().  It blocks only
+ *    while the queue is full; a caller that must not block writes no more
+ *    than ao_queue_space() frames.
+ *
+ * \return
+ *    Returns the number of bytes queued (4 a frame), as ao_write() does.
+ */
+
+int
+ao_queue_write
+(
+   ao_queue_t * q,
+   const double * left,
+   const double * right,
+   int len
+)
+{
+   int done = 0;
+   pthread_mutex_lock(&q->lock);
+   while (done < len && q->running)
+   {
+      long tail;
+      long n;
+      long first;
+      while (q->running && q->count == q->size)
+         pthread_cond_wait(&q->cond_space, &q->lock);
+
+      if (! q->running)
+         break;
+
+      n = q->size - q->count;
+      if (n > len - done)
+         n = len - done;
+
+      tail = (q->head + q->count) % q->size;
+      first = q->size - tail;
+      if (first > n)
+         first = n;
+
+      ao_pack_16_stereo
+      (
+         left + done, right + done, (int) first, q->ring + 4 * tail
+      );
+      if (n > first)
+      {
+         ao_pack_16_stereo
+         (
+            left + done + first, right + done + first, (int) (n - first),
+            q->ring
+         );
+      }
+      q->count += n;
+      done += (int) n;
+      if (! q->primed)
+      {
+         q->primed = wtrue;
+         q->depth_min = q->count;
+      }
+      pthread_cond_signal(&q->cond_data);
+   }
+   pthread_mutex_unlock(&q->lock);
+   return done * 4;
+}
+
+/**
+ *    Returns the frames that ao_queue_write() can take without blocking.
+ */
+
+long
+ao_queue_space (ao_queue_t * q)
+{
+   long result;
+   pthread_mutex_lock(&q->lock);
+   result = q->size - q->count;
+   pthread_mutex_unlock(&q->lock);
+   return result;
+}
+
+/**
+ *    Returns the frames queued and not yet given to the device.
+ */
+
+long
+ao_queue_depth (ao_queue_t * q)
+{
+   long result;
+   pthread_mutex_lock(&q->lock);
+   result = q->count;
+   pthread_mutex_unlock(&q->lock);
+   return result;
+}
+
+/**
+ *    Returns the number of underruns so far.
+ */
+
+unsigned long
+ao_queue_underruns (ao_queue_t * q)
+{
+   unsigned long result;
+   pthread_mutex_lock(&q->lock);
+   result = q->underruns;
+   pthread_mutex_unlock(&q->lock);
+   return result;
+}
+
+/**
+ *    Returns the lowest depth of the queue since it was last flushed or
+ *    drained, i.e. how close the writer came to an underrun.
+ */
+
+long
+ao_queue_depth_min (ao_queue_t * q)
+{
+   long result;
+   pthread_mutex_lock(&q->lock);
+   result = q->depth_min;
+   pthread_mutex_unlock(&q->lock);
+   return result;
+}
+
+/**
+ *    Drops the frames not given to the device yet, e.g. for a pause or a
+ *    jump, so that the change is heard at once.  The queue running dry
+ *    afterwards is not an underrun.
+ */
+
+void
+ao_queue_flush (ao_queue_t * q)
+{
+   pthread_mutex_lock(&q->lock);
+   q->count = 0;
+   q->head = 0;
+   q->primed = wfalse;
+   q->depth_min = q->size;
+   pthread_cond_broadcast(&q->cond_space);
+   pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ *    Waits until the device has played every queued frame.
+ */
+
+void
+ao_queue_drain (ao_queue_t * q)
+{
+   pthread_mutex_lock(&q->lock);
+   q->draining = wtrue;
+   while (q->running && (q->count > 0 || q->playing))
+      pthread_cond_wait(&q->cond_space, &q->lock);
+
+   q->draining = wfalse;
+   q->primed = wfalse;
+   q->depth_min = q->size;
+   pthread_mutex_unlock(&q->lock);
+}
+
 /*
  * ao-wrapper.c
  *
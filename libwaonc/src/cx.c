@@ -0,0 +1,533 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : interleaved-complex routines
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          cx.c
+ *
+ *    This module provides interleaved-complex routines, the counterparts
+ *    of the half-complex routines in hc.c.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    See cx.h for the layout.  In every routine, bin 0 (and bin len/2
+ *    when len is even) is purely real, exactly as in the HC routines, and
+ *    its imaginary slot is written as 0.0.
+ */
+
+#include <math.h>
+#include <stdlib.h>                    /* malloc()                            */
+#include <stdio.h>                     /* fprintf()                           */
+
+#include "cx.h"                        /* declares the function of module     */
+
+/**
+ *    Returns the amplitude and the angle (arg) of each complex bin of
+ *    the CX buffer.  The counterpart of HC_to_polar().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param freq[CX_LENGTH(len)]
+ *    Provides the frequency array.
+ *
+ * \param conjugate
+ *    Set to 0 (wfalse) for the normal case of computation.  Set to 1
+ *    (wtrue) for the conjugate of each bin.
+ *
+ * \param [out] amp[len/2+1]
+ *    Provides the output buffer for the amplitude.
+ *
+ * \param [out] phs[len/2+1]
+ *    Provides the output buffer for the phase.
+ */
+
+void
+CX_to_polar
+(
+   long len,
+   const double * freq,
+   wbool_t conjugate,
+   double * amp,
+   double * phs
+)
+{
+   int i;
+   phs[0] = 0.0;
+   amp[0] = fabs(freq[0]);
+   for (i = 1; i < (len + 1) / 2; i ++)
+   {
+      double rl = freq[2 * i];
+      double im = freq[2 * i + 1];
+      amp[i] = sqrt(rl*rl + im*im);
+      if (amp[i] > 0.0)
+      {
+         if (conjugate)
+            phs[i] = atan2(-im, rl);
+         else
+            phs[i] = atan2(+im, rl);
+      }
+      else
+         phs[i] = 0.0;
+   }
+   if (len % 2 == 0)
+   {
+      phs[len/2] = 0.0;
+      amp[len/2] = fabs(freq[len]);
+   }
+}
+
+/**
+ *    Returns the power and the angle (arg) of each complex bin of the CX
+ *    buffer.  The counterpart of HC_to_polar2().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param freq[CX_LENGTH(len)]
+ *    Provides the frequency buffer.
+ *
+ * \param conjugate
+ *    Set to 0 (wfalse) for the normal case of computation.  Set to 1
+ *    (wtrue) for the conjugate of each bin.
+ *
+ * \param scale
+ *    Provides the scale factor for amp2[].
+ *
+ * \param [out] amp2[len/2+1]
+ *    Provides the output buffer for the power.
+ *
+ * \param [out] phs[len/2+1]
+ *    Provides the output buffer for the phase.
+ */
+
+void
+CX_to_polar2
+(
+   long len,
+   const double * freq,
+   wbool_t conjugate,
+   double scale,
+   double * amp2,
+   double * phs
+)
+{
+   int i;
+   phs[0] = 0.0;
+   amp2[0] = freq[0] * freq[0] / scale;
+   for (i = 1; i < (len + 1) / 2; i ++)
+   {
+      double rl = freq[2 * i];
+      double im = freq[2 * i + 1];
+      amp2[i] = (rl*rl + im*im) / scale;
+      if (amp2[i] > 0.0)
+      {
+         if (conjugate)
+            phs[i] = atan2(-im, rl);
+         else
+            phs[i] = atan2(+im, rl);
+      }
+      else
+         phs[i] = 0.0;
+   }
+   if (len % 2 == 0)
+   {
+      phs[len/2] = 0.0;
+      amp2[len/2] = freq[len] * freq[len] / scale;
+   }
+}
+
+/**
+ *    Returns the power of each complex bin of the CX buffer.  The
+ *    counterpart of HC_to_amp2().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param freq[CX_LENGTH(len)]
+ *    Provides the frequency buffer.
+ *
+ * \param scale
+ *    Provides the scale factor for the amp2[] output buffer.
+ *
+ * \param [out] amp2[len/2+1]
+ *    Provides the destination buffer for the "(real^2 + imag^2) / scale"
+ *    operation.
+ */
+
+void
+CX_to_amp2
+(
+   long len,
+   const double * freq,
+   double scale,
+   double * amp2
+)
+{
+   int i;
+   int n = (int) (len / 2 + 1);
+   double rscale = 1.0 / scale;
+   for (i = 0; i < n; i ++)
+   {
+      double rl = freq[2 * i];
+      double im = freq[2 * i + 1];
+      amp2[i] = (rl * rl + im * im) * rscale;
+   }
+}
+
+/**
+ *    Converts from polar coordinates to CX values.  The counterpart of
+ *    polar_to_HC().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param amp[len/2+1]
+ *    Provides the buffer for the amplitude values.
+ *
+ * \param phs[len/2+1]
+ *    Provides the buffer for the phase values.
+ *
+ * \param conjugate
+ *    Set to 0 (wfalse) for the normal case of computation.  Set to 1
+ *    (wtrue) for the conjugate of each bin.
+ *
+ * \param [out] freq[CX_LENGTH(len)]
+ *    Provides the output buffer for the frequency values.
+ */
+
+void
+polar_to_CX
+(
+   long len,
+   const double * amp,
+   const double * phs,
+   wbool_t conjugate,
+   double * freq
+)
+{
+   int i;
+   freq[0] = amp[0];
+   freq[1] = 0.0;
+   for (i = 1; i < (len + 1) / 2; i ++)
+   {
+      double rl = amp[i] * cos(phs[i]);
+      double im = amp[i] * sin(phs[i]);
+      freq[2 * i] = rl;
+      freq[2 * i + 1] = conjugate ? -im : im;
+   }
+   if (len % 2 == 0)
+   {
+      freq[len] = amp[len/2];
+      freq[len + 1] = 0.0;
+   }
+}
+
+/**
+ *    Calculates Z = X * Y, bin by bin.  The counterpart of HC_mul().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param x
+ *    Provides the x array.
+ *
+ * \param y
+ *    Provides the y array.
+ *
+ * \param [out] z
+ *    Provides the output z array.  It can be the same as x or y.
+ */
+
+void
+CX_mul
+(
+   long len,
+   const double * x,
+   const double * y,
+   double * z
+)
+{
+   int i;
+   int n = (int) (len / 2 + 1);
+   for (i = 0; i < n; i ++)
+   {
+      double rx = x[2 * i];
+      double ix = x[2 * i + 1];
+      double ry = y[2 * i];
+      double iy = y[2 * i + 1];
+      z[2 * i]     = rx * ry - ix * iy;
+      z[2 * i + 1] = rx * iy + ix * ry;
+   }
+}
+
+/**
+ *    Calculates Z = X / Y, bin by bin.  The counterpart of HC_div().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param x
+ *    Provides the x array.
+ *
+ * \param y
+ *    Provides the y array.
+ *
+ * \param [out] z
+ *    Provides the output z array.  It can be the same as x or y.
+ */
+
+void
+CX_div
+(
+   long len,
+   const double * x,
+   const double * y,
+   double * z
+)
+{
+   int i;
+   int n = (int) (len / 2 + 1);
+   for (i = 0; i < n; i ++)
+   {
+      double rx = x[2 * i];
+      double ix = x[2 * i + 1];
+      double ry = y[2 * i];
+      double iy = y[2 * i + 1];
+      double den = ry * ry + iy * iy;
+      z[2 * i]     = (rx*ry + ix*iy) / den;
+      z[2 * i + 1] = (ix*ry - rx*iy) / den;
+   }
+}
+
+/**
+ *    Calculates the modulus of each bin, stored as the real part of z.
+ *    The counterpart of HC_abs().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param x
+ *    Provides the x array.
+ *
+ * \param [out] z
+ *    Provides the output z array.
+ */
+
+void
+CX_abs
+(
+   long len,
+   const double * x,
+   double * z
+)
+{
+   int i;
+   int n = (int) (len / 2 + 1);
+   for (i = 0; i < n; i ++)
+   {
+      double rx = x[2 * i];
+      double ix = x[2 * i + 1];
+      z[2 * i]     = sqrt(rx * rx + ix * ix);
+      z[2 * i + 1] = 0.0;
+   }
+}
+
+/**
+ *    Calculates the "z" values for the "Puckette" lock, that is, the sum
+ *    of each bin with its two neighbors.  The counterpart of
+ *    HC_puckette_lock(); bin 0 and bin len/2 are copied as is, and are
+ *    not used as neighbors.
+ *
+ * \note:
+ *    y cannot be z!
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param y
+ *    Provides the y array.
+ *
+ * \param [out] z
+ *    Provides the output z array.
+ */
+
+void
+CX_puckette_lock (long len, const double * y, double * z)
+{
+   int k;
+   int n = (int) ((len + 1) / 2);
+   z[0] = y[0];
+   z[1] = 0.0;
+   for (k = 1; k < n; k ++)
+   {
+      z[2 * k]     = y[2 * k];
+      z[2 * k + 1] = y[2 * k + 1];
+      if (k > 1)
+      {
+         z[2 * k]     += y[2 * k - 2];
+         z[2 * k + 1] += y[2 * k - 1];
+      }
+      if (k < n - 1)
+      {
+         z[2 * k]     += y[2 * k + 2];
+         z[2 * k + 1] += y[2 * k + 3];
+      }
+   }
+   if (len % 2 == 0)
+   {
+      z[len]     = y[len];
+      z[len + 1] = 0.0;
+   }
+}
+
+/**
+ *    Provides the following calculations to implement a complex-phase
+ *    vocoder, the counterpart of HC_complex_phase_vocoder():
+ *
+\verbatim
+      Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]|
+\endverbatim
+ *
+ *    Since Y/X = Y X* / |X|^2, and the positive factor 1/|X|^2 cancels
+ *    in the normalization, the rotation is computed in a single pass as
+ *    Y X* / |Y X*|, with one square root and one division per bin and no
+ *    temporary buffers.  A bin where Y X* vanishes keeps the phase of
+ *    X[t_i], rather than producing a NaN that would be carried along in
+ *    f_out_old[] forever.
+ *
+ * \reference
+ *    M.Puckette (1995).
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param fs[]
+ *    Provides X[s_i], analysis-FFT at starting time of i step
+ *
+ * \param ft[]
+ *    Provides X[t_i], analysis-FFT at terminal time of i step.
+ *    Note: t_i - s_i = u_i - u_{i-1} = hop_out
+ *
+ * \param f_out_old[]
+ *    Provides Y[u_{i-1}], synthesis-FFT at (i-1) step
+ *
+ * \param [out] f_out[]
+ *    Provides Y[u_i], synthesis-FFT at i step.
+ *    You can use the same pointer f_out_old[] for this.
+ */
+
+void
+CX_complex_phase_vocoder
+(
+   int len,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+)
+{
+   int i;
+   int n = len / 2 + 1;
+   for (i = 0; i < n; i ++)
+   {
+      double rs = fs[2 * i];
+      double is = fs[2 * i + 1];
+      double ry = f_out_old[2 * i];
+      double iy = f_out_old[2 * i + 1];
+      double rt = ft[2 * i];
+      double it = ft[2 * i + 1];
+      double rq = ry * rs + iy * is;   /* q = Y[u_{i-1}] X*[s_i]            */
+      double iq = iy * rs - ry * is;
+      double mod = sqrt(rq * rq + iq * iq);
+      if (mod > 0.0)
+      {
+         rq /= mod;
+         iq /= mod;
+         f_out[2 * i]     = rt * rq - it * iq;
+         f_out[2 * i + 1] = rt * iq + it * rq;
+      }
+      else
+      {
+         f_out[2 * i]     = rt;
+         f_out[2 * i + 1] = it;
+      }
+   }
+}
+
+/**
+ *    Separates the spectra of two real signals that were transformed
+ *    together as the real and imaginary parts of one complex FFT.  The
+ *    counterpart of HC_split_stereo().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param z[2*len]
+ *    Provides the complex FFT, as (real, imag) pairs (fftw_complex).
+ *
+ * \param [out] left[CX_LENGTH(len)]
+ *    Provides the CX spectrum of the real part.
+ *
+ * \param [out] right[CX_LENGTH(len)]
+ *    Provides the CX spectrum of the imaginary part.
+ */
+
+void
+CX_split_stereo
+(
+   long len,
+   const double * z,
+   double * left,
+   double * right
+)
+{
+   int i;
+   left[0] = z[0];
+   left[1] = 0.0;
+   right[0] = z[1];
+   right[1] = 0.0;
+   for (i = 1; i < (len + 1) / 2; i ++)
+   {
+      double a = z[2 * i];
+      double b = z[2 * i + 1];
+      double c = z[2 * (len - i)];
+      double d = z[2 * (len - i) + 1];
+      left[2 * i]      = 0.5 * (a + c);
+      left[2 * i + 1]  = 0.5 * (b - d);
+      right[2 * i]     = 0.5 * (b + d);
+      right[2 * i + 1] = 0.5 * (c - a);
+   }
+   if (len % 2 == 0)
+   {
+      left[len]      = z[len];
+      left[len + 1]  = 0.0;
+      right[len]     = z[len + 1];
+      right[len + 1] = 0.0;
+   }
+}
+
+/*
+ * cx.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
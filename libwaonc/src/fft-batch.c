@@ -0,0 +1,319 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : batched FFT of several frames
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          fft-batch.c
+ *
+ *    This module provides the transform of several frames with a single
+ *    FFTW plan.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    With FFTW2 there is no "many" planner, but rfftw() takes a "howmany"
+ *    count and strides, which serves the same purpose.  The r2c layout is
+ *    FFTW3-only, so it is quietly turned off for FFTW2 builds.
+ */
+
+#include <stdio.h>                     /* fprintf()                           */
+#include <stdlib.h>                    /* malloc(), free()                    */
+
+#include "cx.h"                        /* CX_to_amp2(), CX_LENGTH(), ...      */
+#include "fft-batch.h"                 /* waon_fft_batch_t                    */
+#include "hc.h"                        /* HC_to_amp2(), HC_to_polar2()        */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+
+/**
+ *    Creates a batch of \a count frames of \a len samples, and its plan.
+ *
+ * \param len
+ *    Provides the FFT length.
+ *
+ * \param count
+ *    Provides the number of frames transformed by one fft_batch_execute()
+ *    call.  Values less than 1 are treated as 1.
+ *
+ * \param flag_window
+ *    Provides the window applied by fft_batch_load().
+ *
+ * \param r2c
+ *    If wtrue, the spectra are in the interleaved-complex layout of cx.h,
+ *    otherwise in the half-complex layout of hc.h.
+ *
+ * \return
+ *    Returns the new batch.  Free it with fft_batch_free().  The function
+ *    exits the application if memory cannot be allocated.
+ */
+
+waon_fft_batch_t *
+fft_batch_create
+(
+   long len,
+   int count,
+   filter_window_t flag_window,
+   wbool_t r2c
+)
+{
+   waon_fft_batch_t * batch =
+      (waon_fft_batch_t *) malloc(sizeof(waon_fft_batch_t));
+
+   CHECK_MALLOC(batch, "fft_batch_create");
+   if (count < 1)
+      count = 1;
+
+#ifdef FFTW2
+   r2c = wfalse;
+#endif
+
+   batch->len = len;
+   batch->count = count;
+   batch->r2c = r2c;
+   batch->spec_len = r2c ? CX_LENGTH(len) : len;
+   batch->flag_window = flag_window;
+
+#ifdef FFTW2
+   batch->in = (double *) malloc(sizeof(double) * len * count);
+   batch->out = (double *) malloc(sizeof(double) * batch->spec_len * count);
+#else
+   batch->in = (double *) fftw_malloc(sizeof(double) * len * count);
+   batch->out = (double *) fftw_malloc
+   (
+      sizeof(double) * batch->spec_len * count
+   );
+#endif
+   CHECK_MALLOC(batch->in, "fft_batch_create");
+   CHECK_MALLOC(batch->out, "fft_batch_create");
+
+#ifdef FFTW2
+   batch->plan = rfftw_create_plan(len, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE);
+#else
+   {
+      int n = (int) len;
+      if (r2c)
+      {
+         batch->plan = fftw_plan_many_dft_r2c
+         (
+            1, &n, count,
+            batch->in, NULL, 1, (int) len,
+            (fftw_complex *) batch->out, NULL, 1, (int) (batch->spec_len / 2),
+            FFTW_ESTIMATE
+         );
+      }
+      else
+      {
+         fftw_r2r_kind kind = FFTW_R2HC;
+         batch->plan = fftw_plan_many_r2r
+         (
+            1, &n, count,
+            batch->in, NULL, 1, (int) len,
+            batch->out, NULL, 1, (int) len,
+            &kind, FFTW_ESTIMATE
+         );
+      }
+   }
+#endif
+   return batch;
+}
+
+/**
+ *    Frees a batch created by fft_batch_create().
+ *
+ * \param batch
+ *    Provides the batch to free.  A null pointer is ignored.
+ */
+
+void
+fft_batch_free (waon_fft_batch_t * batch)
+{
+   if (not_nullptr(batch))
+   {
+#ifdef FFTW2
+      rfftw_destroy_plan(batch->plan);
+      free(batch->in);
+      free(batch->out);
+#else
+      fftw_destroy_plan(batch->plan);
+      fftw_free(batch->in);
+      fftw_free(batch->out);
+#endif
+      free(batch);
+   }
+}
+
+/**
+ *    Windows one frame into row \a k of the batch.
+ *
+ * \param batch
+ *    Provides the batch.
+ *
+ * \param k
+ *    Provides the row, in the range [0, count).
+ *
+ * \param x[len]
+ *    Provides the (unwindowed) frame.
+ */
+
+void
+fft_batch_load
+(
+   waon_fft_batch_t * batch,
+   int k,
+   const double * x
+)
+{
+   windowing
+   (
+      batch->len, x, batch->flag_window, 1.0, batch->in + k * batch->len
+   );
+}
+
+/**
+ *    Transforms all of the rows of the batch at once.  Rows that were not
+ *    loaded since the last call are transformed too, so the caller just
+ *    ignores their results.
+ *
+ * \param batch
+ *    Provides the batch.
+ */
+
+void
+fft_batch_execute (waon_fft_batch_t * batch)
+{
+#ifdef FFTW2
+   rfftw
+   (
+      batch->plan, batch->count,
+      batch->in, 1, batch->len, batch->out, 1, batch->len
+   );
+#else
+   fftw_execute(batch->plan);
+#endif
+}
+
+/**
+ *    Returns the spectrum of row \a k, in the layout of the batch.
+ *
+ * \param batch
+ *    Provides the batch.
+ *
+ * \param k
+ *    Provides the row, in the range [0, count).
+ *
+ * \return
+ *    Returns a pointer to the spec_len values of the spectrum.
+ */
+
+const double *
+fft_batch_spectrum
+(
+   const waon_fft_batch_t * batch,
+   int k
+)
+{
+   return batch->out + k * batch->spec_len;
+}
+
+/**
+ *    Calculates the power spectrum of the first \a n rows, the batched
+ *    counterpart of HC_to_amp2() and CX_to_amp2().
+ *
+ * \param batch
+ *    Provides the batch.
+ *
+ * \param n
+ *    Provides the number of rows to convert.
+ *
+ * \param scale
+ *    Provides the scale factor for the power.
+ *
+ * \param [out] amp2[n][len/2+1]
+ *    Provides the destination for the power spectra, one row per frame.
+ */
+
+void
+fft_batch_amp2
+(
+   const waon_fft_batch_t * batch,
+   int n,
+   double scale,
+   double * amp2
+)
+{
+   int k;
+   long nbin = batch->len / 2 + 1;
+   for (k = 0; k < n; ++k)
+   {
+      const double * y = fft_batch_spectrum(batch, k);
+      if (batch->r2c)
+         CX_to_amp2(batch->len, y, scale, amp2 + k * nbin);
+      else
+         HC_to_amp2(batch->len, y, scale, amp2 + k * nbin);
+   }
+}
+
+/**
+ *    Calculates the power and phase spectra of the first \a n rows, the
+ *    batched counterpart of HC_to_polar2() and CX_to_polar2().
+ *
+ * \param batch
+ *    Provides the batch.
+ *
+ * \param n
+ *    Provides the number of rows to convert.
+ *
+ * \param scale
+ *    Provides the scale factor for the power.
+ *
+ * \param [out] amp2[n][len/2+1]
+ *    Provides the destination for the power spectra, one row per frame.
+ *
+ * \param [out] phs[n][len/2+1]
+ *    Provides the destination for the phase spectra, one row per frame.
+ */
+
+void
+fft_batch_polar2
+(
+   const waon_fft_batch_t * batch,
+   int n,
+   double scale,
+   double * amp2,
+   double * phs
+)
+{
+   int k;
+   long nbin = batch->len / 2 + 1;
+   for (k = 0; k < n; ++k)
+   {
+      const double * y = fft_batch_spectrum(batch, k);
+      if (batch->r2c)
+         CX_to_polar2(batch->len, y, 0, scale, amp2 + k*nbin, phs + k*nbin);
+      else
+         HC_to_polar2(batch->len, y, 0, scale, amp2 + k*nbin, phs + k*nbin);
+   }
+}
+
+/*
+ * fft-batch.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -52,6 +52,7 @@
 #include "macros.h"                    /* wbool_t, errprint() macros          */
 #include "memory-check.h"              /* CHECK_MALLOC() macro                */
 #include "hc.h"                        /* HC_to_amp2()                        */
+#include "cx.h"                        /* CX_split_stereo()                   */
 
 /*
  * @gcc
@@ -571,6 +572,174 @@ apply_FFT
    }
 }
 
+/**
+ *    Creates the FFTW plan for windowed_FFT_stereo() and
+ *    apply_FFT_stereo(), a complex forward FFT of length \a len.
+ *
+ * \param len
+ *    Provides the FFT length.
+ *
+ * \param in[2*len]
+ *    Provides the input buffer, from fftw_malloc().
+ *
+ * \param out[2*len]
+ *    Provides the output buffer, from fftw_malloc().
+ *
+ * \return
+ *    Returns the plan.  Free it with fftw_destroy_plan().
+ */
+
+fftw_plan
+plan_FFT_stereo (int len, double * in, double * out)
+{
+   return fftw_plan_dft_1d
+   (
+      len, (fftw_complex *) in, (fftw_complex *) out,
+      FFTW_FORWARD, FFTW_ESTIMATE
+   );
+}
+
+/**
+ *    Applies the window to both channels of a stereo frame and transforms
+ *    them with one complex FFT, the left channel as the real part and the
+ *    right channel as the imaginary part.  The two spectra are then
+ *    separated by HC_split_stereo() or CX_split_stereo().  This costs
+ *    about as much as one of the two real FFTs it replaces.
+ *
+ * \param len
+ *    Provides the FFT length.
+ *
+ * \param left[len]
+ *    Provides the left channel.
+ *
+ * \param right[len]
+ *    Provides the right channel.
+ *
+ * \param flag_window
+ *    Provides the window type.
+ *
+ * \param plan
+ *    Provides the plan from plan_FFT_stereo().
+ *
+ * \param in[2*len]
+ *    Provides the input buffer of the plan.
+ *
+ * \param out[2*len]
+ *    Provides the output buffer of the plan.  It is also used to window
+ *    the channels.
+ *
+ * \param r2c
+ *    If wtrue, the spectra are made in the CX layout (cx.h), otherwise in
+ *    the HC layout (hc.h).
+ *
+ * \param [out] f_left[len or CX_LENGTH(len)]
+ *    Provides the spectrum of the left channel.  It can be \a in.
+ *
+ * \param [out] f_right[len or CX_LENGTH(len)]
+ *    Provides the spectrum of the right channel.  It can be \a in + len
+ *    in the HC layout.
+ */
+
+void
+windowed_FFT_stereo
+(
+   int len,
+   const double * left,
+   const double * right,
+   filter_window_t flag_window,
+   fftw_plan plan,
+   double * in,
+   double * out,
+   wbool_t r2c,
+   double * f_left,
+   double * f_right
+)
+{
+   int i;
+   windowing(len, left, flag_window, 1.0, out);
+   windowing(len, right, flag_window, 1.0, out + len);
+   for (i = 0; i < len; ++i)
+   {
+      in[2 * i] = out[i];
+      in[2 * i + 1] = out[len + i];
+   }
+   fftw_execute(plan);                       /* FFT: in[] -> out[]            */
+   if (r2c)
+      CX_split_stereo(len, out, f_left, f_right);
+   else
+      HC_split_stereo(len, out, f_left, f_right);
+}
+
+/**
+ *    The stereo counterpart of apply_FFT(), which transforms both channels
+ *    with windowed_FFT_stereo() and returns their amplitudes and phases.
+ *
+ * \param len
+ *    Provides the FFT length.
+ *
+ * \param left[len]
+ *    Provides the left channel.
+ *
+ * \param right[len]
+ *    Provides the right channel.
+ *
+ * \param flag_window
+ *    Provides the window type.
+ *
+ * \param plan
+ *    Provides the plan from plan_FFT_stereo().
+ *
+ * \param in[2*len]
+ *    Provides the input buffer of the plan.  It also receives the two HC
+ *    spectra.
+ *
+ * \param out[2*len]
+ *    Provides the output buffer of the plan.
+ *
+ * \param scale
+ *    Provides the amplitude scale factor, as in apply_FFT().
+ *
+ * \param [out] l_amp[len/2+1], l_phs[len/2+1]
+ *    Provide the amplitude and phase of the left channel.
+ *
+ * \param [out] r_amp[len/2+1], r_phs[len/2+1]
+ *    Provide the amplitude and phase of the right channel.
+ */
+
+void
+apply_FFT_stereo
+(
+   int len,
+   const double * left,
+   const double * right,
+   filter_window_t flag_window,
+   fftw_plan plan,
+   double * in,
+   double * out,
+   double scale,
+   double * l_amp,
+   double * l_phs,
+   double * r_amp,
+   double * r_phs
+)
+{
+   windowed_FFT_stereo
+   (
+      len, left, right, flag_window, plan, in, out, wfalse, in, in + len
+   );
+   HC_to_polar(len, in, 0, l_amp, l_phs);
+   HC_to_polar(len, in + len, 0, r_amp, r_phs);
+   if (scale != 1.0)
+   {
+      int i;
+      for (i = 0; i < len/2+1; ++i)
+      {
+         l_amp[i] /= scale;
+         r_amp[i] /= scale;
+      }
+   }
+}
+
 /**
  *    Prepares the window for the FFT.
  *
@@ -734,30 +903,20 @@ power_spectrum_fftw
  *       -  factor = 1.0 means full subtraction of the average
  *       -  factor = 2.0 means over subtraction
  *
+ * \param ave[n/2+1]
+ *    Provides the work space of the averages, owned by the caller so
+ *    that threads do not share it.
+ *
  * \param [out] p[(n+1)/2]
  *    Provides the subtracted power spectrum as a side-effect.
  */
 
 void
-power_subtract_ave (int n, double * p, int m, double factor)
+power_subtract_ave (int n, double * p, int m, double factor, double * ave)
 {
-   static double * ave = nullptr;
-   static int n_ave = 0;
    int nlen = n / 2 + 1;
    int i;
    int k;
-   if (is_nullptr(ave))
-   {
-      ave = (double *) malloc(sizeof(double) * nlen);
-      CHECK_MALLOC(ave, "power_subtract_ave");
-      n_ave = nlen;
-   }
-   else if (n_ave < nlen)
-   {
-      ave = (double *) realloc(ave, sizeof(double) * nlen);
-      CHECK_MALLOC(ave, "power_subtract_ave");
-      n_ave = nlen;
-   }
    for (i = 0; i < nlen; ++i)         /* full span */
    {
       int nave = 0;
@@ -781,7 +940,6 @@ power_subtract_ave (int n, double * p, int m, double factor)
       else
          p[i] = 0.0;
    }
-   free(ave);
 }
 
 /**
@@ -799,30 +957,20 @@ power_subtract_ave (int n, double * p, int m, double factor)
  *       -  factor = 1.0 means full subtraction of the average
  *       -  factor = 2.0 means over subtraction
  *
+ * \param oct[n/2+1]
+ *    Provides the work space of the octaves, owned by the caller, as
+ *    with power_subtract_ave().
+ *
  * \param [out] p[(n+1)/2]
  *    Provides the subtracted power spectrum.
  */
 
 void
-power_subtract_octave (int n, double * p, double factor)
+power_subtract_octave (int n, double * p, double factor, double * oct)
 {
-   static double * oct = NULL;
-   static int n_oct = 0;
    int nlen = (n + 1) / 2;
    int i;
    int i2;
-   if (oct == NULL)
-   {
-      oct = (double *) malloc(sizeof(double) * (n / 2 + 1));
-      CHECK_MALLOC(oct, "power_subtract_octave");
-      n_oct = n / 2 + 1;
-   }
-   else if (n_oct < (n / 2 + 1))
-   {
-      oct = (double *) realloc(oct, sizeof(double) * (n / 2 + 1));
-      CHECK_MALLOC(oct, "power_subtract_octave");
-      n_oct = n / 2 + 1;
-   }
    oct[0] = p[0];
    for (i = 1; i < nlen / 2 + 1; ++i)
    {
@@ -845,7 +993,6 @@ power_subtract_octave (int n, double * p, double factor)
       else
          p[i] = 0.0;
    }
-   free(oct);
 }
 
 /*
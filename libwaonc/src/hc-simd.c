@@ -0,0 +1,667 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : vectorized half-complex kernels
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          hc-simd.c
+ *
+ *    This module provides SIMD versions of HC_complex_phase_vocoder() and
+ *    HC_puckette_lock().
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    In the HC layout, the imaginary part of bin k is at len-k, so the
+ *    imaginary parts of the bins k to k+w-1 are a contiguous block read
+ *    backwards.  Each vector kernel loads that block and reverses it in
+ *    the register, and reverses it again to store it.
+ *
+ *    The phase vocoder uses the one-pass form of CX_complex_phase_vocoder()
+ *    (see cx.c), Y[u_i] = X[t_i] q / |q| with q = Y[u_{i-1}] X*[s_i].  The
+ *    1/|q| comes from the reciprocal-square-root estimate of the
+ *    instruction set, refined by Newton steps r' = r (3 - m r^2) / 2:
+ *
+ *       -  SSE2, AVX2:  rsqrtps (12 bits, float) and 2 steps.
+ *       -  NEON:  frsqrte (8 bits, double) and 3 steps.
+ *
+ *    The result is within about 1e-13 (relative) of the scalar division.
+ *    The float estimate only covers FLT_MIN <= |q|^2 <= FLT_MAX; a block
+ *    with a bin outside of that range (in particular, a silent bin, where
+ *    q is 0) is done by the scalar code.  Like the CX version, and unlike
+ *    HC_complex_phase_vocoder(), a bin where q is 0 takes X[t_i] instead
+ *    of becoming a NaN.
+ *
+ *    The Puckette lock is a three-bin sum, which, except for its two end
+ *    bins, is the same contiguous sum over the real and the imaginary
+ *    halves.  The sums are done in the same order as HC_puckette_lock(),
+ *    so the results are identical.
+ */
+
+#include <float.h>                     /* FLT_MIN, FLT_MAX, DBL_MIN, ...      */
+#include <math.h>                      /* sqrt()                              */
+
+#include "hc.h"                        /* HC_puckette_lock()                  */
+#include "hc-simd.h"                   /* hc_simd_t                           */
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#define HC_SIMD_X86
+#include <immintrin.h>                 /* SSE2 and AVX2 intrinsics            */
+#define HC_TARGET(isa)                 __attribute__((target(isa)))
+#elif defined __aarch64__ && defined __ARM_NEON
+#define HC_SIMD_ARM
+#include <arm_neon.h>                  /* NEON intrinsics                     */
+#endif
+
+/**
+ *    Holds the instruction set of the kernels.  HC_SIMD_MAX means it is
+ *    not yet picked.
+ */
+
+static hc_simd_t s_level = HC_SIMD_MAX;
+
+/**
+ *    Does one bin (1 <= i < (len+1)/2) of the phase vocoder, in the same
+ *    way as CX_complex_phase_vocoder().
+ */
+
+static void
+pv_bin
+(
+   int len,
+   int i,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+)
+{
+   double rs = fs[i];
+   double is = fs[len - i];
+   double ry = f_out_old[i];
+   double iy = f_out_old[len - i];
+   double rt = ft[i];
+   double it = ft[len - i];
+   double rq = ry * rs + iy * is;      /* q = Y[u_{i-1}] X*[s_i]              */
+   double iq = iy * rs - ry * is;
+   double mod = sqrt(rq * rq + iq * iq);
+   if (mod > 0.0)
+   {
+      rq /= mod;
+      iq /= mod;
+      f_out[i]       = rt * rq - it * iq;
+      f_out[len - i] = rt * iq + it * rq;
+   }
+   else
+   {
+      f_out[i]       = rt;
+      f_out[len - i] = it;
+   }
+}
+
+/**
+ *    Does a purely real bin (0, or len/2 for an even len).
+ */
+
+static void
+pv_real_bin
+(
+   int i,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+)
+{
+   double q = f_out_old[i] * fs[i];
+   if (q > 0.0)
+      f_out[i] = ft[i];
+   else if (q < 0.0)
+      f_out[i] = -ft[i];
+   else
+      f_out[i] = ft[i];
+}
+
+/**
+ *    Sets z[j] = (y[j] + y[j + d1]) + y[j + d2] for j = a to b-1.
+ */
+
+static void
+box3
+(
+   const double * y,
+   double * z,
+   long a,
+   long b,
+   int d1,
+   int d2
+)
+{
+   long j;
+   for (j = a; j < b; ++j)
+      z[j] = (y[j] + y[j + d1]) + y[j + d2];
+}
+
+#ifdef HC_SIMD_X86
+
+/**
+ *    Does the bins from i, two at a time, while they are below n.
+ *
+ * \return
+ *    Returns the first bin not done.
+ */
+
+HC_TARGET("sse2")
+static int
+pv_bins_sse2
+(
+   int len,
+   int i,
+   int n,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+)
+{
+   const __m128d half = _mm_set1_pd(0.5);
+   const __m128d three_halves = _mm_set1_pd(1.5);
+   const __m128d lo = _mm_set1_pd(FLT_MIN);
+   const __m128d hi = _mm_set1_pd(FLT_MAX);
+   for ( ; i + 2 <= n; i += 2)
+   {
+      int j = len - i - 1;             /* imaginary parts of bins i+1, i      */
+      __m128d rs = _mm_loadu_pd(fs + i);
+      __m128d is = _mm_loadu_pd(fs + j);
+      __m128d ry = _mm_loadu_pd(f_out_old + i);
+      __m128d iy = _mm_loadu_pd(f_out_old + j);
+      __m128d rt = _mm_loadu_pd(ft + i);
+      __m128d it = _mm_loadu_pd(ft + j);
+      __m128d rq, iq, m2, ok, r;
+      is = _mm_shuffle_pd(is, is, 1);
+      iy = _mm_shuffle_pd(iy, iy, 1);
+      it = _mm_shuffle_pd(it, it, 1);
+      rq = _mm_add_pd(_mm_mul_pd(ry, rs), _mm_mul_pd(iy, is));
+      iq = _mm_sub_pd(_mm_mul_pd(iy, rs), _mm_mul_pd(ry, is));
+      m2 = _mm_add_pd(_mm_mul_pd(rq, rq), _mm_mul_pd(iq, iq));
+      ok = _mm_and_pd(_mm_cmpge_pd(m2, lo), _mm_cmple_pd(m2, hi));
+      if (_mm_movemask_pd(ok) != 0x3)
+      {
+         pv_bin(len, i, fs, ft, f_out_old, f_out);
+         pv_bin(len, i + 1, fs, ft, f_out_old, f_out);
+         continue;
+      }
+      r = _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(m2)));
+      r = _mm_mul_pd
+      (
+         r, _mm_sub_pd(three_halves, _mm_mul_pd(_mm_mul_pd(half, m2),
+            _mm_mul_pd(r, r)))
+      );
+      r = _mm_mul_pd
+      (
+         r, _mm_sub_pd(three_halves, _mm_mul_pd(_mm_mul_pd(half, m2),
+            _mm_mul_pd(r, r)))
+      );
+      rq = _mm_mul_pd(rq, r);
+      iq = _mm_mul_pd(iq, r);
+      _mm_storeu_pd
+      (
+         f_out + i, _mm_sub_pd(_mm_mul_pd(rt, rq), _mm_mul_pd(it, iq))
+      );
+      iq = _mm_add_pd(_mm_mul_pd(rt, iq), _mm_mul_pd(it, rq));
+      _mm_storeu_pd(f_out + j, _mm_shuffle_pd(iq, iq, 1));
+   }
+   return i;
+}
+
+/**
+ *    The AVX2 version of pv_bins_sse2(), four bins at a time.
+ */
+
+HC_TARGET("avx2")
+static int
+pv_bins_avx2
+(
+   int len,
+   int i,
+   int n,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+)
+{
+   const __m256d half = _mm256_set1_pd(0.5);
+   const __m256d three_halves = _mm256_set1_pd(1.5);
+   const __m256d lo = _mm256_set1_pd(FLT_MIN);
+   const __m256d hi = _mm256_set1_pd(FLT_MAX);
+   for ( ; i + 4 <= n; i += 4)
+   {
+      int j = len - i - 3;             /* imaginary parts of bins i+3 to i    */
+      __m256d rs = _mm256_loadu_pd(fs + i);
+      __m256d is = _mm256_loadu_pd(fs + j);
+      __m256d ry = _mm256_loadu_pd(f_out_old + i);
+      __m256d iy = _mm256_loadu_pd(f_out_old + j);
+      __m256d rt = _mm256_loadu_pd(ft + i);
+      __m256d it = _mm256_loadu_pd(ft + j);
+      __m256d rq, iq, m2, ok, r;
+      is = _mm256_permute4x64_pd(is, 0x1B);
+      iy = _mm256_permute4x64_pd(iy, 0x1B);
+      it = _mm256_permute4x64_pd(it, 0x1B);
+      rq = _mm256_add_pd(_mm256_mul_pd(ry, rs), _mm256_mul_pd(iy, is));
+      iq = _mm256_sub_pd(_mm256_mul_pd(iy, rs), _mm256_mul_pd(ry, is));
+      m2 = _mm256_add_pd(_mm256_mul_pd(rq, rq), _mm256_mul_pd(iq, iq));
+      ok = _mm256_and_pd
+      (
+         _mm256_cmp_pd(m2, lo, _CMP_GE_OQ), _mm256_cmp_pd(m2, hi, _CMP_LE_OQ)
+      );
+      if (_mm256_movemask_pd(ok) != 0xF)
+      {
+         int k;
+         for (k = 0; k < 4; ++k)
+            pv_bin(len, i + k, fs, ft, f_out_old, f_out);
+
+         continue;
+      }
+      r = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(m2)));
+      r = _mm256_mul_pd
+      (
+         r, _mm256_sub_pd(three_halves, _mm256_mul_pd(_mm256_mul_pd(half, m2),
+            _mm256_mul_pd(r, r)))
+      );
+      r = _mm256_mul_pd
+      (
+         r, _mm256_sub_pd(three_halves, _mm256_mul_pd(_mm256_mul_pd(half, m2),
+            _mm256_mul_pd(r, r)))
+      );
+      rq = _mm256_mul_pd(rq, r);
+      iq = _mm256_mul_pd(iq, r);
+      _mm256_storeu_pd
+      (
+         f_out + i,
+         _mm256_sub_pd(_mm256_mul_pd(rt, rq), _mm256_mul_pd(it, iq))
+      );
+      iq = _mm256_add_pd(_mm256_mul_pd(rt, iq), _mm256_mul_pd(it, rq));
+      _mm256_storeu_pd(f_out + j, _mm256_permute4x64_pd(iq, 0x1B));
+   }
+   return i;
+}
+
+/**
+ *    The SSE2 version of box3(), two bins at a time.
+ *
+ * \return
+ *    Returns the first bin not done.
+ */
+
+HC_TARGET("sse2")
+static long
+box3_sse2
+(
+   const double * y,
+   double * z,
+   long a,
+   long b,
+   int d1,
+   int d2
+)
+{
+   for ( ; a + 2 <= b; a += 2)
+   {
+      __m128d s = _mm_add_pd(_mm_loadu_pd(y + a), _mm_loadu_pd(y + a + d1));
+      _mm_storeu_pd(z + a, _mm_add_pd(s, _mm_loadu_pd(y + a + d2)));
+   }
+   return a;
+}
+
+/**
+ *    The AVX2 version of box3(), four bins at a time.
+ */
+
+HC_TARGET("avx2")
+static long
+box3_avx2
+(
+   const double * y,
+   double * z,
+   long a,
+   long b,
+   int d1,
+   int d2
+)
+{
+   for ( ; a + 4 <= b; a += 4)
+   {
+      __m256d s = _mm256_add_pd
+      (
+         _mm256_loadu_pd(y + a), _mm256_loadu_pd(y + a + d1)
+      );
+      _mm256_storeu_pd(z + a, _mm256_add_pd(s, _mm256_loadu_pd(y + a + d2)));
+   }
+   return a;
+}
+
+#endif   /* HC_SIMD_X86 */
+
+#ifdef HC_SIMD_ARM
+
+/**
+ *    The NEON version of pv_bins_sse2(), two bins at a time.
+ */
+
+static int
+pv_bins_neon
+(
+   int len,
+   int i,
+   int n,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+)
+{
+   const float64x2_t lo = vdupq_n_f64(DBL_MIN);
+   const float64x2_t hi = vdupq_n_f64(DBL_MAX);
+   for ( ; i + 2 <= n; i += 2)
+   {
+      int j = len - i - 1;             /* imaginary parts of bins i+1, i      */
+      float64x2_t rs = vld1q_f64(fs + i);
+      float64x2_t is = vld1q_f64(fs + j);
+      float64x2_t ry = vld1q_f64(f_out_old + i);
+      float64x2_t iy = vld1q_f64(f_out_old + j);
+      float64x2_t rt = vld1q_f64(ft + i);
+      float64x2_t it = vld1q_f64(ft + j);
+      float64x2_t rq, iq, m2, r;
+      uint64x2_t ok;
+      is = vextq_f64(is, is, 1);
+      iy = vextq_f64(iy, iy, 1);
+      it = vextq_f64(it, it, 1);
+      rq = vaddq_f64(vmulq_f64(ry, rs), vmulq_f64(iy, is));
+      iq = vsubq_f64(vmulq_f64(iy, rs), vmulq_f64(ry, is));
+      m2 = vaddq_f64(vmulq_f64(rq, rq), vmulq_f64(iq, iq));
+      ok = vandq_u64(vcgeq_f64(m2, lo), vcleq_f64(m2, hi));
+      if ((vgetq_lane_u64(ok, 0) & vgetq_lane_u64(ok, 1)) == 0)
+      {
+         pv_bin(len, i, fs, ft, f_out_old, f_out);
+         pv_bin(len, i + 1, fs, ft, f_out_old, f_out);
+         continue;
+      }
+      r = vrsqrteq_f64(m2);
+      r = vmulq_f64(r, vrsqrtsq_f64(vmulq_f64(m2, r), r));
+      r = vmulq_f64(r, vrsqrtsq_f64(vmulq_f64(m2, r), r));
+      r = vmulq_f64(r, vrsqrtsq_f64(vmulq_f64(m2, r), r));
+      rq = vmulq_f64(rq, r);
+      iq = vmulq_f64(iq, r);
+      vst1q_f64(f_out + i, vsubq_f64(vmulq_f64(rt, rq), vmulq_f64(it, iq)));
+      iq = vaddq_f64(vmulq_f64(rt, iq), vmulq_f64(it, rq));
+      vst1q_f64(f_out + j, vextq_f64(iq, iq, 1));
+   }
+   return i;
+}
+
+/**
+ *    The NEON version of box3(), two bins at a time.
+ */
+
+static long
+box3_neon
+(
+   const double * y,
+   double * z,
+   long a,
+   long b,
+   int d1,
+   int d2
+)
+{
+   for ( ; a + 2 <= b; a += 2)
+   {
+      float64x2_t s = vaddq_f64(vld1q_f64(y + a), vld1q_f64(y + a + d1));
+      vst1q_f64(z + a, vaddq_f64(s, vld1q_f64(y + a + d2)));
+   }
+   return a;
+}
+
+#endif   /* HC_SIMD_ARM */
+
+/**
+ *    Gets the best instruction set of the processor.
+ */
+
+hc_simd_t
+hc_simd_best (void)
+{
+#if defined HC_SIMD_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      return HC_SIMD_AVX2;
+   else if (__builtin_cpu_supports("sse2"))
+      return HC_SIMD_SSE2;
+   else
+      return HC_SIMD_NONE;
+#elif defined HC_SIMD_ARM
+   return HC_SIMD_NEON;
+#else
+   return HC_SIMD_NONE;
+#endif
+}
+
+/**
+ *    Gets the instruction set used by the kernels.  The first call picks
+ *    hc_simd_best().
+ */
+
+hc_simd_t
+hc_simd_level (void)
+{
+   if (s_level == HC_SIMD_MAX)
+      s_level = hc_simd_best();
+
+   return s_level;
+}
+
+/**
+ *    Selects the instruction set of the kernels, e.g. to compare them.
+ *
+ * \param level
+ *    Provides the instruction set.
+ *
+ * \return
+ *    Returns wtrue if the processor supports it.  Otherwise, the setting
+ *    is not changed.
+ */
+
+wbool_t
+hc_simd_set_level (hc_simd_t level)
+{
+   hc_simd_t best = hc_simd_best();
+   wbool_t result =
+      level == HC_SIMD_NONE || level == best ||
+      (level == HC_SIMD_SSE2 && best == HC_SIMD_AVX2);
+
+   if (result)
+      s_level = level;
+
+   return result;
+}
+
+/**
+ *    Gets the name of an instruction set.
+ */
+
+const char *
+hc_simd_name (hc_simd_t level)
+{
+   switch (level)
+   {
+   case HC_SIMD_NONE:   return "scalar";
+   case HC_SIMD_SSE2:   return "sse2";
+   case HC_SIMD_AVX2:   return "avx2";
+   case HC_SIMD_NEON:   return "neon";
+   default:             return "?";
+   }
+}
+
+/**
+ *    The vectorized HC_complex_phase_vocoder():
+ *
+\verbatim
+      Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]|
+\endverbatim
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param fs[len]
+ *    Provides X[s_i], analysis-FFT at starting time of i step.
+ *
+ * \param ft[len]
+ *    Provides X[t_i], analysis-FFT at terminal time of i step.
+ *
+ * \param f_out_old[len]
+ *    Provides Y[u_{i-1}], synthesis-FFT at (i-1) step.
+ *
+ * \param [out] f_out[len]
+ *    Provides Y[u_i], synthesis-FFT at i step.  It can be f_out_old[].
+ */
+
+void
+HC_complex_phase_vocoder_simd
+(
+   int len,
+   const double * fs,
+   const double * ft,
+   const double * f_out_old,
+   double * f_out
+)
+{
+   int n = (len + 1) / 2;
+   int i = 1;
+   switch (hc_simd_level())
+   {
+#ifdef HC_SIMD_X86
+   case HC_SIMD_AVX2:
+
+      i = pv_bins_avx2(len, i, n, fs, ft, f_out_old, f_out);
+      break;
+
+   case HC_SIMD_SSE2:
+
+      i = pv_bins_sse2(len, i, n, fs, ft, f_out_old, f_out);
+      break;
+#endif
+#ifdef HC_SIMD_ARM
+   case HC_SIMD_NEON:
+
+      i = pv_bins_neon(len, i, n, fs, ft, f_out_old, f_out);
+      break;
+#endif
+   default:
+
+      break;
+   }
+   for ( ; i < n; ++i)
+      pv_bin(len, i, fs, ft, f_out_old, f_out);
+
+   pv_real_bin(0, fs, ft, f_out_old, f_out);
+   if (len % 2 == 0)
+      pv_real_bin(len / 2, fs, ft, f_out_old, f_out);
+}
+
+/**
+ *    The vectorized HC_puckette_lock().
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param y[len]
+ *    Provides the spectrum.
+ *
+ * \param [out] z[len]
+ *    Provides the locked spectrum.  It cannot be y[].
+ */
+
+void
+HC_puckette_lock_simd (long len, const double * y, double * z)
+{
+   long n = (len + 1) / 2;
+   long a, b;
+   int pass;
+   if (n < 4)
+   {
+      HC_puckette_lock(len, y, z);     /* no interior bins to speak of        */
+      return;
+   }
+   z[0] = y[0];
+
+   /*
+    * Bins 1 and n-1 have only one neighbor.
+    */
+
+   z[1]           = y[1] + y[2];
+   z[len - 1]     = y[len - 1] + y[len - 2];
+   z[n - 1]       = y[n - 1] + y[n - 2];
+   z[len - n + 1] = y[len - n + 1] + y[len - n + 2];
+
+   /*
+    * Bins 2 to n-2:  the real parts add k, k-1, k+1; the imaginary parts,
+    * at j = len-k, add j, j+1, j-1.
+    */
+
+   for (pass = 0; pass < 2; ++pass)
+   {
+      int d1 = pass == 0 ? -1 : +1;
+      a = pass == 0 ? 2 : len - n + 2;
+      b = pass == 0 ? n - 1 : len - 1;
+      switch (hc_simd_level())
+      {
+#ifdef HC_SIMD_X86
+      case HC_SIMD_AVX2:
+
+         a = box3_avx2(y, z, a, b, d1, -d1);
+         break;
+
+      case HC_SIMD_SSE2:
+
+         a = box3_sse2(y, z, a, b, d1, -d1);
+         break;
+#endif
+#ifdef HC_SIMD_ARM
+      case HC_SIMD_NEON:
+
+         a = box3_neon(y, z, a, b, d1, -d1);
+         break;
+#endif
+      default:
+
+         break;
+      }
+      box3(y, z, a, b, d1, -d1);
+   }
+   if (len % 2 == 0)
+      z[len/2] = y[len/2];
+}
+
+/*
+ * hc-simd.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
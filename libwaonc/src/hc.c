@@ -582,6 +582,60 @@ HC_complex_phase_vocoder
    HC_mul(len, ft, tmp1, f_out);
 }
 
+/**
+ *    Separates the spectra of two real signals that were transformed
+ *    together, the left as the real part and the right as the imaginary
+ *    part of one complex FFT.  Since the FFT of a real signal has the
+ *    symmetry X(len-k) = X*(k),
+ *
+\verbatim
+      L(k) = (Z(k) + Z*(len-k)) / 2
+      R(k) = (Z(k) - Z*(len-k)) / 2i
+\endverbatim
+ *
+ * \param len
+ *    Provides the length of the FFT.
+ *
+ * \param z[2*len]
+ *    Provides the complex FFT Z(k), as (real, imag) pairs (fftw_complex).
+ *
+ * \param [out] left[len]
+ *    Provides the HC spectrum of the real part.
+ *
+ * \param [out] right[len]
+ *    Provides the HC spectrum of the imaginary part.
+ */
+
+void
+HC_split_stereo
+(
+   long len,
+   const double * z,
+   double * left,
+   double * right
+)
+{
+   int i;
+   left[0] = z[0];
+   right[0] = z[1];
+   for (i = 1; i < (len + 1) / 2; i ++)
+   {
+      double a = z[2 * i];
+      double b = z[2 * i + 1];
+      double c = z[2 * (len - i)];
+      double d = z[2 * (len - i) + 1];
+      left[i] = 0.5 * (a + c);
+      left[len - i] = 0.5 * (b - d);
+      right[i] = 0.5 * (b + d);
+      right[len - i] = 0.5 * (c - a);
+   }
+   if (len % 2 == 0)
+   {
+      left[len/2] = z[len];
+      right[len/2] = z[len + 1];
+   }
+}
+
 /*
  * hc.c
  *
@@ -0,0 +1,143 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : JACK client setup
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          jack-client.c
+ *
+ *    This module provides the JACK client setup shared by the programs
+ *    that play or capture through JACK.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ */
+
+#include <stdio.h>                     /* fprintf()                           */
+#include <stdlib.h>                    /* free()                              */
+
+#include "jack-client.h"               /* waon_jack_open()                    */
+
+/**
+ *    Opens a client connection to the JACK server, starting the server
+ *    if need be.
+ *
+ * \param name
+ *    Provides the name of the client.  The server makes it unique.
+ *
+ * \return
+ *    Returns the client, or null if the server cannot be reached.
+ */
+
+jack_client_t *
+waon_jack_open (const char * name)
+{
+   jack_status_t status;
+   jack_client_t * client = jack_client_open
+   (
+      name, JackNullOption, &status, (const char *) nullptr
+   );
+   if (is_nullptr(client))
+   {
+      fprintf(stderr, "jack_client_open() failed, status = 0x%2.0x\n", status);
+      if (status & JackServerFailed)
+         fprintf(stderr, "Unable to connect to JACK server\n");
+
+      return nullptr;
+   }
+   if (status & JackServerStarted)
+      fprintf(stderr, "JACK server started\n");
+
+   if (status & JackNameNotUnique)
+   {
+      fprintf
+      (
+         stderr, "unique name `%s' assigned\n", jack_get_client_name(client)
+      );
+   }
+   return client;
+}
+
+/**
+ *    Connects a port of an active client to the first physical port of
+ *    the other direction.  Note the orientation of the ports of the
+ *    backend:  the playback ports are inputs, and the capture ports are
+ *    outputs.
+ *
+ * \param client
+ *    Provides the client.  It must be activated first.
+ *
+ * \param port
+ *    Provides the port of the client.
+ *
+ * \param is_output
+ *    True to connect an output to the playback, false to connect the
+ *    capture to an input.
+ *
+ * \return
+ *    Returns true if the port is connected.
+ */
+
+wbool_t
+waon_jack_connect_physical
+(
+   jack_client_t * client,
+   jack_port_t * port,
+   wbool_t is_output
+)
+{
+   wbool_t result = wfalse;
+   const char ** ports = jack_get_ports
+   (
+      client, nullptr, nullptr,
+      JackPortIsPhysical | (is_output ? JackPortIsInput : JackPortIsOutput)
+   );
+   if (is_nullptr(ports))
+   {
+      fprintf
+      (
+         stderr, "no physical %s ports\n", is_output ? "playback" : "capture"
+      );
+   }
+   else
+   {
+      int rc = is_output ?
+         jack_connect(client, jack_port_name(port), ports[0]) :
+         jack_connect(client, ports[0], jack_port_name(port));
+
+      if (rc == 0)
+         result = wtrue;
+      else
+      {
+         fprintf
+         (
+            stderr, "cannot connect %s ports\n", is_output ? "output" : "input"
+         );
+      }
+      free(ports);
+   }
+   return result;
+}
+
+/*
+ * jack-client.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,345 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : live analysis
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          live.c
+ *
+ *    This module runs stages 1 and 2 of processing() on a stream of
+ *    samples, one hop at a time, for live input.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    A step shifts the hop of new samples into the frame and transforms
+ *    it.  The spectrum is kept scaled by the FFT length, for the display,
+ *    and the copy given to note_intensity() is scaled by init_den() as in
+ *    processing(), so that --cutoff and --relative keep their meaning.
+ *    Unlike processing(), the first frames are padded with silence rather
+ *    than waited for.
+ */
+
+#include <math.h>                      /* pow(), M_PI                         */
+#include <stdlib.h>                    /* malloc(), free()                    */
+#include <string.h>                    /* memmove(), memset()                 */
+
+#include "live.h"                      /* waon_live_t                         */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "midi.h"                      /* g_midi_pitch_info                   */
+
+/**
+ *    Creates the live analysis.  This makes an FFTW plan.
+ *
+ * \param parameters
+ *    Provides the FFT length, the hop (shift_hop, a quarter of the FFT
+ *    length if 0), the window, the phase correction, the cutoffs, the
+ *    note range, and the energy gate.
+ *
+ * \param scratchpad
+ *    Provides the absolute-cutoff flag and the patch, see init_patch().
+ *
+ * \param samplerate
+ *    Provides the rate of the input.
+ *
+ * \return
+ *    Returns the new analysis.  Free it with live_free().  The function
+ *    exits the application if memory cannot be allocated.
+ */
+
+waon_live_t *
+live_create
+(
+   const waon_parameters_t * parameters,
+   const analysis_scratchpad_t * scratchpad,
+   int samplerate
+)
+{
+   long len = parameters->fft_len;
+   long nbin = len / 2 + 1;
+   int i;
+   waon_live_t * live = (waon_live_t *) malloc(sizeof(waon_live_t));
+   CHECK_MALLOC(live, "live_create");
+   live->fft_len = len;
+   live->hop = parameters->shift_hop > 0 ? parameters->shift_hop : len / 4;
+   if (live->hop > len)
+      live->hop = len;
+
+   live->samplerate = samplerate;
+   live->flag_phase = parameters->flag_phase;
+   live->cut_ratio = parameters->cut_ratio;
+   live->rel_cut_ratio = parameters->rel_cut_ratio;
+   live->scratchpad = *scratchpad;
+   live->t0 = (double) len / (double) samplerate;
+   live->den = init_den(len, (filter_window_t) parameters->flag_window);
+   live->i0 = (int)
+   (
+      g_midi_pitch_info.mp_mid2freq[parameters->notelow] * live->t0 - 0.5
+   );
+   live->i1 = (int)
+   (
+      g_midi_pitch_info.mp_mid2freq[parameters->notetop] * live->t0 - 0.5
+   ) + 1;
+   if (live->i0 <= 0)
+      live->i0 = 1;
+
+   if (live->i1 >= len / 2)
+      live->i1 = len / 2 - 1;
+
+   live->gate = 0.0;
+   if (parameters->energy_gate)
+      live->gate = pow(10.0, parameters->cut_ratio);   /* see sweep_gate() */
+
+   if (parameters->psub_n != 0 || parameters->oct_f != 0.0)
+      infoprint("The drum and octave removals are not applied live");
+
+   live->batch = fft_batch_create
+   (
+      len, 1, (filter_window_t) parameters->flag_window, wfalse
+   );
+   live->frame = (double *) malloc(sizeof(double) * len);
+   live->phs = (double *) malloc(sizeof(double) * nbin);
+   live->ph0 = (double *) malloc(sizeof(double) * nbin);
+   live->fp = (double *) malloc(sizeof(double) * nbin);
+   live->power = (double *) malloc(sizeof(double) * nbin);
+   live->amp2 = (double *) malloc(sizeof(double) * nbin);
+   live->dphi = (double *) malloc(sizeof(double) * nbin);
+   CHECK_MALLOC(live->frame, "live_create");
+   CHECK_MALLOC(live->phs, "live_create");
+   CHECK_MALLOC(live->ph0, "live_create");
+   CHECK_MALLOC(live->fp, "live_create");
+   CHECK_MALLOC(live->power, "live_create");
+   CHECK_MALLOC(live->amp2, "live_create");
+   CHECK_MALLOC(live->dphi, "live_create");
+   memset(live->frame, 0, sizeof(double) * len);
+   memset(live->amp2, 0, sizeof(double) * nbin);
+   memset(live->dphi, 0, sizeof(double) * nbin);
+   memset(live->vel, 0, sizeof live->vel);
+   for (i = 0; i < MIDI_NOTE_COUNT; ++i)
+      live->on_vel[i] = WAON_UNINITIALIZED;
+
+   live->have_ph0 = wfalse;
+   live->step = 0;
+   live->mean_square = 0.0;
+   return live;
+}
+
+/**
+ *    Analyses the frame that ends with the next hop of samples.  This
+ *    neither allocates nor locks.
+ *
+ * \param live
+ *    Provides the analysis.  The results are left in amp2[], dphi[],
+ *    vel[] and mean_square.
+ *
+ * \param x
+ *    Provides the hop of new samples (mono), [live->hop].
+ */
+
+void
+live_step (waon_live_t * live, const float * x)
+{
+   long len = live->fft_len;
+   long nbin = len / 2 + 1;
+   long keep = len - live->hop;
+   long i;
+   memmove(live->frame, live->frame + live->hop, sizeof(double) * keep);
+   for (i = 0; i < live->hop; ++i)
+      live->frame[keep + i] = (double) x[i];
+
+   ++live->step;
+   live->mean_square = frame_mean_square(len, live->frame);
+   fft_batch_load(live->batch, 0, live->frame);
+   fft_batch_execute(live->batch);
+   fft_batch_polar2(live->batch, 1, (double) len, live->amp2, live->phs);
+   for (i = 0; i < nbin; ++i)
+   {
+      double d = 0.0;
+      if (live->flag_phase && live->have_ph0)
+      {
+         double twopi = 2.0 * M_PI;
+         d = live->phs[i] - live->ph0[i] -
+            twopi * (double) i / (double) len * (double) live->hop;
+
+         for ( ; d >= M_PI; d -= twopi)
+            ;
+
+         for ( ; d < -M_PI; d += twopi)
+            ;
+
+         d = d / twopi / (double) live->hop;
+      }
+      live->dphi[i] = d;
+      live->ph0[i] = live->phs[i];
+      live->fp[i] = ((double) i / (double) len + d) * live->samplerate;
+      live->power[i] = live->amp2[i] * (double) len / live->den;
+   }
+   live->have_ph0 = wtrue;
+   if (live->gate > 0.0 && live->mean_square <= live->gate)
+   {
+      memset(live->vel, 0, sizeof live->vel);   /* gated:  no notes       */
+      return;
+   }
+   note_intensity
+   (
+      live->power, live->flag_phase ? live->fp : nullptr,
+      live->cut_ratio, live->rel_cut_ratio, live->i0, live->i1, live->t0,
+      live->vel, &live->scratchpad
+   );
+}
+
+/**
+ *    Adds an event to the list of live_notes_check().
+ */
+
+static int
+live_event
+(
+   waon_live_event_t * events, int n, int event, int note, int vel
+)
+{
+   events[n].event = (char) event;
+   events[n].note = MIDI_NOTE(note);
+   events[n].vel = (char) vel;
+   return n + 1;
+}
+
+/**
+ *    Decides the note-on and note-off events of the last frame from its
+ *    velocities, by the rules of WAON_notes_check():  a note starts above
+ *    on_threshold, stops at or below off_threshold, and starts again if it
+ *    rises by peak_threshold over the velocity of its note-on.  The
+ *    velocity of a sounding note is raised to its peak, but the note-on is
+ *    already out, so the raise affects only the restarts.
+ *
+ * \param live
+ *    Provides the analysis, after live_step().
+ *
+ * \param on_threshold
+ *    The velocity a note must exceed to start.  waonc uses 8.
+ *
+ * \param off_threshold
+ *    The velocity at or below which a sounding note stops.  waonc uses 0.
+ *
+ * \param peak_threshold
+ *    The rise that restarts a sounding note (--peak).
+ *
+ * \param events
+ *    Receives the events, [LIVE_EVENTS_MAX].
+ *
+ * \return
+ *    Returns the number of events.
+ */
+
+int
+live_notes_check
+(
+   waon_live_t * live,
+   int on_threshold,
+   int off_threshold,
+   int peak_threshold,
+   waon_live_event_t * events
+)
+{
+   int n = 0;
+   int i;
+   for (i = 0; i < MIDI_NOTE_COUNT; ++i)
+   {
+      int vel = live->vel[i];
+      if (live->on_vel[i] < 0)            /* off at last step                 */
+      {
+         if (vel > on_threshold)
+         {
+            n = live_event(events, n, MIDI_EVENT_NOTE_ON, i, vel);
+            live->on_vel[i] = vel;
+         }
+      }
+      else if (vel <= off_threshold)
+      {
+         n = live_event(events, n, MIDI_EVENT_NOTE_OFF, i, MIDI_VELOCITY_HALF);
+         live->on_vel[i] = WAON_UNINITIALIZED;
+      }
+      else if (vel >= live->on_vel[i] + peak_threshold)
+      {
+         n = live_event(events, n, MIDI_EVENT_NOTE_OFF, i, MIDI_VELOCITY_HALF);
+         n = live_event(events, n, MIDI_EVENT_NOTE_ON, i, vel);
+         live->on_vel[i] = vel;
+      }
+      else if (vel > live->on_vel[i])
+         live->on_vel[i] = vel;
+   }
+   return n;
+}
+
+/**
+ *    Stops all of the sounding notes, as at the end of the input.
+ *
+ * \param live
+ *    Provides the analysis.
+ *
+ * \param events
+ *    Receives the note-off events, [MIDI_NOTE_COUNT].
+ *
+ * \return
+ *    Returns the number of events.
+ */
+
+int
+live_notes_off (waon_live_t * live, waon_live_event_t * events)
+{
+   int n = 0;
+   int i;
+   for (i = 0; i < MIDI_NOTE_COUNT; ++i)
+   {
+      if (live->on_vel[i] >= 0)
+      {
+         n = live_event(events, n, MIDI_EVENT_NOTE_OFF, i, MIDI_VELOCITY_HALF);
+         live->on_vel[i] = WAON_UNINITIALIZED;
+      }
+   }
+   return n;
+}
+
+/**
+ *    Frees the live analysis.
+ */
+
+void
+live_free (waon_live_t * live)
+{
+   if (not_nullptr(live))
+   {
+      fft_batch_free(live->batch);
+      free(live->frame);
+      free(live->phs);
+      free(live->ph0);
+      free(live->fp);
+      free(live->power);
+      free(live->amp2);
+      free(live->dphi);
+      free(live);
+   }
+}
+
+/*
+ * live.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -45,16 +45,12 @@
 #include "notes.h"                     /* waon_notes_t                  */
 
 /**
- *    Currently a global variable using in processing.c and midi.c.
- *    The first value, mp_adj_pitch, is also present in waon_parameters_t
- *    (declared in the parameters.h module).
+ *    The frequencies of the MIDI notes, used in processing.c and live.c.
+ *    It is never written, so the threads of waoncd share it.
  */
 
 midi_pitch_t g_midi_pitch_info =
 {
-   0.0,
-   0.0,
-   0,
    {
       /* C-1 - */
 
@@ -218,8 +214,7 @@ logf_to_midi (double logf)
 
 /**
  *    Gets the standard MIDI note from a frequency value, taking into
- *    account the "global" adj_pitch value and by collecting information
- *    for the "global" pitch_shift value.
+ *    account the pitch adjustment.
  *
  * \note
  *    MIDI note #69 is A4 (440Hz); the constants appear un-macro'ed in the
@@ -228,24 +223,23 @@ logf_to_midi (double logf)
  * \param freq
  *    Provides the pitch frequency value to be converted.
  *
+ * \param adj_pitch
+ *    Provides the pitch adjustment (-a), in semitones.
+ *
  * \return
  *    Returns the standard MIDI note value for the given frequency.  If
  *    the frequency is illegal, -1 (WAON_NOTE_ILLEGAL) is returned.
  */
 
 int
-get_note (double freq)
+get_note (double freq, double adj_pitch)
 {
    static const double factor = 1.731234049066756242e+01;      /* 12/log(2)   */
    int inote = WAON_NOTE_ILLEGAL;
    if (freq > 0.0)
    {
-      double dnote =
-         69.5 + factor * log(freq/440.0) + g_midi_pitch_info.mp_adj_pitch;
-
+      double dnote = 69.5 + factor * log(freq/440.0) + adj_pitch;
       inote = (int) dnote;
-      g_midi_pitch_info.mp_pitch_shift += (dnote - (double) inote);
-      g_midi_pitch_info.mp_n_pitch++;           /* calculate the pitch_shift  */
       if (inote < MIDI_NOTE_MIN || inote > MIDI_NOTE_MAX)
       {
          /*
@@ -576,7 +570,7 @@ wbshort (int fd, unsigned short us)
 }
 
 /**
- *    Performs MIDI output for WAON_notes().
+ *    Writes the notes as a standard MIDI file (format 0) to an open file.
  *
  * \param notes
  *    Provides a structure holding the notes and describing them.
@@ -585,17 +579,25 @@ wbshort (int fd, unsigned short us)
  * \param div
  *    Provides the "division" (TBD).
  *
- * \param filename
- *    Provides the filename of the output MIDI file.  Currently this
- *    pointer is not checked.  If the filename is "-", then the output
- *    file is stdout.
+ * \param fd
+ *    Provides the file, open for writing at its start.  It is left open.
+ *
+ * \param seekable
+ *    True if the track length can be rewritten once it is known.
+ *
+ * \return
+ *    Returns the number of bytes written, or -1 on an error.
  */
 
-void
-WAON_notes_output_midi (waon_notes_t * notes, double div, char * filename)
+int
+WAON_notes_write_midi
+(
+   waon_notes_t * notes,
+   double div,
+   int fd,
+   wbool_t seekable
+)
 {
-   int fd;                             /* file descriptor of output midi file  */
-   wbool_t flag_stdout;
    int p_midi;
    int n_midi;
    int h_midi;                         /* pointer of track header  */
@@ -604,40 +606,12 @@ WAON_notes_output_midi (waon_notes_t * notes, double div, char * filename)
    int last_step = 0;
    int i;
 
-   /**
-    * \todo
-    *    Need a verbosity flag for the WAON_notes_output_midi() function.
-    */
-
-   fprintf
-   (
-      stderr,
-      "   WAON_notes:         n = %d\n"
-      "   Output filename:   '%s'\n"
-      ,
-      notes->n, filename
-   );
-   if (strncmp(filename, "-", strlen(filename)) == 0)
-   {
-      fd = fcntl(STDOUT_FILENO, F_DUPFD, 0);
-      flag_stdout = wtrue;
-   }
-   else
-   {
-      fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-      flag_stdout = wfalse;
-   }
-   if (fd < 0)
-   {
-      fprintf(stderr, "? cannot open %s\n", filename);
-      exit(1);
-   }
    p_midi = 0;
    n_midi = smf_header_fmt(fd, 0, 1, div);   /* MIDI header                   */
    if (n_midi != 14)
    {
       fprintf(stderr, "? error during writing mid! %d (header)\n", p_midi);
-      return;
+      return -1;
    }
    p_midi += n_midi;
    h_midi = p_midi;                    /* pointer of track-head               */
@@ -646,7 +620,7 @@ WAON_notes_output_midi (waon_notes_t * notes, double div, char * filename)
    if (n_midi != 8)
    {
       fprintf(stderr, "? error during writing mid! %d (track header)\n", p_midi);
-      return;
+      return -1;
    }
    p_midi += n_midi;
    dh_midi = p_midi;                   /* head of data                        */
@@ -654,14 +628,14 @@ WAON_notes_output_midi (waon_notes_t * notes, double div, char * filename)
    if (n_midi != 7)
    {
       fprintf(stderr, "? error during writing mid! %d (tempo)\n", p_midi);
-      return;
+      return -1;
    }
    p_midi += n_midi;
    n_midi = smf_prog_change(fd, 0, 0); /* ch.0 prog. 0                        */
    if (n_midi != 3)
    {
       fprintf(stderr, "? error during writing mid! %d (prog change)\n", p_midi);
-      return;
+      return -1;
    }
    p_midi += n_midi;
    for (i = 0; i < notes->n; i ++)
@@ -710,10 +684,10 @@ WAON_notes_output_midi (waon_notes_t * notes, double div, char * filename)
    if (n_midi != 4)
    {
       fprintf(stderr, "? error during writing mid! %d (track end)\n", p_midi);
-      return;
+      return -1;
    }
    p_midi += n_midi;
-   if (flag_stdout)
+   if (! seekable)
    {
       if ((7 + 4 * nmidi) != (p_midi - dh_midi))
          fprintf(stderr, "WaoN warning : data size seems to be different.\n");
@@ -723,15 +697,69 @@ WAON_notes_output_midi (waon_notes_t * notes, double div, char * filename)
       if (lseek(fd, h_midi, SEEK_SET) < 0)   /* recalculate number in track   */
       {
          fprintf(stderr, "? error during lseek %d (re-calc)\n", h_midi);
-         return;
+         return -1;
       }
       n_midi = smf_track_head(fd, (p_midi - dh_midi));
       if (n_midi != 8)
       {
          fprintf(stderr, "? error during write %d (re-calc)\n", p_midi);
-         return;
+         return -1;
       }
    }
+   return p_midi;
+}
+
+/**
+ *    Performs MIDI output for WAON_notes().
+ *
+ * \param notes
+ *    Provides a structure holding the notes and describing them.
+ *    Currently this pointer is not checked.
+ *
+ * \param div
+ *    Provides the "division" (TBD).
+ *
+ * \param filename
+ *    Provides the filename of the output MIDI file.  Currently this
+ *    pointer is not checked.  If the filename is "-", then the output
+ *    file is stdout.
+ */
+
+void
+WAON_notes_output_midi (waon_notes_t * notes, double div, char * filename)
+{
+   int fd;                             /* file descriptor of output midi file  */
+   wbool_t flag_stdout;
+
+   /**
+    * \todo
+    *    Need a verbosity flag for the WAON_notes_output_midi() function.
+    */
+
+   fprintf
+   (
+      stderr,
+      "   WAON_notes:         n = %d\n"
+      "   Output filename:   '%s'\n"
+      ,
+      notes->n, filename
+   );
+   if (strncmp(filename, "-", strlen(filename)) == 0)
+   {
+      fd = fcntl(STDOUT_FILENO, F_DUPFD, 0);
+      flag_stdout = wtrue;
+   }
+   else
+   {
+      fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+      flag_stdout = wfalse;
+   }
+   if (fd < 0)
+   {
+      fprintf(stderr, "? cannot open %s\n", filename);
+      exit(1);
+   }
+   (void) WAON_notes_write_midi(notes, div, fd, ! flag_stdout);
    close(fd);
 }
 
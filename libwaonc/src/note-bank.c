@@ -0,0 +1,353 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : note-bank analysis
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          note-bank.c
+ *
+ *    This module provides a bank of Goertzel filters tuned to the MIDI
+ *    notes, for the stage 1 and 2 processing of narrow note ranges.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The Goertzel recurrence evaluates one DFT coefficient of an arbitrary
+ *    (not necessarily integer-bin) frequency in O(len) operations, so the
+ *    cost of a frame is O(len * notes * harmonics), independent of the FFT
+ *    size of the rest of the pipeline.  The frame is windowed exactly as
+ *    it would be for the FFT, and the power is scaled by the same init_den()
+ *    weight that HC_to_amp2() uses, so that the --cutoff and --relative
+ *    options keep their meaning in this mode.
+ */
+
+#include <math.h>                      /* cos(), log10(), pow()               */
+#include <stdio.h>                     /* fprintf()                           */
+#include <stdlib.h>                    /* malloc(), free()                    */
+
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "midi.h"                      /* midi_to_freq()                      */
+#include "note-bank.h"                 /* waon_note_bank_t                    */
+
+/**
+ *    Creates a bank of Goertzel filters for the MIDI notes in the range
+ *    [note_low, note_top].
+ *
+ *    The frequency of each note takes into account the pitch adjustment,
+ *    in the same way that get_note() does, so that the bank and the FFT
+ *    path pick the same notes for the same setting.
+ *
+ * \param note_low
+ *    Provides the lowest MIDI note to detect.
+ *
+ * \param note_top
+ *    Provides the highest MIDI note to detect.
+ *
+ * \param harmonics
+ *    Provides the number of partials folded into the power of each note,
+ *    including the fundamental.  Values less than 1 are treated as 1, and
+ *    the value is clipped to NOTE_BANK_HARMONICS_MAX.  Partial h has the
+ *    weight 1/h.  Partials above the Nyquist frequency are ignored.
+ *
+ * \param len
+ *    Provides the number of samples in one analysis frame (fft_len).
+ *
+ * \param samplerate
+ *    Provides the sampling rate of the input.
+ *
+ * \param flag_window
+ *    Provides the type of window to apply to each frame.
+ *
+ * \param adj_pitch
+ *    Provides the pitch adjustment (--adjust), in semitones.
+ *
+ * \return
+ *    Returns a pointer to the new bank.  Free it with note_bank_free().
+ *    The function exits the application if memory cannot be allocated,
+ *    like the rest of libwaonc.
+ */
+
+waon_note_bank_t *
+note_bank_create
+(
+   int note_low,
+   int note_top,
+   int harmonics,
+   long len,
+   double samplerate,
+   filter_window_t flag_window,
+   double adj_pitch
+)
+{
+   int i, h;
+   double shift = pow(2.0, -adj_pitch / 12.0);
+   waon_note_bank_t * bank =
+      (waon_note_bank_t *) malloc(sizeof(waon_note_bank_t));
+
+   CHECK_MALLOC(bank, "note_bank_create");
+   if (harmonics < 1)
+      harmonics = 1;
+   else if (harmonics > NOTE_BANK_HARMONICS_MAX)
+      harmonics = NOTE_BANK_HARMONICS_MAX;
+
+   bank->note_low = note_low;
+   bank->note_top = note_top;
+   bank->count = note_top - note_low + 1;
+   bank->harmonics = harmonics;
+   bank->len = len;
+   bank->den = init_den(len, flag_window);
+   bank->window = (double *) malloc(sizeof(double) * len);
+   bank->coeff = (double *) malloc(sizeof(double) * bank->count * harmonics);
+   bank->weight = (double *) malloc(sizeof(double) * bank->count * harmonics);
+   bank->power = (double *) malloc(sizeof(double) * bank->count);
+   CHECK_MALLOC(bank->window, "note_bank_create");
+   CHECK_MALLOC(bank->coeff, "note_bank_create");
+   CHECK_MALLOC(bank->weight, "note_bank_create");
+   CHECK_MALLOC(bank->power, "note_bank_create");
+
+   /*
+    * Windowing a frame of ones yields the window function itself.
+    */
+
+   for (i = 0; i < len; ++i)
+      bank->window[i] = 1.0;
+
+   windowing(len, bank->window, flag_window, 1.0, bank->window);
+   for (i = 0; i < bank->count; ++i)
+   {
+      double f0 = midi_to_freq(note_low + i) * shift;
+      for (h = 0; h < harmonics; ++h)
+      {
+         double f = f0 * (double) (h + 1);
+         int k = i * harmonics + h;
+         if (f < 0.5 * samplerate)
+         {
+            bank->coeff[k] = 2.0 * cos(2.0 * M_PI * f / samplerate);
+            bank->weight[k] = 1.0 / (double) (h + 1);
+         }
+         else
+         {
+            bank->coeff[k] = 0.0;
+            bank->weight[k] = 0.0;     /* above Nyquist, ignored              */
+         }
+      }
+      bank->power[i] = 0.0;
+   }
+   return bank;
+}
+
+/**
+ *    Frees a bank created by note_bank_create().
+ *
+ * \param bank
+ *    Provides the bank to free.  A null pointer is ignored.
+ */
+
+void
+note_bank_free (waon_note_bank_t * bank)
+{
+   if (not_nullptr(bank))
+   {
+      if (not_nullptr(bank->window))
+         free(bank->window);
+
+      if (not_nullptr(bank->coeff))
+         free(bank->coeff);
+
+      if (not_nullptr(bank->weight))
+         free(bank->weight);
+
+      if (not_nullptr(bank->power))
+         free(bank->power);
+
+      free(bank);
+   }
+}
+
+/**
+ *    Calculates the power of each note of the bank for one frame.
+ *
+ *    For each filter, the Goertzel recurrence
+ *
+\verbatim
+      s[n] = w[n] x[n] + 2 cos(omega) s[n-1] - s[n-2]
+\endverbatim
+ *
+ *    is run over the windowed frame, and the power of the coefficient is
+ *    s1^2 + s2^2 - 2 cos(omega) s1 s2, scaled by bank->den.
+ *
+ * \param bank
+ *    Provides the bank.  Its power[] member receives the result.
+ *
+ * \param x[len]
+ *    Provides the (unwindowed) frame of samples.
+ */
+
+void
+note_bank_power
+(
+   waon_note_bank_t * bank,
+   const double * x
+)
+{
+   int i, h;
+   long n;
+   for (i = 0; i < bank->count; ++i)
+   {
+      double p = 0.0;
+      for (h = 0; h < bank->harmonics; ++h)
+      {
+         int k = i * bank->harmonics + h;
+         double c = bank->coeff[k];
+         double s1 = 0.0;
+         double s2 = 0.0;
+         if (bank->weight[k] == 0.0)
+            continue;
+
+         for (n = 0; n < bank->len; ++n)
+         {
+            double s0 = bank->window[n] * x[n] + c * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+         }
+         p += bank->weight[k] * (s1 * s1 + s2 * s2 - c * s1 * s2);
+      }
+      bank->power[i] = p / bank->den;
+   }
+}
+
+/**
+ *    Picks the notes from the power[] calculated by note_bank_power().
+ *
+ *    This function is the note-bank counterpart of note_intensity().  A
+ *    note is picked if its power is over the cutoff and is a local
+ *    maximum among its neighbors in the bank (the filters of adjacent
+ *    notes overlap, especially at the low end).  The velocity uses the
+ *    same scaling as note_intensity().  The power[] is not altered, so
+ *    that several cutoffs can be applied to the same frame.
+ *
+ * \param bank
+ *    Provides the bank, with the power[] of the current frame.
+ *
+ * \param cut_ratio
+ *    Provides the log10 of cutoff ratio to use to scale the velocity.
+ *
+ * \param rel_cut_ratio
+ *    Provides the log10 of cutoff ratio relative to the average power of
+ *    the bank.
+ *
+ * \param abs_flg
+ *    Provides the flag for the absolute versus relative cutoff.
+ *
+ * \param [out] intens
+ *    Provides the intensity [0,128) for each MIDI note [0, 128).
+ */
+
+void
+note_bank_pick
+(
+   const waon_note_bank_t * bank,
+   double cut_ratio,
+   double rel_cut_ratio,
+   wbool_t abs_flg,
+   char * intens
+)
+{
+   int i;
+   double threshold;
+   for (i = 0; i < MIDI_NOTE_COUNT; ++i)
+      intens[i] = 0;
+
+   if (abs_flg)
+      threshold = pow(10.0, cut_ratio);
+   else
+   {
+      double av = 0.0;
+      for (i = 0; i < bank->count; ++i)
+         av += bank->power[i];
+
+      av /= (double) bank->count;
+      threshold = av * pow(10.0, rel_cut_ratio);
+   }
+   for (i = 0; i < bank->count; ++i)
+   {
+      double p = bank->power[i];
+      double v;
+      if (p <= threshold)
+         continue;
+
+      if (i > 0 && bank->power[i - 1] > p)
+         continue;                     /* the lower neighbor is the peak      */
+
+      if (i < bank->count - 1 && bank->power[i + 1] > p)
+         continue;                     /* the upper neighbor is the peak      */
+
+      v = 127.0 / (double) (-cut_ratio) * (log10(p) - (double) cut_ratio);
+      if (v >= 128.0)
+         intens[bank->note_low + i] = 127;
+      else if (v > 0)
+         intens[bank->note_low + i] = (int) v;
+   }
+}
+
+/**
+ *    Gets the intensity of the notes of the bank for one frame, by
+ *    calling note_bank_power() and then note_bank_pick().
+ *
+ * \param bank
+ *    Provides the bank.
+ *
+ * \param x[len]
+ *    Provides the (unwindowed) frame of samples.
+ *
+ * \param cut_ratio
+ *    Provides the log10 of cutoff ratio to use to scale the velocity.
+ *
+ * \param rel_cut_ratio
+ *    Provides the log10 of cutoff ratio relative to the average power of
+ *    the bank.
+ *
+ * \param abs_flg
+ *    Provides the flag for the absolute versus relative cutoff.
+ *
+ * \param [out] intens
+ *    Provides the intensity [0,128) for each MIDI note [0, 128).
+ */
+
+void
+note_bank_intensity
+(
+   waon_note_bank_t * bank,
+   const double * x,
+   double cut_ratio,
+   double rel_cut_ratio,
+   wbool_t abs_flg,
+   char * intens
+)
+{
+   note_bank_power(bank, x);
+   note_bank_pick(bank, cut_ratio, rel_cut_ratio, abs_flg, intens);
+}
+
+/*
+ * note-bank.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
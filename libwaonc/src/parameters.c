@@ -27,7 +27,7 @@
  * \library       waonc application
  * \author        Chris Ahlstrom
  * \date          2013-11-23
- * \updates       2013-11-29
+ * \updates       2026-10-18
  * \version       $Revision$
  * \license       GNU GPL
  */
@@ -40,6 +40,7 @@
 #include "fft.h"                       /* filter-window enumeration           */
 #include "memory-check.h"              /* CHECK_MALLOC() macro                */
 #include "midi.h"                      /* MIDI-related macros                 */
+#include "note-bank.h"                 /* NOTE_BANK_HARMONICS_MAX             */
 #include "parameters.h"                /* declares functions for this module  */
 #include "VERSION.h"
 
@@ -122,6 +123,13 @@ static const char * const s_waon_helptext_2 =
 "  -i --input        Input WAV file ('-' for default) [Default: stdin].\n"
 "  -o --output       Output MID file ('-' for default) [Default: 'output.mid'].\n"
 "  -p --patch        Patch file [Default: no patch].\n"
+"  --sweep           File of parameter sets, one per line, using -c, -r, -k,\n"
+"                    --psub-n, --psub-f, --oct and -o.  The spectrum is made\n"
+"                    once, and one MIDI file is written for each set.\n"
+"  --spec-cache      Spectral cache file (.waonspec).  It is read if it holds\n"
+"                    this analysis (-n, -s, -w, phase), else it is written.\n"
+"                    gwaonc reads '<input>.waonspec' by itself.  Not for\n"
+"                    standard input.\n"
 "\n"
 ;
 
@@ -143,6 +151,11 @@ static const char * const s_waon_helptext_3 =
 "     4 'Hamming' window\n"
 "     5 'Blackman' window\n"
 "     6 'Steeper' 30-dB/octave rolloff window\n"
+"  --r2c             Use the interleaved-complex (r2c) FFT layout instead of\n"
+"                    the half-complex (R2HC) one.  Same results, usually\n"
+"                    faster.\n"
+"  --batch           Number of frames transformed together by one FFTW plan.\n"
+"                    [Default: 16]\n"
 "\n"
 ;
 
@@ -158,6 +171,13 @@ static const char * const s_waon_helptext_4 =
 "PHASE-VOCODER OPTIONS:\n"
 "  --no-phase        Don't use phase difference to improve frequency estimates.\n"
 "\n"
+"NOTE-BANK OPTIONS:\n"
+"  --note-bank       Analyse with one Goertzel filter per note in the --bottom\n"
+"                    to --top range instead of the FFT.  Cheaper for narrow\n"
+"                    ranges.  The phase and drum/octave options don't apply.\n"
+"  --harmonics       Number of partials per note in the bank, counting the\n"
+"                    fundamental, range [1,8]. [Default: 1]\n"
+"\n"
 ;
 
 /**
@@ -172,6 +192,8 @@ static const char * const s_waon_helptext_5 =
 "                    [Default: absolute cutoff with the value in -c option].\n"
 "  -k --peak         Peak threshold for note-on, range [0,127]. [Default: 128\n"
 "                    = no peak-search = search only first on-event].\n"
+"  --no-gate         Analyse every frame.  By default, frames too quiet to\n"
+"                    reach the -c cut-off are skipped without an FFT.\n"
 ;
 
 static const char * const s_waon_helptext_6 =
@@ -247,9 +269,14 @@ parameters_initialize (waon_parameters_t * parameters)
       parameters->file_midi = nullptr;
       parameters->file_wav = nullptr;
       parameters->file_patch = nullptr;
+      parameters->file_sweep = nullptr;
+      parameters->file_spec_cache = nullptr;
       parameters->cut_ratio = DEFAULT_CUTOFF_RATIO;
       parameters->rel_cut_ratio = DEFAULT_RELATIVE_CUTOFF_RATIO;
       parameters->fft_len = DEFAULT_FFT_LENGTH;
+      parameters->fft_r2c = wfalse;
+      parameters->fft_batch = DEFAULT_FFT_BATCH;
+      parameters->energy_gate = DEFAULT_USE_ENERGY_GATE;
       parameters->flag_window = DEFAULT_FFT_WINDOW_TYPE;   /* Hanning window */
       parameters->notelow = DEFAULT_NOTE_BOTTOM;
       parameters->notetop = DEFAULT_NOTE_TOP;
@@ -261,6 +288,8 @@ parameters_initialize (waon_parameters_t * parameters)
       parameters->oct_f = 0.0;
       parameters->adj_pitch = 0.0;
       parameters->abs_flg = DEFAULT_USE_ABSOLUTE_CUTOFF;
+      parameters->note_bank = wfalse;
+      parameters->bank_harmonics = 1;
       parameters->dump_bins = wfalse;
       parameters->dump_events = wfalse;
       parameters->show_help = wfalse;
@@ -295,6 +324,16 @@ parameters_free (waon_parameters_t * parameters)
          free(parameters->file_patch);
          parameters->file_patch = nullptr;
       }
+      if (not_nullptr(parameters->file_sweep))
+      {
+         free(parameters->file_sweep);
+         parameters->file_sweep = nullptr;
+      }
+      if (not_nullptr(parameters->file_spec_cache))
+      {
+         free(parameters->file_spec_cache);
+         parameters->file_spec_cache = nullptr;
+      }
    }
 }
 
@@ -481,7 +520,12 @@ parameters_parse
          {
             if (i+1 < argc)
             {
-               parameters->file_patch = argv[++i];
+               parameters->file_patch = (char *) malloc
+               (
+                  sizeof(char) * (strlen(argv[++i]) + 1)
+               );
+               CHECK_MALLOC(parameters->file_patch, "main");
+               strcpy(parameters->file_patch, argv[i]);
             }
             else
             {
@@ -592,6 +636,96 @@ parameters_parse
             parameters->show_version = wtrue;
             result = wfalse;
          }
+         else if (strcmp(argv[i], "--r2c") == 0)
+         {
+            parameters->fft_r2c = wtrue;
+         }
+         else if (strcmp(argv[i], "--sweep") == 0)
+         {
+            if (i+1 < argc)
+            {
+               parameters->file_sweep = (char *) malloc
+               (
+                  sizeof(char) * (strlen(argv[++i]) + 1)
+               );
+               CHECK_MALLOC(parameters->file_sweep, "main");
+               strcpy(parameters->file_sweep, argv[i]);
+            }
+            else
+            {
+               parameters->show_help = wtrue;
+               result = wfalse;
+               break;
+            }
+         }
+         else if (strcmp(argv[i], "--spec-cache") == 0)
+         {
+            if (i+1 < argc)
+            {
+               parameters->file_spec_cache = (char *) malloc
+               (
+                  sizeof(char) * (strlen(argv[++i]) + 1)
+               );
+               CHECK_MALLOC(parameters->file_spec_cache, "main");
+               strcpy(parameters->file_spec_cache, argv[i]);
+            }
+            else
+            {
+               parameters->show_help = wtrue;
+               result = wfalse;
+               break;
+            }
+         }
+         else if (strcmp(argv[i], "--no-gate") == 0)
+         {
+            parameters->energy_gate = wfalse;
+         }
+         else if (strcmp(argv[i], "--batch") == 0)
+         {
+            if (i+1 < argc)
+            {
+               parameters->fft_batch = atoi(argv[++i]);
+            }
+            else
+            {
+               parameters->show_help = wtrue;
+               result = wfalse;
+               break;
+            }
+         }
+         else if (strcmp(argv[i], "--note-bank") == 0)
+         {
+            parameters->note_bank = wtrue;
+         }
+         else if (strcmp(argv[i], "--harmonics") == 0)
+         {
+            if (i+1 < argc)
+            {
+               parameters->bank_harmonics = atoi(argv[++i]);
+               if
+               (
+                  parameters->bank_harmonics < 1 ||
+                  parameters->bank_harmonics > NOTE_BANK_HARMONICS_MAX
+               )
+               {
+                  parameters->bank_harmonics =
+                     parameters->bank_harmonics < 1 ?
+                        1 : NOTE_BANK_HARMONICS_MAX;
+
+                  errprintf
+                  (
+                     "? --harmonics value outside of 1 to 8 range, using %d\n",
+                     parameters->bank_harmonics
+                  );
+               }
+            }
+            else
+            {
+               parameters->show_help = wtrue;
+               result = wfalse;
+               break;
+            }
+         }
          else if (strcmp(argv[i], "--dump-bins") == 0)
          {
             parameters->dump_bins = wtrue;
@@ -616,6 +750,25 @@ parameters_parse
 
          if (parameters->psub_f == 0.0)
             parameters->psub_n = 0;
+
+         /*
+          * The cache is keyed on the modification time of the input, and
+          * standard input has none, so a cache of other audio would be
+          * taken for it.
+          */
+
+         if
+         (
+            not_nullptr(parameters->file_spec_cache) &&
+            (
+               is_nullptr(parameters->file_wav) ||
+               strcmp(parameters->file_wav, "-") == 0
+            )
+         )
+         {
+            errprint("--spec-cache needs an input file, not standard input");
+            result = wfalse;
+         }
       }
    }
    return result;
@@ -0,0 +1,603 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : waveform peak pyramid
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          peaks.c
+ *
+ *    This module provides the minimum, maximum, and RMS of the samples of
+ *    any range of a sound file, from a pyramid of the values of blocks.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The mean squares are combined weighted by the frames of each entry,
+ *    as the last entry of a level may cover fewer frames than the others.
+ */
+
+#include <fcntl.h>                     /* open()                              */
+#include <math.h>                      /* sqrt(), HUGE_VAL                    */
+#include <stdio.h>                     /* FILE, fopen(), fwrite()             */
+#include <stdlib.h>                    /* malloc(), calloc(), free()          */
+#include <string.h>                    /* memcpy(), memset(), memcmp()        */
+#include <sys/mman.h>                  /* mmap(), munmap()                    */
+#include <sys/stat.h>                  /* fstat(), stat()                     */
+#include <unistd.h>                    /* close(), read()                     */
+
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "peaks.h"                     /* waon_peaks_t                        */
+
+/**
+ *    Holds the values of a range while peaks_range() adds them up.
+ */
+
+typedef struct
+{
+   double min[2];
+   double max[2];
+   double sum[2];          /*<< The sum of the squares.                       */
+
+} peaks_acc_t;
+
+/**
+ *    Gets the channels of an entry, 1 or 2.
+ */
+
+static int
+peaks_channels (const waon_peaks_t * peaks)
+{
+   return peaks->header.channels > 1 ? 2 : 1;
+}
+
+/**
+ *    Fills in the key (header) that describes a source.
+ */
+
+static void
+peaks_key
+(
+   waon_peaks_header_t * key,
+   const snd_cache_t * snd,
+   const char * source
+)
+{
+   struct stat st;
+   memset(key, 0, sizeof(*key));
+   memcpy(key->magic, PEAKS_MAGIC, sizeof(key->magic));
+   key->version = PEAKS_VERSION;
+   key->header_size = (int32_t) sizeof(waon_peaks_header_t);
+   key->base = PEAKS_BASE;
+   key->samplerate = (int32_t) snd->sfinfo.samplerate;
+   key->channels = (int32_t) snd->sfinfo.channels;
+   key->source_frames = (int64_t) snd->sfinfo.frames;
+   if (not_nullptr(source) && stat(source, &st) == 0)
+      key->source_mtime = (int64_t) st.st_mtime;
+}
+
+/**
+ *    Sets the levels and their counts, which follow from the length of
+ *    the source.
+ *
+ * \return
+ *    Returns the entries of all of the levels.
+ */
+
+static long
+peaks_levels (waon_peaks_t * peaks)
+{
+   long n = (long) ((peaks->header.source_frames + PEAKS_BASE - 1) /
+      PEAKS_BASE);
+
+   long total = 0;
+   peaks->levels = 0;
+   while (n > 0 && peaks->levels < PEAKS_LEVELS_MAX)
+   {
+      peaks->count[peaks->levels++] = n;
+      total += n;
+      if (n == 1)
+         break;
+
+      n = (n + 1) / 2;
+   }
+   return total;
+}
+
+/**
+ *    Points the levels at their entries, which follow one another.
+ */
+
+static void
+peaks_point (waon_peaks_t * peaks, const float * data)
+{
+   long stride = (long) PEAKS_VALUES * peaks_channels(peaks);
+   int l;
+   for (l = 0; l < peaks->levels; ++l)
+   {
+      peaks->level[l] = data;
+      data += peaks->count[l] * stride;
+   }
+}
+
+/**
+ *    Gets the frames covered by entry \a k of level \a l.
+ */
+
+static long
+peaks_frames (const waon_peaks_t * peaks, int l, long k)
+{
+   long size = (long) PEAKS_BASE << l;
+   long end = (k + 1) * size;
+   if (end > (long) peaks->header.source_frames)
+      end = (long) peaks->header.source_frames;
+
+   return end - k * size;
+}
+
+/**
+ *    Allocates a pyramid with its buffers.  The caller points its levels.
+ */
+
+static waon_peaks_t *
+peaks_alloc (snd_cache_t * snd, const waon_peaks_header_t * key)
+{
+   waon_peaks_t * peaks = (waon_peaks_t *) calloc(1, sizeof(waon_peaks_t));
+   CHECK_MALLOC(peaks, "peaks_alloc");
+   peaks->header = *key;
+   peaks->snd = snd;
+   peaks->left = (double *) malloc(sizeof(double) * PEAKS_BASE);
+   peaks->right = (double *) malloc(sizeof(double) * PEAKS_BASE);
+   CHECK_MALLOC(peaks->left, "peaks_alloc");
+   CHECK_MALLOC(peaks->right, "peaks_alloc");
+   return peaks;
+}
+
+/**
+ *    Adds the samples of the frames [from, to) to the values of a range,
+ *    reading them from the snd_cache_t.
+ */
+
+static void
+peaks_add_samples
+(
+   waon_peaks_t * peaks,
+   peaks_acc_t * acc,
+   long from,
+   long to
+)
+{
+   int ch = peaks_channels(peaks);
+   while (from < to)
+   {
+      long n = to - from;
+      long i;
+      int c;
+      if (n > PEAKS_BASE)
+         n = PEAKS_BASE;
+
+      snd_cache_read_at(peaks->snd, from, peaks->left, peaks->right, n);
+      for (c = 0; c < ch; ++c)
+      {
+         const double * x = c == 0 ? peaks->left : peaks->right;
+         for (i = 0; i < n; ++i)
+         {
+            if (x[i] < acc->min[c])
+               acc->min[c] = x[i];
+
+            if (x[i] > acc->max[c])
+               acc->max[c] = x[i];
+
+            acc->sum[c] += x[i] * x[i];
+         }
+      }
+      from += n;
+   }
+}
+
+/**
+ *    Adds entry \a k of level \a l to the values of a range.
+ */
+
+static void
+peaks_add_entry
+(
+   const waon_peaks_t * peaks,
+   peaks_acc_t * acc,
+   int l,
+   long k
+)
+{
+   int ch = peaks_channels(peaks);
+   const float * e = peaks->level[l] + k * PEAKS_VALUES * ch;
+   double n = (double) peaks_frames(peaks, l, k);
+   int c;
+   for (c = 0; c < ch; ++c, e += PEAKS_VALUES)
+   {
+      if (e[0] < acc->min[c])
+         acc->min[c] = e[0];
+
+      if (e[1] > acc->max[c])
+         acc->max[c] = e[1];
+
+      acc->sum[c] += e[2] * n;
+   }
+}
+
+/**
+ *    Builds the pyramid of a sound file, reading every frame once.
+ *
+ * \param snd
+ *    Provides the decoded samples.  They must stay open until the pyramid
+ *    is freed.
+ *
+ * \param source
+ *    Provides the name of the sound file, used for its modification time
+ *    in the header.  Can be null.
+ *
+ * \return
+ *    Returns the pyramid.  Free it with peaks_free().
+ */
+
+waon_peaks_t *
+peaks_build
+(
+   snd_cache_t * snd,
+   const char * source
+)
+{
+   waon_peaks_header_t key;
+   waon_peaks_t * peaks;
+   float * data;
+   long total, stride, k;
+   int ch, l;
+   peaks_key(&key, snd, source);
+   peaks = peaks_alloc(snd, &key);
+   total = peaks_levels(peaks);
+   ch = peaks_channels(peaks);
+   stride = (long) PEAKS_VALUES * ch;
+   peaks->data = (float *) malloc
+   (
+      sizeof(float) * (total > 0 ? total : 1) * stride
+   );
+   CHECK_MALLOC(peaks->data, "peaks_build");
+   peaks->header.entry_count = (int64_t) total;
+   peaks_point(peaks, peaks->data);
+   if (peaks->levels == 0)
+      return peaks;
+
+   data = peaks->data;
+   for (k = 0; k < peaks->count[0]; ++k, data += stride)
+   {
+      peaks_acc_t acc;
+      int c;
+      for (c = 0; c < ch; ++c)
+      {
+         acc.min[c] = HUGE_VAL;
+         acc.max[c] = -HUGE_VAL;
+         acc.sum[c] = 0.0;
+      }
+      peaks_add_samples
+      (
+         peaks, &acc, k * PEAKS_BASE, k * PEAKS_BASE + peaks_frames(peaks, 0, k)
+      );
+      for (c = 0; c < ch; ++c)
+      {
+         data[c * PEAKS_VALUES] = (float) acc.min[c];
+         data[c * PEAKS_VALUES + 1] = (float) acc.max[c];
+         data[c * PEAKS_VALUES + 2] = (float)
+            (acc.sum[c] / (double) peaks_frames(peaks, 0, k));
+      }
+   }
+   for (l = 1; l < peaks->levels; ++l)
+   {
+      for (k = 0; k < peaks->count[l]; ++k, data += stride)
+      {
+         const float * a = peaks->level[l - 1] + 2 * k * stride;
+         const float * b = a + stride;
+         double na = (double) peaks_frames(peaks, l - 1, 2 * k);
+         double nb = 0.0;
+         int c;
+         if (2 * k + 1 < peaks->count[l - 1])
+            nb = (double) peaks_frames(peaks, l - 1, 2 * k + 1);
+         else
+            b = a;
+
+         for (c = 0; c < ch; ++c, a += PEAKS_VALUES, b += PEAKS_VALUES)
+         {
+            float * e = data + c * PEAKS_VALUES;
+            e[0] = a[0] < b[0] ? a[0] : b[0];
+            e[1] = a[1] > b[1] ? a[1] : b[1];
+            e[2] = (float) ((a[2] * na + b[2] * nb) / (na + nb));
+         }
+      }
+   }
+   return peaks;
+}
+
+/**
+ *    Opens and maps the peak file of a sound file.
+ *
+ * \param name
+ *    Provides the name of the peak file.
+ *
+ * \param snd
+ *    Provides the decoded samples.  They must stay open until the pyramid
+ *    is freed.
+ *
+ * \param source
+ *    Provides the name of the sound file, whose modification time the
+ *    file must match.  Can be null, and then the time is not checked.
+ *
+ * \return
+ *    Returns the pyramid, or null if the file does not exist, is not a
+ *    complete peak file, or does not match the sound file.  Free it with
+ *    peaks_free().
+ */
+
+waon_peaks_t *
+peaks_open
+(
+   const char * name,
+   snd_cache_t * snd,
+   const char * source
+)
+{
+   waon_peaks_t * peaks = nullptr;
+   waon_peaks_header_t key, header;
+   struct stat st;
+   int fd = open(name, O_RDONLY);
+   if (fd < 0)
+      return nullptr;
+
+   peaks_key(&key, snd, source);
+   if
+   (
+      fstat(fd, &st) == 0 &&
+      read(fd, &header, sizeof(header)) == (ssize_t) sizeof(header) &&
+      memcmp(header.magic, PEAKS_MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == PEAKS_VERSION &&
+      header.header_size == key.header_size &&
+      header.base == key.base &&
+      header.samplerate == key.samplerate &&
+      header.channels == key.channels &&
+      header.source_frames == key.source_frames &&
+      (
+         header.source_mtime == 0 || key.source_mtime == 0 ||
+         header.source_mtime == key.source_mtime
+      ) &&
+      header.entry_count > 0
+   )
+   {
+      peaks = peaks_alloc(snd, &header);
+      peaks->map_size = sizeof(header) + (size_t) header.entry_count *
+         PEAKS_VALUES * peaks_channels(peaks) * sizeof(float);
+
+      if
+      (
+         peaks_levels(peaks) != (long) header.entry_count ||
+         (size_t) st.st_size < peaks->map_size
+      )
+      {
+         peaks_free(peaks);
+         peaks = nullptr;
+      }
+      else
+      {
+         peaks->map = mmap
+         (
+            nullptr, peaks->map_size, PROT_READ, MAP_SHARED, fd, 0
+         );
+         if (peaks->map == MAP_FAILED)
+         {
+            peaks->map = nullptr;
+            peaks_free(peaks);
+            peaks = nullptr;
+         }
+         else
+         {
+            peaks_point
+            (
+               peaks,
+               (const float *) ((const char *) peaks->map + sizeof(header))
+            );
+         }
+      }
+   }
+   close(fd);
+   return peaks;
+}
+
+/**
+ *    Saves a pyramid in a peak file.
+ *
+ * \param peaks
+ *    Provides the pyramid.
+ *
+ * \param name
+ *    Provides the name of the peak file, which is overwritten.
+ *
+ * \return
+ *    Returns wtrue if the file is complete.  If not, the error is
+ *    reported, and the file is left with an entry count of 0.
+ */
+
+wbool_t
+peaks_save (const waon_peaks_t * peaks, const char * name)
+{
+   waon_peaks_header_t header = peaks->header;
+   size_t values = (size_t) header.entry_count * PEAKS_VALUES *
+      peaks_channels(peaks);
+
+   wbool_t ok = wfalse;
+   FILE * f = fopen(name, "wb");
+   if (is_nullptr(f))
+   {
+      errprintf("? cannot create peak file %s\n", name);
+      return wfalse;
+   }
+   header.entry_count = 0;
+   if
+   (
+      fwrite(&header, sizeof(header), 1, f) == 1 &&
+      (
+         values == 0 ||
+         fwrite(peaks->level[0], sizeof(float), values, f) == values
+      ) &&
+      fseek(f, 0L, SEEK_SET) == 0 &&
+      fwrite(&peaks->header, sizeof(header), 1, f) == 1
+   )
+   {
+      ok = wtrue;
+   }
+   if (fclose(f) != 0)
+      ok = wfalse;
+
+   if (! ok)
+      errprintf("? cannot write peak file %s\n", name);
+
+   return ok;
+}
+
+/**
+ *    Gets the minimum, maximum, and RMS of the samples of a range of
+ *    frames.  Not thread-safe, as it uses the buffers of the pyramid.
+ *
+ * \param peaks
+ *    Provides the pyramid.
+ *
+ * \param start
+ *    Provides the first frame.  The frames out of the file are skipped.
+ *
+ * \param len
+ *    Provides the number of frames.
+ *
+ * \param [out] min
+ *    Provides the destination of the minimum of each channel, [2].  A
+ *    mono file gets 0 for the second channel, as with sndfile_read_at().
+ *
+ * \param [out] max
+ *    Provides the destination of the maximum of each channel, [2].
+ *
+ * \param [out] rms
+ *    Provides the destination of the RMS of each channel, [2].  Can be
+ *    null.
+ *
+ * \return
+ *    Returns the number of frames within the file.  If 0, the values are
+ *    0.
+ */
+
+long
+peaks_range
+(
+   waon_peaks_t * peaks,
+   long start,
+   long len,
+   double * min,
+   double * max,
+   double * rms
+)
+{
+   long frames = (long) peaks->header.source_frames;
+   int ch = peaks_channels(peaks);
+   peaks_acc_t acc;
+   long a, b;
+   int c;
+   if (start < 0)
+   {
+      len += start;
+      start = 0;
+   }
+   if (len > frames - start)
+      len = frames - start;
+
+   for (c = 0; c < 2; ++c)
+   {
+      min[c] = max[c] = 0.0;
+      if (not_nullptr(rms))
+         rms[c] = 0.0;
+   }
+   if (len <= 0)
+      return 0;
+
+   for (c = 0; c < ch; ++c)
+   {
+      acc.min[c] = HUGE_VAL;
+      acc.max[c] = -HUGE_VAL;
+      acc.sum[c] = 0.0;
+   }
+
+   /* the entries of level 0 that the range fills, and the ends */
+
+   a = (start + PEAKS_BASE - 1) / PEAKS_BASE;
+   b = (start + len) / PEAKS_BASE;
+   if (a >= b)
+      peaks_add_samples(peaks, &acc, start, start + len);
+   else
+   {
+      int l;
+      peaks_add_samples(peaks, &acc, start, a * PEAKS_BASE);
+      peaks_add_samples(peaks, &acc, b * PEAKS_BASE, start + len);
+      for (l = 0; a < b; ++l, a /= 2, b /= 2)
+      {
+         if (a % 2 == 1)
+            peaks_add_entry(peaks, &acc, l, a++);
+
+         if (b % 2 == 1)
+            peaks_add_entry(peaks, &acc, l, --b);
+      }
+   }
+   for (c = 0; c < ch; ++c)
+   {
+      min[c] = acc.min[c];
+      max[c] = acc.max[c];
+      if (not_nullptr(rms))
+         rms[c] = sqrt(acc.sum[c] / (double) len);
+   }
+   return len;
+}
+
+/**
+ *    Frees a pyramid, unmapping its file if it was read.
+ *
+ * \param peaks
+ *    Provides the pyramid.  A null pointer is ignored.
+ */
+
+void
+peaks_free (waon_peaks_t * peaks)
+{
+   if (is_nullptr(peaks))
+      return;
+
+   if (not_nullptr(peaks->map))
+      munmap(peaks->map, peaks->map_size);
+
+   free(peaks->data);
+   free(peaks->left);
+   free(peaks->right);
+   free(peaks);
+}
+
+/*
+ * peaks.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
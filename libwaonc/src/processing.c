@@ -27,12 +27,15 @@
  * \library       waonc application
  * \author        Kengo Ichiki with modifications by Chris Ahlstrom
  * \date          2007-02-28
- * \updates       2013-12-23
+ * \updates       2026-10-18
  * \version       $Revision$
  * \license       GNU GPL
  *
  *    This module was created by moving the main functionality of the waonc
  *    main() function into this module.
+ *
+ *    The main loop is processing_run(), on the buffers of an engine that
+ *    can be reused, see processing.h.
  */
 
 #include <ctype.h>                     /* isdigit()                           */
@@ -45,190 +48,408 @@
 
 #include "memory-check.h"              /* CHECK_MALLOC() macro                */
 #include "fft.h"                       /* waon FFT utility functions          */
-#include "hc.h"                        /* HC array manipulation routines      */
+#include "fft-batch.h"                 /* waon_fft_batch_t, batched FFT       */
 #include "snd.h"                       /* wrapper for the libsndfile library  */
 #include "midi.h"                      /* smf_...(), mid2freq[], get_note()   */
 #include "analyse.h"                   /* note_intensity(), note_on_off(), ...*/
 #include "notes.h"                     /* waon_notes_t                        */
+#include "note-bank.h"                 /* waon_note_bank_t, Goertzel filters  */
 #include "parameters.h"                /* waon_parameters_t                   */
+#include "processing.h"                /* waon_processing_t                   */
+#include "spec-cache.h"                /* waon_spec_cache_t, .waonspec files  */
+#include "sweep.h"                     /* waon_sweep_t, parameter sets        */
+
+/**
+ *    Creates an engine for processing_run(), with nothing prepared.
+ *
+ * \return
+ *    Returns the engine.  Free it with processing_free().  The function
+ *    exits the application if memory cannot be allocated.
+ */
+
+waon_processing_t *
+processing_create (void)
+{
+   waon_processing_t * engine =
+      (waon_processing_t *) calloc(1, sizeof(waon_processing_t));
+
+   CHECK_MALLOC(engine, "processing_create");
+   return engine;
+}
+
+/**
+ *    Frees the buffers and the plan of an engine, but not the engine.
+ */
+
+static void
+processing_release (waon_processing_t * engine)
+{
+   fft_batch_free(engine->batch);
+   free(engine->left);
+   free(engine->right);
+   free(engine->x);
+   free(engine->pb);
+   free(engine->phb);
+   free(engine->p0);
+   free(engine->dphi);
+   free(engine->ph0);
+   free(engine->held);
+   free(engine->frames);
+   engine->batch = nullptr;
+   engine->left = engine->right = engine->x = nullptr;
+   engine->pb = engine->phb = nullptr;
+   engine->p0 = engine->dphi = engine->ph0 = engine->held = nullptr;
+   engine->frames = nullptr;
+   engine->channels = 0;
+   engine->fft_len = 0;
+}
+
+/**
+ *    Makes the buffers, the FFTW plan, and the patch for the parameters,
+ *    unless the engine already has them.  The FFTW planner is not thread
+ *    safe, so that threads that share it must call this function one at
+ *    a time.  processing_run() itself does not plan.
+ *
+ * \param engine
+ *    Provides the engine.
+ *
+ * \param parameters
+ *    Provides the FFT length, the batch, the window, the layout, the note
+ *    bank, and the patch file.
+ *
+ * \param scratchpad
+ *    Provides the scratchpad that receives the patch, see init_patch().
+ *    It must be the same from one call to the next.  The sweep of the run
+ *    is to be made from it afterward, so that its sets get the patch.
+ *
+ * \return
+ *    Returns true if something was made, false if the engine was ready.
+ */
 
 wbool_t
-processing
+processing_prepare
 (
-   waon_parameters_t * waon_parameters,
-   analysis_scratchpad_t * analysis_scratchpad
+   waon_processing_t * engine,
+   const waon_parameters_t * parameters,
+   analysis_scratchpad_t * scratchpad
 )
 {
-   wbool_t result = not_nullptr(waon_parameters);
-   if (result)
+   wbool_t result = wfalse;
+   long fft_len = parameters->fft_len;
+   int nbatch = parameters->fft_batch < 1 ? 1 : parameters->fft_batch;
+   wbool_t same_patch =
+      is_nullptr(parameters->file_patch) ?
+         is_nullptr(engine->file_patch) :
+         not_nullptr(engine->file_patch) &&
+            strcmp(parameters->file_patch, engine->file_patch) == 0;
+
+   if
+   (
+      engine->fft_len != fft_len || engine->nbatch != nbatch ||
+      engine->flag_window != parameters->flag_window ||
+      engine->fft_r2c != parameters->fft_r2c ||
+      engine->note_bank != parameters->note_bank
+   )
    {
-      waon_notes_t * notes = WAON_notes_init();
-      long fft_len = waon_parameters->fft_len;  /* this one is used a lot           */
-      char vel[128];                      /* velocity at the current step     */
-      int on_event[128];                  /* event index of waon_notes_t      */
-      double * left  = (double *) malloc(sizeof(double) * fft_len);
-      double * right = (double *) malloc(sizeof(double) * fft_len);
-      double * x = nullptr;               /* wave data for FFT                */
-      double * y = nullptr;               /* spectrum data for FFT            */
-      double * p = nullptr;               /* power spectrum                   */
-      double * p0 = nullptr;
-      double * dphi = nullptr;
-      double * ph0 = nullptr;
-      double * ph1 = nullptr;
-      double * pmidi = nullptr;
-      SNDFILE * sf = nullptr;
-      SF_INFO sfinfo;
-      double t0;
-      double den;
-      int i0, i1;
-      int i, sum;
-#ifdef FFTW2
-      rfftw_plan plan;
-#else /* FFTW3 */
-      fftw_plan plan;
-#endif
-      int icnt; /* counter  */
-      long div;
-
-      CHECK_MALLOC(notes, "main");
-      CHECK_MALLOC(left,  "main");
-      CHECK_MALLOC(right, "main");
-      for (i = 0; i < 128; i ++)
+      long nbin = fft_len/2 + 1;
+      processing_release(engine);
+      engine->left  = (double *) malloc(sizeof(double) * fft_len);
+      engine->right = (double *) malloc(sizeof(double) * fft_len);
+      engine->x = (double *) malloc(sizeof(double) * fft_len);
+      engine->pb = (double *) malloc(sizeof(double) * nbin * nbatch);
+      engine->phb = (double *) malloc(sizeof(double) * nbin * nbatch);
+      engine->p0 = (double *) malloc(sizeof(double) * nbin);
+      engine->dphi = (double *) malloc(sizeof(double) * nbin);
+      engine->ph0 = (double *) malloc(sizeof(double) * nbin);
+      engine->held = (double *) malloc(sizeof(double) * fft_len);
+      engine->frames = (double *) malloc(sizeof(double) * fft_len * 2);
+      CHECK_MALLOC(engine->left, "processing_prepare");
+      CHECK_MALLOC(engine->right, "processing_prepare");
+      CHECK_MALLOC(engine->x, "processing_prepare");
+      CHECK_MALLOC(engine->pb, "processing_prepare");
+      CHECK_MALLOC(engine->phb, "processing_prepare");
+      CHECK_MALLOC(engine->p0, "processing_prepare");
+      CHECK_MALLOC(engine->dphi, "processing_prepare");
+      CHECK_MALLOC(engine->ph0, "processing_prepare");
+      CHECK_MALLOC(engine->held, "processing_prepare");
+      CHECK_MALLOC(engine->frames, "processing_prepare");
+      engine->channels = 2;               /* processing_run() grows it       */
+      if (! parameters->note_bank)
       {
-         vel[i]      = 0;
-         on_event[i] = -1;
-      }
+         /*
+          * Full valgrind check shows reachable "lost" block here:
+          */
 
-#ifdef FFTW2
-      x = (double *) malloc(sizeof(double) * fft_len);
-      y = (double *) malloc(sizeof(double) * fft_len);
-#else       /* FFTW3 */
-      x = (double *) fftw_malloc(sizeof(double) * fft_len);
-      y = (double *) fftw_malloc(sizeof(double) * fft_len);
-#endif
-      p = (double *) malloc(sizeof(double) * (fft_len/2 + 1));
-      CHECK_MALLOC(x, "main");
-      CHECK_MALLOC(y, "main");
-      CHECK_MALLOC(p, "main");
-      if (waon_parameters->flag_phase)
-      {
-         p0 = (double *) malloc(sizeof(double) * (fft_len/2 + 1));
-         dphi = (double *) malloc(sizeof(double) * (fft_len/2 + 1));
-         ph0 = (double *) malloc(sizeof(double) * (fft_len/2 + 1));
-         ph1 = (double *) malloc(sizeof(double) * (fft_len/2 + 1));
-         CHECK_MALLOC(p0, "main");
-         CHECK_MALLOC(dphi, "main");
-         CHECK_MALLOC(ph0, "main");
-         CHECK_MALLOC(ph1, "main");
-      }
-      pmidi = (double *) malloc(sizeof(double) * 128);
-      CHECK_MALLOC(pmidi, "main");
-      if (is_nullptr(waon_parameters->file_midi))       /* MIDI output file */
-      {
-         waon_parameters->file_midi = (char *) malloc
+         engine->batch = fft_batch_create
          (
-            sizeof(char) * (strlen("output.mid") + 1)
+            fft_len, nbatch, parameters->flag_window, parameters->fft_r2c
          );
-         CHECK_MALLOC(waon_parameters->file_midi, "main");
-         strcpy(waon_parameters->file_midi, "output.mid");
       }
-      if (is_nullptr(waon_parameters->file_wav))        /* open input wav file */
+      engine->fft_len = fft_len;
+      engine->nbatch = nbatch;
+      engine->flag_window = parameters->flag_window;
+      engine->fft_r2c = parameters->fft_r2c;
+      engine->note_bank = parameters->note_bank;
+      same_patch = wfalse;                /* the patch depends on the length  */
+      result = wtrue;
+   }
+   if (! same_patch)
+   {
+      free(engine->file_patch);
+      engine->file_patch = nullptr;
+      if (not_nullptr(parameters->file_patch))
       {
-         waon_parameters->file_wav = (char *) malloc(sizeof(char) * 2);
-         CHECK_MALLOC(waon_parameters->file_wav, "main");
-         waon_parameters->file_wav[0] = '-';
+         engine->file_patch = strdup(parameters->file_patch);
+         CHECK_MALLOC(engine->file_patch, "processing_prepare");
       }
+      init_patch
+      (
+         parameters->file_patch, fft_len, parameters->flag_window, scratchpad
+      );
+      result = wtrue;
+   }
+   return result;
+}
 
+/**
+ *    Transcribes a sound file into the notes of each set of the sweep.
+ *
+ * \param engine
+ *    Provides the engine, prepared for the parameters.
+ *
+ * \param parameters
+ *    Provides the parameters of the analysis.  The file_wav name is used
+ *    only as the key of the spectral cache.
+ *
+ * \param sweep
+ *    Provides the parameter sets, which receive the notes.
+ *
+ * \param sf
+ *    Provides the sound file, opened for reading, mono or stereo.
+ *
+ * \param sfinfo
+ *    Provides its format.
+ *
+ * \param stats
+ *    Receives the figures of the run.
+ *
+ * \return
+ *    Returns false if the sound is shorter than the first frame.
+ */
+
+wbool_t
+processing_run
+(
+   waon_processing_t * engine,
+   const waon_parameters_t * waon_parameters,
+   waon_sweep_t * sweep,
+   SNDFILE * sf,
+   const SF_INFO * sfinfo,
+   waon_processing_stats_t * stats
+)
+{
+   long fft_len = waon_parameters->fft_len;  /* this one is used a lot  */
+   double * left  = engine->left;
+   double * right = engine->right;
+   double * x = engine->x;                /* wave data for FFT                */
+   double * pb = engine->pb;              /* power spectra of the batch       */
+   double * phb = engine->phb;            /* phase spectra of the batch       */
+   double * p = nullptr;                  /* power spectrum (a row of pb[])   */
+   double * p0 = engine->p0;
+   double * dphi = engine->dphi;
+   double * ph0 = engine->ph0;
+   double * ph1 = nullptr;                /* phase spectrum (a row of phb[])  */
+   double * held = engine->held;          /* the last gated frame             */
+   waon_note_bank_t * bank = nullptr;     /* optional Goertzel note bank     */
+   waon_spec_cache_t * cache = nullptr;   /* spectral cache, read or written */
+   wbool_t cache_read = wfalse;           /* stage 1 comes from the cache     */
+   double * msb = nullptr;                /* mean-square of the batch rows    */
+   waon_fft_batch_t * batch = engine->batch; /* frames transformed together  */
+   int nbatch = engine->nbatch;           /* frames in one batch              */
+   long nbin = fft_len/2 + 1;             /* length of one power spectrum     */
+   wbool_t eof = wfalse;
+   wbool_t silent = wfalse;               /* gated, see frame_mean_square() */
+   wbool_t have_ph0 = wfalse;             /* ph0[] holds the previous frame   */
+   wbool_t have_held = wfalse;            /* held[] precedes the next frame   */
+   wbool_t seeded = wfalse;               /* row 0 is held[], for its phase   */
+   double gate = 0.0;                     /* mean-square of a silent frame    */
+   int nsilent = 0;                       /* statistic:  gated frames         */
+   double t0;
+   double den;
+   int i0, i1;
+   int i;
+   int icnt; /* counter  */
+   int k, nframes;                        /* row, and rows loaded in batch    */
+
+   /*
+    * -  t0 is the time-period for the FFT (inverse of smallest
+    *    frequency).
+    * -  den is the weight of the FFT window function.
+    * -  i0 to i1 is the range to analyse (search notes) after 't0' is
+    *    calculated.  i0 == 0 means a DC component (frequency == 0).
+    */
+
+   t0 = (double) fft_len / (double) sfinfo->samplerate;
+   den = init_den(fft_len, waon_parameters->flag_window);
+   i0 = (int)
+   (
+      g_midi_pitch_info.mp_mid2freq[waon_parameters->notelow] * t0 - 0.5
+   );
+   i1 = (int)
+   (
+      g_midi_pitch_info.mp_mid2freq[waon_parameters->notetop] * t0 - 0.5
+   ) + 1;
+   if (i0 <= 0)
+      i0 = 1;
+
+   if (i1 >= (fft_len/2))
+      i1 = fft_len/2 - 1;
+
+   if (sfinfo->channels > engine->channels)  /* sndfile_read() splits them */
+   {
+      free(engine->frames);
+      engine->frames = (double *) malloc
+      (
+         sizeof(double) * fft_len * sfinfo->channels
+      );
+      CHECK_MALLOC(engine->frames, "processing_run");
+      engine->channels = sfinfo->channels;
+   }
+   if (not_nullptr(waon_parameters->file_spec_cache))
+   {
       /*
-       * Yields "Conditional jump or move depends on uninitialised
-       * value(s)" inside this function call in valgrind:
+       * Use the spectral cache if it matches this analysis, otherwise
+       * (re)write it during this run.  The note bank makes no spectra.
        */
 
-      sf = sf_open(waon_parameters->file_wav, SFM_READ, &sfinfo);
-      if (is_nullptr(sf))
+      waon_spec_header_t key;
+      spec_cache_key
+      (
+         &key, waon_parameters->file_wav, fft_len,
+         waon_parameters->shift_hop, waon_parameters->flag_window,
+         sfinfo->samplerate, sfinfo->channels, (long) sfinfo->frames,
+         waon_parameters->flag_phase
+      );
+      if (waon_parameters->note_bank)
+         infoprint("The spectral cache is not used with --note-bank");
+      else
       {
-         fprintf
-         (
-            stderr, "Can't open input file %s: %s\n",
-            waon_parameters->file_wav, strerror(errno)
-         );
-         exit(1);
+         cache = spec_cache_open(waon_parameters->file_spec_cache, &key);
+         if (not_nullptr(cache))
+            cache_read = wtrue;
+         else
+            cache = spec_cache_create(waon_parameters->file_spec_cache, &key);
       }
-      sndfile_print_info(&sfinfo);
-      if (sfinfo.channels != 2 && sfinfo.channels != 1)
+      if (not_nullptr(cache) && ! cache_read)
       {
-         errprint("Only mono and stereo inputs are supported");
-         exit(1);
+         msb = (double *) malloc(sizeof(double) * nbatch);
+         CHECK_MALLOC(msb, "processing_run");
       }
+   }
+   if (waon_parameters->note_bank)
+   {
+      bank = note_bank_create
+      (
+         waon_parameters->notelow, waon_parameters->notetop,
+         waon_parameters->bank_harmonics, fft_len,
+         (double) sfinfo->samplerate, waon_parameters->flag_window,
+         waon_parameters->adj_pitch
+      );
+   }
 
+   if (waon_parameters->shift_hop != fft_len) /* for first step */
+   {
       /*
-       * -  t0 is the time-period for the FFT (inverse of smallest
-       *    frequency).
-       * -  den is the weight of the FFT window function.
-       * -  i0 to i1 is the range to analyse (search notes) after 't0' is
-       *    calculated.  i0 == 0 means a DC component (frequency == 0).
+       * Full valgrind check shows reachable "lost" block in
+       * sndfile_read() call.
        */
 
-      t0 = (double) fft_len / (double) sfinfo.samplerate;
-      den = init_den(fft_len, waon_parameters->flag_window);
-      i0 = (int)
-      (
-         g_midi_pitch_info.mp_mid2freq[waon_parameters->notelow] * t0 - 0.5
-      );
-      i1 = (int)
+      if
       (
-         g_midi_pitch_info.mp_mid2freq[waon_parameters->notetop] * t0 - 0.5
-      ) + 1;
-      if (i0 <= 0)
-         i0 = 1;
-
-      if (i1 >= (fft_len/2))
-         i1 = fft_len/2 - 1;
+         sndfile_read
+         (
+            sf, *sfinfo, left+waon_parameters->shift_hop,
+            right+waon_parameters->shift_hop, fft_len-waon_parameters->shift_hop,
+            engine->frames
+         )
+         != (fft_len - waon_parameters->shift_hop)
+      )
+      {
+         spec_cache_close(cache);
+         note_bank_free(bank);
+         free(msb);
+         return wfalse;
+      }
+   }
 
-      init_patch
-      (
-         waon_parameters->file_patch, fft_len, waon_parameters->flag_window,
-         analysis_scratchpad
-      );
+   /*
+    * The energy gate.  Both the absolute and the relative (-r) cutoffs
+    * scale the velocity from 10^cut_ratio, so that a frame whose
+    * mean-square cannot put any bin over 10^cut_ratio yields only zero
+    * velocities.  The note bank sums the weighted power of its
+    * partials, so its bound is larger by the sum of the weights.  The
+    * drum and octave removals only lower the power, unless they are
+    * given negative factors.  With the phase correction, a gated frame
+    * followed by a loud one is still transformed, for its phase, so
+    * that the gate does not change the notes.
+    */
 
-#ifdef FFTW2                     /* initialization plan for FFTW2 or FFTW3 */
-      plan = rfftw_create_plan(fft_len, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE);
-#else
+   {
+      double gain = 1.0;
+      if (not_nullptr(bank))
+      {
+         gain = 0.0;
+         for (k = 1; k <= bank->harmonics; ++k)
+            gain += 1.0 / (double) k;  /* the weights of the partials  */
+      }
+      gate = sweep_gate(sweep, gain);  /* the lowest cutoff of all sets  */
+      if (not_nullptr(msb))
+         gate = 0.0;                   /* the cache needs every frame     */
+   }
+   icnt = 0;
+   eof = cache_read;                   /* the cache replaces the main loop */
+   if (cache_read)
+   {
       /*
-       * Full valgrind check shows reachable "lost" block here:
+       * Stage 1 from the cache:  the power (and the phase correction)
+       * of each frame is read instead of computed.  The mean-square
+       * still drives the energy gate.
        */
 
-      plan = fftw_plan_r2r_1d(fft_len, x, y, FFTW_R2HC, FFTW_ESTIMATE);
-#endif
-
-      if (waon_parameters->shift_hop != fft_len) /* for first step */
+      long nframe = spec_cache_frames(cache);
+      for ( ; icnt < nframe; ++icnt)
       {
-         /*
-          * Full valgrind check shows reachable "lost" block in
-          * sndfile_read() call.
-          */
-
-         if
+         double ms = spec_cache_read
          (
-            sndfile_read
-            (
-               sf, sfinfo, left+waon_parameters->shift_hop,
-               right+waon_parameters->shift_hop, fft_len-waon_parameters->shift_hop
-            )
-            != (fft_len - waon_parameters->shift_hop)
-         )
+            cache, icnt, pb, waon_parameters->flag_phase ? dphi : nullptr
+         );
+         if (gate > 0.0 && ms <= gate)
          {
-            fprintf (stderr, "No Wav Data!\n");
-            exit(0);
+            sweep_silence(sweep, icnt);
+            ++nsilent;
+         }
+         else if (waon_parameters->flag_phase == 0)
+         {
+            sweep_spectrum(sweep, icnt, pb, nullptr, i0, i1, t0);
+         }
+         else
+         {
+            for (i = 0; i < (fft_len/2 + 1); ++i)           /* full span */
+            {
+               dphi[i] = ((double) i / (double) fft_len + dphi[i]) *
+                  (double) sfinfo->samplerate;
+            }
+            sweep_spectrum(sweep, icnt, pb, dphi, i0, i1, t0);
          }
       }
-      g_midi_pitch_info.mp_pitch_shift = 0.0;
-      g_midi_pitch_info.mp_n_pitch = 0;
-      for (icnt = 0; ; icnt++)                              /* MAIN LOOP      */
+   }
+   for ( ; ! eof; )                                      /* MAIN LOOP      */
+   {
+      for (nframes = 0; nframes < nbatch; )      /* read a batch of hops */
       {
          for (i = 0; i < fft_len - waon_parameters->shift_hop; i ++) /* shift       */
          {
-            if (sfinfo.channels == 2)                       /* stereo         */
+            if (sfinfo->channels == 2)                       /* stereo         */
             {
                left[i] = left[i + waon_parameters->shift_hop];
                right[i] = right[i + waon_parameters->shift_hop];
@@ -242,9 +463,9 @@ processing
          (
             sndfile_read                              /* read from wav */
             (
-               sf, sfinfo, left + (fft_len-waon_parameters->shift_hop),
+               sf, *sfinfo, left + (fft_len-waon_parameters->shift_hop),
                right + (fft_len-waon_parameters->shift_hop),
-               waon_parameters->shift_hop
+               waon_parameters->shift_hop, engine->frames
             )
             != waon_parameters->shift_hop
          )
@@ -255,36 +476,101 @@ processing
              * errprint("WaoN: end of file");
              */
 
+            eof = wtrue;
             break;
          }
          for (i = 0; i < fft_len; i ++)   /* set double table x[] for FFT */
          {
-            if (sfinfo.channels == 2)                 /* stereo */
+            if (sfinfo->channels == 2)                 /* stereo */
                x[i] = 0.5 * (left[i] + right[i]);
             else                                      /* mono */
                x[i] = left[i];
          }
+         if (gate > 0.0 && frame_mean_square(fft_len, x) <= gate)
+         {
+            if (waon_parameters->flag_phase && is_nullptr(bank))
+            {
+               memcpy(held, x, sizeof(double) * fft_len);
+               have_held = wtrue;      /* the next frame needs its phase   */
+            }
+            silent = wtrue;            /* handled after the batch below */
+            break;
+         }
+         if (not_nullptr(bank))
+         {
+            /*
+             * Stages 1 and 2 in one pass:  the note bank evaluates the
+             * power only at the note frequencies.
+             */
 
-         /**
-          * Stage 1: calculate power spectrum
-          */
+            note_bank_power(bank, x);
+            sweep_bank(sweep, icnt, bank);
+            ++icnt;
+            continue;                  /* no batch:  read until end of file */
+         }
+
+         if (have_held)
+         {
+            /*
+             * The frame before was gated, but the phase correction of
+             * this one needs its phase, as without the gate.  A silent
+             * frame only precedes the first row of a batch, so that
+             * held[] is the first row, unless the batch has one row,
+             * which is then transformed on its own.
+             */
+
+            if (nframes + 1 < nbatch)
+            {
+               fft_batch_load(batch, nframes++, held);
+               seeded = wtrue;
+            }
+            else
+            {
+               fft_batch_load(batch, 0, held);
+               fft_batch_execute(batch);
+               fft_batch_polar2(batch, 1, den, p0, ph0);
+               have_ph0 = wtrue;
+            }
+            have_held = wfalse;
+         }
+         if (not_nullptr(msb))
+            msb[nframes] = frame_mean_square(fft_len, x);
 
-         windowing(fft_len, x, waon_parameters->flag_window, 1.0, x);
+         fft_batch_load(batch, nframes++, x);   /* windowing          */
+      }
 
-#ifdef FFTW2
-         rfftw_one(plan, x, y);
-#else
-         fftw_execute(plan); /* x[] -> y[] */
-#endif
+      /**
+       * Stage 1: calculate the power spectra of the whole batch
+       */
 
-         if (waon_parameters->flag_phase == 0)
+      if (nframes > 0)
+      {
+         fft_batch_execute(batch);
+         if (waon_parameters->flag_phase == 0)  /* no PV correction     */
+            fft_batch_amp2(batch, nframes, den, pb);
+         else                                /* with PV correction      */
+            fft_batch_polar2(batch, nframes, den, pb, phb);
+      }
+
+      k = 0;
+      if (seeded)                      /* held[], for its phase only      */
+      {
+         for (i = 0; i < (fft_len/2 + 1); ++i)  /* full span              */
          {
-            HC_to_amp2 (fft_len, y, den, p); /* no phase-vocoder correction   */
+            p0[i] = pb[i];
+            ph0[i] = phb[i];
          }
-         else                                /* with phase-vocoder correction */
+         have_ph0 = wtrue;
+         seeded = wfalse;
+         k = 1;
+      }
+      for ( ; k < nframes; ++k, ++icnt)           /* each frame in order */
+      {
+         p = pb + k * nbin;
+         if (waon_parameters->flag_phase)
          {
-            HC_to_polar2(fft_len, y, 0, den, p, ph1);
-            if (icnt == 0)                   /* first step, so no ph0[] yet   */
+            ph1 = phb + k * nbin;
+            if (! have_ph0)         /* first step, or first after a gap */
             {
                for (i = 0; i < (fft_len/2 + 1); ++i) /* full span             */
                {
@@ -292,6 +578,7 @@ processing
                   p0[i] = p[i];              /* backup phase for next step    */
                   ph0[i] = ph1[i];
                }
+               have_ph0 = wtrue;
             }
             else                       /* freq correction by phase difference */
             {
@@ -323,46 +610,34 @@ processing
                }
             }
          }
-         if (waon_parameters->psub_n != 0)              /* drum-removal process */
-         {
-            power_subtract_ave(fft_len, p, waon_parameters->psub_n, waon_parameters->psub_f);
-         }
-         if (waon_parameters->oct_f != 0.0)             /* octave-removal process */
+         if (not_nullptr(msb))             /* writing the spectral cache */
          {
-            power_subtract_octave(fft_len, p, waon_parameters->oct_f);
+            spec_cache_write
+            (
+               cache, msb[k], p,
+               waon_parameters->flag_phase ? dphi : nullptr
+            );
          }
-
          /**
-          * Stage 2: pickup notes, new code:
+          * Stages 1b to 3, for each parameter set:  drum and octave
+          * removal, note pickup, and the check of the previous time
+          * for note-on/off.  Stage 2, new code (not used):
           *
-         if (flag_phase == 0)
-         {
-           average_FFT_into_midi (fft_len, (double)sfinfo.samplerate,
-                   p, NULL,
-                   pmidi);
-         }
-              else
-         {
-           average_FFT_into_midi (fft_len, (double)sfinfo.samplerate,
-                   p, dphi,
-                   pmidi);
-         }
-              pickup_notes (pmidi,
-                cut_ratio, rel_cut_ratio,
-                notelow, notetop,
-                vel);
+         average_FFT_into_midi
+         (
+            fft_len, (double)sfinfo->samplerate, p, flag_phase ? dphi : NULL,
+            pmidi
+         );
+         pickup_notes
+         (
+            pmidi, cut_ratio, rel_cut_ratio, notelow, notetop, vel
+         );
           *
           */
 
-         /* old code */
-
          if (waon_parameters->flag_phase == 0) /* no phase-vocoder correction */
          {
-            note_intensity
-            (
-               p, nullptr, waon_parameters->cut_ratio, waon_parameters->rel_cut_ratio,
-               i0, i1, t0, vel, analysis_scratchpad
-            );
+            sweep_spectrum(sweep, icnt, p, nullptr, i0, i1, t0);
          }
          else
          {
@@ -375,122 +650,197 @@ processing
             for (i = 0; i < (fft_len/2 + 1); ++i)           /* full span */
             {
                dphi[i] = ((double) i / (double) fft_len + dphi[i]) *
-                  (double) sfinfo.samplerate;
+                  (double) sfinfo->samplerate;
             }
-            note_intensity
-            (
-               p, dphi, waon_parameters->cut_ratio, waon_parameters->rel_cut_ratio,
-               i0, i1, t0, vel, analysis_scratchpad
-            );
+            sweep_spectrum(sweep, icnt, p, dphi, i0, i1, t0);
          }
+      }
+      if (silent)                      /* gated frame:  no FFT, no notes */
+      {
+         sweep_silence(sweep, icnt);
+         ++icnt;
+         ++nsilent;
+         have_ph0 = wfalse;
+         silent = wfalse;
+      }
+   }                                            /* MAIN LOOP      */
+
+   /* Clean up the generated notes */
+
+   sweep_finish(sweep);
+
+   /*
+    * div is the divisions for one beat (quarter-note).
+    * Here we assume 120 BPM, that is, 1 beat is 0.5 sec.
+    *
+    * \note:
+    *    (shift_hop / ft->rate) = duration for 1 step (sec)
+   */
+
+   stats->div = (long)
+   (
+      0.5 * (double) sfinfo->samplerate / (double) waon_parameters->shift_hop
+   );
+   stats->frames = icnt;
+   stats->gated = nsilent;
+   spec_cache_close(cache);
+   note_bank_free(bank);
+   if (not_nullptr(msb))
+      free(msb);
+
+   return wtrue;
+}
 
-         /**
-          * Stage 3: check previous time for note-on/off
-          */
+/**
+ *    Frees an engine.
+ */
+
+void
+processing_free (waon_processing_t * engine)
+{
+   if (not_nullptr(engine))
+   {
+      processing_release(engine);
+      free(engine->file_patch);
+      free(engine);
+   }
+}
+
+/**
+ *    Transcribes the input file of the parameters into one MIDI file per
+ *    parameter set, as waonc does.
+ */
 
-         WAON_notes_check
+wbool_t
+processing
+(
+   waon_parameters_t * waon_parameters,
+   analysis_scratchpad_t * analysis_scratchpad
+)
+{
+   wbool_t result = not_nullptr(waon_parameters);
+   if (result)
+   {
+      waon_processing_t * engine = nullptr;
+      waon_processing_stats_t stats;
+      waon_sweep_t * sweep = nullptr;     /* parameter sets, notes of each    */
+      SNDFILE * sf = nullptr;
+      SF_INFO sfinfo;
+      int i, sum;
+      int k;
+
+      if (is_nullptr(waon_parameters->file_midi))       /* MIDI output file */
+      {
+         waon_parameters->file_midi = (char *) malloc
          (
-            notes, icnt, vel, on_event, 8, 0, waon_parameters->peak_threshold
+            sizeof(char) * (strlen("output.mid") + 1)
          );
-      }                                            /* MAIN LOOP      */
+         CHECK_MALLOC(waon_parameters->file_midi, "main");
+         strcpy(waon_parameters->file_midi, "output.mid");
+      }
+      if (is_nullptr(waon_parameters->file_wav))        /* open input wav file */
+      {
+         waon_parameters->file_wav = (char *) malloc(sizeof(char) * 2);
+         CHECK_MALLOC(waon_parameters->file_wav, "main");
+         waon_parameters->file_wav[0] = '-';
+      }
 
-      /* Clean up the generated notes */
+      /*
+       * The patch goes into the scratchpad before the sweep copies it
+       * into its sets.
+       */
 
-      WAON_notes_regulate(notes);
-      WAON_notes_remove_shortnotes(notes, 1, 64);
-      WAON_notes_remove_shortnotes(notes, 2, 28);
-      WAON_notes_remove_octaves(notes);
+      engine = processing_create();
+      (void) processing_prepare(engine, waon_parameters, analysis_scratchpad);
+      sweep = sweep_create(waon_parameters, analysis_scratchpad);
+      if (is_nullptr(sweep))
+         exit(1);
 
       /*
-       *
-      g_midi_pitch_info.mp_pitch_shift /= (double) g_midi_pitch_info.mp_n_pitch;
-      fprintf
-      (
-         stderr, "WaoN : difference of pitch = %f ( + %f )\n",
-         -(g_midi_pitch_info.mp_pitch_shift - 0.5),
-         g_midi_pitch_info.mp_adj_pitch
-      );
-       *
+       * Yields "Conditional jump or move depends on uninitialised
+       * value(s)" inside this function call in valgrind:
        */
 
-      /*
-       * div is the divisions for one beat (quarter-note).
-       * Here we assume 120 BPM, that is, 1 beat is 0.5 sec.
-       *
-       * \note:
-       *    (shift_hop / ft->rate) = duration for 1 step (sec)
-      */
-
-      div = (long)
-      (
-         0.5 * (double) sfinfo.samplerate / (double) waon_parameters->shift_hop
-      );
-      fprintf
+      sf = sf_open(waon_parameters->file_wav, SFM_READ, &sfinfo);
+      if (is_nullptr(sf))
+      {
+         fprintf
+         (
+            stderr, "Can't open input file %s: %s\n",
+            waon_parameters->file_wav, strerror(errno)
+         );
+         exit(1);
+      }
+      sndfile_print_info(&sfinfo);
+      if (sfinfo.channels != 2 && sfinfo.channels != 1)
+      {
+         errprint("Only mono and stereo inputs are supported");
+         exit(1);
+      }
+      if
       (
-         stderr,
-         "   Division:           %ld\n"
-         "   WaoN # of events:   %d\n"
-         "   Minimum note:       %d\n"
-         "   Maximum note:       %d\n"
-         ,
-         div, notes->n, notes->minimum, notes->maximum
-      );
-      sum = 0;
-      if (waon_parameters->dump_bins)
+         ! processing_run
+         (
+            engine, waon_parameters, sweep, sf, &sfinfo, &stats
+         )
+      )
       {
-         for (i = 0; i < MIDI_NOTE_COUNT; ++i)
+         fprintf (stderr, "No Wav Data!\n");
+         exit(0);
+      }
+
+      if (sweep->count == 1)
+      {
+         waon_notes_t * notes = sweep->sets[0].notes;
+         fprintf
+         (
+            stderr,
+            "   Division:           %ld\n"
+            "   WaoN # of events:   %d\n"
+            "   Minimum note:       %d\n"
+            "   Maximum note:       %d\n"
+            "   Gated frames:       %d of %d\n"
+            ,
+            stats.div, notes->n, notes->minimum, notes->maximum,
+            stats.gated, stats.frames
+         );
+         sum = 0;
+         if (waon_parameters->dump_bins)
          {
-            if (notes->bin[i] > 0)
+            for (i = 0; i < MIDI_NOTE_COUNT; ++i)
             {
-               fprintf(stderr, "bin[%3d] = %5d\n", i, notes->bin[i]);
-               sum += notes->bin[i];
+               if (notes->bin[i] > 0)
+               {
+                  fprintf(stderr, "bin[%3d] = %5d\n", i, notes->bin[i]);
+                  sum += notes->bin[i];
+               }
             }
+            fprintf(stderr, "   Bin total:          %5d\n", sum);
          }
-         fprintf(stderr, "   Bin total:          %5d\n", sum);
+         if (waon_parameters->dump_events)
+            WAON_notes_dump(notes);
       }
-      if (waon_parameters->dump_events)
-         WAON_notes_dump(notes);
-
-      WAON_notes_output_midi(notes, div, waon_parameters->file_midi);
-
-#ifdef FFTW2
-      rfftw_destroy_plan(plan);
-#else
-      fftw_destroy_plan(plan);
-#endif /* FFTW2 */
-
-      WAON_notes_free(notes);
-
-      if (not_nullptr(left))
-         free(left);
-
-      if (not_nullptr(right))
-         free(right);
-
-      if (not_nullptr(x))
-         free(x);
-
-      if (not_nullptr(y))
-         free(y);
-
-      if (not_nullptr(p))
-         free(p);
-
-      if (not_nullptr(p0))
-         free(p0);
-
-      if (not_nullptr(dphi))
-         free(dphi);
-
-      if (not_nullptr(ph0))
-         free(ph0);
-
-      if (not_nullptr(ph1))
-         free(ph1);
-
-      if (not_nullptr(pmidi))
-         free(pmidi);
-
+      else
+      {
+         fprintf
+         (
+            stderr,
+            "   Division:           %ld\n"
+            "   Gated frames:       %d of %d\n"
+            ,
+            stats.div, stats.gated, stats.frames
+         );
+         sweep_summary(sweep, stderr);
+      }
+      for (k = 0; k < sweep->count; ++k)        /* one MIDI file per set */
+      {
+         WAON_notes_output_midi
+         (
+            sweep->sets[k].notes, stats.div, sweep->sets[k].parameters.file_midi
+         );
+      }
+      sweep_free(sweep);
+      processing_free(engine);
       parameters_free(waon_parameters);
       sf_close (sf);
    }
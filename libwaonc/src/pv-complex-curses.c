@@ -36,6 +36,8 @@ int flag_nofft = 0;
 
 
 /* play 100 milisecond and return
+ * (with the output queue, play until the queue is full, so that
+ * the keys are scanned without waiting for the device)
  * INPUT
  *  pv        : struct pv_complex
  *  play_cur  : current frame
@@ -55,9 +57,13 @@ play_100msec_curses (struct pv_complex * pv,
    if (*play_cur >= frame1) *play_cur = frame1;
 
 
-   for (l = 0; l < len_100msec; l += pv->hop_syn)
+   for (l = 0; pv->aoq != NULL || l < len_100msec; l += pv->hop_syn)
    {
       long len_play;
+      if (pv_complex_play_ready (pv) == 0)
+      {
+         break; /* the queue is full */
+      }
       if (flag_nofft == 0) len_play = pv_complex_play_step (pv, *play_cur);
       else                 len_play = pv_nofft_play_step (pv, *play_cur);
       if (len_play < pv->hop_res)
@@ -95,9 +101,11 @@ play_100msec_curses (struct pv_complex * pv,
 #define Y_hop_syn (12)
 #define Y_hop_ana (13)
 #define Y_hop_res (14)
+#define Y_cache   (15)
 
 #define Y_status  (16)
-#define Y_comment (18)
+#define Y_queue   (17)
+#define Y_comment (19)
 
 static void
 curses_print_window (int flag_window)
@@ -233,7 +241,8 @@ curses_print_pv (const char * file,
 /* phase vocoder by complex arithmetics with fixed hops.
  */
 void pv_complex_curses (const char * file,
-                        long len, long hop_syn)
+                        long len, long hop_syn,
+                        long latency_ms)
 {
    extern int flag_nofft;
    int flag_window = 3;
@@ -249,6 +258,7 @@ void pv_complex_curses (const char * file,
    long len_1sec;
    long len_10sec;
    ao_device * ao;       /*  = NULL; */
+   ao_queue_t * aoq;
    long status = 1; /* TRUE */
    int ch;
 
@@ -262,6 +272,11 @@ void pv_complex_curses (const char * file,
 
    pv = pv_complex_init (len, hop_syn, flag_window);
    CHECK_MALLOC (pv, "pv_complex_curses");
+   if (pv_complex_set_cache (pv, PV_COMPLEX_CACHE_LOOP_FRAMES) == 0)
+   {
+      /* the loops are transformed at each pass then */
+      fprintf (stderr, "no memory for the spectrum cache\n");
+   }
 
    /* open input file */
 
@@ -277,7 +292,17 @@ void pv_complex_curses (const char * file,
    pv_complex_set_input (pv, sf, &sfinfo);
 
    ao = ao_init_16_stereo (sfinfo.samplerate, 0);
-   pv_complex_set_output_ao (pv, ao);
+   aoq = ao_queue_new (ao, sfinfo.samplerate, latency_ms);
+   if (aoq != NULL)
+   {
+      /* the keys are scanned while the output thread plays */
+      pv_complex_set_output_ao_queue (pv, aoq);
+      timeout (10); /* wait for a key at most 10 msec */
+   }
+   else
+   {
+      pv_complex_set_output_ao (pv, ao);
+   }
 
 
    /* initial values */
@@ -316,6 +341,10 @@ void pv_complex_curses (const char * file,
          flag_play = flag_play % 2;
          if (flag_play == 0) mvprintw(Y_status, 1, "status     : stop");
          else                mvprintw(Y_status, 1, "status     : play");
+         if (flag_play == 0 && aoq != NULL)
+         {
+            ao_queue_flush (aoq); /* stop now, not after the latency */
+         }
          break;
 
       case '>':
@@ -473,14 +502,30 @@ void pv_complex_curses (const char * file,
          */
       }
       mvprintw (Y_frames, 1, "current    : %010ld", play_cur);
+      mvprintw (Y_cache,  1, "fft-cache  : %5.1f %% hits",
+                pv_complex_cache_hit_rate (pv));
+      if (aoq != NULL)
+      {
+         mvprintw (Y_queue,  1, "ao-queue   : %05ld (min %05ld),"
+                   " underruns %lu  ",
+                   ao_queue_depth (aoq), ao_queue_depth_min (aoq),
+                   ao_queue_underruns (aoq));
+      }
       refresh();
    }
    while (status == 1)
       ;
 
+   endwin(); /* End ncurses mode */
+   if (aoq != NULL)
+   {
+      fprintf (stderr, "ao queue: %ld frames, underruns %lu\n",
+               aoq->size, ao_queue_underruns (aoq));
+      ao_queue_free (aoq);
+   }
+
    pv_complex_free (pv);
    sf_close (sf) ;
-   endwin(); /* End ncurses mode */
 }
 
 /*
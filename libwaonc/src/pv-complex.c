@@ -26,64 +26,116 @@
 
 #include "memory-check.h" /* CHECK_MALLOC() macro */
 #include "hc.h" /* half-complex format handling routines */
-#include "fft.h" /* windowing() */
+#include "hc-simd.h" /* vectorized HC phase vocoder and lock */
+#include "cx.h" /* interleaved complex format handling routines */
+#include "fft.h" /* windowing(), windowed_FFT_stereo() */
 #include "snd.h"
 #include "ao-wrapper.h"
 #include "pv-conventional.h" /* get_scale_factor_for_window() */
 #include "pv-complex.h"
+#include "pv-render.h" /* pv_render() */
 
 
 /** utility routines for struct pv_omplex_data **/
 
+/* OUTPUT
+ *  returned value : the new struct pv_complex,
+ *                   or NULL if the memory is short
+ */
 struct pv_complex *
 pv_complex_init (long len, long hop_syn, int flag_window)
 {
-   int i;
+   /* the pointers are NULL until allocated, for pv_complex_free() */
    struct pv_complex * pv
-      = (struct pv_complex *) malloc (sizeof (struct pv_complex));
-   CHECK_MALLOC (pv, "pv_complex_init");
+      = (struct pv_complex *) calloc (1, sizeof (struct pv_complex));
+   if (pv == NULL)
+   {
+      return (NULL);
+   }
 
    pv->len = len;
    pv->hop_syn = hop_syn;
+   pv->flag_r2c = 0; /* half-complex (for default) */
+   pv->spec_len = len;
 
    pv->flag_window = flag_window;
 
    pv->window_scale = get_scale_factor_for_window (len, hop_syn, flag_window);
 
    pv->time = (double *)fftw_malloc (len * sizeof(double));
-   pv->freq = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (pv->time, "pv_complex_init");
-   CHECK_MALLOC (pv->freq, "pv_complex_init");
-   pv->plan = fftw_plan_r2r_1d (len, pv->time, pv->freq,
-                                FFTW_R2HC, FFTW_ESTIMATE);
+   /* spectra are sized for either layout (see pv_complex_set_r2c()) */
+   pv->freq = (double *)fftw_malloc (CX_LENGTH (len) * sizeof(double));
 
-   pv->f_out = (double *)fftw_malloc (len * sizeof(double));
-   pv->t_out = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (pv->f_out, "pv_complex_init");
-   CHECK_MALLOC (pv->t_out, "pv_complex_init");
-   pv->plan_inv = fftw_plan_r2r_1d (len, pv->f_out, pv->t_out,
-                                    FFTW_HC2R, FFTW_ESTIMATE);
+   pv->st_in  = (double *)fftw_malloc (2 * len * sizeof(double));
+   pv->st_out = (double *)fftw_malloc (2 * len * sizeof(double));
 
-   pv->l_f_old = (double *)malloc (len * sizeof(double));
-   pv->r_f_old = (double *)malloc (len * sizeof(double));
-   CHECK_MALLOC (pv->l_f_old, "pv_complex_init");
-   CHECK_MALLOC (pv->r_f_old, "pv_complex_init");
+   pv->f_out = (double *)fftw_malloc (CX_LENGTH (len) * sizeof(double));
+   pv->t_out = (double *)fftw_malloc (len * sizeof(double));
 
-   pv->l_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   pv->r_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   CHECK_MALLOC (pv->l_out, "pv_complex_init");
-   CHECK_MALLOC (pv->r_out, "pv_complex_init");
-   for (i = 0; i < (hop_syn + len); i ++)
+   pv->l_f_old = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+   pv->r_f_old = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+
+   pv->l_out = (double *) calloc (hop_syn + len, sizeof(double));
+   pv->r_out = (double *) calloc (hop_syn + len, sizeof(double));
+
+   pv->l_read = (double *)malloc (len * sizeof(double));
+   pv->r_read = (double *)malloc (len * sizeof(double));
+
+   pv->l_fs  = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+   pv->r_fs  = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+   pv->l_ft  = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+   pv->r_ft  = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+   pv->l_tmp = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+   pv->r_tmp = (double *)malloc (CX_LENGTH (len) * sizeof(double));
+
+   if (pv->time == NULL || pv->freq == NULL ||
+       pv->st_in == NULL || pv->st_out == NULL ||
+       pv->f_out == NULL || pv->t_out == NULL ||
+       pv->l_f_old == NULL || pv->r_f_old == NULL ||
+       pv->l_out == NULL || pv->r_out == NULL ||
+       pv->l_read == NULL || pv->r_read == NULL ||
+       pv->l_fs == NULL || pv->r_fs == NULL ||
+       pv->l_ft == NULL || pv->r_ft == NULL ||
+       pv->l_tmp == NULL || pv->r_tmp == NULL)
    {
-      pv->l_out [i] = 0.0;
-      pv->r_out [i] = 0.0;
+      pv_complex_free (pv);
+      return (NULL);
    }
 
+   pv->plan = fftw_plan_r2r_1d (len, pv->time, pv->freq,
+                                FFTW_R2HC, FFTW_ESTIMATE);
+   pv->plan_stereo = plan_FFT_stereo (len, pv->st_in, pv->st_out);
+   pv->plan_inv = fftw_plan_r2r_1d (len, pv->f_out, pv->t_out,
+                                    FFTW_HC2R, FFTW_ESTIMATE);
+
    pv->flag_left  = 0; /* l_f_old[] is not initialized yet */
    pv->flag_right = 0; /* r_f_old[] is not initialized yet */
 
    pv->flag_lock = 0; /* no phase lock (for default) */
 
+   pv->input = NULL; /* read pv->sf */
+
+   pv->flag_out = 0;
+   pv->ao  = NULL;
+   pv->aoq = NULL;
+
+   pv->src_quality = SRC_SINC_FASTEST; /* converter for the pitch-shift */
+   pv->resample = NULL;
+   pv->l_res = NULL;
+   pv->r_res = NULL;
+   pv->res_len = 0;
+
+   pv->n_cache = 0;
+   pv->cache = NULL;
+   pv->cache_clock  = 0;
+   pv->cache_hits   = 0;
+   pv->cache_misses = 0;
+   if (pv_complex_set_cache (pv, PV_COMPLEX_CACHE_FRAMES) == 0)
+   {
+      pv_complex_free (pv);
+      return (NULL);
+   }
+
    /*pv->pitch_shift = 0.0; // no pitch-shift */
 
    return (pv);
@@ -114,6 +166,7 @@ pv_complex_set_input (struct pv_complex * pv,
 {
    pv->sf = sf;
    pv->sfinfo = sfinfo;
+   pv_complex_clear_cache (pv);
 }
 
 void
@@ -122,6 +175,16 @@ pv_complex_set_output_ao (struct pv_complex * pv,
 {
    pv->flag_out = 0;
    pv->ao = ao;
+   pv->aoq = NULL;
+}
+
+void
+pv_complex_set_output_ao_queue (struct pv_complex * pv,
+                                ao_queue_t * q)
+{
+   pv->flag_out = 0;
+   pv->ao = q->device;
+   pv->aoq = q;
 }
 
 void
@@ -139,19 +202,28 @@ pv_complex_free (struct pv_complex * pv)
    if (pv != NULL)
    {
       if (pv->time != NULL)
-         free (pv->time);
+         fftw_free (pv->time);
 
       if (pv->freq != NULL)
-         free (pv->freq);
+         fftw_free (pv->freq);
 
       if (pv->plan != NULL)
          fftw_destroy_plan (pv->plan);
 
+      if (pv->st_in != NULL)
+         fftw_free (pv->st_in);
+
+      if (pv->st_out != NULL)
+         fftw_free (pv->st_out);
+
+      if (pv->plan_stereo != NULL)
+         fftw_destroy_plan (pv->plan_stereo);
+
       if (pv->t_out != NULL)
-         free (pv->t_out);
+         fftw_free (pv->t_out);
 
       if (pv->f_out != NULL)
-         free (pv->f_out);
+         fftw_free (pv->f_out);
 
       if (pv->plan_inv != NULL)
          fftw_destroy_plan (pv->plan_inv);
@@ -168,55 +240,260 @@ pv_complex_free (struct pv_complex * pv)
       if (pv->r_out != NULL)
          free (pv->r_out);
 
+      pv_resample_free (pv->resample);
+      free (pv->l_res);
+      free (pv->r_res);
+
+      free (pv->l_read);
+      free (pv->r_read);
+      free (pv->l_fs);
+      free (pv->r_fs);
+      free (pv->l_ft);
+      free (pv->r_ft);
+      free (pv->l_tmp);
+      free (pv->r_tmp);
+
+      pv_complex_set_cache (pv, 0);
+
       free (pv);
    }
 }
 
+/* select the layout of the spectra (and rebuild the FFTW plans)
+ * INPUT
+ *  flag_r2c : 0 == half-complex layout (FFTW_R2HC, hc.h routines)
+ *             1 == interleaved complex layout (r2c/c2r, cx.h routines)
+ * OUTPUT
+ *  pv->spec_len : number of doubles in the spectra passed around
+ *  pv->flag_left, pv->flag_right : reset, since [lr]_f_old[] are lost
+ */
+void
+pv_complex_set_r2c (struct pv_complex * pv, int flag_r2c)
+{
+   flag_r2c = (flag_r2c != 0);
+   if (flag_r2c == pv->flag_r2c)
+   {
+      return;
+   }
+
+   fftw_destroy_plan (pv->plan);
+   fftw_destroy_plan (pv->plan_inv);
+   if (flag_r2c)
+   {
+      /* note that c2r destroys its input, which is the scratch f_out[] */
+      pv->plan = fftw_plan_dft_r2c_1d (pv->len, pv->time,
+                                       (fftw_complex *)pv->freq,
+                                       FFTW_ESTIMATE);
+      pv->plan_inv = fftw_plan_dft_c2r_1d (pv->len,
+                                           (fftw_complex *)pv->f_out,
+                                           pv->t_out, FFTW_ESTIMATE);
+      pv->spec_len = CX_LENGTH (pv->len);
+   }
+   else
+   {
+      pv->plan = fftw_plan_r2r_1d (pv->len, pv->time, pv->freq,
+                                   FFTW_R2HC, FFTW_ESTIMATE);
+      pv->plan_inv = fftw_plan_r2r_1d (pv->len, pv->f_out, pv->t_out,
+                                       FFTW_HC2R, FFTW_ESTIMATE);
+      pv->spec_len = pv->len;
+   }
+   pv->flag_r2c = flag_r2c;
+
+   pv->flag_left  = 0; /* l_f_old[] is in the other layout */
+   pv->flag_right = 0; /* r_f_old[] is in the other layout */
+   pv_complex_clear_cache (pv); /* so are the cached spectra */
+}
+
+/* resize the spectrum cache (and empty it)
+ * INPUT
+ *  n : number of frames to keep (0 turns the cache off)
+ * OUTPUT
+ *  returned value : 1 on success,
+ *                   0 if the memory is short (the cache is off then)
+ */
+int
+pv_complex_set_cache (struct pv_complex * pv, int n)
+{
+   int i;
+   for (i = 0; i < pv->n_cache; i ++)
+   {
+      free (pv->cache [i].left);
+      free (pv->cache [i].right);
+   }
+   if (pv->cache != NULL)
+   {
+      free (pv->cache);
+      pv->cache = NULL;
+   }
+   pv->n_cache = 0;
+   if (n > 0)
+   {
+      pv->cache = (struct pv_complex_frame *)calloc
+                  (n, sizeof (struct pv_complex_frame));
+      if (pv->cache == NULL)
+      {
+         return 0;
+      }
+      pv->n_cache = n;
+      for (i = 0; i < pv->n_cache; i ++)
+      {
+         /* spectra are sized for either layout */
+         pv->cache [i].left
+            = (double *)malloc (CX_LENGTH (pv->len) * sizeof (double));
+         pv->cache [i].right
+            = (double *)malloc (CX_LENGTH (pv->len) * sizeof (double));
+         if (pv->cache [i].left == NULL || pv->cache [i].right == NULL)
+         {
+            pv_complex_set_cache (pv, 0); /* frees what is there */
+            return 0;
+         }
+      }
+   }
+   pv_complex_clear_cache (pv);
+   return 1;
+}
+
+/* empty the spectrum cache, e.g. for a new input.
+ * the hit and miss counts are kept. */
+void
+pv_complex_clear_cache (struct pv_complex * pv)
+{
+   int i;
+   for (i = 0; i < pv->n_cache; i ++)
+   {
+      pv->cache [i].frame = -1;
+      pv->cache [i].used = 0;
+   }
+}
+
+/* hit rate of the spectrum cache in percent (0 before any read) */
+double
+pv_complex_cache_hit_rate (const struct pv_complex * pv)
+{
+   unsigned long n = pv->cache_hits + pv->cache_misses;
+   if (n == 0)
+   {
+      return 0.0;
+   }
+   return 100.0 * (double)pv->cache_hits / (double)n;
+}
+
+/* Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]|
+ * by HC_complex_phase_vocoder_simd() or CX_complex_phase_vocoder(),
+ * according to pv->flag_r2c.
+ */
+void
+pv_complex_phase_vocoder (struct pv_complex * pv,
+                          const double * fs, const double * ft,
+                          const double * f_out_old, double * f_out)
+{
+   if (pv->flag_r2c)
+   {
+      CX_complex_phase_vocoder (pv->len, fs, ft, f_out_old, f_out);
+   }
+   else
+   {
+      HC_complex_phase_vocoder_simd (pv->len, fs, ft, f_out_old, f_out);
+   }
+}
+
+/* loose phase lock by HC_puckette_lock_simd() or CX_puckette_lock(),
+ * according to pv->flag_r2c.
+ */
+void
+pv_complex_puckette_lock (struct pv_complex * pv,
+                          const double * y, double * z)
+{
+   if (pv->flag_r2c)
+   {
+      CX_puckette_lock (pv->len, y, z);
+   }
+   else
+   {
+      HC_puckette_lock_simd (pv->len, y, z);
+   }
+}
+
 
+/* read [frame, frame + len] from pv->input if it is set,
+ * otherwise from pv->sf
+ * OUTPUT
+ *  returned value : frames read, or PV_ENGINE_MORE (see pv-engine.h)
+ */
+long
+pv_complex_read_at (struct pv_complex * pv,
+                    long frame,
+                    double * left, double * right,
+                    long len)
+{
+   if (pv->input != NULL)
+   {
+      return pv_engine_input_read_at (pv->input, frame, left, right, len);
+   }
+   return sndfile_read_at (pv->sf, *(pv->sfinfo), frame, left, right, len);
+}
+
+/* the windowed spectra of both channels of the frame starting at
+ * "frame", from the spectrum cache if they are there
+ * OUTPUT
+ *  f_left[pv->spec_len], f_right[pv->spec_len] :
+ *  returned value : frames read (pv->len, unless at the end)
+ */
 long
 read_and_FFT_stereo (struct pv_complex * pv,
                      long frame,
                      double * f_left, double * f_right)
 {
-   static double * left  = NULL;
-   static double * right = NULL;
+   double * left  = pv->l_read;
+   double * right = pv->r_read;
+   struct pv_complex_frame * c = NULL;
    long status;
    int i;
-   if (left == NULL)
+
+   /* look up the cache; on a miss, c is the least recently used entry */
+   for (i = 0; i < pv->n_cache; i ++)
    {
-      left  = (double *)malloc (sizeof (double) * pv->len);
-      right = (double *)malloc (sizeof (double) * pv->len);
-      CHECK_MALLOC (left,  "read_and_FFT_stereo");
-      CHECK_MALLOC (right, "read_and_FFT_stereo");
+      struct pv_complex_frame * e = pv->cache + i;
+      if (e->frame == frame && e->flag_window == pv->flag_window)
+      {
+         e->used = ++ pv->cache_clock;
+         pv->cache_hits ++;
+         memcpy (f_left,  e->left,  sizeof (double) * pv->spec_len);
+         memcpy (f_right, e->right, sizeof (double) * pv->spec_len);
+         return (pv->len);
+      }
+      if (c == NULL || e->used < c->used)
+      {
+         c = e;
+      }
    }
+   pv->cache_misses ++;
 
-   status = sndfile_read_at (pv->sf, *(pv->sfinfo), frame,
-                             left, right, pv->len);
+   status = pv_complex_read_at (pv, frame, left, right, pv->len);
    if (status != pv->len)
    {
       return (status);
    }
 
-   /* FFT for left channel */
-   windowing (pv->len, left, pv->flag_window, 1.0, pv->time);
-   fftw_execute (pv->plan); /* FFT: time[] -> freq[] */
-   for (i = 0; i < pv->len; i ++)
-   {
-      f_left [i] = pv->freq [i];
-   }
+   /* FFT for both channels at once, left + i right */
+   windowed_FFT_stereo (pv->len, left, right, pv->flag_window,
+                        pv->plan_stereo, pv->st_in, pv->st_out,
+                        pv->flag_r2c, f_left, f_right);
 
-   /* FFT for right channel */
-   windowing (pv->len, right, pv->flag_window, 1.0, pv->time);
-   fftw_execute (pv->plan); /* FFT: time[] -> freq[] */
-   for (i = 0; i < pv->len; i ++)
+   if (c != NULL)
    {
-      f_right [i] = pv->freq [i];
+      c->frame = frame;
+      c->flag_window = pv->flag_window;
+      c->used = ++ pv->cache_clock;
+      memcpy (c->left,  f_left,  sizeof (double) * pv->spec_len);
+      memcpy (c->right, f_right, sizeof (double) * pv->spec_len);
    }
 
    return (status);
 }
 
 /* the results are stored in out [i] for i = hop_syn to (hop_syn + len)
+ * f[pv->spec_len] is the spectrum in the layout given by pv->flag_r2c
  * INPUT
  *  scale : for safety (give 0.5, for example)
  */
@@ -224,22 +501,44 @@ void
 apply_invFFT_mono (struct pv_complex * pv,
                    const double * f, double scale,
                    double * out)
+{
+   apply_invFFT_mono_r (pv, f, scale, pv->f_out, pv->t_out, out);
+}
+
+/* apply_invFFT_mono() on the work arrays of the caller, so that
+ * two threads may run it at once with the plan pv->plan_inv.
+ * INPUT
+ *  f_out[CX_LENGTH (pv->len)], t_out[pv->len] : allocated by fftw_malloc()
+ */
+void
+apply_invFFT_mono_r (struct pv_complex * pv,
+                     const double * f, double scale,
+                     double * f_out, double * t_out,
+                     double * out)
 {
    int i;
 
    /* scale */
-   for (i = 0; i < pv->len; i ++)
+   for (i = 0; i < pv->spec_len; i ++)
+   {
+      f_out [i] = f [i];
+   }
+   /* iFFT: f_out[] -> t_out[] */
+   if (pv->flag_r2c == 0)
+   {
+      fftw_execute_r2r (pv->plan_inv, f_out, t_out);
+   }
+   else
    {
-      pv->f_out [i] = f [i];
+      fftw_execute_dft_c2r (pv->plan_inv, (fftw_complex *)f_out, t_out);
    }
-   fftw_execute (pv->plan_inv); /* iFFT: f_out[] -> t_out[] */
    /* scale by len and windowing */
-   windowing (pv->len, pv->t_out, pv->flag_window, (double)pv->len * scale,
-              pv->t_out);
+   windowing (pv->len, t_out, pv->flag_window, (double)pv->len * scale,
+              t_out);
    /* superimpose */
    for (i = 0; i < pv->len; i ++)
    {
-      out [pv->hop_syn + i] += pv->t_out [i];
+      out [pv->hop_syn + i] += t_out [i];
    }
 }
 
@@ -259,80 +558,119 @@ check_zero (int n, const double * x)
    return 0;
 }
 
-
-/* resample pv->[rl]_out[i] for i = 0 to pv->hop_syn
- *       to [left,right][i] for i = 0 to pv->hop_res
+/* the synthesis spectrum of one channel for one hop
  * INPUT
+ *  fs[spec_len], ft[spec_len] : spectra at s_i and t_i
+ *  flag : whether f_old[] is ready (1) or not (0)
+ *  f_old[spec_len] : Y[u_{i-1}], or Z[u_{i-1}] with the phase lock
+ *  pv->flag_lock : 0 == no phase lock
+ *                  1 == loose phase lock
  * OUTPUT
+ *  y[spec_len] : Y[u_i], to be superimposed by apply_invFFT_mono()
+ *  f_old[spec_len] : backed up for the next step
+ *  returned value : 1 if y[] is made,
+ *                   0 if the channel is silent at s_i or t_i
  */
-void
-pv_complex_resample (struct pv_complex * pv,
-                     double * left, double * right)
+int
+pv_complex_channel_vocoder (struct pv_complex * pv,
+                            const double * fs, const double * ft,
+                            int * flag, double * f_old,
+                            double * y)
 {
-   /* samplerate conversion */
-   SRC_DATA srdata;
-   static float * fl_in  = NULL;
-   static float * fl_out = NULL;
-   static int hop_syn0 = 0;
-   static int hop_res0 = 0;
    int i;
-   int status;
-   if (fl_in == NULL)
+
+   /* check zero */
+   if (check_zero (pv->spec_len, fs) == 0 ||
+         check_zero (pv->spec_len, ft) == 0)
    {
-      fl_in  = (float *)malloc (sizeof (float) * 2 * pv->hop_syn);
-      fl_out = (float *)malloc (sizeof (float) * 2 * pv->hop_res);
-      CHECK_MALLOC (fl_in,  "pv_complex_resample");
-      CHECK_MALLOC (fl_out, "pv_complex_resample");
-      hop_syn0 = pv->hop_syn;
-      hop_res0 = pv->hop_res;
+      return 0; /* inactive */
    }
-   else
+
+   /* check f_old[] */
+   if (*flag == 0)
    {
-      if (hop_syn0 < pv->hop_syn)
+      if (pv->flag_lock == 0) /* no phase lock */
       {
-         fl_in = (float *)realloc (fl_in, sizeof (float) * 2 * pv->hop_syn);
-         CHECK_MALLOC (fl_in,  "pv_complex_resample");
-         hop_syn0 = pv->hop_syn;
+         for (i = 0; i < pv->spec_len; i ++)
+         {
+            f_old [i] = fs [i];
+         }
       }
-      if (hop_res0 < pv->hop_res)
+      else /* loose phase lock */
       {
-         fl_out =
-            (float *)realloc (fl_out, sizeof (float) * 2 * pv->hop_res);
-         CHECK_MALLOC (fl_out, "pv_complex_resample");
-         hop_res0 = pv->hop_res;
+         /* apply loose phase lock */
+         pv_complex_puckette_lock (pv, fs, f_old);
       }
+      *flag = 1;
    }
 
-   srdata.input_frames  = pv->hop_syn;
-   srdata.output_frames = pv->hop_res;
-   srdata.src_ratio = (double)(pv->hop_res) / (double)(pv->hop_syn);
-   srdata.data_in  = fl_in;
-   srdata.data_out = fl_out;
-
-   /* samplerate conversion (time fixed) */
-
-   for (i = 0; i < pv->hop_syn; i ++)
+   /* generate the frame (out_0 + (n+1) * hop_syn), that is, "u_i" */
+   if (pv->flag_lock == 0) /* no phase lock */
+   {
+      /* Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]| */
+      pv_complex_phase_vocoder (pv, fs, ft, f_old, y);
+      /* back up for the next step */
+      for (i = 0; i < pv->spec_len; i ++)
+      {
+         f_old [i] = y [i];
+      }
+   }
+   else /* loose phase lock */
    {
-      fl_in [i * 2 + 0] = (float)(pv->l_out [i]);
-      fl_in [i * 2 + 1] = (float)(pv->r_out [i]);
+      /* Y[u_i] = X[t_i] (Z[u_{i-1}]/X[s_i]) / |Z[u_{i-1}]/X[s_i]| */
+      pv_complex_phase_vocoder (pv, fs, ft, f_old, y);
+      /* apply loose phase lock and store for the next step */
+      pv_complex_puckette_lock (pv, y, f_old);
    }
 
-   /*status = src_simple (&srdata, SRC_SINC_BEST_QUALITY, 2); */
-
-   status = src_simple (&srdata, SRC_SINC_FASTEST, 2);
+   return 1; /* active */
+}
 
-   /* this works better */
 
-   if (status != 0)
+/* select the converter for the pitch-shift (and reset its state)
+ * INPUT
+ *  quality : converter type of libsamplerate, from
+ *            SRC_SINC_BEST_QUALITY (0) to SRC_LINEAR (4)
+ * OUTPUT
+ *  returned value : 1 on success, 0 if quality is not a converter
+ */
+int
+pv_complex_set_resample_quality (struct pv_complex * pv, int quality)
+{
+   if (src_get_name (quality) == NULL)
    {
-      fprintf (stderr, "fail to samplerate conversion\n");
-      exit (1);
+      return 0;
+   }
+   if (pv->resample != NULL)
+   {
+      pv_resample_free (pv->resample); /* made again by the next hop */
+      pv->resample = NULL;
    }
+   pv->src_quality = quality;
+   return 1;
+}
 
-   for (i = 0; i < pv->hop_res; i ++)
+/* resample pv->[rl]_out[i] for i = 0 to pv->hop_syn
+ *       to [left,right][i] for i = 0 to pv->hop_res
+ * by pv_resample_hop() (see pv-resample.h): the converter streams from
+ * hop to hop, and it is primed by silence once, when it is made, so
+ * that the output is late by a fixed latency and no hop is padded.
+ * INPUT
+ * OUTPUT
+ */
+void
+pv_complex_resample (struct pv_complex * pv,
+                     double * left, double * right)
+{
+   if (pv->resample == NULL)
    {
-      left [i]  = (double)(fl_out [i * 2 + 0]);
-      right [i] = (double)(fl_out [i * 2 + 1]);
+      pv->resample = pv_resample_new (pv->src_quality);
+      CHECK_MALLOC (pv->resample, "pv_complex_resample");
+   }
+   if (pv_resample_hop (pv->resample, pv->l_out, pv->r_out, pv->hop_syn,
+                        left, right, pv->hop_res) < 0)
+   {
+      exit (1); /* with the message of pv_resample_hop() */
    }
 }
 
@@ -346,7 +684,12 @@ pv_complex_play (struct pv_complex * pv,
                  int n, double * l, double * r)
 {
    int status = 0;
-   if (pv->flag_out == 0)
+   if (pv->flag_out == 0 && pv->aoq != NULL)
+   {
+      status = ao_queue_write (pv->aoq, l, r, n);
+      status /= 4; /* 2 bytes for 2 channels */
+   }
+   else if (pv->flag_out == 0)
    {
       status = ao_write (pv->ao, l, r, n);
       status /= 4; /* 2 bytes for 2 channels */
@@ -378,30 +721,19 @@ pv_complex_play_resample (struct pv_complex * pv)
    if (pv->hop_syn != pv->hop_res)
    {
       /* samplerate conversion */
-      static double * l_resamp = NULL;
-      static double * r_resamp = NULL;
-      static int hop_res0 = 0;
-      if (l_resamp == NULL)
+      if (pv->res_len < pv->hop_res)
       {
-         l_resamp = (double *)malloc (sizeof (double) * pv->hop_res);
-         r_resamp = (double *)malloc (sizeof (double) * pv->hop_res);
-         CHECK_MALLOC (l_resamp, "pv_complex_play_resample");
-         CHECK_MALLOC (r_resamp, "pv_complex_play_resample");
-         hop_res0 = pv->hop_res;
-      }
-      else if (hop_res0 < pv->hop_res)
-      {
-         l_resamp =
-            (double *)realloc (l_resamp, sizeof (double) * pv->hop_res);
-         r_resamp =
-            (double *)realloc (r_resamp, sizeof (double) * pv->hop_res);
-         CHECK_MALLOC (l_resamp, "pv_complex_play_resample");
-         CHECK_MALLOC (r_resamp, "pv_complex_play_resample");
-         hop_res0 = pv->hop_res;
+         pv->l_res =
+            (double *)realloc (pv->l_res, sizeof (double) * pv->hop_res);
+         pv->r_res =
+            (double *)realloc (pv->r_res, sizeof (double) * pv->hop_res);
+         CHECK_MALLOC (pv->l_res, "pv_complex_play_resample");
+         CHECK_MALLOC (pv->r_res, "pv_complex_play_resample");
+         pv->res_len = pv->hop_res;
       }
 
-      pv_complex_resample (pv, l_resamp, r_resamp);
-      status = pv_complex_play (pv, pv->hop_res, l_resamp, r_resamp);
+      pv_complex_resample (pv, pv->l_res, pv->r_res);
+      status = pv_complex_play (pv, pv->hop_res, pv->l_res, pv->r_res);
    }
    else
    {
@@ -412,7 +744,30 @@ pv_complex_play_resample (struct pv_complex * pv)
 }
 
 
-/* play one hop_syn by the phase vocoder:
+/* check whether the next hop can be played without waiting for the
+ * device (see pv_complex_set_output_ao_queue())
+ * OUTPUT
+ *  returned value : 0 if pv->aoq has no room for hop_res frames,
+ *                   1 otherwise (and always without a queue)
+ */
+int
+pv_complex_play_ready (struct pv_complex * pv)
+{
+   if (pv->flag_out != 0 || pv->aoq == NULL)
+   {
+      return 1;
+   }
+   /* a hop longer than the whole queue goes once the queue is empty */
+   if (ao_queue_space (pv->aoq) >= pv->hop_res ||
+       ao_queue_depth (pv->aoq) == 0)
+   {
+      return 1;
+   }
+   return 0;
+}
+
+
+/* make one hop_syn by the phase vocoder, without playing it:
  * phase vocoder by complex arithmetics with fixed hops.
  *   t_i - s_i = u_i - u_{i-1} = hop
  *   where s_i and t_i are the times for two analysis FFT
@@ -424,63 +779,23 @@ pv_complex_play_resample (struct pv_complex * pv)
  *        you have to increment this by yourself.
  *  pv->flag_lock : 0 == no phase lock
  *                  1 == loose phase lock
- * OUTPUT (returned value)
- *  status : output frames (should be hop_res)
+ * OUTPUT
+ *  pv->[lr]_out[0, hop_syn] : the frames to play, before the shift
+ *                             by pv_complex_shift_out()
+ *  returned value : pv->len on success, otherwise the status of
+ *                   read_and_FFT_stereo() (nothing is made then)
  */
 long
-pv_complex_play_step (struct pv_complex * pv,
-                      long cur)
+pv_complex_synth_step (struct pv_complex * pv,
+                       long cur)
 {
-   static int len = 0;
-   static double * l_fs  = NULL;
-   static double * r_fs  = NULL;
-   static double * l_ft  = NULL;
-   static double * r_ft  = NULL;
-   static double * l_tmp = NULL;
-   static double * r_tmp = NULL;
+   double * l_fs  = pv->l_fs;
+   double * r_fs  = pv->r_fs;
+   double * l_ft  = pv->l_ft;
+   double * r_ft  = pv->r_ft;
+   double * l_tmp = pv->l_tmp;
+   double * r_tmp = pv->r_tmp;
    long status;
-   int flag_left_cur;
-   int flag_right_cur;
-   int i;
-
-   if (l_fs == NULL)
-   {
-      l_fs = (double *)malloc (pv->len * sizeof (double));
-      r_fs = (double *)malloc (pv->len * sizeof (double));
-      CHECK_MALLOC (l_fs, "pv_complex_play_step");
-      CHECK_MALLOC (r_fs, "pv_complex_play_step");
-
-      l_ft = (double *)malloc (pv->len * sizeof (double));
-      r_ft = (double *)malloc (pv->len * sizeof (double));
-      CHECK_MALLOC (l_ft, "pv_complex_play_step");
-      CHECK_MALLOC (r_ft, "pv_complex_play_step");
-
-      l_tmp = (double *)malloc (pv->len * sizeof (double));
-      r_tmp = (double *)malloc (pv->len * sizeof (double));
-      CHECK_MALLOC (l_tmp, "pv_complex_play_step");
-      CHECK_MALLOC (r_tmp, "pv_complex_play_step");
-
-      len = pv->len;
-   }
-   else if (len < pv->len)
-   {
-      l_fs = (double *)realloc (l_fs, pv->len * sizeof (double));
-      r_fs = (double *)realloc (r_fs, pv->len * sizeof (double));
-      CHECK_MALLOC (l_fs, "pv_complex_play_step");
-      CHECK_MALLOC (r_fs, "pv_complex_play_step");
-
-      l_ft = (double *)realloc (l_ft, pv->len * sizeof (double));
-      r_ft = (double *)realloc (r_ft, pv->len * sizeof (double));
-      CHECK_MALLOC (l_ft, "pv_complex_play_step");
-      CHECK_MALLOC (r_ft, "pv_complex_play_step");
-
-      l_tmp = (double *)realloc (l_tmp, pv->len * sizeof (double));
-      r_tmp = (double *)realloc (r_tmp, pv->len * sizeof (double));
-      CHECK_MALLOC (l_tmp, "pv_complex_play_step");
-      CHECK_MALLOC (r_tmp, "pv_complex_play_step");
-
-      len = pv->len;
-   }
 
    /* read starting data [cur, cur + len]
     * ==> FFT ==> fs[len]
@@ -488,7 +803,7 @@ pv_complex_play_step (struct pv_complex * pv,
    status = read_and_FFT_stereo (pv, cur, l_fs, r_fs);
    if (status != pv->len)
    {
-      return 0; /* no output */
+      return (status); /* no output */
    }
 
    /* read terminal data [cur + hop_syn, cur + hop_syn + len]
@@ -497,129 +812,33 @@ pv_complex_play_step (struct pv_complex * pv,
    status = read_and_FFT_stereo (pv, cur + pv->hop_syn, l_ft, r_ft);
    if (status != pv->len)
    {
-      return 0; /* no output */
-   }
-
-   /* check zero */
-   if (check_zero (pv->len, l_fs) == 0 ||
-         check_zero (pv->len, l_ft) == 0)
-   {
-      flag_left_cur = 0; /* inactive */
-   }
-   else
-   {
-      flag_left_cur = 1; /* active */
-   }
-   if (check_zero (pv->len, r_fs) == 0 ||
-         check_zero (pv->len, r_ft) == 0)
-   {
-      flag_right_cur = 0; /* inactive */
+      return (status); /* no output */
    }
-   else
-   {
-      flag_right_cur = 1; /* active */
-   }
-
 
    /* phase vocoder process
     * fs[len] and ft[len] ==> superimposing out[hop_syn, hop_syn + len]
     */
-   /* left channel */
-   if (flag_left_cur == 1)
+   if (pv_complex_channel_vocoder (pv, l_fs, l_ft,
+                                   &pv->flag_left, pv->l_f_old, l_tmp) == 1)
    {
-      /* check l_f_old[] */
-      if (pv->flag_left == 0)
-      {
-         if (pv->flag_lock == 0) /* no phase lock */
-         {
-            for (i = 0; i < pv->len; i ++)
-            {
-               pv->l_f_old [i] = l_fs [i];
-            }
-         }
-         else /* loose phase lock */
-         {
-            /* apply loose phase lock */
-            HC_puckette_lock (pv->len, l_fs, pv->l_f_old);
-         }
-
-         pv->flag_left = 1;
-      }
-
-      /* generate the frame (out_0 + (n+1) * hop_syn), that is, "u_i" */
-      if (pv->flag_lock == 0) /* no phase lock */
-      {
-         /* Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, l_fs, l_ft, pv->l_f_old,
-                                   pv->l_f_old);
-         /* already backed up for the next step in [lr]_f_old[] */
-         apply_invFFT_mono (pv, pv->l_f_old, pv->window_scale, pv->l_out);
-      }
-      else /* loose phase lock */
-      {
-         /* Y[u_i] = X[t_i] (Z[u_{i-1}]/X[s_i]) / |Z[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, l_fs, l_ft, pv->l_f_old,
-                                   l_tmp);
-         /* apply loose phase lock and store for the next step */
-         HC_puckette_lock (pv->len, l_tmp, pv->l_f_old);
-
-         apply_invFFT_mono (pv, l_tmp, pv->window_scale, pv->l_out);
-      }
+      apply_invFFT_mono (pv, l_tmp, pv->window_scale, pv->l_out);
    }
-
-
-   /* right channel */
-   if (flag_right_cur == 1)
+   if (pv_complex_channel_vocoder (pv, r_fs, r_ft,
+                                   &pv->flag_right, pv->r_f_old, r_tmp) == 1)
    {
-      /* check l_f_old[] */
-      if (pv->flag_right == 0)
-      {
-         if (pv->flag_lock == 0) /* no phase lock */
-         {
-            for (i = 0; i < pv->len; i ++)
-            {
-               pv->r_f_old [i] = r_fs [i];
-            }
-         }
-         else /* loose phase lock */
-         {
-            /* apply loose phase lock */
-            HC_puckette_lock (pv->len, r_fs, pv->r_f_old);
-         }
-         pv->flag_right = 1;
-      }
-
-      /* generate the frame (out_0 + (n+1) * hop_syn), that is, "u_i" */
-      if (pv->flag_lock == 0) /* no phase lock */
-      {
-         /* Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, r_fs, r_ft, pv->r_f_old,
-                                   pv->r_f_old);
-         /* already backed up for the next step in [lr]_f_old[] */
-         apply_invFFT_mono (pv, pv->r_f_old, pv->window_scale, pv->r_out);
-      }
-      else /* loose phase lock */
-      {
-         /* Y[u_i] = X[t_i] (Z[u_{i-1}]/X[s_i]) / |Z[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, r_fs, r_ft, pv->r_f_old,
-                                   r_tmp);
-         /* apply loose phase lock and store for the next step */
-         HC_puckette_lock (pv->len, r_tmp, pv->r_f_old);
-
-         apply_invFFT_mono (pv, r_tmp, pv->window_scale, pv->r_out);
-      }
+      apply_invFFT_mono (pv, r_tmp, pv->window_scale, pv->r_out);
    }
 
+   return (status);
+}
 
-   /* output
-    * out[0, hop_syn] ==> resample into hop_res ==> ao derive or snd file
-    */
-   status = pv_complex_play_resample (pv);
-
-
-   /* shift
-    * out[hop_syn, hop_syn + len] ==> out[0, len]
-    */
+/* shift
+ * out[hop_syn, hop_syn + len] ==> out[0, len]
+ */
+void
+pv_complex_shift_out (struct pv_complex * pv)
+{
+   int i;
    for (i = 0; i < pv->len; i ++)
    {
       pv->l_out [i] = pv->l_out [i + pv->hop_syn];
@@ -630,6 +849,40 @@ pv_complex_play_step (struct pv_complex * pv,
       pv->l_out [i] = 0.0;
       pv->r_out [i] = 0.0;
    }
+}
+
+/* play one hop_syn by the phase vocoder:
+ * phase vocoder by complex arithmetics with fixed hops.
+ *   t_i - s_i = u_i - u_{i-1} = hop
+ *   where s_i and t_i are the times for two analysis FFT
+ *   and u_i is the time for the synthesis FFT at step i
+ * Reference: M.Puckette (1995)
+ * INPUT
+ *  pv : struct pv_complex
+ *  cur : current frame to play.
+ *        you have to increment this by yourself.
+ *  pv->flag_lock : 0 == no phase lock
+ *                  1 == loose phase lock
+ * OUTPUT (returned value)
+ *  status : output frames (should be hop_res)
+ */
+long
+pv_complex_play_step (struct pv_complex * pv,
+                      long cur)
+{
+   long status;
+
+   if (pv_complex_synth_step (pv, cur) != pv->len)
+   {
+      return 0; /* no output */
+   }
+
+   /* output
+    * out[0, hop_syn] ==> resample into hop_res ==> ao derive or snd file
+    */
+   status = pv_complex_play_resample (pv);
+
+   pv_complex_shift_out (pv);
 
    return (status);
 }
@@ -646,6 +899,11 @@ pv_complex_play_step (struct pv_complex * pv,
  * INPUT
  *  flag_lock : 0 == no phase lock is applied
  *              1 == loose phase lock is applied
+ *  flag_r2c : 0 == half-complex FFT layout
+ *             1 == interleaved complex (r2c) FFT layout
+ *  src_quality : converter type of libsamplerate for the pitch-shift
+ *  flag_threads : 0 == one thread
+ *                 1 == pipeline of threads by pv_render() (outfile only)
  *  rate : time-streching rate
  *  pitch_shift : in the unit of half-note
  */
@@ -653,7 +911,10 @@ void pv_complex (const char * file, const char * outfile,
                  double rate, double pitch_shift,
                  long len, long hop_syn,
                  int flag_window,
-                 int flag_lock)
+                 int flag_lock,
+                 int flag_r2c,
+                 int src_quality,
+                 int flag_threads)
 {
    long hop_res = (long)((double)hop_syn * pow (2.0, - pitch_shift / 12.0));
    long hop_ana = (long)((double)hop_res * rate);
@@ -665,6 +926,7 @@ void pv_complex (const char * file, const char * outfile,
    SF_INFO sfout_info;
    ao_device * ao = NULL;
 
+   CHECK_MALLOC (pv, "pv_complex");
    pv->hop_res = hop_res;
    pv->hop_ana = hop_ana;
 
@@ -702,13 +964,28 @@ void pv_complex (const char * file, const char * outfile,
       pv_complex_set_output_sf (pv, sfout, &sfout_info);
    }
    pv->flag_lock = flag_lock;
+   pv_complex_set_r2c (pv, flag_r2c);
+   if (pv_complex_set_resample_quality (pv, src_quality) == 0)
+   {
+      fprintf (stderr, "invalid samplerate converter %d\n", src_quality);
+      exit (1);
+   }
 
-   for (cur = 0; cur < (long)sfinfo.frames; cur += pv->hop_ana)
+   if (outfile != NULL && flag_threads != 0
+       && pv_render (pv, (long)sfinfo.frames) >= 0)
+   {
+      /* rendered by the threads */
+   }
+   else
    {
-      long len_play = pv_complex_play_step (pv, cur);
-      if (len_play < pv->hop_res)
+      /* one thread, also if the threads of pv_render() cannot start */
+      for (cur = 0; cur < (long)sfinfo.frames; cur += pv->hop_ana)
       {
-         break;
+         long len_play = pv_complex_play_step (pv, cur);
+         if (len_play < pv->hop_res)
+         {
+            break;
+         }
       }
    }
 
@@ -725,11 +1002,142 @@ void pv_complex (const char * file, const char * outfile,
       sf_write_sync (sfout);
       sf_close (sfout);
    }
+   fprintf (stderr, "spectrum cache: %lu hits, %lu misses (%.1f %%)\n",
+            pv->cache_hits, pv->cache_misses,
+            pv_complex_cache_hit_rate (pv));
 
    pv_complex_free (pv);
    sf_close (sf) ;
 }
 
+
+/** the engine interface (see pv-engine.h) **/
+
+struct pv_complex_engine_state
+{
+   struct pv_complex * pv;
+   long cur; /* starting frame of the next hop */
+};
+
+static void *
+pv_complex_engine_init (const pv_engine_params_t * params,
+                        pv_engine_shape_t * shape)
+{
+   struct pv_complex_engine_state * st;
+   struct pv_complex * pv = pv_complex_init (params->len, params->hop_syn,
+                                             params->flag_window);
+   if (pv == NULL)
+   {
+      return (NULL);
+   }
+
+   pv_complex_change_rate_pitch (pv, params->rate, params->pitch_shift);
+   if (pv->hop_ana <= 0 || pv->hop_res <= 0)
+   {
+      /* backward play needs the whole input, and a hop of 0 never ends */
+      pv_complex_free (pv);
+      return (NULL);
+   }
+   pv_complex_set_r2c (pv, params->flag_r2c);
+   pv->flag_lock = params->flag_lock;
+
+   st = (struct pv_complex_engine_state *)
+      malloc (sizeof (struct pv_complex_engine_state));
+   if (st == NULL)
+   {
+      pv_complex_free (pv);
+      return (NULL);
+   }
+   st->pv = pv;
+   st->cur = 0;
+
+   shape->block   = pv->hop_syn;
+   shape->hop_res = pv->hop_res;
+   shape->tail    = pv->len;
+   return (st);
+}
+
+static void *
+pv_complex_lock_engine_init (const pv_engine_params_t * params,
+                             pv_engine_shape_t * shape)
+{
+   pv_engine_params_t p = *params;
+   p.flag_lock = 1;
+   return (pv_complex_engine_init (&p, shape));
+}
+
+static long
+pv_complex_engine_process_block (void * state,
+                                 pv_engine_input_t * in,
+                                 double * left, double * right)
+{
+   struct pv_complex_engine_state * st
+      = (struct pv_complex_engine_state *)state;
+   struct pv_complex * pv = st->pv;
+   long status;
+
+   pv->input = in;
+   status = pv_complex_synth_step (pv, st->cur);
+   pv->input = NULL;
+   if (status == PV_ENGINE_MORE)
+   {
+      return (PV_ENGINE_MORE);
+   }
+   else if (status != pv->len)
+   {
+      return (PV_ENGINE_END);
+   }
+
+   memcpy (left,  pv->l_out, sizeof (double) * pv->hop_syn);
+   memcpy (right, pv->r_out, sizeof (double) * pv->hop_syn);
+   pv_complex_shift_out (pv);
+
+   st->cur += pv->hop_ana;
+   in->keep = st->cur;
+   return (pv->hop_syn);
+}
+
+static long
+pv_complex_engine_flush (void * state,
+                         double * left, double * right)
+{
+   struct pv_complex * pv = ((struct pv_complex_engine_state *)state)->pv;
+
+   /* frames left in l_out[] and r_out[] */
+   memcpy (left,  pv->l_out, sizeof (double) * pv->len);
+   memcpy (right, pv->r_out, sizeof (double) * pv->len);
+   return (pv->len);
+}
+
+static void
+pv_complex_engine_free (void * state)
+{
+   struct pv_complex_engine_state * st
+      = (struct pv_complex_engine_state *)state;
+   pv_complex_free (st->pv);
+   free (st);
+}
+
+const pv_engine_ops_t pv_complex_engine =
+{
+   "complex",
+   "PV by complex arithmetics with fixed hops",
+   pv_complex_engine_init,
+   pv_complex_engine_process_block,
+   pv_complex_engine_flush,
+   pv_complex_engine_free
+};
+
+const pv_engine_ops_t pv_complex_lock_engine =
+{
+   "complex-lock",
+   "Puckette's loose-locking PV by complex arithmetics with fixed hops",
+   pv_complex_lock_engine_init,
+   pv_complex_engine_process_block,
+   pv_complex_engine_flush,
+   pv_complex_engine_free
+};
+
 /*
  * pv-complex.c
  *
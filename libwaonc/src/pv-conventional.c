@@ -23,123 +23,49 @@
 
 #include <fftw3.h> /* FFTW library */
 #include "hc.h" /* half-complex format handling routines */
-#include "fft.h" /* windowing() */
+#include "fft.h" /* windowing(), parzen(), ... */
 
-#include <sndfile.h> /* libsndfile */
-#include "snd.h"
+#include <samplerate.h> /* SRC_SINC_BEST_QUALITY */
 
-#include <ao/ao.h> /* ao device */
-#include "ao-wrapper.h"
-
-#include <samplerate.h> /* samplerate */
-
-#include "memory-check.h" /* CHECK_MALLOC() macro */
+#include "pv-engine.h"
 
 
 /** general utility routines for pv **/
 
-/*
- * INPUT
- *  hop_res :
- *  hop_syn :
- *  l_out [hop_syn] :
- *  r_out [hop_syn] :
- *  ao, sfout, sfout_info : properties for output
+/* the value at i of the window flag_window of length len, as made by
+ * windowing() with the scale 1 (and 1 for an invalid window)
  */
-
-int
-pv_play_resample (long hop_res, long hop_syn,
-                  double * l_out, double * r_out,
-                  ao_device * ao, SNDFILE * sfout, SF_INFO * sfout_info)
+static double
+window_value (int i, int len, int flag_window)
 {
-   int status;
-   int i;
-
-   /* samplerate conversion */
-
-   float * fl_in  = NULL;
-   float * fl_out = NULL;
-   double * l_out_src = NULL;
-   double * r_out_src = NULL;
-   SRC_DATA srdata;
-
-   if (hop_res != hop_syn)
+   switch (flag_window)
    {
-      fl_in  = (float *)malloc (sizeof (float) * 2 * hop_syn);
-      fl_out = (float *)malloc (sizeof (float) * 2 * hop_res);
-      CHECK_MALLOC (fl_in,  "pv_play_resample");
-      CHECK_MALLOC (fl_out, "pv_play_resample");
-
-      srdata.input_frames  = hop_syn;
-      srdata.output_frames = hop_res;
-      srdata.src_ratio = (double)hop_res / (double)hop_syn;
-      srdata.data_in  = fl_in;
-      srdata.data_out = fl_out;
-
-      l_out_src = (double *)malloc (sizeof (double) * hop_res);
-      r_out_src = (double *)malloc (sizeof (double) * hop_res);
-      CHECK_MALLOC (l_out_src, "pv_play_resample");
-      CHECK_MALLOC (r_out_src, "pv_play_resample");
+   case FILTER_WINDOW_PARZEN:
+      return (parzen (i, len));
 
+   case FILTER_WINDOW_WELCH:
+      return (welch (i, len));
 
-      /* samplerate conversion (time fixed) */
-      for (i = 0; i < hop_syn; i ++)
-      {
-         fl_in [i * 2 + 0] = (float)l_out [i];
-         fl_in [i * 2 + 1] = (float)r_out [i];
-      }
-      status = src_simple (&srdata, SRC_SINC_BEST_QUALITY, 2);
-      /* status = src_simple (&srdata, SRC_SINC_FASTEST, 2); */
-      if (status != 0)
-      {
-         fprintf (stderr, "fail to samplerate conversion\n");
-         exit (1);
-      }
-      for (i = 0; i < hop_res; i ++)
-      {
-         l_out_src [i] = (double)fl_out [i * 2 + 0];
-         r_out_src [i] = (double)fl_out [i * 2 + 1];
-      }
+   case FILTER_WINDOW_HANNING:
+      return (hanning (i, len));
 
-      /* output */
-      if (sfout == NULL)
-      {
-         status = ao_write (ao, l_out_src, r_out_src, hop_res);
-         status /= 4; /* 2 bytes for 2 channels */
-      }
-      else
-      {
-         status = sndfile_write (sfout, *sfout_info,
-                                 l_out_src, r_out_src, hop_res);
-      }
+   case FILTER_WINDOW_HAMMING:
+      return (hamming (i, len));
 
-      free (fl_in);
-      free (fl_out);
+   case FILTER_WINDOW_BLACKMAN:
+      return (blackman (i, len));
 
-      free (l_out_src);
-      free (r_out_src);
-   }
-   else
-   {
-      /*
-       * No samplerate conversion (pitch fixed) output.
-       */
+   case FILTER_WINDOW_STEEPER:
+      return (steeper (i, len));
 
-      if (sfout == NULL)
-      {
-         status = ao_write (ao, l_out, r_out, hop_syn);
-         status /= 4;                  /* 2 bytes for 2 channels */
-      }
-      else
-      {
-         status = sndfile_write (sfout, *sfout_info, l_out, r_out, hop_syn);
-      }
+   default:
+      return (1.0);
    }
-   return status;
 }
 
 /**
  * estimate the superposing weight for the window with hop
+ * (without a work array, so that it never fails)
  */
 
 double
@@ -149,27 +75,20 @@ get_scale_factor_for_window (int len, long hop_syn, int flag_window)
    double acc_max = 0.0;
    int i;
    int j;
-   double * x = (double *) malloc (sizeof (double) * len);
-   CHECK_MALLOC (x, "get_scale_factor_for_window");
-
-   for (i = 0; i < len; i ++)
-   {
-      x [i] = 1.0;
-   }
-   windowing (len, x, flag_window, 1.0, x);
 
    for (j = 0; j < hop_syn; j++)
    {
       acc = 0.0;
       for (i = 0; i < len; i += hop_syn)
       {
-         acc += x [j + i];
+         if (j + i < len)
+         {
+            acc += window_value (j + i, len, flag_window);
+         }
       }
       if (acc_max < acc) acc_max = acc;
    }
 
-   free (x);
-
    acc *= 1.5; /* extra safety */
 
    return acc;
@@ -179,308 +98,335 @@ get_scale_factor_for_window (int len, long hop_syn, int flag_window)
  * Ref: J.Laroche and M.Dolson (1999)
  */
 
-void pv_conventional (const char * file, const char * outfile,
-                      double rate, double pitch_shift,
-                      long len, long hop_syn,
-                      int flag_window)
+struct pv_conventional
 {
-   long hop_res = (long)((double)hop_syn * pow (2.0, - pitch_shift / 12.0));
-   long hop_ana = (long)((double)hop_res * rate);
-   double twopi = 2.0 * M_PI;
-   int i;
-   int k;
-   long read_status; /* open the input file */
-   double * left = NULL;
-   double * right = NULL;
-   SNDFILE * sf = NULL;
-   SF_INFO sfinfo; /* libsndfile version */
+   long len;
+   long hop_syn;
+   long hop_ana;
+   int flag_window;
+   double window_scale;
 
-   /* int status; */
+   double * left;  /* [len], the input frame */
+   double * right; /* [len] */
 
-   ao_device * ao = NULL;
-   SNDFILE * sfout = NULL;
-   SF_INFO sfout_info;
-   double window_scale;
-   double * time = NULL;
-   double * freq = NULL;
-   double * t_out = NULL;
-   double * f_out = NULL;
+   /* both channels in one complex FFT, see apply_FFT_stereo() */
+   double * time;
+   double * freq;
    fftw_plan plan;
-   fftw_plan plan_inv;
-   double * amp = NULL;
-   double * ph_in = NULL;
-   double * l_ph_out = NULL;
-   double * r_ph_out = NULL;
-   double * l_ph_in_old = NULL;
-   double * r_ph_in_old = NULL;
-   double * l_out = NULL;
-   double * r_out = NULL;
-   double * omega = NULL;
-   int flag_ph = 0;
-
-   memset (&sfinfo, 0, sizeof (sfinfo));
-   sf = sf_open (file, SFM_READ, &sfinfo);
-   if (sf == NULL)
-   {
-      fprintf (stderr, "fail to open %s\n", file);
-      exit (1);
-   }
-   sndfile_print_info (&sfinfo);
-
-   /* allocate buffers  */
 
-   left  = (double *) malloc (sizeof (double) * len);
-   right = (double *) malloc (sizeof (double) * len);
-   CHECK_MALLOC (left,  "pv_conventional");
-   CHECK_MALLOC (right, "pv_conventional");
+   double * f_out;
+   double * t_out;
+   fftw_plan plan_inv;
 
-   /* prepare the output */
+   double * amp;
+   double * ph_in;
+   double * r_amp;
+   double * r_ph_in;
+   double * l_ph_out;
+   double * r_ph_out;
+   double * l_ph_in_old;
+   double * r_ph_in_old;
+   double * omega; /* expected frequency */
+
+   double * l_out; /* [hop_syn + len], overlap-add buffers */
+   double * r_out;
+
+   int flag_ph; /* 0 until the phases are initialized */
+   long cur;    /* starting frame of the next hop */
+};
+
+static void
+pv_conventional_engine_free (void * state)
+{
+   struct pv_conventional * pv = (struct pv_conventional *)state;
 
-   if (outfile == NULL)
+   free (pv->left);
+   free (pv->right);
+   if (pv->plan != NULL)
    {
-      ao = ao_init_16_stereo (sfinfo.samplerate, 1 /* verbose */);
+      fftw_destroy_plan (pv->plan);
    }
-   else
+   fftw_free (pv->time);
+   fftw_free (pv->freq);
+   if (pv->plan_inv != NULL)
    {
-      sfout = sndfile_open_for_write (&sfout_info,
-                                      outfile,
-                                      sfinfo.samplerate,
-                                      sfinfo.channels);
-      if (sfout == NULL)
-      {
-         fprintf (stderr, "fail to open file %s\n", outfile);
-         exit (1);
-      }
+      fftw_destroy_plan (pv->plan_inv);
    }
+   fftw_free (pv->t_out);
+   fftw_free (pv->f_out);
+   free (pv->amp);
+   free (pv->ph_in);
+   free (pv->r_amp);
+   free (pv->r_ph_in);
+   free (pv->l_ph_out);
+   free (pv->r_ph_out);
+   free (pv->l_ph_in_old);
+   free (pv->r_ph_in_old);
+   free (pv->l_out);
+   free (pv->r_out);
+   free (pv->omega);
+   free (pv);
+}
 
+static void *
+pv_conventional_engine_init (const pv_engine_params_t * params,
+                             pv_engine_shape_t * shape)
+{
+   struct pv_conventional * pv;
+   long len = params->len;
+   long hop_syn = params->hop_syn;
+   long hop_res = (long)((double)hop_syn
+                         * pow (2.0, - params->pitch_shift / 12.0));
+   long hop_ana = (long)((double)hop_res * params->rate);
+   double twopi = 2.0 * M_PI;
+   int k;
 
-   window_scale = get_scale_factor_for_window (len, hop_syn, flag_window);
-
-   /* initialization plan for FFTW  */
-
-   time = (double *)fftw_malloc (len * sizeof(double));
-   freq = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (time, "pv_conventional");
-   CHECK_MALLOC (freq, "pv_conventional");
-   plan = fftw_plan_r2r_1d (len, time, freq, FFTW_R2HC, FFTW_ESTIMATE);
-
-   f_out = (double *)fftw_malloc (len * sizeof(double));
-   t_out = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (f_out, "pv_conventional");
-   CHECK_MALLOC (t_out, "pv_conventional");
-   /*  fftw_plan plan_inv; */
-   plan_inv = fftw_plan_r2r_1d (len, f_out, t_out,
-                                FFTW_HC2R, FFTW_ESTIMATE);
-
-   amp   = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   ph_in = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (amp,   "pv_conventional");
-   CHECK_MALLOC (ph_in, "pv_conventional");
-
-   l_ph_out    = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_ph_out    = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (l_ph_out, "pv_conventional");
-   CHECK_MALLOC (r_ph_out, "pv_conventional");
-
-   l_ph_in_old = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_ph_in_old = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (l_ph_in_old, "pv_conventional");
-   CHECK_MALLOC (r_ph_in_old, "pv_conventional");
-
-   for (i = 0; i < (len / 2) + 1; i ++)
+   if (hop_res <= 0 || hop_ana <= 0)
    {
-      ph_in [i]  = 0.0;
-      l_ph_out [i] = 0.0;
-      r_ph_out [i] = 0.0;
-      l_ph_in_old [i] = 0.0;
-      r_ph_in_old [i] = 0.0;
+      return (NULL);
    }
 
-   l_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   r_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   CHECK_MALLOC (l_out, "pv_conventional");
-   CHECK_MALLOC (r_out, "pv_conventional");
-   for (i = 0; i < (hop_syn + len); i ++)
+   /* the pointers are NULL until allocated, for the free function */
+   pv = (struct pv_conventional *) calloc (1, sizeof (struct pv_conventional));
+   if (pv == NULL)
    {
-      l_out [i] = 0.0;
-      r_out [i] = 0.0;
+      return (NULL);
    }
-
-   /* expected frequency */
-
-   omega = (double *) malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (omega, "pv_conventional");
-   for (k = 0; k < (len / 2) + 1; k ++)
+   pv->len = len;
+   pv->hop_syn = hop_syn;
+   pv->hop_ana = hop_ana;
+   pv->flag_window = params->flag_window;
+   pv->window_scale = get_scale_factor_for_window (len, hop_syn,
+                                                   params->flag_window);
+
+   pv->left  = (double *) malloc (sizeof (double) * len);
+   pv->right = (double *) malloc (sizeof (double) * len);
+
+   pv->time = (double *)fftw_malloc (2 * len * sizeof(double));
+   pv->freq = (double *)fftw_malloc (2 * len * sizeof(double));
+
+   pv->f_out = (double *)fftw_malloc (len * sizeof(double));
+   pv->t_out = (double *)fftw_malloc (len * sizeof(double));
+
+   pv->amp   = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->ph_in = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_amp   = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_ph_in = (double *)calloc ((len / 2) + 1, sizeof(double));
+
+   pv->l_ph_out = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_ph_out = (double *)calloc ((len / 2) + 1, sizeof(double));
+
+   pv->l_ph_in_old = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_ph_in_old = (double *)calloc ((len / 2) + 1, sizeof(double));
+
+   pv->l_out = (double *) calloc (hop_syn + len, sizeof(double));
+   pv->r_out = (double *) calloc (hop_syn + len, sizeof(double));
+
+   pv->omega = (double *) malloc (((len / 2) + 1) * sizeof(double));
+
+   if (pv->left == NULL || pv->right == NULL ||
+       pv->time == NULL || pv->freq == NULL ||
+       pv->f_out == NULL || pv->t_out == NULL ||
+       pv->amp == NULL || pv->ph_in == NULL ||
+       pv->r_amp == NULL || pv->r_ph_in == NULL ||
+       pv->l_ph_out == NULL || pv->r_ph_out == NULL ||
+       pv->l_ph_in_old == NULL || pv->r_ph_in_old == NULL ||
+       pv->l_out == NULL || pv->r_out == NULL ||
+       pv->omega == NULL)
    {
-      omega [k] = twopi * (double)k / (double)len;
+      pv_conventional_engine_free (pv);
+      return (NULL);
    }
 
-   /* read the first frame */
+   /* initialization plan for FFTW  */
+
+   pv->plan = plan_FFT_stereo (len, pv->time, pv->freq);
+   pv->plan_inv = fftw_plan_r2r_1d (len, pv->f_out, pv->t_out,
+                                    FFTW_HC2R, FFTW_ESTIMATE);
 
-   read_status = sndfile_read (sf, sfinfo, left, right, len);
-   if (read_status != len)
+   for (k = 0; k < (len / 2) + 1; k ++)
    {
-      exit (1);
+      pv->omega [k] = twopi * (double)k / (double)len;
    }
 
-   for (;;)
-   {
-      /* left channel */
-      apply_FFT (len, left, flag_window, plan, time, freq,
-                 1.0,
-                 amp, ph_in);
-      if (flag_ph == 0)
-      {
-         /* initialize phase */
-         for (k = 0; k < (len / 2) + 1; k ++)
-         {
-            l_ph_out [k] = ph_in [k] * (double)hop_syn / (double)hop_ana;
+   pv->flag_ph = 0;
+   pv->cur = 0;
 
-            /* l_ph_out [k] = ph_in [k]; */
+   shape->block   = hop_syn;
+   shape->hop_res = hop_res;
+   shape->tail    = len;
+   return (pv);
+}
 
-            /* backup for the next step */
-            l_ph_in_old [k] = ph_in [k];
-         }
-         /* flag_ph = 1; right channel is in the following! */
-      }
-      else
-      {
-         /* only for imag components who have phase */
-         for (k = 1; k < ((len + 1) / 2); k ++)
-         {
-            double dphi;
-            dphi = ph_in [k] - l_ph_in_old [k]
-                   - omega [k] * (double)hop_ana;
-            for (; dphi >= M_PI; dphi -= twopi);
-            for (; dphi < -M_PI; dphi += twopi);
+/* the phases of one channel for the next hop
+ * INPUT
+ *  ph_in[len/2+1] : the phases of the input frame
+ * OUTPUT
+ *  ph_out[len/2+1], ph_in_old[len/2+1] :
+ */
+static void
+pv_conventional_phase (struct pv_conventional * pv,
+                       const double * ph_in,
+                       double * ph_out, double * ph_in_old)
+{
+   double twopi = 2.0 * M_PI;
+   int k;
 
-            l_ph_out [k] += dphi * (double)hop_syn / (double)hop_ana
-                            + omega [k] * (double)hop_syn;
+   if (pv->flag_ph == 0)
+   {
+      /* initialize phase */
+      for (k = 0; k < (pv->len / 2) + 1; k ++)
+      {
+         ph_out [k] = ph_in [k] * (double)pv->hop_syn / (double)pv->hop_ana;
 
-            l_ph_in_old [k] = ph_in [k];
-         }
+         /* backup for the next step */
+         ph_in_old [k] = ph_in [k];
       }
-      polar_to_HC (len, amp, l_ph_out, 0, f_out);
-      fftw_execute (plan_inv);
-      /* scale by len and windowing */
-      windowing (len, t_out, flag_window, (double)len * window_scale, t_out);
-      /* superimpose */
-      for (i = 0; i < len; i ++)
+   }
+   else
+   {
+      /* only for imag components who have phase */
+      for (k = 1; k < ((pv->len + 1) / 2); k ++)
       {
-         l_out [hop_syn + i] += t_out [i];
-      }
+         double dphi;
+         dphi = ph_in [k] - ph_in_old [k]
+                - pv->omega [k] * (double)pv->hop_ana;
+         for (; dphi >= M_PI; dphi -= twopi);
+         for (; dphi < -M_PI; dphi += twopi);
 
-      /* right channel */
-      apply_FFT (len, right, flag_window, plan, time, freq,
-                 1.0,
-                 amp, ph_in);
-      if (flag_ph == 0)
-      {
-         /* initialize phase */
-         for (k = 0; k < (len / 2) + 1; k ++)
-         {
-            r_ph_out [k] = ph_in [k] * (double)hop_syn / (double)hop_ana;
-            /* r_ph_out [k] = ph_in [k]; */
+         ph_out [k] += dphi * (double)pv->hop_syn / (double)pv->hop_ana
+                       + pv->omega [k] * (double)pv->hop_syn;
 
-            /* backup for the next step */
-            r_ph_in_old [k] = ph_in [k];
-         }
-         flag_ph = 1;
+         ph_in_old [k] = ph_in [k];
       }
-      else
-      {
-         /* only for imag components who have phase */
-         for (k = 1; k < ((len + 1) / 2); k ++)
-         {
-            double dphi;
-            dphi = ph_in [k] - r_ph_in_old [k]
-                   - omega [k] * (double)hop_ana;
-            for (; dphi >= M_PI; dphi -= twopi);
-            for (; dphi < -M_PI; dphi += twopi);
+   }
+}
 
-            r_ph_out [k] += dphi * (double)hop_syn / (double)hop_ana
-                            + omega [k] * (double)hop_syn;
+/* synthesize one channel and superimpose it on out[hop_syn, hop_syn + len]
+ */
+static void
+pv_conventional_synth (struct pv_conventional * pv,
+                       const double * amp, const double * ph_out,
+                       double * out)
+{
+   int i;
 
-            r_ph_in_old [k] = ph_in [k];
-         }
-      }
-      polar_to_HC (len, amp, r_ph_out, 0, f_out);
-      fftw_execute (plan_inv);
-      /* scale by len and windowing */
-      /* windowing (len, t_out, flag_window, (double)len, t_out); */
-      windowing (len, t_out, flag_window, (double)len * window_scale, t_out);
-      /* superimpose */
-      for (i = 0; i < len; i ++)
-      {
-         r_out [hop_syn + i] += t_out [i];
-      }
+   polar_to_HC (pv->len, amp, ph_out, 0, pv->f_out);
+   fftw_execute (pv->plan_inv);
+   /* scale by len and windowing */
+   windowing (pv->len, pv->t_out, pv->flag_window,
+              (double)pv->len * pv->window_scale, pv->t_out);
+   /* superimpose */
+   for (i = 0; i < pv->len; i ++)
+   {
+      out [pv->hop_syn + i] += pv->t_out [i];
+   }
+}
 
+/* one hop_syn of the output, see pv-engine.h
+ * the last frame is the last one that fits in the input completely.
+ */
+static long
+pv_conventional_engine_process_block (void * state,
+                                      pv_engine_input_t * in,
+                                      double * left, double * right)
+{
+   struct pv_conventional * pv = (struct pv_conventional *)state;
+   long status;
+   int i;
 
-      /* output */
-      /* status = */ pv_play_resample (hop_res, hop_syn, l_out, r_out,
-                                 ao, sfout, &sfout_info);
+   status = pv_engine_input_read_at (in, pv->cur,
+                                     pv->left, pv->right, pv->len);
+   if (status == PV_ENGINE_MORE)
+   {
+      return (PV_ENGINE_MORE);
+   }
+   else if (status != pv->len)
+   {
+      /* most likely, it is EOF. */
+      return (PV_ENGINE_END);
+   }
 
+   apply_FFT_stereo (pv->len, pv->left, pv->right, pv->flag_window,
+                     pv->plan, pv->time, pv->freq,
+                     1.0,
+                     pv->amp, pv->ph_in, pv->r_amp, pv->r_ph_in);
 
-      /* shift acc_out by hop_syn */
-      for (i = 0; i < len; i ++)
-      {
-         l_out [i] = l_out [i + hop_syn];
-         r_out [i] = r_out [i + hop_syn];
-      }
-      for (i = len; i < len + hop_syn; i ++)
-      {
-         l_out [i] = 0.0;
-         r_out [i] = 0.0;
-      }
+   /* left channel */
+   pv_conventional_phase (pv, pv->ph_in, pv->l_ph_out, pv->l_ph_in_old);
+   pv_conventional_synth (pv, pv->amp, pv->l_ph_out, pv->l_out);
 
+   /* right channel */
+   pv_conventional_phase (pv, pv->r_ph_in, pv->r_ph_out, pv->r_ph_in_old);
+   pv_conventional_synth (pv, pv->r_amp, pv->r_ph_out, pv->r_out);
+   pv->flag_ph = 1;
 
-      /* for the next step */
-      for (i = 0; i < (len - hop_ana); i ++)
-      {
-         left  [i] = left  [i + hop_ana];
-         right [i] = right [i + hop_ana];
-      }
+   /* output */
+   memcpy (left,  pv->l_out, sizeof (double) * pv->hop_syn);
+   memcpy (right, pv->r_out, sizeof (double) * pv->hop_syn);
 
-      /* read next segment */
-      read_status = sndfile_read (sf, sfinfo,
-                                  left  + len - hop_ana,
-                                  right + len - hop_ana,
-                                  hop_ana);
-      if (read_status != hop_ana)
-      {
-         /* most likely, it is EOF. */
-         break;
-      }
-   }
-   sf_close (sf);
-   if (outfile == NULL)
+   /* shift acc_out by hop_syn */
+   for (i = 0; i < pv->len; i ++)
    {
-      ao_close (ao);
+      pv->l_out [i] = pv->l_out [i + pv->hop_syn];
+      pv->r_out [i] = pv->r_out [i + pv->hop_syn];
    }
-   else
+   for (i = pv->len; i < pv->len + pv->hop_syn; i ++)
    {
-      /* frames left in l_out[] and r_out[] */
-      /* status = */ sndfile_write (sfout, sfout_info, l_out, r_out, len);
-      sf_write_sync (sfout);
-      sf_close (sfout);
+      pv->l_out [i] = 0.0;
+      pv->r_out [i] = 0.0;
    }
-   free (left);
-   free (right);
-   free (time);
-   free (freq);
-   fftw_destroy_plan (plan);
-   free (t_out);
-   free (f_out);
-   fftw_destroy_plan (plan_inv);
-   free (amp);
-   free (ph_in);
-   free (l_ph_out);
-   free (r_ph_out);
-   free (l_ph_in_old);
-   free (r_ph_in_old);
-   free (l_out);
-   free (r_out);
-   free (omega);
+
+   /* for the next step */
+   pv->cur += pv->hop_ana;
+   in->keep = pv->cur;
+   return (pv->hop_syn);
+}
+
+static long
+pv_conventional_engine_flush (void * state,
+                              double * left, double * right)
+{
+   struct pv_conventional * pv = (struct pv_conventional *)state;
+
+   /* frames left in l_out[] and r_out[] */
+   memcpy (left,  pv->l_out, sizeof (double) * pv->len);
+   memcpy (right, pv->r_out, sizeof (double) * pv->len);
+   return (pv->len);
+}
+
+const pv_engine_ops_t pv_conventional_engine =
+{
+   "conventional",
+   "standard PV (Laroche and Dolson, 1999)",
+   pv_conventional_engine_init,
+   pv_conventional_engine_process_block,
+   pv_conventional_engine_flush,
+   pv_conventional_engine_free
+};
+
+/* play or write the file through pv_conventional_engine
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
+ */
+int
+pv_conventional (const char * file, const char * outfile,
+                 double rate, double pitch_shift,
+                 long len, long hop_syn,
+                 int flag_window)
+{
+   pv_engine_params_t params;
+
+   pv_engine_params_init (&params);
+   params.len = len;
+   params.hop_syn = hop_syn;
+   params.rate = rate;
+   params.pitch_shift = pitch_shift;
+   params.flag_window = flag_window;
+   params.src_quality = SRC_SINC_BEST_QUALITY; /* the best converter */
+
+   return (pv_engine_render_file (&pv_conventional_engine, &params,
+                                  file, outfile));
 }
 
 /*
@@ -22,439 +22,479 @@
 
 #include <fftw3.h> /* FFTW library */
 #include "hc.h" /* half-complex format handling routines */
-#include "fft.h" /* windowing(), apply_FFT() */
-#include <sndfile.h> /* libsndfile */
-#include "snd.h"
+#include "fft.h" /* windowing(), apply_FFT_stereo() */
 
+#include <sndfile.h> /* libsndfile */
 #include <ao/ao.h> /* ao device */
-#include "ao-wrapper.h"
 
-#include "memory-check.h" /* CHECK_MALLOC() macro */
-#include "pv-conventional.h" /* pv_play_resample() */
+#include "pv-conventional.h" /* get_scale_factor_for_window() */
+#include "pv-engine.h"
+
+/* this routine is translated from Matlab script written by D.P.W.Ellis:
+ *   http://www.ee.columbia.edu/~dpwe/resources/matlab/pvoc/
+ */
+
+struct pv_ellis
+{
+   long len;
+   long hop_syn;
+   int flag_window;
+   double corr_rate;
+   double window_scale;
+
+   double * left;  /* [len], the input frame */
+   double * right; /* [len] */
+
+   /* both channels in one complex FFT, see read_and_FFT_stereo() */
+   double * time;
+   double * freq;
+   fftw_plan plan;
+
+   double * f_out;
+   double * t_out;
+   fftw_plan plan_inv;
+
+   double * l_amp; /* the frame nf */
+   double * l_phs;
+   double * r_amp;
+   double * r_phs;
+   double * l_am0; /* the frame nf0 */
+   double * l_ph0;
+   double * r_am0;
+   double * r_ph0;
+   double * omega; /* expected frequency */
+   double * l_mag; /* averaged magnitude (amplitude) to re-synthesize */
+   double * r_mag;
+   double * l_ph;  /* phase accumulator to re-synthesize */
+   double * r_ph;
+
+   double * l_out; /* [hop_syn + len], overlap-add buffers */
+   double * r_out;
 
+   long nf0;
+   long nf;
+   int flag_ph; /* 0 until the first two frames are read */
+   double tt;
+};
+
+/* read the frame at "frame" and FFT it
+ * OUTPUT
+ *  returned value : the status of pv_engine_input_read_at()
+ */
 static long
 read_and_FFT_stereo
 (
-   SNDFILE * sf, SF_INFO * sfinfo,
+   struct pv_ellis * pv,
+   pv_engine_input_t * in,
    long frame,
-   int len,
-   int flag_window,
-   fftw_plan plan, double * time, double * freq,
    double * l_amp, double * l_phs,
    double * r_amp, double * r_phs
 )
 {
    long status;
-   double * left = (double *) malloc (sizeof (double) * len);
-   double * right = (double *) malloc (sizeof (double) * len);
-   CHECK_MALLOC (left,  "read_and_FFT_stereo");
-   CHECK_MALLOC (right, "read_and_FFT_stereo");
-   status = sndfile_read_at(sf, *sfinfo, frame, left, right, len);
-   if (status != len)
+   status = pv_engine_input_read_at (in, frame, pv->left, pv->right, pv->len);
+   if (status != pv->len)
    {
-      free(left);
-      free(right);
       return status;
    }
-   apply_FFT(len, left, flag_window, plan, time, freq, 1.0, l_amp, l_phs);
-   apply_FFT(len, right, flag_window, plan, time, freq, 1.0, r_amp, r_phs);
-   free(left);
-   free(right);
+   apply_FFT_stereo
+   (
+      pv->len, pv->left, pv->right, pv->flag_window,
+      pv->plan, pv->time, pv->freq, 1.0,
+      l_amp, l_phs, r_amp, r_phs
+   );
    return status;
 }
 
-/* this routine is translated from Matlab script written by D.P.W.Ellis:
- *   http://www.ee.columbia.edu/~dpwe/resources/matlab/pvoc/
+/* whether the frame at "frame" is there completely
+ * OUTPUT
+ *  returned value : 0 if so, otherwise PV_ENGINE_MORE or PV_ENGINE_END
  */
-void pv_ellis (const char * file, const char * outfile,
-               double rate, double pitch_shift,
-               long len, long hop,
-               int flag_window)
+static long
+pv_ellis_frame_ready (struct pv_ellis * pv, pv_engine_input_t * in,
+                      long frame)
 {
-   /* int status; */
-   double twopi = 2.0 * M_PI;
-   int i;
-   int k;
-   long nf;
-   long nf0;
-   long hop_syn = hop;
-   long hop_res = (long)((double)hop_syn * pow (2.0, - pitch_shift / 12.0));
-   double corr_rate = (double)hop_res * rate / (double)hop_syn;
-   long read_status; /* open the input file */
-   SNDFILE * sf = NULL;
-   SF_INFO sfinfo; /* libsndfile version */
-   ao_device * ao = NULL;
-   SNDFILE * sfout = NULL;
-   SF_INFO sfout_info;
-   double * left = NULL;
-   double * right = NULL;
-   double window_scale;
-   double * time = NULL;
-   double * freq = NULL;
-   double * t_out = NULL;
-   double * f_out = NULL;
-   double * l_amp = NULL;
-   double * l_phs = NULL;
-   double * r_amp = NULL;
-   double * r_phs = NULL;
-   double * l_am0 = NULL;
-   double * l_ph0 = NULL;
-   double * r_am0 = NULL;
-   double * r_ph0 = NULL;
-   double * l_out = NULL;
-   double * r_out = NULL;
-   double * omega = NULL;
-   double * l_mag = NULL;
-   double * r_mag = NULL;
-   double * l_ph = NULL;
-   double * r_ph = NULL;
-   double tt;
-   int step;
-   fftw_plan plan;
-   fftw_plan plan_inv;
-   double tf;
-   double dp;
-   memset (&sfinfo, 0, sizeof (sfinfo));
-   sf = sf_open (file, SFM_READ, &sfinfo);
-   if (sf == NULL)
+   long status = pv_engine_input_ready (in, frame, pv->len);
+   if (status == PV_ENGINE_MORE)
+   {
+      return (PV_ENGINE_MORE);
+   }
+   else if (status != pv->len)
    {
-      fprintf (stderr, "fail to open %s\n", file);
-      exit (1);
+      /* most likely, it is EOF. */
+      return (PV_ENGINE_END);
    }
-   sndfile_print_info (&sfinfo);
+   return (0);
+}
 
-   /* allocate buffers  */
+static void
+pv_ellis_engine_free (void * state)
+{
+   struct pv_ellis * pv = (struct pv_ellis *)state;
 
-   left  = (double *) malloc(sizeof(double) * len);
-   right = (double *) malloc(sizeof(double) * len);
-   CHECK_MALLOC (left,  "pv_ellis");
-   CHECK_MALLOC (right, "pv_ellis");
+   free (pv->left);
+   free (pv->right);
 
-   /* prepare the output */
-   if (outfile == NULL)
+   if (pv->plan != NULL)
    {
-      ao = ao_init_16_stereo(sfinfo.samplerate, 1 /* verbose */);
+      fftw_destroy_plan (pv->plan);
    }
-   else
+   fftw_free (pv->time);
+   fftw_free (pv->freq);
+
+   if (pv->plan_inv != NULL)
    {
-      sfout = sndfile_open_for_write
-      (
-         &sfout_info, outfile, sfinfo.samplerate, sfinfo.channels
-      );
-      if (sfout == NULL)
-      {
-         fprintf (stderr, "fail to open file %s\n", outfile);
-         exit (1);
-      }
+      fftw_destroy_plan (pv->plan_inv);
    }
-   window_scale = get_scale_factor_for_window(len, hop_syn, flag_window);
-
-   /* initialization plan for FFTW  */
-
-   time = (double *)fftw_malloc (len * sizeof(double));
-   freq = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (time, "pv_ellis");
-   CHECK_MALLOC (freq, "pv_ellis");
-   plan = fftw_plan_r2r_1d (len, time, freq, FFTW_R2HC, FFTW_ESTIMATE);
-
-   f_out = (double *)fftw_malloc (len * sizeof(double));
-   t_out = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (f_out, "pv_ellis");
-   CHECK_MALLOC (t_out, "pv_ellis");
-   plan_inv = fftw_plan_r2r_1d (len, f_out, t_out,
-                                FFTW_HC2R, FFTW_ESTIMATE);
-
-   l_amp = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   l_phs = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_amp = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_phs = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (l_amp, "pv_ellis");
-   CHECK_MALLOC (l_phs, "pv_ellis");
-   CHECK_MALLOC (r_amp, "pv_ellis");
-   CHECK_MALLOC (r_phs, "pv_ellis");
-
-   l_am0 = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   l_ph0 = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_am0 = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_ph0 = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (l_am0, "pv_ellis");
-   CHECK_MALLOC (l_ph0, "pv_ellis");
-   CHECK_MALLOC (r_am0, "pv_ellis");
-   CHECK_MALLOC (r_ph0, "pv_ellis");
-
-   for (i = 0; i < (len / 2) + 1; i ++)
+   fftw_free (pv->t_out);
+   fftw_free (pv->f_out);
+
+   free (pv->l_amp);
+   free (pv->l_phs);
+   free (pv->r_amp);
+   free (pv->r_phs);
+   free (pv->l_am0);
+   free (pv->l_ph0);
+   free (pv->r_am0);
+   free (pv->r_ph0);
+
+   free (pv->l_out);
+   free (pv->r_out);
+
+   free (pv->omega);
+   free (pv->l_mag);
+   free (pv->r_mag);
+
+   free (pv->l_ph);
+   free (pv->r_ph);
+   free (pv);
+}
+
+static void *
+pv_ellis_engine_init (const pv_engine_params_t * params,
+                      pv_engine_shape_t * shape)
+{
+   struct pv_ellis * pv;
+   double twopi = 2.0 * M_PI;
+   long len = params->len;
+   long hop_syn = params->hop_syn;
+   long hop_res = (long)((double)hop_syn
+                         * pow (2.0, - params->pitch_shift / 12.0));
+   double corr_rate = (double)hop_res * params->rate / (double)hop_syn;
+   int k;
+
+   if (hop_res <= 0 || corr_rate <= 0.0)
    {
-      l_amp [i] = 0.0;
-      l_phs [i] = 0.0;
-      r_amp [i] = 0.0;
-      r_phs [i] = 0.0;
-
-      l_am0 [i] = 0.0;
-      l_ph0 [i] = 0.0;
-      r_am0 [i] = 0.0;
-      r_ph0 [i] = 0.0;
+      return (NULL);
    }
 
-   l_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   r_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   CHECK_MALLOC (l_out, "pv_ellis");
-   CHECK_MALLOC (r_out, "pv_ellis");
-   for (i = 0; i < (hop_syn + len); i ++)
+   /* the pointers are NULL until allocated, for the free function */
+   pv = (struct pv_ellis *) calloc (1, sizeof (struct pv_ellis));
+   if (pv == NULL)
    {
-      l_out [i] = 0.0;
-      r_out [i] = 0.0;
+      return (NULL);
+   }
+   pv->len = len;
+   pv->hop_syn = hop_syn;
+   pv->flag_window = params->flag_window;
+   pv->corr_rate = corr_rate;
+   pv->window_scale = get_scale_factor_for_window(len, hop_syn,
+                                                  params->flag_window);
+
+   pv->left  = (double *) malloc(sizeof(double) * len);
+   pv->right = (double *) malloc(sizeof(double) * len);
+
+   pv->time = (double *)fftw_malloc (2 * len * sizeof(double));
+   pv->freq = (double *)fftw_malloc (2 * len * sizeof(double));
+
+   pv->f_out = (double *)fftw_malloc (len * sizeof(double));
+   pv->t_out = (double *)fftw_malloc (len * sizeof(double));
+
+   pv->l_amp = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->l_phs = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_amp = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_phs = (double *)calloc ((len / 2) + 1, sizeof(double));
+
+   pv->l_am0 = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->l_ph0 = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_am0 = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_ph0 = (double *)calloc ((len / 2) + 1, sizeof(double));
+
+   pv->l_out = (double *) calloc (hop_syn + len, sizeof(double));
+   pv->r_out = (double *) calloc (hop_syn + len, sizeof(double));
+
+   pv->omega = (double *) malloc (sizeof (double) * ((len / 2) + 1));
+
+   pv->l_mag = (double *) malloc (sizeof (double) * ((len / 2) + 1));
+   pv->r_mag = (double *) malloc (sizeof (double) * ((len / 2) + 1));
+
+   pv->l_ph = (double *) malloc (sizeof (double) * ((len / 2) + 1));
+   pv->r_ph = (double *) malloc (sizeof (double) * ((len / 2) + 1));
+
+   if (pv->left == NULL || pv->right == NULL ||
+       pv->time == NULL || pv->freq == NULL ||
+       pv->f_out == NULL || pv->t_out == NULL ||
+       pv->l_amp == NULL || pv->l_phs == NULL ||
+       pv->r_amp == NULL || pv->r_phs == NULL ||
+       pv->l_am0 == NULL || pv->l_ph0 == NULL ||
+       pv->r_am0 == NULL || pv->r_ph0 == NULL ||
+       pv->l_out == NULL || pv->r_out == NULL ||
+       pv->omega == NULL || pv->l_mag == NULL ||
+       pv->r_mag == NULL || pv->l_ph == NULL ||
+       pv->r_ph == NULL)
+   {
+      pv_ellis_engine_free (pv);
+      return (NULL);
    }
 
-   /* expected frequency */
+   pv->plan = plan_FFT_stereo (len, pv->time, pv->freq);
+   pv->plan_inv = fftw_plan_r2r_1d (len, pv->f_out, pv->t_out,
+                                    FFTW_HC2R, FFTW_ESTIMATE);
 
-   omega = (double *) malloc (sizeof (double) * ((len / 2) + 1));
-   CHECK_MALLOC (omega, "pv_ellis");
    for (k = 0; k < (len / 2) + 1; k ++)
    {
-      omega [k] = twopi * (double)k / (double)len;
+      pv->omega [k] = twopi * (double)k / (double)len;
    }
 
-   /* averaged magnitude (amplitude) to re-synthesize */
-
-   l_mag = (double *) malloc (sizeof (double) * ((len / 2) + 1));
-   r_mag = (double *) malloc (sizeof (double) * ((len / 2) + 1));
-   CHECK_MALLOC (l_mag, "pv_ellis");
-   CHECK_MALLOC (r_mag, "pv_ellis");
-
-   /* Phase accumulator to re-synthesize */
+   pv->nf0 = 0;
+   pv->nf = 0;
+   pv->flag_ph = 0;
+   pv->tt = 0.0;
 
-   l_ph = (double *) malloc (sizeof (double) * ((len / 2) + 1));
-   r_ph = (double *) malloc (sizeof (double) * ((len / 2) + 1));
-   CHECK_MALLOC (l_ph, "pv_ellis");
-   CHECK_MALLOC (r_ph, "pv_ellis");
+   shape->block   = hop_syn;
+   shape->hop_res = hop_res;
+   shape->tail    = len;
+   return (pv);
+}
 
+/* read the frames 0 and hop_syn, and preset the phase
+ */
+static long
+pv_ellis_start (struct pv_ellis * pv, pv_engine_input_t * in)
+{
+   long status;
+   int k;
 
-   /* read the first frame */
-   read_status = read_and_FFT_stereo (sf, &sfinfo, 0,
-                                      len, flag_window,
-                                      plan, time, freq,
-                                      l_amp, l_phs,
-                                      r_amp, r_phs);
-   if (read_status != len)
+   status = pv_ellis_frame_ready (pv, in, pv->hop_syn);
+   if (status != 0)
    {
-      exit (1);
+      return (status);
    }
-   nf = 0; /* 0 frame */
+
+   /* read the first frame */
+   read_and_FFT_stereo (pv, in, 0,
+                        pv->l_am0, pv->l_ph0, pv->r_am0, pv->r_ph0);
+   pv->nf0 = 0; /* 0 frame */
 
    /* Preset to phase of first frame for perfect reconstruction */
    /* in case of 1:1 time scaling */
-   for (k = 0; k < (len / 2) + 1; k ++)
+   for (k = 0; k < (pv->len / 2) + 1; k ++)
    {
-      l_ph [k] = l_phs [k];
-      r_ph [k] = r_phs [k];
+      pv->l_ph [k] = pv->l_ph0 [k];
+      pv->r_ph [k] = pv->r_ph0 [k];
    }
 
    /* read next frame */
-   /* backup */
-   nf0 = nf;
-   for (k = 0; k < (len / 2) + 1; k ++)
-   {
-      l_am0[k] = l_amp[k];
-      l_ph0[k] = l_phs[k];
-      r_am0[k] = r_amp[k];
-      r_ph0[k] = r_phs[k];
-   }
-   read_status = read_and_FFT_stereo
-   (
-      sf, &sfinfo, hop_syn, len, flag_window, plan, time, freq,
-      l_amp, l_phs, r_amp, r_phs
-   );
-   if (read_status != len)
+   read_and_FFT_stereo (pv, in, pv->hop_syn,
+                        pv->l_amp, pv->l_phs, pv->r_amp, pv->r_phs);
+   pv->nf = 1; /* 1*hop_syn frame */
+   pv->flag_ph = 1;
+   return (0);
+}
+
+/* one hop_syn of the output, see pv-engine.h
+ * nothing changes before the frames of the hop are there.
+ */
+static long
+pv_ellis_engine_process_block (void * state,
+                               pv_engine_input_t * in,
+                               double * left, double * right)
+{
+   struct pv_ellis * pv = (struct pv_ellis *)state;
+   double twopi = 2.0 * M_PI;
+   long len = pv->len;
+   long hop_syn = pv->hop_syn;
+   long status;
+   double tf;
+   double dp;
+   int t0, t1;
+   int i;
+   int k;
+
+   if (pv->flag_ph == 0)
    {
-      exit (1);
+      status = pv_ellis_start (pv, in);
+      if (status != 0)
+      {
+         return (status);
+      }
    }
-   nf = 1; /* 1*hop_syn frame */
-
-   /* for (tt = 0.0, step = 0; ; tt += rate, step++) */
 
-   for (tt = 0.0, step = 0; ; tt += corr_rate, step++)
+   t0 = (int)pv->tt;
+   t1 = t0 + 1;
+   if (t0 != pv->nf0)
    {
-      int t0, t1;
-      t0 = (int)tt;
-      t1 = t0 + 1;
-      if (t0 != nf0)
+      if (t0 == pv->nf) /* then, we can use the last data for t0 */
       {
-         if (t0 == nf) /* then, we can use the last data for t0 */
+         status = pv_ellis_frame_ready (pv, in, (long)t1 * hop_syn);
+         if (status != 0)
          {
-            for (k = 0; k < (len / 2) + 1; k ++)
-            {
-               l_am0 [k] = l_amp [k];
-               l_ph0 [k] = l_phs [k];
-               r_am0 [k] = r_amp [k];
-               r_ph0 [k] = r_phs [k];
-            }
-            nf0 = t0;
-
-            /* read t1 * hop_syn frame, the next one! */
-            read_status = read_and_FFT_stereo (sf, &sfinfo,
-                                               (long)t1 * hop_syn,
-                                               len, flag_window,
-                                               plan, time, freq,
-                                               l_amp, l_phs,
-                                               r_amp, r_phs);
-            if (read_status != len)
-            {
-               /* most likely, it is EOF. */
-               break;
-            }
-            nf = t1;
+            return (status);
          }
-         else /* we have to read the last data for t0 (and for t1, too) */
+         for (k = 0; k < (len / 2) + 1; k ++)
          {
-            /* read t0 * hop_syn frame */
-            read_status = read_and_FFT_stereo (sf, &sfinfo,
-                                               (long)t0 * hop_syn,
-                                               len, flag_window,
-                                               plan, time, freq,
-                                               l_am0, l_ph0,
-                                               r_am0, r_ph0);
-            if (read_status != len)
-            {
-               /* most likely, it is EOF. */
-               break;
-            }
-            nf0 = t0;
-
-            /* read t1 * hop_syn frame, the next one! */
-            read_status = read_and_FFT_stereo (sf, &sfinfo,
-                                               (long)t1 * hop_syn,
-                                               len, flag_window,
-                                               plan, time, freq,
-                                               l_amp, l_phs,
-                                               r_amp, r_phs);
-            if (read_status != len)
-            {
-               /* most likely, it is EOF. */
-               break;
-            }
-            nf = t1;
+            pv->l_am0 [k] = pv->l_amp [k];
+            pv->l_ph0 [k] = pv->l_phs [k];
+            pv->r_am0 [k] = pv->r_amp [k];
+            pv->r_ph0 [k] = pv->r_phs [k];
          }
+         pv->nf0 = t0;
       }
-      /* otherwise, t0 == nf0 (and therefore t1 == nf),
-       * so that we do not need to read the frames */
-
-      tf = tt - (double)((int) tt);
-      for (k = 0; k < (len / 2) + 1; k ++)
+      else /* we have to read the last data for t0 (and for t1, too) */
       {
-         l_mag [k] = (1.0 - tf) * l_am0 [k] + tf * l_amp [k];
-         r_mag [k] = (1.0 - tf) * r_am0 [k] + tf * r_amp [k];
-      }
+         status = pv_ellis_frame_ready (pv, in, (long)t0 * hop_syn);
+         if (status == 0)
+         {
+            status = pv_ellis_frame_ready (pv, in, (long)t1 * hop_syn);
+         }
+         if (status != 0)
+         {
+            return (status);
+         }
 
-      /* synthesize */
-      polar_to_HC (len, l_mag, l_ph, 0, f_out); /* (bmag, ph) -> f_out[] */
-      fftw_execute (plan_inv); /* inv-FFT: f_out[] -> t_out[] */
-      /* scale by len and windowing */
-      windowing (len, t_out, flag_window, (double)len * window_scale, t_out);
-      /* superimpose */
-      for (i = 0; i < len; i ++)
-      {
-         l_out [hop_syn + i] += t_out [i];
+         /* read t0 * hop_syn frame */
+         read_and_FFT_stereo (pv, in, (long)t0 * hop_syn,
+                              pv->l_am0, pv->l_ph0, pv->r_am0, pv->r_ph0);
+         pv->nf0 = t0;
       }
 
-      polar_to_HC (len, r_mag, r_ph, 0, f_out); /* (bmag, ph) -> f_out[] */
-      fftw_execute (plan_inv); /* inv-FFT: f_out[] -> t_out[] */
-      /* scale by len and windowing */
-      windowing (len, t_out, flag_window, (double)len * window_scale, t_out);
-      /* superimpose */
-      for (i = 0; i < len; i ++)
-      {
-         r_out [hop_syn + i] += t_out [i];
-      }
+      /* read t1 * hop_syn frame, the next one! */
+      read_and_FFT_stereo (pv, in, (long)t1 * hop_syn,
+                           pv->l_amp, pv->l_phs, pv->r_amp, pv->r_phs);
+      pv->nf = t1;
+   }
+   /* otherwise, t0 == nf0 (and therefore t1 == nf),
+    * so that we do not need to read the frames */
 
+   tf = pv->tt - (double)((int) pv->tt);
+   for (k = 0; k < (len / 2) + 1; k ++)
+   {
+      pv->l_mag [k] = (1.0 - tf) * pv->l_am0 [k] + tf * pv->l_amp [k];
+      pv->r_mag [k] = (1.0 - tf) * pv->r_am0 [k] + tf * pv->r_amp [k];
+   }
 
-      /* Cumulate phase, ready for next frame */
-      /* calculate phase advance */
+   /* synthesize */
+   /* (bmag, ph) -> f_out[] */
+   polar_to_HC (len, pv->l_mag, pv->l_ph, 0, pv->f_out);
+   fftw_execute (pv->plan_inv); /* inv-FFT: f_out[] -> t_out[] */
+   /* scale by len and windowing */
+   windowing (len, pv->t_out, pv->flag_window,
+              (double)len * pv->window_scale, pv->t_out);
+   /* superimpose */
+   for (i = 0; i < len; i ++)
+   {
+      pv->l_out [hop_syn + i] += pv->t_out [i];
+   }
 
-      for (k = 0; k < (len / 2) + 1; k ++)
-      {
-         /* NOTE: I don't understand why the following is working... */
-         /* the phase for the next output is hop_syn/rate frames ahead, */
-         /* while the phase increment is for hop_syn frames. */
-
-         dp = l_phs [k] - l_ph0 [k] - omega [k] * (double)hop_syn;
-         for (; dp >= M_PI; dp -= twopi);
-         for (; dp < -M_PI; dp += twopi);
-         l_ph [k] += (omega [k] + dp / (double)hop_syn) * (double) hop_syn;
-         l_ph [k] -= twopi * (double)((int)(l_ph [k] / twopi));
-
-         dp = r_phs [k] - r_ph0 [k] - omega [k] * (double)hop_syn;
-         for (; dp >= M_PI; dp -= twopi);
-         for (; dp < -M_PI; dp += twopi);
-         r_ph [k] += (omega [k] + dp / (double)hop_syn) * (double) hop_syn;
-         r_ph [k] -= twopi * (double)((int)(r_ph [k] / twopi));
-      }
+   polar_to_HC (len, pv->r_mag, pv->r_ph, 0, pv->f_out);
+   fftw_execute (pv->plan_inv); /* inv-FFT: f_out[] -> t_out[] */
+   /* scale by len and windowing */
+   windowing (len, pv->t_out, pv->flag_window,
+              (double)len * pv->window_scale, pv->t_out);
+   /* superimpose */
+   for (i = 0; i < len; i ++)
+   {
+      pv->r_out [hop_syn + i] += pv->t_out [i];
+   }
 
-      /* output */
-      /*
-         status = pv_play_resample ((long)((double)hop_syn * rate),
-             hop_syn, l_out, r_out,
-             ao, sfout, &sfout_info,
-             flag_pitch);
-      */
-      /*status =*/ pv_play_resample (hop_res, hop_syn, l_out, r_out,
-                                 ao, sfout, &sfout_info);
-      /* note here hop_syn is set equal to hop_syn, so give the correct one */
 
+   /* Cumulate phase, ready for next frame */
+   /* calculate phase advance */
 
-      /* shift acc_out by hop_syn */
-      for (i = 0; i < len; i ++)
-      {
-         l_out [i] = l_out [i + hop_syn];
-         r_out [i] = r_out [i + hop_syn];
-      }
-      for (i = len; i < len + hop_syn; i ++)
-      {
-         l_out [i] = 0.0;
-         r_out [i] = 0.0;
-      }
+   for (k = 0; k < (len / 2) + 1; k ++)
+   {
+      /* NOTE: I don't understand why the following is working... */
+      /* the phase for the next output is hop_syn/rate frames ahead, */
+      /* while the phase increment is for hop_syn frames. */
+
+      dp = pv->l_phs [k] - pv->l_ph0 [k] - pv->omega [k] * (double)hop_syn;
+      for (; dp >= M_PI; dp -= twopi);
+      for (; dp < -M_PI; dp += twopi);
+      pv->l_ph [k] += (pv->omega [k] + dp / (double)hop_syn) * (double) hop_syn;
+      pv->l_ph [k] -= twopi * (double)((int)(pv->l_ph [k] / twopi));
+
+      dp = pv->r_phs [k] - pv->r_ph0 [k] - pv->omega [k] * (double)hop_syn;
+      for (; dp >= M_PI; dp -= twopi);
+      for (; dp < -M_PI; dp += twopi);
+      pv->r_ph [k] += (pv->omega [k] + dp / (double)hop_syn) * (double) hop_syn;
+      pv->r_ph [k] -= twopi * (double)((int)(pv->r_ph [k] / twopi));
    }
-   sf_close (sf) ;
-   if (outfile == NULL)
+
+   /* output */
+   memcpy (left,  pv->l_out, sizeof (double) * hop_syn);
+   memcpy (right, pv->r_out, sizeof (double) * hop_syn);
+
+   /* shift acc_out by hop_syn */
+   for (i = 0; i < len; i ++)
    {
-      ao_close (ao);
+      pv->l_out [i] = pv->l_out [i + hop_syn];
+      pv->r_out [i] = pv->r_out [i + hop_syn];
    }
-   else
+   for (i = len; i < len + hop_syn; i ++)
    {
-      /* frames left in l_out[] and r_out[] */
-      /* status = */ sndfile_write (sfout, sfout_info, l_out, r_out, len);
-      sf_write_sync (sfout);
-      sf_close (sfout);
+      pv->l_out [i] = 0.0;
+      pv->r_out [i] = 0.0;
    }
 
-   free (left);
-   free (right);
-
-   free (time);
-   free (freq);
-   fftw_destroy_plan (plan);
-
-   free (t_out);
-   free (f_out);
-   fftw_destroy_plan (plan_inv);
-
-   free (l_amp);
-   free (l_phs);
-   free (r_amp);
-   free (r_phs);
-   free (l_am0);
-   free (l_ph0);
-   free (r_am0);
-   free (r_ph0);
+   /* the frames read later start at t0 * hop_syn or after */
+   pv->tt += pv->corr_rate;
+   in->keep = (long)t0 * hop_syn;
+   return (hop_syn);
+}
 
-   free (l_out);
-   free (r_out);
+static long
+pv_ellis_engine_flush (void * state,
+                       double * left, double * right)
+{
+   struct pv_ellis * pv = (struct pv_ellis *)state;
 
-   free (omega);
-   free (l_mag);
-   free (r_mag);
+   /* frames left in l_out[] and r_out[] */
+   memcpy (left,  pv->l_out, sizeof (double) * pv->len);
+   memcpy (right, pv->r_out, sizeof (double) * pv->len);
+   return (pv->len);
+}
 
-   free (l_ph);
-   free (r_ph);
+const pv_engine_ops_t pv_ellis_engine =
+{
+   "ellis",
+   "PV after the Matlab script of D.P.W.Ellis",
+   pv_ellis_engine_init,
+   pv_ellis_engine_process_block,
+   pv_ellis_engine_flush,
+   pv_ellis_engine_free
+};
+
+/* play or write the file through pv_ellis_engine
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
+ */
+int pv_ellis (const char * file, const char * outfile,
+              double rate, double pitch_shift,
+              long len, long hop,
+              int flag_window)
+{
+   pv_engine_params_t params;
+
+   pv_engine_params_init (&params);
+   params.len = len;
+   params.hop_syn = hop;
+   params.rate = rate;
+   params.pitch_shift = pitch_shift;
+   params.flag_window = flag_window;
+   params.src_quality = SRC_SINC_BEST_QUALITY; /* the best converter */
+
+   return (pv_engine_render_file (&pv_ellis_engine, &params,
+                                  file, outfile));
 }
 
 /*
@@ -0,0 +1,767 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : common interface of the phase vocoders
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-engine.c
+ *
+ *    This module provides one interface to all of the phase-vocoder
+ *    variants, so that they can be embedded and compared.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The input queue keeps the frames from in.keep on, so a variant can
+ *    read any frame it has not given up, as it read the file with
+ *    sndfile_read_at() before.  A read past the queued frames returns
+ *    PV_ENGINE_MORE, until pv_engine_flush() marks the end of the input;
+ *    after that it returns the frames that are there, like a short read
+ *    of the file.
+ *
+ *    The resampling for the pitch-shift is the one of
+ *    pv_complex_resample(), pv_resample_hop():  one SRC_STATE streams
+ *    from block to block, and each block is handed out as exactly
+ *    hop_res frames, late by the fixed latency of the converter.
+ *
+ *    No function exits the application.  A failed allocation is
+ *    reported, and returned as a null pointer or -1.
+ */
+
+#include <stdio.h>                     /* fprintf()                           */
+#include <stdlib.h>                    /* malloc(), realloc(), free()         */
+#include <string.h>                    /* memcpy(), memmove(), strcmp()       */
+#include <sndfile.h>                   /* SNDFILE, sf_open()                  */
+#include <ao/ao.h>                     /* ao_device                           */
+
+#include "ao-wrapper.h"                /* ao_init_16_stereo(), ao_write()     */
+#include "pv-engine.h"                 /* pv_engine_t                         */
+#include "snd.h"                       /* sndfile_read(), sndfile_write()     */
+
+/**
+ *    Lists the variants, for pv_engine_list() and pv_engine_find().
+ */
+
+static const pv_engine_ops_t * const s_engines [] =
+{
+   &pv_complex_engine,
+   &pv_complex_lock_engine,
+   &pv_conventional_engine,
+   &pv_loose_lock_engine,
+   &pv_ellis_engine,
+   &pv_freq_engine,
+   &pv_nofft_engine,
+   &pv_wsola_engine,
+   nullptr
+};
+
+/**
+ *    Sets the defaults of pv (the program):  an FFT of 2048 frames with a
+ *    hop of 512, the Hanning window, no time-stretch or pitch-shift, and
+ *    the fastest sinc converter.
+ */
+
+void
+pv_engine_params_init (pv_engine_params_t * params)
+{
+   params->len = 2048;
+   params->hop_syn = 512;
+   params->rate = 1.0;
+   params->pitch_shift = 0.0;
+   params->flag_window = 3;
+   params->flag_lock = 0;
+   params->flag_r2c = 0;
+   params->src_quality = SRC_SINC_FASTEST;
+}
+
+/**
+ * \return
+ *    Returns the variant at \a index, or a null pointer past the last one.
+ */
+
+const pv_engine_ops_t *
+pv_engine_list (int index)
+{
+   int count = (int) (sizeof s_engines / sizeof s_engines[0]) - 1;
+   return (index >= 0 && index < count) ? s_engines[index] : nullptr;
+}
+
+/**
+ * \return
+ *    Returns the variant called \a name, or a null pointer.
+ */
+
+const pv_engine_ops_t *
+pv_engine_find (const char * name)
+{
+   int i;
+   for (i = 0; not_nullptr(s_engines[i]); ++i)
+   {
+      if (strcmp(s_engines[i]->name, name) == 0)
+         return s_engines[i];
+   }
+   return nullptr;
+}
+
+/**
+ *    Checks whether the frames from \a frame to \a frame + \a len - 1 are
+ *    in the queue.
+ *
+ * \return
+ *    Returns \a len if they are all there.  Otherwise, returns
+ *    PV_ENGINE_MORE before the end of the input, and the number of frames
+ *    there (possibly 0) after it.  A frame given up (before in->start) or
+ *    a negative one counts as past the end.
+ */
+
+long
+pv_engine_input_ready (const pv_engine_input_t * in, long frame, long len)
+{
+   long end = in->start + in->count;
+   if (frame < in->start || frame < 0)
+      return 0;
+
+   if (frame + len <= end)
+      return len;
+
+   if (! in->eof)
+      return PV_ENGINE_MORE;
+
+   return frame < end ? end - frame : 0;
+}
+
+/**
+ *    Copies frames from the queue, as sndfile_read_at() reads them from a
+ *    file.  The frames missing at the end of the input are set to 0.
+ *
+ * \return
+ *    Returns the value of pv_engine_input_ready().  Nothing is copied if
+ *    it is PV_ENGINE_MORE.
+ */
+
+long
+pv_engine_input_read_at
+(
+   pv_engine_input_t * in,
+   long frame,
+   double * left,
+   double * right,
+   long len
+)
+{
+   long n = pv_engine_input_ready(in, frame, len);
+   if (n >= 0)
+   {
+      long i = in->offset + frame - in->start;
+      if (n > 0)
+      {
+         memcpy(left, in->left + i, sizeof(double) * n);
+         memcpy(right, in->right + i, sizeof(double) * n);
+      }
+      if (n < len)
+      {
+         memset(left + n, 0, sizeof(double) * (len - n));
+         memset(right + n, 0, sizeof(double) * (len - n));
+      }
+   }
+   return n;
+}
+
+/**
+ *    Reports a failed allocation.
+ */
+
+static void
+engine_no_memory (const char * func)
+{
+   errprintf("? %s: out of memory\n", func);
+}
+
+/**
+ *    Appends \a n frames to the input queue, first dropping the frames
+ *    before in->keep.
+ *
+ * \return
+ *    Returns wfalse, with a message, if the queue cannot grow.  The
+ *    queue is left as it was.
+ */
+
+static wbool_t
+engine_queue
+(
+   pv_engine_input_t * in,
+   const double * left,
+   const double * right,
+   long n
+)
+{
+   if (in->keep > in->start)
+   {
+      long drop = in->keep - in->start;
+      if (drop > in->count)
+         drop = in->count;
+
+      in->offset += drop;
+      in->count -= drop;
+      in->start += drop;
+   }
+   if (in->offset + in->count + n > in->size)
+   {
+      if (in->offset > 0)
+      {
+         memmove(in->left, in->left + in->offset, sizeof(double) * in->count);
+         memmove(in->right, in->right + in->offset, sizeof(double) * in->count);
+         in->offset = 0;
+      }
+      if (in->count + n > in->size)
+      {
+         long size = 2 * in->size > in->count + n ?
+            2 * in->size : in->count + n;
+
+         double * l = (double *) realloc(in->left, sizeof(double) * size);
+         double * r;
+         if (is_nullptr(l))
+         {
+            engine_no_memory("engine_queue");
+            return wfalse;
+         }
+         in->left = l;
+         r = (double *) realloc(in->right, sizeof(double) * size);
+         if (is_nullptr(r))
+         {
+            engine_no_memory("engine_queue");
+            return wfalse;
+         }
+         in->right = r;
+         in->size = size;
+      }
+   }
+   memcpy(in->left + in->offset + in->count, left, sizeof(double) * n);
+   memcpy(in->right + in->offset + in->count, right, sizeof(double) * n);
+   in->count += n;
+   return wtrue;
+}
+
+/**
+ *    Makes room for \a n more frames in the output queue.
+ *
+ * \return
+ *    Returns the index of the first free frame, or -1, with a message,
+ *    if the queue cannot grow.
+ */
+
+static long
+engine_room (pv_engine_t * e, long n)
+{
+   if (e->out_offset + e->out_count + n > e->out_size)
+   {
+      if (e->out_offset > 0)
+      {
+         memmove
+         (
+            e->l_out, e->l_out + e->out_offset, sizeof(double) * e->out_count
+         );
+         memmove
+         (
+            e->r_out, e->r_out + e->out_offset, sizeof(double) * e->out_count
+         );
+         e->out_offset = 0;
+      }
+      if (e->out_count + n > e->out_size)
+      {
+         long size = 2 * e->out_size > e->out_count + n ?
+            2 * e->out_size : e->out_count + n;
+
+         double * l = (double *) realloc(e->l_out, sizeof(double) * size);
+         double * r;
+         if (is_nullptr(l))
+         {
+            engine_no_memory("engine_room");
+            return -1;
+         }
+         e->l_out = l;
+         r = (double *) realloc(e->r_out, sizeof(double) * size);
+         if (is_nullptr(r))
+         {
+            engine_no_memory("engine_room");
+            return -1;
+         }
+         e->r_out = r;
+         e->out_size = size;
+      }
+   }
+   return e->out_offset + e->out_count;
+}
+
+/**
+ *    Appends \a n frames to the output queue as they are.
+ *
+ * \return
+ *    Returns wfalse if the queue cannot grow.
+ */
+
+static wbool_t
+engine_append (pv_engine_t * e, const double * l, const double * r, long n)
+{
+   long at = engine_room(e, n);
+   if (at < 0)
+      return wfalse;
+
+   memcpy(e->l_out + at, l, sizeof(double) * n);
+   memcpy(e->r_out + at, r, sizeof(double) * n);
+   e->out_count += n;
+   return wtrue;
+}
+
+/**
+ *    Resamples a block of \a n frames into shape.hop_res frames of the
+ *    output queue, by pv_resample_hop().
+ *
+ * \return
+ *    Returns wfalse if the queue cannot grow or the resampling fails.
+ */
+
+static wbool_t
+engine_resample (pv_engine_t * e, const double * l, const double * r, long n)
+{
+   long hop_res = e->shape.hop_res;
+   long at = engine_room(e, hop_res);
+   long made;
+   if (at < 0)
+      return wfalse;
+
+   made = pv_resample_hop
+   (
+      e->resample, l, r, n, e->l_out + at, e->r_out + at, hop_res
+   );
+   if (made < 0)
+      return wfalse;
+
+   e->out_count += hop_res;
+   return wtrue;
+}
+
+/**
+ *    Runs the hops of the variant until it needs more input or the input
+ *    is used up.
+ *
+ * \return
+ *    Returns wfalse if the variant, the resampling, or the output queue
+ *    fails.
+ */
+
+static wbool_t
+engine_run (pv_engine_t * e)
+{
+   while (! e->ended)
+   {
+      long n = e->ops->process_block(e->state, &e->in, e->l_hop, e->r_hop);
+      if (n == PV_ENGINE_ERROR)
+      {
+         errprintf("? %s: the engine failed\n", e->ops->name);
+         return wfalse;
+      }
+      if (n == PV_ENGINE_MORE && ! e->in.eof)
+         break;
+
+      if (n < 0)
+      {
+         e->ended = wtrue;
+         break;
+      }
+      if (not_nullptr(e->resample))
+      {
+         if (! engine_resample(e, e->l_hop, e->r_hop, n))
+            return wfalse;
+      }
+      else if (! engine_append(e, e->l_hop, e->r_hop, n))
+         return wfalse;
+   }
+   return wtrue;
+}
+
+/**
+ *    Creates a driver for one variant.
+ *
+ * \return
+ *    Returns a null pointer, with a message, if the variant does not take
+ *    the parameters, the converter cannot be made, or the memory is short.
+ */
+
+pv_engine_t *
+pv_engine_new (const pv_engine_ops_t * ops, const pv_engine_params_t * params)
+{
+   pv_engine_t * e;
+   if (params->len < 4 || params->hop_syn < 1 || params->hop_syn > params->len)
+   {
+      errprintf("? %s: invalid FFT length or hop\n", ops->name);
+      return nullptr;
+   }
+   e = (pv_engine_t *) calloc(1, sizeof(pv_engine_t));
+   if (is_nullptr(e))
+   {
+      engine_no_memory("pv_engine_new");
+      return nullptr;
+   }
+   e->ops = ops;
+   e->params = *params;
+   e->state = ops->init(params, &e->shape);
+   if (is_nullptr(e->state))
+   {
+      errprintf
+      (
+         "? %s: the parameters do not suit this engine, "
+         "or the memory is short\n", ops->name
+      );
+      free(e);
+      return nullptr;
+   }
+   e->l_hop = (double *) malloc(sizeof(double) * e->shape.block);
+   e->r_hop = (double *) malloc(sizeof(double) * e->shape.block);
+   if (is_nullptr(e->l_hop) || is_nullptr(e->r_hop))
+   {
+      engine_no_memory("pv_engine_new");
+      pv_engine_free(e);
+      return nullptr;
+   }
+   if (e->shape.hop_res != e->shape.block)
+   {
+      e->resample = pv_resample_new(params->src_quality);
+      if (is_nullptr(e->resample))
+      {
+         errprintf
+         (
+            "? samplerate converter %d: invalid, or the memory is short\n",
+            params->src_quality
+         );
+         pv_engine_free(e);
+         return nullptr;
+      }
+   }
+   return e;
+}
+
+/**
+ *    Queues \a n frames of input and runs the hops they make possible.
+ *
+ * \return
+ *    Returns the number of output frames ready for pv_engine_read(), or
+ *    -1, with a message, if the variant or the resampling fails, or the
+ *    memory is short.
+ */
+
+long
+pv_engine_process_block
+(
+   pv_engine_t * e,
+   const double * left,
+   const double * right,
+   long n
+)
+{
+   if (! e->ended && ! e->in.eof && n > 0)
+   {
+      if (! engine_queue(&e->in, left, right, n))
+         return -1;
+   }
+   if (! engine_run(e))
+      return -1;
+
+   return e->out_count;
+}
+
+/**
+ *    Marks the end of the input, runs the last hops, and queues the
+ *    frames left in the overlap-add buffers of the variant.
+ *
+ * \return
+ *    Returns the number of output frames ready for pv_engine_read(), or
+ *    -1, with a message, if the variant or the resampling fails, or the
+ *    memory is short.
+ */
+
+long
+pv_engine_flush (pv_engine_t * e)
+{
+   if (! e->flushed)
+   {
+      e->in.eof = wtrue;
+      if (! engine_run(e))
+         return -1;
+
+      if (e->shape.tail > 0)
+      {
+         double * l = (double *) malloc(sizeof(double) * e->shape.tail);
+         double * r = (double *) malloc(sizeof(double) * e->shape.tail);
+         wbool_t ok = not_nullptr(l) && not_nullptr(r);
+         if (ok)
+         {
+            long n = e->ops->flush(e->state, l, r);
+            if (n == PV_ENGINE_ERROR)
+            {
+               errprintf("? %s: the engine failed\n", e->ops->name);
+               ok = wfalse;
+            }
+            else if (n > 0)
+               ok = engine_append(e, l, r, n);
+         }
+         else
+            engine_no_memory("pv_engine_flush");
+
+         free(l);
+         free(r);
+         if (! ok)
+            return -1;
+      }
+      e->flushed = wtrue;
+   }
+   return e->out_count;
+}
+
+/**
+ *    Takes up to \a n frames of output.
+ *
+ * \return
+ *    Returns the number of frames copied.
+ */
+
+long
+pv_engine_read (pv_engine_t * e, double * left, double * right, long n)
+{
+   if (n > e->out_count)
+      n = e->out_count;
+
+   if (n > 0)
+   {
+      memcpy(left, e->l_out + e->out_offset, sizeof(double) * n);
+      memcpy(right, e->r_out + e->out_offset, sizeof(double) * n);
+      e->out_offset += n;
+      e->out_count -= n;
+   }
+   return n;
+}
+
+/**
+ *    Frees the variant and the driver.
+ */
+
+void
+pv_engine_free (pv_engine_t * e)
+{
+   if (not_nullptr(e))
+   {
+      if (not_nullptr(e->state))
+         e->ops->free(e->state);
+
+      pv_resample_free(e->resample);
+      free(e->in.left);
+      free(e->in.right);
+      free(e->l_hop);
+      free(e->r_hop);
+      free(e->l_out);
+      free(e->r_out);
+      free(e);
+   }
+}
+
+/**
+ *    Plays or writes the output frames that are ready.
+ *
+ * \return
+ *    Returns wfalse if the file cannot be written.
+ */
+
+static wbool_t
+render_drain
+(
+   pv_engine_t * e,
+   ao_device * ao,
+   ao_queue_t * aoq,
+   SNDFILE * sfout,
+   SF_INFO * sfout_info,
+   double * l,
+   double * r
+)
+{
+   long n;
+   while ((n = pv_engine_read(e, l, r, PV_ENGINE_BLOCK)) > 0)
+   {
+      if (not_nullptr(sfout))
+      {
+         if (sndfile_write(sfout, *sfout_info, l, r, (int) n) != n)
+            return wfalse;
+      }
+      else if (not_nullptr(aoq))
+         ao_queue_write(aoq, l, r, (int) n);
+      else
+         ao_write(ao, l, r, (int) n);
+   }
+   return wtrue;
+}
+
+/**
+ *    Runs a variant over a whole file, as the pv_conventional() etc.
+ *    functions did each on their own.
+ *
+ * \param outfile
+ *    Provides the output file, or a null pointer to play through ao.
+ *
+ * \return
+ *    Returns 0 on success, and -1, with a message, on failure.
+ */
+
+int
+pv_engine_render_file
+(
+   const pv_engine_ops_t * ops,
+   const pv_engine_params_t * params,
+   const char * file,
+   const char * outfile
+)
+{
+   SF_INFO sfinfo;
+   SF_INFO sfout_info;
+   SNDFILE * sf;
+   SNDFILE * sfout = nullptr;
+   ao_device * ao = nullptr;
+   ao_queue_t * aoq = nullptr;
+   pv_engine_t * e;
+   double * left;
+   double * right;
+   double * frames;
+   int result = 0;
+   memset(&sfinfo, 0, sizeof sfinfo);
+   sf = sf_open(file, SFM_READ, &sfinfo);
+   if (is_nullptr(sf))
+   {
+      errprintf("? cannot open %s\n", file);
+      return -1;
+   }
+   sndfile_print_info(&sfinfo);
+   e = pv_engine_new(ops, params);
+   if (is_nullptr(e))
+   {
+      sf_close(sf);
+      return -1;
+   }
+   if (is_nullptr(outfile))
+   {
+      /*
+       * The output thread plays one block while the next is made.
+       */
+
+      ao = ao_init_16_stereo(sfinfo.samplerate, wtrue);
+      if (is_nullptr(ao))
+      {
+         errprintf("? cannot play %s, there is no audio device\n", file);
+         pv_engine_free(e);
+         sf_close(sf);
+         return -1;
+      }
+      aoq = ao_queue_new(ao, sfinfo.samplerate, AO_QUEUE_LATENCY_MS);
+   }
+   else
+   {
+      sfout = sndfile_open_for_write
+      (
+         &sfout_info, outfile, sfinfo.samplerate, sfinfo.channels
+      );
+      if (is_nullptr(sfout))
+      {
+         errprintf("? cannot open %s for writing\n", outfile);
+         pv_engine_free(e);
+         sf_close(sf);
+         return -1;
+      }
+   }
+   left = (double *) malloc(sizeof(double) * PV_ENGINE_BLOCK);
+   right = (double *) malloc(sizeof(double) * PV_ENGINE_BLOCK);
+   frames = (double *) malloc
+   (
+      sizeof(double) * PV_ENGINE_BLOCK * sfinfo.channels
+   );
+   if (is_nullptr(left) || is_nullptr(right) || is_nullptr(frames))
+   {
+      engine_no_memory("pv_engine_render_file");
+      result = -1;
+   }
+   while (result == 0)
+   {
+      long n = sndfile_read
+      (
+         sf, sfinfo, left, right, PV_ENGINE_BLOCK, frames
+      );
+      if (n > 0)
+      {
+         if (sfinfo.channels == 1)
+            memcpy(right, left, sizeof(double) * n);
+
+         if (pv_engine_process_block(e, left, right, n) < 0)
+         {
+            result = -1;
+            break;
+         }
+         if (! render_drain(e, ao, aoq, sfout, &sfout_info, left, right))
+         {
+            errprintf("? cannot write %s\n", outfile);
+            result = -1;
+            break;
+         }
+      }
+      if (n < PV_ENGINE_BLOCK)
+         break;
+   }
+   if (result == 0)
+   {
+      if (pv_engine_flush(e) < 0)
+         result = -1;
+      else if (! render_drain(e, ao, aoq, sfout, &sfout_info, left, right))
+      {
+         errprintf("? cannot write %s\n", outfile);
+         result = -1;
+      }
+   }
+   if (not_nullptr(sfout))
+   {
+      sf_write_sync(sfout);
+      sf_close(sfout);
+   }
+   else
+   {
+      if (not_nullptr(aoq))
+      {
+         ao_queue_drain(aoq);
+         ao_queue_free(aoq);
+      }
+      ao_close(ao);
+   }
+   free(left);
+   free(right);
+   free(frames);
+   pv_engine_free(e);
+   sf_close(sf);
+   return result;
+}
+
+/*
+ * pv-engine.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -24,209 +24,230 @@
 #include "hc.h" /* half-complex format handling routines */
 #include "fft.h" /* windowing() */
 
-#include <sndfile.h> /* libsndfile */
-#include "snd.h"
-
-#include <ao/ao.h> /* ao device */
-#include "ao-wrapper.h"
-
-#include "memory-check.h" /* CHECK_MALLOC() macro */
+#include "pv-engine.h"
 
 
 /* phase vocoder by frequency domain
  * only integer rate is working
  */
-void pv_freq (const char * file, const char * outfile,
-              double rate, long len, long hop_syn,
-              int flag_window)
+
+struct pv_freq
 {
-   /* double amp_lim = 5.0; */
-   double amp_lim = 0.0;
-   int i;
-   long len_out;
+   long len;
+   long len_out; /* len * iscale */
    int iscale;
-   double * left = NULL;
-   double * right = NULL;
-
-   SNDFILE * sf = NULL;
-   SF_INFO sfinfo; /* libsndfile version */
-
-   int status;
-   ao_device * ao = NULL;
-   SNDFILE * sfout = NULL;
-   SF_INFO sfout_info;
-
-   double * time = NULL;
-   double * freq = NULL;
-   double * t_out = NULL;
-   double * f_out = NULL;
-   double * l_out = NULL;
-   double * r_out = NULL;
-   double * phs = NULL;
-   double * amp = NULL;
-   double * p_out = NULL;
-   double * a_out = NULL;
-   int step = 0;
+   int flag_window;
+   double amp_lim;
+
+   double * left;  /* [len], the input frame */
+   double * right; /* [len] */
 
+   /* both channels in one complex FFT, see apply_FFT_stereo() */
+   double * time;
+   double * freq;
    fftw_plan plan;
+
+   double * f_out; /* [len_out] */
+   double * t_out;
    fftw_plan plan_inv;
 
-   memset (&sfinfo, 0, sizeof (sfinfo));
-   sf = sf_open (file, SFM_READ, &sfinfo); /* open the input file */
-   if (sf == NULL)
-   {
-      fprintf (stderr, "fail to open %s\n", file);
-      exit (1);
-   }
-   sndfile_print_info (&sfinfo);
+   double * phs;
+   double * amp;
+   double * r_amp;
+   double * r_phs;
 
-   /* allocate buffers  */
+   long cur; /* starting frame of the next frame */
+};
 
-   left  = (double *) malloc (sizeof (double) * len);
-   right = (double *) malloc (sizeof (double) * len);
-   CHECK_MALLOC (left,  "pv_freq");
-   CHECK_MALLOC (right, "pv_freq");
+static void
+pv_freq_engine_free (void * state)
+{
+   struct pv_freq * pv = (struct pv_freq *)state;
 
-   /* now only integer rate is working */
+   free (pv->left);
+   free (pv->right);
 
-   iscale = (int)rate;
-   len_out = len * (long)iscale;
+   if (pv->plan != NULL)
+   {
+      fftw_destroy_plan (pv->plan);
+   }
+   fftw_free (pv->time);
+   fftw_free (pv->freq);
+
+   if (pv->plan_inv != NULL)
+   {
+      fftw_destroy_plan (pv->plan_inv);
+   }
+   fftw_free (pv->t_out);
+   fftw_free (pv->f_out);
+
+   free (pv->phs);
+   free (pv->amp);
+   free (pv->r_phs);
+   free (pv->r_amp);
+   free (pv);
+}
 
-   /* prepare the output */
+static void *
+pv_freq_engine_init (const pv_engine_params_t * params,
+                     pv_engine_shape_t * shape)
+{
+   struct pv_freq * pv;
+   long len = params->len;
 
-   if (outfile == NULL)
+   /* now only integer rate is working */
+   if ((int)params->rate < 1)
    {
-      ao = ao_init_16_stereo (sfinfo.samplerate, 1 /* verbose */);
+      return (NULL);
    }
-   else
+
+   /* the pointers are NULL until allocated, for the free function */
+   pv = (struct pv_freq *) calloc (1, sizeof (struct pv_freq));
+   if (pv == NULL)
    {
-      sfout = sndfile_open_for_write (&sfout_info,
-                                      outfile,
-                                      sfinfo.samplerate,
-                                      sfinfo.channels);
-      if (sfout == NULL)
-      {
-         fprintf (stderr, "fail to open file %s\n", outfile);
-         exit (1);
-      }
+      return (NULL);
    }
+   pv->len = len;
+   pv->iscale = (int)params->rate;
+   pv->len_out = len * (long)pv->iscale;
+   pv->flag_window = params->flag_window;
+   /* pv->amp_lim = 5.0; */
+   pv->amp_lim = 0.0;
 
-   /* initialization plan for FFTW  */
+   pv->left  = (double *) malloc (sizeof (double) * len);
+   pv->right = (double *) malloc (sizeof (double) * len);
 
-   time = (double *)fftw_malloc (len * sizeof(double));
-   freq = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (time, "pv_freq");
-   CHECK_MALLOC (freq, "pv_freq");
-   plan = fftw_plan_r2r_1d (len, time, freq, FFTW_R2HC, FFTW_ESTIMATE);
+   pv->time = (double *)fftw_malloc (2 * len * sizeof(double));
+   pv->freq = (double *)fftw_malloc (2 * len * sizeof(double));
 
-   f_out = (double *)fftw_malloc (len_out * sizeof(double));
-   t_out = (double *)fftw_malloc (len_out * sizeof(double));
-   CHECK_MALLOC (f_out, "pv_freq");
-   CHECK_MALLOC (t_out, "pv_freq");
-   plan_inv = fftw_plan_r2r_1d (len_out, f_out, t_out,
-                                FFTW_HC2R, FFTW_ESTIMATE);
+   pv->f_out = (double *)fftw_malloc (pv->len_out * sizeof(double));
+   pv->t_out = (double *)fftw_malloc (pv->len_out * sizeof(double));
 
-   l_out = (double *)malloc (len_out * sizeof(double));
-   r_out = (double *)malloc (len_out * sizeof(double));
-   CHECK_MALLOC (l_out, "pv_freq");
-   CHECK_MALLOC (r_out, "pv_freq");
+   pv->phs = (double *)malloc (((len / 2) + 1) * sizeof(double));
+   pv->amp = (double *)malloc (((len / 2) + 1) * sizeof(double));
 
-   phs = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   amp = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (phs, "pv_freq");
-   CHECK_MALLOC (amp, "pv_freq");
+   pv->r_phs = (double *)malloc (((len / 2) + 1) * sizeof(double));
+   pv->r_amp = (double *)malloc (((len / 2) + 1) * sizeof(double));
 
-   p_out = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   a_out = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (p_out, "pv_freq");
-   CHECK_MALLOC (a_out, "pv_freq");
+   if (pv->left == NULL || pv->right == NULL ||
+       pv->time == NULL || pv->freq == NULL ||
+       pv->f_out == NULL || pv->t_out == NULL ||
+       pv->phs == NULL || pv->amp == NULL ||
+       pv->r_phs == NULL || pv->r_amp == NULL)
+   {
+      pv_freq_engine_free (pv);
+      return (NULL);
+   }
 
+   pv->plan = plan_FFT_stereo (len, pv->time, pv->freq);
+   pv->plan_inv = fftw_plan_r2r_1d (pv->len_out, pv->f_out, pv->t_out,
+                                    FFTW_HC2R, FFTW_ESTIMATE);
 
-   while (sndfile_read (sf, sfinfo, left, right, len) != 0)
+   pv->cur = 0;
+
+   /* no overlap, and no resampling */
+   shape->block   = pv->len_out;
+   shape->hop_res = pv->len_out;
+   shape->tail    = 0;
+   return (pv);
+}
+
+/* synthesize one channel into out[len_out]
+ */
+static void
+pv_freq_synth (struct pv_freq * pv,
+               double * amp, const double * phs,
+               double * out)
+{
+   int i;
+
+   /* cut signal of amp < amp_lim */
+   for (i = 0; i < (pv->len / 2) + 1; i ++)
+   {
+      if (amp [i] < pv->amp_lim) amp [i] = 0.0;
+   }
+
+   /* prepare f_out[]; now iscale = 2 */
+   polar_to_HC_scale (pv->len, amp, phs, 0, pv->iscale, pv->f_out);
+   fftw_execute (pv->plan_inv); /* f_out[] -> t_out[] */
+   for (i = 0; i < pv->len_out; i ++)
    {
-      /* left channel */
-      apply_FFT (len, left, flag_window, plan, time, freq, 2.0, amp, phs);
-
-      /* cut signal of amp < amp_lim */
-      for (i = 0; i < (len / 2) + 1; i ++)
-      {
-         if (amp [i] < amp_lim) amp [i] = 0.0;
-      }
-
-      /* prepare f_out[]; now iscale = 2 */
-      polar_to_HC_scale (len, amp, phs, 0, iscale, f_out);
-      fftw_execute (plan_inv); /* f_out[] -> t_out[] */
-      for (i = 0; i < len_out; i ++)
-      {
-         l_out [i] = t_out [i] / (double)len;
-      }
-
-
-      /* right channel */
-      apply_FFT (len, right, flag_window, plan, time, freq, 2.0, amp, phs);
-
-      /* cut signal of amp < amp_lim */
-      for (i = 0; i < (len / 2) + 1; i ++)
-      {
-         if (amp [i] < amp_lim) amp [i] = 0.0;
-      }
-
-      /* prepare f_out[]; now iscale = 2 */
-      polar_to_HC_scale (len, amp, phs, 0, iscale, f_out);
-      fftw_execute (plan_inv); /* f_out[] -> t_out[] */
-      for (i = 0; i < len_out; i ++)
-      {
-         r_out [i] = t_out [i] / (double)len;
-      }
-
-
-      /* output */
-      if (outfile == NULL)
-      {
-         status = ao_write (ao, l_out, r_out, hop_syn);
-         status /= 4; /* 2 bytes for 2 channels */
-      }
-      else
-      {
-         status = sndfile_write (sfout, sfout_info, l_out, r_out, len_out);
-      }
-
-      step ++;
+      out [i] = pv->t_out [i] / (double)pv->len;
    }
+}
 
+/* len_out frames of the output for each len frames of the input,
+ * see pv-engine.h.  the last frame is padded by zero.
+ */
+static long
+pv_freq_engine_process_block (void * state,
+                              pv_engine_input_t * in,
+                              double * left, double * right)
+{
+   struct pv_freq * pv = (struct pv_freq *)state;
+   long status;
 
-   sf_close (sf);
-   if (outfile == NULL)
+   status = pv_engine_input_read_at (in, pv->cur,
+                                     pv->left, pv->right, pv->len);
+   if (status == PV_ENGINE_MORE)
    {
-      ao_close (ao);
+      return (PV_ENGINE_MORE);
    }
-   else
+   else if (status == 0)
    {
-      /* frames left in l_out[] and r_out[] */
-      status = sndfile_write (sfout, sfout_info, l_out, r_out, len);
-      sf_write_sync (sfout);
-      sf_close (sfout);
+      return (PV_ENGINE_END);
    }
 
-   free (left);
-   free (right);
+   apply_FFT_stereo (pv->len, pv->left, pv->right, pv->flag_window,
+                     pv->plan, pv->time, pv->freq,
+                     2.0, pv->amp, pv->phs, pv->r_amp, pv->r_phs);
 
-   free (time);
-   free (freq);
-   fftw_destroy_plan (plan);
+   /* left channel */
+   pv_freq_synth (pv, pv->amp, pv->phs, left);
+   /* right channel */
+   pv_freq_synth (pv, pv->r_amp, pv->r_phs, right);
+
+   pv->cur += pv->len;
+   in->keep = pv->cur;
+   return (pv->len_out);
+}
 
-   free (t_out);
-   free (f_out);
-   fftw_destroy_plan (plan_inv);
+static long
+pv_freq_engine_flush (void * state,
+                      double * left, double * right)
+{
+   /* the frames do not overlap, so nothing is left */
+   return (0);
+}
 
-   free (l_out);
-   free (r_out);
+const pv_engine_ops_t pv_freq_engine =
+{
+   "freq",
+   "PV by frequency domain (integer rates only)",
+   pv_freq_engine_init,
+   pv_freq_engine_process_block,
+   pv_freq_engine_flush,
+   pv_freq_engine_free
+};
+
+/* play or write the file through pv_freq_engine
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
+ */
+int pv_freq (const char * file, const char * outfile,
+             double rate, long len, long hop_syn,
+             int flag_window)
+{
+   pv_engine_params_t params;
 
-   free (phs);
-   free (amp);
+   pv_engine_params_init (&params);
+   params.len = len;
+   params.hop_syn = hop_syn;
+   params.rate = rate;
+   params.flag_window = flag_window;
 
-   free (p_out);
-   free (a_out);
+   return (pv_engine_render_file (&pv_freq_engine, &params,
+                                  file, outfile));
 }
 
 /*
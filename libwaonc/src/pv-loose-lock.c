@@ -23,16 +23,13 @@
 
 #include <fftw3.h> /* FFTW library */
 #include "hc.h" /* half-complex format handling routines */
-#include "fft.h" /* windowing(), apply_FFT() */
+#include "fft.h" /* windowing(), apply_FFT_stereo() */
 
 #include <sndfile.h> /* libsndfile */
-#include "snd.h"
-
 #include <ao/ao.h> /* ao device */
-#include "ao-wrapper.h"
 
-#include "memory-check.h" /* CHECK_MALLOC() macro */
-#include "pv-conventional.h" /* pv_play_resample() */
+#include "pv-conventional.h" /* get_scale_factor_for_window() */
+#include "pv-engine.h"
 
 
 /* puckette's loose phase lock scheme in conventional form
@@ -40,336 +37,347 @@
  * References: M.Puckette (1995)
  *             J.Laroche and M.Dolson (1999)
  */
-void pv_loose_lock (const char * file, const char * outfile,
-                    double rate, double pitch_shift,
-                    long len, long hop_syn,
-                    int flag_window)
-{
-   long hop_res = (long)((double)hop_syn * pow (2.0, - pitch_shift / 12.0));
-   long hop_ana = (long)((double)hop_res * rate);
-   double twopi = 2.0 * M_PI;
-   int i;
-   int k;
-   long read_status; /* open the input file */
-   SNDFILE * sf = NULL;
-   SF_INFO sfinfo; /* libsndfile version */
-   double * left = NULL;
-   double * right = NULL;
-
-   /* int status; */
-
-   ao_device * ao = NULL;
-   SNDFILE * sfout = NULL;
-   SF_INFO sfout_info;
 
+struct pv_loose_lock
+{
+   long len;
+   long hop_syn;
+   long hop_ana;
+   int flag_window;
    double window_scale;
-   double * time = NULL;
-   double * freq = NULL;
-   double * t_out = NULL;
-   double * f_out = NULL;
-   double * amp = NULL;
-   double * ph_in = NULL;
-   double * ph_out = NULL;
-   double * l_ph_in_old = NULL;
-   double * r_ph_in_old = NULL;
-   double * z = NULL;
-   double * l_ph_z = NULL;
-   double * r_ph_z = NULL;
-   double * l_out = NULL;
-   double * r_out = NULL;
-   double * omega = NULL;
-   int flag_ph = 0;
 
+   double * left;  /* [len], the input frame */
+   double * right; /* [len] */
+
+   /* both channels in one complex FFT, see apply_FFT_stereo() */
+   double * time;
+   double * freq;
    fftw_plan plan;
+
+   double * f_out;
+   double * t_out;
    fftw_plan plan_inv;
 
-   memset (&sfinfo, 0, sizeof (sfinfo));
-   sf = sf_open (file, SFM_READ, &sfinfo);
-   if (sf == NULL)
+   double * amp;
+   double * ph_in;
+   double * r_amp;
+   double * r_ph_in;
+   double * ph_out; /* shared by both channels */
+   double * l_ph_in_old;
+   double * r_ph_in_old;
+   double * z;
+   double * l_ph_z;
+   double * r_ph_z;
+   double * omega; /* expected frequency */
+
+   double * l_out; /* [hop_syn + len], overlap-add buffers */
+   double * r_out;
+
+   int flag_ph; /* 0 until the phases are initialized */
+   long cur;    /* starting frame of the next hop */
+};
+
+static void
+pv_loose_lock_engine_free (void * state)
+{
+   struct pv_loose_lock * pv = (struct pv_loose_lock *)state;
+
+   free (pv->left);
+   free (pv->right);
+   if (pv->plan != NULL)
    {
-      fprintf (stderr, "fail to open %s\n", file);
-      exit (1);
+      fftw_destroy_plan (pv->plan);
    }
-   sndfile_print_info (&sfinfo);
-
-   /* allocate buffers  */
-
-   left  = (double *) malloc (sizeof (double) * len);
-   right = (double *) malloc (sizeof (double) * len);
-   CHECK_MALLOC (left,  "pv_loose_lock");
-   CHECK_MALLOC (right, "pv_loose_lock");
+   fftw_free (pv->time);
+   fftw_free (pv->freq);
+   if (pv->plan_inv != NULL)
+   {
+      fftw_destroy_plan (pv->plan_inv);
+   }
+   fftw_free (pv->t_out);
+   fftw_free (pv->f_out);
+   free (pv->amp);
+   free (pv->ph_in);
+   free (pv->r_amp);
+   free (pv->r_ph_in);
+   free (pv->ph_out);
+   free (pv->l_ph_in_old);
+   free (pv->r_ph_in_old);
+   free (pv->z);
+   free (pv->l_ph_z);
+   free (pv->r_ph_z);
+   free (pv->l_out);
+   free (pv->r_out);
+   free (pv->omega);
+   free (pv);
+}
 
-   /* prepare the output */
+static void *
+pv_loose_lock_engine_init (const pv_engine_params_t * params,
+                           pv_engine_shape_t * shape)
+{
+   struct pv_loose_lock * pv;
+   long len = params->len;
+   long hop_syn = params->hop_syn;
+   long hop_res = (long)((double)hop_syn
+                         * pow (2.0, - params->pitch_shift / 12.0));
+   long hop_ana = (long)((double)hop_res * params->rate);
+   double twopi = 2.0 * M_PI;
+   int k;
 
-   if (outfile == NULL)
+   if (hop_res <= 0 || hop_ana <= 0)
    {
-      ao = ao_init_16_stereo (sfinfo.samplerate, 1 /* verbose */);
+      return (NULL);
    }
-   else
+
+   /* the pointers are NULL until allocated, for the free function */
+   pv = (struct pv_loose_lock *) calloc (1, sizeof (struct pv_loose_lock));
+   if (pv == NULL)
    {
-      sfout = sndfile_open_for_write (&sfout_info,
-                                      outfile,
-                                      sfinfo.samplerate,
-                                      sfinfo.channels);
-      if (sfout == NULL)
-      {
-         fprintf (stderr, "fail to open file %s\n", outfile);
-         exit (1);
-      }
+      return (NULL);
    }
+   pv->len = len;
+   pv->hop_syn = hop_syn;
+   pv->hop_ana = hop_ana;
+   pv->flag_window = params->flag_window;
+   pv->window_scale = get_scale_factor_for_window (len, hop_syn,
+                                                   params->flag_window);
 
-   window_scale = get_scale_factor_for_window (len, hop_syn, flag_window);
+   pv->left  = (double *) malloc (sizeof (double) * len);
+   pv->right = (double *) malloc (sizeof (double) * len);
 
-   /* initialization plan for FFTW  */
+   pv->time = (double *)fftw_malloc (2 * len * sizeof(double));
+   pv->freq = (double *)fftw_malloc (2 * len * sizeof(double));
 
-   time = (double *)fftw_malloc (len * sizeof(double));
-   freq = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (time, "pv_loose_lock");
-   CHECK_MALLOC (freq, "pv_loose_lock");
-   plan = fftw_plan_r2r_1d (len, time, freq, FFTW_R2HC, FFTW_ESTIMATE);
+   pv->f_out = (double *)fftw_malloc (len * sizeof(double));
+   pv->t_out = (double *)fftw_malloc (len * sizeof(double));
 
-   f_out = (double *)fftw_malloc (len * sizeof(double));
-   t_out = (double *)fftw_malloc (len * sizeof(double));
-   CHECK_MALLOC (f_out, "pv_loose_lock");
-   CHECK_MALLOC (t_out, "pv_loose_lock");
-   plan_inv = fftw_plan_r2r_1d (len, f_out, t_out,
-                                FFTW_HC2R, FFTW_ESTIMATE);
+   pv->amp = (double *)calloc ((len / 2) + 1, sizeof(double));
 
-   amp = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (amp, "pv_loose_lock");
+   pv->ph_in  = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->ph_out = (double *)calloc ((len / 2) + 1, sizeof(double));
 
-   ph_in  = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   ph_out = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (ph_in,  "pv_loose_lock");
-   CHECK_MALLOC (ph_out, "pv_loose_lock");
+   pv->r_amp   = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_ph_in = (double *)calloc ((len / 2) + 1, sizeof(double));
 
-   l_ph_in_old = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_ph_in_old = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (l_ph_in_old, "pv_loose_lock");
-   CHECK_MALLOC (r_ph_in_old, "pv_loose_lock");
+   pv->l_ph_in_old = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_ph_in_old = (double *)calloc ((len / 2) + 1, sizeof(double));
 
-   for (i = 0; i < (len / 2) + 1; i ++)
-   {
-      ph_in [i]      = 0.0;
-      ph_out [i]     = 0.0;
-      l_ph_in_old [i]  = 0.0;
-      r_ph_in_old [i]  = 0.0;
-   }
+   pv->z = (double *)malloc (len * sizeof(double));
 
-   z = (double *)malloc (len * sizeof(double));
-   CHECK_MALLOC (z, "pv_loose_lock");
+   pv->l_ph_z = (double *)calloc ((len / 2) + 1, sizeof(double));
+   pv->r_ph_z = (double *)calloc ((len / 2) + 1, sizeof(double));
 
-   l_ph_z = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   r_ph_z = (double *)malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (l_ph_z, "pv_loose_lock");
-   CHECK_MALLOC (r_ph_z, "pv_loose_lock");
+   pv->l_out = (double *) calloc (hop_syn + len, sizeof(double));
+   pv->r_out = (double *) calloc (hop_syn + len, sizeof(double));
 
-   l_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   r_out = (double *) malloc ((hop_syn + len) * sizeof(double));
-   CHECK_MALLOC (l_out, "pv_loose_lock");
-   CHECK_MALLOC (r_out, "pv_loose_lock");
-   for (i = 0; i < (hop_syn + len); i ++)
-   {
-      l_out [i] = 0.0;
-      r_out [i] = 0.0;
-   }
+   pv->omega = (double *) malloc (((len / 2) + 1) * sizeof(double));
 
-   omega = (double *) malloc (((len / 2) + 1) * sizeof(double));
-   CHECK_MALLOC (omega, "pv_loose_lock");
-   for (k = 0; k < (len / 2) + 1; k ++)
+   if (pv->left == NULL || pv->right == NULL ||
+       pv->time == NULL || pv->freq == NULL ||
+       pv->f_out == NULL || pv->t_out == NULL ||
+       pv->amp == NULL || pv->ph_in == NULL ||
+       pv->ph_out == NULL || pv->r_amp == NULL ||
+       pv->r_ph_in == NULL || pv->l_ph_in_old == NULL ||
+       pv->r_ph_in_old == NULL || pv->z == NULL ||
+       pv->l_ph_z == NULL || pv->r_ph_z == NULL ||
+       pv->l_out == NULL || pv->r_out == NULL ||
+       pv->omega == NULL)
    {
-      omega [k] = twopi * (double)k / (double)len;
+      pv_loose_lock_engine_free (pv);
+      return (NULL);
    }
 
+   pv->plan = plan_FFT_stereo (len, pv->time, pv->freq);
+   pv->plan_inv = fftw_plan_r2r_1d (len, pv->f_out, pv->t_out,
+                                    FFTW_HC2R, FFTW_ESTIMATE);
 
-   /* read the first frame */
-   read_status = sndfile_read (sf, sfinfo, left, right, len);
-   if (read_status != len)
+   for (k = 0; k < (len / 2) + 1; k ++)
    {
-      exit (1);
+      pv->omega [k] = twopi * (double)k / (double)len;
    }
 
-   for (;;)
-   {
-      /* left channel */
-      apply_FFT (len, left, flag_window, plan, time, freq,
-                 1.0,
-                 amp, ph_in);
+   pv->flag_ph = 0;
+   pv->cur = 0;
 
-      if (flag_ph == 0)
-      {
-         /* initialize phase */
-         for (k = 0; k < (len / 2) + 1; k ++)
-         {
-            ph_out [k] = ph_in [k] * (double)hop_syn / (double)hop_ana;
-            /* ph_out [k] = ph_in [k]; */
-
-            /* backup for the next step */
-            l_ph_in_old [k] = ph_in [k];
-            l_ph_z [k] = ph_out [k];
-         }
-         /* flag_ph = 1; later we have the process for the right channel */
-      }
-      else
-      {
-         /* only for imag components who have phase */
-         for (k = 1; k < (len + 1) / 2; k ++)
-         {
-            /* standard phase vocoder */
-            double dphi;
-            dphi = ph_in [k] - l_ph_in_old [k] - omega [k] * (double)hop_ana;
-            for (; dphi >= M_PI; dphi -= twopi);
-            for (; dphi < -M_PI; dphi += twopi);
-
-            ph_out [k] = l_ph_z [k]
-                         + dphi * (double)hop_syn / (double)hop_ana
-                         + omega [k] * (double)hop_syn;
-
-            /* backup for the next step */
-            l_ph_in_old [k] = ph_in [k];
-         }
-      }
-      polar_to_HC (len, amp, ph_out, 0, f_out); /* (amp, ph_out) -> f_out[] */
-
-      /* calc. ph_z for the next step */
-      HC_puckette_lock (len, f_out, z); /* f_out[] -> z[] */
-      HC_to_polar (len, z, 0, amp, l_ph_z); /* z[] -> (amp, ph_z) */
-      /* note that amp[] here is not used */
-
-      fftw_execute (plan_inv); /* f_out[] -> t_out[] */
-      /* scale by len and windowing */
-      windowing (len, t_out, flag_window, (double)len * window_scale, t_out);
-      /* superimpose */
-      for (i = 0; i < len; i ++)
-      {
-         l_out [hop_syn + i] += t_out [i];
-      }
+   shape->block   = hop_syn;
+   shape->hop_res = hop_res;
+   shape->tail    = len;
+   return (pv);
+}
 
-      /* right channel */
-      apply_FFT (len, right, flag_window, plan, time, freq,
-                 1.0,
-                 amp, ph_in);
+/* one channel of the hop, superimposed on out[hop_syn, hop_syn + len]
+ * INPUT
+ *  amp[len/2+1], ph_in[len/2+1] : the input frame
+ *  ph_in_old[len/2+1], ph_z[len/2+1] : the phases of the last hop
+ * OUTPUT
+ *  ph_in_old[], ph_z[] : for the next hop
+ *  amp[] : overwritten (not used later)
+ */
+static void
+pv_loose_lock_channel (struct pv_loose_lock * pv,
+                       double * amp, const double * ph_in,
+                       double * ph_in_old, double * ph_z,
+                       double * out)
+{
+   double twopi = 2.0 * M_PI;
+   long len = pv->len;
+   int i;
+   int k;
 
-      if (flag_ph == 0)
-      {
-         /* initialize phase */
-         for (k = 0; k < (len / 2) + 1; k ++)
-         {
-            ph_out [k] = ph_in [k] * (double)hop_syn / (double)hop_ana;
-            /* ph_out [k] = ph_in [k]; */
-
-            /* backup for the next step */
-            r_ph_in_old [k] = ph_in [k];
-            r_ph_z [k] = ph_out [k];
-         }
-         flag_ph = 1;
-      }
-      else
-      {
-         /* only for imag components who have phase */
-         for (k = 1; k < (len + 1) / 2; k ++)
-         {
-            /* standard phase vocoder */
-            double dphi;
-            dphi = ph_in [k] - r_ph_in_old [k] - omega [k] * (double)hop_ana;
-            for (; dphi >= M_PI; dphi -= twopi);
-            for (; dphi < -M_PI; dphi += twopi);
-
-            ph_out [k] = r_ph_z [k]
-                         + dphi * (double)hop_syn / (double)hop_ana
-                         + omega [k] * (double)hop_syn;
-
-            /* backup for the next step */
-            r_ph_in_old [k] = ph_in [k];
-         }
-      }
-      polar_to_HC (len, amp, ph_out, 0, f_out); /* (amp, ph_out) -> f_out[] */
-
-      /* calc. ph_z for the next step */
-      HC_puckette_lock (len, f_out, z); /* f_out[] -> z[] */
-      HC_to_polar (len, z, 0, amp, r_ph_z); /* z[] -> (amp, r_ph_z) */
-      /* note that amp[] here is not used */
-
-      fftw_execute (plan_inv); /* f_out[] -> t_out[] */
-      /* scale by len and windowing */
-      windowing (len, t_out, flag_window, (double)len * window_scale, t_out);
-      /* superimpose */
-      for (i = 0; i < len; i ++)
+   if (pv->flag_ph == 0)
+   {
+      /* initialize phase */
+      for (k = 0; k < (len / 2) + 1; k ++)
       {
-         r_out [hop_syn + i] += t_out [i];
-      }
-
-
-      /* output */
-      /* status = */ pv_play_resample (hop_res, hop_syn, l_out, r_out,
-                                 ao, sfout, &sfout_info);
-
+         pv->ph_out [k] = ph_in [k] * (double)pv->hop_syn / (double)pv->hop_ana;
 
-      /* shift acc_out by hop_syn */
-      for (i = 0; i < len; i ++)
-      {
-         l_out [i] = l_out [i + hop_syn];
-         r_out [i] = r_out [i + hop_syn];
+         /* backup for the next step */
+         ph_in_old [k] = ph_in [k];
+         ph_z [k] = pv->ph_out [k];
       }
-      for (i = len; i < len + hop_syn; i ++)
+   }
+   else
+   {
+      /* only for imag components who have phase */
+      for (k = 1; k < (len + 1) / 2; k ++)
       {
-         l_out [i] = 0.0;
-         r_out [i] = 0.0;
+         /* standard phase vocoder */
+         double dphi;
+         dphi = ph_in [k] - ph_in_old [k] - pv->omega [k] * (double)pv->hop_ana;
+         for (; dphi >= M_PI; dphi -= twopi);
+         for (; dphi < -M_PI; dphi += twopi);
+
+         pv->ph_out [k] = ph_z [k]
+                          + dphi * (double)pv->hop_syn / (double)pv->hop_ana
+                          + pv->omega [k] * (double)pv->hop_syn;
+
+         /* backup for the next step */
+         ph_in_old [k] = ph_in [k];
       }
+   }
+   /* (amp, ph_out) -> f_out[] */
+   polar_to_HC (len, amp, pv->ph_out, 0, pv->f_out);
+
+   /* calc. ph_z for the next step */
+   HC_puckette_lock (len, pv->f_out, pv->z); /* f_out[] -> z[] */
+   HC_to_polar (len, pv->z, 0, amp, ph_z); /* z[] -> (amp, ph_z) */
+   /* note that amp[] here is not used */
+
+   fftw_execute (pv->plan_inv); /* f_out[] -> t_out[] */
+   /* scale by len and windowing */
+   windowing (len, pv->t_out, pv->flag_window,
+              (double)len * pv->window_scale, pv->t_out);
+   /* superimpose */
+   for (i = 0; i < len; i ++)
+   {
+      out [pv->hop_syn + i] += pv->t_out [i];
+   }
+}
 
+/* one hop_syn of the output, see pv-engine.h
+ * the last frame is the last one that fits in the input completely.
+ */
+static long
+pv_loose_lock_engine_process_block (void * state,
+                                    pv_engine_input_t * in,
+                                    double * left, double * right)
+{
+   struct pv_loose_lock * pv = (struct pv_loose_lock *)state;
+   long status;
+   int i;
 
-      /* for the next step */
-      for (i = 0; i < (len - hop_ana); i ++)
-      {
-         left  [i]  = left  [i + hop_ana];
-         right  [i] = right  [i + hop_ana];
-      }
-
-      /* read next segment */
-      read_status = sndfile_read (sf, sfinfo,
-                                  left  + len - hop_ana,
-                                  right + len - hop_ana,
-                                  hop_ana);
-      if (read_status != hop_ana)
-      {
-         /* most likely, it is EOF. */
-         break;
-      }
+   status = pv_engine_input_read_at (in, pv->cur,
+                                     pv->left, pv->right, pv->len);
+   if (status == PV_ENGINE_MORE)
+   {
+      return (PV_ENGINE_MORE);
+   }
+   else if (status != pv->len)
+   {
+      /* most likely, it is EOF. */
+      return (PV_ENGINE_END);
    }
 
-
-   sf_close (sf);
-   if (outfile == NULL)
+   apply_FFT_stereo (pv->len, pv->left, pv->right, pv->flag_window,
+                     pv->plan, pv->time, pv->freq,
+                     1.0,
+                     pv->amp, pv->ph_in, pv->r_amp, pv->r_ph_in);
+
+   /* left channel */
+   pv_loose_lock_channel (pv, pv->amp, pv->ph_in,
+                          pv->l_ph_in_old, pv->l_ph_z, pv->l_out);
+   /* right channel */
+   pv_loose_lock_channel (pv, pv->r_amp, pv->r_ph_in,
+                          pv->r_ph_in_old, pv->r_ph_z, pv->r_out);
+   pv->flag_ph = 1;
+
+   /* output */
+   memcpy (left,  pv->l_out, sizeof (double) * pv->hop_syn);
+   memcpy (right, pv->r_out, sizeof (double) * pv->hop_syn);
+
+   /* shift acc_out by hop_syn */
+   for (i = 0; i < pv->len; i ++)
    {
-      ao_close (ao);
+      pv->l_out [i] = pv->l_out [i + pv->hop_syn];
+      pv->r_out [i] = pv->r_out [i + pv->hop_syn];
    }
-   else
+   for (i = pv->len; i < pv->len + pv->hop_syn; i ++)
    {
-      /* frames left in l_out[] and r_out[] */
-      /* status = */ sndfile_write (sfout, sfout_info, l_out, r_out, len);
-      sf_write_sync (sfout);
-      sf_close (sfout);
+      pv->l_out [i] = 0.0;
+      pv->r_out [i] = 0.0;
    }
 
-   free (left);
-   free (right);
-   free (time);
-   free (freq);
-   fftw_destroy_plan (plan);
-   free (t_out);
-   free (f_out);
-   fftw_destroy_plan (plan_inv);
-   free (amp);
-   free (ph_in);
-   free (ph_out);
-   free (l_ph_in_old);
-   free (r_ph_in_old);
-   free (z);
-   free (l_ph_z);
-   free (r_ph_z);
-   free (l_out);
-   free (r_out);
-   free (omega);
+   /* for the next step */
+   pv->cur += pv->hop_ana;
+   in->keep = pv->cur;
+   return (pv->hop_syn);
+}
+
+static long
+pv_loose_lock_engine_flush (void * state,
+                            double * left, double * right)
+{
+   struct pv_loose_lock * pv = (struct pv_loose_lock *)state;
+
+   /* frames left in l_out[] and r_out[] */
+   memcpy (left,  pv->l_out, sizeof (double) * pv->len);
+   memcpy (right, pv->r_out, sizeof (double) * pv->len);
+   return (pv->len);
+}
+
+const pv_engine_ops_t pv_loose_lock_engine =
+{
+   "loose-lock",
+   "Puckette's loose-locking PV in conventional form",
+   pv_loose_lock_engine_init,
+   pv_loose_lock_engine_process_block,
+   pv_loose_lock_engine_flush,
+   pv_loose_lock_engine_free
+};
+
+/* play or write the file through pv_loose_lock_engine
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
+ */
+int
+pv_loose_lock (const char * file, const char * outfile,
+               double rate, double pitch_shift,
+               long len, long hop_syn,
+               int flag_window)
+{
+   pv_engine_params_t params;
+
+   pv_engine_params_init (&params);
+   params.len = len;
+   params.hop_syn = hop_syn;
+   params.rate = rate;
+   params.pitch_shift = pitch_shift;
+   params.flag_window = flag_window;
+   params.src_quality = SRC_SINC_BEST_QUALITY; /* the best converter */
+
+   return (pv_engine_render_file (&pv_loose_lock_engine, &params,
+                                  file, outfile));
 }
 
 /*
@@ -19,61 +19,36 @@
 #include <stdlib.h> /* malloc() */
 #include <string.h> /* memset() */
 #include <math.h>   /* pow() */
-#include "memory-check.h" /* CHECK_MALLOC() macro */
 
 #include "pv-complex.h" /* struct pv_complex, pv_complex_play_resample() */
 #include "fft.h"        /* windowing() */
-
-#include <sndfile.h> /* libsndfile */
-#include "snd.h" /* sndfile_read_at() */
-
-#include <ao/ao.h> /* ao device */
-#include "ao-wrapper.h"
+#include "pv-engine.h"
 #include "pv-nofft.h"
 
 
-/* play one hop_syn by the phase vocoder without FFT
- * INPUT
- *  pv : struct pv_complex
- *  cur : current frame to play.
- *        you have to increment this by yourself.
- *  pv->flag_lock : 0 == no phase lock
- *                  1 == loose phase lock
- * OUTPUT (returned value)
- *  status : output frames (should be hop_res)
+/* make one hop_syn by the phase vocoder without FFT, without playing it
+ * (see pv_nofft_play_step())
+ * OUTPUT
+ *  pv->[lr]_out[0, hop_syn] : the frames to play, before the shift
+ *                             by pv_complex_shift_out()
+ *  returned value : pv->len on success, otherwise the status of
+ *                   pv_complex_read_at() (nothing is made then)
  */
 long
-pv_nofft_play_step (struct pv_complex * pv,
-                    long cur)
+pv_nofft_synth_step (struct pv_complex * pv,
+                     long cur)
 {
-   int n = 0;
-   static double * left  = NULL;
-   static double * right = NULL;
+   double * left  = pv->l_read; /* the work arrays of this pv */
+   double * right = pv->r_read;
    long status;
    int i;
-   if (left == NULL)
-   {
-      left  = (double *)malloc (sizeof (double) * pv->len);
-      right = (double *)malloc (sizeof (double) * pv->len);
-      CHECK_MALLOC (left,  "read_and_FFT_stereo");
-      CHECK_MALLOC (right, "read_and_FFT_stereo");
-      n = pv->len;
-   }
-   else if (n < pv->len)
-   {
-      left  = (double *)realloc (left,  sizeof (double) * pv->len);
-      right = (double *)realloc (right, sizeof (double) * pv->len);
-      CHECK_MALLOC (left,  "read_and_FFT_stereo");
-      CHECK_MALLOC (right, "read_and_FFT_stereo");
-      n = pv->len;
-   }
 
    /* read [cur, cur+len] => left, right [len] */
 
-   status = sndfile_read_at (pv->sf, *(pv->sfinfo), cur, left, right, pv->len);
+   status = pv_complex_read_at (pv, cur, left, right, pv->len);
    if (status != pv->len)
    {
-      return 0; /* no output */
+      return (status); /* no output */
    }
 
    windowing (pv->len, left,  pv->flag_window, pv->window_scale, left);
@@ -85,114 +60,167 @@ pv_nofft_play_step (struct pv_complex * pv,
       pv->r_out[pv->hop_syn + i] += right[i];
    }
 
+   return (status);
+}
+
+/* play one hop_syn by the phase vocoder without FFT
+ * INPUT
+ *  pv : struct pv_complex
+ *  cur : current frame to play.
+ *        you have to increment this by yourself.
+ *  pv->flag_lock : 0 == no phase lock
+ *                  1 == loose phase lock
+ * OUTPUT (returned value)
+ *  status : output frames (should be hop_res)
+ */
+long
+pv_nofft_play_step (struct pv_complex * pv,
+                    long cur)
+{
+   long status;
+
+   if (pv_nofft_synth_step (pv, cur) != pv->len)
+   {
+      return 0; /* no output */
+   }
+
    /* output
     * out[0, hop_syn] ==> resample into hop_res ==> ao derive or snd file
     */
    status = pv_complex_play_resample (pv);
 
-
-   /* shift
-    * out[hop_syn, hop_syn + len] ==> out[0, len]
-    */
-   for (i = 0; i < pv->len; i ++)
-   {
-      pv->l_out [i] = pv->l_out [i + pv->hop_syn];
-      pv->r_out [i] = pv->r_out [i + pv->hop_syn];
-   }
-   for (i = pv->len; i < pv->len + pv->hop_syn; i ++)
-   {
-      pv->l_out [i] = 0.0;
-      pv->r_out [i] = 0.0;
-   }
+   pv_complex_shift_out (pv);
 
    return (status);
 }
 
 
-/* phase vocoder by no-FFT -- wrapper for pv_nofft_play_step()
- * INPUT
- *  flag_lock : 0 == no phase lock is applied
- *              1 == loose phase lock is applied
- *  rate : time-streching rate
- *  pitch_shift : in the unit of half-note
- */
-void pv_nofft (const char * file, const char * outfile,
-               double rate, double pitch_shift,
-               long len, long hop_syn,
-               int flag_window)
-{
-   long hop_res = (long)((double)hop_syn * pow (2.0, - pitch_shift / 12.0));
-   long hop_ana = (long)((double)hop_res * rate);
-   struct pv_complex * pv = pv_complex_init (len, hop_syn, flag_window);
-   SNDFILE * sf = NULL;
-   SF_INFO sfinfo;
-   ao_device * ao = NULL;
-   SNDFILE * sfout = NULL;
-   SF_INFO sfout_info;
-   long cur;
+/** the engine interface (see pv-engine.h) **/
 
-   pv->hop_res = hop_res;
-   pv->hop_ana = hop_ana;
+struct pv_nofft_engine_state
+{
+   struct pv_complex * pv;
+   long cur; /* starting frame of the next hop */
+};
 
-   /* pv->pitch_shift = pitch_shift; */
+static void *
+pv_nofft_engine_init (const pv_engine_params_t * params,
+                      pv_engine_shape_t * shape)
+{
+   struct pv_nofft_engine_state * st;
+   struct pv_complex * pv = pv_complex_init (params->len, params->hop_syn,
+                                             params->flag_window);
+   if (pv == NULL)
+   {
+      return (NULL);
+   }
 
+   pv_complex_change_rate_pitch (pv, params->rate, params->pitch_shift);
+   if (pv->hop_ana <= 0 || pv->hop_res <= 0)
+   {
+      pv_complex_free (pv);
+      return (NULL);
+   }
 
-   memset (&sfinfo, 0, sizeof (sfinfo));
-   sf = sf_open (file, SFM_READ, &sfinfo); /* open file */
-   if (sf == NULL)
+   st = (struct pv_nofft_engine_state *)
+      malloc (sizeof (struct pv_nofft_engine_state));
+   if (st == NULL)
    {
-      fprintf (stderr, "fail to open %s\n", file);
-      exit (1);
+      pv_complex_free (pv);
+      return (NULL);
    }
-   sndfile_print_info (&sfinfo);
+   st->pv = pv;
+   st->cur = 0;
 
-   pv_complex_set_input (pv, sf, &sfinfo);
+   shape->block   = pv->hop_syn;
+   shape->hop_res = pv->hop_res;
+   shape->tail    = pv->len;
+   return (st);
+}
 
+static long
+pv_nofft_engine_process_block (void * state,
+                               pv_engine_input_t * in,
+                               double * left, double * right)
+{
+   struct pv_nofft_engine_state * st = (struct pv_nofft_engine_state *)state;
+   struct pv_complex * pv = st->pv;
+   long status;
 
-   if (outfile == NULL)
+   pv->input = in;
+   status = pv_nofft_synth_step (pv, st->cur);
+   pv->input = NULL;
+   if (status == PV_ENGINE_MORE)
    {
-      ao = ao_init_16_stereo (sfinfo.samplerate, 1 /* verbose */);
-      pv_complex_set_output_ao (pv, ao);
+      return (PV_ENGINE_MORE);
    }
-   else
+   else if (status != pv->len)
    {
-      sfout = sndfile_open_for_write (&sfout_info,
-                                      outfile,
-                                      sfinfo.samplerate,
-                                      sfinfo.channels);
-      if (sfout == NULL)
-      {
-         fprintf (stderr, "fail to open file %s\n", outfile);
-         exit (1);
-      }
-      pv_complex_set_output_sf (pv, sfout, &sfout_info);
+      return (PV_ENGINE_END);
    }
 
-   for (cur = 0; cur < (long)sfinfo.frames; cur += pv->hop_ana)
-   {
-      long len_play = pv_nofft_play_step (pv, cur);
-      if (len_play < pv->hop_res)
-      {
-         break;
-      }
-   }
+   memcpy (left,  pv->l_out, sizeof (double) * pv->hop_syn);
+   memcpy (right, pv->r_out, sizeof (double) * pv->hop_syn);
+   pv_complex_shift_out (pv);
 
-   if (outfile == NULL)
-   {
-      ao_close (ao);
-   }
-   else
-   {
-      /* frames left in l_out[] and r_out[] */
-      sndfile_write (sfout, sfout_info,
-                     pv->l_out, pv->r_out, len);
+   st->cur += pv->hop_ana;
+   in->keep = st->cur;
+   return (pv->hop_syn);
+}
 
-      sf_write_sync (sfout);
-      sf_close (sfout);
-   }
+static long
+pv_nofft_engine_flush (void * state,
+                       double * left, double * right)
+{
+   struct pv_complex * pv = ((struct pv_nofft_engine_state *)state)->pv;
+
+   /* frames left in l_out[] and r_out[] */
+   memcpy (left,  pv->l_out, sizeof (double) * pv->len);
+   memcpy (right, pv->r_out, sizeof (double) * pv->len);
+   return (pv->len);
+}
+
+static void
+pv_nofft_engine_free (void * state)
+{
+   struct pv_nofft_engine_state * st = (struct pv_nofft_engine_state *)state;
+   pv_complex_free (st->pv);
+   free (st);
+}
+
+const pv_engine_ops_t pv_nofft_engine =
+{
+   "nofft",
+   "overlap-add without FFT, for fun (this is not phase vocoder)",
+   pv_nofft_engine_init,
+   pv_nofft_engine_process_block,
+   pv_nofft_engine_flush,
+   pv_nofft_engine_free
+};
+
+/* phase vocoder by no-FFT -- through pv_nofft_engine
+ * INPUT
+ *  rate : time-streching rate
+ *  pitch_shift : in the unit of half-note
+ * OUTPUT
+ *  returned value : 0 on success, -1 on failure (with a message)
+ */
+int pv_nofft (const char * file, const char * outfile,
+              double rate, double pitch_shift,
+              long len, long hop_syn,
+              int flag_window)
+{
+   pv_engine_params_t params;
+
+   pv_engine_params_init (&params);
+   params.len = len;
+   params.hop_syn = hop_syn;
+   params.rate = rate;
+   params.pitch_shift = pitch_shift;
+   params.flag_window = flag_window;
 
-   pv_complex_free (pv);
-   sf_close (sf) ;
+   return (pv_engine_render_file (&pv_nofft_engine, &params,
+                                  file, outfile));
 }
 
 /*
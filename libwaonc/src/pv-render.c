@@ -0,0 +1,487 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : pipelined offline phase vocoder
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-render.c
+ *
+ *    This module renders a whole input through pv_complex with the stages
+ *    of pv_complex_play_step() on separate threads.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Hop j lives in slot j % PV_RENDER_QUEUE of the ring.  Each stage keeps
+ *    the count of the hops it has finished, and a stage works on hop j once
+ *    the count of the stage before it is above j.  The counts, and nothing
+ *    else, are guarded by one mutex; a slot belongs to one stage at a time,
+ *    so the data in it need no locking.
+ *
+ *    Each stage owns its part of the struct pv_complex:  the reader owns
+ *    the input, the stereo FFT and the spectrum cache; a channel owns its
+ *    flag_left (flag_right) and l_f_old[] (r_f_old[]); the writer owns
+ *    l_out[], r_out[] and the samplerate converter.  The inverse FFTs of
+ *    the two channels share pv->plan_inv, through fftw_execute_r2r() or
+ *    fftw_execute_dft_c2r() on their own arrays, which FFTW allows from
+ *    several threads.
+ */
+
+#include <pthread.h>                   /* pthread_create(), mutex, condition  */
+#include <stdlib.h>                    /* calloc(), malloc(), free()          */
+#include <string.h>                    /* memcpy(), memmove(), memset()       */
+
+#include "cx.h"                        /* CX_LENGTH() macro                   */
+#include "hc-simd.h"                   /* hc_simd_level()                     */
+#include "macros.h"                    /* wbool_t and errprint() macros       */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "pv-render.h"                 /* pv_render()                         */
+
+/**
+ *    Holds one hop in the ring.  Index 0 is the left channel, 1 the right.
+ */
+
+typedef struct
+{
+   double * fs[2];         /*<< The spectra at s_i, [spec_len].               */
+   double * ft[2];         /*<< The spectra at t_i, [spec_len].               */
+   double * y[2];          /*<< The synthesis spectra Y[u_i], [spec_len].     */
+   int active[2];          /*<< Whether y[] was made (the channel sounds).    */
+   double * hop[2];        /*<< The finished output frames, [hop_syn].        */
+
+} pv_render_slot_t;
+
+struct pv_render;
+
+/**
+ *    Holds the state of one channel, shared by its vocoder and its
+ *    synthesis threads.
+ */
+
+typedef struct
+{
+   struct pv_render * r;   /*<< The pipeline this channel belongs to.         */
+   int index;              /*<< 0 for the left channel, 1 for the right.      */
+   int * flag;             /*<< &pv->flag_left or &pv->flag_right.            */
+   double * f_old;         /*<< pv->l_f_old or pv->r_f_old.                   */
+   double * ola;           /*<< The overlap-add buffer, [len + hop_syn].      */
+   double * f_out;         /*<< The inverse FFT input (fftw_malloc()).        */
+   double * t_out;         /*<< The inverse FFT output (fftw_malloc()).       */
+   long n_vocoded;         /*<< The hops done by the vocoder thread.          */
+   long n_synthesized;     /*<< The hops done by the synthesis thread.        */
+   pthread_cond_t vocoded; /*<< Signalled when n_vocoded goes up.             */
+   pthread_t vocoder;
+   pthread_t synthesizer;
+
+} pv_render_channel_t;
+
+/**
+ *    Holds the whole pipeline.
+ */
+
+typedef struct pv_render
+{
+   struct pv_complex * pv;
+   long frames;            /*<< The input frames to render.                   */
+   pv_render_slot_t slot[PV_RENDER_QUEUE];
+   pv_render_channel_t channel[2];
+   pthread_mutex_t lock;   /*<< Guards the counts and the flags below.        */
+   pthread_cond_t freed;   /*<< Signalled when n_written goes up.             */
+   pthread_cond_t read;    /*<< Signalled when n_read goes up.                */
+   pthread_cond_t done;    /*<< Signalled when n_synthesized goes up.         */
+   long n_read;            /*<< The hops done by the reader.                  */
+   long n_written;         /*<< The hops done by the writer.                  */
+   long n_hops;            /*<< The hops in all, -1 until the reader ends.    */
+   wbool_t abort;          /*<< Set if the writer fails or a start fails.     */
+   pthread_t reader;
+
+} pv_render_t;
+
+/**
+ *    Wakes every thread, after the end or an abort.  The mutex is held.
+ */
+
+static void
+render_wake_all (pv_render_t * r)
+{
+   pthread_cond_broadcast(&r->freed);
+   pthread_cond_broadcast(&r->read);
+   pthread_cond_broadcast(&r->done);
+   pthread_cond_broadcast(&r->channel[0].vocoded);
+   pthread_cond_broadcast(&r->channel[1].vocoded);
+}
+
+/**
+ *    Waits until the stage before has finished hop \a next.
+ *
+ * \param cond
+ *    Provides the condition signalled by the stage before.
+ *
+ * \param upstream
+ *    Provides the count of the stage before.
+ *
+ * \return
+ *    Returns wfalse if there is no hop \a next (the end) or if the
+ *    pipeline is aborted.
+ */
+
+static wbool_t
+render_wait
+(
+   pv_render_t * r,
+   pthread_cond_t * cond,
+   const long * upstream,
+   long next
+)
+{
+   wbool_t result;
+   pthread_mutex_lock(&r->lock);
+   while
+   (
+      ! r->abort && *upstream <= next && (r->n_hops < 0 || next < r->n_hops)
+   )
+   {
+      pthread_cond_wait(cond, &r->lock);
+   }
+   result = ! r->abort && next < *upstream;
+   pthread_mutex_unlock(&r->lock);
+   return result;
+}
+
+/**
+ *    Adds one to a count and signals the stage after.
+ */
+
+static void
+render_post (pv_render_t * r, pthread_cond_t * cond, long * count)
+{
+   pthread_mutex_lock(&r->lock);
+   ++*count;
+   pthread_cond_broadcast(cond);
+   pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ *    The reader:  the stereo spectra at s_i = j hop_ana and t_i = s_i +
+ *    hop_syn, as pv_complex_play_step() reads them.  The loop is that of
+ *    pv_complex(), and it ends at the first frame that cannot be read.
+ */
+
+static void *
+render_reader (void * arg)
+{
+   pv_render_t * r = (pv_render_t *) arg;
+   struct pv_complex * pv = r->pv;
+   long cur;
+   long j = 0;
+   for (cur = 0; cur < r->frames; cur += pv->hop_ana, ++j)
+   {
+      pv_render_slot_t * s = &r->slot[j % PV_RENDER_QUEUE];
+      wbool_t ok;
+      pthread_mutex_lock(&r->lock);
+      while (! r->abort && j - r->n_written >= PV_RENDER_QUEUE)
+         pthread_cond_wait(&r->freed, &r->lock);
+
+      ok = ! r->abort;
+      pthread_mutex_unlock(&r->lock);
+      if (! ok)
+         break;
+
+      if (read_and_FFT_stereo(pv, cur, s->fs[0], s->fs[1]) != pv->len)
+         break;
+
+      if
+      (
+         read_and_FFT_stereo(pv, cur + pv->hop_syn, s->ft[0], s->ft[1]) !=
+            pv->len
+      )
+      {
+         break;
+      }
+
+      render_post(r, &r->read, &r->n_read);
+   }
+   pthread_mutex_lock(&r->lock);
+   r->n_hops = r->n_read;
+   render_wake_all(r);
+   pthread_mutex_unlock(&r->lock);
+   return NULL;
+}
+
+/**
+ *    The phase vocoder of one channel.  It runs one hop at a time, since
+ *    each hop starts from the f_old[] of the last one.
+ */
+
+static void *
+render_vocoder (void * arg)
+{
+   pv_render_channel_t * ch = (pv_render_channel_t *) arg;
+   pv_render_t * r = ch->r;
+   int c = ch->index;
+   long j;
+   for (j = 0; render_wait(r, &r->read, &r->n_read, j); ++j)
+   {
+      pv_render_slot_t * s = &r->slot[j % PV_RENDER_QUEUE];
+      s->active[c] = pv_complex_channel_vocoder
+      (
+         r->pv, s->fs[c], s->ft[c], ch->flag, ch->f_old, s->y[c]
+      );
+      render_post(r, &ch->vocoded, &ch->n_vocoded);
+   }
+   return NULL;
+}
+
+/**
+ *    The inverse FFT and the overlap-add of one channel, done the same way
+ *    as in pv_complex_play_step(), into ch->ola[] instead of pv->l_out[]
+ *    or pv->r_out[].  The first hop_syn frames go to the slot.
+ */
+
+static void *
+render_synthesizer (void * arg)
+{
+   pv_render_channel_t * ch = (pv_render_channel_t *) arg;
+   pv_render_t * r = ch->r;
+   struct pv_complex * pv = r->pv;
+   int c = ch->index;
+   long j;
+   for (j = 0; render_wait(r, &ch->vocoded, &ch->n_vocoded, j); ++j)
+   {
+      pv_render_slot_t * s = &r->slot[j % PV_RENDER_QUEUE];
+      if (s->active[c])
+      {
+         apply_invFFT_mono_r
+         (
+            pv, s->y[c], pv->window_scale, ch->f_out, ch->t_out, ch->ola
+         );
+      }
+      memcpy(s->hop[c], ch->ola, sizeof(double) * pv->hop_syn);
+      memmove(ch->ola, ch->ola + pv->hop_syn, sizeof(double) * pv->len);
+      memset(ch->ola + pv->len, 0, sizeof(double) * pv->hop_syn);
+      render_post(r, &r->done, &ch->n_synthesized);
+   }
+   return NULL;
+}
+
+/**
+ *    Starts a thread.
+ *
+ * \return
+ *    Returns wtrue if the thread started.
+ */
+
+static wbool_t
+render_start (pthread_t * t, void * (* func) (void *), void * arg)
+{
+   wbool_t result = pthread_create(t, NULL, func, arg) == 0;
+   if (! result)
+      errprint("pv_render: cannot start a thread");
+
+   return result;
+}
+
+/**
+ *    Renders a whole input, from frame 0, with a pipeline of threads.
+ *    The input, the output and the parameters are those set in \a pv, as
+ *    for the pv_complex_play_step() loop.
+ *
+ * \param pv
+ *    Provides the phase vocoder.  On return, its state is the one the
+ *    pv_complex_play_step() loop leaves:  l_out[] and r_out[] hold the
+ *    frames not played yet.
+ *
+ * \param frames
+ *    Provides the number of frames of the input.
+ *
+ * \return
+ *    Returns the number of hops written.  It is short if a write fails.
+ *    It is -1 if a thread cannot be started; then \a pv is left as it
+ *    was, so that the caller can render it the other way.
+ */
+
+long
+pv_render (struct pv_complex * pv, long frames)
+{
+   pv_render_t * r = (pv_render_t *) calloc(1, sizeof(pv_render_t));
+   long j;
+   int c, k;
+   wbool_t started;
+   wbool_t have_reader;
+   wbool_t have_vocoder[2] = { wfalse, wfalse };
+   wbool_t have_synthesizer[2] = { wfalse, wfalse };
+   CHECK_MALLOC(r, "pv_render");
+   r->pv = pv;
+   r->frames = frames;
+   r->n_hops = -1;
+   for (k = 0; k < PV_RENDER_QUEUE; ++k)
+   {
+      pv_render_slot_t * s = &r->slot[k];
+      for (c = 0; c < 2; ++c)
+      {
+         s->fs[c] = (double *) malloc(sizeof(double) * pv->spec_len);
+         s->ft[c] = (double *) malloc(sizeof(double) * pv->spec_len);
+         s->y[c] = (double *) malloc(sizeof(double) * pv->spec_len);
+         s->hop[c] = (double *) malloc(sizeof(double) * pv->hop_syn);
+         CHECK_MALLOC(s->fs[c], "pv_render");
+         CHECK_MALLOC(s->ft[c], "pv_render");
+         CHECK_MALLOC(s->y[c], "pv_render");
+         CHECK_MALLOC(s->hop[c], "pv_render");
+      }
+   }
+   for (c = 0; c < 2; ++c)
+   {
+      pv_render_channel_t * ch = &r->channel[c];
+      double * out = c == 0 ? pv->l_out : pv->r_out;
+      ch->r = r;
+      ch->index = c;
+      ch->flag = c == 0 ? &pv->flag_left : &pv->flag_right;
+      ch->f_old = c == 0 ? pv->l_f_old : pv->r_f_old;
+      ch->ola = (double *) malloc(sizeof(double) * (pv->len + pv->hop_syn));
+      ch->f_out = (double *) fftw_malloc(sizeof(double) * CX_LENGTH(pv->len));
+      ch->t_out = (double *) fftw_malloc(sizeof(double) * pv->len);
+      CHECK_MALLOC(ch->ola, "pv_render");
+      CHECK_MALLOC(ch->f_out, "pv_render");
+      CHECK_MALLOC(ch->t_out, "pv_render");
+      memcpy(ch->ola, out, sizeof(double) * (pv->len + pv->hop_syn));
+      pthread_cond_init(&ch->vocoded, NULL);
+   }
+   pthread_mutex_init(&r->lock, NULL);
+   pthread_cond_init(&r->freed, NULL);
+   pthread_cond_init(&r->read, NULL);
+   pthread_cond_init(&r->done, NULL);
+
+   (void) hc_simd_level();             /* pick it before the threads race    */
+
+   /*
+    * Each thread takes the lock before it touches \a pv, so none of them
+    * starts working until all of them are running.  If one cannot start,
+    * the others see the abort and end without having done anything.
+    */
+
+   pthread_mutex_lock(&r->lock);
+   started = render_start(&r->reader, render_reader, r);
+   have_reader = started;
+   for (c = 0; c < 2; ++c)
+   {
+      if (started)
+      {
+         started = render_start
+         (
+            &r->channel[c].vocoder, render_vocoder, &r->channel[c]
+         );
+         have_vocoder[c] = started;
+      }
+      if (started)
+      {
+         started = render_start
+         (
+            &r->channel[c].synthesizer, render_synthesizer, &r->channel[c]
+         );
+         have_synthesizer[c] = started;
+      }
+   }
+   if (! started)
+   {
+      r->abort = wtrue;
+      render_wake_all(r);
+   }
+   pthread_mutex_unlock(&r->lock);
+
+   /*
+    * The writer, on this thread.
+    */
+
+   for (j = 0; started; ++j)
+   {
+      pv_render_slot_t * s = &r->slot[j % PV_RENDER_QUEUE];
+      if (! render_wait(r, &r->done, &r->channel[0].n_synthesized, j))
+         break;
+
+      if (! render_wait(r, &r->done, &r->channel[1].n_synthesized, j))
+         break;
+
+      memcpy(pv->l_out, s->hop[0], sizeof(double) * pv->hop_syn);
+      memcpy(pv->r_out, s->hop[1], sizeof(double) * pv->hop_syn);
+      if (pv_complex_play_resample(pv) < pv->hop_res)
+      {
+         pthread_mutex_lock(&r->lock);
+         r->abort = wtrue;
+         render_wake_all(r);
+         pthread_mutex_unlock(&r->lock);
+         break;
+      }
+      render_post(r, &r->freed, &r->n_written);
+   }
+   if (have_reader)
+      pthread_join(r->reader, NULL);
+
+   for (c = 0; c < 2; ++c)
+   {
+      if (have_vocoder[c])
+         pthread_join(r->channel[c].vocoder, NULL);
+
+      if (have_synthesizer[c])
+         pthread_join(r->channel[c].synthesizer, NULL);
+   }
+
+   /*
+    * Hand the overlap-add tails back, as pv_complex_play_step() leaves
+    * them.  After an abort they are ahead of the output; nothing is left
+    * to play then anyway.
+    */
+
+   for (c = 0; started && c < 2; ++c)
+   {
+      double * out = c == 0 ? pv->l_out : pv->r_out;
+      memcpy(out, r->channel[c].ola, sizeof(double) * (pv->len + pv->hop_syn));
+   }
+   j = started ? r->n_written : -1;
+   pthread_mutex_destroy(&r->lock);
+   pthread_cond_destroy(&r->freed);
+   pthread_cond_destroy(&r->read);
+   pthread_cond_destroy(&r->done);
+   for (c = 0; c < 2; ++c)
+   {
+      pv_render_channel_t * ch = &r->channel[c];
+      pthread_cond_destroy(&ch->vocoded);
+      free(ch->ola);
+      fftw_free(ch->f_out);
+      fftw_free(ch->t_out);
+   }
+   for (k = 0; k < PV_RENDER_QUEUE; ++k)
+   {
+      for (c = 0; c < 2; ++c)
+      {
+         free(r->slot[k].fs[c]);
+         free(r->slot[k].ft[c]);
+         free(r->slot[k].y[c]);
+         free(r->slot[k].hop[c]);
+      }
+   }
+   free(r);
+   return j;
+}
+
+/*
+ * pv-render.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
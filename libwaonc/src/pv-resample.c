@@ -0,0 +1,290 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : streaming resampler of the vocoders
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-resample.c
+ *
+ *    This module provides the samplerate conversion of the pitch-shift,
+ *    one hop at a time, for pv_complex_resample() and pv_engine_t.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The ratio is set at each hop with src_set_ratio(), rather than
+ *    smoothed over it by src_process(), so that a hop makes its frames
+ *    even when the pitch changes.  No function of the module exits the
+ *    application; a failure is reported and returned.
+ */
+
+#include <stdio.h>                     /* fprintf()                           */
+#include <stdlib.h>                    /* malloc(), realloc(), free()         */
+#include <string.h>                    /* memset(), memmove()                 */
+
+#include "macros.h"                    /* errprint(), nullptr, wbool_t        */
+#include "pv-resample.h"               /* pv_resample_t                       */
+
+/**
+ *    Creates a resampler.  The converter itself is made by the first hop.
+ *
+ * \param quality
+ *    The converter type of libsamplerate, from SRC_SINC_BEST_QUALITY (0)
+ *    to SRC_LINEAR (4).
+ *
+ * \return
+ *    Returns the resampler, or a null pointer if \a quality is not a
+ *    converter or the memory is short.
+ */
+
+pv_resample_t *
+pv_resample_new (int quality)
+{
+   pv_resample_t * rs;
+   if (is_nullptr(src_get_name(quality)))
+      return nullptr;
+
+   rs = (pv_resample_t *) calloc(1, sizeof(pv_resample_t));
+   if (not_nullptr(rs))
+      rs->quality = quality;
+
+   return rs;
+}
+
+/**
+ *    Frees the resampler and its converter.
+ */
+
+void
+pv_resample_free (pv_resample_t * rs)
+{
+   if (not_nullptr(rs))
+   {
+      if (not_nullptr(rs->src))
+         src_delete(rs->src);
+
+      free(rs->in);
+      free(rs->out);
+      free(rs);
+   }
+}
+
+/**
+ *    Drops the converter and the frames of the FIFO, e.g. for a jump in
+ *    the input.  The next hop primes a new converter.
+ */
+
+void
+pv_resample_reset (pv_resample_t * rs)
+{
+   if (not_nullptr(rs->src))
+      rs->src = src_delete(rs->src);
+
+   rs->out_n = 0;
+}
+
+/**
+ *    Runs the converter on \a n frames of \a in (interleaved stereo), and
+ *    appends its output to the FIFO, which grows by at least \a room
+ *    frames as needed.
+ *
+ * \return
+ *    Returns wfalse, with a message, if libsamplerate fails or the memory
+ *    is short.
+ */
+
+static wbool_t
+resample_run
+(
+   pv_resample_t * rs,
+   const float * in,
+   long n,
+   double ratio,
+   long room
+)
+{
+   SRC_DATA srdata;
+   srdata.data_in = in;
+   srdata.input_frames = n;
+   srdata.end_of_input = 0;
+   srdata.src_ratio = ratio;
+   while (srdata.input_frames > 0)
+   {
+      int status;
+      if (rs->out_len < rs->out_n + room + 16)
+      {
+         long len = rs->out_n + 2 * room + 16;
+         float * out = (float *) realloc(rs->out, sizeof(float) * 2 * len);
+         if (is_nullptr(out))
+         {
+            errprint("samplerate conversion: out of memory");
+            return wfalse;
+         }
+         rs->out = out;
+         rs->out_len = len;
+      }
+      srdata.data_out = rs->out + 2 * rs->out_n;
+      srdata.output_frames = rs->out_len - rs->out_n;
+      status = src_process(rs->src, &srdata);
+      if (status != 0)
+      {
+         errprintf("? samplerate conversion: %s\n", src_strerror(status));
+         return wfalse;
+      }
+      rs->out_n += srdata.output_frames_gen;
+      srdata.data_in += 2 * srdata.input_frames_used;
+      srdata.input_frames -= srdata.input_frames_used;
+      if (srdata.input_frames_used == 0 && srdata.output_frames_gen == 0)
+         break;                        /* nothing more to do with the input */
+   }
+   return wtrue;
+}
+
+/**
+ *    Feeds \a n frames of silence to the converter until the FIFO holds
+ *    \a target frames.
+ *
+ * \return
+ *    Returns wfalse if resample_run() fails.
+ */
+
+static wbool_t
+resample_fill
+(
+   pv_resample_t * rs,
+   long n,
+   double ratio,
+   long room,
+   long target
+)
+{
+   memset(rs->in, 0, sizeof(float) * 2 * n);
+   while (rs->out_n < target)
+   {
+      if (! resample_run(rs, rs->in, n, ratio, room))
+         return wfalse;
+   }
+   return wtrue;
+}
+
+/**
+ *    Resamples one hop of \a n_in frames into \a n_out frames.
+ *
+ * \param l_in
+ *    The left channel of the hop, [n_in].
+ *
+ * \param l_out
+ *    Receives \a n_out frames of the left channel, which are those of an
+ *    earlier hop by the fixed latency of the resampler.
+ *
+ * \return
+ *    Returns \a n_out, or -1, with a message, if the converter cannot be
+ *    made or run.
+ */
+
+long
+pv_resample_hop
+(
+   pv_resample_t * rs,
+   const double * l_in,
+   const double * r_in,
+   long n_in,
+   double * l_out,
+   double * r_out,
+   long n_out
+)
+{
+   double ratio = (double) n_out / (double) n_in;
+   long n_fill = n_in > PV_RESAMPLE_MARGIN ? n_in : PV_RESAMPLE_MARGIN;
+   wbool_t prime = wfalse;
+   long i;
+   if (rs->in_len < n_fill)
+   {
+      float * in = (float *) realloc(rs->in, sizeof(float) * 2 * n_fill);
+      if (is_nullptr(in))
+      {
+         errprint("samplerate conversion: out of memory");
+         return -1;
+      }
+      rs->in = in;
+      rs->in_len = n_fill;
+   }
+   if (is_nullptr(rs->src))
+   {
+      int status;
+      rs->src = src_new(rs->quality, 2, &status);
+      if (is_nullptr(rs->src))
+      {
+         errprintf("? samplerate conversion: %s\n", src_strerror(status));
+         return -1;
+      }
+      rs->out_n = 0;
+      prime = wtrue;
+   }
+   src_set_ratio(rs->src, ratio);
+   if (prime)
+   {
+      /*
+       * The fixed latency:  the delay of the converter and the margin,
+       * all silence.
+       */
+
+      if (! resample_fill(rs, n_fill, ratio, n_out, PV_RESAMPLE_MARGIN))
+         return -1;
+
+      rs->out_n = PV_RESAMPLE_MARGIN;
+   }
+   for (i = 0; i < n_in; ++i)
+   {
+      rs->in[i * 2 + 0] = (float) l_in[i];
+      rs->in[i * 2 + 1] = (float) r_in[i];
+   }
+   if (! resample_run(rs, rs->in, n_in, ratio, n_out))
+      return -1;
+
+   /*
+    * The margin covers the jitter of the count, and the move of the delay
+    * of the converter when it downsamples, which is less than the half
+    * length of its filter (about 20 output frames for the fastest sinc,
+    * and 150 for the best).  This is only a guard:  the FIFO is topped up
+    * by silence behind the frames still in the converter.
+    */
+
+   if (rs->out_n < n_out)
+   {
+      long target = n_out + PV_RESAMPLE_MARGIN;
+      if (! resample_fill(rs, n_fill, ratio, n_out, target))
+         return -1;
+   }
+   for (i = 0; i < n_out; ++i)
+   {
+      l_out[i] = (double) rs->out[i * 2 + 0];
+      r_out[i] = (double) rs->out[i * 2 + 1];
+   }
+   rs->out_n -= n_out;
+   memmove(rs->out, rs->out + 2 * n_out, sizeof(float) * 2 * rs->out_n);
+   return n_out;
+}
+
+/*
+ * pv-resample.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,637 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : WSOLA time-stretching
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          pv-wsola.c
+ *
+ *    This module stretches the time of a sound by waveform-similarity
+ *    overlap-add (WSOLA), without a phase vocoder.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Each step takes the "template", the len input frames that follow the
+ *    previous segment, and searches the input from cur - tolerance to cur
+ *    + tolerance for the segment most like it.  The measure is the
+ *    correlation normalized by the energy of the candidate, on the mono
+ *    mix of the two channels.
+ *
+ *    The coarse search sums the mono mix over groups of decimate frames,
+ *    and gets the correlation for every candidate at once as the inverse
+ *    FFT of X(f) conj(T(f)), where X and T are the spectra of the region
+ *    and of the template, zero-padded to n_fft so that the circular
+ *    correlation is the linear one for the candidates.  The energies come
+ *    from a running sum.  The fine search computes the correlation
+ *    directly for the decimate - 1 frames on either side of the coarse
+ *    match.  For the default len 2048 and hop 512, a step costs three
+ *    real FFTs of 2048 points and some 30000 multiply-adds, against the
+ *    FFT pair and the phase arithmetic of every bin of pv_complex.
+ */
+
+#include <math.h>                      /* sqrt(), pow()                       */
+#include <stdlib.h>                    /* malloc(), free()                    */
+#include <string.h>                    /* memcpy(), memmove(), memset()       */
+#include <ao/ao.h>                     /* ao_device, for pv-conventional.h    */
+#include <sndfile.h>                   /* SNDFILE, for pv-conventional.h      */
+
+#include "fft.h"                       /* windowing()                         */
+#include "pv-conventional.h"           /* get_scale_factor_for_window()       */
+#include "pv-engine.h"                 /* pv_engine_ops_t, PV_ENGINE_MORE     */
+#include "pv-wsola.h"                  /* pv_wsola_t                          */
+
+/**
+ *    Allocates an array of n doubles, set to 0.
+ *
+ * \return
+ *    Returns a null pointer if the memory is short.
+ */
+
+static double *
+wsola_alloc (long n)
+{
+   double * result = (double *) fftw_malloc(sizeof(double) * n);
+   if (not_nullptr(result))
+      memset(result, 0, sizeof(double) * n);
+
+   return result;
+}
+
+/**
+ *    Creates the WSOLA state.
+ *
+ * \param len
+ *    The frames of a segment.
+ *
+ * \param hop_syn
+ *    The output frames of a step.  The search reaches hop_syn / 2 frames
+ *    either way from the nominal frame of a segment.
+ *
+ * \param flag_window
+ *    The window of the segments, see windowing().
+ *
+ * \return
+ *    Returns the new state, or a null pointer if len or hop_syn are not
+ *    positive, or if the memory is short.
+ */
+
+pv_wsola_t *
+pv_wsola_new (long len, long hop_syn, int flag_window)
+{
+   pv_wsola_t * w;
+   long n_reg;
+   long n_dec;
+   double scale;
+   if (len <= 0 || hop_syn <= 0)
+      return nullptr;
+
+   w = (pv_wsola_t *) calloc(1, sizeof(pv_wsola_t));
+   if (is_nullptr(w))
+      return nullptr;
+
+   w->len = len;
+   w->hop_syn = hop_syn;
+   w->tolerance = hop_syn / 2;
+   w->flag_window = flag_window;
+
+   /*
+    * Short segments are searched at the full rate.
+    */
+
+   w->decimate = len >= 16 * PV_WSOLA_DECIMATE ? PV_WSOLA_DECIMATE : 1;
+   n_reg = len + 2 * w->tolerance;
+   n_dec = n_reg / w->decimate + 1;
+   w->n_fft = 1;
+   while (w->n_fft < n_dec)
+      w->n_fft *= 2;
+
+   w->window = wsola_alloc(len);
+   w->l_reg = wsola_alloc(n_reg);
+   w->r_reg = wsola_alloc(n_reg);
+   w->m_reg = wsola_alloc(n_reg);
+   w->l_tmpl = wsola_alloc(len);
+   w->r_tmpl = wsola_alloc(len);
+   w->m_tmpl = wsola_alloc(len);
+   w->x_time = wsola_alloc(w->n_fft);
+   w->t_time = wsola_alloc(w->n_fft);
+   w->c_time = wsola_alloc(w->n_fft);
+   w->energy = wsola_alloc(w->n_fft + 1);
+   w->x_freq = (fftw_complex *)
+      fftw_malloc(sizeof(fftw_complex) * (w->n_fft / 2 + 1));
+
+   w->t_freq = (fftw_complex *)
+      fftw_malloc(sizeof(fftw_complex) * (w->n_fft / 2 + 1));
+
+   w->l_out = wsola_alloc(hop_syn + len);
+   w->r_out = wsola_alloc(hop_syn + len);
+   if
+   (
+      is_nullptr(w->window) || is_nullptr(w->l_reg) ||
+      is_nullptr(w->r_reg) || is_nullptr(w->m_reg) ||
+      is_nullptr(w->l_tmpl) || is_nullptr(w->r_tmpl) ||
+      is_nullptr(w->m_tmpl) || is_nullptr(w->x_time) ||
+      is_nullptr(w->t_time) || is_nullptr(w->c_time) ||
+      is_nullptr(w->energy) || is_nullptr(w->x_freq) ||
+      is_nullptr(w->t_freq) || is_nullptr(w->l_out) ||
+      is_nullptr(w->r_out)
+   )
+   {
+      pv_wsola_free(w);
+      return nullptr;
+   }
+
+   /*
+    * The window, over the overlap of the segments, is computed once.
+    */
+
+   scale = get_scale_factor_for_window((int) len, hop_syn, flag_window);
+   {
+      long i;
+      for (i = 0; i < len; ++i)
+         w->window[i] = 1.0;
+   }
+   (void) windowing
+   (
+      (int) len, w->window, (filter_window_t) flag_window, scale, w->window
+   );
+   w->plan_x = fftw_plan_dft_r2c_1d
+   (
+      (int) w->n_fft, w->x_time, w->x_freq, FFTW_ESTIMATE
+   );
+   w->plan_t = fftw_plan_dft_r2c_1d
+   (
+      (int) w->n_fft, w->t_time, w->t_freq, FFTW_ESTIMATE
+   );
+   w->plan_c = fftw_plan_dft_c2r_1d
+   (
+      (int) w->n_fft, w->x_freq, w->c_time, FFTW_ESTIMATE
+   );
+   w->prev = -1;
+   return w;
+}
+
+/**
+ *    Frees the WSOLA state.
+ */
+
+void
+pv_wsola_free (pv_wsola_t * w)
+{
+   if (is_nullptr(w))
+      return;
+
+   if (not_nullptr(w->plan_x))
+      fftw_destroy_plan(w->plan_x);
+
+   if (not_nullptr(w->plan_t))
+      fftw_destroy_plan(w->plan_t);
+
+   if (not_nullptr(w->plan_c))
+      fftw_destroy_plan(w->plan_c);
+
+   fftw_free(w->window);
+   fftw_free(w->l_reg);
+   fftw_free(w->r_reg);
+   fftw_free(w->m_reg);
+   fftw_free(w->l_tmpl);
+   fftw_free(w->r_tmpl);
+   fftw_free(w->m_tmpl);
+   fftw_free(w->x_time);
+   fftw_free(w->t_time);
+   fftw_free(w->c_time);
+   fftw_free(w->energy);
+   fftw_free(w->x_freq);
+   fftw_free(w->t_freq);
+   fftw_free(w->l_out);
+   fftw_free(w->r_out);
+   free(w);
+}
+
+/**
+ *    Forgets the previous segment and the overlap-add buffers, e.g. for
+ *    a jump in the input.
+ */
+
+void
+pv_wsola_reset (pv_wsola_t * w)
+{
+   w->prev = -1;
+   memset(w->l_out, 0, sizeof(double) * (w->hop_syn + w->len));
+   memset(w->r_out, 0, sizeof(double) * (w->hop_syn + w->len));
+}
+
+/**
+ *    Finds the offset, from 0 to \a n_cand - 1 in the region, of the
+ *    candidate most like the template.  Both mono mixes must be set.  A
+ *    silent template gives the offset \a nominal.
+ */
+
+static long
+wsola_search (pv_wsola_t * w, long n_cand, long nominal)
+{
+   const long len = w->len;
+   const int d = w->decimate;
+   const long n_tmpl = len / d;
+   const long n_coarse = (n_cand - 1) / d + 1;
+   const long n_reg = (n_cand - 1) + len;
+   long best = 0;
+   double best_score = -1.0e300;
+   double e_tmpl = 0.0;
+   long lo;
+   long hi;
+   long i;
+   long k;
+   for (i = 0; i < len; ++i)
+      e_tmpl += w->m_tmpl[i] * w->m_tmpl[i];
+
+   if (e_tmpl <= 0.0)
+      return nominal;
+
+   /*
+    * The decimated region and template, zero-padded to n_fft.
+    */
+
+   memset(w->x_time, 0, sizeof(double) * w->n_fft);
+   memset(w->t_time, 0, sizeof(double) * w->n_fft);
+   for (i = 0; i < n_reg / d; ++i)
+   {
+      double s = 0.0;
+      int j;
+      for (j = 0; j < d; ++j)
+         s += w->m_reg[i * d + j];
+
+      w->x_time[i] = s;
+   }
+   for (i = 0; i < n_tmpl; ++i)
+   {
+      double s = 0.0;
+      int j;
+      for (j = 0; j < d; ++j)
+         s += w->m_tmpl[i * d + j];
+
+      w->t_time[i] = s;
+   }
+   w->energy[0] = 0.0;
+   for (i = 0; i < w->n_fft; ++i)
+      w->energy[i + 1] = w->energy[i] + w->x_time[i] * w->x_time[i];
+
+   /*
+    * c[k] = sum x[k + i] t[i], the inverse FFT of X conj(T).  The region
+    * and template fit in n_fft, so no candidate wraps around.
+    */
+
+   fftw_execute(w->plan_x);
+   fftw_execute(w->plan_t);
+   for (i = 0; i < w->n_fft / 2 + 1; ++i)
+   {
+      double xr = w->x_freq[i][0];
+      double xi = w->x_freq[i][1];
+      double tr = w->t_freq[i][0];
+      double ti = w->t_freq[i][1];
+      w->x_freq[i][0] = xr * tr + xi * ti;
+      w->x_freq[i][1] = xi * tr - xr * ti;
+   }
+   fftw_execute(w->plan_c);
+   for (k = 0; k < n_coarse; ++k)
+   {
+      double e = w->energy[k + n_tmpl] - w->energy[k];
+      double score = e > 0.0 ? w->c_time[k] / sqrt(e) : 0.0;
+      if (score > best_score)
+      {
+         best_score = score;
+         best = k * d;
+      }
+   }
+
+   /*
+    * Refine at the full rate.
+    */
+
+   if (d == 1)
+      return best;
+
+   lo = best - (d - 1);
+   hi = best + (d - 1);
+   if (lo < 0)
+      lo = 0;
+
+   if (hi > n_cand - 1)
+      hi = n_cand - 1;
+
+   best_score = -1.0e300;
+   for (k = lo; k <= hi; ++k)
+   {
+      const double * x = w->m_reg + k;
+      double c = 0.0;
+      double e = 0.0;
+      double score;
+      for (i = 0; i < len; ++i)
+      {
+         c += x[i] * w->m_tmpl[i];
+         e += x[i] * x[i];
+      }
+      score = e > 0.0 ? c / sqrt(e) : 0.0;
+      if (score > best_score)
+      {
+         best_score = score;
+         best = k;
+      }
+   }
+   return best;
+}
+
+/**
+ *    Makes one hop of the output.
+ *
+ * \param w
+ *    The WSOLA state.
+ *
+ * \param reader
+ *    Reads the input frames.
+ *
+ * \param data
+ *    The first parameter of the reader.
+ *
+ * \param cur
+ *    The nominal frame of the segment; the caller advances it by the
+ *    analysis hop.
+ *
+ * \param left
+ *    Gets the hop_syn frames of the left channel.
+ *
+ * \param right
+ *    Gets the hop_syn frames of the right channel.
+ *
+ * \return
+ *    Returns hop_syn on success.  Otherwise it returns what the reader
+ *    returned for the frames it lacked, and nothing has changed.
+ */
+
+long
+pv_wsola_step
+(
+   pv_wsola_t * w,
+   pv_wsola_reader_t reader,
+   void * data,
+   long cur,
+   double * left,
+   double * right
+)
+{
+   const long len = w->len;
+   const long hop = w->hop_syn;
+   long pos = 0;                       /* offset of the segment in l_reg[]   */
+   long i;
+   if (w->prev < 0 || w->tolerance == 0)
+   {
+      long status = reader(data, cur, w->l_reg, w->r_reg, len);
+      if (status != len)
+         return status;
+
+      w->prev = cur;
+   }
+   else
+   {
+      long lo = cur - w->tolerance;
+      long n_cand;
+      long status;
+      if (lo < 0)
+         lo = 0;
+
+      n_cand = cur + w->tolerance - lo + 1;
+      status = reader(data, w->prev + hop, w->l_tmpl, w->r_tmpl, len);
+      if (status < 0)
+         return status;
+
+      status = reader(data, lo, w->l_reg, w->r_reg, n_cand - 1 + len);
+      if (status < 0)
+         return status;
+
+      /*
+       * At the end of the input, the candidates past it are dropped; the
+       * step fails only if the nominal segment itself is short.
+       */
+
+      if (status < n_cand - 1 + len)
+      {
+         if (status < cur - lo + len)
+            return status;
+
+         n_cand = status - len + 1;
+      }
+      for (i = 0; i < len; ++i)
+         w->m_tmpl[i] = w->l_tmpl[i] + w->r_tmpl[i];
+
+      for (i = 0; i < n_cand - 1 + len; ++i)
+         w->m_reg[i] = w->l_reg[i] + w->r_reg[i];
+
+      pos = wsola_search(w, n_cand, cur - lo);
+      w->prev = lo + pos;
+   }
+   for (i = 0; i < len; ++i)
+   {
+      w->l_out[hop + i] += w->window[i] * w->l_reg[pos + i];
+      w->r_out[hop + i] += w->window[i] * w->r_reg[pos + i];
+   }
+   memcpy(left, w->l_out, sizeof(double) * hop);
+   memcpy(right, w->r_out, sizeof(double) * hop);
+   memmove(w->l_out, w->l_out + hop, sizeof(double) * len);
+   memmove(w->r_out, w->r_out + hop, sizeof(double) * len);
+   memset(w->l_out + len, 0, sizeof(double) * hop);
+   memset(w->r_out + len, 0, sizeof(double) * hop);
+   return hop;
+}
+
+/**
+ *    Returns the first input frame that the step at \a cur may read, for
+ *    the caller that discards the input as it goes.
+ */
+
+long
+pv_wsola_keep (const pv_wsola_t * w, long cur)
+{
+   long result = cur - w->tolerance;
+   if (w->prev >= 0 && w->prev + w->hop_syn < result)
+      result = w->prev + w->hop_syn;
+
+   return result > 0 ? result : 0;
+}
+
+/*
+ * The engine interface (see pv-engine.h).
+ */
+
+/**
+ *    Holds the state of pv_wsola_engine.
+ */
+
+typedef struct
+{
+   pv_wsola_t * wsola;
+   long hop_ana;           /*<< The analysis hop.                             */
+   long cur;               /*<< The nominal frame of the next segment.        */
+
+} wsola_engine_state_t;
+
+/**
+ *    Adapts pv_engine_input_read_at() to pv_wsola_reader_t.
+ */
+
+static long
+wsola_engine_read
+(
+   void * data,
+   long frame,
+   double * left,
+   double * right,
+   long len
+)
+{
+   return pv_engine_input_read_at
+   (
+      (pv_engine_input_t *) data, frame, left, right, len
+   );
+}
+
+static void *
+wsola_engine_init
+(
+   const pv_engine_params_t * params,
+   pv_engine_shape_t * shape
+)
+{
+   wsola_engine_state_t * st;
+   long hop_res = (long)
+      ((double) params->hop_syn * pow(2.0, -params->pitch_shift / 12.0));
+
+   long hop_ana = (long) ((double) hop_res * params->rate);
+   if (hop_ana <= 0 || hop_res <= 0)
+      return nullptr;
+
+   st = (wsola_engine_state_t *) malloc(sizeof(wsola_engine_state_t));
+   if (is_nullptr(st))
+      return nullptr;
+
+   st->wsola = pv_wsola_new(params->len, params->hop_syn, params->flag_window);
+   if (is_nullptr(st->wsola))
+   {
+      free(st);
+      return nullptr;
+   }
+   st->hop_ana = hop_ana;
+   st->cur = 0;
+   shape->block = params->hop_syn;
+   shape->hop_res = hop_res;
+   shape->tail = params->len;
+   return st;
+}
+
+static long
+wsola_engine_process_block
+(
+   void * state,
+   pv_engine_input_t * in,
+   double * left,
+   double * right
+)
+{
+   wsola_engine_state_t * st = (wsola_engine_state_t *) state;
+   long status = pv_wsola_step
+   (
+      st->wsola, wsola_engine_read, in, st->cur, left, right
+   );
+   if (status == PV_ENGINE_MORE)
+      return PV_ENGINE_MORE;
+   else if (status != st->wsola->hop_syn)
+      return PV_ENGINE_END;
+
+   st->cur += st->hop_ana;
+   in->keep = pv_wsola_keep(st->wsola, st->cur);
+   return status;
+}
+
+static long
+wsola_engine_flush (void * state, double * left, double * right)
+{
+   pv_wsola_t * w = ((wsola_engine_state_t *) state)->wsola;
+   memcpy(left, w->l_out, sizeof(double) * w->len);
+   memcpy(right, w->r_out, sizeof(double) * w->len);
+   return w->len;
+}
+
+static void
+wsola_engine_free (void * state)
+{
+   wsola_engine_state_t * st = (wsola_engine_state_t *) state;
+   pv_wsola_free(st->wsola);
+   free(st);
+}
+
+const pv_engine_ops_t pv_wsola_engine =
+{
+   "wsola",
+   "waveform-similarity overlap-add, time-domain (speech, percussion)",
+   wsola_engine_init,
+   wsola_engine_process_block,
+   wsola_engine_flush,
+   wsola_engine_free
+};
+
+/**
+ *    Stretches a file by WSOLA, through pv_wsola_engine.
+ *
+ * \param rate
+ *    The time-stretching rate.
+ *
+ * \param pitch_shift
+ *    In half-notes, done by resampling.
+ *
+ * \return
+ *    Returns 0 on success, and -1 on failure (with a message).
+ */
+
+int
+pv_wsola
+(
+   const char * file,
+   const char * outfile,
+   double rate,
+   double pitch_shift,
+   long len,
+   long hop_syn,
+   int flag_window
+)
+{
+   pv_engine_params_t params;
+   pv_engine_params_init(&params);
+   params.len = len;
+   params.hop_syn = hop_syn;
+   params.rate = rate;
+   params.pitch_shift = pitch_shift;
+   params.flag_window = flag_window;
+   return pv_engine_render_file(&pv_wsola_engine, &params, file, outfile);
+}
+
+/*
+ * pv-wsola.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
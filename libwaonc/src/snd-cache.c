@@ -0,0 +1,329 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : decoded-sample cache
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          snd-cache.c
+ *
+ *    This module holds the decoded samples of a sound file in memory.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The pool of blocks is mapped rather than allocated, so that its pages
+ *    cost nothing until a block is decoded into them, and the kernel may
+ *    page out the blocks not read for a while.
+ */
+
+#include <stdlib.h>                    /* malloc(), calloc(), free()          */
+#include <string.h>                    /* memset()                            */
+#include <sys/mman.h>                  /* mmap(), munmap()                    */
+
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "snd-cache.h"                 /* snd_cache_t                         */
+
+/**
+ *    Converts \a got frames of the decode buffer to float, keeping the
+ *    first channels, and clears the rest of the \a len frames.
+ */
+
+static void
+cache_convert (const snd_cache_t * cache, float * dest, long got, long len)
+{
+   int ch = cache->sfinfo.channels;
+   long i;
+   for (i = 0; i < got; ++i)
+   {
+      dest[i * cache->channels] = (float) cache->decode[i * ch];
+      if (cache->channels > 1)
+         dest[i * cache->channels + 1] = (float) cache->decode[i * ch + 1];
+   }
+   memset
+   (
+      dest + got * cache->channels, 0,
+      sizeof(float) * (len - got) * cache->channels
+   );
+}
+
+/**
+ *    Decodes the whole file into data[].
+ *
+ * \return
+ *    Returns wfalse if the memory cannot be had, in which case the file is
+ *    read by blocks.
+ */
+
+static wbool_t
+cache_decode_whole (snd_cache_t * cache)
+{
+   long frames = (long) cache->sfinfo.frames;
+   long pos;
+   cache->data = (float *) malloc
+   (
+      sizeof(float) * (frames > 0 ? frames : 1) * cache->channels
+   );
+   if (is_nullptr(cache->data))
+      return wfalse;
+
+   for (pos = 0; pos < frames; pos += SND_CACHE_BLOCK)
+   {
+      long len = frames - pos;
+      sf_count_t got;
+      if (len > SND_CACHE_BLOCK)
+         len = SND_CACHE_BLOCK;
+
+      got = sf_readf_double(cache->sf, cache->decode, len);
+      if (got < 0)
+         got = 0;
+
+      cache_convert(cache, cache->data + pos * cache->channels, got, len);
+   }
+   return wtrue;
+}
+
+/**
+ *    Returns the samples of block \a b, decoding it over the least recently
+ *    used slot if it is not held.  The lock is held.
+ */
+
+static const float *
+cache_block (snd_cache_t * cache, long b)
+{
+   long size = (long) SND_CACHE_BLOCK * cache->channels;
+   int slot = cache->last;
+   if (cache->block[slot] != b)
+   {
+      int lru = 0;
+      int s;
+      for (s = 0; s < SND_CACHE_BLOCKS; ++s)
+      {
+         if (cache->block[s] == b)
+            break;
+
+         if (cache->used[s] < cache->used[lru])
+            lru = s;
+      }
+      if (s == SND_CACHE_BLOCKS)
+      {
+         sf_count_t pos = (sf_count_t) b * SND_CACHE_BLOCK;
+         sf_count_t got = 0;
+         s = lru;
+         cache->block[s] = b;
+         if (sf_seek(cache->sf, pos, SEEK_SET) != -1)
+            got = sf_readf_double(cache->sf, cache->decode, SND_CACHE_BLOCK);
+
+         if (got < 0)
+            got = 0;
+
+         cache_convert(cache, cache->pool + s * size, got, SND_CACHE_BLOCK);
+      }
+      slot = cache->last = s;
+   }
+   cache->used[slot] = ++cache->clock;
+   return cache->pool + slot * size;
+}
+
+/**
+ *    Opens a sound file and decodes it, whole if it fits in
+ *    SND_CACHE_FULL_MAX bytes.
+ *
+ * \param file
+ *    Provides the name of the file.
+ *
+ * \return
+ *    Returns the cache, or a null pointer if the file cannot be opened.
+ */
+
+snd_cache_t *
+snd_cache_open (const char * file)
+{
+   snd_cache_t * cache = (snd_cache_t *) calloc(1, sizeof(snd_cache_t));
+   double bytes;
+   int s;
+   CHECK_MALLOC(cache, "snd_cache_open");
+   cache->sf = sf_open(file, SFM_READ, &cache->sfinfo);
+   if (is_nullptr(cache->sf))
+   {
+      errprintf("snd_cache_open: cannot open %s\n", file);
+      free(cache);
+      return nullptr;
+   }
+   cache->channels = cache->sfinfo.channels > 1 ? 2 : 1;
+   cache->decode = (double *) malloc
+   (
+      sizeof(double) * SND_CACHE_BLOCK * cache->sfinfo.channels
+   );
+   CHECK_MALLOC(cache->decode, "snd_cache_open");
+   pthread_mutex_init(&cache->lock, NULL);
+   bytes = (double) sizeof(float) * cache->channels * cache->sfinfo.frames;
+   if (bytes <= (double) SND_CACHE_FULL_MAX && cache_decode_whole(cache))
+   {
+      cache->whole = wtrue;
+      sf_close(cache->sf);
+      cache->sf = nullptr;
+      free(cache->decode);
+      cache->decode = nullptr;
+      return cache;
+   }
+   cache->pool_size = sizeof(float) * SND_CACHE_BLOCKS *
+      (size_t) SND_CACHE_BLOCK * cache->channels;
+
+   cache->pool = (float *) mmap
+   (
+      NULL, cache->pool_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0
+   );
+   if (cache->pool == (float *) MAP_FAILED)
+   {
+      errprint("snd_cache_open: cannot map the blocks");
+      exit(1);
+   }
+   cache->block = (long *) malloc(sizeof(long) * SND_CACHE_BLOCKS);
+   cache->used = (unsigned long *) calloc
+   (
+      SND_CACHE_BLOCKS, sizeof(unsigned long)
+   );
+   CHECK_MALLOC(cache->block, "snd_cache_open");
+   CHECK_MALLOC(cache->used, "snd_cache_open");
+   for (s = 0; s < SND_CACHE_BLOCKS; ++s)
+      cache->block[s] = -1;
+
+   return cache;
+}
+
+/**
+ *    Reads frames, as sndfile_read_at() does, from any thread.
+ *
+ * \param cache
+ *    Provides the cache.
+ *
+ * \param start
+ *    Provides the first frame.  The frames out of the file read as 0.
+ *
+ * \param [out] left
+ *    Provides the destination for the first channel, [len].
+ *
+ * \param [out] right
+ *    Provides the destination for the second channel, [len], or a null
+ *    pointer.  A mono file reads as 0 here, as with sndfile_read_at().
+ *
+ * \param len
+ *    Provides the number of frames.
+ *
+ * \return
+ *    Returns the number of frames within the file.
+ */
+
+long
+snd_cache_read_at
+(
+   snd_cache_t * cache,
+   long start,
+   double * left,
+   double * right,
+   long len
+)
+{
+   long frames = (long) cache->sfinfo.frames;
+   int ch = cache->channels;
+   long n = 0;
+   long i = 0;
+   if (! cache->whole)
+      pthread_mutex_lock(&cache->lock);
+
+   while (i < len)
+   {
+      long f = start + i;
+      long count, k;
+      const float * p;
+      if (f < 0 || f >= frames)
+      {
+         left[i] = 0.0;
+         if (not_nullptr(right))
+            right[i] = 0.0;
+
+         ++i;
+         continue;
+      }
+
+      /* the run of frames from f on, within the file and one block */
+
+      count = len - i;
+      if (count > frames - f)
+         count = frames - f;
+
+      if (cache->whole)
+         p = cache->data + f * ch;
+      else
+      {
+         long offset = f % SND_CACHE_BLOCK;
+         if (count > SND_CACHE_BLOCK - offset)
+            count = SND_CACHE_BLOCK - offset;
+
+         p = cache_block(cache, f / SND_CACHE_BLOCK) + offset * ch;
+      }
+      for (k = 0; k < count; ++k)
+      {
+         left[i + k] = p[k * ch];
+         if (not_nullptr(right))
+            right[i + k] = ch > 1 ? p[k * ch + 1] : 0.0;
+      }
+      i += count;
+      n += count;
+   }
+   if (! cache->whole)
+      pthread_mutex_unlock(&cache->lock);
+
+   return n;
+}
+
+/**
+ *    Frees the cache, and closes its file.
+ *
+ * \param cache
+ *    Provides the cache.  A null pointer is ignored.
+ */
+
+void
+snd_cache_close (snd_cache_t * cache)
+{
+   if (is_nullptr(cache))
+      return;
+
+   if (not_nullptr(cache->sf))
+      sf_close(cache->sf);
+
+   if (not_nullptr(cache->pool))
+      munmap(cache->pool, cache->pool_size);
+
+   pthread_mutex_destroy(&cache->lock);
+   free(cache->data);
+   free(cache->block);
+   free(cache->used);
+   free(cache->decode);
+   free(cache);
+}
+
+/*
+ * snd-cache.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -38,43 +38,51 @@
 #include "memory-check.h"              /* CHECK_MALLOC() macro          */
 #include "snd.h"                       /* this module's functions       */
 
+/**
+ *    Reads frames, splitting the first two channels.
+ *
+ * \param buf
+ *    Provides room for len * sfinfo.channels samples, in which a file of
+ *    more than one channel is read before it is split.  If null, a buffer
+ *    is allocated for the call.  There is no buffer of the module, so
+ *    that threads can read their own files at the same time.
+ *
+ * \return
+ *    Returns the frames read.
+ */
+
 long sndfile_read
 (
    SNDFILE * sf,
    SF_INFO sfinfo,
    double * left,
    double * right,
-   int len
+   int len,
+   double * buf
 )
 {
-   static double * buf = NULL;
-   static int nbuf = 0;
    sf_count_t status;
-   if (buf == NULL)
-   {
-      buf = (double *)malloc (sizeof (double) * len * sfinfo.channels);
-      CHECK_MALLOC (buf, "sndfile_read");
-      nbuf = len * sfinfo.channels;
-   }
-   if (len * sfinfo.channels > nbuf)
-   {
-      buf = (double *)realloc (buf, sizeof (double) * len * sfinfo.channels);
-      CHECK_MALLOC (buf, "sndfile_read");
-      nbuf = len * sfinfo.channels;
-   }
    if (sfinfo.channels == 1)
    {
       status = sf_readf_double (sf, left, (sf_count_t)len);
    }
    else
    {
+      double * own = nullptr;
       int i;
+      if (is_nullptr(buf))
+      {
+         own = (double *)malloc (sizeof (double) * len * sfinfo.channels);
+         CHECK_MALLOC (own, "sndfile_read");
+         buf = own;
+      }
       status = sf_readf_double (sf, buf, (sf_count_t)len);
-      for (i = 0; i < len; i ++)
+      for (i = 0; i < status; i ++)
       {
          left  [i] = buf [i * sfinfo.channels];
          right [i] = buf [i * sfinfo.channels + 1];
       }
+      free (own);
    }
 
    return ((long) status);
@@ -100,7 +108,7 @@ long sndfile_read_at
       errprint("seek error");
       exit(1);
    }
-   return sndfile_read(sf, sfinfo, left, right, len);
+   return sndfile_read(sf, sfinfo, left, right, len, nullptr);
 }
 
 /**
@@ -0,0 +1,413 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : on-disk spectral-frame cache
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          spec-cache.c
+ *
+ *    This module provides the ".waonspec" file, which holds the power
+ *    spectra (stage 1) of every frame of a sound file.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The values are stored as float, which halves the size of the file
+ *    and is far more precise than the velocity scale (127 steps over the
+ *    -cut_ratio decades) needs.
+ */
+
+#include <fcntl.h>                     /* open()                              */
+#include <stdlib.h>                    /* malloc(), free()                    */
+#include <string.h>                    /* memcpy(), memset(), memcmp()        */
+#include <sys/mman.h>                  /* mmap(), munmap()                    */
+#include <sys/stat.h>                  /* fstat(), stat()                     */
+#include <unistd.h>                    /* close()                             */
+
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "spec-cache.h"                /* waon_spec_cache_t                   */
+
+/**
+ *    Fills in the key (header) that describes the analysis of a source.
+ *
+ * \param [out] key
+ *    Provides the header to fill in.  Its frame_count is 0.
+ *
+ * \param source
+ *    Provides the name of the sound file, used for its modification time.
+ *    If null or "-", the time is 0, and spec_cache_matches() then matches
+ *    no cache.
+ *
+ * \param fft_len
+ *    Provides the FFT length.
+ *
+ * \param shift_hop
+ *    Provides the samples between frames.  A value of 0 matches any hop
+ *    in spec_cache_matches().
+ *
+ * \param flag_window
+ *    Provides the window.
+ *
+ * \param samplerate
+ *    Provides the sample rate of the source.
+ *
+ * \param channels
+ *    Provides the channel count of the source.
+ *
+ * \param source_frames
+ *    Provides the length of the source, in frames.
+ *
+ * \param has_dphi
+ *    Indicates that the dphi[] arrays are needed (or provided).
+ */
+
+void
+spec_cache_key
+(
+   waon_spec_header_t * key,
+   const char * source,
+   long fft_len,
+   long shift_hop,
+   int flag_window,
+   int samplerate,
+   int channels,
+   long source_frames,
+   wbool_t has_dphi
+)
+{
+   struct stat st;
+   memset(key, 0, sizeof(*key));
+   memcpy(key->magic, SPEC_CACHE_MAGIC, sizeof(key->magic));
+   key->version = SPEC_CACHE_VERSION;
+   key->header_size = (int32_t) sizeof(waon_spec_header_t);
+   key->fft_len = (int32_t) fft_len;
+   key->shift_hop = (int32_t) shift_hop;
+   key->flag_window = (int32_t) flag_window;
+   key->samplerate = (int32_t) samplerate;
+   key->channels = (int32_t) channels;
+   key->has_dphi = has_dphi ? 1 : 0;
+   key->source_frames = (int64_t) source_frames;
+   if (not_nullptr(source) && strcmp(source, "-") != 0)
+   {
+      if (stat(source, &st) == 0)
+         key->source_mtime = (int64_t) st.st_mtime;
+   }
+   key->frame_count = 0;
+}
+
+/**
+ *    Checks that a cache holds the analysis described by a key.
+ *
+ * \param cache
+ *    Provides the cache.
+ *
+ * \param key
+ *    Provides the key, from spec_cache_key().  The hop is not checked if
+ *    it is 0.  A modification time of 0 (standard input, or no stat())
+ *    matches nothing, since nothing else identifies the audio.  The cache
+ *    may hold the dphi[] arrays even if the key does not need them.
+ *
+ * \return
+ *    Returns wtrue if the cache can be used.
+ */
+
+wbool_t
+spec_cache_matches
+(
+   const waon_spec_cache_t * cache,
+   const waon_spec_header_t * key
+)
+{
+   const waon_spec_header_t * h = &cache->header;
+   return
+      h->fft_len == key->fft_len &&
+      (key->shift_hop == 0 || h->shift_hop == key->shift_hop) &&
+      h->flag_window == key->flag_window &&
+      h->samplerate == key->samplerate &&
+      h->channels == key->channels &&
+      h->source_frames == key->source_frames &&
+      h->source_mtime != 0 && h->source_mtime == key->source_mtime &&
+      (h->has_dphi || ! key->has_dphi);
+}
+
+/**
+ *    Sets the sizes that follow from the header.
+ */
+
+static void
+spec_cache_sizes (waon_spec_cache_t * cache)
+{
+   cache->nbin = cache->header.fft_len / 2 + 1;
+   cache->record = 1 + cache->nbin * (cache->header.has_dphi ? 2 : 1);
+}
+
+/**
+ *    Opens and maps an existing cache for reading.
+ *
+ * \param name
+ *    Provides the name of the cache file.
+ *
+ * \param key
+ *    Provides the key the cache must match, or null to accept any
+ *    complete cache (the caller then checks the header).
+ *
+ * \return
+ *    Returns the cache, or null if the file does not exist, is not a
+ *    complete cache, or does not match the key.  Close it with
+ *    spec_cache_close().
+ */
+
+waon_spec_cache_t *
+spec_cache_open
+(
+   const char * name,
+   const waon_spec_header_t * key
+)
+{
+   waon_spec_cache_t * cache = nullptr;
+   waon_spec_header_t header;
+   struct stat st;
+   int fd = open(name, O_RDONLY);
+   if (fd < 0)
+      return nullptr;
+
+   if
+   (
+      fstat(fd, &st) == 0 &&
+      read(fd, &header, sizeof(header)) == (ssize_t) sizeof(header) &&
+      memcmp(header.magic, SPEC_CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == SPEC_CACHE_VERSION &&
+      header.header_size == (int32_t) sizeof(header) &&
+      header.fft_len > 0 && header.frame_count > 0
+   )
+   {
+      cache = (waon_spec_cache_t *) malloc(sizeof(waon_spec_cache_t));
+      CHECK_MALLOC(cache, "spec_cache_open");
+      memset(cache, 0, sizeof(*cache));
+      cache->header = header;
+      spec_cache_sizes(cache);
+      cache->map_size = sizeof(header) +
+         (size_t) header.frame_count * cache->record * sizeof(float);
+
+      if
+      (
+         (size_t) st.st_size < cache->map_size ||
+         (not_nullptr(key) && ! spec_cache_matches(cache, key))
+      )
+      {
+         free(cache);
+         cache = nullptr;
+      }
+      else
+      {
+         cache->map = mmap
+         (
+            nullptr, cache->map_size, PROT_READ, MAP_SHARED, fd, 0
+         );
+         if (cache->map == MAP_FAILED)
+         {
+            free(cache);
+            cache = nullptr;
+         }
+         else
+            cache->data = (const float *)
+               ((const char *) cache->map + sizeof(header));
+      }
+   }
+   close(fd);
+   return cache;
+}
+
+/**
+ *    Creates a cache file to be filled by spec_cache_write().
+ *
+ * \param name
+ *    Provides the name of the cache file, which is overwritten.
+ *
+ * \param key
+ *    Provides the header, from spec_cache_key().
+ *
+ * \return
+ *    Returns the cache, or null if the file cannot be created (the error
+ *    is reported).  Close it with spec_cache_close(), which completes the
+ *    header.
+ */
+
+waon_spec_cache_t *
+spec_cache_create
+(
+   const char * name,
+   const waon_spec_header_t * key
+)
+{
+   waon_spec_cache_t * cache;
+   FILE * f = fopen(name, "wb");
+   if (is_nullptr(f))
+   {
+      errprintf("? cannot create spectral cache %s\n", name);
+      return nullptr;
+   }
+   cache = (waon_spec_cache_t *) malloc(sizeof(waon_spec_cache_t));
+   CHECK_MALLOC(cache, "spec_cache_create");
+   memset(cache, 0, sizeof(*cache));
+   cache->header = *key;
+   cache->header.frame_count = 0;
+   spec_cache_sizes(cache);
+   cache->buffer = (float *) malloc(sizeof(float) * cache->record);
+   CHECK_MALLOC(cache->buffer, "spec_cache_create");
+   cache->file = f;
+   fwrite(&cache->header, sizeof(cache->header), 1, f);
+   return cache;
+}
+
+/**
+ *    Appends the record of the next frame to a cache being written.
+ *
+ * \param cache
+ *    Provides the cache, from spec_cache_create().
+ *
+ * \param mean_square
+ *    Provides the frame_mean_square() of the frame.
+ *
+ * \param power[fft_len/2+1]
+ *    Provides the power spectrum.
+ *
+ * \param dphi[fft_len/2+1]
+ *    Provides the phase correction.  Used only if the header has_dphi;
+ *    then null means zeros.
+ */
+
+void
+spec_cache_write
+(
+   waon_spec_cache_t * cache,
+   double mean_square,
+   const double * power,
+   const double * dphi
+)
+{
+   long i;
+   float * r = cache->buffer;
+   r[0] = (float) mean_square;
+   for (i = 0; i < cache->nbin; ++i)
+      r[1 + i] = (float) power[i];
+
+   if (cache->header.has_dphi)
+   {
+      for (i = 0; i < cache->nbin; ++i)
+         r[1 + cache->nbin + i] = not_nullptr(dphi) ? (float) dphi[i] : 0.0f;
+   }
+   if (fwrite(r, sizeof(float), cache->record, cache->file) ==
+         (size_t) cache->record)
+   {
+      ++cache->header.frame_count;
+   }
+}
+
+/**
+ *    Gets the number of frames of a cache.
+ */
+
+long
+spec_cache_frames (const waon_spec_cache_t * cache)
+{
+   return (long) cache->header.frame_count;
+}
+
+/**
+ *    Reads the record of one frame of a mapped cache.
+ *
+ * \param cache
+ *    Provides the cache, from spec_cache_open().
+ *
+ * \param k
+ *    Provides the frame, in the range [0, spec_cache_frames()).
+ *
+ * \param [out] power[fft_len/2+1]
+ *    Provides the destination of the power spectrum.  Can be null.
+ *
+ * \param [out] dphi[fft_len/2+1]
+ *    Provides the destination of the phase correction, or null.  Zeros
+ *    are provided if the cache has no dphi[] arrays.
+ *
+ * \return
+ *    Returns the mean-square of the frame.
+ */
+
+double
+spec_cache_read
+(
+   const waon_spec_cache_t * cache,
+   long k,
+   double * power,
+   double * dphi
+)
+{
+   const float * r = cache->data + k * cache->record;
+   long i;
+   if (not_nullptr(power))
+   {
+      for (i = 0; i < cache->nbin; ++i)
+         power[i] = (double) r[1 + i];
+   }
+   if (not_nullptr(dphi))
+   {
+      for (i = 0; i < cache->nbin; ++i)
+      {
+         dphi[i] = cache->header.has_dphi ?
+            (double) r[1 + cache->nbin + i] : 0.0;
+      }
+   }
+   return (double) r[0];
+}
+
+/**
+ *    Closes a cache.  A cache being written gets its final frame count
+ *    in the header; a mapped cache is unmapped.
+ *
+ * \param cache
+ *    Provides the cache.  A null pointer is ignored.
+ */
+
+void
+spec_cache_close (waon_spec_cache_t * cache)
+{
+   if (not_nullptr(cache))
+   {
+      if (not_nullptr(cache->file))
+      {
+         if (fseek(cache->file, 0L, SEEK_SET) == 0)
+            fwrite(&cache->header, sizeof(cache->header), 1, cache->file);
+
+         fclose(cache->file);
+         free(cache->buffer);
+      }
+      if (not_nullptr(cache->map))
+         munmap(cache->map, cache->map_size);
+
+      free(cache);
+   }
+}
+
+/*
+ * spec-cache.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,675 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : tiled cache of spectrogram columns
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          spec-tiles.c
+ *
+ *    This module caches the spectra of the columns of a spectrogram, and
+ *    computes the missing ones on worker threads.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    A tile goes from free to queued (by spec_tiles_column()), to busy (a
+ *    worker took it), to ready.  Only the calling thread frees or reuses a
+ *    tile, and never a busy one, so a worker fills the data of its tile
+ *    without the lock.  The lock guards the states and the counts.
+ *
+ *    The columns are computed by spg_columns_compute() (see
+ *    spectrogram.c), and stored as float.
+ */
+
+#include <pthread.h>                   /* pthread_create(), mutex, condition  */
+#include <stdlib.h>                    /* malloc(), free(), exit()            */
+#include <string.h>                    /* memset()                            */
+#include <unistd.h>                    /* sysconf()                           */
+
+#include "hc-simd.h"                   /* hc_simd_level()                     */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "spec-tiles.h"                /* spec_tiles_t                        */
+
+/**
+ *    Provides the states of a tile.
+ */
+
+typedef enum
+{
+   SPEC_TILE_FREE,
+   SPEC_TILE_QUEUED,
+   SPEC_TILE_BUSY,
+   SPEC_TILE_READY
+
+} spec_tile_state_t;
+
+/**
+ *    Holds one tile.  The data are the power spectra of the columns,
+ *    [SPEC_TILES_COLUMNS][nbin], followed by their phase differences if
+ *    the key has a hop.
+ */
+
+typedef struct
+{
+   spec_tiles_key_t key;
+   long index;             /*<< Holds columns index * SPEC_TILES_COLUMNS on.  */
+   spec_tile_state_t state;
+   float * data;           /*<< Allocated unless the tile is free.            */
+   long size;              /*<< Floats in data[].                             */
+   unsigned long used;     /*<< When it was last asked for.                   */
+   unsigned long pass;     /*<< The redraw that last asked for it.            */
+
+} spec_tile_t;
+
+/**
+ *    Holds a worker thread with its buffers.
+ */
+
+typedef struct
+{
+   struct spec_tiles * tiles;
+   spg_columns_t * cols;   /*<< The batch and the buffers.                    */
+   pthread_t thread;
+
+} spec_tiles_worker_t;
+
+/**
+ *    Holds the cache.
+ */
+
+struct spec_tiles
+{
+   snd_cache_t * snd;      /*<< The decoded samples of the file.              */
+   const waon_spec_cache_t * disk; /*<< The ".waonspec" file, or null.        */
+   spec_tile_t * tile;     /*<< [SPEC_TILES_MAX]                              */
+   int count;              /*<< Slots of tile[] in use.                       */
+   int last;               /*<< The last tile found, tried first.             */
+   long bytes;             /*<< Memory of the data of the tiles.              */
+   unsigned long clock;
+   unsigned long pass;     /*<< Counts the spec_tiles_begin() calls.          */
+   long fft_len;           /*<< The length the batches are planned for.       */
+   wbool_t planning;       /*<< The batches are being planned again.          */
+   int busy;               /*<< Workers computing a tile.                     */
+   wbool_t running;
+   spec_tiles_worker_t * worker;
+   int threads;
+   pthread_mutex_t lock;
+   pthread_cond_t queued;  /*<< Signalled when a tile is queued.              */
+   pthread_cond_t idle;    /*<< Signalled when busy goes to 0.                */
+   spec_tiles_notify_t notify;
+   void * notify_data;
+};
+
+/**
+ *    Fills the power spectra of a tile from the ".waonspec" file, taking
+ *    for each column the frame of the file nearest to it, as gwaonc did.
+ *
+ * \return
+ *    Returns wfalse if the file does not hold the analysis of the key.
+ */
+
+static wbool_t
+tiles_from_disk
+(
+   spec_tiles_worker_t * w,
+   const spec_tiles_key_t * key,
+   long index,
+   float * data
+)
+{
+   const waon_spec_cache_t * disk = w->tiles->disk;
+   long nbin = key->fft_len / 2 + 1;
+   long hop, nframe;
+   double scale;
+   int j;
+   long k;
+   if (is_nullptr(disk) || key->hop != 0 ||
+         disk->header.fft_len != key->fft_len ||
+         disk->header.flag_window != key->flag_window)
+   {
+      return wfalse;
+   }
+   hop = disk->header.shift_hop;
+   nframe = spec_cache_frames(disk);
+
+   /* the file is scaled by init_den(), the columns by the FFT length */
+
+   scale = init_den(key->fft_len, key->flag_window) / (double) key->fft_len;
+   for (j = 0; j < SPEC_TILES_COLUMNS; ++j)
+   {
+      long pos = (index * SPEC_TILES_COLUMNS + j) * key->step;
+      long row = (pos + hop / 2) / hop;
+      float * a = data + j * nbin;
+      if (row >= nframe)
+      {
+         for (k = 0; k < nbin; ++k)
+            a[k] = 0.0f;
+      }
+      else
+      {
+         spec_cache_read(disk, row, w->cols->amp2, NULL);
+         for (k = 0; k < nbin; ++k)
+            a[k] = (float) (w->cols->amp2[k] * scale);
+      }
+   }
+   return wtrue;
+}
+
+/**
+ *    Computes the columns of a tile.
+ */
+
+static void
+tiles_compute
+(
+   spec_tiles_worker_t * w,
+   const spec_tiles_key_t * key,
+   long index,
+   float * data
+)
+{
+   long nbin = key->fft_len / 2 + 1;
+   if (key->hop == 0 && tiles_from_disk(w, key, index, data))
+      return;
+
+   spg_columns_compute
+   (
+      w->cols, w->tiles->snd, key, index * SPEC_TILES_COLUMNS,
+      SPEC_TILES_COLUMNS, data, data + SPEC_TILES_COLUMNS * nbin
+   );
+}
+
+/**
+ *    Returns the queued tile to compute next, the one asked for first, or
+ *    -1 if there is none.  The lock is held.
+ */
+
+static int
+tiles_next (const spec_tiles_t * tiles)
+{
+   int best = -1;
+   int t;
+   for (t = 0; t < tiles->count; ++t)
+   {
+      const spec_tile_t * tile = &tiles->tile[t];
+      if (tile->state == SPEC_TILE_QUEUED &&
+            tile->key.fft_len == tiles->fft_len &&
+            (best < 0 || tile->used < tiles->tile[best].used))
+      {
+         best = t;
+      }
+   }
+   return best;
+}
+
+/**
+ *    Runs a worker thread.
+ */
+
+static void *
+tiles_worker (void * arg)
+{
+   spec_tiles_worker_t * w = (spec_tiles_worker_t *) arg;
+   spec_tiles_t * tiles = w->tiles;
+   for (;;)
+   {
+      spec_tile_t * tile;
+      spec_tiles_key_t key;
+      int t = -1;
+      pthread_mutex_lock(&tiles->lock);
+      while (tiles->running &&
+            (tiles->planning || (t = tiles_next(tiles)) < 0))
+      {
+         pthread_cond_wait(&tiles->queued, &tiles->lock);
+      }
+      if (! tiles->running)
+      {
+         pthread_mutex_unlock(&tiles->lock);
+         break;
+      }
+      tile = &tiles->tile[t];
+      tile->state = SPEC_TILE_BUSY;
+      key = tile->key;
+      ++tiles->busy;
+      pthread_mutex_unlock(&tiles->lock);
+
+      tiles_compute(w, &key, tile->index, tile->data);
+
+      pthread_mutex_lock(&tiles->lock);
+      tile->state = SPEC_TILE_READY;
+      if (--tiles->busy == 0)
+         pthread_cond_broadcast(&tiles->idle);
+
+      pthread_mutex_unlock(&tiles->lock);
+      if (not_nullptr(tiles->notify))
+         tiles->notify(tiles->notify_data);
+   }
+   return NULL;
+}
+
+/**
+ *    Frees the batch and the buffers of a worker.
+ */
+
+static void
+tiles_worker_unplan (spec_tiles_worker_t * w)
+{
+   spg_columns_free(w->cols);
+   w->cols = nullptr;
+}
+
+/**
+ *    Plans the batches of the workers for another FFT length, once no
+ *    worker is busy, and drops the queued tiles of the old length.  This
+ *    runs on the calling thread, the only one that makes FFTW plans.
+ */
+
+static void
+tiles_plan (spec_tiles_t * tiles, long fft_len)
+{
+   int i;
+   pthread_mutex_lock(&tiles->lock);
+   tiles->planning = wtrue;
+   while (tiles->busy > 0)
+      pthread_cond_wait(&tiles->idle, &tiles->lock);
+
+   for (i = 0; i < tiles->threads; ++i)
+   {
+      spec_tiles_worker_t * w = &tiles->worker[i];
+      tiles_worker_unplan(w);
+      w->cols = spg_columns_new(fft_len, DEFAULT_FFT_BATCH);
+   }
+   for (i = 0; i < tiles->count; ++i)
+   {
+      spec_tile_t * tile = &tiles->tile[i];
+      if (tile->state == SPEC_TILE_QUEUED && tile->key.fft_len != fft_len)
+      {
+         tiles->bytes -= tile->size * (long) sizeof(float);
+         free(tile->data);
+         tile->data = nullptr;
+         tile->state = SPEC_TILE_FREE;
+      }
+   }
+   tiles->fft_len = fft_len;
+   tiles->planning = wfalse;
+   pthread_cond_broadcast(&tiles->queued);
+   pthread_mutex_unlock(&tiles->lock);
+}
+
+/**
+ *    Frees the least recently used ready tile, but not one the current
+ *    redraw asked for.  The lock is held.
+ *
+ * \return
+ *    Returns the slot freed, or -1 if there is none to free.
+ */
+
+static int
+tiles_evict (spec_tiles_t * tiles)
+{
+   int lru = -1;
+   int t;
+   for (t = 0; t < tiles->count; ++t)
+   {
+      const spec_tile_t * tile = &tiles->tile[t];
+      if (tile->state == SPEC_TILE_READY && tile->pass != tiles->pass &&
+            (lru < 0 || tile->used < tiles->tile[lru].used))
+      {
+         lru = t;
+      }
+   }
+   if (lru >= 0)
+   {
+      spec_tile_t * tile = &tiles->tile[lru];
+      tiles->bytes -= tile->size * (long) sizeof(float);
+      free(tile->data);
+      tile->data = nullptr;
+      tile->state = SPEC_TILE_FREE;
+   }
+   return lru;
+}
+
+/**
+ *    Finds a slot for a new tile of \a size floats, and allocates its
+ *    data.  The lock is held.
+ *
+ * \return
+ *    Returns the slot, or -1 if all of them are queued or busy.
+ */
+
+static int
+tiles_alloc (spec_tiles_t * tiles, long size)
+{
+   long need = size * (long) sizeof(float);
+   int t;
+   while (tiles->bytes + need > SPEC_TILES_MEMORY && tiles_evict(tiles) >= 0)
+      ;
+
+   for (t = 0; t < tiles->count; ++t)
+   {
+      if (tiles->tile[t].state == SPEC_TILE_FREE)
+         break;
+   }
+   if (t == tiles->count)
+   {
+      if (tiles->count < SPEC_TILES_MAX)
+         ++tiles->count;
+      else if ((t = tiles_evict(tiles)) < 0)
+         return -1;
+   }
+   tiles->tile[t].data = (float *) malloc(need);
+   CHECK_MALLOC(tiles->tile[t].data, "spec_tiles_column");
+   tiles->tile[t].size = size;
+   tiles->bytes += need;
+   return t;
+}
+
+/**
+ *    Returns the slot of a tile that is not free, or -1.  The lock is
+ *    held.
+ */
+
+static int
+tiles_find (spec_tiles_t * tiles, const spec_tiles_key_t * key, long index)
+{
+   int t = tiles->last;
+   int n;
+   for (n = 0; n < tiles->count; ++n, ++t)
+   {
+      const spec_tile_t * tile;
+      if (t >= tiles->count)
+         t = 0;
+
+      tile = &tiles->tile[t];
+      if (tile->state != SPEC_TILE_FREE && tile->index == index &&
+            tile->key.fft_len == key->fft_len &&
+            tile->key.hop == key->hop &&
+            tile->key.flag_window == key->flag_window &&
+            tile->key.step == key->step)
+      {
+         tiles->last = t;
+         return t;
+      }
+   }
+   return -1;
+}
+
+/**
+ *    Creates the cache and starts its worker threads.
+ *
+ * \param snd
+ *    Provides the decoded samples of the sound file.  They must stay open
+ *    until the cache is freed.
+ *
+ * \param threads
+ *    Provides the number of workers; 0 picks one less than the number of
+ *    processors, within 1 and SPEC_TILES_THREADS.
+ *
+ * \param notify
+ *    Provides the function a worker calls when a tile is ready, or null.
+ *    It runs on the worker thread, and must not call this module.
+ *
+ * \param data
+ *    Provides the argument of \a notify.
+ *
+ * \return
+ *    Returns the cache.
+ */
+
+spec_tiles_t *
+spec_tiles_new
+(
+   snd_cache_t * snd,
+   int threads,
+   spec_tiles_notify_t notify,
+   void * data
+)
+{
+   spec_tiles_t * tiles = (spec_tiles_t *) calloc(1, sizeof(spec_tiles_t));
+   int i;
+   CHECK_MALLOC(tiles, "spec_tiles_new");
+   if (threads <= 0)
+   {
+      threads = (int) sysconf(_SC_NPROCESSORS_ONLN) - 1;
+      if (threads > SPEC_TILES_THREADS)
+         threads = SPEC_TILES_THREADS;
+
+      if (threads < 1)
+         threads = 1;
+   }
+   tiles->tile = (spec_tile_t *) calloc(SPEC_TILES_MAX, sizeof(spec_tile_t));
+   tiles->worker = (spec_tiles_worker_t *) calloc
+   (
+      threads, sizeof(spec_tiles_worker_t)
+   );
+   CHECK_MALLOC(tiles->tile, "spec_tiles_new");
+   CHECK_MALLOC(tiles->worker, "spec_tiles_new");
+   tiles->snd = snd;
+   tiles->threads = threads;
+   tiles->notify = notify;
+   tiles->notify_data = data;
+   for (i = 0; i < threads; ++i)
+      tiles->worker[i].tiles = tiles;
+
+   pthread_mutex_init(&tiles->lock, NULL);
+   pthread_cond_init(&tiles->queued, NULL);
+   pthread_cond_init(&tiles->idle, NULL);
+   tiles->running = wtrue;
+
+   (void) hc_simd_level();             /* pick it before the threads race    */
+   for (i = 0; i < threads; ++i)
+   {
+      spec_tiles_worker_t * w = &tiles->worker[i];
+      if (pthread_create(&w->thread, NULL, tiles_worker, w) != 0)
+      {
+         errprint("spec_tiles_new: cannot start a thread");
+         exit(1);
+      }
+   }
+   return tiles;
+}
+
+/**
+ *    Sets the ".waonspec" file (see spec-cache.h) from which the power
+ *    spectra of a matching FFT length and window are read rather than
+ *    computed.  The file must stay open until the cache is freed, or
+ *    this is called again.
+ *
+ * \param tiles
+ *    Provides the cache.
+ *
+ * \param disk
+ *    Provides the open file, or a null pointer for none.
+ */
+
+void
+spec_tiles_set_disk_cache
+(
+   spec_tiles_t * tiles,
+   const waon_spec_cache_t * disk
+)
+{
+   pthread_mutex_lock(&tiles->lock);
+   tiles->planning = wtrue;
+   while (tiles->busy > 0)
+      pthread_cond_wait(&tiles->idle, &tiles->lock);
+
+   tiles->disk = disk;
+   tiles->planning = wfalse;
+   pthread_cond_broadcast(&tiles->queued);
+   pthread_mutex_unlock(&tiles->lock);
+}
+
+/**
+ *    Starts a redraw:  drops the tiles still queued, which the previous
+ *    redraw asked for, so that the workers compute only what is asked for
+ *    from now on.
+ *
+ * \param tiles
+ *    Provides the cache.
+ */
+
+void
+spec_tiles_begin (spec_tiles_t * tiles)
+{
+   int t;
+   pthread_mutex_lock(&tiles->lock);
+   ++tiles->pass;
+   for (t = 0; t < tiles->count; ++t)
+   {
+      spec_tile_t * tile = &tiles->tile[t];
+      if (tile->state == SPEC_TILE_QUEUED)
+      {
+         tiles->bytes -= tile->size * (long) sizeof(float);
+         free(tile->data);
+         tile->data = nullptr;
+         tile->state = SPEC_TILE_FREE;
+      }
+   }
+   pthread_mutex_unlock(&tiles->lock);
+}
+
+/**
+ *    Gets one column, or queues its tile.
+ *
+ * \param tiles
+ *    Provides the cache.
+ *
+ * \param key
+ *    Provides the analysis.  Its FFT length is at least 2, and its step
+ *    is at least 1.
+ *
+ * \param column
+ *    Provides the column, which starts at frame column * key->step.
+ *
+ * \param [out] amp2
+ *    Provides the destination for the power spectrum, [fft_len/2+1],
+ *    scaled by the FFT length.
+ *
+ * \param [out] dphi
+ *    Provides the destination for the phase difference, [fft_len/2+1],
+ *    if key->hop is not 0.  It is the frequency correction in cycles per
+ *    frame, as fft_two_frames() of gwaonc has it.
+ *
+ * \return
+ *    Returns wtrue if the column was ready and is copied.
+ */
+
+wbool_t
+spec_tiles_column
+(
+   spec_tiles_t * tiles,
+   const spec_tiles_key_t * key,
+   long column,
+   double * amp2,
+   double * dphi
+)
+{
+   long nbin = key->fft_len / 2 + 1;
+   long index = column / SPEC_TILES_COLUMNS;
+   wbool_t result = wfalse;
+   int t;
+   if (key->fft_len != tiles->fft_len)
+      tiles_plan(tiles, key->fft_len);
+
+   pthread_mutex_lock(&tiles->lock);
+   t = tiles_find(tiles, key, index);
+   if (t >= 0)
+   {
+      spec_tile_t * tile = &tiles->tile[t];
+      tile->used = ++tiles->clock;
+      tile->pass = tiles->pass;
+      if (tile->state == SPEC_TILE_READY)
+      {
+         long j = column - index * SPEC_TILES_COLUMNS;
+         const float * a = tile->data + j * nbin;
+         long k;
+         for (k = 0; k < nbin; ++k)
+            amp2[k] = a[k];
+
+         if (key->hop != 0)
+         {
+            const float * d = a + SPEC_TILES_COLUMNS * nbin;
+            for (k = 0; k < nbin; ++k)
+               dphi[k] = d[k];
+         }
+         result = wtrue;
+      }
+   }
+   else
+   {
+      long size = SPEC_TILES_COLUMNS * nbin * (key->hop != 0 ? 2 : 1);
+      t = tiles_alloc(tiles, size);
+      if (t >= 0)
+      {
+         spec_tile_t * tile = &tiles->tile[t];
+         tile->key = *key;
+         tile->index = index;
+         tile->state = SPEC_TILE_QUEUED;
+         tile->used = ++tiles->clock;
+         tile->pass = tiles->pass;
+         pthread_cond_signal(&tiles->queued);
+      }
+   }
+   pthread_mutex_unlock(&tiles->lock);
+   return result;
+}
+
+/**
+ *    Stops the workers and frees the cache.  The notify function is not
+ *    called after this returns.
+ *
+ * \param tiles
+ *    Provides the cache.  A null pointer is ignored.
+ */
+
+void
+spec_tiles_free (spec_tiles_t * tiles)
+{
+   int i;
+   if (is_nullptr(tiles))
+      return;
+
+   pthread_mutex_lock(&tiles->lock);
+   tiles->running = wfalse;
+   pthread_cond_broadcast(&tiles->queued);
+   pthread_mutex_unlock(&tiles->lock);
+   for (i = 0; i < tiles->threads; ++i)
+      pthread_join(tiles->worker[i].thread, NULL);
+
+   for (i = 0; i < tiles->threads; ++i)
+      tiles_worker_unplan(&tiles->worker[i]);
+
+   for (i = 0; i < tiles->count; ++i)
+      free(tiles->tile[i].data);
+
+   pthread_mutex_destroy(&tiles->lock);
+   pthread_cond_destroy(&tiles->queued);
+   pthread_cond_destroy(&tiles->idle);
+   free(tiles->worker);
+   free(tiles->tile);
+   free(tiles);
+}
+
+/*
+ * spec-tiles.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,896 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : spectrogram engine
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          spectrogram.c
+ *
+ *    This module computes and colors the spectrogram of gwaonc, so that
+ *    gwaonc and the spgc batch renderer draw the same picture.
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The spectra are scaled by the FFT length, as gwaonc always did.  The
+ *    phase difference of a bin k is
+ *
+@verbatim
+      dphi[k] = principal(ph2 - ph1 - 2 pi k hop / N) / (2 pi hop)
+@endverbatim
+ *
+ *    where principal() brings the value into [-pi, pi), so that the
+ *    frequency of the bin, corrected by the phase vocoder, is
+ *    (k / N + dphi[k]) * samplerate.
+ */
+
+#include <math.h>                      /* log(), pow(), sqrt(), M_PI          */
+#include <stdlib.h>                    /* malloc(), realloc(), free()         */
+#include <string.h>                    /* memcpy(), memset()                  */
+
+#include "hc.h"                        /* HC_to_amp2(), HC_to_polar2()        */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "midi.h"                      /* midi_to_logf(), logf_to_midi()      */
+#include "spectrogram.h"               /* spg_render_t                        */
+
+/**
+ *    Brings the phase difference of bin \a k into [-pi, pi), and divides
+ *    it by 2 pi hop.
+ */
+
+static double
+spg_dphi (double ph0, double ph1, long k, long fft_len, long hop)
+{
+   double twopi = 2.0 * M_PI;
+   double d = ph1 - ph0 - twopi * (double) k / (double) fft_len * (double) hop;
+   for ( ; d >= M_PI; d -= twopi)
+      ;
+
+   for ( ; d < -M_PI; d += twopi)
+      ;
+
+   return d / twopi / (double) hop;
+}
+
+/**
+ *    Loads the mono mix of the frames from \a start on into row \a k of
+ *    the batch.
+ */
+
+static void
+spg_columns_load
+(
+   spg_columns_t * cols,
+   snd_cache_t * snd,
+   int k,
+   long start
+)
+{
+   long i;
+   snd_cache_read_at(snd, start, cols->left, cols->right, cols->fft_len);
+   for (i = 0; i < cols->fft_len; ++i)
+      cols->left[i] = 0.5 * (cols->left[i] + cols->right[i]);
+
+   fft_batch_load(cols->batch, k, cols->left);
+}
+
+/**
+ *    Creates the batch and the buffers that compute the columns.  This
+ *    makes an FFTW plan.
+ *
+ * \param fft_len
+ *    The FFT length.
+ *
+ * \param count
+ *    The frames of the batch.  A column with a hop takes two, unless the
+ *    hop is the step.
+ */
+
+spg_columns_t *
+spg_columns_new (long fft_len, int count)
+{
+   long nbin = fft_len / 2 + 1;
+   spg_columns_t * cols = (spg_columns_t *) malloc(sizeof(spg_columns_t));
+   CHECK_MALLOC(cols, "spg_columns_new");
+   if (count < 2)
+      count = 2;
+
+   cols->fft_len = fft_len;
+   cols->batch = fft_batch_create(fft_len, count, FILTER_WINDOW_NONE, wfalse);
+   cols->left = (double *) malloc(sizeof(double) * fft_len);
+   cols->right = (double *) malloc(sizeof(double) * fft_len);
+   cols->amp2 = (double *) malloc(sizeof(double) * count * nbin);
+   cols->phs = (double *) malloc(sizeof(double) * count * nbin);
+   cols->last_amp2 = (double *) malloc(sizeof(double) * nbin);
+   cols->last_phs = (double *) malloc(sizeof(double) * nbin);
+   CHECK_MALLOC(cols->left, "spg_columns_new");
+   CHECK_MALLOC(cols->right, "spg_columns_new");
+   CHECK_MALLOC(cols->amp2, "spg_columns_new");
+   CHECK_MALLOC(cols->phs, "spg_columns_new");
+   CHECK_MALLOC(cols->last_amp2, "spg_columns_new");
+   CHECK_MALLOC(cols->last_phs, "spg_columns_new");
+   return cols;
+}
+
+/**
+ *    Computes the columns \a first to \a first + \a n - 1.
+ *
+ * \param amp2
+ *    Receives the power spectra, [n][fft_len / 2 + 1].
+ *
+ * \param dphi
+ *    Receives the phase differences, [n][fft_len / 2 + 1], if the key has
+ *    a hop.  It is not used otherwise.
+ */
+
+void
+spg_columns_compute
+(
+   spg_columns_t * cols,
+   snd_cache_t * snd,
+   const spg_key_t * key,
+   long first,
+   long n,
+   float * amp2,
+   float * dphi
+)
+{
+   long len = cols->fft_len;
+   long nbin = len / 2 + 1;
+   long j0, k;
+   int per, j, m;
+   cols->batch->flag_window = (filter_window_t) key->flag_window;
+   if (key->hop == 0)
+   {
+      per = cols->batch->count;
+      for (j0 = 0; j0 < n; j0 += per)
+      {
+         m = n - j0 < per ? (int) (n - j0) : per;
+         for (j = 0; j < m; ++j)
+            spg_columns_load(cols, snd, j, (first + j0 + j) * key->step);
+
+         fft_batch_execute(cols->batch);
+         fft_batch_amp2(cols->batch, m, (double) len, cols->amp2);
+         for (k = 0; k < m * nbin; ++k)
+            amp2[j0 * nbin + k] = (float) cols->amp2[k];
+      }
+   }
+   else if (key->hop == key->step)
+   {
+      /*
+       * The frame a hop after column c is column c + 1, so the n columns
+       * take the n + 1 frames from first on, each transformed once.  Frame
+       * f closes column f - 1; last_amp2 and last_phs carry the last frame
+       * of a batch over to the next one.
+       */
+
+      long f0;
+      per = cols->batch->count;
+      for (f0 = 0; f0 <= n; f0 += per)
+      {
+         m = n + 1 - f0 < per ? (int) (n + 1 - f0) : per;
+         for (j = 0; j < m; ++j)
+            spg_columns_load(cols, snd, j, (first + f0 + j) * key->step);
+
+         fft_batch_execute(cols->batch);
+         fft_batch_polar2(cols->batch, m, (double) len, cols->amp2, cols->phs);
+         for (j = 0; j < m; ++j)
+         {
+            const double * a = cols->last_amp2;
+            const double * ph0 = cols->last_phs;
+            const double * ph1 = cols->phs + j * nbin;
+            float * ca;
+            float * cd;
+            if (f0 + j == 0)
+               continue;
+
+            if (j > 0)
+            {
+               a = cols->amp2 + (j - 1) * nbin;
+               ph0 = ph1 - nbin;
+            }
+            ca = amp2 + (f0 + j - 1) * nbin;
+            cd = dphi + (f0 + j - 1) * nbin;
+            for (k = 0; k < nbin; ++k)
+            {
+               ca[k] = (float) a[k];
+               cd[k] = (float) spg_dphi(ph0[k], ph1[k], k, len, key->hop);
+            }
+         }
+         memcpy
+         (
+            cols->last_amp2, cols->amp2 + (m - 1) * nbin,
+            nbin * sizeof(double)
+         );
+         memcpy
+         (
+            cols->last_phs, cols->phs + (m - 1) * nbin, nbin * sizeof(double)
+         );
+      }
+   }
+   else
+   {
+      /*
+       * Rows 2j and 2j + 1 are the column and the frame a hop later.
+       */
+
+      per = cols->batch->count / 2;
+      for (j0 = 0; j0 < n; j0 += per)
+      {
+         m = n - j0 < per ? (int) (n - j0) : per;
+         for (j = 0; j < m; ++j)
+         {
+            long pos = (first + j0 + j) * key->step;
+            spg_columns_load(cols, snd, 2 * j, pos);
+            spg_columns_load(cols, snd, 2 * j + 1, pos + key->hop);
+         }
+         fft_batch_execute(cols->batch);
+         fft_batch_polar2
+         (
+            cols->batch, 2 * m, (double) len, cols->amp2, cols->phs
+         );
+         for (j = 0; j < m; ++j)
+         {
+            const double * a = cols->amp2 + 2 * j * nbin;
+            const double * ph0 = cols->phs + 2 * j * nbin;
+            const double * ph1 = ph0 + nbin;
+            float * ca = amp2 + (j0 + j) * nbin;
+            float * cd = dphi + (j0 + j) * nbin;
+            for (k = 0; k < nbin; ++k)
+            {
+               ca[k] = (float) a[k];
+               cd[k] = (float) spg_dphi(ph0[k], ph1[k], k, len, key->hop);
+            }
+         }
+      }
+   }
+}
+
+/**
+ *    Frees the batch and the buffers.
+ */
+
+void
+spg_columns_free (spg_columns_t * cols)
+{
+   if (not_nullptr(cols))
+   {
+      fft_batch_free(cols->batch);
+      free(cols->left);
+      free(cols->right);
+      free(cols->amp2);
+      free(cols->phs);
+      free(cols->last_amp2);
+      free(cols->last_phs);
+      free(cols);
+   }
+}
+
+/**
+ *    Creates the plans and the buffers that compute the spectra of one
+ *    frame.  The window is none until flag_window is set.
+ */
+
+spg_frame_t *
+spg_frame_new (long fft_len)
+{
+   long nbin = fft_len / 2 + 1;
+   spg_frame_t * frame = (spg_frame_t *) malloc(sizeof(spg_frame_t));
+   CHECK_MALLOC(frame, "spg_frame_new");
+   frame->fft_len = fft_len;
+   frame->flag_window = FILTER_WINDOW_NONE;
+   frame->mono = fft_batch_create(fft_len, 1, FILTER_WINDOW_NONE, wfalse);
+   frame->st_in = (double *) fftw_malloc(sizeof(double) * 2 * fft_len);
+   frame->st_out = (double *) fftw_malloc(sizeof(double) * 2 * fft_len);
+   CHECK_MALLOC(frame->st_in, "spg_frame_new");
+   CHECK_MALLOC(frame->st_out, "spg_frame_new");
+   frame->plan_stereo = plan_FFT_stereo
+   (
+      (int) fft_len, frame->st_in, frame->st_out
+   );
+   frame->left = (double *) malloc(sizeof(double) * fft_len);
+   frame->right = (double *) malloc(sizeof(double) * fft_len);
+   frame->l_ph1 = (double *) malloc(sizeof(double) * nbin);
+   frame->r_ph1 = (double *) malloc(sizeof(double) * nbin);
+   CHECK_MALLOC(frame->left, "spg_frame_new");
+   CHECK_MALLOC(frame->right, "spg_frame_new");
+   CHECK_MALLOC(frame->l_ph1, "spg_frame_new");
+   CHECK_MALLOC(frame->r_ph1, "spg_frame_new");
+   return frame;
+}
+
+/**
+ *    Computes the spectra of the frame starting at \a i.
+ *
+ * \param r_amp2
+ *    If null, the mono mix is analysed, into l_amp2 and l_ph.
+ *
+ * \param l_ph
+ *    If null, only the powers are computed.
+ */
+
+void
+spg_frame_one
+(
+   spg_frame_t * frame,
+   snd_cache_t * snd,
+   long i,
+   double * l_amp2,
+   double * r_amp2,
+   double * l_ph,
+   double * r_ph
+)
+{
+   long len = frame->fft_len;
+   long k;
+   snd_cache_read_at(snd, i, frame->left, frame->right, len);
+   if (is_nullptr(r_amp2))
+   {
+      for (k = 0; k < len; ++k)
+         frame->left[k] = 0.5 * (frame->left[k] + frame->right[k]);
+
+      frame->mono->flag_window = (filter_window_t) frame->flag_window;
+      fft_batch_load(frame->mono, 0, frame->left);
+      fft_batch_execute(frame->mono);
+      if (is_nullptr(l_ph))
+         fft_batch_amp2(frame->mono, 1, (double) len, l_amp2);
+      else
+         fft_batch_polar2(frame->mono, 1, (double) len, l_amp2, l_ph);
+   }
+   else
+   {
+      /*
+       * Both channels in one FFT; the HC spectra replace the samples.
+       */
+
+      windowed_FFT_stereo
+      (
+         (int) len, frame->left, frame->right,
+         (filter_window_t) frame->flag_window, frame->plan_stereo,
+         frame->st_in, frame->st_out, wfalse, frame->left, frame->right
+      );
+      if (is_nullptr(l_ph))
+      {
+         HC_to_amp2(len, frame->left, (double) len, l_amp2);
+         HC_to_amp2(len, frame->right, (double) len, r_amp2);
+      }
+      else
+      {
+         HC_to_polar2(len, frame->left, 0, (double) len, l_amp2, l_ph);
+         HC_to_polar2(len, frame->right, 0, (double) len, r_amp2, r_ph);
+      }
+   }
+}
+
+/**
+ *    Computes the spectra of the frame starting at \a i, with the phase
+ *    differences to the frame \a hop later.
+ *
+ * \param r_amp2
+ *    If null, the mono mix is analysed, and r_ph and r_dphi are not used.
+ */
+
+void
+spg_frame_two
+(
+   spg_frame_t * frame,
+   snd_cache_t * snd,
+   long i,
+   long hop,
+   double * l_amp2,
+   double * r_amp2,
+   double * l_ph,
+   double * r_ph,
+   double * l_dphi,
+   double * r_dphi
+)
+{
+   long nbin = frame->fft_len / 2 + 1;
+   long k;
+
+   /*
+    * The frame i goes last, as the powers are those of the frame i.
+    */
+
+   spg_frame_one(frame, snd, i + hop, l_amp2, r_amp2, frame->l_ph1,
+      frame->r_ph1);
+
+   spg_frame_one(frame, snd, i, l_amp2, r_amp2, l_ph, r_ph);
+   for (k = 0; k < nbin; ++k)
+   {
+      l_dphi[k] = spg_dphi(l_ph[k], frame->l_ph1[k], k, frame->fft_len, hop);
+      if (not_nullptr(r_amp2))
+      {
+         r_dphi[k] = spg_dphi
+         (
+            r_ph[k], frame->r_ph1[k], k, frame->fft_len, hop
+         );
+      }
+   }
+}
+
+/**
+ *    Frees the plans and the buffers.
+ */
+
+void
+spg_frame_free (spg_frame_t * frame)
+{
+   if (not_nullptr(frame))
+   {
+      fft_batch_free(frame->mono);
+      fftw_destroy_plan(frame->plan_stereo);
+      fftw_free(frame->st_in);
+      fftw_free(frame->st_out);
+      free(frame->left);
+      free(frame->right);
+      free(frame->l_ph1);
+      free(frame->r_ph1);
+      free(frame);
+   }
+}
+
+/**
+ *    Fills the colormap of gwaonc: from black through blue, cyan, green,
+ *    and yellow to red, in five steps.
+ */
+
+void
+spg_colormap (unsigned char palette[SPG_COLORS][3])
+{
+   int seg = SPG_COLORS / 5;
+   int i;
+   memset(palette, 0, SPG_COLORS * 3);
+   for (i = 0; i < seg; ++i)
+   {
+      unsigned char up = (unsigned char) (i * 5);
+      unsigned char down = (unsigned char) (255 - i * 5);
+      int i0 = SPG_COLORS / 5;
+      palette[i][2] = up;
+
+      palette[i0 + i][1] = up;
+      palette[i0 + i][2] = 255;
+
+      i0 = SPG_COLORS * 2 / 5;
+      palette[i0 + i][1] = 255;
+      palette[i0 + i][2] = down;
+
+      i0 = SPG_COLORS * 3 / 5;
+      palette[i0 + i][0] = up;
+      palette[i0 + i][1] = 255;
+
+      i0 = SPG_COLORS * 4 / 5;
+      palette[i0 + i][0] = 255;
+      palette[i0 + i][1] = down;
+   }
+   palette[SPG_COLORS - 1][0] = 255;
+   palette[SPG_COLORS - 1][1] = 0;
+   palette[SPG_COLORS - 1][2] = 0;
+}
+
+/**
+ *    Returns the row of a frequency, from 0 at logf_min to \a resolution
+ *    at logf_max.
+ */
+
+static int
+spg_logf_to_row (const spg_view_t * view, double logf, int resolution)
+{
+   return (int)
+   (
+      (double) resolution * (logf - view->logf_min) /
+         (view->logf_max - view->logf_min)
+   );
+}
+
+/**
+ *    Returns the frequency of the middle of a row.
+ */
+
+static double
+spg_row_to_logf (const spg_view_t * view, int row, int resolution)
+{
+   return view->logf_min +
+      ((double) row + 0.5) * (view->logf_max - view->logf_min) /
+         (double) resolution;
+}
+
+/**
+ *    Returns the row of the bottom of a MIDI note, halfway to the note
+ *    below.
+ */
+
+static int
+spg_note_bottom (const spg_view_t * view, int midi, int resolution)
+{
+   int r0 = spg_logf_to_row(view, midi_to_logf(midi - 1), resolution);
+   int r1 = spg_logf_to_row(view, midi_to_logf(midi), resolution);
+   return (r1 + r0) / 2;
+}
+
+/**
+ *    Compares two views.  The fields are compared one by one, as the
+ *    padding of the structures may differ.
+ */
+
+static wbool_t
+spg_view_equal (const spg_view_t * a, const spg_view_t * b)
+{
+   return a->mode == b->mode && a->fft_len == b->fft_len &&
+      a->samplerate == b->samplerate &&
+      a->logf_min == b->logf_min && a->logf_max == b->logf_max &&
+      a->amp2_min == b->amp2_min && a->amp2_max == b->amp2_max &&
+      a->octave_removal_factor == b->octave_removal_factor;
+}
+
+/**
+ *    Adds up the amplitudes of the bins at the rows of their frequencies
+ *    corrected by the phase vocoder.
+ *
+ * \param resolution
+ *    The rows, from logf_min to logf_max.
+ *
+ * \param amp
+ *    Receives the sums of the amplitudes (not squared), [resolution].
+ */
+
+void
+spg_average_pv
+(
+   const spg_view_t * view,
+   int resolution,
+   const double * amp2,
+   const double * dphi,
+   double * amp
+)
+{
+   int i, k;
+   for (i = 0; i < resolution; ++i)
+      amp[i] = 0.0;
+
+   for (k = 1; k < (view->fft_len + 1) / 2; ++k)
+   {
+      double x = log
+      (
+         ((double) k / (double) view->fft_len + dphi[k]) * view->samplerate
+      );
+      int ix = spg_logf_to_row(view, x, resolution);
+      if (ix < 0 || ix >= resolution)
+         continue;
+
+      amp[ix] += sqrt(amp2[k]);
+   }
+   if (view->octave_removal_factor > 0.0)             /* experimental     */
+   {
+      /*
+       * From the top down, so that amp[i] is still the sum when it is
+       * taken off the row an octave up.
+       */
+
+      for (i = resolution - 13; i >= 0; --i)
+      {
+         amp[i + 12] -= view->octave_removal_factor * amp[i];
+         if (amp[i + 12] < 0.0)
+            amp[i + 12] = 0.0;
+      }
+   }
+}
+
+/**
+ *    Empties a render, before the first spg_render_set().
+ */
+
+void
+spg_render_init (spg_render_t * render)
+{
+   memset(render, 0, sizeof(spg_render_t));
+}
+
+/**
+ *    Adds the band of the bins from \a k0 to \a k - 1, at the row \a r0,
+ *    whose next band is at the row \a r.
+ */
+
+static void
+spg_render_add (spg_render_t * render, int k0, int k, int r0, int r)
+{
+   const spg_view_t * view = &render->view;
+   int b = render->bands++;
+   render->k0[b] = k0;
+   render->k1[b] = k;
+   if (r - r0 > 1)
+   {
+      /*
+       * A gap: the cell goes halfway to the rows of the bands below and
+       * above, where r1 is the row of the bin k - 2.  Bin 0 is below any
+       * row.
+       */
+
+      int r1 = -r0;
+      if (k > 2)
+      {
+         double x = log
+         (
+            (double) (k - 2) / (double) view->fft_len * view->samplerate
+         );
+         r1 = spg_logf_to_row(view, x, render->height);
+      }
+      int bottom = (r0 + r1) / 2;
+      int top = (r + r0) / 2;
+      int rows = (r - r1) / 2 + 1;
+      if (bottom < 0)
+         bottom = 0;
+
+      if (rows < 1)
+         rows = 1;
+
+      if (top > render->height)
+         top = render->height;
+
+      render->top[b] = top;
+      render->len_line[b] = top - bottom + 1;
+      render->len_rect[b] = rows;
+   }
+   else
+   {
+      render->top[b] = r0;
+      render->len_line[b] = 1;
+      render->len_rect[b] = 1;
+   }
+}
+
+/**
+ *    Sets up a render for a view and a height.  The bands and thresholds
+ *    are kept if they did not change.
+ *
+ * \param thin
+ *    The columns are one pixel wide, so that a cell of a band fills its
+ *    rows rather than a square.
+ */
+
+void
+spg_render_set
+(
+   spg_render_t * render,
+   const spg_view_t * view,
+   int height,
+   wbool_t thin
+)
+{
+   long nbin = view->fft_len / 2 + 1;
+   int k, k0, r, r0, ic;
+   render->thin = thin;
+   if (not_nullptr(render->k0) && render->height == height &&
+         spg_view_equal(&render->view, view))
+   {
+      return;
+   }
+   render->view = *view;
+   render->height = height;
+   render->k0 = (int *) realloc(render->k0, sizeof(int) * nbin);
+   render->k1 = (int *) realloc(render->k1, sizeof(int) * nbin);
+   render->top = (int *) realloc(render->top, sizeof(int) * nbin);
+   render->len_line = (int *) realloc(render->len_line, sizeof(int) * nbin);
+   render->len_rect = (int *) realloc(render->len_rect, sizeof(int) * nbin);
+   render->ave = (double *) realloc(render->ave, sizeof(double) * height);
+   CHECK_MALLOC(render->k0, "spg_render_set");
+   CHECK_MALLOC(render->k1, "spg_render_set");
+   CHECK_MALLOC(render->top, "spg_render_set");
+   CHECK_MALLOC(render->len_line, "spg_render_set");
+   CHECK_MALLOC(render->len_rect, "spg_render_set");
+   CHECK_MALLOC(render->ave, "spg_render_set");
+
+   /*
+    * A band is added when the next one starts, so the top one is not.
+    */
+
+   render->bands = 0;
+   r0 = -1;
+   k0 = -1;
+   for (k = 0; k < nbin; ++k)
+   {
+      double x = log((double) k / (double) view->fft_len * view->samplerate);
+      if (x < view->logf_min || x > view->logf_max)
+         continue;
+
+      r = spg_logf_to_row(view, x, height);
+      if (r != r0)
+      {
+         if (k0 >= 0)
+            spg_render_add(render, k0, k, r0, r);
+
+         k0 = k;
+         r0 = r;
+      }
+   }
+
+   /*
+    * The color index, (int) (256 (log10(amp2) - amp2_min) / (amp2_max -
+    * amp2_min)), is the number of thresholds that amp2 reaches, so that
+    * it is found with no log10().
+    */
+
+   render->threshold[0] = 0.0;
+   for (ic = 1; ic < SPG_COLORS; ++ic)
+   {
+      render->threshold[ic] = pow
+      (
+         10.0, view->amp2_min +
+            (double) ic / (double) SPG_COLORS *
+               (view->amp2_max - view->amp2_min)
+      );
+   }
+}
+
+/**
+ *    Fills the rows \a top down to \a top - \a len + 1 of a column.
+ */
+
+static void
+spg_render_fill
+(
+   const spg_render_t * render,
+   double * value,
+   int top,
+   int len,
+   double v
+)
+{
+   int row;
+   for (row = top; row > top - len && row >= 0; --row)
+   {
+      if (row <= render->height)
+         value[row] = v;
+   }
+}
+
+/**
+ *    Turns a column into the powers of the rows of the display.
+ *
+ * \param dphi
+ *    The phase differences of the column, for the phase-vocoder modes.
+ *
+ * \param value
+ *    Receives the powers of the rows 0 to height, or -1 for a row that
+ *    is left blank.  The cells overlap as they do in gwaonc, where row
+ *    0 is under the panel and is not drawn.
+ */
+
+void
+spg_render_column
+(
+   spg_render_t * render,
+   const double * amp2,
+   const double * dphi,
+   double * value
+)
+{
+   const spg_view_t * view = &render->view;
+   int height = render->height;
+   int notes = (int)
+   (
+      (view->logf_max - view->logf_min) * 12.0 / log(2.0) + 0.5
+   );
+   int b, k, row;
+   for (row = 0; row <= height; ++row)
+      value[row] = -1.0;
+
+   if (view->mode == SPG_MODE_POWER)
+   {
+      for (b = 0; b < render->bands; ++b)           /* mean of the band */
+      {
+         double y = 0.0;
+         for (k = render->k0[b]; k < render->k1[b]; ++k)
+            y += amp2[k];
+
+         y /= (double) (render->k1[b] - render->k0[b]);
+         spg_render_fill
+         (
+            render, value, render->top[b],
+            render->thin ? render->len_line[b] : render->len_rect[b], y
+         );
+      }
+      return;
+   }
+   spg_average_pv(view, height, amp2, dphi, render->ave);
+   if (view->mode == SPG_MODE_PV || height < notes)
+   {
+      for (row = 0; row < height; ++row)
+         value[row] = render->ave[row] * render->ave[row];
+   }
+   else                                            /* mean of the note */
+   {
+      int midi0 = -1;
+      double y = 0.0;
+      int ny = 0;
+      for (row = 0; row < height; ++row)
+      {
+         int midi = logf_to_midi(spg_row_to_logf(view, row, height));
+         if (midi != midi0)
+         {
+            if (ny > 0)
+            {
+               int bottom = spg_note_bottom(view, midi - 1, height);
+               int top = spg_note_bottom(view, midi, height);
+               int len = top - bottom + 1;
+               if (bottom < 0)
+                  bottom = 0;
+
+               if (len < 1)
+                  len = 1;
+
+               if (top > height)
+                  top = height;
+
+               y /= (double) ny;
+               spg_render_fill
+               (
+                  render, value, top,
+                  render->thin ? top - bottom + 1 : len, y * y
+               );
+            }
+            y = 0.0;
+            ny = 0;
+            midi0 = midi;
+         }
+         y += render->ave[row];
+         ++ny;
+      }
+   }
+}
+
+/**
+ *    Returns the color index of a power, from 0 to SPG_COLORS - 1.
+ */
+
+int
+spg_color_index (const spg_render_t * render, double amp2)
+{
+   int ic = 0;
+   int step;
+   for (step = SPG_COLORS / 2; step > 0; step /= 2)
+   {
+      if (amp2 >= render->threshold[ic + step])
+         ic += step;
+   }
+   return ic;
+}
+
+/**
+ *    Frees the buffers of a render, which can be set up again.
+ */
+
+void
+spg_render_free (spg_render_t * render)
+{
+   free(render->k0);
+   free(render->k1);
+   free(render->top);
+   free(render->len_line);
+   free(render->len_rect);
+   free(render->ave);
+   spg_render_init(render);
+}
+
+/*
+ * spectrogram.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
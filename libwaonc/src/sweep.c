@@ -0,0 +1,552 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : parameter sweep over one analysis
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          sweep.c
+ *
+ *    This module provides the note-picking stages (2 and 3) for several
+ *    parameter sets that share one spectral analysis (stage 1).
+ *
+ * \library       libwaonc
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The power spectrum of a frame is computed once.  Each set then gets
+ *    its own copy of it, since the drum and octave removals and
+ *    note_intensity() all modify the spectrum in place.  The copy costs
+ *    fft_len/2+1 doubles per set and frame, much less than the FFT.  A
+ *    single set works on the spectrum directly.
+ */
+
+#include <math.h>                      /* pow()                               */
+#include <stdlib.h>                    /* malloc(), realloc(), free()         */
+#include <string.h>                    /* memcpy(), strcpy(), strtok()        */
+
+#include "fft.h"                       /* power_subtract_ave(), ...           */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "sweep.h"                     /* waon_sweep_t                        */
+
+/**
+ *    Copies a string into new memory.
+ */
+
+static char *
+sweep_strdup (const char * s)
+{
+   char * result = (char *) malloc(strlen(s) + 1);
+   CHECK_MALLOC(result, "sweep_strdup");
+   strcpy(result, s);
+   return result;
+}
+
+/**
+ *    Makes the MIDI file name of a set that has no -o option, by inserting
+ *    "-NN" before the extension of the base name.
+ *
+ * \param base
+ *    Provides the --output file name, e.g. "output.mid".
+ *
+ * \param number
+ *    Provides the number of the set, starting at 1.
+ *
+ * \return
+ *    Returns the new name, e.g. "output-01.mid".  The caller frees it.
+ */
+
+static char *
+sweep_file_name (const char * base, int number)
+{
+   const char * dot = strrchr(base, '.');
+   size_t stem = is_nullptr(dot) ? strlen(base) : (size_t) (dot - base);
+   char * result = (char *) malloc(strlen(base) + 16);
+   CHECK_MALLOC(result, "sweep_file_name");
+   memcpy(result, base, stem);
+   sprintf(result + stem, "-%02d%s", number, is_nullptr(dot) ? "" : dot);
+   return result;
+}
+
+/**
+ *    Initializes the note-tracking state of a set, and frees the file
+ *    names it does not own.
+ */
+
+static void
+sweep_set_init
+(
+   waon_sweep_set_t * set,
+   const analysis_scratchpad_t * scratchpad
+)
+{
+   int i;
+   set->scratchpad = *scratchpad;
+   set->scratchpad.absolute_cutoff = set->parameters.abs_flg;
+   set->scratchpad.adj_pitch = set->parameters.adj_pitch;
+   set->notes = WAON_notes_init();
+   CHECK_MALLOC(set->notes, "sweep_set_init");
+   for (i = 0; i < MIDI_NOTE_COUNT; ++i)
+   {
+      set->vel[i] = 0;
+      set->on_event[i] = -1;
+   }
+}
+
+/**
+ *    Checks that a set differs from the base only in the options that act
+ *    after the power spectrum is made.
+ *
+ * \return
+ *    Returns wtrue if the set is usable.
+ */
+
+static wbool_t
+sweep_set_check
+(
+   const waon_parameters_t * set,
+   const waon_parameters_t * base
+)
+{
+   return
+      is_nullptr(set->file_wav) && is_nullptr(set->file_patch) &&
+      set->fft_len == base->fft_len &&
+      set->fft_r2c == base->fft_r2c &&
+      set->flag_window == base->flag_window &&
+      set->notelow == base->notelow &&
+      set->notetop == base->notetop &&
+      set->shift_hop == base->shift_hop &&
+      set->flag_phase == base->flag_phase &&
+      set->adj_pitch == base->adj_pitch &&
+      set->note_bank == base->note_bank &&
+      set->bank_harmonics == base->bank_harmonics;
+}
+
+/**
+ *    Reads the parameter sets of the base->file_sweep file.
+ *
+ * \return
+ *    Returns wtrue if the file was read and every line was good.
+ */
+
+static wbool_t
+sweep_read
+(
+   waon_sweep_t * sweep,
+   const waon_parameters_t * base,
+   const analysis_scratchpad_t * scratchpad
+)
+{
+   char line[512];
+   int lineno = 0;
+   wbool_t result = wtrue;
+   FILE * f = fopen(base->file_sweep, "r");
+   if (is_nullptr(f))
+   {
+      errprintf("? cannot open sweep file %s\n", base->file_sweep);
+      return wfalse;
+   }
+   while (result && not_nullptr(fgets(line, sizeof line, f)))
+   {
+      char * argv[SWEEP_TOKENS_MAX + 1];
+      int argc = 1;
+      char * token = strtok(line, " \t\r\n");
+      waon_sweep_set_t * set;
+      ++lineno;
+      if (is_nullptr(token) || token[0] == '#')
+         continue;
+
+      argv[0] = "sweep";
+      while (not_nullptr(token) && argc <= SWEEP_TOKENS_MAX)
+      {
+         argv[argc++] = token;
+         token = strtok(nullptr, " \t\r\n");
+      }
+      sweep->sets = (waon_sweep_set_t *) realloc
+      (
+         sweep->sets, sizeof(waon_sweep_set_t) * (sweep->count + 1)
+      );
+      CHECK_MALLOC(sweep->sets, "sweep_read");
+      set = &sweep->sets[sweep->count];
+      set->parameters = *base;
+      set->parameters.file_wav = nullptr;
+      set->parameters.file_midi = nullptr;
+      set->parameters.file_patch = nullptr;
+      set->parameters.file_sweep = nullptr;
+      set->parameters.file_spec_cache = nullptr;
+      result = parameters_parse(&set->parameters, argc, argv);
+      if (result)
+         result = sweep_set_check(&set->parameters, base);
+
+      if (result)
+      {
+         if (is_nullptr(set->parameters.file_midi))
+         {
+            set->parameters.file_midi =
+               sweep_file_name(base->file_midi, sweep->count + 1);
+         }
+         sweep_set_init(set, scratchpad);
+         ++sweep->count;
+      }
+      else
+      {
+         errprintf("? bad parameter set in line %d of the sweep file\n", lineno);
+         parameters_free(&set->parameters);
+      }
+   }
+   fclose(f);
+   if (result && sweep->count == 0)
+   {
+      errprint("the sweep file holds no parameter sets");
+      result = wfalse;
+   }
+   return result;
+}
+
+/**
+ *    Creates the parameter sets for a run.
+ *
+ * \param base
+ *    Provides the parameters from the command line.  If its file_sweep
+ *    member is set, the sets are read from that file, otherwise the base
+ *    is the only set.  The file_midi member must be set.
+ *
+ * \param scratchpad
+ *    Provides the analysis scratchpad, which is copied into each set.
+ *
+ * \return
+ *    Returns the new sweep, or a null pointer if the sweep file could not
+ *    be read or has a bad line (the error is reported).  Free it with
+ *    sweep_free().
+ */
+
+waon_sweep_t *
+sweep_create
+(
+   const waon_parameters_t * base,
+   const analysis_scratchpad_t * scratchpad
+)
+{
+   waon_sweep_t * sweep = (waon_sweep_t *) malloc(sizeof(waon_sweep_t));
+   CHECK_MALLOC(sweep, "sweep_create");
+   sweep->count = 0;
+   sweep->sets = nullptr;
+   sweep->fft_len = base->fft_len;
+   sweep->scratch = (double *) malloc(sizeof(double) * (base->fft_len/2 + 1));
+   CHECK_MALLOC(sweep->scratch, "sweep_create");
+   sweep->work = (double *) malloc(sizeof(double) * (base->fft_len/2 + 1));
+   CHECK_MALLOC(sweep->work, "sweep_create");
+   if (not_nullptr(base->file_sweep))
+   {
+      if (! sweep_read(sweep, base, scratchpad))
+      {
+         sweep_free(sweep);
+         sweep = nullptr;
+      }
+   }
+   else
+   {
+      waon_sweep_set_t * set = (waon_sweep_set_t *)
+         malloc(sizeof(waon_sweep_set_t));
+
+      CHECK_MALLOC(set, "sweep_create");
+      set->parameters = *base;
+      set->parameters.file_wav = nullptr;
+      set->parameters.file_patch = nullptr;
+      set->parameters.file_sweep = nullptr;
+      set->parameters.file_spec_cache = nullptr;
+      set->parameters.file_midi = sweep_strdup(base->file_midi);
+      sweep_set_init(set, scratchpad);
+      sweep->sets = set;
+      sweep->count = 1;
+   }
+   return sweep;
+}
+
+/**
+ *    Frees a sweep created by sweep_create().
+ *
+ * \param sweep
+ *    Provides the sweep to free.  A null pointer is ignored.
+ */
+
+void
+sweep_free (waon_sweep_t * sweep)
+{
+   if (not_nullptr(sweep))
+   {
+      int s;
+      for (s = 0; s < sweep->count; ++s)
+      {
+         WAON_notes_free(sweep->sets[s].notes);
+         parameters_free(&sweep->sets[s].parameters);
+      }
+      if (not_nullptr(sweep->sets))
+         free(sweep->sets);
+
+      free(sweep->scratch);
+      free(sweep->work);
+      free(sweep);
+   }
+}
+
+/**
+ *    Gets the energy-gate threshold that is safe for every set, that is,
+ *    the one of the lowest cutoff.  See frame_mean_square().
+ *
+ * \param sweep
+ *    Provides the sweep.
+ *
+ * \param gain
+ *    Provides the bound of the power of a bin relative to the
+ *    mean-square of the frame (1 for the FFT).
+ *
+ * \return
+ *    Returns the mean-square at or below which a frame yields no notes in
+ *    any set, or 0 if the gate cannot be used.
+ */
+
+double
+sweep_gate (const waon_sweep_t * sweep, double gain)
+{
+   double cut = 0.0;
+   int s;
+   for (s = 0; s < sweep->count; ++s)
+   {
+      const waon_parameters_t * parms = &sweep->sets[s].parameters;
+      if (! parms->energy_gate || parms->psub_f < 0.0 || parms->oct_f < 0.0)
+         return 0.0;
+
+      if (s == 0 || parms->cut_ratio < cut)
+         cut = parms->cut_ratio;
+   }
+   return pow(10.0, cut) / gain;
+}
+
+/**
+ *    Runs stages 1b to 3 (drum and octave removal, note picking, and the
+ *    note-on/off check) of every set for one frame.
+ *
+ * \param sweep
+ *    Provides the sweep.
+ *
+ * \param step
+ *    Provides the frame number.
+ *
+ * \param p[fft_len/2+1]
+ *    Provides the power spectrum of the frame.  It is destroyed if there
+ *    is only one set.
+ *
+ * \param fp[fft_len/2+1]
+ *    Provides the corrected frequency of each bin, or null to use the bin
+ *    center frequencies.
+ *
+ * \param i0
+ *    The beginning of the frequency range.
+ *
+ * \param i1
+ *    The end of the frequency range.
+ *
+ * \param t0
+ *    The duration of the FFT frame (inverse of the bin spacing).
+ */
+
+void
+sweep_spectrum
+(
+   waon_sweep_t * sweep,
+   int step,
+   double * p,
+   const double * fp,
+   int i0,
+   int i1,
+   double t0
+)
+{
+   long nbin = sweep->fft_len/2 + 1;
+   int s;
+   for (s = 0; s < sweep->count; ++s)
+   {
+      waon_sweep_set_t * set = &sweep->sets[s];
+      const waon_parameters_t * parms = &set->parameters;
+      double * q = p;
+      if (sweep->count > 1)
+      {
+         q = sweep->scratch;
+         memcpy(q, p, sizeof(double) * nbin);
+      }
+      if (parms->psub_n != 0)          /* drum-removal process                */
+      {
+         power_subtract_ave
+         (
+            sweep->fft_len, q, parms->psub_n, parms->psub_f, sweep->work
+         );
+      }
+
+      if (parms->oct_f != 0.0)         /* octave-removal process              */
+         power_subtract_octave(sweep->fft_len, q, parms->oct_f, sweep->work);
+
+      note_intensity
+      (
+         q, (double *) fp, parms->cut_ratio, parms->rel_cut_ratio,
+         i0, i1, t0, set->vel, &set->scratchpad
+      );
+      WAON_notes_check
+      (
+         set->notes, step, set->vel, set->on_event, 8, 0,
+         parms->peak_threshold
+      );
+   }
+}
+
+/**
+ *    Runs the note picking and the note-on/off check of every set for one
+ *    frame analysed by the note bank.
+ *
+ * \param sweep
+ *    Provides the sweep.
+ *
+ * \param step
+ *    Provides the frame number.
+ *
+ * \param bank
+ *    Provides the bank, after note_bank_power() was called for the frame.
+ */
+
+void
+sweep_bank
+(
+   waon_sweep_t * sweep,
+   int step,
+   const waon_note_bank_t * bank
+)
+{
+   int s;
+   for (s = 0; s < sweep->count; ++s)
+   {
+      waon_sweep_set_t * set = &sweep->sets[s];
+      const waon_parameters_t * parms = &set->parameters;
+      note_bank_pick
+      (
+         bank, parms->cut_ratio, parms->rel_cut_ratio,
+         set->scratchpad.absolute_cutoff, set->vel
+      );
+      WAON_notes_check
+      (
+         set->notes, step, set->vel, set->on_event, 8, 0,
+         parms->peak_threshold
+      );
+   }
+}
+
+/**
+ *    Runs the note-on/off check of every set for a frame without notes
+ *    (see sweep_gate()).
+ *
+ * \param sweep
+ *    Provides the sweep.
+ *
+ * \param step
+ *    Provides the frame number.
+ */
+
+void
+sweep_silence (waon_sweep_t * sweep, int step)
+{
+   int s;
+   for (s = 0; s < sweep->count; ++s)
+   {
+      waon_sweep_set_t * set = &sweep->sets[s];
+      memset(set->vel, 0, sizeof set->vel);
+      WAON_notes_check
+      (
+         set->notes, step, set->vel, set->on_event, 8, 0,
+         set->parameters.peak_threshold
+      );
+   }
+}
+
+/**
+ *    Cleans up the generated notes of every set.
+ *
+ * \param sweep
+ *    Provides the sweep.
+ */
+
+void
+sweep_finish (waon_sweep_t * sweep)
+{
+   int s;
+   for (s = 0; s < sweep->count; ++s)
+   {
+      waon_notes_t * notes = sweep->sets[s].notes;
+      WAON_notes_regulate(notes);
+      WAON_notes_remove_shortnotes(notes, 1, 64);
+      WAON_notes_remove_shortnotes(notes, 2, 28);
+      WAON_notes_remove_octaves(notes);
+   }
+}
+
+/**
+ *    Writes a table of the parameter sets and their results.
+ *
+ * \param sweep
+ *    Provides the sweep, after sweep_finish().
+ *
+ * \param out
+ *    Provides the destination, normally stderr.
+ */
+
+void
+sweep_summary (const waon_sweep_t * sweep, FILE * out)
+{
+   int s;
+   fprintf
+   (
+      out,
+      "   Sweep:              %d parameter sets\n"
+      "   set  cutoff  relative  peak  psub-n  psub-f    oct  events"
+      "  min  max  MIDI file\n",
+      sweep->count
+   );
+   for (s = 0; s < sweep->count; ++s)
+   {
+      const waon_sweep_set_t * set = &sweep->sets[s];
+      const waon_parameters_t * parms = &set->parameters;
+      char relative[16];
+      if (parms->abs_flg)
+         strcpy(relative, "-");
+      else
+         sprintf(relative, "%.2f", parms->rel_cut_ratio);
+
+      fprintf
+      (
+         out,
+         "   %3d  %6.2f  %8s  %4d  %6d  %6.2f  %5.2f  %6d  %3d  %3d  %s\n",
+         s + 1, parms->cut_ratio, relative, parms->peak_threshold,
+         parms->psub_n, parms->psub_f, parms->oct_f, set->notes->n,
+         set->notes->minimum, set->notes->maximum, parms->file_midi
+      );
+   }
+}
+
+/*
+ * sweep.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
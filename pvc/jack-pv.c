@@ -18,21 +18,23 @@
  */
 
 #include <stdio.h>
-#include <unistd.h> /* sleep() */
+#include <unistd.h> /* sleep(), usleep() */
 #include <stdlib.h>
 #include <string.h>
 #include <math.h> /* pow() */
+#include <pthread.h> /* pthread_create(), pthread_join() */
 
 #include <curses.h>
 #include <ao/ao.h>
 #include <jack/jack.h>
 #include <jack/transport.h>
+#include <jack/ringbuffer.h> /* lock-free ring for the worker thread */
 #include <sndfile.h>
 
 #include "ao-wrapper.h"
+#include "jack-client.h" /* waon_jack_open() */
 #include "pv-conventional.h" /* get_scale_factor_for_window () */
 #include "pv-complex.h" /* struct pv_complex */
-#include "hc.h" /* HC_complex_phase_vocoder() */
 #include "memory-check.h" /* CHECK_MALLOC */
 #include "jack-pv.h"
 
@@ -91,18 +93,18 @@ jack_pv_complex_play_step (struct pv_complex * pv,
 
    if (l_fs == NULL)
    {
-      l_fs = (double *)malloc (pv->len * sizeof (double));
-      r_fs = (double *)malloc (pv->len * sizeof (double));
+      l_fs = (double *)malloc (pv->spec_len * sizeof (double));
+      r_fs = (double *)malloc (pv->spec_len * sizeof (double));
       CHECK_MALLOC (l_fs, "pv_complex_play_step");
       CHECK_MALLOC (r_fs, "pv_complex_play_step");
 
-      l_ft = (double *)malloc (pv->len * sizeof (double));
-      r_ft = (double *)malloc (pv->len * sizeof (double));
+      l_ft = (double *)malloc (pv->spec_len * sizeof (double));
+      r_ft = (double *)malloc (pv->spec_len * sizeof (double));
       CHECK_MALLOC (l_ft, "pv_complex_play_step");
       CHECK_MALLOC (r_ft, "pv_complex_play_step");
 
-      l_tmp = (double *)malloc (pv->len * sizeof (double));
-      r_tmp = (double *)malloc (pv->len * sizeof (double));
+      l_tmp = (double *)malloc (pv->spec_len * sizeof (double));
+      r_tmp = (double *)malloc (pv->spec_len * sizeof (double));
       CHECK_MALLOC (l_tmp, "pv_complex_play_step");
       CHECK_MALLOC (r_tmp, "pv_complex_play_step");
    }
@@ -122,8 +124,8 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       return 0; /* no output */
    }
 
-   if (check_zero (pv->len, l_fs) == 0 ||
-         check_zero (pv->len, l_ft) == 0)
+   if (check_zero (pv->spec_len, l_fs) == 0 ||
+         check_zero (pv->spec_len, l_ft) == 0)
    {
       flag_left_cur = 0; /* inactive */
    }
@@ -132,8 +134,8 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       flag_left_cur = 1; /* active */
    }
 
-   if (check_zero (pv->len, r_fs) == 0 ||
-         check_zero (pv->len, r_ft) == 0)
+   if (check_zero (pv->spec_len, r_fs) == 0 ||
+         check_zero (pv->spec_len, r_ft) == 0)
    {
       flag_right_cur = 0; /* inactive */
    }
@@ -151,7 +153,7 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       {
          if (pv->flag_lock == 0) /* no phase lock */
          {
-            for (i = 0; i < pv->len; i ++)
+            for (i = 0; i < pv->spec_len; i ++)
             {
                pv->l_f_old [i] = l_fs [i];
             }
@@ -159,7 +161,7 @@ jack_pv_complex_play_step (struct pv_complex * pv,
          else /* loose phase lock */
          {
             /* apply loose phase lock */
-            HC_puckette_lock (pv->len, l_fs, pv->l_f_old);
+            pv_complex_puckette_lock (pv, l_fs, pv->l_f_old);
          }
 
          pv->flag_left = 1;
@@ -169,7 +171,7 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       if (pv->flag_lock == 0) /* no phase lock */
       {
          /* Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, l_fs, l_ft, pv->l_f_old,
+         pv_complex_phase_vocoder (pv, l_fs, l_ft, pv->l_f_old,
                                    pv->l_f_old);
          /* already backed up for the next step in [lr]_f_old[] */
          apply_invFFT_mono (pv, pv->l_f_old, pv->window_scale, pv->l_out);
@@ -177,10 +179,10 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       else /* loose phase lock */
       {
          /* Y[u_i] = X[t_i] (Z[u_{i-1}]/X[s_i]) / |Z[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, l_fs, l_ft, pv->l_f_old,
+         pv_complex_phase_vocoder (pv, l_fs, l_ft, pv->l_f_old,
                                    l_tmp);
          /* apply loose phase lock and store for the next step */
-         HC_puckette_lock (pv->len, l_tmp, pv->l_f_old);
+         pv_complex_puckette_lock (pv, l_tmp, pv->l_f_old);
 
          apply_invFFT_mono (pv, l_tmp, pv->window_scale, pv->l_out);
       }
@@ -195,7 +197,7 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       {
          if (pv->flag_lock == 0) /* no phase lock */
          {
-            for (i = 0; i < pv->len; i ++)
+            for (i = 0; i < pv->spec_len; i ++)
             {
                pv->r_f_old [i] = r_fs [i];
             }
@@ -203,7 +205,7 @@ jack_pv_complex_play_step (struct pv_complex * pv,
          else /* loose phase lock */
          {
             /* apply loose phase lock */
-            HC_puckette_lock (pv->len, r_fs, pv->r_f_old);
+            pv_complex_puckette_lock (pv, r_fs, pv->r_f_old);
          }
          pv->flag_right = 1;
       }
@@ -212,7 +214,7 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       if (pv->flag_lock == 0) /* no phase lock */
       {
          /* Y[u_i] = X[t_i] (Y[u_{i-1}]/X[s_i]) / |Y[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, r_fs, r_ft, pv->r_f_old,
+         pv_complex_phase_vocoder (pv, r_fs, r_ft, pv->r_f_old,
                                    pv->r_f_old);
          /* already backed up for the next step in [lr]_f_old[] */
          apply_invFFT_mono (pv, pv->r_f_old, pv->window_scale, pv->r_out);
@@ -220,10 +222,10 @@ jack_pv_complex_play_step (struct pv_complex * pv,
       else /* loose phase lock */
       {
          /* Y[u_i] = X[t_i] (Z[u_{i-1}]/X[s_i]) / |Z[u_{i-1}]/X[s_i]| */
-         HC_complex_phase_vocoder (pv->len, r_fs, r_ft, pv->r_f_old,
+         pv_complex_phase_vocoder (pv, r_fs, r_ft, pv->r_f_old,
                                    r_tmp);
          /* apply loose phase lock and store for the next step */
-         HC_puckette_lock (pv->len, r_tmp, pv->r_f_old);
+         pv_complex_puckette_lock (pv, r_tmp, pv->r_f_old);
 
          apply_invFFT_mono (pv, r_tmp, pv->window_scale, pv->r_out);
       }
@@ -263,120 +265,276 @@ jack_pv_complex_play_step (struct pv_complex * pv,
    return (pv->hop_res);
 }
 
-/**
- * The process callback for this JACK application is called in a
- * special realtime thread once for each audio cycle.
- *
- * This client follows a simple rule: when the JACK transport is
- * running, copy the input port to the output.  When it stops, exit.
+/* pv_wsola_reader_t on the input of the phase vocoder (and its cache) */
+static long
+jack_pv_wsola_read (void * data,
+                    long frame,
+                    double * left, double * right,
+                    long len)
+{
+   return (pv_complex_read_at ((struct pv_complex *) data,
+                               frame, left, right, len));
+}
+
+/* play one hop_in by WSOLA, with the parameters of pv_jack->pv.
+ * the WSOLA state is made again when hop_syn or the window change.
+ * INPUT
+ *  pv_jack : struct pv_jack
+ *  cur : current frame to play.
+ *        you have to increment this by yourself.
+ * OUTPUT
+ *  left[pv->hop_res], right[pv->hop_res] :
+ *  returned value : hop_res (not hop_syn), or 0 at the end of the file.
+ *  pv->[lr]_out[0, hop_syn] are overwritten (for the resampling),
+ *  so the phase vocoder has to start afresh after this.
  */
 int
-my_jack_process (jack_nframes_t nframes, void * arg)
+jack_pv_wsola_play_step (struct pv_jack * pv_jack,
+                         long cur,
+                         double * left, double * right)
 {
-   extern FILE * err_log;
-   static long play_cur = 0;
-   static jack_default_audio_sample_t * in = NULL;
-   static jack_nframes_t in_len = 0;
-   static double * left  = NULL;
-   static double * right = NULL;
-   static int hop_res0 = 0;
-   static int cur = 0;
-   jack_transport_state_t ts;
-   jack_default_audio_sample_t * out = NULL;
-   struct pv_jack * pv_jack = (struct pv_jack *) arg;
+   struct pv_complex * pv = pv_jack->pv;
+   long status;
+   int i;
 
-   if (in == NULL)
+   if (pv_jack->wsola == NULL ||
+       pv_jack->wsola->len != pv->len ||
+       pv_jack->wsola->hop_syn != pv->hop_syn ||
+       pv_jack->wsola->flag_window != pv->flag_window)
    {
-      in = (jack_default_audio_sample_t *)malloc
-           (sizeof (jack_default_audio_sample_t) * nframes);
-      in_len = nframes;
+      pv_wsola_free (pv_jack->wsola);
+      pv_jack->wsola = pv_wsola_new (pv->len, pv->hop_syn, pv->flag_window);
+      CHECK_MALLOC (pv_jack->wsola, "jack_pv_wsola_play_step");
    }
-   else if (in_len < nframes)
+
+   status = pv_wsola_step (pv_jack->wsola, jack_pv_wsola_read, pv, cur,
+                           pv->l_out, pv->r_out);
+   if (status != pv->hop_syn)
    {
-      in = (jack_default_audio_sample_t *)realloc
-           (in,
-            sizeof (jack_default_audio_sample_t) * nframes);
-      in_len = nframes;
+      return 0; /* no output */
    }
 
-   if (left == NULL)
+   if (pv->hop_syn != pv->hop_res)
    {
-      left  = (double *)malloc (sizeof (double) * pv_jack->pv->hop_res);
-      right = (double *)malloc (sizeof (double) * pv_jack->pv->hop_res);
-      CHECK_MALLOC (left,  "my_jack_process");
-      CHECK_MALLOC (right, "my_jack_process");
-      hop_res0 = pv_jack->pv->hop_res;
-      cur = hop_res0; /* no data left */
+      pv_complex_resample (pv, left, right);
    }
-   else if (hop_res0 < pv_jack->pv->hop_res)
+   else
    {
-      left  = (double *)realloc (left,  sizeof (double) * pv_jack->pv->hop_res);
-      right = (double *)realloc (right, sizeof (double) * pv_jack->pv->hop_res);
-      CHECK_MALLOC (left,  "my_jack_process");
-      CHECK_MALLOC (right, "my_jack_process");
-      hop_res0 = pv_jack->pv->hop_res;
-      cur = hop_res0; /* no data left */
+      for (i = 0; i < pv->hop_res; i ++)
+      {
+         left[i]  = pv->l_out[i];
+         right[i] = pv->r_out[i];
+      }
    }
 
-   /* check */
+   return (pv->hop_res);
+}
 
-   fprintf (err_log, "cur = %d\n", cur);
+/* apply the parameters posted by the curses loop to pv, between
+ * two hops of the worker.
+ * the overlap-add buffers [lr]_out[] start afresh when hop_syn or
+ * the method changes: the ones of the last step do not fit.
+ * INPUT
+ *  pv_jack : struct pv_jack
+ *  params : the parameters to apply
+ *  flag_wsola : the method of the last step
+ * OUTPUT
+ *  *flag_wsola : the method of the next step
+ */
+static void
+pv_jack_apply_params (struct pv_jack * pv_jack,
+                      const struct pv_jack_params * params,
+                      int * flag_wsola)
+{
+   struct pv_complex * pv = pv_jack->pv;
+   long i;
 
-   ts = jack_transport_query (pv_jack->client, NULL);
-   if (ts == JackTransportRolling)
+   if (params->hop_syn != pv->hop_syn || params->flag_wsola != *flag_wsola)
    {
-      int i, j;
-      if (pv_jack->state == Init)
+      if (params->hop_syn != pv->hop_syn)
       {
-         pv_jack->state = Run;
+         pv->l_out = (double *)realloc
+                     (pv->l_out, (pv->len + params->hop_syn) * sizeof (double));
+         pv->r_out = (double *)realloc
+                     (pv->r_out, (pv->len + params->hop_syn) * sizeof (double));
+         CHECK_MALLOC (pv->l_out, "pv_jack_apply_params");
+         CHECK_MALLOC (pv->r_out, "pv_jack_apply_params");
       }
-
-      out = (jack_default_audio_sample_t *)
-           jack_port_get_buffer (pv_jack->out, nframes);
-
-      /* the process for nframes */
-      /* paste the data left in left[] and right[] from cur to hop_res0 */
-
-      for (i = 0, j = cur; (j < hop_res0) && (i < (int) nframes); i ++, j ++)
+      for (i = 0; i < pv->len + params->hop_syn; i ++)
       {
-         in[i] = (jack_default_audio_sample_t)(0.5 * (left[j] + right[j]));
+         pv->l_out [i] = 0.0;
+         pv->r_out [i] = 0.0;
       }
-      cur = j;
-      cur = cur % hop_res0;
+      pv->flag_left  = 0;
+      pv->flag_right = 0;
+      if (pv_jack->wsola != NULL)
+      {
+         pv_wsola_reset (pv_jack->wsola);
+      }
+   }
 
-      /* if the data is not enough, */
+   pv->hop_syn = params->hop_syn;
+   pv->hop_ana = params->hop_ana;
+   pv->hop_res = params->hop_res;
+   pv->flag_lock = params->flag_lock;
+   pv->flag_window = params->flag_window;
+   pv->window_scale = get_scale_factor_for_window (pv->len, pv->hop_syn,
+                                                   pv->flag_window);
+   *flag_wsola = params->flag_wsola;
+}
 
-      while (i < (int) nframes)
-      {
-         int j;
+/* the worker thread: it reads the file and runs the phase vocoder
+ * ahead of the process callback, as long as the ring has room.
+ * the output of a step that does not fit stays in buf[] until the
+ * callback makes room for it.
+ * it is the only thread that touches pv while it runs; the curses
+ * loop talks to it through pv_jack->pending and pv_jack->play_cur.
+ * INPUT
+ *  arg : struct pv_jack
+ */
+static void *
+pv_jack_worker (void * arg)
+{
+   struct pv_jack * pv_jack = (struct pv_jack *) arg;
+   struct pv_complex * pv = pv_jack->pv;
+   struct pv_jack_params params;
+   double * left  = NULL;
+   double * right = NULL;
+   jack_default_audio_sample_t * buf = NULL;
+   long n_alloc = 0;
+   long n = 0;   /* samples in buf[] */
+   long cur = 0; /* samples of buf[] already in the ring */
+   long play_cur = 0; /* next frame of the file to analyse */
+   int flag_wsola = 0; /* the method of the last step */
+   int flag_new;
+   long i;
 
-         /* process further data (next hop_res frames) */
+   while (pv_jack->state != Exit)
+   {
+      size_t space;
 
-         if (cur != 0)
+      if (cur >= n)
+      {
+         /* a hop boundary: take the new parameters, if any */
+         pthread_mutex_lock (&pv_jack->lock);
+         flag_new = pv_jack->flag_pending;
+         params = pv_jack->pending;
+         pv_jack->flag_pending = 0;
+         pthread_mutex_unlock (&pv_jack->lock);
+         if (flag_new)
          {
-            fprintf (stderr, "cur update failed...\n");
-            fprintf (err_log, "cur update failed...\n");
-            fprintf (err_log, "cur = %d\n", cur);
-            fclose (err_log);
-            exit (1);
+            pv_jack_apply_params (pv_jack, &params, &flag_wsola);
          }
-         jack_pv_complex_play_step (pv_jack->pv, play_cur, left, right);
-         play_cur += pv_jack->pv->hop_ana;
 
-         /* then, paste the data in left[] and right[] from 0 to hop_res0 */
+         /* process further data (next hop_res frames) */
+         if (n_alloc < pv->hop_res)
+         {
+            n_alloc = pv->hop_res;
+            left  = (double *)realloc (left,  sizeof (double) * n_alloc);
+            right = (double *)realloc (right, sizeof (double) * n_alloc);
+            buf = (jack_default_audio_sample_t *)realloc
+                  (buf, sizeof (jack_default_audio_sample_t) * n_alloc);
+            CHECK_MALLOC (left,  "pv_jack_worker");
+            CHECK_MALLOC (right, "pv_jack_worker");
+            CHECK_MALLOC (buf,   "pv_jack_worker");
+         }
+         if (flag_wsola == 0)
+         {
+            n = jack_pv_complex_play_step (pv, play_cur, left, right);
+         }
+         else
+         {
+            n = jack_pv_wsola_play_step (pv_jack, play_cur, left, right);
+         }
+         play_cur += pv->hop_ana;
 
-         for (j = 0; (j < hop_res0) && (i < (int) nframes); j ++, i ++)
+         pthread_mutex_lock (&pv_jack->lock);
+         pv_jack->play_cur = play_cur;
+         pv_jack->cache_hit_rate = pv_complex_cache_hit_rate (pv);
+         pthread_mutex_unlock (&pv_jack->lock);
+         if (n == 0)
          {
-            in[i] = (jack_default_audio_sample_t)(0.5 * (left[j] + right[j]));
+            /* out of the file: silence, rather than an underrun */
+            n = pv->hop_res < n_alloc ? pv->hop_res : n_alloc;
+            for (i = 0; i < n; i ++)
+            {
+               left[i] = right[i] = 0.0;
+            }
          }
-         cur = j;
-         cur = cur % hop_res0;
+         for (i = 0; i < n; i ++)
+         {
+            buf[i] = (jack_default_audio_sample_t)(0.5 * (left[i] + right[i]));
+         }
+         cur = 0;
       }
 
-      /* now, the data in in[] is enough to pass jack server */
+      space = jack_ringbuffer_write_space (pv_jack->ring)
+              / sizeof (jack_default_audio_sample_t);
+      if (space == 0)
+      {
+         usleep (PV_JACK_WORKER_SLEEP);
+         continue;
+      }
+      if (space > (size_t)(n - cur))
+      {
+         space = (size_t)(n - cur);
+      }
+      jack_ringbuffer_write (pv_jack->ring, (const char *)(buf + cur),
+                             space * sizeof (jack_default_audio_sample_t));
+      cur += (long)space;
+   }
+
+   free (left);
+   free (right);
+   free (buf);
+   return NULL;
+}
 
-      memcpy (out, in,
-              sizeof (jack_default_audio_sample_t) * nframes);
+/**
+ * The process callback for this JACK application is called in a
+ * special realtime thread once for each audio cycle.
+ *
+ * This client follows a simple rule: when the JACK transport is
+ * running, copy the ring to the output.  When it stops, exit.
+ * It neither allocates nor reads the file; a short ring is
+ * padded by silence and counted as an underrun.
+ */
+int
+my_jack_process (jack_nframes_t nframes, void * arg)
+{
+   jack_transport_state_t ts;
+   jack_default_audio_sample_t * out = NULL;
+   struct pv_jack * pv_jack = (struct pv_jack *) arg;
+
+   ts = jack_transport_query (pv_jack->client, NULL);
+   if (ts == JackTransportRolling)
+   {
+      size_t fill;
+      size_t n = (size_t) nframes;
+      if (pv_jack->state == Init)
+      {
+         pv_jack->state = Run;
+      }
+
+      out = (jack_default_audio_sample_t *)
+           jack_port_get_buffer (pv_jack->out, nframes);
+
+      fill = jack_ringbuffer_read_space (pv_jack->ring)
+             / sizeof (jack_default_audio_sample_t);
+      if (fill < pv_jack->fill_min)
+      {
+         pv_jack->fill_min = fill;
+      }
+      if (fill < n)
+      {
+         n = fill;
+         pv_jack->n_underruns ++;
+      }
+      jack_ringbuffer_read (pv_jack->ring, (char *) out,
+                            n * sizeof (jack_default_audio_sample_t));
+      memset (out + n, 0,
+              sizeof (jack_default_audio_sample_t) * (nframes - n));
+      pv_jack->n_cycles ++;
    }
    else if (ts == JackTransportStopped)
    {
@@ -399,7 +557,10 @@ jack_shutdown (void * arg)
    exit (arg == NULL ? 1 : 2);
 }
 
-/* start jack process for output (playback)
+/* open jack client for output (playback).
+ * the worker thread and the process callback are started by
+ * pv_jack_start (), once the parameters are known (hop_res needs
+ * the sample rate of the server).
  * INPUT
  * OUTPUT
  *  returned value : struct pv_jack *pv_jack.
@@ -407,48 +568,36 @@ jack_shutdown (void * arg)
 struct pv_jack *
 pv_jack_init (struct pv_complex * pv)
 {
-   char * client_name = NULL;
-   const char * server_name = NULL;
    struct pv_jack * pv_jack
       = (struct pv_jack *)malloc (sizeof (struct pv_jack));
-   jack_options_t options = JackNullOption;
-   jack_status_t jack_status;
-   const char ** ports;
 
    CHECK_MALLOC (pv_jack, "main");
 
    pv_jack->pv = pv;
    pv_jack->state = Init;
+   pv_jack->wsola = NULL;
+   pthread_mutex_init (&pv_jack->lock, NULL);
+   pv_jack->flag_pending = 0;
+   pv_jack->play_cur = 0;
+   pv_jack->cache_hit_rate = 0.0;
+   pv_jack->n_cycles = 0;
+   pv_jack->n_underruns = 0;
+
+   /* the ring, locked in memory */
+   pv_jack->ring = jack_ringbuffer_create
+                   (sizeof (jack_default_audio_sample_t) * PV_JACK_RING_LEN);
+   CHECK_MALLOC (pv_jack->ring, "pv_jack_init");
+   jack_ringbuffer_mlock (pv_jack->ring);
+   pv_jack->fill_min = jack_ringbuffer_write_space (pv_jack->ring)
+                       / sizeof (jack_default_audio_sample_t);
 
 
-   client_name = (char *)malloc (sizeof (char) * 8);
-   strcpy (client_name, "jack-pv");
-   server_name = NULL;
-
    /* open a client connection to the JACK server */
-
-   pv_jack->client
-      = jack_client_open (client_name, options, &jack_status, server_name);
+   pv_jack->client = waon_jack_open ("jack-pv");
    if (pv_jack->client == NULL)
    {
-      fprintf (stderr, "jack_client_open() failed, "
-               "status = 0x%2.0x\n", jack_status);
-      if (jack_status & JackServerFailed)
-      {
-         fprintf (stderr, "Unable to connect to JACK server\n");
-      }
       exit (1);
    }
-   if (jack_status & JackServerStarted)
-   {
-      fprintf (stderr, "JACK server started\n");
-   }
-   if (jack_status & JackNameNotUnique)
-   {
-      free (client_name);
-      client_name = jack_get_client_name(pv_jack->client);
-      fprintf (stderr, "unique name `%s' assigned\n", client_name);
-   }
 
    /* tell the JACK server to call `process()' whenever
       there is work to be done.
@@ -477,6 +626,27 @@ pv_jack_init (struct pv_complex * pv)
       exit (1);
    }
 
+   return (pv_jack);
+}
+
+/* start the worker thread, which applies params before its first hop,
+ * and then the process callback.
+ * INPUT
+ *  pv_jack : struct pv_jack from pv_jack_init ()
+ *  params : the initial parameters
+ */
+void
+pv_jack_start (struct pv_jack * pv_jack,
+               const struct pv_jack_params * params)
+{
+   pv_jack->pending = *params;
+   pv_jack->flag_pending = 1;
+   if (pthread_create (&pv_jack->worker, NULL, pv_jack_worker, pv_jack) != 0)
+   {
+      fprintf (stderr, "cannot start the worker thread\n");
+      exit (1);
+   }
+
    /* Tell the JACK server that we are ready to roll.  Our
     * process() callback will start running now. */
    if (jack_activate (pv_jack->client))
@@ -492,27 +662,41 @@ pv_jack_init (struct pv_complex * pv)
     * "input" to the backend, and capture ports are "output" from
     * it.
     */
-   ports = jack_get_ports (pv_jack->client, NULL, NULL,
-                           JackPortIsPhysical | JackPortIsInput);
-   if (ports == NULL)
-   {
-      fprintf(stderr, "no physical playback ports\n");
-      exit (1);
-   }
-   if (jack_connect (pv_jack->client, jack_port_name (pv_jack->out), ports[0]))
-   {
-      fprintf (stderr, "cannot connect output ports\n");
-   }
-   free (ports);
+   waon_jack_connect_physical (pv_jack->client, pv_jack->out, 1);
+}
 
+void
+pv_jack_set_params (struct pv_jack * pv_jack,
+                    const struct pv_jack_params * params)
+{
+   pthread_mutex_lock (&pv_jack->lock);
+   pv_jack->pending = *params;
+   pv_jack->flag_pending = 1;
+   pthread_mutex_unlock (&pv_jack->lock);
+}
 
-   return (pv_jack);
+void
+pv_jack_get_status (struct pv_jack * pv_jack,
+                    long * play_cur, double * cache_hit_rate)
+{
+   pthread_mutex_lock (&pv_jack->lock);
+   *play_cur = pv_jack->play_cur;
+   *cache_hit_rate = pv_jack->cache_hit_rate;
+   pthread_mutex_unlock (&pv_jack->lock);
 }
 
 void
 pv_jack_free (struct pv_jack * pv_jack)
 {
-   if (pv_jack != NULL) free (pv_jack);
+   if (pv_jack != NULL)
+   {
+      pv_jack->state = Exit;
+      pthread_join (pv_jack->worker, NULL);
+      pthread_mutex_destroy (&pv_jack->lock);
+      jack_ringbuffer_free (pv_jack->ring);
+      pv_wsola_free (pv_jack->wsola);
+      free (pv_jack);
+   }
 }
 
 
@@ -523,13 +707,16 @@ pv_jack_free (struct pv_jack * pv_jack)
 #define Y_rate    (5)
 #define Y_pitch   (6)
 #define Y_lock    (8)
+#define Y_method  (9)
 #define Y_window  (10)
 #define Y_len     (11)
 #define Y_hop_syn (12)
 #define Y_hop_ana (13)
 #define Y_hop_res (14)
+#define Y_cache   (15)
 
 #define Y_status  (16)
+#define Y_ring    (17)
 #define Y_comment (18)
 
 static void
@@ -561,6 +748,13 @@ curses_print_window (int flag_window)
    }
 }
 
+static void
+curses_print_method (int flag_wsola)
+{
+   if (flag_wsola == 0) mvprintw (Y_method, 1, "method     : PV   ");
+   else                 mvprintw (Y_method, 1, "method     : WSOLA");
+}
+
 static void
 curses_print_pitch (int pv_pitch)
 {
@@ -625,6 +819,7 @@ curses_print_pitch (int pv_pitch)
 static void
 curses_print_pv (const char * file,
                  struct pv_complex * pv,
+                 const struct pv_jack_params * params,
                  int flag_play,
                  long frame0, long frame1,
                  double pv_pitch,
@@ -640,16 +835,17 @@ curses_print_pv (const char * file,
    curses_print_pitch (pv_pitch);
    mvprintw (Y_rate,   1, "rate       : %-5.1f", pv_rate);
    mvprintw (Y_len,    1, "fft-len    : %06ld", pv->len);
-   mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", pv->hop_syn);
-   mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", pv->hop_ana);
-   mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", pv->hop_res);
+   mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", params->hop_syn);
+   mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", params->hop_ana);
+   mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", params->hop_res);
 
    if (flag_play == 0) mvprintw(Y_status, 1, "status     : stop");
    else                mvprintw(Y_status, 1, "status     : play");
 
-   if (pv->flag_lock == 0) mvprintw(Y_lock, 1, "phase-lock : off");
-   else                    mvprintw(Y_lock, 1, "phase-lock : on ");
-   curses_print_window (pv->flag_window);
+   if (params->flag_lock == 0) mvprintw(Y_lock, 1, "phase-lock : off");
+   else                        mvprintw(Y_lock, 1, "phase-lock : on ");
+   curses_print_method (params->flag_wsola);
+   curses_print_window (params->flag_window);
 
    /* help message */
    mvprintw (Y_loop,    41, "< > by cur, [ { expand } ]");
@@ -658,6 +854,7 @@ curses_print_pv (const char * file,
    mvprintw (Y_hop_syn, 41, "H / h");
    mvprintw (Y_status,  41, "SPACE");
    mvprintw (Y_lock,    41, "L");
+   mvprintw (Y_method,  41, "S");
    mvprintw (Y_window,  41, "W");
 
    mvprintw (Y_comment - 1, 0, "----------------------------------------");
@@ -665,22 +862,31 @@ curses_print_pv (const char * file,
 
 /* change rate and pitch (note that hop_syn is fixed)
  * INPUT
- *  pv : struct pv_complex
+ *  params : struct pv_jack_params
  *  rate  : rate of speed (1 == same speed, negative == backward)
  *  pitch : pitch-shift (0 == no-shift, +1(-1) = half-note up(down))
  * OUTPUT
- *  pv->hop_res :
- *  pv->hop_ana :
+ *  params->hop_res :
+ *  params->hop_ana :
  */
-void
-pv_complex_change_rate_pitch_ (struct pv_complex * pv,
-                               int sr_in, int sr_out,
-                               double rate,
-                               double pitch)
+static void
+pv_jack_change_rate_pitch (struct pv_jack_params * params,
+                           int sr_in, int sr_out,
+                           double rate,
+                           double pitch)
 {
    double rate0 = (double)sr_out / (double)sr_in;
-   pv->hop_res = (long)(rate0 * (double)pv->hop_syn * pow (2.0, - pitch / 12.0));
-   pv->hop_ana = (long)((double)pv->hop_res * rate);
+   params->hop_res = (long)(rate0 * (double)params->hop_syn
+                            * pow (2.0, - pitch / 12.0));
+   params->hop_ana = (long)((double)params->hop_res * rate);
+}
+
+static void
+curses_print_hops (const struct pv_jack_params * params)
+{
+   mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", params->hop_syn);
+   mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", params->hop_ana);
+   mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", params->hop_res);
 }
 
 /* phase vocoder by complex arithmetics with fixed hops.  */
@@ -692,6 +898,7 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
    SNDFILE * sf = NULL;
    SF_INFO sfinfo;
    struct pv_jack * pv_jack;
+   struct pv_jack_params params; /* the ones of the keys, for the worker */
    int jack_sr;
    extern FILE * err_log;
    double pv_rate  = 1.0;
@@ -700,6 +907,7 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
    long frame1 = 0;
    int flag_play = 1;
    long play_cur = 0;
+   double cache_hit_rate = 0.0;
    long len_1sec;
    long len_10sec;
 
@@ -712,6 +920,11 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
    nodelay(stdscr, TRUE); /* Don't wait the key press */
    pv = pv_complex_init (len, hop_syn, flag_window);
    CHECK_MALLOC (pv, "pv_complex_curses");
+   if (pv_complex_set_cache (pv, PV_COMPLEX_CACHE_LOOP_FRAMES) == 0)
+   {
+      /* the loops are transformed at each pass then */
+      fprintf (stderr, "no memory for the spectrum cache\n");
+   }
 
    memset (&sfinfo, 0, sizeof (sfinfo));
    sf = sf_open (file, SFM_READ, &sfinfo); /* open input file */
@@ -736,20 +949,24 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
    jack_sr = (int)jack_get_sample_rate (pv_jack->client);
    err_log = fopen ("jack-pv.log", "w");
 
-   /* initial values */
-   pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                  pv_rate, pv_pitch);
+   /* initial values, applied by the worker before its first hop */
+   params.hop_syn = hop_syn;
+   params.flag_lock = 0; /* no phase-lock */
+   params.flag_window = flag_window;
+   params.flag_wsola = 0;
+   pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                              pv_rate, pv_pitch);
    fprintf (stderr, "# samplerates: %d %d\n", sfinfo.samplerate, jack_sr);
+   pv_jack_start (pv_jack, &params);
 
    frame1 = (long)pv->sfinfo->frames - 1;
-   pv->flag_lock = 0; /* no phase-lock */
 
    len_1sec  = (long)(pv->sfinfo->samplerate /* Hz */);
    len_10sec = (long)(10 * pv->sfinfo->samplerate /* Hz */);
 
    mvprintw (Y_comment, 1, "Welcome WaoN-pv in curses mode.");
-   curses_print_pv (file, pv, flag_play, frame0, frame1,
-                    pv_pitch, pv_rate);
+   curses_print_pv (file, pv, &params, flag_play,
+                    frame0, frame1, pv_pitch, pv_rate);
 
    /* main loop */
    /* long status = 1; TRUE */
@@ -757,9 +974,11 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
    {
       /* scan keyboard */
       int ch = getch();
+      int flag_changed = 1; /* a key may have changed params */
       switch (ch)
       {
       case ERR: /* no key event */
+         flag_changed = 0;
          break;
 
       case ' ': /* SPACE */
@@ -813,85 +1032,76 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
 
       case 'L':
       case 'l':
-         pv->flag_lock++;
-         pv->flag_lock = pv->flag_lock % 2;
+         params.flag_lock++;
+         params.flag_lock = params.flag_lock % 2;
 
-         if (pv->flag_lock == 0) mvprintw(Y_lock, 1, "phase-lock : off");
-         else                    mvprintw(Y_lock, 1, "phase-lock : on ");
+         if (params.flag_lock == 0) mvprintw(Y_lock, 1, "phase-lock : off");
+         else                       mvprintw(Y_lock, 1, "phase-lock : on ");
+         break;
+
+      case 'S':
+      case 's':
+         /* the worker switches at its next step */
+         params.flag_wsola = (params.flag_wsola + 1) % 2;
+         curses_print_method (params.flag_wsola);
          break;
 
       case 'W':
       case 'w':
-         pv->flag_window++;
-         pv->flag_window = pv->flag_window % 7; /* 0 to 6 */
-
-         /* reset scale factor */
-         pv->window_scale
-            = get_scale_factor_for_window (pv->len, pv->hop_syn,
-                                           pv->flag_window);
-         curses_print_window (pv->flag_window);
+         /* the worker resets the scale factor */
+         params.flag_window++;
+         params.flag_window = params.flag_window % 7; /* 0 to 6 */
+         curses_print_window (params.flag_window);
          break;
 
       case 'H':
-         pv->hop_syn *= 2;
-         if (pv->hop_syn > len) pv->hop_syn = len;
+         params.hop_syn *= 2;
+         if (params.hop_syn > len) params.hop_syn = len;
          /* hop_res, hop_ana depend on hop_syn */
-         pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                        pv_rate, pv_pitch);
-         mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", pv->hop_syn);
-         mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", pv->hop_ana);
-         mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", pv->hop_res);
+         pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                                    pv_rate, pv_pitch);
+         curses_print_hops (&params);
          break;
 
       case 'h':
-         pv->hop_syn /= 2;
-         if (pv->hop_syn < 1) pv->hop_syn = 1;
+         params.hop_syn /= 2;
+         if (params.hop_syn < 1) params.hop_syn = 1;
          /* hop_res, hop_ana depend on hop_syn */
-         pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                        pv_rate, pv_pitch);
-         mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", pv->hop_syn);
-         mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", pv->hop_ana);
-         mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", pv->hop_res);
+         pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                                    pv_rate, pv_pitch);
+         curses_print_hops (&params);
          break;
 
       case KEY_UP:
          pv_pitch += 1.0;
-         pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                        pv_rate, pv_pitch);
+         pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                                    pv_rate, pv_pitch);
          curses_print_pitch (pv_pitch);
-         mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", pv->hop_syn);
-         mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", pv->hop_ana);
-         mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", pv->hop_res);
+         curses_print_hops (&params);
          break;
 
       case KEY_DOWN:
          pv_pitch -= 1.0;
-         pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                        pv_rate, pv_pitch);
+         pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                                    pv_rate, pv_pitch);
          curses_print_pitch (pv_pitch);
-         mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", pv->hop_syn);
-         mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", pv->hop_ana);
-         mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", pv->hop_res);
+         curses_print_hops (&params);
          break;
 
       case KEY_LEFT:
          pv_rate -= 0.1;
-         pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                        pv_rate, pv_pitch);
+         pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                                    pv_rate, pv_pitch);
          mvprintw (Y_rate,   1, "rate       : %-5.1f", pv_rate);
-         mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", pv->hop_syn);
-         mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", pv->hop_ana);
-         mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", pv->hop_res);
+         curses_print_hops (&params);
          break;
 
       case KEY_RIGHT:
          pv_rate += 0.1;
-         pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                        pv_rate, pv_pitch);
+         pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                                    pv_rate, pv_pitch);
          mvprintw (Y_rate,   1, "rate       : %-5.1f", pv_rate);
-         mvprintw (Y_hop_syn, 1, "hop(syn)   : %06ld", pv->hop_syn);
-         mvprintw (Y_hop_ana, 1, "hop(ana)   : %06ld", pv->hop_ana);
-         mvprintw (Y_hop_res, 1, "hop(res)   : %06ld", pv->hop_res);
+         curses_print_hops (&params);
          break;
 
       case KEY_HOME:
@@ -901,11 +1111,11 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
          frame1 = (long)pv->sfinfo->frames - 1;
          pv_rate = 1.0;
          pv_pitch = 0.0;
-         pv->hop_syn = hop_syn; /* value in the argument */
-         pv_complex_change_rate_pitch_ (pv, sfinfo.samplerate, jack_sr,
-                                        pv_rate, pv_pitch);
-         curses_print_pv (file, pv, flag_play, frame0, frame1,
-                          pv_pitch, pv_rate);
+         params.hop_syn = hop_syn; /* value in the argument */
+         pv_jack_change_rate_pitch (&params, sfinfo.samplerate, jack_sr,
+                                    pv_rate, pv_pitch);
+         curses_print_pv (file, pv, &params, flag_play,
+                          frame0, frame1, pv_pitch, pv_rate);
          mvprintw(Y_comment, 1, "reset everything");
          break;
 
@@ -921,7 +1131,17 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
            break;
            */
       }
+      if (flag_changed)
+      {
+         pv_jack_set_params (pv_jack, &params);
+      }
+      pv_jack_get_status (pv_jack, &play_cur, &cache_hit_rate);
       mvprintw (Y_frames, 1, "current    : %010ld", play_cur);
+      mvprintw (Y_cache,  1, "fft-cache  : %5.1f %% hits", cache_hit_rate);
+      mvprintw (Y_ring,   1, "ring       : %05ld (min %05ld), underruns %lu",
+                (long)(jack_ringbuffer_read_space (pv_jack->ring)
+                       / sizeof (jack_default_audio_sample_t)),
+                (long)pv_jack->fill_min, pv_jack->n_underruns);
       refresh();
    }
 
@@ -929,6 +1149,10 @@ void pv_complex_curses_jack (const char * file, long len, long hop_syn)
       ;
 
    jack_client_close (pv_jack->client);
+   fprintf (err_log, "cycles = %lu, underruns = %lu, ring min = %ld\n",
+            pv_jack->n_cycles, pv_jack->n_underruns,
+            (long)pv_jack->fill_min);
+   fclose (err_log);
    pv_jack_free (pv_jack);
 
    pv_complex_free (pv);
@@ -21,8 +21,20 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#include <pthread.h> /* pthread_t, pthread_mutex_t */
 #include <jack/jack.h> /* jack_client_t, jack_port_t */
+#include <jack/ringbuffer.h> /* jack_ringbuffer_t */
 #include "pv-complex.h" /* struct pv_complex */
+#include "pv-wsola.h" /* pv_wsola_t */
+
+/* length of the ring between the worker thread and the process
+ * callback, in samples (JACK rounds it up to a power of two).
+ * at 44.1 kHz, 8192 samples are about 0.19 sec of latency for
+ * the changes of rate and pitch. */
+#define PV_JACK_RING_LEN (8192)
+
+/* sleep of the worker thread while the ring is full [usec] */
+#define PV_JACK_WORKER_SLEEP (1000)
 
 /* a simple state machine for this client */
 
@@ -33,12 +45,46 @@ enum jack_state
    Exit
 };
 
+/* the parameters of the playback that the curses loop changes.
+ * the loop posts them by pv_jack_set_params (), and the worker
+ * applies them to pv at the start of its next hop, so that pv is
+ * never changed under a running step. */
+struct pv_jack_params
+{
+   long hop_syn;
+   long hop_ana;
+   long hop_res;
+   int flag_lock;   /* 0 == no phase lock, 1 == loose phase lock */
+   int flag_window;
+   int flag_wsola;  /* 1 == play by WSOLA instead of the phase vocoder */
+};
+
 struct pv_jack
 {
    struct pv_complex * pv;
    jack_client_t * client;
    jack_port_t  * out;
-   enum jack_state state;
+   volatile enum jack_state state;
+
+   /* the worker thread reads the file and runs the phase vocoder,
+    * and writes the (mono) output into the ring.
+    * the process callback only copies out of the ring. */
+   jack_ringbuffer_t * ring;
+   pthread_t worker;
+   pv_wsola_t * wsola; /* made and used by the worker only */
+
+   /* between the curses loop and the worker, under the lock:
+    * the parameters to apply, and the status of the last hop */
+   pthread_mutex_t lock;
+   struct pv_jack_params pending;
+   int flag_pending;      /* 1 == pending[] is not applied yet */
+   long play_cur;         /* next frame of the file to analyse */
+   double cache_hit_rate; /* of the FFT cache of pv [%] */
+
+   /* statistics, written by the process callback only */
+   volatile unsigned long n_cycles;    /* cycles while rolling */
+   volatile unsigned long n_underruns; /* cycles the ring ran short */
+   volatile size_t fill_min;           /* lowest fill at a cycle [samples] */
 };
 
 
@@ -63,12 +109,25 @@ jack_pv_complex_play_step (struct pv_complex * pv,
                            long cur,
                            double * left, double * right);
 
+/* play one hop_in by WSOLA (see pv-wsola.h), the time-domain
+ * alternative to jack_pv_complex_play_step() for speech
+ * OUTPUT
+ *  left[pv->hop_res], right[pv->hop_res] :
+ *  returned value : hop_res (not hop_syn).
+ */
+int
+jack_pv_wsola_play_step (struct pv_jack * pv_jack,
+                         long cur,
+                         double * left, double * right);
+
 /**
  * The process callback for this JACK application is called in a
  * special realtime thread once for each audio cycle.
  *
  * This client follows a simple rule: when the JACK transport is
- * running, copy the input port to the output.  When it stops, exit.
+ * running, copy the ring to the output.  When it stops, exit.
+ * It neither allocates nor reads the file; a short ring is
+ * padded by silence and counted as an underrun.
  */
 int
 my_jack_process (jack_nframes_t nframes, void * arg);
@@ -81,7 +140,8 @@ void
 jack_shutdown (void * arg);
 
 /**
- * start jack process for output (playback)
+ * open the jack client for output (playback).
+ * the worker and the process callback start by pv_jack_start ().
  * INPUT
  * OUTPUT
  *  returned value : struct pv_jack *pv_jack.
@@ -89,6 +149,32 @@ jack_shutdown (void * arg);
 struct pv_jack *
 pv_jack_init (struct pv_complex * pv);
 
+/**
+ * start the worker thread that fills the ring, with the parameters
+ * params, and then the process callback.
+ */
+void
+pv_jack_start (struct pv_jack * pv_jack,
+               const struct pv_jack_params * params);
+
+/**
+ * post new parameters to the worker, which applies them at its next hop.
+ */
+void
+pv_jack_set_params (struct pv_jack * pv_jack,
+                    const struct pv_jack_params * params);
+
+/**
+ * get the position and the cache hit rate after the last hop.
+ */
+void
+pv_jack_get_status (struct pv_jack * pv_jack,
+                    long * play_cur, double * cache_hit_rate);
+
+/**
+ * stop the worker thread (pv_jack->state has to be Exit)
+ * and free the ring.
+ */
 void
 pv_jack_free (struct pv_jack * pv_jack);
 
@@ -33,6 +33,7 @@
 /* #include "jack-pv.h" */
 
 #include "pv-nofft.h"
+#include "pv-wsola.h"
 #include "VERSION.h"
 
 
@@ -72,12 +73,25 @@ void print_pv_usage (char * argv0)
    fprintf (stdout, "\t\t4 hamming window\n");
    fprintf (stdout, "\t\t5 blackman window\n");
    fprintf (stdout, "\t\t6 steeper 30-dB/octave rolloff window\n");
+   fprintf (stdout, "  -r2c       \tuse the interleaved complex (r2c) FFT layout\n"
+            "\t\tinstead of the half-complex one (schemes 2 and 4)\n");
    fprintf (stdout, "PHASE-VOCODER OPTIONS\n");
    fprintf (stdout, "  -hop       \thop number (default: 512)\n");
    fprintf (stdout, "  -rate      \tsynthesize rate; larger is faster"
             " (default: 1.0)\n");
    fprintf (stdout, "  -pitch\tpitch shift. +1/-1 is half-note up/down"
             " (default: 0)\n");
+   fprintf (stdout, "  -src       \tsamplerate converter for the pitch shift"
+            " (schemes 2 and 4)\n");
+   fprintf (stdout, "\t\t0 best sinc\n");
+   fprintf (stdout, "\t\t1 medium sinc\n");
+   fprintf (stdout, "\t\t2 fastest sinc (default)\n");
+   fprintf (stdout, "\t\t3 zero-order hold\n");
+   fprintf (stdout, "\t\t4 linear\n");
+   fprintf (stdout, "  -threads   \trender the output file with a pipeline of\n"
+            "\t\tthreads (schemes 2 and 4, with -o)\n");
+   fprintf (stdout, "  -latency   \tmsec the curses mode plays ahead of the\n"
+            "\t\tdevice (scheme 0) [Default: %d]\n", AO_QUEUE_LATENCY_MS);
    fprintf (stdout, "  -scheme    \tgive the number for PV scheme\n");
    fprintf (stdout, "\t\t1 : conventional PV\n");
    fprintf (stdout, "\t\t2 : PV by complex arithmetics with fixed hops\n");
@@ -87,6 +101,7 @@ void print_pv_usage (char * argv0)
    fprintf (stdout, "\t\t5 : PV with fixed hops by Ellis\n");
    fprintf (stdout, "\t\t6 : PV in freq. domain\n");
    fprintf (stdout, "\t\t7 : plain superimpose (no-FFT)\n");
+   fprintf (stdout, "\t\t8 : WSOLA, time-domain (no-FFT PV, for speech)\n");
    fprintf (stdout, "\t\t0 : interactive PV with curses (default)\n");
    fprintf (stdout, "KEY BINDINGS IN CURSES MODE (with -scheme 0, the default)\n"
             "\tSPACE        : play / stop\n"
@@ -116,6 +131,11 @@ int main (int argc, char ** argv)
    double pitch_shift = 0.0;
    int scheme = 0;
    int flag_window = 3; /* hanning window */
+   int flag_r2c = 0; /* half-complex FFT layout */
+   int src_quality = SRC_SINC_FASTEST; /* samplerate converter */
+   int flag_threads = 0; /* one thread */
+   long latency_ms = AO_QUEUE_LATENCY_MS; /* of the curses output */
+   int status = 0; /* of the schemes that return one */
 
    int i;
    for (i = 1; i < argc; i++)
@@ -177,6 +197,28 @@ int main (int argc, char ** argv)
             scheme = atoi (argv [++i]);
          }
       }
+      else if (strcmp (argv[i], "-r2c" ) == 0)
+      {
+         flag_r2c = 1;
+      }
+      else if (strcmp (argv[i], "-threads" ) == 0)
+      {
+         flag_threads = 1;
+      }
+      else if (strcmp (argv[i], "-latency" ) == 0)
+      {
+         if (i + 1 < argc)
+         {
+            latency_ms = (long)atoi (argv [++i]);
+         }
+      }
+      else if (strcmp (argv[i], "-src" ) == 0)
+      {
+         if (i + 1 < argc)
+         {
+            src_quality = atoi (argv [++i]);
+         }
+      }
       else if ((strcmp (argv[i], "--window") == 0)
                || (strcmp (argv[i], "-w") == 0))
       {
@@ -208,36 +250,42 @@ int main (int argc, char ** argv)
    switch (scheme)
    {
    case 0:
-      pv_complex_curses (file_in, len, hop);
+      pv_complex_curses (file_in, len, hop, latency_ms);
       break;
 
    case 1:
-      pv_conventional (file_in, file_out, rate, pitch_shift,
-                       len, hop, flag_window);
+      status = pv_conventional (file_in, file_out, rate, pitch_shift,
+                                len, hop, flag_window);
       break;
 
    case 2:
       pv_complex (file_in, file_out, rate, pitch_shift,
                   len, hop, flag_window,
-                  0 /* no phase lock */
+                  0 /* no phase lock */,
+                  flag_r2c,
+                  src_quality,
+                  flag_threads
                  );
       break;
 
    case 3:
-      pv_loose_lock (file_in, file_out, rate, pitch_shift,
-                     len, hop, flag_window);
+      status = pv_loose_lock (file_in, file_out, rate, pitch_shift,
+                              len, hop, flag_window);
       break;
 
    case 4:
       pv_complex (file_in, file_out, rate, pitch_shift,
                   len, hop, flag_window,
-                  1 /* loose phase lock */
+                  1 /* loose phase lock */,
+                  flag_r2c,
+                  src_quality,
+                  flag_threads
                  );
       break;
 
    case 5:
-      pv_ellis (file_in, file_out, rate, pitch_shift,
-                len, hop, flag_window);
+      status = pv_ellis (file_in, file_out, rate, pitch_shift,
+                         len, hop, flag_window);
       break;
 
    case 6:
@@ -246,15 +294,20 @@ int main (int argc, char ** argv)
          fprintf (stderr, "pitch-shifting is not implemented yet\n");
          break;
       }
-      pv_freq (file_in, file_out, rate, len, hop, flag_window);
+      status = pv_freq (file_in, file_out, rate, len, hop, flag_window);
       break;
 
    case 7:
-      pv_nofft (file_in, file_out, rate, pitch_shift,
-                len, hop, flag_window);
+      status = pv_nofft (file_in, file_out, rate, pitch_shift,
+                         len, hop, flag_window);
+      break;
+
+   case 8:
+      status = pv_wsola (file_in, file_out, rate, pitch_shift,
+                         len, hop, flag_window);
       break;
       /*
-      case 8:
+      case 9:
       pv_complex_curses_jack (file_in, len, hop);
       break;
       */
@@ -266,5 +319,5 @@ int main (int argc, char ** argv)
 
    free (file_in);
 
-   return 0;
+   return (status == 0 ? 0 : 1);
 }
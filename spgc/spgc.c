@@ -0,0 +1,728 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : batch spectrogram renderer
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          spgc.c
+ *
+ *    This program renders the spectrogram of a sound file without a
+ *    display, with the engine and the display modes of gwaonc (see
+ *    spectrogram.h).
+ *
+ * \library       spgc application
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    Each column of the output is one analysis frame, and the frames are
+ *    "-step" samples apart, so a file of any length gives an image of any
+ *    width.  The columns are computed in passes, each split between the
+ *    worker threads; all of the FFTW plans are made before the threads
+ *    start.  The output is one of:
+ *
+ *       -  "ppm", a binary PPM (P6) image, with the colormap of gwaonc.
+ *       -  "png", a PNG image with the same colormap as a palette.  No
+ *          compression library is needed: the image data are written as
+ *          stored (uncompressed) deflate blocks.
+ *       -  "raw", the power of each row of each column, as native 32-bit
+ *          floats, [columns][height], the bottom row first.  A blank row
+ *          (one no bin reaches) is 0.  Each pass is written as soon as it
+ *          is done, so that the memory does not grow with the file.
+ *
+ *    An image is held as one color index per pixel until it is written.
+ */
+
+#include <pthread.h>                   /* pthread_create(), pthread_join()    */
+#include <stdint.h>                    /* uint32_t                            */
+#include <stdio.h>                     /* FILE, fopen(), fwrite()             */
+#include <stdlib.h>                    /* atoi(), atof(), malloc(), exit()    */
+#include <string.h>                    /* strcmp(), strrchr()                 */
+#include <unistd.h>                    /* sysconf()                           */
+
+#include "hc-simd.h"                   /* hc_simd_level()                     */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "midi.h"                      /* midi_to_logf()                      */
+#include "spectrogram.h"               /* spg_columns_t, spg_render_t         */
+#include "VERSION.h"                   /* WAON_VERSION                        */
+
+/**
+ *    The columns a worker computes at a time.
+ */
+
+#define SPGC_BLOCK                     64
+
+/**
+ *    The most worker threads.
+ */
+
+#define SPGC_THREADS_MAX               64
+
+/**
+ *    The columns of a pass of the raw output, per thread.
+ */
+
+#define SPGC_PASS                      (16 * SPGC_BLOCK)
+
+/**
+ *    The largest stored deflate block.
+ */
+
+#define SPGC_DEFLATE_MAX               65535
+
+/**
+ *    Provides the output formats.
+ */
+
+typedef enum
+{
+   SPGC_FORMAT_PPM,
+   SPGC_FORMAT_PNG,
+   SPGC_FORMAT_RAW
+
+} spgc_format_t;
+
+/**
+ *    Holds the settings and the output of a run.
+ */
+
+typedef struct
+{
+   snd_cache_t * snd;      /*<< The samples of the input file.                */
+   spg_key_t key;          /*<< The FFT length, window, hop, and step.        */
+   spg_view_t view;        /*<< The display mode and ranges.                  */
+   int height;             /*<< The rows of the output.                       */
+   spgc_format_t format;
+   long first;             /*<< The column of the file of output column 0.    */
+   long columns;           /*<< The columns of the output.                    */
+   unsigned char * index;  /*<< [height][columns], the colors of an image.    */
+   float * raw;            /*<< [pass][height], the powers of a raw pass.     */
+   long pass_first;        /*<< The first output column of the pass.          */
+
+} spgc_job_t;
+
+/**
+ *    Holds a worker thread with its buffers.
+ */
+
+typedef struct
+{
+   spgc_job_t * job;
+   spg_columns_t * cols;
+   spg_render_t render;
+   float * amp2;           /*<< [SPGC_BLOCK][nbin]                            */
+   float * dphi;
+   double * column_amp2;   /*<< [nbin]                                        */
+   double * column_dphi;
+   double * value;         /*<< [height + 1]                                  */
+   long begin;             /*<< The output columns of this worker in the      */
+   long end;               /*<< pass, begin <= c < end.                       */
+   pthread_t thread;
+
+} spgc_worker_t;
+
+/**
+ *    Holds a PNG file while its image data are written.
+ */
+
+typedef struct
+{
+   FILE * out;
+   unsigned char * block;  /*<< [SPGC_DEFLATE_MAX], the pending bytes.        */
+   long len;               /*<< The pending bytes.                            */
+   uint32_t adler_a;       /*<< The Adler-32 of the uncompressed data.        */
+   uint32_t adler_b;
+   wbool_t started;        /*<< The zlib header was written.                  */
+
+} spgc_png_t;
+
+/**
+ *    The CRC-32 table of PNG, filled by spgc_crc_init().
+ */
+
+static uint32_t s_crc_table[256];
+
+/**
+ *    Fills the CRC-32 table.
+ */
+
+static void
+spgc_crc_init (void)
+{
+   uint32_t n;
+   for (n = 0; n < 256; ++n)
+   {
+      uint32_t c = n;
+      int k;
+      for (k = 0; k < 8; ++k)
+         c = (c & 1) ? 0xedb88320U ^ (c >> 1) : c >> 1;
+
+      s_crc_table[n] = c;
+   }
+}
+
+/**
+ *    Adds \a len bytes to a CRC-32 in progress, which starts at 0.
+ */
+
+static uint32_t
+spgc_crc (uint32_t crc, const unsigned char * p, long len)
+{
+   uint32_t c = crc ^ 0xffffffffU;
+   long i;
+   for (i = 0; i < len; ++i)
+      c = s_crc_table[(c ^ p[i]) & 0xff] ^ (c >> 8);
+
+   return c ^ 0xffffffffU;
+}
+
+/**
+ *    Writes a 32-bit big-endian value.
+ */
+
+static void
+spgc_put32 (unsigned char * p, uint32_t v)
+{
+   p[0] = (unsigned char) (v >> 24);
+   p[1] = (unsigned char) (v >> 16);
+   p[2] = (unsigned char) (v >> 8);
+   p[3] = (unsigned char) v;
+}
+
+/**
+ *    Writes a PNG chunk, whose data are \a head followed by \a data.
+ */
+
+static void
+spgc_png_chunk
+(
+   FILE * out,
+   const char * type,
+   const unsigned char * head,
+   long head_len,
+   const unsigned char * data,
+   long len
+)
+{
+   unsigned char b[4];
+   uint32_t crc = spgc_crc(0, (const unsigned char *) type, 4);
+   crc = spgc_crc(crc, head, head_len);
+   crc = spgc_crc(crc, data, len);
+   spgc_put32(b, (uint32_t) (head_len + len));
+   fwrite(b, 1, 4, out);
+   fwrite(type, 1, 4, out);
+   if (head_len > 0)
+      fwrite(head, 1, head_len, out);
+
+   if (len > 0)
+      fwrite(data, 1, len, out);
+
+   spgc_put32(b, crc);
+   fwrite(b, 1, 4, out);
+}
+
+/**
+ *    Writes the pending bytes as an IDAT chunk holding a stored deflate
+ *    block, after the zlib header if it is the first one.  The last one
+ *    ends with the Adler-32 of the data.
+ */
+
+static void
+spgc_png_flush (spgc_png_t * png, wbool_t last)
+{
+   unsigned char head[7];
+   long h = 0;
+   if (! png->started)
+   {
+      head[h++] = 0x78;                   /* deflate, 32K window          */
+      head[h++] = 0x01;                   /* no dictionary, fastest       */
+      png->started = wtrue;
+   }
+   head[h++] = last ? 1 : 0;              /* BFINAL, BTYPE 00 (stored)    */
+   head[h++] = (unsigned char) (png->len & 0xff);
+   head[h++] = (unsigned char) (png->len >> 8);
+   head[h++] = (unsigned char) (~png->len & 0xff);
+   head[h++] = (unsigned char) ((~png->len >> 8) & 0xff);
+   if (last)
+   {
+      unsigned char * p = png->block + png->len;
+      spgc_put32(p, (png->adler_b << 16) | png->adler_a);
+      spgc_png_chunk(png->out, "IDAT", head, h, png->block, png->len + 4);
+   }
+   else
+      spgc_png_chunk(png->out, "IDAT", head, h, png->block, png->len);
+
+   png->len = 0;
+}
+
+/**
+ *    Adds bytes to the image data of a PNG.
+ */
+
+static void
+spgc_png_write (spgc_png_t * png, const unsigned char * p, long len)
+{
+   long i;
+   for (i = 0; i < len; ++i)
+   {
+      png->adler_a = (png->adler_a + p[i]) % 65521U;
+      png->adler_b = (png->adler_b + png->adler_a) % 65521U;
+      png->block[png->len++] = p[i];
+      if (png->len == SPGC_DEFLATE_MAX)
+         spgc_png_flush(png, wfalse);
+   }
+}
+
+/**
+ *    Writes an image of color indices as a PNG with a palette.
+ */
+
+static void
+spgc_write_png
+(
+   FILE * out,
+   const unsigned char * index,
+   long width,
+   int height,
+   unsigned char palette[SPG_COLORS][3]
+)
+{
+   static const unsigned char s_signature[8] =
+   {
+      0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+   };
+   unsigned char ihdr[13];
+   unsigned char filter = 0;
+   spgc_png_t png;
+   int y;
+   spgc_crc_init();
+   fwrite(s_signature, 1, sizeof s_signature, out);
+   spgc_put32(ihdr, (uint32_t) width);
+   spgc_put32(ihdr + 4, (uint32_t) height);
+   ihdr[8] = 8;                           /* bit depth                    */
+   ihdr[9] = 3;                           /* indexed color                */
+   ihdr[10] = ihdr[11] = ihdr[12] = 0;    /* deflate, no filter, no lace  */
+   spgc_png_chunk(out, "IHDR", ihdr, sizeof ihdr, NULL, 0);
+   spgc_png_chunk(out, "PLTE", &palette[0][0], SPG_COLORS * 3, NULL, 0);
+
+   png.out = out;
+   png.block = (unsigned char *) malloc(SPGC_DEFLATE_MAX + 4);
+   CHECK_MALLOC(png.block, "spgc_write_png");
+   png.len = 0;
+   png.adler_a = 1;
+   png.adler_b = 0;
+   png.started = wfalse;
+   for (y = 0; y < height; ++y)
+   {
+      spgc_png_write(&png, &filter, 1);
+      spgc_png_write(&png, index + (long) y * width, width);
+   }
+   spgc_png_flush(&png, wtrue);
+   spgc_png_chunk(out, "IEND", NULL, 0, NULL, 0);
+   free(png.block);
+}
+
+/**
+ *    Writes an image of color indices as a binary PPM.
+ */
+
+static void
+spgc_write_ppm
+(
+   FILE * out,
+   const unsigned char * index,
+   long width,
+   int height,
+   unsigned char palette[SPG_COLORS][3]
+)
+{
+   unsigned char * row = (unsigned char *) malloc(3 * width);
+   int y;
+   CHECK_MALLOC(row, "spgc_write_ppm");
+   fprintf(out, "P6\n%ld %d\n255\n", width, height);
+   for (y = 0; y < height; ++y)
+   {
+      const unsigned char * p = index + (long) y * width;
+      long x;
+      for (x = 0; x < width; ++x)
+      {
+         row[3 * x] = palette[p[x]][0];
+         row[3 * x + 1] = palette[p[x]][1];
+         row[3 * x + 2] = palette[p[x]][2];
+      }
+      fwrite(row, 1, 3 * width, out);
+   }
+   free(row);
+}
+
+/**
+ *    Computes the output columns of a worker for the current pass.
+ */
+
+static void *
+spgc_worker (void * arg)
+{
+   spgc_worker_t * w = (spgc_worker_t *) arg;
+   spgc_job_t * job = w->job;
+   long nbin = job->key.fft_len / 2 + 1;
+   int height = job->height;
+   long c0;
+   spg_render_set(&w->render, &job->view, height, wtrue);
+   for (c0 = w->begin; c0 < w->end; c0 += SPGC_BLOCK)
+   {
+      long n = w->end - c0 < SPGC_BLOCK ? w->end - c0 : SPGC_BLOCK;
+      long j;
+      spg_columns_compute
+      (
+         w->cols, job->snd, &job->key, job->first + c0, n, w->amp2, w->dphi
+      );
+      for (j = 0; j < n; ++j)
+      {
+         long c = c0 + j;
+         long k;
+         int row;
+         for (k = 0; k < nbin; ++k)
+         {
+            w->column_amp2[k] = w->amp2[j * nbin + k];
+            if (job->key.hop > 0)
+               w->column_dphi[k] = w->dphi[j * nbin + k];
+         }
+         spg_render_column(&w->render, w->column_amp2, w->column_dphi,
+            w->value);
+
+         /*
+          * Row 0 is the bottom edge, under the panel of gwaonc.
+          */
+
+         if (not_nullptr(job->index))
+         {
+            for (row = 1; row <= height; ++row)
+            {
+               double v = w->value[row];
+               job->index[(long) (height - row) * job->columns + c] =
+                  v < 0.0 ? 0 : (unsigned char) spg_color_index(&w->render, v);
+            }
+         }
+         else
+         {
+            float * r = job->raw + (c - job->pass_first) * height;
+            for (row = 1; row <= height; ++row)
+            {
+               double v = w->value[row];
+               r[row - 1] = v < 0.0 ? 0.0f : (float) v;
+            }
+         }
+      }
+   }
+   return NULL;
+}
+
+/**
+ *    Prints the usage of the program.
+ */
+
+static void
+spgc_usage (const char * argv0)
+{
+   fprintf
+   (
+      stdout,
+      "WaoN-spgc - batch spectrogram renderer, Version %s\n\n"
+      "Usage: %s -i file [option ...]\n\n"
+      "  -i, --input file   The sound file to analyse.\n"
+      "  -o, --output file  The output, '-' for stdout [Default: -].\n"
+      "  -f, --format fmt   'ppm', 'png', or 'raw' [Default: from the\n"
+      "                     extension of the output, else ppm].\n"
+      "  -n len             FFT length [Default: 2048].\n"
+      "  -w, --window w     Window, 0 to 6 or a name as in waonc\n"
+      "                     [Default: 0, none, as in gwaonc].\n"
+      "  -step frames       Frames between two columns [Default: len/4].\n"
+      "  -hop frames        Phase-vocoder hop of modes 1 and 2\n"
+      "                     [Default: len/4].\n"
+      "  -mode m            0 power, 1 phase vocoder, 2 phase vocoder\n"
+      "                     averaged over each note [Default: 0].\n"
+      "  -height rows       Rows of the output [Default: 480].\n"
+      "  -oct-min o         Lowest octave, -1 to 8 [Default: 2].\n"
+      "  -oct-max o         Octave above the highest one [Default: 6].\n"
+      "  -amp-min a         log10 of the power of the first color\n"
+      "                     [Default: -3].\n"
+      "  -amp-max a         log10 of the power of the last color\n"
+      "                     [Default: 1].\n"
+      "  -start frame       First frame, rounded down to a multiple of the\n"
+      "                     step [Default: 0].\n"
+      "  -length frames     Frames to render [Default: to the end].\n"
+      "  -threads n         Worker threads [Default: the processors].\n"
+      "  -h, --help         Show this help.\n"
+      ,
+      WAON_VERSION,
+      argv0
+   );
+}
+
+int
+main (int argc, char * argv[])
+{
+   const char * file_in = NULL;
+   const char * file_out = "-";
+   const char * format = NULL;
+   long fft_len = 2048;
+   long step = 0;
+   long hop = 0;
+   int flag_window = FILTER_WINDOW_NONE;
+   int mode = 0;
+   int height = 480;
+   int oct_min = 2;
+   int oct_max = 6;
+   double amp_min = -3.0;
+   double amp_max = 1.0;
+   long start = 0;
+   long length = -1;
+   int threads = 0;
+   spgc_job_t job;
+   spgc_worker_t * worker;
+   unsigned char palette[SPG_COLORS][3];
+   FILE * out;
+   long nbin, frames, pass, c;
+   int i;
+   for (i = 1; i < argc; ++i)
+   {
+      const char * a = argv[i];
+      wbool_t more = i + 1 < argc;
+      if ((strcmp(a, "-i") == 0 || strcmp(a, "--input") == 0) && more)
+         file_in = argv[++i];
+      else if ((strcmp(a, "-o") == 0 || strcmp(a, "--output") == 0) && more)
+         file_out = argv[++i];
+      else if ((strcmp(a, "-f") == 0 || strcmp(a, "--format") == 0) && more)
+         format = argv[++i];
+      else if (strcmp(a, "-n") == 0 && more)
+         fft_len = atol(argv[++i]);
+      else if ((strcmp(a, "-w") == 0 || strcmp(a, "--window") == 0) && more)
+      {
+         const char * w = argv[++i];
+         flag_window = (w[0] >= '0' && w[0] <= '9') ?
+            atoi(w) : (int) fft_window_value(w);
+      }
+      else if (strcmp(a, "-step") == 0 && more)
+         step = atol(argv[++i]);
+      else if (strcmp(a, "-hop") == 0 && more)
+         hop = atol(argv[++i]);
+      else if (strcmp(a, "-mode") == 0 && more)
+         mode = atoi(argv[++i]);
+      else if (strcmp(a, "-height") == 0 && more)
+         height = atoi(argv[++i]);
+      else if (strcmp(a, "-oct-min") == 0 && more)
+         oct_min = atoi(argv[++i]);
+      else if (strcmp(a, "-oct-max") == 0 && more)
+         oct_max = atoi(argv[++i]);
+      else if (strcmp(a, "-amp-min") == 0 && more)
+         amp_min = atof(argv[++i]);
+      else if (strcmp(a, "-amp-max") == 0 && more)
+         amp_max = atof(argv[++i]);
+      else if (strcmp(a, "-start") == 0 && more)
+         start = atol(argv[++i]);
+      else if (strcmp(a, "-length") == 0 && more)
+         length = atol(argv[++i]);
+      else if (strcmp(a, "-threads") == 0 && more)
+         threads = atoi(argv[++i]);
+      else
+      {
+         spgc_usage(argv[0]);
+         exit(strcmp(a, "-h") == 0 || strcmp(a, "--help") == 0 ? 0 : 1);
+      }
+   }
+   if (step <= 0)
+      step = fft_len / 4;
+
+   if (hop <= 0)
+      hop = fft_len / 4;
+
+   if (is_nullptr(format))
+   {
+      const char * dot = strrchr(file_out, '.');
+      format = not_nullptr(dot) ? dot + 1 : "ppm";
+   }
+   if (strcmp(format, "png") == 0)
+      job.format = SPGC_FORMAT_PNG;
+   else if (strcmp(format, "raw") == 0 || strcmp(format, "f32") == 0)
+      job.format = SPGC_FORMAT_RAW;
+   else
+      job.format = SPGC_FORMAT_PPM;
+
+   if (is_nullptr(file_in) || fft_len < 16 || step <= 0 || height < 1 ||
+         mode < 0 || mode > 2 || oct_min < -1 || oct_max > 9 ||
+         oct_min >= oct_max || amp_min >= amp_max || flag_window < 0 ||
+         flag_window >= FILTER_WINDOW_MAX || start < 0)
+   {
+      spgc_usage(argv[0]);
+      exit(1);
+   }
+   job.snd = snd_cache_open(file_in);
+   if (is_nullptr(job.snd))
+   {
+      errprintf("? cannot open %s\n", file_in);
+      exit(1);
+   }
+   frames = (long) job.snd->sfinfo.frames;
+   if (length < 0 || start + length > frames)
+      length = frames > start ? frames - start : 0;
+
+   job.key.fft_len = fft_len;
+   job.key.hop = mode == 0 ? 0 : hop;
+   job.key.flag_window = flag_window;
+   job.key.step = step;
+   job.view.mode = (spg_mode_t) mode;
+   job.view.fft_len = fft_len;
+   job.view.samplerate = job.snd->sfinfo.samplerate;
+   job.view.logf_min = midi_to_logf((oct_min + 1) * 12);
+   job.view.logf_max = midi_to_logf((oct_max + 1) * 12);
+   job.view.amp2_min = amp_min;
+   job.view.amp2_max = amp_max;
+   job.view.octave_removal_factor = 0.0;
+   job.height = height;
+   job.first = start / step;
+   job.columns = (length + step - 1) / step;
+   if (job.columns < 1)
+      job.columns = 1;
+
+   if (threads <= 0)
+      threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+   if (threads < 1)
+      threads = 1;
+   else if (threads > SPGC_THREADS_MAX)
+      threads = SPGC_THREADS_MAX;
+
+   /*
+    * An image is held whole, in one pass; a raw output in passes.
+    */
+
+   job.index = NULL;
+   job.raw = NULL;
+   if (job.format == SPGC_FORMAT_RAW)
+   {
+      pass = (long) threads * SPGC_PASS;
+      job.raw = (float *) malloc(sizeof(float) * pass * height);
+      CHECK_MALLOC(job.raw, "main");
+   }
+   else
+   {
+      pass = job.columns;
+      job.index = (unsigned char *) malloc((size_t) job.columns * height);
+      CHECK_MALLOC(job.index, "main");
+   }
+   if (strcmp(file_out, "-") == 0)
+      out = stdout;
+   else
+      out = fopen(file_out, "wb");
+
+   if (is_nullptr(out))
+   {
+      errprintf("? cannot write %s\n", file_out);
+      exit(1);
+   }
+
+   /*
+    * The plans are made here, as the FFTW planner is not thread-safe.
+    */
+
+   (void) hc_simd_level();
+   nbin = fft_len / 2 + 1;
+   worker = (spgc_worker_t *) malloc(sizeof(spgc_worker_t) * threads);
+   CHECK_MALLOC(worker, "main");
+   for (i = 0; i < threads; ++i)
+   {
+      spgc_worker_t * w = &worker[i];
+      w->job = &job;
+      w->cols = spg_columns_new(fft_len, DEFAULT_FFT_BATCH);
+      spg_render_init(&w->render);
+      w->amp2 = (float *) malloc(sizeof(float) * SPGC_BLOCK * nbin);
+      w->dphi = (float *) malloc(sizeof(float) * SPGC_BLOCK * nbin);
+      w->column_amp2 = (double *) malloc(sizeof(double) * nbin);
+      w->column_dphi = (double *) calloc(nbin, sizeof(double));
+      w->value = (double *) malloc(sizeof(double) * (height + 1));
+      CHECK_MALLOC(w->amp2, "main");
+      CHECK_MALLOC(w->dphi, "main");
+      CHECK_MALLOC(w->column_amp2, "main");
+      CHECK_MALLOC(w->column_dphi, "main");
+      CHECK_MALLOC(w->value, "main");
+   }
+   fprintf
+   (
+      stderr, "# spgc: %ld columns x %d rows, %d thread(s)\n",
+      job.columns, height, threads
+   );
+   for (c = 0; c < job.columns; c += pass)
+   {
+      long n = job.columns - c < pass ? job.columns - c : pass;
+      long share = (n + threads - 1) / threads;
+      job.pass_first = c;
+      for (i = 0; i < threads; ++i)
+      {
+         spgc_worker_t * w = &worker[i];
+         w->begin = c + i * share;
+         w->end = w->begin + share;
+         if (w->end > c + n)
+            w->end = c + n;
+
+         if (w->begin < w->end &&
+               pthread_create(&w->thread, NULL, spgc_worker, w) != 0)
+         {
+            spgc_worker(w);                  /* no thread, do it here    */
+            w->end = w->begin;
+         }
+      }
+      for (i = 0; i < threads; ++i)
+      {
+         if (worker[i].begin < worker[i].end)
+            pthread_join(worker[i].thread, NULL);
+      }
+      if (not_nullptr(job.raw))
+         fwrite(job.raw, sizeof(float), (size_t) n * height, out);
+   }
+   spg_colormap(palette);
+   if (job.format == SPGC_FORMAT_PNG)
+      spgc_write_png(out, job.index, job.columns, height, palette);
+   else if (job.format == SPGC_FORMAT_PPM)
+      spgc_write_ppm(out, job.index, job.columns, height, palette);
+
+   if (out != stdout)
+      fclose(out);
+
+   for (i = 0; i < threads; ++i)
+   {
+      spgc_worker_t * w = &worker[i];
+      spg_columns_free(w->cols);
+      spg_render_free(&w->render);
+      free(w->amp2);
+      free(w->dphi);
+      free(w->column_amp2);
+      free(w->column_dphi);
+      free(w->value);
+   }
+   free(worker);
+   free(job.index);
+   free(job.raw);
+   snd_cache_close(job.snd);
+   return 0;
+}
+
+/*
+ * spgc.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -33,7 +33,6 @@
  */
 
 #include "analyse.h"                   /* note_intensity(), note_on_off(), ...*/
-#include "midi.h"                      /* g_midi_pitch_info NEW NEW NEW       */
 #include "parameters.h"                /* waon_parameters_t                   */
 #include "processing.h"                /* processing()                        */
 
@@ -68,12 +67,9 @@ main (int argc, char * argv [])
    if (result)
    {
        analysis_scratchpad.absolute_cutoff = waon_parameters.abs_flg;
+       analysis_scratchpad.adj_pitch = waon_parameters.adj_pitch;
        if (not_nullptr(waon_parameters.file_patch))
           analysis_scratchpad.use_patchfile = wtrue;
-
-       /* NEW as of 12-01 */
-
-       g_midi_pitch_info.mp_adj_pitch = waon_parameters.adj_pitch;
    }
    if (waon_parameters.show_help)
    {
@@ -90,6 +86,9 @@ main (int argc, char * argv [])
       parse_good = processing(&waon_parameters, &analysis_scratchpad);
       parameters_free(&waon_parameters);
    }
+   else if (! result)
+      parse_good = wfalse;
+
    return parse_good ? 0 : 1 ;
 }
 
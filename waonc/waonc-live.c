@@ -0,0 +1,694 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : live transcription over JACK
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          waonc-live.c
+ *
+ *    This program transcribes a JACK audio input to note-on and note-off
+ *    events on a JACK MIDI output, as they are decided.
+ *
+ * \library       waonc-live application
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The analysis is the one of waonc (see live.h), with the same options
+ *    (-n, -s, -c, -r, -k, -t, -b, ...).  Three threads hand the data on
+ *    through lock-free rings, and none of them waits on another:
+ *
+ *       -  The JACK process callback copies the input into the capture
+ *          ring, and writes the MIDI events waiting in the event ring to
+ *          the output port.  It neither allocates nor does I/O.
+ *       -  The worker analyses each hop of the capture ring and puts the
+ *          events of the frame in the event ring, stamped with the time
+ *          the last sample of the frame came in.
+ *       -  The main thread reports the latency every few seconds, from
+ *          a snapshot of the statistics of the callback, which the
+ *          callback puts in the report ring when the last one is taken.
+ *
+ *    The latency of an event is the time from the sound at the middle of
+ *    its frame to the MIDI output:
+ *
+ *       -  capture:  the latency of the input port.
+ *       -  frame:  half of the FFT frame.
+ *       -  analysis:  from the last sample of the frame to the start of
+ *          the period in which the event is sent, as measured.
+ *       -  output:  the latency of the MIDI port.
+ *
+ *    To try it without a sound card:
+ *
+\verbatim
+      jackd -d dummy -r 48000 -p 256 &
+      waonc-live -n 2048 -s 256 --midi midi-monitor:input &
+      jack_midi_dump &
+      sndfile-jackplay test.wav    (then connect it to waonc-live:input)
+\endverbatim
+ *
+ *    waonc/test_live_script does so with test-files/a440.wav, and checks
+ *    the notes.
+ */
+
+#include <pthread.h>                   /* pthread_create(), pthread_join()    */
+#include <signal.h>                    /* signal(), SIGINT, SIGTERM           */
+#include <stdio.h>                     /* fprintf()                           */
+#include <stdlib.h>                    /* malloc(), free()                    */
+#include <string.h>                    /* memset(), strcmp()                  */
+#include <unistd.h>                    /* usleep(), sleep()                   */
+
+#include <jack/jack.h>                 /* jack_client_t, jack_port_t          */
+#include <jack/midiport.h>             /* jack_midi_event_write()             */
+#include <jack/ringbuffer.h>           /* jack_ringbuffer_t                   */
+
+#include "jack-client.h"               /* waon_jack_open()                    */
+#include "live.h"                      /* waon_live_t, live_notes_check()     */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "parameters.h"                /* waon_parameters_t                   */
+
+/**
+ *    The samples between the process callback and the worker (JACK rounds
+ *    it up to a power of two).  At 48 kHz, 32768 samples are 0.68 second,
+ *    which fill up only while the worker stalls.
+ */
+
+#define WAONC_LIVE_CAPTURE_RING        32768
+
+/**
+ *    The MIDI messages between the worker and the process callback.
+ */
+
+#define WAONC_LIVE_EVENT_RING          1024
+
+/**
+ *    The snapshots of the statistics of the process callback:  the ring
+ *    has room for one, which the report takes.
+ */
+
+#define WAONC_LIVE_REPORT_RING         (2 * sizeof(live_stats_t))
+
+/**
+ *    The sleep of the worker while a hop is not captured yet [usec].
+ */
+
+#define WAONC_LIVE_SLEEP               1000
+
+/**
+ *    The period of the latency report [sec].
+ */
+
+#define WAONC_LIVE_REPORT              5
+
+/**
+ *    The velocities of the note-on and note-off thresholds, as in waonc.
+ */
+
+#define WAONC_LIVE_ON_THRESHOLD        8
+#define WAONC_LIVE_OFF_THRESHOLD       0
+
+/**
+ *    Holds a MIDI message in the event ring.
+ */
+
+typedef struct
+{
+   jack_time_t t_capture;  /*<< The last sample of the frame came in [usec].  */
+   jack_midi_data_t data[3]; /*<< The note-on or note-off message.            */
+
+} live_message_t;
+
+/**
+ *    Holds the statistics of the process callback, which the report gets
+ *    as a whole through the report ring.
+ */
+
+typedef struct
+{
+   unsigned long sent;     /*<< The messages sent.                            */
+   double us_sum;          /*<< Their analysis latency [usec].                */
+   double us_max;          /*<< The worst of them [usec].                     */
+   unsigned long overruns; /*<< Cycles lost on a full capture ring.           */
+
+} live_stats_t;
+
+/**
+ *    Holds the JACK client, the rings, and the statistics.  Each counter
+ *    has one writer; the report reads those of the worker without a lock,
+ *    and may be a cycle out of date.
+ */
+
+typedef struct
+{
+   jack_client_t * client;
+   jack_port_t * in;                   /*<< The audio input.                  */
+   jack_port_t * out;                  /*<< The MIDI output.                  */
+   jack_nframes_t samplerate;
+   waon_live_t * live;
+   int peak_threshold;                 /*<< See WAON_notes_check().           */
+   jack_ringbuffer_t * capture;        /*<< Samples, from the callback.       */
+   jack_ringbuffer_t * messages;       /*<< live_message_t, from the worker.  */
+   jack_ringbuffer_t * reports;        /*<< live_stats_t, from the callback.  */
+   float * hop;                        /*<< [live->hop], of the worker.       */
+   pthread_t worker;
+   wbool_t worker_started;
+   volatile wbool_t flag_exit;         /*<< The worker stops.                 */
+   volatile wbool_t flag_server;       /*<< False if the server went away.    */
+
+   /* Written by the process callback only. */
+
+   volatile unsigned long frames_in;   /*<< Samples put in the capture ring.  */
+   volatile jack_time_t t_cycle;       /*<< The last input sample came in.    */
+   live_stats_t stats;                 /*<< Read only through the reports.    */
+
+   /* Written by the worker only. */
+
+   volatile unsigned long frames;      /*<< The frames analysed.              */
+   volatile unsigned long dropped;     /*<< Messages lost on a full ring.     */
+
+   /* Used by the main thread only. */
+
+   live_stats_t report;                /*<< The last snapshot of the stats.   */
+
+} live_daemon_t;
+
+/**
+ *    Set by the signal handler to stop the program.
+ */
+
+static volatile sig_atomic_t s_stop = 0;
+
+/**
+ *    The signal handler for SIGINT and SIGTERM.
+ */
+
+static void
+live_signal (int sig)
+{
+   s_stop = 1;
+}
+
+/**
+ *    The process callback, in the real-time thread of JACK.  It copies the
+ *    input into the capture ring, or counts the cycle lost if the worker is
+ *    that far behind, and sends the messages that are ready at the start
+ *    of the period.  A message the MIDI buffer has no room for waits for
+ *    the next cycle.  Then it puts a snapshot of its statistics in the
+ *    report ring, if the last one was taken.
+ */
+
+static int
+live_process (jack_nframes_t nframes, void * arg)
+{
+   live_daemon_t * ld = (live_daemon_t *) arg;
+   const jack_default_audio_sample_t * in =
+      (const jack_default_audio_sample_t *)
+         jack_port_get_buffer(ld->in, nframes);
+   void * out = jack_port_get_buffer(ld->out, nframes);
+   size_t len = sizeof(jack_default_audio_sample_t) * nframes;
+   jack_nframes_t frame = jack_last_frame_time(ld->client);
+   jack_time_t t_out = jack_frames_to_time(ld->client, frame + nframes);
+   live_message_t m;
+   if (jack_ringbuffer_write_space(ld->capture) < len)
+      ++ld->stats.overruns;
+   else
+   {
+      jack_ringbuffer_write(ld->capture, (const char *) in, len);
+      ld->frames_in += nframes;
+   }
+   ld->t_cycle = jack_frames_to_time(ld->client, frame);
+
+   jack_midi_clear_buffer(out);
+   while (jack_ringbuffer_read_space(ld->messages) >= sizeof m)
+   {
+      double us;
+      jack_ringbuffer_peek(ld->messages, (char *) &m, sizeof m);
+      if (jack_midi_event_write(out, 0, m.data, sizeof m.data) != 0)
+         break;
+
+      jack_ringbuffer_read_advance(ld->messages, sizeof m);
+      us = (double) (t_out - m.t_capture);
+      ld->stats.us_sum += us;
+      if (us > ld->stats.us_max)
+         ld->stats.us_max = us;
+
+      ++ld->stats.sent;
+   }
+   if (jack_ringbuffer_write_space(ld->reports) >= sizeof ld->stats)
+   {
+      jack_ringbuffer_write
+      (
+         ld->reports, (const char *) &ld->stats, sizeof ld->stats
+      );
+   }
+   return 0;
+}
+
+/**
+ *    Called by JACK when the server goes away.
+ */
+
+static void
+live_shutdown (void * arg)
+{
+   live_daemon_t * ld = (live_daemon_t *) arg;
+   ld->flag_server = wfalse;
+}
+
+/**
+ *    Puts the events of a frame in the event ring, or counts them lost if
+ *    the callback is that far behind.
+ */
+
+static void
+live_send
+(
+   live_daemon_t * ld,
+   const waon_live_event_t * events,
+   int count,
+   jack_time_t t_capture
+)
+{
+   int e;
+   for (e = 0; e < count; ++e)
+   {
+      live_message_t m;
+      m.t_capture = t_capture;
+      m.data[0] = events[e].event == MIDI_EVENT_NOTE_ON ? 0x90 : 0x80;
+      m.data[1] = (jack_midi_data_t) events[e].note;
+      m.data[2] = (jack_midi_data_t) events[e].vel;
+      if (jack_ringbuffer_write_space(ld->messages) < sizeof m)
+         ++ld->dropped;
+      else
+         jack_ringbuffer_write(ld->messages, (const char *) &m, sizeof m);
+   }
+}
+
+/**
+ *    The worker.  A hop at a time, it analyses the frame and sends its
+ *    events.  At the exit, it stops the sounding notes.
+ */
+
+static void *
+live_worker (void * arg)
+{
+   live_daemon_t * ld = (live_daemon_t *) arg;
+   waon_live_t * live = ld->live;
+   size_t len_hop = sizeof(float) * live->hop;
+   unsigned long frames_read = 0;
+   waon_live_event_t events[LIVE_EVENTS_MAX];
+   int count;
+   while (! ld->flag_exit)
+   {
+      jack_time_t t_capture;
+      long behind;
+      if (jack_ringbuffer_read_space(ld->capture) < len_hop)
+      {
+         usleep(WAONC_LIVE_SLEEP);
+         continue;
+      }
+      jack_ringbuffer_read(ld->capture, (char *) ld->hop, len_hop);
+      frames_read += live->hop;
+
+      /*
+       * The last sample of the frame came in as many samples before the
+       * last cycle as there are still in the ring (frames_in may lag the
+       * ring by a cycle).
+       */
+
+      behind = (long) (ld->frames_in - frames_read);
+      if (behind < 0)
+         behind = 0;
+
+      t_capture = ld->t_cycle -
+         (jack_time_t) (1.0e6 * (double) behind / (double) ld->samplerate);
+
+      live_step(live, ld->hop);
+      count = live_notes_check
+      (
+         live, WAONC_LIVE_ON_THRESHOLD, WAONC_LIVE_OFF_THRESHOLD,
+         ld->peak_threshold, events
+      );
+      live_send(ld, events, count, t_capture);
+      ++ld->frames;
+   }
+   count = live_notes_off(live, events);
+   live_send(ld, events, count, jack_get_time());
+   return nullptr;
+}
+
+/**
+ *    Takes a fresh snapshot of the statistics of the callback into
+ *    ld->report.  The snapshot waiting in the report ring is taken, which
+ *    lets the callback put the next one, which is waited for for two
+ *    periods at most.  If it does not come (the server is gone), the one
+ *    taken stands.
+ */
+
+static void
+live_snapshot (live_daemon_t * ld)
+{
+   size_t size = sizeof ld->report;
+   useconds_t wait = 0;
+   useconds_t most = 0;
+   if (ld->flag_server)
+   {
+      jack_nframes_t period = jack_get_buffer_size(ld->client);
+      most = (useconds_t) (2.0e6 * period / ld->samplerate) + 1000;
+   }
+   while (jack_ringbuffer_read_space(ld->reports) >= size)
+      jack_ringbuffer_read(ld->reports, (char *) &ld->report, size);
+
+   while (jack_ringbuffer_read_space(ld->reports) < size && wait < most)
+   {
+      usleep(WAONC_LIVE_SLEEP);
+      wait += WAONC_LIVE_SLEEP;
+   }
+   if (jack_ringbuffer_read_space(ld->reports) >= size)
+      jack_ringbuffer_read(ld->reports, (char *) &ld->report, size);
+}
+
+/**
+ *    Reports the latency of the messages sent since the last report, and
+ *    the worst one so far.
+ *
+ * \param ld
+ *    Provides the daemon.
+ *
+ * \param last
+ *    Provides and receives the statistics of the last report.
+ */
+
+static void
+live_report (live_daemon_t * ld, live_stats_t * last)
+{
+   jack_latency_range_t range;
+   double ms_capture, ms_output;
+   double ms_frame = 1.0e3 * 0.5 * (double) ld->live->fft_len /
+      (double) ld->samplerate;
+
+   unsigned long n;
+   double ms_analysis;
+   double ms_fixed;
+   live_snapshot(ld);
+   n = ld->report.sent - last->sent;
+   ms_analysis = n > 0 ?
+      1.0e-3 * (ld->report.us_sum - last->us_sum) / n : 0.0;
+
+   jack_port_get_latency_range(ld->in, JackCaptureLatency, &range);
+   ms_capture = 1.0e3 * (double) range.max / (double) ld->samplerate;
+   jack_port_get_latency_range(ld->out, JackPlaybackLatency, &range);
+   ms_output = 1.0e3 * (double) range.max / (double) ld->samplerate;
+   ms_fixed = ms_capture + ms_frame + ms_output;
+   fprintf
+   (
+      stderr,
+      "latency %.1f ms (max %.1f) = capture %.1f + frame %.1f"
+      " + analysis %.1f + output %.1f; %lu events, %lu frames,"
+      " %lu overruns, %lu dropped\n",
+      ms_fixed + ms_analysis, ms_fixed + 1.0e-3 * ld->report.us_max,
+      ms_capture, ms_frame, ms_analysis, ms_output,
+      n, ld->frames, ld->report.overruns, ld->dropped
+   );
+   *last = ld->report;
+}
+
+/**
+ *    Stops the threads, in the order of the data, and frees everything.
+ *    The worker stops first, so that the callback can still send the
+ *    note-offs of the sounding notes before the client is closed.
+ */
+
+static void
+live_daemon_free (live_daemon_t * ld)
+{
+   if (ld->worker_started)
+   {
+      ld->flag_exit = wtrue;
+      pthread_join(ld->worker, nullptr);
+      if (ld->flag_server)
+      {
+         jack_nframes_t period = jack_get_buffer_size(ld->client);
+         usleep((useconds_t) (2.0e6 * period / ld->samplerate) + 1000);
+      }
+   }
+   if (not_nullptr(ld->client))
+      jack_client_close(ld->client);      /* no more callbacks                */
+
+   if (not_nullptr(ld->capture))
+      jack_ringbuffer_free(ld->capture);
+
+   if (not_nullptr(ld->messages))
+      jack_ringbuffer_free(ld->messages);
+
+   if (not_nullptr(ld->reports))
+      jack_ringbuffer_free(ld->reports);
+
+   live_free(ld->live);
+   free(ld->hop);
+   free(ld);
+}
+
+/**
+ *    Starts the JACK client and the worker, and connects the ports.
+ *
+ * \param parameters
+ *    Provides the analysis options.
+ *
+ * \param scratchpad
+ *    Provides the cutoff flag and the patch.
+ *
+ * \param port_in
+ *    The port to take the input from, or null for the first physical
+ *    capture port.
+ *
+ * \param port_midi
+ *    The port to send the MIDI to, or null for none.
+ *
+ * \return
+ *    Returns the daemon, or null if JACK cannot be used.
+ */
+
+static live_daemon_t *
+live_daemon_init
+(
+   const waon_parameters_t * parameters,
+   const analysis_scratchpad_t * scratchpad,
+   const char * port_in,
+   const char * port_midi
+)
+{
+   live_daemon_t * ld = (live_daemon_t *) calloc(1, sizeof(live_daemon_t));
+   CHECK_MALLOC(ld, "live_daemon_init");
+   ld->flag_server = wtrue;
+   ld->peak_threshold = parameters->peak_threshold;
+   ld->client = waon_jack_open("waonc-live");
+   if (is_nullptr(ld->client))
+   {
+      live_daemon_free(ld);
+      return nullptr;
+   }
+   ld->samplerate = jack_get_sample_rate(ld->client);
+   ld->live = live_create(parameters, scratchpad, (int) ld->samplerate);
+   ld->hop = (float *) malloc(sizeof(float) * ld->live->hop);
+   CHECK_MALLOC(ld->hop, "live_daemon_init");
+
+   /*
+    * The rings, locked in memory, and the worker to read the first, before
+    * the process callback starts.
+    */
+
+   ld->capture = jack_ringbuffer_create
+   (
+      sizeof(jack_default_audio_sample_t) * WAONC_LIVE_CAPTURE_RING
+   );
+   ld->messages = jack_ringbuffer_create
+   (
+      sizeof(live_message_t) * WAONC_LIVE_EVENT_RING
+   );
+   ld->reports = jack_ringbuffer_create(WAONC_LIVE_REPORT_RING);
+   CHECK_MALLOC(ld->capture, "live_daemon_init");
+   CHECK_MALLOC(ld->messages, "live_daemon_init");
+   CHECK_MALLOC(ld->reports, "live_daemon_init");
+   jack_ringbuffer_mlock(ld->capture);
+   jack_ringbuffer_mlock(ld->messages);
+   jack_ringbuffer_mlock(ld->reports);
+   if (pthread_create(&ld->worker, nullptr, live_worker, ld) != 0)
+   {
+      fprintf(stderr, "cannot start the worker thread\n");
+      live_daemon_free(ld);
+      return nullptr;
+   }
+   ld->worker_started = wtrue;
+   jack_set_process_callback(ld->client, live_process, ld);
+   jack_on_shutdown(ld->client, live_shutdown, ld);
+   ld->in = jack_port_register
+   (
+      ld->client, "input", JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0
+   );
+   ld->out = jack_port_register
+   (
+      ld->client, "midi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0
+   );
+   if (is_nullptr(ld->in) || is_nullptr(ld->out))
+   {
+      fprintf(stderr, "no more JACK ports available\n");
+      live_daemon_free(ld);
+      return nullptr;
+   }
+   if (jack_activate(ld->client) != 0)
+   {
+      fprintf(stderr, "cannot activate client\n");
+      live_daemon_free(ld);
+      return nullptr;
+   }
+   if (is_nullptr(port_in))
+      (void) waon_jack_connect_physical(ld->client, ld->in, wfalse);
+   else if (jack_connect(ld->client, port_in, jack_port_name(ld->in)) != 0)
+      fprintf(stderr, "cannot connect %s to the input\n", port_in);
+
+   if (not_nullptr(port_midi))
+   {
+      if (jack_connect(ld->client, jack_port_name(ld->out), port_midi) != 0)
+         fprintf(stderr, "cannot connect the MIDI output to %s\n", port_midi);
+   }
+   fprintf
+   (
+      stderr, "waonc-live: %u Hz, N = %ld, H = %ld\n",
+      (unsigned) ld->samplerate, ld->live->fft_len, ld->live->hop
+   );
+   return ld;
+}
+
+/**
+ *    Prints the options of waonc-live, then the ones of the analysis.
+ */
+
+static void
+live_usage (void)
+{
+   fprintf
+   (
+      stdout,
+      "waonc-live transcribes a JACK input to a JACK MIDI output.\n"
+      "\n"
+      "Usage: waonc-live [--input port] [--midi port] [option ...]\n"
+      "\n"
+      "  --input port      Take the input from this port, instead of the\n"
+      "                    first physical capture port.\n"
+      "  --midi port       Send the MIDI events to this port.\n"
+      "\n"
+      "The options of the analysis are the ones of waonc; the file options\n"
+      "are ignored.\n"
+      "\n"
+   );
+   print_usage();
+}
+
+/**
+ *    Provides the entry-point for the waonc-live program.  The options of
+ *    waonc-live are taken out of the command line, and the rest is parsed
+ *    as the options of waonc.
+ *
+ * @param argc
+ *    Provides the standard count of the number of command-line arguments,
+ *    including the name of the program.
+ *
+ * @param argv
+ *    Provides the command-line arguments as an array of pointers.
+ *
+ * @return
+ *    Returns a 0 value if the application succeeds, and a non-zero value
+ *    otherwise.
+ */
+
+int
+main (int argc, char * argv [])
+{
+   waon_parameters_t parameters;
+   analysis_scratchpad_t scratchpad;
+   const char * port_in = nullptr;
+   const char * port_midi = nullptr;
+   live_daemon_t * ld;
+   live_stats_t last;
+   int seconds = 0;
+   int argn = 1;
+   int i;
+   char ** args = (char **) malloc(sizeof(char *) * (argc + 1));
+   CHECK_MALLOC(args, "main");
+   args[0] = argv[0];
+   for (i = 1; i < argc; ++i)
+   {
+      if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+         port_in = argv[++i];
+      else if (strcmp(argv[i], "--midi") == 0 && i + 1 < argc)
+         port_midi = argv[++i];
+      else
+         args[argn++] = argv[i];
+   }
+   args[argn] = nullptr;
+   if (! parameters_initialize(&parameters))
+      return 1;
+
+   if (! parameters_parse(&parameters, argn, args) || parameters.show_help)
+   {
+      live_usage();
+      return 1;
+   }
+   if (parameters.show_version)
+   {
+      print_version();
+      return 0;
+   }
+   if (! analysis_scratchpad_initialize(&scratchpad))
+      return 1;
+
+   scratchpad.absolute_cutoff = parameters.abs_flg;
+   scratchpad.adj_pitch = parameters.adj_pitch;
+   init_patch
+   (
+      parameters.file_patch, parameters.fft_len,
+      (filter_window_t) parameters.flag_window, &scratchpad
+   );
+   ld = live_daemon_init(&parameters, &scratchpad, port_in, port_midi);
+   parameters_free(&parameters);
+   free(args);
+   if (is_nullptr(ld))
+      return 1;
+
+   memset(&last, 0, sizeof last);
+   signal(SIGINT, live_signal);
+   signal(SIGTERM, live_signal);
+   while (! s_stop && ld->flag_server)
+   {
+      sleep(1);
+      if (++seconds % WAONC_LIVE_REPORT == 0)
+         live_report(ld, &last);
+   }
+   if (! ld->flag_server)
+      fprintf(stderr, "the JACK server is gone\n");
+
+   live_report(ld, &last);
+   live_daemon_free(ld);
+   return 0;
+}
+
+/*
+ * waonc-live.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
@@ -0,0 +1,581 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : client of the transcription server
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          waoncd-client.c
+ *
+ *    This program sends a sound to waoncd, once or many times at once,
+ *    and reports the latency and the throughput.
+ *
+ * \library       waoncd application
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The sound is read once, and each of the -c threads sends it until -n
+ *    requests are done.  The latency of a request is measured from the
+ *    connect() to the end of the response.  The report gives its
+ *    percentiles over the requests served, and the means of the times the
+ *    server gave in its responses.  With -o, the SMF of the first request
+ *    served is saved, e.g. to compare it with the output of waonc.
+ *
+\verbatim
+      waoncd-client -O "-n 4096 -s 1024" -o test.mid test.wav
+      waoncd-client -c 16 -n 1000 --raw 44100 1 test.raw
+\endverbatim
+ */
+
+#include <errno.h>                     /* errno                               */
+#include <pthread.h>                   /* pthread_create(), pthread_join()    */
+#include <signal.h>                    /* signal(), SIGPIPE                   */
+#include <stdio.h>                     /* fprintf(), fopen()                  */
+#include <stdlib.h>                    /* malloc(), qsort(), atoi()           */
+#include <string.h>                    /* strcmp(), strlen()                  */
+#include <sys/socket.h>                /* socket(), connect()                 */
+#include <sys/un.h>                    /* struct sockaddr_un                  */
+#include <time.h>                      /* clock_gettime()                     */
+#include <unistd.h>                    /* read(), write(), close()            */
+
+#include "macros.h"                    /* nullptr, wbool_t, errprint()        */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "waoncd.h"                    /* waoncd_request_t, the protocol      */
+
+/**
+ *    The statuses of the requests that got no response.
+ */
+
+#define CLIENT_NO_SERVER               100   /* connect() failed            */
+#define CLIENT_LOST                    101   /* the response was cut short  */
+
+/**
+ *    The largest SMF or message taken from the server.
+ */
+
+#define CLIENT_PAYLOAD_MAX             (64 * 1024 * 1024)
+
+/**
+ *    Holds the outcome of a request.
+ */
+
+typedef struct
+{
+   uint32_t status;        /*<< WAONCD_OK, an error, or CLIENT_LOST, ...      */
+   uint64_t us_latency;    /*<< From the connect() to the end of the response.*/
+   waoncd_response_t response;
+
+} client_result_t;
+
+/**
+ *    Holds the request to repeat, and the outcomes.  The counter and the
+ *    saving of the SMF are guarded by the lock.
+ */
+
+typedef struct
+{
+   struct sockaddr_un addr;            /*<< The socket of the server.         */
+   waoncd_request_t request;
+   const char * options;
+   const char * audio;
+   const char * file_midi;             /*<< Where to save an SMF, or null.    */
+   wbool_t saved;
+   char * message;                     /*<< The first error of the server.    */
+   pthread_mutex_t lock;
+   int next;                           /*<< The next request to send.         */
+   int count;                          /*<< The requests to send.             */
+   client_result_t * results;          /*<< [count].                          */
+
+} client_t;
+
+/**
+ *    Gets the time of a monotonic clock [usec].
+ */
+
+static uint64_t
+client_now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+/**
+ *    Reads exactly len bytes from a socket.
+ */
+
+static wbool_t
+client_read (int fd, void * buffer, size_t len)
+{
+   char * p = (char *) buffer;
+   while (len > 0)
+   {
+      ssize_t n = read(fd, p, len);
+      if (n < 0 && errno == EINTR)
+         continue;
+
+      if (n <= 0)
+         return wfalse;
+
+      p += n;
+      len -= (size_t) n;
+   }
+   return wtrue;
+}
+
+/**
+ *    Writes exactly len bytes to a socket.
+ */
+
+static wbool_t
+client_write (int fd, const void * buffer, size_t len)
+{
+   const char * p = (const char *) buffer;
+   while (len > 0)
+   {
+      ssize_t n = write(fd, p, len);
+      if (n < 0 && errno == EINTR)
+         continue;
+
+      if (n <= 0)
+         return wfalse;
+
+      p += n;
+      len -= (size_t) n;
+   }
+   return wtrue;
+}
+
+/**
+ *    Sends the request once and takes the response.  A server that is
+ *    busy may answer and close before it has taken the whole request, so
+ *    the response is read even if the sending fails.
+ */
+
+static void
+client_request (client_t * client, client_result_t * result)
+{
+   uint64_t t_start = client_now();
+   char * payload = nullptr;
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   result->status = CLIENT_NO_SERVER;
+   if (fd < 0)
+      return;
+
+   if
+   (
+      connect
+      (
+         fd, (const struct sockaddr *) &client->addr, sizeof client->addr
+      ) < 0
+   )
+   {
+      close(fd);
+      return;
+   }
+   result->status = CLIENT_LOST;
+   if
+   (
+      client_write(fd, &client->request, sizeof client->request) &&
+      client_write(fd, client->options, client->request.options_len)
+   )
+   {
+      (void) client_write(fd, client->audio, client->request.audio_len);
+   }
+   if
+   (
+      client_read(fd, &result->response, sizeof result->response) &&
+      result->response.magic == WAONCD_MAGIC &&
+      result->response.payload_len <= CLIENT_PAYLOAD_MAX
+   )
+   {
+      size_t len = (size_t) result->response.payload_len;
+      payload = (char *) malloc(len + 1);
+      CHECK_MALLOC(payload, "client_request");
+      if (client_read(fd, payload, len))
+      {
+         payload[len] = 0;
+         result->status = result->response.status;
+      }
+   }
+   close(fd);
+   result->us_latency = client_now() - t_start;
+   if (not_nullptr(payload))
+   {
+      pthread_mutex_lock(&client->lock);
+      if (result->status == WAONCD_OK)
+      {
+         if (not_nullptr(client->file_midi) && ! client->saved)
+         {
+            FILE * f = fopen(client->file_midi, "wb");
+            client->saved = wtrue;
+            if
+            (
+               is_nullptr(f) ||
+               fwrite(payload, 1, result->response.payload_len, f) !=
+                  result->response.payload_len
+            )
+            {
+               errprintf("? cannot write %s\n", client->file_midi);
+            }
+            if (not_nullptr(f))
+               fclose(f);
+         }
+      }
+      else if (result->status != CLIENT_LOST && is_nullptr(client->message))
+      {
+         client->message = payload;          /* kept for the report       */
+         payload = nullptr;
+      }
+
+      pthread_mutex_unlock(&client->lock);
+      free(payload);
+   }
+}
+
+/**
+ *    Sends requests until all of them are done.
+ */
+
+static void *
+client_thread (void * arg)
+{
+   client_t * client = (client_t *) arg;
+   for (;;)
+   {
+      int n;
+      pthread_mutex_lock(&client->lock);
+      n = client->next++;
+      pthread_mutex_unlock(&client->lock);
+      if (n >= client->count)
+         break;
+
+      client_request(client, &client->results[n]);
+   }
+   return nullptr;
+}
+
+/**
+ *    Compares two latencies for qsort().
+ */
+
+static int
+client_compare (const void * a, const void * b)
+{
+   uint64_t x = *(const uint64_t *) a;
+   uint64_t y = *(const uint64_t *) b;
+   return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ *    Gives the name of a status.
+ */
+
+static const char *
+client_status_name (uint32_t status)
+{
+   switch (status)
+   {
+   case WAONCD_OK:            return "ok";
+   case WAONCD_BUSY:          return "busy";
+   case WAONCD_TOO_LARGE:     return "too large";
+   case WAONCD_BAD_REQUEST:   return "bad request";
+   case WAONCD_BAD_AUDIO:     return "bad audio";
+   case WAONCD_FAILED:        return "failed";
+   case CLIENT_NO_SERVER:     return "no server";
+   default:                   return "lost";
+   }
+}
+
+/**
+ *    Prints the counts of each status, the latency of the requests served,
+ *    and the means of the times of the server.
+ */
+
+static void
+client_report (const client_t * client, uint64_t us_wall)
+{
+   static const uint32_t statuses[] =
+   {
+      WAONCD_OK, WAONCD_BUSY, WAONCD_TOO_LARGE, WAONCD_BAD_REQUEST,
+      WAONCD_BAD_AUDIO, WAONCD_FAILED, CLIENT_NO_SERVER, CLIENT_LOST
+   };
+   uint64_t * latency = (uint64_t *) malloc(sizeof(uint64_t) * client->count);
+   double queue = 0.0, receive = 0.0, plan = 0.0, transcribe = 0.0;
+   int planned = 0;
+   int ok = 0;
+   int i, s;
+   CHECK_MALLOC(latency, "client_report");
+   for (i = 0; i < client->count; ++i)
+   {
+      const client_result_t * r = &client->results[i];
+      if (r->status == WAONCD_OK)
+      {
+         latency[ok++] = r->us_latency;
+         queue += (double) r->response.us_queue;
+         receive += (double) r->response.us_receive;
+         plan += (double) r->response.us_plan;
+         transcribe += (double) r->response.us_transcribe;
+         if (r->response.us_plan > 0)
+            ++planned;
+      }
+   }
+   fprintf
+   (
+      stdout, "requests:     %d in %.3f s", client->count, 1.0e-6 * us_wall
+   );
+   for (s = 0; s < (int) (sizeof statuses / sizeof statuses[0]); ++s)
+   {
+      int n = 0;
+      for (i = 0; i < client->count; ++i)
+      {
+         if (client->results[i].status == statuses[s])
+            ++n;
+      }
+      if (n > 0)
+         fprintf(stdout, ", %d %s", n, client_status_name(statuses[s]));
+   }
+   fprintf(stdout, "\n");
+   if (not_nullptr(client->message))
+      fprintf(stdout, "first error:  %s\n", client->message);
+
+   if (ok > 0)
+   {
+      qsort(latency, ok, sizeof(uint64_t), client_compare);
+      fprintf
+      (
+         stdout,
+         "throughput:   %.1f requests/s\n"
+         "latency [ms]: p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n"
+         "server [ms]:  queue %.1f, receive %.1f, plan %.1f, "
+         "transcribe %.1f (means)\n"
+         "planned:      %d of %d\n"
+         ,
+         ok / (1.0e-6 * us_wall),
+         1.0e-3 * latency[(ok - 1) * 50 / 100],
+         1.0e-3 * latency[(ok - 1) * 90 / 100],
+         1.0e-3 * latency[(ok - 1) * 99 / 100],
+         1.0e-3 * latency[ok - 1],
+         1.0e-3 * queue / ok, 1.0e-3 * receive / ok,
+         1.0e-3 * plan / ok, 1.0e-3 * transcribe / ok,
+         planned, ok
+      );
+   }
+   free(latency);
+}
+
+/**
+ *    Reads a whole file into memory.
+ *
+ * \return
+ *    Returns the bytes, or null if the file cannot be read.  The caller
+ *    frees them.
+ */
+
+static char *
+client_read_file (const char * name, size_t * len)
+{
+   char * result = nullptr;
+   FILE * f = fopen(name, "rb");
+   if (not_nullptr(f))
+   {
+      long size;
+      if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0)
+      {
+         rewind(f);
+         result = (char *) malloc((size_t) size + 1);
+         CHECK_MALLOC(result, "client_read_file");
+         if (fread(result, 1, (size_t) size, f) == (size_t) size)
+            *len = (size_t) size;
+         else
+         {
+            free(result);
+            result = nullptr;
+         }
+      }
+      fclose(f);
+   }
+   return result;
+}
+
+/**
+ *    Prints the options of waoncd-client.
+ */
+
+static void
+client_usage (void)
+{
+   fprintf
+   (
+      stdout,
+      "waoncd-client sends a sound to waoncd and reports the latency.\n"
+      "\n"
+      "Usage: waoncd-client [option ...] file\n"
+      "\n"
+      "  -S, --socket path        The socket of the server (%s).\n"
+      "  -c, --concurrency n      The requests sent at once (1).\n"
+      "  -n, --requests n         The requests to send (1).\n"
+      "  -O, --options 'opts'     The options of waonc for the server.\n"
+      "  -o, --output file        Save the SMF of the first request served.\n"
+      "  --raw rate channels      The file holds raw 16-bit samples.\n"
+      "  --float rate channels    The file holds raw 32-bit float samples.\n"
+      "  -h, --help               Show this help.\n"
+      "\n"
+      "Otherwise the file is a sound file, e.g. WAV.\n"
+      ,
+      WAONCD_SOCKET
+   );
+}
+
+/**
+ *    Matches an option of waoncd-client that takes values.
+ */
+
+#define CLIENT_OPTION(longopt, shortopt, values) \
+   ((strcmp(argv[i], longopt) == 0 || strcmp(argv[i], shortopt) == 0) && \
+      i + (values) < argc)
+
+/**
+ *    Provides the entry-point for the waoncd-client program.
+ *
+ * @param argc
+ *    Provides the standard count of the number of command-line arguments,
+ *    including the name of the program.
+ *
+ * @param argv
+ *    Provides the command-line arguments as an array of pointers.
+ *
+ * @return
+ *    Returns 0 if all of the requests were served, and a non-zero value
+ *    otherwise.
+ */
+
+int
+main (int argc, char * argv [])
+{
+   client_t client;
+   const char * path = WAONCD_SOCKET;
+   const char * file_audio = nullptr;
+   char * audio;
+   size_t audio_len = 0;
+   pthread_t * threads;
+   int nthreads = 1;
+   int started = 0;
+   uint64_t t_start;
+   int i;
+
+   memset(&client, 0, sizeof client);
+   client.options = "";
+   client.count = 1;
+   client.request.magic = WAONCD_MAGIC;
+   client.request.version = WAONCD_VERSION;
+   client.request.format = WAONCD_FORMAT_FILE;
+   for (i = 1; i < argc; ++i)
+   {
+      if (CLIENT_OPTION("--socket", "-S", 1))
+         path = argv[++i];
+      else if (CLIENT_OPTION("--concurrency", "-c", 1))
+         nthreads = atoi(argv[++i]);
+      else if (CLIENT_OPTION("--requests", "-n", 1))
+         client.count = atoi(argv[++i]);
+      else if (CLIENT_OPTION("--options", "-O", 1))
+         client.options = argv[++i];
+      else if (CLIENT_OPTION("--output", "-o", 1))
+         client.file_midi = argv[++i];
+      else if
+      (
+         CLIENT_OPTION("--raw", "--raw", 2) ||
+         CLIENT_OPTION("--float", "--float", 2)
+      )
+      {
+         client.request.format = strcmp(argv[i], "--raw") == 0 ?
+            WAONCD_FORMAT_PCM16 : WAONCD_FORMAT_FLOAT ;
+
+         client.request.samplerate = (uint32_t) atoi(argv[++i]);
+         client.request.channels = (uint32_t) atoi(argv[++i]);
+      }
+      else if (argv[i][0] != '-' && is_nullptr(file_audio))
+         file_audio = argv[i];
+      else
+      {
+         client_usage();
+         return
+         (
+            strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0
+         ) ? 0 : 1;
+      }
+   }
+   if
+   (
+      is_nullptr(file_audio) || nthreads < 1 || client.count < 1 ||
+      strlen(path) >= sizeof client.addr.sun_path
+   )
+   {
+      client_usage();
+      return 1;
+   }
+   audio = client_read_file(file_audio, &audio_len);
+   if (is_nullptr(audio))
+   {
+      errprintf("? cannot read %s\n", file_audio);
+      return 1;
+   }
+   signal(SIGPIPE, SIG_IGN);
+   client.addr.sun_family = AF_UNIX;
+   strcpy(client.addr.sun_path, path);
+   client.audio = audio;
+   client.request.options_len = (uint32_t) strlen(client.options);
+   client.request.audio_len = audio_len;
+   client.results = (client_result_t *)
+      calloc(client.count, sizeof(client_result_t));
+
+   threads = (pthread_t *) malloc(sizeof(pthread_t) * nthreads);
+   CHECK_MALLOC(client.results, "main");
+   CHECK_MALLOC(threads, "main");
+   pthread_mutex_init(&client.lock, nullptr);
+   t_start = client_now();
+   for (started = 0; started < nthreads; ++started)
+   {
+      if (pthread_create(&threads[started], nullptr, client_thread, &client))
+         break;
+   }
+   if (started == 0)
+      client_thread(&client);
+
+   for (i = 0; i < started; ++i)
+      pthread_join(threads[i], nullptr);
+
+   client_report(&client, client_now() - t_start);
+   for (i = 0; i < client.count; ++i)
+   {
+      if (client.results[i].status != WAONCD_OK)
+         break;
+   }
+   pthread_mutex_destroy(&client.lock);
+   free(client.message);
+   free(client.results);
+   free(threads);
+   free(audio);
+   return i == client.count ? 0 : 1;
+}
+
+/*
+ * waoncd-client.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
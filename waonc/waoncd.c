@@ -0,0 +1,1238 @@
+/*
+ * WaoN - a Wave-to-Notes transcriber : transcription server
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/**
+ * \file          waoncd.c
+ *
+ *    This program transcribes sound to standard MIDI files for the clients
+ *    of a UNIX-domain socket, without starting a waonc for each one.
+ *
+ * \library       waoncd application
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    The messages are described in waoncd.h.  The main thread accepts the
+ *    connections and puts them in a bounded queue; when the queue is full,
+ *    it answers WAONCD_BUSY at once, so that a loaded server sheds the
+ *    extra requests instead of letting their waits grow.  A fixed pool of
+ *    workers takes the connections from the queue, reads the request,
+ *    transcribes it, and sends the SMF back with the time each step took.
+ *
+ *    Each worker keeps a few engines (see processing.h), each with its
+ *    FFTW plan and its patch, and uses the one made for the FFT length,
+ *    batch, window, and layout of the request, or else remakes the one
+ *    used the longest time ago.  Only that remaking is serialized, since
+ *    the FFTW planner is not thread safe; the transforms themselves run in
+ *    parallel.
+ *
+ *    A request cannot name a file on the server, so the options that do
+ *    are refused.  The patch (-p) is the server's, given on its command
+ *    line.  The pitch adjustment (-a) of the command line is the one of
+ *    the requests that give none.
+ *
+\verbatim
+      waoncd -j 4 -q 16 &
+      waoncd-client -c 8 -n 200 -O "-n 4096 -s 1024" test.wav
+\endverbatim
+ */
+
+#include <errno.h>                     /* errno, EINTR                        */
+#include <poll.h>                      /* poll()                              */
+#include <pthread.h>                   /* pthread_create(), pthread_join()    */
+#include <signal.h>                    /* signal(), SIGINT, SIGTERM           */
+#include <stdio.h>                     /* fprintf()                           */
+#include <stdlib.h>                    /* malloc(), mkstemp(), atoi()         */
+#include <string.h>                    /* strcmp(), strtok_r()                */
+#include <sys/socket.h>                /* socket(), bind(), accept()          */
+#include <sys/stat.h>                  /* lstat(), S_ISSOCK()                 */
+#include <sys/time.h>                  /* struct timeval                      */
+#include <sys/un.h>                    /* struct sockaddr_un                  */
+#include <time.h>                      /* clock_gettime()                     */
+#include <unistd.h>                    /* read(), write(), pread()            */
+
+#include <sndfile.h>                   /* sf_open_virtual()                   */
+
+#include "analyse.h"                   /* analysis_scratchpad_t               */
+#include "memory-check.h"              /* CHECK_MALLOC() macro                */
+#include "midi.h"                      /* WAON_notes_write_midi()             */
+#include "parameters.h"                /* waon_parameters_t                   */
+#include "processing.h"                /* waon_processing_t                   */
+#include "sweep.h"                     /* waon_sweep_t                        */
+#include "waoncd.h"                    /* waoncd_request_t, the protocol      */
+
+/**
+ *    The defaults of the workers, of the queue, and of the largest audio
+ *    accepted [MB].
+ */
+
+#define WAONCD_WORKERS                 4
+#define WAONCD_QUEUE                   16
+#define WAONCD_AUDIO_MAX               64
+
+/**
+ *    The engines kept by each worker, i.e. the analyses (-n, --batch, -w,
+ *    --r2c, --note-bank) it can switch between without planning.
+ */
+
+#define WAONCD_ENGINES                 2
+
+/**
+ *    The largest options of a request, and the most tokens in them.
+ */
+
+#define WAONCD_OPTIONS_MAX             1024
+#define WAONCD_TOKENS_MAX              64
+
+/**
+ *    The limits of the FFT length and of the batch of a request.
+ */
+
+#define WAONCD_FFT_MIN                 64
+#define WAONCD_FFT_MAX                 65536
+#define WAONCD_BATCH_MAX               256
+
+/**
+ *    The time a client has to send its request, or to take the response,
+ *    before the worker gives up on it [sec].
+ */
+
+#define WAONCD_TIMEOUT                 10
+
+/**
+ *    The poll period of the accept loop, so that it sees a signal [msec].
+ */
+
+#define WAONCD_POLL                    500
+
+/**
+ *    Matches an option of waoncd that takes a value, as in parameters.c.
+ */
+
+#define WAONCD_OPTION(longopt, shortopt) \
+   ((strcmp(argv[i], longopt) == 0 || strcmp(argv[i], shortopt) == 0) && \
+      i + 1 < argc)
+
+/**
+ *    Holds an accepted connection, waiting for a worker.
+ */
+
+typedef struct
+{
+   int fd;                 /*<< The connection.                               */
+   uint64_t t_accept;      /*<< When it was accepted [usec].                  */
+
+} waoncd_job_t;
+
+/**
+ *    Holds an engine of a worker and the scratchpad that holds its patch.
+ */
+
+typedef struct
+{
+   waon_processing_t * engine;
+   analysis_scratchpad_t scratchpad;
+   unsigned long used;     /*<< The request it last served, 0 if none.        */
+
+} waoncd_engine_t;
+
+struct waoncd_server;
+
+/**
+ *    Holds a worker, its engines, and its buffers, which grow to the
+ *    largest request it has served.
+ */
+
+typedef struct
+{
+   struct waoncd_server * server;
+   pthread_t thread;
+   int index;
+   unsigned long requests;             /*<< The requests it has taken.        */
+   waoncd_engine_t engines[WAONCD_ENGINES];
+   char * request;                     /*<< The options and the audio.        */
+   size_t request_size;
+   char * smf;                         /*<< The SMF of the response.          */
+   size_t smf_size;
+   int smf_fd;                         /*<< The file the SMF is written to.   */
+
+} waoncd_worker_t;
+
+/**
+ *    Holds the listening socket, the queue, the workers, and the counts.
+ *    The queue and the counts are guarded by the lock.
+ */
+
+typedef struct waoncd_server
+{
+   int listener;
+   const char * path;                  /*<< The socket.                       */
+   char * file_patch;                  /*<< The patch of all requests.        */
+   double adj_pitch;                   /*<< The default -a of the requests.   */
+   uint64_t audio_max;                 /*<< The largest audio [bytes].        */
+   wbool_t verbose;                    /*<< Log each request.                 */
+   pthread_mutex_t lock;
+   pthread_cond_t ready;               /*<< A job is queued, or stopping.     */
+   pthread_mutex_t plan_lock;          /*<< Serializes the FFTW planner.      */
+   waoncd_job_t * queue;               /*<< [queue_max], a ring.              */
+   int queue_max;
+   int queue_head;
+   int queue_count;
+   wbool_t stopping;
+   int nworkers;
+   waoncd_worker_t * workers;          /*<< [nworkers].                       */
+   unsigned long accepted;
+   unsigned long busy;                 /*<< Refused, the queue was full.      */
+   unsigned long served;
+   unsigned long failed;
+   unsigned long planned;              /*<< Requests that had to plan.        */
+
+} waoncd_server_t;
+
+/**
+ *    Holds a sound in memory, for the virtual I/O of libsndfile.
+ */
+
+typedef struct
+{
+   const unsigned char * data;
+   sf_count_t length;
+   sf_count_t offset;
+
+} waoncd_memory_t;
+
+/**
+ *    Set by the signals that stop the server.
+ */
+
+static volatile sig_atomic_t s_stop = 0;
+
+/**
+ *    Asks the accept loop to stop.
+ */
+
+static void
+waoncd_signal (int sig)
+{
+   (void) sig;
+   s_stop = 1;
+}
+
+/**
+ *    Gets the time of a monotonic clock [usec].
+ */
+
+static uint64_t
+waoncd_now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+/**
+ *    Reads exactly len bytes from a socket.
+ *
+ * \return
+ *    Returns false if the peer closed the connection, timed out, or
+ *    failed before all of the bytes came in.
+ */
+
+static wbool_t
+waoncd_read (int fd, void * buffer, size_t len)
+{
+   char * p = (char *) buffer;
+   while (len > 0)
+   {
+      ssize_t n = read(fd, p, len);
+      if (n < 0 && errno == EINTR)
+         continue;
+
+      if (n <= 0)
+         return wfalse;
+
+      p += n;
+      len -= (size_t) n;
+   }
+   return wtrue;
+}
+
+/**
+ *    Writes exactly len bytes to a socket.
+ *
+ * \return
+ *    Returns false if the peer is gone or too slow.
+ */
+
+static wbool_t
+waoncd_write (int fd, const void * buffer, size_t len)
+{
+   const char * p = (const char *) buffer;
+   while (len > 0)
+   {
+      ssize_t n = write(fd, p, len);
+      if (n < 0 && errno == EINTR)
+         continue;
+
+      if (n <= 0)
+         return wfalse;
+
+      p += n;
+      len -= (size_t) n;
+   }
+   return wtrue;
+}
+
+/**
+ *    Sends a response header and its payload.
+ */
+
+static wbool_t
+waoncd_respond
+(
+   int fd,
+   waoncd_response_t * response,
+   const void * payload,
+   size_t len
+)
+{
+   response->magic = WAONCD_MAGIC;
+   response->payload_len = len;
+   return
+      waoncd_write(fd, response, sizeof *response) &&
+      (len == 0 || waoncd_write(fd, payload, len));
+}
+
+/**
+ *    Sends an error, with its message as the payload.
+ */
+
+static void
+waoncd_refuse
+(
+   int fd,
+   waoncd_response_t * response,
+   uint32_t status,
+   const char * message
+)
+{
+   response->status = status;
+   (void) waoncd_respond(fd, response, message, strlen(message));
+}
+
+/*
+ * The virtual I/O of libsndfile, over a sound in memory.
+ */
+
+static sf_count_t
+waoncd_vio_length (void * user)
+{
+   return ((waoncd_memory_t *) user)->length;
+}
+
+static sf_count_t
+waoncd_vio_seek (sf_count_t offset, int whence, void * user)
+{
+   waoncd_memory_t * m = (waoncd_memory_t *) user;
+   sf_count_t position = offset;
+   if (whence == SEEK_CUR)
+      position += m->offset;
+   else if (whence == SEEK_END)
+      position += m->length;
+
+   if (position < 0 || position > m->length)
+      return -1;
+
+   m->offset = position;
+   return position;
+}
+
+static sf_count_t
+waoncd_vio_read (void * ptr, sf_count_t count, void * user)
+{
+   waoncd_memory_t * m = (waoncd_memory_t *) user;
+   if (count > m->length - m->offset)
+      count = m->length - m->offset;
+
+   memcpy(ptr, m->data + m->offset, (size_t) count);
+   m->offset += count;
+   return count;
+}
+
+static sf_count_t
+waoncd_vio_write (const void * ptr, sf_count_t count, void * user)
+{
+   (void) ptr;
+   (void) count;
+   (void) user;
+   return 0;
+}
+
+static sf_count_t
+waoncd_vio_tell (void * user)
+{
+   return ((waoncd_memory_t *) user)->offset;
+}
+
+static SF_VIRTUAL_IO s_vio =
+{
+   waoncd_vio_length,
+   waoncd_vio_seek,
+   waoncd_vio_read,
+   waoncd_vio_write,
+   waoncd_vio_tell
+};
+
+/**
+ *    Opens the audio of a request with libsndfile.
+ *
+ * \param request
+ *    Provides the header, for the format, the rate, and the channels of
+ *    raw samples.
+ *
+ * \param memory
+ *    Provides the audio.  It must outlive the SNDFILE.
+ *
+ * \param sfinfo
+ *    Receives the format.
+ *
+ * \return
+ *    Returns the sound file, or null if the audio cannot be read.
+ */
+
+static SNDFILE *
+waoncd_open_audio
+(
+   const waoncd_request_t * request,
+   waoncd_memory_t * memory,
+   SF_INFO * sfinfo
+)
+{
+   memset(sfinfo, 0, sizeof *sfinfo);
+   if (request->format != WAONCD_FORMAT_FILE)
+   {
+      sfinfo->samplerate = (int) request->samplerate;
+      sfinfo->channels = (int) request->channels;
+      sfinfo->format = SF_FORMAT_RAW | SF_ENDIAN_CPU |
+      (
+         request->format == WAONCD_FORMAT_PCM16 ?
+            SF_FORMAT_PCM_16 : SF_FORMAT_FLOAT
+      );
+   }
+   return sf_open_virtual(&s_vio, SFM_READ, sfinfo, memory);
+}
+
+/**
+ *    Makes the parameters of a request from its options, which are the
+ *    ones of waonc.
+ *
+ * \param server
+ *    Provides the patch of the server, and the default adjustment.
+ *
+ * \param options
+ *    Provides the options, blank-separated.  They are cut into tokens in
+ *    place, and the parameters may point into them.
+ *
+ * \param parameters
+ *    Receives the parameters.  Free them with parameters_free(), even if
+ *    the function fails.
+ *
+ * \return
+ *    Returns null if the parameters are good, or else the message of the
+ *    error.
+ */
+
+static const char *
+waoncd_parameters
+(
+   const waoncd_server_t * server,
+   char * options,
+   waon_parameters_t * parameters
+)
+{
+   char * argv[WAONCD_TOKENS_MAX + 1];
+   char * save = nullptr;
+   char * token = strtok_r(options, " \t\r\n", &save);
+   int argc = 1;
+   (void) parameters_initialize(parameters);
+   argv[0] = "waoncd";
+   while (not_nullptr(token))
+   {
+      if (argc == WAONCD_TOKENS_MAX)
+         return "too many options";
+
+      argv[argc++] = token;
+      token = strtok_r(nullptr, " \t\r\n", &save);
+   }
+   argv[argc] = nullptr;
+   parameters->adj_pitch = server->adj_pitch;
+   if (! parameters_parse(parameters, argc, argv))
+      return "bad options";
+
+   if (parameters->show_help || parameters->show_version)
+      return "bad options";
+
+   if
+   (
+      not_nullptr(parameters->file_wav) ||
+      not_nullptr(parameters->file_midi) ||
+      not_nullptr(parameters->file_patch) ||
+      not_nullptr(parameters->file_sweep) ||
+      not_nullptr(parameters->file_spec_cache)
+   )
+   {
+      return "the options cannot name files";
+   }
+   if
+   (
+      parameters->fft_len < WAONCD_FFT_MIN ||
+      parameters->fft_len > WAONCD_FFT_MAX ||
+      parameters->shift_hop < 1 || parameters->fft_batch > WAONCD_BATCH_MAX
+   )
+   {
+      return "bad window length, shift, or batch";
+   }
+   parameters->file_midi = strdup("-");            /* sweep_create() needs it */
+   CHECK_MALLOC(parameters->file_midi, "waoncd_parameters");
+   if (not_nullptr(server->file_patch))
+   {
+      parameters->file_patch = strdup(server->file_patch);
+      CHECK_MALLOC(parameters->file_patch, "waoncd_parameters");
+   }
+   return nullptr;
+}
+
+/**
+ *    Picks the engine of a worker for the parameters:  the one made for
+ *    them, else one not made yet, else the one used the longest time ago.
+ */
+
+static waoncd_engine_t *
+waoncd_engine (waoncd_worker_t * worker, const waon_parameters_t * parameters)
+{
+   waoncd_engine_t * result = &worker->engines[0];
+   int nbatch = parameters->fft_batch < 1 ? 1 : parameters->fft_batch;
+   int e;
+   for (e = 0; e < WAONCD_ENGINES; ++e)
+   {
+      waoncd_engine_t * we = &worker->engines[e];
+      const waon_processing_t * engine = we->engine;
+      if
+      (
+         engine->fft_len == parameters->fft_len &&
+         engine->nbatch == nbatch &&
+         engine->flag_window == parameters->flag_window &&
+         engine->fft_r2c == parameters->fft_r2c &&
+         engine->note_bank == parameters->note_bank
+      )
+      {
+         return we;
+      }
+      if (we->used < result->used)
+         result = we;
+   }
+   return result;
+}
+
+/**
+ *    Takes the next connection from the queue, waiting for one.
+ *
+ * \return
+ *    Returns the job, with a negative fd once the server is stopping and
+ *    the queue is empty.
+ */
+
+static waoncd_job_t
+waoncd_dequeue (waoncd_server_t * server)
+{
+   waoncd_job_t job;
+   pthread_mutex_lock(&server->lock);
+   while (server->queue_count == 0 && ! server->stopping)
+      pthread_cond_wait(&server->ready, &server->lock);
+
+   if (server->queue_count > 0)
+   {
+      job = server->queue[server->queue_head];
+      server->queue_head = (server->queue_head + 1) % server->queue_max;
+      --server->queue_count;
+   }
+   else
+   {
+      job.fd = -1;
+      job.t_accept = 0;
+   }
+   pthread_mutex_unlock(&server->lock);
+   return job;
+}
+
+/**
+ *    Serves the request of a connection.
+ *
+ * \param worker
+ *    Provides the worker.
+ *
+ * \param job
+ *    Provides the connection.  It is left open.
+ *
+ * \param response
+ *    Provides the response, with its queue time, and receives the rest.
+ *    It is sent by this function, unless the client is gone.
+ *
+ * \return
+ *    Returns true if the SMF was sent.
+ */
+
+static wbool_t
+waoncd_serve
+(
+   waoncd_worker_t * worker,
+   const waoncd_job_t * job,
+   waoncd_response_t * response
+)
+{
+   waoncd_server_t * server = worker->server;
+   waon_parameters_t parameters;
+   waon_processing_stats_t stats;
+   waoncd_request_t request;
+   waoncd_memory_t memory;
+   waoncd_engine_t * we;
+   waon_sweep_t * sweep = nullptr;
+   SNDFILE * sf = nullptr;
+   SF_INFO sfinfo;
+   const char * error;
+   uint32_t status = WAONCD_BAD_AUDIO;
+   wbool_t result = wfalse;
+   uint64_t t_received, t_planned;
+   size_t len;
+   int nsmf = -1;
+
+   if (! waoncd_read(job->fd, &request, sizeof request))
+      return wfalse;                         /* no one to tell             */
+
+   if (request.magic != WAONCD_MAGIC || request.version != WAONCD_VERSION)
+   {
+      waoncd_refuse(job->fd, response, WAONCD_BAD_REQUEST, "bad header");
+      return wfalse;
+   }
+   if
+   (
+      request.options_len > WAONCD_OPTIONS_MAX ||
+      request.audio_len > server->audio_max
+   )
+   {
+      waoncd_refuse(job->fd, response, WAONCD_TOO_LARGE, "request too large");
+      return wfalse;
+   }
+   if
+   (
+      request.format != WAONCD_FORMAT_FILE &&
+      (
+         (
+            request.format != WAONCD_FORMAT_PCM16 &&
+            request.format != WAONCD_FORMAT_FLOAT
+         ) ||
+         request.samplerate == 0 || request.channels == 0
+      )
+   )
+   {
+      waoncd_refuse(job->fd, response, WAONCD_BAD_REQUEST, "bad format");
+      return wfalse;
+   }
+
+   /*
+    * The buffer holds the options, their terminator, and the audio.
+    */
+
+   len = request.options_len + 1 + (size_t) request.audio_len;
+   if (len > worker->request_size)
+   {
+      free(worker->request);
+      worker->request = (char *) malloc(len);
+      CHECK_MALLOC(worker->request, "waoncd_serve");
+      worker->request_size = len;
+   }
+   if
+   (
+      ! waoncd_read(job->fd, worker->request, request.options_len) ||
+      ! waoncd_read
+      (
+         job->fd, worker->request + request.options_len + 1,
+         (size_t) request.audio_len
+      )
+   )
+   {
+      return wfalse;
+   }
+   worker->request[request.options_len] = 0;
+   t_received = waoncd_now();
+   response->us_receive = t_received - job->t_accept - response->us_queue;
+   error = waoncd_parameters(server, worker->request, &parameters);
+   if (not_nullptr(error))
+   {
+      waoncd_refuse(job->fd, response, WAONCD_BAD_REQUEST, error);
+      parameters_free(&parameters);
+      return wfalse;
+   }
+   we = waoncd_engine(worker, &parameters);
+   we->used = worker->requests;
+   pthread_mutex_lock(&server->plan_lock);
+   if (processing_prepare(we->engine, &parameters, &we->scratchpad))
+   {
+      pthread_mutex_unlock(&server->plan_lock);
+      response->us_plan = waoncd_now() - t_received;
+      pthread_mutex_lock(&server->lock);
+      ++server->planned;
+      pthread_mutex_unlock(&server->lock);
+   }
+   else
+      pthread_mutex_unlock(&server->plan_lock);
+
+   t_planned = waoncd_now();
+   memory.data = (const unsigned char *) worker->request +
+      request.options_len + 1;
+
+   memory.length = (sf_count_t) request.audio_len;
+   memory.offset = 0;
+   sf = waoncd_open_audio(&request, &memory, &sfinfo);
+   if (is_nullptr(sf))
+      error = "the audio cannot be read";
+   else if (sfinfo.channels != 1 && sfinfo.channels != 2)
+      error = "only mono and stereo inputs are supported";
+   else
+   {
+      we->scratchpad.absolute_cutoff = parameters.abs_flg;
+      we->scratchpad.adj_pitch = parameters.adj_pitch;
+      sweep = sweep_create(&parameters, &we->scratchpad);
+      if (is_nullptr(sweep))
+      {
+         status = WAONCD_FAILED;
+         error = "the parameters cannot be set";
+      }
+      else if
+      (
+         ! processing_run
+         (
+            we->engine, &parameters, sweep, sf, &sfinfo, &stats
+         )
+      )
+      {
+         error = "the audio is shorter than one frame";
+      }
+   }
+   if (is_nullptr(error))
+   {
+      status = WAONCD_FAILED;
+      error = "the SMF cannot be written";
+      if
+      (
+         ftruncate(worker->smf_fd, 0) == 0 &&
+         lseek(worker->smf_fd, 0, SEEK_SET) == 0
+      )
+      {
+         nsmf = WAON_notes_write_midi
+         (
+            sweep->sets[0].notes, (double) stats.div, worker->smf_fd, wtrue
+         );
+      }
+      if (nsmf > 0)
+      {
+         if ((size_t) nsmf > worker->smf_size)
+         {
+            free(worker->smf);
+            worker->smf = (char *) malloc((size_t) nsmf);
+            CHECK_MALLOC(worker->smf, "waoncd_serve");
+            worker->smf_size = (size_t) nsmf;
+         }
+         if (pread(worker->smf_fd, worker->smf, (size_t) nsmf, 0) == nsmf)
+            error = nullptr;
+      }
+   }
+   response->us_transcribe = waoncd_now() - t_planned;
+   if (is_nullptr(error))
+   {
+      response->status = WAONCD_OK;
+      response->events = (uint32_t) sweep->sets[0].notes->n;
+      result = waoncd_respond
+      (
+         job->fd, response, worker->smf, (size_t) nsmf
+      );
+   }
+   else
+      waoncd_refuse(job->fd, response, status, error);
+
+   sweep_free(sweep);
+   if (not_nullptr(sf))
+      sf_close(sf);
+
+   parameters_free(&parameters);
+   return result;
+}
+
+/**
+ *    Serves the connections of the queue until the server stops and the
+ *    queue is empty.
+ */
+
+static void *
+waoncd_worker (void * arg)
+{
+   waoncd_worker_t * worker = (waoncd_worker_t *) arg;
+   waoncd_server_t * server = worker->server;
+   for (;;)
+   {
+      waoncd_response_t response;
+      waoncd_job_t job = waoncd_dequeue(server);
+      wbool_t ok;
+      if (job.fd < 0)
+         break;
+
+      memset(&response, 0, sizeof response);
+      response.worker = (uint32_t) worker->index;
+      response.us_queue = waoncd_now() - job.t_accept;
+      ++worker->requests;
+      ok = waoncd_serve(worker, &job, &response);
+      close(job.fd);
+      pthread_mutex_lock(&server->lock);
+      if (ok)
+         ++server->served;
+      else
+         ++server->failed;
+
+      pthread_mutex_unlock(&server->lock);
+      if (server->verbose)
+      {
+         fprintf
+         (
+            stderr,
+            "waoncd: worker %d: status %u, %u events, queue %.1f ms, "
+            "receive %.1f ms, plan %.1f ms, transcribe %.1f ms\n",
+            worker->index, (unsigned) response.status,
+            (unsigned) response.events,
+            1.0e-3 * (double) response.us_queue,
+            1.0e-3 * (double) response.us_receive,
+            1.0e-3 * (double) response.us_plan,
+            1.0e-3 * (double) response.us_transcribe
+         );
+      }
+   }
+   return nullptr;
+}
+
+/**
+ *    Puts a new connection in the queue, or answers WAONCD_BUSY and closes
+ *    it if the queue is full.
+ */
+
+static void
+waoncd_admit (waoncd_server_t * server, int fd)
+{
+   struct timeval tv;
+   wbool_t queued = wfalse;
+   tv.tv_sec = WAONCD_TIMEOUT;
+   tv.tv_usec = 0;
+   (void) setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+   (void) setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+   pthread_mutex_lock(&server->lock);
+   ++server->accepted;
+   if (server->queue_count < server->queue_max)
+   {
+      int tail = (server->queue_head + server->queue_count) % server->queue_max;
+      server->queue[tail].fd = fd;
+      server->queue[tail].t_accept = waoncd_now();
+      ++server->queue_count;
+      pthread_cond_signal(&server->ready);
+      queued = wtrue;
+   }
+   else
+      ++server->busy;
+
+   pthread_mutex_unlock(&server->lock);
+   if (! queued)
+   {
+      waoncd_response_t response;
+      memset(&response, 0, sizeof response);
+      waoncd_refuse(fd, &response, WAONCD_BUSY, "the queue is full");
+      close(fd);
+   }
+}
+
+/**
+ *    Creates the listening socket.  A socket left by a server that is gone
+ *    is replaced, but not one that a server still listens on.
+ *
+ * \return
+ *    Returns the socket, or -1 on an error (reported).
+ */
+
+static int
+waoncd_listen (const char * path)
+{
+   struct sockaddr_un addr;
+   struct stat st;
+   int fd;
+   if (strlen(path) >= sizeof addr.sun_path)
+   {
+      errprintf("? the socket name %s is too long\n", path);
+      return -1;
+   }
+   memset(&addr, 0, sizeof addr);
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, path);
+   if (lstat(path, &st) == 0)
+   {
+      int probe;
+      if (! S_ISSOCK(st.st_mode))
+      {
+         errprintf("? %s exists and is not a socket\n", path);
+         return -1;
+      }
+      probe = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (connect(probe, (struct sockaddr *) &addr, sizeof addr) == 0)
+      {
+         errprintf("? a server already listens on %s\n", path);
+         close(probe);
+         return -1;
+      }
+      close(probe);
+      (void) unlink(path);
+   }
+   fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if
+   (
+      fd < 0 ||
+      bind(fd, (struct sockaddr *) &addr, sizeof addr) < 0 ||
+      listen(fd, SOMAXCONN) < 0
+   )
+   {
+      fprintf
+      (
+         stderr, "? cannot listen on %s: %s\n", path, strerror(errno)
+      );
+      if (fd >= 0)
+         close(fd);
+
+      return -1;
+   }
+   return fd;
+}
+
+/**
+ *    Stops the workers, once they have served the queue.
+ */
+
+static void
+waoncd_server_stop (waoncd_server_t * server)
+{
+   int w;
+   pthread_mutex_lock(&server->lock);
+   server->stopping = wtrue;
+   pthread_cond_broadcast(&server->ready);
+   pthread_mutex_unlock(&server->lock);
+   for (w = 0; w < server->nworkers; ++w)
+   {
+      if (server->workers[w].index >= 0)
+         pthread_join(server->workers[w].thread, nullptr);
+   }
+}
+
+/**
+ *    Frees a stopped server.
+ */
+
+static void
+waoncd_server_free (waoncd_server_t * server)
+{
+   int w;
+   for (w = 0; w < server->nworkers; ++w)
+   {
+      waoncd_worker_t * worker = &server->workers[w];
+      int e;
+      for (e = 0; e < WAONCD_ENGINES; ++e)
+      {
+         processing_free(worker->engines[e].engine);
+         free(worker->engines[e].scratchpad.patch_array);
+      }
+      free(worker->request);
+      free(worker->smf);
+      if (worker->smf_fd >= 0)
+         close(worker->smf_fd);
+   }
+   free(server->workers);
+   free(server->queue);
+   pthread_mutex_destroy(&server->lock);
+   pthread_mutex_destroy(&server->plan_lock);
+   pthread_cond_destroy(&server->ready);
+   free(server);
+}
+
+/**
+ *    Creates the server, without starting its workers.
+ *
+ * \param nworkers
+ *    Provides the size of the pool.
+ *
+ * \param queue_max
+ *    Provides the connections that can wait for a worker.
+ *
+ * \return
+ *    Returns the server.  The function exits the application if memory
+ *    cannot be allocated.
+ */
+
+static waoncd_server_t *
+waoncd_server_init (int nworkers, int queue_max)
+{
+   waoncd_server_t * server =
+      (waoncd_server_t *) calloc(1, sizeof(waoncd_server_t));
+
+   int w;
+   CHECK_MALLOC(server, "waoncd_server_init");
+   server->listener = -1;
+   server->queue = (waoncd_job_t *) malloc(sizeof(waoncd_job_t) * queue_max);
+   server->workers =
+      (waoncd_worker_t *) calloc(nworkers, sizeof(waoncd_worker_t));
+
+   CHECK_MALLOC(server->queue, "waoncd_server_init");
+   CHECK_MALLOC(server->workers, "waoncd_server_init");
+   server->queue_max = queue_max;
+   server->nworkers = nworkers;
+   pthread_mutex_init(&server->lock, nullptr);
+   pthread_mutex_init(&server->plan_lock, nullptr);
+   pthread_cond_init(&server->ready, nullptr);
+   for (w = 0; w < nworkers; ++w)
+   {
+      waoncd_worker_t * worker = &server->workers[w];
+      worker->server = server;
+      worker->index = -1;                 /* not started                   */
+      worker->smf_fd = -1;
+   }
+   return server;
+}
+
+/**
+ *    Starts the workers, once the patch of the server is known.
+ *
+ * \return
+ *    Returns false if a worker cannot be started.
+ */
+
+static wbool_t
+waoncd_server_start (waoncd_server_t * server)
+{
+   char name[] = "/tmp/waoncd-XXXXXX";
+   int w;
+   for (w = 0; w < server->nworkers; ++w)
+   {
+      waoncd_worker_t * worker = &server->workers[w];
+      int e;
+      for (e = 0; e < WAONCD_ENGINES; ++e)
+      {
+         waoncd_engine_t * we = &worker->engines[e];
+         we->engine = processing_create();
+         (void) analysis_scratchpad_initialize(&we->scratchpad);
+         we->scratchpad.use_patchfile = not_nullptr(server->file_patch);
+      }
+      strcpy(name, "/tmp/waoncd-XXXXXX");
+      worker->smf_fd = mkstemp(name);
+      if (worker->smf_fd < 0)
+      {
+         fprintf
+         (
+            stderr, "? cannot create %s: %s\n", name, strerror(errno)
+         );
+         return wfalse;
+      }
+      (void) unlink(name);                /* only the fd is needed         */
+      if (pthread_create(&worker->thread, nullptr, waoncd_worker, worker) != 0)
+      {
+         errprint("cannot start a worker");
+         return wfalse;
+      }
+      worker->index = w;
+   }
+   return wtrue;
+}
+
+/**
+ *    Prints the counts of the server.
+ */
+
+static void
+waoncd_report (waoncd_server_t * server)
+{
+   pthread_mutex_lock(&server->lock);
+   fprintf
+   (
+      stderr,
+      "waoncd: %lu accepted, %lu busy, %lu served, %lu failed, "
+      "%lu planned\n",
+      server->accepted, server->busy, server->served, server->failed,
+      server->planned
+   );
+   pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ *    Prints the options of waoncd.
+ */
+
+static void
+waoncd_usage (void)
+{
+   fprintf
+   (
+      stdout,
+      "waoncd transcribes sound to MIDI for the clients of a local socket.\n"
+      "\n"
+      "Usage: waoncd [option ...]\n"
+      "\n"
+      "  -S, --socket path    The socket to listen on (%s).\n"
+      "  -j, --workers n      The transcriptions done at once (%d).\n"
+      "  -q, --queue n        The requests that can wait for a worker (%d).\n"
+      "                       The ones over it are answered 'busy'.\n"
+      "  -m, --max mb         The largest audio of a request (%d MB).\n"
+      "  -p, --patch file     The patch of all of the requests.\n"
+      "  -a, --adjust st      The pitch adjustment of the requests that\n"
+      "                       give none.\n"
+      "  --verbose            Log each request.\n"
+      "  -h, --help           Show this help.\n"
+      "\n"
+      "The options of a request are the ones of waonc, except the ones\n"
+      "that name files.  See waoncd-client.\n"
+      ,
+      WAONCD_SOCKET, WAONCD_WORKERS, WAONCD_QUEUE, WAONCD_AUDIO_MAX
+   );
+}
+
+/**
+ *    Provides the entry-point for the waoncd program.
+ *
+ * @param argc
+ *    Provides the standard count of the number of command-line arguments,
+ *    including the name of the program.
+ *
+ * @param argv
+ *    Provides the command-line arguments as an array of pointers.
+ *
+ * @return
+ *    Returns a 0 value if the server stopped on a signal, and a non-zero
+ *    value if it could not start.
+ */
+
+int
+main (int argc, char * argv [])
+{
+   waoncd_server_t * server;
+   const char * path = WAONCD_SOCKET;
+   char * file_patch = nullptr;
+   double adj_pitch = 0.0;
+   int nworkers = WAONCD_WORKERS;
+   int queue_max = WAONCD_QUEUE;
+   int audio_max = WAONCD_AUDIO_MAX;
+   wbool_t verbose = wfalse;
+   int i;
+   for (i = 1; i < argc; ++i)
+   {
+      if (WAONCD_OPTION("--socket", "-S"))
+         path = argv[++i];
+      else if (WAONCD_OPTION("--workers", "-j"))
+         nworkers = atoi(argv[++i]);
+      else if (WAONCD_OPTION("--queue", "-q"))
+         queue_max = atoi(argv[++i]);
+      else if (WAONCD_OPTION("--max", "-m"))
+         audio_max = atoi(argv[++i]);
+      else if (WAONCD_OPTION("--patch", "-p"))
+         file_patch = argv[++i];
+      else if (WAONCD_OPTION("--adjust", "-a"))
+         adj_pitch = atof(argv[++i]);
+      else if (strcmp(argv[i], "--verbose") == 0)
+         verbose = wtrue;
+      else
+      {
+         waoncd_usage();
+         return
+         (
+            strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0
+         ) ? 0 : 1;
+      }
+   }
+   if (nworkers < 1 || queue_max < 1 || audio_max < 1)
+   {
+      waoncd_usage();
+      return 1;
+   }
+   if (not_nullptr(file_patch) && access(file_patch, R_OK) != 0)
+   {
+      errprintf("? cannot read the patch %s\n", file_patch);
+      return 1;
+   }
+   signal(SIGPIPE, SIG_IGN);
+   server = waoncd_server_init(nworkers, queue_max);
+   server->path = path;
+   server->file_patch = file_patch;
+   server->adj_pitch = adj_pitch;
+   server->audio_max = (uint64_t) audio_max << 20;
+   server->verbose = verbose;
+   server->listener = waoncd_listen(path);
+   if (server->listener < 0 || ! waoncd_server_start(server))
+   {
+      if (server->listener >= 0)
+      {
+         close(server->listener);
+         (void) unlink(path);
+      }
+      waoncd_server_stop(server);
+      waoncd_server_free(server);
+      return 1;
+   }
+   fprintf
+   (
+      stderr, "waoncd: listening on %s, %d workers, queue %d\n",
+      path, nworkers, queue_max
+   );
+   signal(SIGINT, waoncd_signal);
+   signal(SIGTERM, waoncd_signal);
+   while (! s_stop)
+   {
+      struct pollfd pfd;
+      int fd;
+      pfd.fd = server->listener;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if (poll(&pfd, 1, WAONCD_POLL) <= 0)
+         continue;
+
+      fd = accept(server->listener, nullptr, nullptr);
+      if (fd >= 0)
+         waoncd_admit(server, fd);
+   }
+   close(server->listener);
+   (void) unlink(path);
+   waoncd_server_stop(server);            /* the queue is served first     */
+   waoncd_report(server);
+   waoncd_server_free(server);
+   return 0;
+}
+
+/*
+ * waoncd.c
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */
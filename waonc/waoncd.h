@@ -0,0 +1,121 @@
+#ifndef WAONC_WAONCD_H_
+#define WAONC_WAONCD_H_
+
+/*
+ * WaoN - a Wave-to-Notes transcriber : transcription server protocol
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/**
+ * \file          waoncd.h
+ *
+ *    This module provides the messages between waoncd and its clients.
+ *
+ * \library       waoncd application
+ * \author        Chris Ahlstrom
+ * \date          2026-10-18
+ * \updates       2026-10-18
+ * \version       $Revision$
+ * \license       GNU GPL
+ *
+ *    One request per connection, on a UNIX-domain stream socket.  The
+ *    client sends a waoncd_request_t, the options, and the audio, and the
+ *    server answers with a waoncd_response_t and its payload, then closes
+ *    the connection.  The integers are in the byte order of the host,
+ *    since both ends are on it.
+ *
+ *    The options are the ones of waonc, separated by blanks, except the
+ *    ones that name files (-i, -o, -p, --sweep, --spec-cache).  The audio
+ *    is a whole sound file in any format libsndfile reads (WAV, FLAC, ...),
+ *    or raw interleaved samples.
+ */
+
+#include <stdint.h>                    /* uint32_t, uint64_t                  */
+
+/**
+ *    The default socket, the magic of the messages ("WAON"), and the
+ *    version of the protocol.
+ */
+
+#define WAONCD_SOCKET                  "/tmp/waoncd.socket"
+#define WAONCD_MAGIC                   0x4e4f4157u
+#define WAONCD_VERSION                 1
+
+/**
+ *    The formats of the audio of a request.
+ */
+
+#define WAONCD_FORMAT_FILE             0  /* a sound file, e.g. WAV          */
+#define WAONCD_FORMAT_PCM16            1  /* raw 16-bit signed samples       */
+#define WAONCD_FORMAT_FLOAT            2  /* raw 32-bit float samples        */
+
+/**
+ *    The status of a response.  The payload of an error is its message.
+ */
+
+#define WAONCD_OK                      0  /* the payload is the SMF          */
+#define WAONCD_BUSY                    1  /* the queue is full, try again    */
+#define WAONCD_TOO_LARGE               2  /* over the size limit             */
+#define WAONCD_BAD_REQUEST             3  /* bad header or options           */
+#define WAONCD_BAD_AUDIO               4  /* the audio cannot be read        */
+#define WAONCD_FAILED                  5  /* the transcription failed        */
+
+/**
+ *    The header of a request, followed by options_len bytes of options
+ *    and audio_len bytes of audio.
+ */
+
+typedef struct
+{
+   uint32_t magic;         /*<< WAONCD_MAGIC.                                 */
+   uint32_t version;       /*<< WAONCD_VERSION.                               */
+   uint32_t format;        /*<< WAONCD_FORMAT_FILE, _PCM16 or _FLOAT.         */
+   uint32_t samplerate;    /*<< The rate of raw samples, else 0.              */
+   uint32_t channels;      /*<< The channels of raw samples (1 or 2), else 0. */
+   uint32_t options_len;   /*<< The bytes of the options, no terminator.      */
+   uint64_t audio_len;     /*<< The bytes of the audio.                       */
+
+} waoncd_request_t;
+
+/**
+ *    The header of a response, followed by payload_len bytes.  The times
+ *    are in microseconds, from the accept() of the connection:  the wait
+ *    in the queue, the receiving of the request, the planning (0 if the
+ *    worker had the plan and the patch), and the transcription, including
+ *    the decoding and the writing of the SMF.
+ */
+
+typedef struct
+{
+   uint32_t magic;         /*<< WAONCD_MAGIC.                                 */
+   uint32_t status;        /*<< WAONCD_OK or an error.                        */
+   uint32_t events;        /*<< The note-on and note-off events.              */
+   uint32_t worker;        /*<< The worker that did it.                       */
+   uint64_t us_queue;      /*<< Waiting for a worker.                         */
+   uint64_t us_receive;    /*<< Receiving the request.                        */
+   uint64_t us_plan;       /*<< Making the plan and the patch.                */
+   uint64_t us_transcribe; /*<< Transcribing.                                 */
+   uint64_t payload_len;   /*<< The bytes of the SMF or of the message.       */
+
+} waoncd_response_t;
+
+#endif         /* WAONC_WAONCD_H_ */
+
+/*
+ * waoncd.h
+ *
+ * vim: sw=3 ts=3 wm=8 et ft=c
+ */